@@ -0,0 +1,408 @@
+#include "AssetArchive.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <functional>
+
+#include "JobSystem.h"
+#include "LzCodec.h"
+#include "MeshFile.h"
+
+namespace
+{
+	using Clock = std::chrono::high_resolution_clock;
+
+	const uint32_t BLOCKS_PER_JOB = 2;
+
+	static_assert(sizeof(AssetArchiveHeader) == 64, "the header is written as it is, so it must not change size");
+	static_assert(sizeof(AssetArchiveEntry) == 40, "the asset table is written as it is, so it must not change size");
+	static_assert(sizeof(AssetArchiveBlock) == 24, "the block table is written as it is, so it must not change size");
+
+	double MillisecondsSince(Clock::time_point _start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - _start).count();
+	}
+
+	uint64_t Align(uint64_t _value, uint64_t _alignment)
+	{
+		return (_value + _alignment - 1) & ~(_alignment - 1);
+	}
+
+	std::string NormalizeName(const std::string& _name)
+	{
+		std::string name = _name;
+		std::replace(name.begin(), name.end(), '\\', '/');
+		return name;
+	}
+
+	void ForRange(JobSystem* _pJobSystem, uint32_t _count, uint32_t _grainSize, const std::function<void(unsigned int, unsigned int)>& _func)
+	{
+		if (_pJobSystem && _count > _grainSize)
+			_pJobSystem->ParallelFor(_count, _grainSize, _func);
+		else
+			_func(0, _count);
+	}
+
+	// the header, the tables and the names lie one after the other from the start of the file
+	uint64_t TablesChecksum(const uint8_t* _pData, uint64_t _size)
+	{
+		std::vector<uint8_t> bytes(_pData, _pData + _size);
+		memset(bytes.data() + offsetof(AssetArchiveHeader, checksum), 0, sizeof(uint64_t));
+		return MeshFile::Checksum(bytes.data(), bytes.size());
+	}
+
+	// one block and where it decompresses to
+	struct BlockRead
+	{
+		const AssetArchiveBlock* pBlock;
+		uint8_t* pOut;
+	};
+
+	bool ReadBlocks(const uint8_t* _pFile, const std::vector<BlockRead>& _reads, bool _verifyChecksums, JobSystem* _pJobSystem)
+	{
+		std::atomic<bool> valid(true);
+		ForRange(_pJobSystem, static_cast<uint32_t>(_reads.size()), BLOCKS_PER_JOB, [&](unsigned int _begin, unsigned int _end)
+		{
+			for (unsigned int i = _begin; i < _end; ++i)
+			{
+				const AssetArchiveBlock& block = *_reads[i].pBlock;
+				const uint8_t* pStored = _pFile + block.offset;
+				bool ok;
+				if (block.storedSize == block.size)
+				{
+					memcpy(_reads[i].pOut, pStored, block.size);
+					ok = true;
+				}
+				else
+					ok = LzCodec::Decompress(pStored, block.storedSize, _reads[i].pOut, block.size);
+				if (ok && _verifyChecksums)
+					ok = MeshFile::Checksum(_reads[i].pOut, block.size) == block.checksum;
+				if (!ok)
+					valid = false;
+			}
+		});
+		return valid;
+	}
+
+	// an asset on its way into the archive
+	struct PackedAsset
+	{
+		std::string name;
+		uint64_t nameHash;
+		std::vector<uint8_t> data;
+		std::vector<std::vector<uint8_t>> blocks; // compressed, or empty where that saved nothing
+		uint64_t storedSize = 0;
+		bool stored = false;
+	};
+}
+
+bool AssetArchive::Open(const std::string& _fileName, bool _verifyChecksums)
+{
+	Close();
+	if (!m_file.Open(_fileName))
+		return false;
+
+	// every count is checked against the file size before it is multiplied, so nothing below can overflow
+	const uint8_t* pData = m_file.Data();
+	uint64_t size = m_file.Size();
+	const AssetArchiveHeader* pHeader = reinterpret_cast<const AssetArchiveHeader*>(pData);
+	if (size < sizeof(AssetArchiveHeader) || pHeader->magic != FILE_MAGIC || pHeader->version != FILE_VERSION || pHeader->fileSize != size ||
+		pHeader->blockSize == 0 || pHeader->assetCount > size / sizeof(AssetArchiveEntry) || pHeader->blockCount > size / sizeof(AssetArchiveBlock) ||
+		pHeader->blockTableOffset != sizeof(AssetArchiveHeader) + pHeader->assetCount * sizeof(AssetArchiveEntry) ||
+		pHeader->namesOffset != pHeader->blockTableOffset + pHeader->blockCount * sizeof(AssetArchiveBlock) ||
+		pHeader->namesOffset > size || pHeader->namesSize > size - pHeader->namesOffset)
+	{
+		Close();
+		return false;
+	}
+	if (TablesChecksum(pData, pHeader->namesOffset + pHeader->namesSize) != pHeader->checksum)
+	{
+		Close();
+		return false;
+	}
+
+	// each asset's blocks have to add up to it, a block size at a time, and lie inside the file. stored assets have
+	// to be one aligned run of uncompressed blocks, since Data hands them out as they are
+	const AssetArchiveEntry* pEntries = reinterpret_cast<const AssetArchiveEntry*>(pData + sizeof(AssetArchiveHeader));
+	const AssetArchiveBlock* pBlocks = reinterpret_cast<const AssetArchiveBlock*>(pData + pHeader->blockTableOffset);
+	bool valid = true;
+	for (uint32_t i = 0; i < pHeader->assetCount && valid; ++i)
+	{
+		const AssetArchiveEntry& entry = pEntries[i];
+		valid = (i == 0 || pEntries[i - 1].nameHash <= entry.nameHash) && entry.nameOffset <= pHeader->namesSize &&
+			entry.nameLength <= pHeader->namesSize - entry.nameOffset && entry.firstBlock <= pHeader->blockCount &&
+			entry.blockCount <= pHeader->blockCount - entry.firstBlock && entry.blockCount == (entry.size + pHeader->blockSize - 1) / pHeader->blockSize;
+		bool stored = (entry.flags & ASSET_STORED) != 0;
+		for (uint32_t block = 0; block < entry.blockCount && valid; ++block)
+		{
+			const AssetArchiveBlock& b = pBlocks[entry.firstBlock + block];
+			uint64_t expected = std::min(static_cast<uint64_t>(pHeader->blockSize), entry.size - static_cast<uint64_t>(block) * pHeader->blockSize);
+			valid = b.size == expected && b.storedSize <= b.size && b.offset <= size && b.storedSize <= size - b.offset;
+			if (valid && stored)
+			{
+				valid = b.storedSize == b.size && (block == 0 ? b.offset % DATA_ALIGNMENT == 0 :
+					b.offset == pBlocks[entry.firstBlock + block - 1].offset + pBlocks[entry.firstBlock + block - 1].size);
+			}
+		}
+	}
+	if (!valid)
+	{
+		Close();
+		return false;
+	}
+
+	m_pHeader = pHeader;
+	m_pEntries = pEntries;
+	m_pBlocks = pBlocks;
+	m_pNames = reinterpret_cast<const char*>(pData + pHeader->namesOffset);
+	m_verifyChecksums = _verifyChecksums;
+	return true;
+}
+
+void AssetArchive::Close()
+{
+	m_file.Close();
+	m_pHeader = nullptr;
+	m_pEntries = nullptr;
+	m_pBlocks = nullptr;
+	m_pNames = nullptr;
+}
+
+std::string AssetArchive::Name(uint32_t _asset)
+{
+	return std::string(m_pNames + m_pEntries[_asset].nameOffset, m_pEntries[_asset].nameLength);
+}
+
+uint32_t AssetArchive::Find(const std::string& _name)
+{
+	// a binary search for the hash, then the names of everything with it, which is almost always one asset
+	std::string name = NormalizeName(_name);
+	uint64_t hash = NameHash(name);
+	const AssetArchiveEntry* pEnd = m_pEntries + m_pHeader->assetCount;
+	const AssetArchiveEntry* pEntry = std::lower_bound(m_pEntries, pEnd, hash, [](const AssetArchiveEntry& _entry, uint64_t _hash)
+	{
+		return _entry.nameHash < _hash;
+	});
+	for (; pEntry != pEnd && pEntry->nameHash == hash; ++pEntry)
+	{
+		if (pEntry->nameLength == name.size() && memcmp(m_pNames + pEntry->nameOffset, name.data(), name.size()) == 0)
+			return static_cast<uint32_t>(pEntry - m_pEntries);
+	}
+	return INVALID_ASSET;
+}
+
+const uint8_t* AssetArchive::Data(uint32_t _asset)
+{
+	const AssetArchiveEntry& entry = m_pEntries[_asset];
+	if ((entry.flags & ASSET_STORED) == 0)
+		return nullptr;
+	return entry.blockCount > 0 ? m_file.Data() + m_pBlocks[entry.firstBlock].offset : m_file.Data();
+}
+
+bool AssetArchive::Read(uint32_t _asset, std::vector<uint8_t>& _data, JobSystem* _pJobSystem)
+{
+	const AssetArchiveEntry& entry = m_pEntries[_asset];
+	_data.resize(static_cast<size_t>(entry.size));
+	std::vector<BlockRead> reads(entry.blockCount);
+	for (uint32_t block = 0; block < entry.blockCount; ++block)
+		reads[block] = { &m_pBlocks[entry.firstBlock + block], _data.data() + static_cast<size_t>(block) * m_pHeader->blockSize };
+	return ReadBlocks(m_file.Data(), reads, m_verifyChecksums, _pJobSystem);
+}
+
+bool AssetArchive::ReadMany(const uint32_t* _pAssets, uint32_t _count, std::vector<std::vector<uint8_t>>& _data, JobSystem* _pJobSystem)
+{
+	_data.resize(_count);
+	std::vector<BlockRead> reads;
+	for (uint32_t i = 0; i < _count; ++i)
+	{
+		const AssetArchiveEntry& entry = m_pEntries[_pAssets[i]];
+		_data[i].resize(static_cast<size_t>(entry.size));
+		for (uint32_t block = 0; block < entry.blockCount; ++block)
+			reads.push_back({ &m_pBlocks[entry.firstBlock + block], _data[i].data() + static_cast<size_t>(block) * m_pHeader->blockSize });
+	}
+	return ReadBlocks(m_file.Data(), reads, m_verifyChecksums, _pJobSystem);
+}
+
+bool AssetArchive::Pack(const std::vector<std::string>& _files, const std::string& _destination, const AssetPackDesc& _desc,
+	JobSystem* _pJobSystem, AssetPackStats* _pStats)
+{
+	if (_desc.blockSize == 0)
+		return false;
+
+	AssetPackStats stats;
+	Clock::time_point start = Clock::now();
+	uint32_t assetCount = static_cast<uint32_t>(_files.size());
+	std::vector<PackedAsset> assets(assetCount);
+	std::atomic<bool> readAll(true);
+	ForRange(_pJobSystem, assetCount, 1, [&](unsigned int _begin, unsigned int _end)
+	{
+		for (unsigned int i = _begin; i < _end; ++i)
+		{
+			std::ifstream file(_files[i], std::ios::binary | std::ios::ate);
+			if (!file)
+			{
+				readAll = false;
+				continue;
+			}
+			assets[i].data.resize(static_cast<size_t>(file.tellg()));
+			file.seekg(0);
+			if (!file.read(reinterpret_cast<char*>(assets[i].data.data()), static_cast<std::streamsize>(assets[i].data.size())))
+				readAll = false;
+			assets[i].name = NormalizeName(_files[i]);
+			assets[i].nameHash = NameHash(assets[i].name);
+		}
+	});
+	if (!readAll)
+		return false;
+
+	// the table order, which is also the order the data is laid out in
+	std::sort(assets.begin(), assets.end(), [](const PackedAsset& _a, const PackedAsset& _b)
+	{
+		return _a.nameHash != _b.nameHash ? _a.nameHash < _b.nameHash : _a.name < _b.name;
+	});
+	for (uint32_t i = 1; i < assetCount; ++i)
+	{
+		if (assets[i].name == assets[i - 1].name)
+			return false;
+	}
+
+	// every block of every asset is one job, so one big asset does not leave the other workers idle
+	std::vector<std::pair<uint32_t, uint32_t>> blocks;
+	for (uint32_t i = 0; i < assetCount; ++i)
+	{
+		uint32_t blockCount = static_cast<uint32_t>((assets[i].data.size() + _desc.blockSize - 1) / _desc.blockSize);
+		assets[i].blocks.resize(blockCount);
+		for (uint32_t block = 0; block < blockCount; ++block)
+			blocks.push_back(std::make_pair(i, block));
+	}
+	if (_desc.compress)
+	{
+		ForRange(_pJobSystem, static_cast<uint32_t>(blocks.size()), 1, [&](unsigned int _begin, unsigned int _end)
+		{
+			for (unsigned int i = _begin; i < _end; ++i)
+			{
+				PackedAsset& asset = assets[blocks[i].first];
+				size_t offset = static_cast<size_t>(blocks[i].second) * _desc.blockSize;
+				size_t size = std::min(static_cast<size_t>(_desc.blockSize), asset.data.size() - offset);
+				std::vector<uint8_t>& compressed = asset.blocks[blocks[i].second];
+				compressed.resize(LzCodec::MaxCompressedSize(size));
+				compressed.resize(LzCodec::Compress(asset.data.data() + offset, size, compressed.data()));
+				if (compressed.size() >= size)
+					compressed.clear();
+			}
+		});
+	}
+	for (PackedAsset& asset : assets)
+	{
+		for (uint32_t block = 0; block < asset.blocks.size(); ++block)
+		{
+			uint64_t size = std::min(static_cast<uint64_t>(_desc.blockSize), asset.data.size() - static_cast<uint64_t>(block) * _desc.blockSize);
+			asset.storedSize += asset.blocks[block].empty() ? size : asset.blocks[block].size();
+		}
+		asset.stored = asset.storedSize >= asset.data.size() * (1.0 - _desc.minSaving);
+		if (asset.stored)
+		{
+			asset.blocks.assign(asset.blocks.size(), std::vector<uint8_t>());
+			asset.storedSize = asset.data.size();
+		}
+	}
+	stats.compressMs = MillisecondsSince(start);
+
+	start = Clock::now();
+	AssetArchiveHeader header = {};
+	header.magic = FILE_MAGIC;
+	header.version = FILE_VERSION;
+	header.assetCount = assetCount;
+	header.blockCount = static_cast<uint32_t>(blocks.size());
+	header.blockSize = _desc.blockSize;
+	header.blockTableOffset = sizeof(AssetArchiveHeader) + assetCount * sizeof(AssetArchiveEntry);
+	header.namesOffset = header.blockTableOffset + header.blockCount * sizeof(AssetArchiveBlock);
+
+	std::vector<AssetArchiveEntry> entries(assetCount);
+	std::vector<AssetArchiveBlock> blockTable(header.blockCount);
+	std::string names;
+	for (const PackedAsset& asset : assets)
+		names += asset.name;
+	header.namesSize = names.size();
+
+	// every asset starts on an alignment boundary, its blocks follow one another
+	uint64_t offset = Align(header.namesOffset + header.namesSize, DATA_ALIGNMENT);
+	uint32_t firstBlock = 0;
+	uint32_t nameOffset = 0;
+	for (uint32_t i = 0; i < assetCount; ++i)
+	{
+		const PackedAsset& asset = assets[i];
+		AssetArchiveEntry& entry = entries[i];
+		entry.nameHash = asset.nameHash;
+		entry.nameOffset = nameOffset;
+		entry.nameLength = static_cast<uint32_t>(asset.name.size());
+		entry.size = asset.data.size();
+		entry.firstBlock = firstBlock;
+		entry.blockCount = static_cast<uint32_t>(asset.blocks.size());
+		entry.flags = asset.stored ? ASSET_STORED : 0;
+		nameOffset += entry.nameLength;
+
+		for (uint32_t block = 0; block < entry.blockCount; ++block)
+		{
+			AssetArchiveBlock& b = blockTable[firstBlock + block];
+			size_t blockOffset = static_cast<size_t>(block) * _desc.blockSize;
+			b.size = static_cast<uint32_t>(std::min(static_cast<size_t>(_desc.blockSize), asset.data.size() - blockOffset));
+			b.storedSize = asset.blocks[block].empty() ? b.size : static_cast<uint32_t>(asset.blocks[block].size());
+			b.offset = offset;
+			b.checksum = MeshFile::Checksum(asset.data.data() + blockOffset, b.size);
+			offset += b.storedSize;
+		}
+		firstBlock += entry.blockCount;
+		offset = Align(offset, DATA_ALIGNMENT);
+
+		stats.size += entry.size;
+		stats.storedCount += asset.stored ? 1 : 0;
+	}
+	header.fileSize = blockTable.empty() ? header.namesOffset + header.namesSize : blockTable.back().offset + blockTable.back().storedSize;
+
+	std::vector<uint8_t> tables(static_cast<size_t>(header.namesOffset + header.namesSize));
+	memcpy(tables.data(), &header, sizeof(header));
+	memcpy(tables.data() + sizeof(header), entries.data(), entries.size() * sizeof(AssetArchiveEntry));
+	memcpy(tables.data() + header.blockTableOffset, blockTable.data(), blockTable.size() * sizeof(AssetArchiveBlock));
+	memcpy(tables.data() + header.namesOffset, names.data(), names.size());
+	header.checksum = TablesChecksum(tables.data(), tables.size());
+	memcpy(tables.data(), &header, sizeof(header));
+
+	std::ofstream file(_destination, std::ios::binary);
+	if (!file)
+		return false;
+
+	const char padding[DATA_ALIGNMENT] = {};
+	file.write(reinterpret_cast<const char*>(tables.data()), static_cast<std::streamsize>(tables.size()));
+	uint64_t written = tables.size();
+	for (uint32_t i = 0; i < assetCount; ++i)
+	{
+		const PackedAsset& asset = assets[i];
+		for (uint32_t block = 0; block < entries[i].blockCount; ++block)
+		{
+			const AssetArchiveBlock& b = blockTable[entries[i].firstBlock + block];
+			file.write(padding, static_cast<std::streamsize>(b.offset - written));
+			const uint8_t* pStored = asset.blocks[block].empty() ? asset.data.data() + static_cast<size_t>(block) * _desc.blockSize : asset.blocks[block].data();
+			file.write(reinterpret_cast<const char*>(pStored), b.storedSize);
+			written = b.offset + b.storedSize;
+		}
+	}
+	file.close();
+	stats.writeMs = MillisecondsSince(start);
+
+	stats.assetCount = assetCount;
+	stats.packedSize = header.fileSize;
+	if (_pStats)
+		*_pStats = stats;
+	return static_cast<bool>(file);
+}
+
+uint64_t AssetArchive::NameHash(const std::string& _name)
+{
+	std::string name = NormalizeName(_name);
+	return MeshFile::Checksum(name.data(), name.size());
+}
@@ -0,0 +1,121 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+
+class JobSystem;
+
+struct AssetArchiveHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t fileSize;
+	uint32_t assetCount; // the asset table follows the header, then the block table, then the names
+	uint32_t blockCount;
+	uint32_t blockSize; // bytes of an asset in each block, but its last
+	uint32_t reserved;
+	uint64_t blockTableOffset;
+	uint64_t namesOffset;
+	uint64_t namesSize;
+	uint64_t checksum; // of the header, with this set to 0, the asset and block tables and the names
+};
+
+struct AssetArchiveEntry
+{
+	uint64_t nameHash; // AssetArchive::NameHash of the name, the table is sorted by it
+	uint32_t nameOffset; // bytes into the names, which are not 0 terminated
+	uint32_t nameLength;
+	uint64_t size; // bytes once decompressed
+	uint32_t firstBlock;
+	uint32_t blockCount;
+	uint32_t flags; // ASSET_STORED
+	uint32_t reserved;
+};
+
+struct AssetArchiveBlock
+{
+	uint64_t offset; // bytes from the start of the file
+	uint32_t storedSize; // the same as size when the block is kept uncompressed
+	uint32_t size;
+	uint64_t checksum; // MeshFile::Checksum of the decompressed bytes
+};
+
+struct AssetPackDesc
+{
+	uint32_t blockSize = 64 * 1024; // smaller blocks share out more evenly, bigger ones compress a little better
+	float minSaving = 0.1f; // an asset compression shrinks by less than this is stored as it is, so it can be mapped
+	bool compress = true;
+};
+
+// what Pack did
+struct AssetPackStats
+{
+	uint32_t assetCount = 0;
+	uint32_t storedCount = 0; // of those, how many were not compressed
+	uint64_t size = 0; // of all the assets
+	uint64_t packedSize = 0; // of the archive
+	double compressMs = 0.0;
+	double writeMs = 0.0;
+};
+
+// many assets in one file, found by name in a sorted table of hashes, so a level load opens one file instead of one
+// per asset.
+//
+// each asset is cut into blocks of AssetPackDesc::blockSize, compressed with LzCodec one at a time, so any block can
+// be decompressed on its own. ReadMany shares the blocks of every asset it is given out over the job system, which
+// keeps all the workers busy even when one asset is much bigger than the rest. an asset that does not compress well,
+// like a block compressed texture, is stored as it is instead, starting on a DATA_ALIGNMENT boundary, and Data hands
+// out a pointer straight into the mapping for it, the way MeshFile and TextureFile read their own files
+class AssetArchive
+{
+public:
+	static const uint32_t FILE_MAGIC = 0x4b434150; // "PACK"
+	static const uint32_t FILE_VERSION = 2; // 2: xxhash64 checksums and name hashes
+	static const uint32_t DATA_ALIGNMENT = 64;
+	static const uint32_t ASSET_STORED = 1; // every block of the asset is uncompressed and they follow one another
+	static const uint32_t INVALID_ASSET = 0xffffffff;
+
+	AssetArchive() = default;
+	~AssetArchive() = default;
+
+	// false if the file is missing, truncated, from another version or its tables fail their checksum. with
+	// _verifyChecksums every block read is checked against its checksum as well
+	bool Open(const std::string& _fileName, bool _verifyChecksums = true);
+	void Close();
+	bool IsOpen() { return m_pHeader != nullptr; }
+
+	uint32_t AssetCount() { return m_pHeader->assetCount; }
+	const AssetArchiveEntry& Entry(uint32_t _asset) { return m_pEntries[_asset]; }
+	std::string Name(uint32_t _asset);
+
+	// the asset packed from _name, INVALID_ASSET if there is none. '\' and '/' are the same
+	uint32_t Find(const std::string& _name);
+
+	// the asset's bytes in the mapping when it is stored, nullptr when it has to be read
+	const uint8_t* Data(uint32_t _asset);
+
+	// decompresses an asset into _data. false if a block is corrupt
+	bool Read(uint32_t _asset, std::vector<uint8_t>& _data, JobSystem* _pJobSystem = nullptr);
+
+	// reads _count assets at once into _data, one vector each, with the blocks of all of them shared out together.
+	// false if any block is corrupt
+	bool ReadMany(const uint32_t* _pAssets, uint32_t _count, std::vector<std::vector<uint8_t>>& _data, JobSystem* _pJobSystem = nullptr);
+
+	// packs _files into _destination, each named by its path as given. compression runs on the job system, a block at
+	// a time. false if a file cannot be read or two have the same name
+	static bool Pack(const std::vector<std::string>& _files, const std::string& _destination, const AssetPackDesc& _desc = AssetPackDesc(),
+		JobSystem* _pJobSystem = nullptr, AssetPackStats* _pStats = nullptr);
+
+	// what the asset table is sorted and searched by
+	static uint64_t NameHash(const std::string& _name);
+
+private:
+	MappedFile m_file;
+	const AssetArchiveHeader* m_pHeader = nullptr;
+	const AssetArchiveEntry* m_pEntries = nullptr;
+	const AssetArchiveBlock* m_pBlocks = nullptr;
+	const char* m_pNames = nullptr;
+	bool m_verifyChecksums = true;
+};
@@ -0,0 +1,335 @@
+#include "AssetBuilder.h"
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <sys/stat.h>
+#include <sys/types.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+#include "JobSystem.h"
+#include "MappedFile.h"
+#include "MeshFile.h"
+
+namespace
+{
+	using Clock = std::chrono::high_resolution_clock;
+
+	const char* STATE_FILE = "state.txt";
+
+	// part of every key, bump when what goes into a key or the hash over it changes, so nothing made under the old keys
+	// is taken as up to date or fetched from the cache. 2: xxhash64
+	const uint32_t KEY_VERSION = 2;
+
+	bool MakeDirectory(const std::string& _path)
+	{
+#ifdef _WIN32
+		_mkdir(_path.c_str());
+		struct _stat64 status;
+		return _stat64(_path.c_str(), &status) == 0 && (status.st_mode & _S_IFDIR) != 0;
+#else
+		mkdir(_path.c_str(), 0755);
+		struct stat status;
+		return stat(_path.c_str(), &status) == 0 && S_ISDIR(status.st_mode);
+#endif
+	}
+
+	// MeshFile's xxhash64, strong enough that two contents or two keys never share a hash in practice. false if the
+	// file is not there. an empty file hashes like no bytes at all
+	bool HashFile(const std::string& _fileName, uint64_t& _hash)
+	{
+		MappedFile file;
+		if (file.Open(_fileName))
+		{
+			_hash = MeshFile::Checksum(file.Data(), file.Size());
+			return true;
+		}
+		_hash = MeshFile::Checksum(nullptr, 0);
+		return static_cast<bool>(std::ifstream(_fileName, std::ios::binary));
+	}
+
+	// through a temporary beside the destination, so a build stopped half way never leaves half a file behind. steps
+	// with the same key can store to the cache at the same time, so each has its own temporary
+	bool CopyContents(const std::string& _source, const std::string& _destination, uint32_t _step)
+	{
+		std::string temporary = _destination + ".tmp" + std::to_string(_step);
+		{
+			std::ifstream source(_source, std::ios::binary);
+			std::ofstream destination(temporary, std::ios::binary);
+			if (!source || !destination)
+				return false;
+			if (source.peek() != std::ifstream::traits_type::eof())
+				destination << source.rdbuf();
+			if (!destination)
+				return false;
+		}
+		std::remove(_destination.c_str());
+		if (std::rename(temporary.c_str(), _destination.c_str()) == 0)
+			return true;
+		std::remove(temporary.c_str());
+		return false;
+	}
+
+	void Append(std::vector<uint8_t>& _bytes, const void* _pData, size_t _size)
+	{
+		const uint8_t* pData = static_cast<const uint8_t*>(_pData);
+		_bytes.insert(_bytes.end(), pData, pData + _size);
+	}
+
+	void Append(std::vector<uint8_t>& _bytes, const std::string& _string)
+	{
+		// with the terminator, so "ab" + "c" and "a" + "bc" differ
+		Append(_bytes, _string.c_str(), _string.size() + 1);
+	}
+}
+
+bool AssetBuilder::Init(const std::string& _cacheDirectory)
+{
+	m_cacheDirectory = _cacheDirectory;
+	m_states.clear();
+	if (!MakeDirectory(m_cacheDirectory))
+		return false;
+
+	// "key contentHash size time output" a line, the output last since it may hold spaces
+	std::ifstream file(m_cacheDirectory + "/" + STATE_FILE);
+	std::string line;
+	while (std::getline(file, line))
+	{
+		OutputState state;
+		char output[1024];
+		if (sscanf(line.c_str(), "%" SCNx64 " %" SCNx64 " %" SCNu64 " %" SCNu64 " %1023[^\n]", &state.key, &state.contentHash, &state.size,
+			&state.time, output) == 5)
+			m_states[output] = state;
+	}
+	return true;
+}
+
+void AssetBuilder::AddTool(const std::string& _name, uint64_t _version, ToolFunc _func)
+{
+	Tool tool = { _version, _func };
+	m_tools[_name] = tool;
+}
+
+bool AssetBuilder::AddStep(const AssetBuildStep& _step)
+{
+	if (_step.inputs.empty() || !m_outputSteps.insert(std::make_pair(_step.output, static_cast<uint32_t>(m_steps.size()))).second)
+		return false;
+	m_steps.push_back(_step);
+	return true;
+}
+
+bool AssetBuilder::LoadSteps(const std::string& _fileName)
+{
+	std::ifstream file(_fileName);
+	if (!file)
+		return false;
+
+	std::string line;
+	while (std::getline(file, line))
+	{
+		std::istringstream parts(line);
+		std::string tool;
+		if (!(parts >> tool) || tool[0] == '#')
+			continue;
+
+		AssetBuildStep step;
+		size_t colon = tool.find(':');
+		step.tool = tool.substr(0, colon);
+		step.settings = colon == std::string::npos ? std::string() : tool.substr(colon + 1);
+		std::string input;
+		parts >> step.output;
+		while (parts >> input)
+			step.inputs.push_back(input);
+		if (step.output.empty() || !AddStep(step))
+			return false;
+	}
+	return true;
+}
+
+bool AssetBuilder::Build(JobSystem* _pJobSystem, AssetBuildStats* _pStats)
+{
+	Clock::time_point start = Clock::now();
+	uint32_t stepCount = static_cast<uint32_t>(m_steps.size());
+	m_results.assign(stepCount, ASSET_BUILD_PENDING);
+	m_outputHashes.assign(stepCount, 0);
+	m_newStates.assign(stepCount, OutputState());
+	m_dependencies.assign(stepCount, std::vector<uint32_t>());
+
+	// an input another step makes ties the two together, anything else is a source
+	std::vector<uint32_t> waitingOn(stepCount, 0);
+	std::vector<std::vector<uint32_t>> dependents(stepCount);
+	for (uint32_t step = 0; step < stepCount; ++step)
+	{
+		if (m_tools.find(m_steps[step].tool) == m_tools.end())
+			return false;
+		for (const std::string& input : m_steps[step].inputs)
+		{
+			std::map<std::string, uint32_t>::const_iterator it = m_outputSteps.find(input);
+			if (it == m_outputSteps.end())
+				continue;
+			m_dependencies[step].push_back(it->second);
+			dependents[it->second].push_back(step);
+			waitingOn[step]++;
+		}
+	}
+
+	// waves of steps whose inputs are all made, until none are left. steps left over wait on each other
+	std::vector<uint32_t> wave;
+	for (uint32_t step = 0; step < stepCount; ++step)
+	{
+		if (waitingOn[step] == 0)
+			wave.push_back(step);
+	}
+	uint32_t done = 0;
+	uint32_t waveCount = 0;
+	while (!wave.empty())
+	{
+		if (_pJobSystem && wave.size() > 1)
+		{
+			_pJobSystem->ParallelFor(static_cast<unsigned int>(wave.size()), 1, [&](unsigned int _begin, unsigned int _end)
+			{
+				for (unsigned int i = _begin; i < _end; ++i)
+					RunStep(wave[i], _pJobSystem);
+			});
+		}
+		else
+		{
+			for (uint32_t step : wave)
+				RunStep(step, _pJobSystem);
+		}
+		done += static_cast<uint32_t>(wave.size());
+		waveCount++;
+
+		std::vector<uint32_t> next;
+		for (uint32_t step : wave)
+		{
+			for (uint32_t dependent : dependents[step])
+			{
+				if (--waitingOn[dependent] == 0)
+					next.push_back(dependent);
+			}
+		}
+		wave.swap(next);
+	}
+	bool cycle = done < stepCount;
+
+	AssetBuildStats stats;
+	stats.stepCount = stepCount;
+	stats.waveCount = waveCount;
+	for (uint32_t step = 0; step < stepCount; ++step)
+	{
+		switch (m_results[step])
+		{
+		case ASSET_BUILD_UP_TO_DATE: stats.upToDate++; break;
+		case ASSET_BUILD_FROM_CACHE: stats.fromCache++; break;
+		case ASSET_BUILD_BUILT: stats.built++; break;
+		case ASSET_BUILD_FAILED: stats.failed++; break;
+		default: stats.skipped++; break;
+		}
+
+		// a failed step forgets its output, so the next build tries it again
+		if (m_results[step] == ASSET_BUILD_UP_TO_DATE || m_results[step] == ASSET_BUILD_FROM_CACHE || m_results[step] == ASSET_BUILD_BUILT)
+			m_states[m_steps[step].output] = m_newStates[step];
+		else
+			m_states.erase(m_steps[step].output);
+	}
+	bool saved = SaveState();
+	stats.ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	if (_pStats)
+		*_pStats = stats;
+	return !cycle && saved && stats.failed == 0 && stats.skipped == 0;
+}
+
+void AssetBuilder::RunStep(uint32_t _step, JobSystem* _pJobSystem)
+{
+	const AssetBuildStep& step = m_steps[_step];
+	for (uint32_t dependency : m_dependencies[_step])
+	{
+		if (m_results[dependency] == ASSET_BUILD_FAILED || m_results[dependency] == ASSET_BUILD_SKIPPED)
+		{
+			m_results[_step] = ASSET_BUILD_SKIPPED;
+			return;
+		}
+	}
+
+	// the key. outputs of other steps are hashed already, sources are hashed here
+	const Tool& tool = m_tools.find(step.tool)->second;
+	std::vector<uint8_t> keyBytes;
+	Append(keyBytes, &KEY_VERSION, sizeof(KEY_VERSION));
+	Append(keyBytes, step.tool);
+	Append(keyBytes, &tool.version, sizeof(tool.version));
+	Append(keyBytes, step.settings);
+	for (const std::string& input : step.inputs)
+	{
+		uint64_t hash;
+		std::map<std::string, uint32_t>::const_iterator it = m_outputSteps.find(input);
+		if (it != m_outputSteps.end())
+			hash = m_outputHashes[it->second];
+		else if (!HashFile(input, hash))
+		{
+			m_results[_step] = ASSET_BUILD_FAILED;
+			return;
+		}
+		Append(keyBytes, input);
+		Append(keyBytes, &hash, sizeof(hash));
+	}
+	OutputState& state = m_newStates[_step];
+	state.key = MeshFile::Checksum(keyBytes.data(), keyBytes.size());
+
+	// the same key as last time and the output untouched since, nothing to do
+	std::map<std::string, OutputState>::const_iterator last = m_states.find(step.output);
+	MeshFile::SourceStamp(step.output, state.size, state.time);
+	if (last != m_states.end() && last->second.key == state.key && last->second.size == state.size && last->second.time == state.time &&
+		std::ifstream(step.output, std::ios::binary))
+	{
+		state.contentHash = last->second.contentHash;
+		m_outputHashes[_step] = state.contentHash;
+		m_results[_step] = ASSET_BUILD_UP_TO_DATE;
+		return;
+	}
+
+	// made before from the same inputs, or made now and kept for next time
+	std::string cachePath = CachePath(state.key);
+	uint64_t cachedHash;
+	if (HashFile(cachePath, cachedHash) && CopyContents(cachePath, step.output, _step))
+		m_results[_step] = ASSET_BUILD_FROM_CACHE;
+	else if (tool.func(step, _pJobSystem) && HashFile(step.output, cachedHash))
+	{
+		// a cache that cannot be written only costs the next build time
+		CopyContents(step.output, cachePath, _step);
+		m_results[_step] = ASSET_BUILD_BUILT;
+	}
+	else
+	{
+		m_results[_step] = ASSET_BUILD_FAILED;
+		return;
+	}
+	MeshFile::SourceStamp(step.output, state.size, state.time);
+	state.contentHash = cachedHash;
+	m_outputHashes[_step] = cachedHash;
+}
+
+bool AssetBuilder::SaveState()
+{
+	std::ofstream file(m_cacheDirectory + "/" + STATE_FILE);
+	for (const std::pair<const std::string, OutputState>& entry : m_states)
+	{
+		const OutputState& state = entry.second;
+		char line[128];
+		snprintf(line, sizeof(line), "%016" PRIx64 " %016" PRIx64 " %" PRIu64 " %" PRIu64 " ", state.key, state.contentHash, state.size, state.time);
+		file << line << entry.first << "\n";
+	}
+	return static_cast<bool>(file);
+}
+
+std::string AssetBuilder::CachePath(uint64_t _key)
+{
+	char name[17];
+	snprintf(name, sizeof(name), "%016" PRIx64, _key);
+	return m_cacheDirectory + "/" + name;
+}
@@ -0,0 +1,110 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+class JobSystem;
+
+// one output made from its inputs by a tool
+struct AssetBuildStep
+{
+	std::string tool;
+	std::string settings; // handed to the tool as it is, a texture's format or a shader's target
+	std::string output;
+	std::vector<std::string> inputs; // the first is what the tool reads, any others are what it reads along with it, like included files
+};
+
+enum AssetBuildResult
+{
+	ASSET_BUILD_PENDING = 0,
+	ASSET_BUILD_UP_TO_DATE, // the output is what the last build left for the same key
+	ASSET_BUILD_FROM_CACHE, // copied out of the cache, made earlier from the same inputs
+	ASSET_BUILD_BUILT,
+	ASSET_BUILD_FAILED, // the tool failed or an input is missing
+	ASSET_BUILD_SKIPPED // a step it needs failed
+};
+
+// what Build did
+struct AssetBuildStats
+{
+	uint32_t stepCount = 0;
+	uint32_t upToDate = 0;
+	uint32_t fromCache = 0;
+	uint32_t built = 0;
+	uint32_t failed = 0;
+	uint32_t skipped = 0;
+	uint32_t waveCount = 0; // steps that run together, each waiting for the last
+	double ms = 0.0;
+};
+
+// builds assets incrementally: a step only runs when something it is made from has changed, and anything it has
+// made before is fetched from a cache instead of being made again.
+//
+// a step's key hashes its tool and the tool's version, its settings, and the names and contents of its inputs. the
+// outputs of other steps count by their content too, so a source edit that makes the same mesh leaves everything
+// built from that mesh alone. outputs are kept in the cache directory under their key, so going back to an earlier
+// version of a source, or building on a clean checkout, copies the old output back. the cache dir also keeps what
+// key each output was last made with, and its size and time, so an output nobody touched needs neither.
+//
+// steps that read another's output wait for it. Build sorts the steps into waves of ones that do not depend on each
+// other and runs each wave across the job system. the tools are free to use the job system too
+class AssetBuilder
+{
+public:
+	// makes _step's output, false if it could not
+	typedef std::function<bool(const AssetBuildStep& _step, JobSystem* _pJobSystem)> ToolFunc;
+
+	AssetBuilder() = default;
+	~AssetBuilder() = default;
+
+	// creates the cache directory if it is not there and loads what the last build left in it
+	bool Init(const std::string& _cacheDirectory);
+
+	// _version is part of every key the tool makes, so bumping it rebuilds everything it made
+	void AddTool(const std::string& _name, uint64_t _version, ToolFunc _func);
+
+	// false if another step already makes the same output
+	bool AddStep(const AssetBuildStep& _step);
+
+	// adds the steps in a build file, one a line: "tool[:settings] output input [input ...]". empty lines and ones
+	// starting with # are skipped. false if the file is missing or a line has too few parts
+	bool LoadSteps(const std::string& _fileName);
+
+	// builds every step that is not up to date. false if a tool is unknown, the steps form a cycle or any step fails
+	bool Build(JobSystem* _pJobSystem = nullptr, AssetBuildStats* _pStats = nullptr);
+
+	const std::vector<AssetBuildStep>& Steps() { return m_steps; }
+	AssetBuildResult Result(uint32_t _step) { return m_results[_step]; } // from the last Build
+
+private:
+	struct Tool
+	{
+		uint64_t version;
+		ToolFunc func;
+	};
+
+	// what an output was last made with, kept in the cache directory between builds
+	struct OutputState
+	{
+		uint64_t key;
+		uint64_t contentHash;
+		uint64_t size;
+		uint64_t time;
+	};
+
+	void RunStep(uint32_t _step, JobSystem* _pJobSystem);
+	bool SaveState();
+	std::string CachePath(uint64_t _key);
+
+	std::string m_cacheDirectory;
+	std::map<std::string, Tool> m_tools;
+	std::vector<AssetBuildStep> m_steps;
+	std::map<std::string, uint32_t> m_outputSteps; // which step makes each output
+	std::vector<std::vector<uint32_t>> m_dependencies; // per step, the steps making its inputs
+	std::vector<AssetBuildResult> m_results;
+	std::vector<uint64_t> m_outputHashes; // per step, of its output once it is done
+	std::vector<OutputState> m_newStates; // per step, written back to m_states after the build
+	std::map<std::string, OutputState> m_states;
+};
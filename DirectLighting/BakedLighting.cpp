@@ -0,0 +1,362 @@
+#include "BakedLighting.h"
+
+#include <cstring>
+
+#include "D3dx12.h"
+
+using namespace DirectX;
+
+static_assert(sizeof(BakedLightingConstants) == 64, "BakedLightingConstants must match the cbuffer in BakedLighting.hlsli");
+static_assert(sizeof(LightmapFileChart) == 80, "LightmapFileChart must match LightmapChart in BakedLighting.hlsli");
+static_assert(LightmapBaker::DXGI_FORMAT_RGB9E5 == DXGI_FORMAT_R9G9B9E5_SHAREDEXP, "the lightmap file names its format by dxgi's number");
+
+void BakedLighting::AddRootParameters(RootSignatureDesc& _rootSignatureDesc)
+{
+	m_rootConstants = _rootSignatureDesc.AddConstants(2, sizeof(BakedLightingConstants) / sizeof(UINT), D3D12_SHADER_VISIBILITY_PIXEL);
+	m_rootLightmap = _rootSignatureDesc.AddDescriptorTable(D3D12_SHADER_VISIBILITY_PIXEL);
+	_rootSignatureDesc.AddDescriptorRange(m_rootLightmap, D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 4);
+	m_rootCharts = _rootSignatureDesc.AddSRV(5, D3D12_SHADER_VISIBILITY_PIXEL);
+	m_rootVolume = _rootSignatureDesc.AddDescriptorTable(D3D12_SHADER_VISIBILITY_PIXEL);
+	_rootSignatureDesc.AddDescriptorRange(m_rootVolume, D3D12_DESCRIPTOR_RANGE_TYPE_SRV, IrradianceVolume::GPU_TEXTURE_COUNT, 6);
+
+	// the lightmap's padding is there so this can filter across texels without reaching another chart, and in the
+	// volume it blends the eight probes around a point
+	D3D12_STATIC_SAMPLER_DESC sampler = {};
+	sampler.Filter = D3D12_FILTER_MIN_MAG_MIP_LINEAR;
+	sampler.AddressU = D3D12_TEXTURE_ADDRESS_MODE_CLAMP;
+	sampler.AddressV = D3D12_TEXTURE_ADDRESS_MODE_CLAMP;
+	sampler.AddressW = D3D12_TEXTURE_ADDRESS_MODE_CLAMP;
+	sampler.ComparisonFunc = D3D12_COMPARISON_FUNC_NEVER;
+	sampler.MaxLOD = D3D12_FLOAT32_MAX;
+	sampler.ShaderRegister = 0;
+	sampler.ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
+	_rootSignatureDesc.AddStaticSampler(sampler);
+}
+
+bool BakedLighting::Init(ID3D12Device* _pDevice)
+{
+	m_pDevice = _pDevice;
+
+	D3D12_DESCRIPTOR_HEAP_DESC heapDesc = {};
+	heapDesc.NumDescriptors = DESCRIPTOR_SETS * (1 + IrradianceVolume::GPU_TEXTURE_COUNT) + SHARED_VIEWS;
+	heapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+	heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+	HRESULT hr = _pDevice->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(&m_pDescriptorHeap));
+	if (FAILED(hr))
+	{
+		return false;
+	}
+	m_descriptorSize = _pDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+
+	// every table has to point at a valid view even while the shader does not read it, so they start out null
+	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format = DXGI_FORMAT_R9G9B9E5_SHAREDEXP;
+	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	srvDesc.Texture2D.MipLevels = 1;
+	for (UINT i = 0; i < DESCRIPTOR_SETS; ++i)
+	{
+		CD3DX12_CPU_DESCRIPTOR_HANDLE srvHandle(m_pDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), i, m_descriptorSize);
+		_pDevice->CreateShaderResourceView(nullptr, &srvDesc, srvHandle);
+	}
+	srvDesc.Format = DXGI_FORMAT_R16G16B16A16_FLOAT;
+	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE3D;
+	srvDesc.Texture3D.MipLevels = 1;
+	for (UINT i = DESCRIPTOR_SETS; i < heapDesc.NumDescriptors - SHARED_VIEWS; ++i)
+	{
+		CD3DX12_CPU_DESCRIPTOR_HANDLE srvHandle(m_pDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), i, m_descriptorSize);
+		_pDevice->CreateShaderResourceView(nullptr, &srvDesc, srvHandle);
+	}
+	return true;
+}
+
+bool BakedLighting::LoadLightmap(const std::string& _fileName)
+{
+	LightmapBaker::FileHeader header;
+	std::vector<uint32_t> texels;
+	std::vector<LightmapFileChart> charts;
+	if (!LightmapBaker::Load(_fileName, header, texels, charts) || header.width == 0 || header.height == 0)
+	{
+		return false;
+	}
+	m_pendingHeader = header;
+	m_pendingTexels.swap(texels);
+	m_pendingCharts.swap(charts);
+	m_pendingLightmap = true;
+	return true;
+}
+
+void BakedLighting::LoadIrradianceVolume(IrradianceVolume& _volume)
+{
+	m_pendingVolumeDesc = _volume.Desc();
+	_volume.GpuTexels(m_pendingVolumeTexels);
+	m_pendingVolume = true;
+}
+
+void BakedLighting::Update(GraphicsCommandRecorder& _recorder, UINT64 _frameNumber)
+{
+	// release what was replaced once the gpu can no longer be using it
+	for (size_t i = 0; i < m_retired.size();)
+	{
+		if (m_retired[i].releaseFrame <= _frameNumber)
+		{
+			m_retired[i].pResource->Release();
+			m_retired[i] = m_retired.back();
+			m_retired.pop_back();
+			continue;
+		}
+		++i;
+	}
+
+	if (m_pendingLightmap)
+	{
+		m_pendingLightmap = false;
+		Retire(m_pLightmap, _frameNumber + MAX_FRAMES);
+		Retire(m_pCharts, _frameNumber + MAX_FRAMES);
+		m_pLightmap = nullptr;
+		m_pCharts = nullptr;
+		m_constants.lightmapChartCount = 0;
+
+		// the frame is lit from the clusters alone if the new lightmap does not make it to the gpu
+		if (!CreateLightmap(_recorder, _frameNumber))
+		{
+			Retire(m_pLightmap, _frameNumber + MAX_FRAMES);
+			Retire(m_pCharts, _frameNumber + MAX_FRAMES);
+			m_pLightmap = nullptr;
+			m_pCharts = nullptr;
+		}
+		else
+		{
+			m_constants.lightmapChartCount = m_pendingHeader.chartCount;
+			m_constants.lightmapInvWidth = 1.0f / m_pendingHeader.width;
+			m_constants.lightmapInvHeight = 1.0f / m_pendingHeader.height;
+		}
+		m_pendingTexels = std::vector<uint32_t>();
+		m_pendingCharts = std::vector<LightmapFileChart>();
+	}
+
+	if (m_pendingVolume)
+	{
+		m_pendingVolume = false;
+		for (ID3D12Resource*& pTexture : m_pVolume)
+		{
+			Retire(pTexture, _frameNumber + MAX_FRAMES);
+			pTexture = nullptr;
+		}
+		m_constants.volumeProbeCount = XMFLOAT3(0.0f, 0.0f, 0.0f);
+
+		// and with the flat ambient if the volume does not
+		if (!CreateIrradianceVolume(_recorder, _frameNumber))
+		{
+			for (ID3D12Resource*& pTexture : m_pVolume)
+			{
+				Retire(pTexture, _frameNumber + MAX_FRAMES);
+				pTexture = nullptr;
+			}
+		}
+		else
+		{
+			m_constants.volumeBoundsMin = m_pendingVolumeDesc.boundsMin;
+			m_constants.volumeBoundsMax = m_pendingVolumeDesc.boundsMax;
+			m_constants.volumeProbeCount = XMFLOAT3(static_cast<float>(m_pendingVolumeDesc.countX),
+				static_cast<float>(m_pendingVolumeDesc.countY), static_cast<float>(m_pendingVolumeDesc.countZ));
+		}
+		m_pendingVolumeTexels = std::vector<uint16_t>();
+	}
+}
+
+bool BakedLighting::CreateLightmap(GraphicsCommandRecorder& _recorder, UINT64 _frameNumber)
+{
+	D3D12_RESOURCE_DESC textureDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R9G9B9E5_SHAREDEXP, m_pendingHeader.width, m_pendingHeader.height, 1, 1);
+	if (!CreateTexture(_recorder, _frameNumber, textureDesc, m_pendingTexels.data(), L"Lightmap Resource Heap", m_pLightmap))
+	{
+		return false;
+	}
+
+	UINT64 chartsSize = static_cast<UINT64>(m_pendingCharts.size()) * sizeof(LightmapFileChart);
+	HRESULT hr = m_pDevice->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(chartsSize > 0 ? chartsSize : sizeof(LightmapFileChart)),
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(&m_pCharts));
+	if (FAILED(hr))
+	{
+		return false;
+	}
+	m_pCharts->SetName(L"Lightmap Charts Resource Heap");
+	UINT8* pData = nullptr;
+	CD3DX12_RANGE readRange(0, 0); // we never read it on the cpu
+	hr = m_pCharts->Map(0, &readRange, reinterpret_cast<void**>(&pData));
+	if (FAILED(hr))
+	{
+		return false;
+	}
+	if (chartsSize > 0)
+		memcpy(pData, m_pendingCharts.data(), static_cast<size_t>(chartsSize));
+	m_pCharts->Unmap(0, nullptr);
+
+	// a set the frames in flight are not using, see the class comment
+	m_lightmapSet = (m_lightmapSet + 1) % DESCRIPTOR_SETS;
+	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format = DXGI_FORMAT_R9G9B9E5_SHAREDEXP;
+	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	srvDesc.Texture2D.MipLevels = 1;
+	CD3DX12_CPU_DESCRIPTOR_HANDLE srvHandle(m_pDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), m_lightmapSet, m_descriptorSize);
+	m_pDevice->CreateShaderResourceView(m_pLightmap, &srvDesc, srvHandle);
+	return true;
+}
+
+bool BakedLighting::CreateIrradianceVolume(GraphicsCommandRecorder& _recorder, UINT64 _frameNumber)
+{
+	// one probe per texel, so the sampler's trilinear filter is the blend of the eight probes around a point
+	D3D12_RESOURCE_DESC textureDesc = CD3DX12_RESOURCE_DESC::Tex3D(DXGI_FORMAT_R16G16B16A16_FLOAT,
+		m_pendingVolumeDesc.countX, m_pendingVolumeDesc.countY, static_cast<UINT16>(m_pendingVolumeDesc.countZ), 1);
+	size_t texelCount = static_cast<size_t>(m_pendingVolumeDesc.countX) * m_pendingVolumeDesc.countY * m_pendingVolumeDesc.countZ;
+	for (UINT i = 0; i < IrradianceVolume::GPU_TEXTURE_COUNT; ++i)
+	{
+		if (!CreateTexture(_recorder, _frameNumber, textureDesc, m_pendingVolumeTexels.data() + i * texelCount * 4, L"Irradiance Volume Resource Heap", m_pVolume[i]))
+		{
+			return false;
+		}
+	}
+
+	m_volumeSet = (m_volumeSet + 1) % DESCRIPTOR_SETS;
+	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format = DXGI_FORMAT_R16G16B16A16_FLOAT;
+	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE3D;
+	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	srvDesc.Texture3D.MipLevels = 1;
+	for (UINT i = 0; i < IrradianceVolume::GPU_TEXTURE_COUNT; ++i)
+	{
+		CD3DX12_CPU_DESCRIPTOR_HANDLE srvHandle(m_pDescriptorHeap->GetCPUDescriptorHandleForHeapStart(),
+			DESCRIPTOR_SETS + m_volumeSet * IrradianceVolume::GPU_TEXTURE_COUNT + i, m_descriptorSize);
+		m_pDevice->CreateShaderResourceView(m_pVolume[i], &srvDesc, srvHandle);
+	}
+	return true;
+}
+
+bool BakedLighting::CreateTexture(GraphicsCommandRecorder& _recorder, UINT64 _frameNumber, const D3D12_RESOURCE_DESC& _desc, const void* _pTexels, const wchar_t* _name, ID3D12Resource*& _pTexture)
+{
+	HRESULT hr = m_pDevice->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+		D3D12_HEAP_FLAG_NONE,
+		&_desc,
+		D3D12_RESOURCE_STATE_COPY_DEST,
+		nullptr,
+		IID_PPV_ARGS(&_pTexture));
+	if (FAILED(hr))
+	{
+		return false;
+	}
+	_pTexture->SetName(_name);
+
+	// the upload buffer's rows are padded out to what the copy wants, so the texels go in a row at a time
+	D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint;
+	UINT rowCount;
+	UINT64 rowSize;
+	UINT64 uploadSize;
+	m_pDevice->GetCopyableFootprints(&_desc, 0, 1, 0, &footprint, &rowCount, &rowSize, &uploadSize);
+	ID3D12Resource* pUpload = nullptr;
+	hr = m_pDevice->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(uploadSize),
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(&pUpload));
+	if (FAILED(hr))
+	{
+		return false;
+	}
+	pUpload->SetName(L"Baked Lighting Upload Resource Heap");
+	UINT8* pData = nullptr;
+	CD3DX12_RANGE readRange(0, 0); // we never read it on the cpu
+	hr = pUpload->Map(0, &readRange, reinterpret_cast<void**>(&pData));
+	if (FAILED(hr))
+	{
+		pUpload->Release();
+		return false;
+	}
+	const UINT8* pSource = static_cast<const UINT8*>(_pTexels);
+	for (UINT slice = 0; slice < footprint.Footprint.Depth; ++slice)
+	{
+		for (UINT row = 0; row < rowCount; ++row)
+		{
+			UINT64 sourceRow = static_cast<UINT64>(slice) * rowCount + row;
+			memcpy(pData + footprint.Offset + sourceRow * footprint.Footprint.RowPitch, pSource + sourceRow * rowSize, static_cast<size_t>(rowSize));
+		}
+	}
+	pUpload->Unmap(0, nullptr);
+
+	// the copy goes out now, the transition with the frame's first batch of barriers
+	_recorder.FlushBarriers();
+	CD3DX12_TEXTURE_COPY_LOCATION destination(_pTexture, 0);
+	CD3DX12_TEXTURE_COPY_LOCATION source(pUpload, footprint);
+	_recorder.CommandList()->CopyTextureRegion(&destination, 0, 0, 0, &source, nullptr);
+	_recorder.Transition(_pTexture, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+	Retire(pUpload, _frameNumber + MAX_FRAMES);
+	return true;
+}
+
+void BakedLighting::Retire(ID3D12Resource* _pResource, UINT64 _releaseFrame)
+{
+	if (_pResource == nullptr)
+	{
+		return;
+	}
+	RetiredResource retired;
+	retired.pResource = _pResource;
+	retired.releaseFrame = _releaseFrame;
+	m_retired.push_back(retired);
+}
+
+void BakedLighting::Bind(GraphicsCommandRecorder& _recorder)
+{
+	ID3D12DescriptorHeap* ppHeaps[] = { m_pDescriptorHeap };
+	_recorder.CommandList()->SetDescriptorHeaps(_countof(ppHeaps), ppHeaps);
+	_recorder.SetGraphicsRoot32BitConstants(m_rootConstants, sizeof(BakedLightingConstants) / sizeof(UINT), &m_constants, 0);
+	_recorder.SetGraphicsRootDescriptorTable(m_rootLightmap, CD3DX12_GPU_DESCRIPTOR_HANDLE(m_pDescriptorHeap->GetGPUDescriptorHandleForHeapStart(), m_lightmapSet, m_descriptorSize));
+	_recorder.SetGraphicsRootDescriptorTable(m_rootVolume, CD3DX12_GPU_DESCRIPTOR_HANDLE(m_pDescriptorHeap->GetGPUDescriptorHandleForHeapStart(),
+		DESCRIPTOR_SETS + m_volumeSet * IrradianceVolume::GPU_TEXTURE_COUNT, m_descriptorSize));
+	// the shader only reads the charts when there are some
+	if (m_pCharts)
+		_recorder.SetGraphicsRootShaderResourceView(m_rootCharts, m_pCharts->GetGPUVirtualAddress());
+}
+
+D3D12_CPU_DESCRIPTOR_HANDLE BakedLighting::SharedViewCpu(UINT _index)
+{
+	UINT first = DESCRIPTOR_SETS * (1 + IrradianceVolume::GPU_TEXTURE_COUNT);
+	return CD3DX12_CPU_DESCRIPTOR_HANDLE(m_pDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), first + _index, m_descriptorSize);
+}
+
+D3D12_GPU_DESCRIPTOR_HANDLE BakedLighting::SharedViewGpu(UINT _index)
+{
+	UINT first = DESCRIPTOR_SETS * (1 + IrradianceVolume::GPU_TEXTURE_COUNT);
+	return CD3DX12_GPU_DESCRIPTOR_HANDLE(m_pDescriptorHeap->GetGPUDescriptorHandleForHeapStart(), first + _index, m_descriptorSize);
+}
+
+void BakedLighting::Release()
+{
+	for (RetiredResource& retired : m_retired)
+		retired.pResource->Release();
+	m_retired.clear();
+	if (m_pLightmap)
+		m_pLightmap->Release();
+	m_pLightmap = nullptr;
+	if (m_pCharts)
+		m_pCharts->Release();
+	m_pCharts = nullptr;
+	for (ID3D12Resource*& pTexture : m_pVolume)
+	{
+		if (pTexture)
+			pTexture->Release();
+		pTexture = nullptr;
+	}
+	if (m_pDescriptorHeap)
+		m_pDescriptorHeap->Release();
+	m_pDescriptorHeap = nullptr;
+	m_pDevice = nullptr;
+}
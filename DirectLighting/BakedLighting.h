@@ -0,0 +1,119 @@
+#pragma once
+#include <Windows.h>
+#include <D3d12.h>
+
+#include <string>
+#include <vector>
+
+#include "CommandRecorder.h"
+#include "IrradianceVolume.h"
+#include "LightmapBaker.h"
+#include "RootSignature.h"
+
+// the scene pixel shader's view of the baked lighting, as root constants at b2 (see BakedLighting.hlsli)
+struct BakedLightingConstants
+{
+	uint32_t lightmapChartCount; // 0 while there is no lightmap, the shader then lights everything from the clusters
+	float lightmapInvWidth;
+	float lightmapInvHeight;
+	uint32_t pad0;
+	DirectX::XMFLOAT3 volumeBoundsMin;
+	float pad1;
+	DirectX::XMFLOAT3 volumeBoundsMax;
+	float pad2;
+	DirectX::XMFLOAT3 volumeProbeCount; // 0 while there is no irradiance volume, the shader then uses the flat ambient
+	float pad3;
+};
+
+// gets a lightmap file made by LightmapBaker (in the renderer or with the tool's "-bake") and an IrradianceVolume's
+// probes to the scene's pixel shader. the lightmap holds the direct light on the surfaces it was baked for, the volume
+// the light bouncing around, which takes the place of the flat ambient everywhere inside it.
+//
+// LoadLightmap only reads the file. the next Update creates the texture, copies the texels into it on the frame's
+// command list and writes its view, so a lightmap can be loaded again at any time, e.g. after a bake. the charts go
+// into an upload buffer the shader reads through a root srv, and for every pixel it looks for a chart whose plane
+// and bounds the pixel lies in. a surface that has moved away from where it was baked finds none and is lit from the
+// clusters as before. LoadIrradianceVolume works the same way, its GpuTexels go into seven 3d textures.
+//
+// whatever a load replaces is kept until the gpu is done with it: its resources for MAX_FRAMES frames, and its views
+// because every load writes the next of DESCRIPTOR_SETS sets round its part of the heap.
+//
+// Bind sets its heap for the scene's draws, and only one heap can be set at a time, so the heap also has SHARED_VIEWS
+// places at the end for the views of other textures the scene's pixel shader reads, like the shadow map. whoever
+// uses one writes it once and binds it with a table of their own
+class BakedLighting
+{
+public:
+	static const UINT MAX_FRAMES = 3;
+	static const UINT DESCRIPTOR_SETS = MAX_FRAMES + 1;
+	static const UINT SHARED_VIEWS = 1;
+
+	BakedLighting() = default;
+	~BakedLighting() = default;
+
+	// the constants at b2, the lightmap's table at t4, its charts at t5 and the volume's table at t6 to t12, all for
+	// the pixel shader, and the linear clamp sampler at s0
+	void AddRootParameters(RootSignatureDesc& _rootSignatureDesc);
+
+	bool Init(ID3D12Device* _pDevice);
+
+	// reads the file, the lightmap is used from the next Update on. false if it is missing or not a lightmap, the
+	// one already in use then stays
+	bool LoadLightmap(const std::string& _fileName);
+
+	// copies the baked probes, the volume is used from the next Update on
+	void LoadIrradianceVolume(IrradianceVolume& _volume);
+
+	// call once a frame, before anything is drawn with the root signature AddRootParameters was given
+	void Update(GraphicsCommandRecorder& _recorder, UINT64 _frameNumber);
+
+	// sets the descriptor heap too, which a pass of its own may have changed
+	void Bind(GraphicsCommandRecorder& _recorder);
+
+	const BakedLightingConstants& Constants() { return m_constants; }
+
+	// where shared view _index is written and where a table reads it, see the class comment
+	D3D12_CPU_DESCRIPTOR_HANDLE SharedViewCpu(UINT _index);
+	D3D12_GPU_DESCRIPTOR_HANDLE SharedViewGpu(UINT _index);
+
+	void Release();
+
+private:
+	bool CreateLightmap(GraphicsCommandRecorder& _recorder, UINT64 _frameNumber);
+	bool CreateIrradianceVolume(GraphicsCommandRecorder& _recorder, UINT64 _frameNumber);
+	// a default heap texture with _pTexels copied into it on the frame's command list, rows and slices tightly packed
+	bool CreateTexture(GraphicsCommandRecorder& _recorder, UINT64 _frameNumber, const D3D12_RESOURCE_DESC& _desc, const void* _pTexels, const wchar_t* _name, ID3D12Resource*& _pTexture);
+	void Retire(ID3D12Resource* _pResource, UINT64 _releaseFrame);
+
+	struct RetiredResource
+	{
+		ID3D12Resource* pResource;
+		UINT64 releaseFrame;
+	};
+
+	ID3D12Device* m_pDevice = nullptr;
+	ID3D12DescriptorHeap* m_pDescriptorHeap = nullptr; // shader visible, DESCRIPTOR_SETS lightmap views, as many sets of volume views, then the shared views
+	UINT m_descriptorSize = 0;
+	UINT m_lightmapSet = 0;
+	UINT m_volumeSet = 0;
+
+	ID3D12Resource* m_pLightmap = nullptr;
+	ID3D12Resource* m_pCharts = nullptr; // LightmapFileCharts in an upload buffer
+	ID3D12Resource* m_pVolume[IrradianceVolume::GPU_TEXTURE_COUNT] = {};
+	std::vector<RetiredResource> m_retired;
+	BakedLightingConstants m_constants = {};
+
+	// what LoadLightmap read, until Update creates the resources for it
+	bool m_pendingLightmap = false;
+	LightmapBaker::FileHeader m_pendingHeader = {};
+	std::vector<uint32_t> m_pendingTexels;
+	std::vector<LightmapFileChart> m_pendingCharts;
+	bool m_pendingVolume = false;
+	IrradianceVolumeDesc m_pendingVolumeDesc;
+	std::vector<uint16_t> m_pendingVolumeTexels;
+
+	UINT m_rootConstants = 0;
+	UINT m_rootLightmap = 0;
+	UINT m_rootCharts = 0;
+	UINT m_rootVolume = 0;
+};
@@ -0,0 +1,69 @@
+// lighting a pixel from a lightmap LightmapBaker baked and an IrradianceVolume, see BakedLighting.h for how they get
+// here. the lightmap holds the irradiance from the lights and the sun with their shadows, the volume the irradiance of
+// the light bouncing off the scene, both in the same units as ClusteredDiffuse
+
+#include "IrradianceVolume.hlsli"
+
+// BakedLightingConstants in BakedLighting.h
+cbuffer BakedLightingConstants : register(b2)
+{
+	uint lightmapChartCount; // 0 while there is no lightmap
+	float lightmapInvWidth;
+	float lightmapInvHeight;
+	float3 volumeBoundsMin;
+	float3 volumeBoundsMax;
+	float3 volumeProbeCount; // 0 while there is no irradiance volume
+};
+
+// LightmapFileChart in LightmapBaker.h
+struct LightmapChart
+{
+	float3 axisU; // dot(position, axisU) - offsetU is the position's texel across the whole lightmap
+	float offsetU;
+	float3 axisV;
+	float offsetV;
+	float3 normal;
+	float planeDistance;
+	float3 boundsMin;
+	float pad0;
+	float3 boundsMax;
+	float pad1;
+};
+
+Texture2D<float3> lightmap : register(t4);
+StructuredBuffer<LightmapChart> lightmapCharts : register(t5);
+Texture3D<float4> irradianceVolume[IRRADIANCE_VOLUME_TEXTURES] : register(t6);
+SamplerState linearClamp : register(s0);
+
+#define LIGHTMAP_NORMAL_COSINE 0.98f // LightmapBaker's CHART_NORMAL_COSINE, the most a chart's triangles bend
+#define LIGHTMAP_TOLERANCE 0.01f // how far off a chart's plane and bounds a position rebuilt from depth may be
+
+// the baked irradiance at a world space position on a surface with the given normal. false when the position is on
+// no chart, because it was never baked or has moved since
+bool SampleLightmap(float3 position, float3 normal, out float3 irradiance)
+{
+	irradiance = 0.0f;
+	for (uint i = 0; i < lightmapChartCount; ++i)
+	{
+		LightmapChart chart = lightmapCharts[i];
+		if (dot(normal, chart.normal) < LIGHTMAP_NORMAL_COSINE || abs(dot(position, chart.normal) - chart.planeDistance) > LIGHTMAP_TOLERANCE)
+			continue;
+		if (any(position < chart.boundsMin - LIGHTMAP_TOLERANCE) || any(position > chart.boundsMax + LIGHTMAP_TOLERANCE))
+			continue;
+
+		float2 texel = float2(dot(position, chart.axisU) - chart.offsetU, dot(position, chart.axisV) - chart.offsetV);
+		irradiance = lightmap.SampleLevel(linearClamp, texel * float2(lightmapInvWidth, lightmapInvHeight), 0.0f);
+		return true;
+	}
+	return false;
+}
+
+// the light bouncing off the scene onto a surface at a world space position with the given normal, clamped to the
+// volume's bounds. the flat ambient when there is no volume
+float3 BouncedLight(float3 position, float3 normal, float3 ambient)
+{
+	if (volumeProbeCount.x == 0.0f)
+		return ambient;
+	float3 uvw = IrradianceVolumeUvw(position, volumeBoundsMin, volumeBoundsMax, volumeProbeCount);
+	return SampleIrradianceVolume(irradianceVolume, linearClamp, uvw, normal);
+}
@@ -0,0 +1,81 @@
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "AssetArchive.h"
+#include "Benchmark.h"
+#include "JobSystem.h"
+
+// AssetArchive reads over size MB, 64 by default, of assets a block long each, packed once with LzCodec and once
+// stored: the whole archive through ReadMany on the job system, then single blocks read one at a time in a random
+// order, the way a streamer asks for them. the file is read once before the timings, so they measure the mapping and
+// the decoder rather than the disk
+int main(int _argc, char* _argv[])
+{
+	unsigned int size = Benchmark::Size(_argc, _argv, 64);
+	JobSystem jobSystem;
+	jobSystem.Init();
+
+	// text that repeats with small changes, as an obj or a shader does, so it compresses to about what assets do
+	AssetPackDesc desc;
+	unsigned int assetCount = size * 1024 * 1024 / desc.blockSize;
+	std::vector<std::string> files(assetCount);
+	std::mt19937 random(1);
+	for (unsigned int i = 0; i < assetCount; ++i)
+	{
+		std::string text;
+		while (text.size() < desc.blockSize)
+			text += "v " + std::to_string(random() % 1000) + ".5 " + std::to_string(random() % 100) + " -1.25\n";
+		files[i] = "ArchiveBenchmark" + std::to_string(i) + ".obj";
+		std::ofstream(files[i], std::ios::binary).write(text.data(), desc.blockSize);
+	}
+	double bytes = static_cast<double>(assetCount) * desc.blockSize;
+
+	std::vector<uint32_t> assets(assetCount);
+	std::vector<uint32_t> order(assetCount * 4);
+	for (uint32_t& asset : order)
+		asset = random() % assetCount;
+	printf("%u assets of %u kb, %u threads\n", assetCount, desc.blockSize / 1024, jobSystem.ThreadCount());
+
+	for (bool compress : { true, false })
+	{
+		desc.compress = compress;
+		const char* packName = compress ? "ArchiveBenchmarkLz.pack" : "ArchiveBenchmarkStored.pack";
+		AssetPackStats stats;
+		if (!AssetArchive::Pack(files, packName, desc, &jobSystem, &stats))
+		{
+			printf("%s: could not pack\n", packName);
+			return 1;
+		}
+		AssetArchive archive;
+		if (!archive.Open(packName))
+		{
+			printf("%s: could not open\n", packName);
+			return 1;
+		}
+		for (unsigned int i = 0; i < assetCount; ++i)
+			assets[i] = archive.Find(files[i]);
+		printf("%s, %.1f mb packed into %.1f mb\n", compress ? "lz" : "stored", stats.size / 1048576.0, stats.packedSize / 1048576.0);
+
+		std::vector<std::vector<uint8_t>> data;
+		archive.ReadMany(assets.data(), assetCount, data, &jobSystem);
+		Benchmark::Run(compress ? "whole archive, lz" : "whole archive, stored", 5, [&]()
+		{
+			archive.ReadMany(assets.data(), assetCount, data, &jobSystem);
+		}, bytes);
+
+		std::vector<uint8_t> block;
+		Benchmark::Run(compress ? "random blocks, lz" : "random blocks, stored", 5, [&]()
+		{
+			for (uint32_t asset : order)
+				archive.Read(assets[asset], block);
+		}, static_cast<double>(order.size()) * desc.blockSize);
+		archive.Close();
+	}
+
+	for (const std::string& file : files)
+		std::remove(file.c_str());
+	return 0;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+
+// the benchmarks are plain programs like the tests. each takes how much work to do as its first argument, defaulting to
+// the size the request was measured at, and ctest runs them at a small size so they are built and run on every change
+namespace Benchmark
+{
+	// the first argument as a count, _default without one
+	inline unsigned int Size(int _argc, char* _argv[], unsigned int _default)
+	{
+		return _argc > 1 ? static_cast<unsigned int>(strtoul(_argv[1], nullptr, 10)) : _default;
+	}
+
+	// the fastest of _repeats runs of _func in milliseconds, printed with _name and _items per second when given
+	inline double Run(const char* _name, unsigned int _repeats, const std::function<void()>& _func, double _items = 0.0)
+	{
+		double best = 1e30;
+		for (unsigned int i = 0; i < _repeats; ++i)
+		{
+			std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+			_func();
+			best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+		}
+		if (_items > 0.0)
+			printf("%-40s %10.3f ms %10.2f M/s\n", _name, best, _items / best / 1000.0);
+		else
+			printf("%-40s %10.3f ms\n", _name, best);
+		return best;
+	}
+}
@@ -0,0 +1,80 @@
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "Benchmark.h"
+#include "CascadedShadows.h"
+#include "JobSystem.h"
+
+using namespace DirectX;
+
+// CascadedShadows::SetCasters and Cull with the renderer's camera, sun and four cascades over 100 units, for size
+// casters per cascade, 100k by default. each cascade's share is scattered through its slice of the view frustum, so
+// every cascade has about that many to test and keep, plus the ones it reaches of its neighbours'. the cull is timed
+// alone and together with SetCasters, which is what the renderer pays every frame
+int main(int _argc, char* _argv[])
+{
+	unsigned int perCascade = Benchmark::Size(_argc, _argv, 100000);
+	JobSystem jobSystem;
+	jobSystem.Init();
+
+	const float fov = 45.0f * (3.14f / 180.0f);
+	const float aspect = 1920.0f / 1080.0f;
+	XMFLOAT4X4 view, proj;
+	XMStoreFloat4x4(&view, XMMatrixLookAtLH(XMVectorSet(0.0f, 2.0f, -4.0f, 1.0f), XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)));
+	XMStoreFloat4x4(&proj, XMMatrixPerspectiveFovLH(fov, aspect, 0.1f, 1000.0f));
+	XMFLOAT3 sun;
+	XMStoreFloat3(&sun, XMVector3Normalize(XMVectorSet(0.3f, -1.0f, 0.4f, 0.0f)));
+
+	ShadowCascadeDesc desc;
+	desc.maxDistance = 100.0f;
+	CascadedShadows shadows;
+	shadows.Init(desc, proj);
+	shadows.Update(view, sun);
+
+	// view space positions inside the frustum, taken back to world space
+	XMMATRIX invView = XMMatrixInverse(nullptr, XMLoadFloat4x4(&view));
+	float tanHalfFov = std::tan(fov * 0.5f);
+	unsigned int count = perCascade * desc.cascadeCount;
+	std::vector<XMFLOAT4> spheres(count);
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		const ShadowCascade& cascade = shadows.Cascade(i % desc.cascadeCount);
+		float z = cascade.splitNear + (cascade.splitFar - cascade.splitNear) * unit(random);
+		float halfHeight = z * tanHalfFov;
+		XMVECTOR position = XMVectorSet(halfHeight * aspect * (2.0f * unit(random) - 1.0f), halfHeight * (2.0f * unit(random) - 1.0f), z, 1.0f);
+		XMStoreFloat4(&spheres[i], XMVector3TransformCoord(position, invView));
+		spheres[i].w = 0.1f + 0.9f * unit(random);
+	}
+
+	shadows.SetCasters(spheres.data(), count, &jobSystem);
+	shadows.Cull(&jobSystem);
+	printf("%u casters, %u workers\n", count, jobSystem.ThreadCount());
+	for (uint32_t cascade = 0; cascade < desc.cascadeCount; ++cascade)
+	{
+		const ShadowCascade& shadowCascade = shadows.Cascade(cascade);
+		printf("cascade %u, %.1f to %.1f: %zu casters\n", cascade, shadowCascade.splitNear, shadowCascade.splitFar, shadows.Casters(cascade).size());
+	}
+
+	Benchmark::Run("cull, one thread", 5, [&]()
+	{
+		shadows.Cull(nullptr);
+	}, count);
+	Benchmark::Run("cull, job system", 5, [&]()
+	{
+		shadows.Cull(&jobSystem);
+	}, count);
+	Benchmark::Run("set casters and cull, one thread", 5, [&]()
+	{
+		shadows.SetCasters(spheres.data(), count, nullptr);
+		shadows.Cull(nullptr);
+	}, count);
+	Benchmark::Run("set casters and cull, job system", 5, [&]()
+	{
+		shadows.SetCasters(spheres.data(), count, &jobSystem);
+		shadows.Cull(&jobSystem);
+	}, count);
+	return 0;
+}
@@ -0,0 +1,114 @@
+#include <random>
+#include <vector>
+
+#include "Benchmark.h"
+#include "IrradianceVolume.h"
+#include "JobSystem.h"
+#include "PathTracer.h"
+
+using namespace DirectX;
+
+namespace
+{
+	struct BenchmarkVertex
+	{
+		XMFLOAT3 position;
+		XMFLOAT4 color;
+	};
+}
+
+// IrradianceVolume over a lit floor, a million points by default. times the projection kernel over that many
+// directions, the bake of the default 8 x 4 x 8 volume, and the irradiance at that many points scattered through the
+// volume, each blending its eight probes and evaluating the blend, on one thread and on the job system
+int main(int _argc, char* _argv[])
+{
+	unsigned int count = Benchmark::Size(_argc, _argv, 1000000);
+	JobSystem jobSystem;
+	jobSystem.Init();
+	printf("%u points, %u workers\n", count, jobSystem.ThreadCount());
+
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::normal_distribution<float> gauss;
+	std::vector<XMFLOAT3> directions(count);
+	std::vector<XMFLOAT3> radiance(count);
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		XMStoreFloat3(&directions[i], XMVector3Normalize(XMVectorSet(gauss(random), gauss(random), gauss(random), 0.0f)));
+		radiance[i] = XMFLOAT3(unit(random), unit(random), unit(random));
+	}
+	ShCoefficients coefficients;
+	Benchmark::Run("project", 5, [&]()
+	{
+		IrradianceVolume::ProjectIrradiance(directions.data(), radiance.data(), count, coefficients);
+	}, count);
+
+	// a floor under the volume with a few lights on it and the sun
+	PathTracerDesc sceneDesc;
+	sceneDesc.width = 1;
+	sceneDesc.height = 1;
+	PathTracer scene;
+	scene.Init(sceneDesc);
+	const float extent = 20.0f;
+	BenchmarkVertex vertices[4] =
+	{
+		{ XMFLOAT3(-extent, -1.0f, -extent), XMFLOAT4(0.5f, 0.5f, 0.5f, 1.0f) },
+		{ XMFLOAT3(-extent, -1.0f, extent), XMFLOAT4(0.5f, 0.5f, 0.5f, 1.0f) },
+		{ XMFLOAT3(extent, -1.0f, extent), XMFLOAT4(0.5f, 0.5f, 0.5f, 1.0f) },
+		{ XMFLOAT3(extent, -1.0f, -extent), XMFLOAT4(0.5f, 0.5f, 0.5f, 1.0f) }
+	};
+	uint32_t indices[6] = { 0, 1, 2, 0, 2, 3 };
+	XMFLOAT4X4 identity;
+	XMStoreFloat4x4(&identity, XMMatrixIdentity());
+	scene.AddMesh(vertices, 4, sizeof(BenchmarkVertex), 0, sizeof(XMFLOAT3), indices, 6, identity);
+	std::vector<Light> lights(16);
+	for (Light& light : lights)
+	{
+		light.position = XMFLOAT3(-8.0f + 16.0f * unit(random), 2.0f * unit(random), -8.0f + 16.0f * unit(random));
+		light.range = 4.0f;
+		light.color = XMFLOAT3(unit(random), unit(random), unit(random));
+		light.type = LIGHT_POINT;
+		light.direction = XMFLOAT3(0.0f, 0.0f, 1.0f);
+		light.cosOuterAngle = -1.0f;
+	}
+	scene.SetLights(lights.data(), static_cast<uint32_t>(lights.size()));
+	scene.SetSun(XMFLOAT3(0.3f, -1.0f, 0.4f), XMFLOAT3(1.0f, 1.0f, 1.0f));
+	scene.Commit();
+
+	IrradianceVolume volume;
+	volume.Init(IrradianceVolumeDesc());
+	const IrradianceVolumeDesc& desc = volume.Desc();
+	Benchmark::Run("bake, job system", 3, [&]()
+	{
+		volume.Bake(scene, &jobSystem);
+	}, static_cast<double>(volume.ProbeCount()) * desc.samplesPerProbe);
+
+	std::vector<XMFLOAT3> positions(count);
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		positions[i] = XMFLOAT3(
+			desc.boundsMin.x + (desc.boundsMax.x - desc.boundsMin.x) * unit(random),
+			desc.boundsMin.y + (desc.boundsMax.y - desc.boundsMin.y) * unit(random),
+			desc.boundsMin.z + (desc.boundsMax.z - desc.boundsMin.z) * unit(random));
+	}
+	std::vector<XMFLOAT3> irradiance(count);
+	Benchmark::Run("eight probe irradiance, one thread", 5, [&]()
+	{
+		for (unsigned int i = 0; i < count; ++i)
+			irradiance[i] = volume.Irradiance(positions[i], directions[i]);
+	}, count);
+	Benchmark::Run("eight probe irradiance, job system", 5, [&]()
+	{
+		jobSystem.ParallelFor(count, 1024, [&](unsigned int _begin, unsigned int _end)
+		{
+			for (unsigned int i = _begin; i < _end; ++i)
+				irradiance[i] = volume.Irradiance(positions[i], directions[i]);
+		});
+	}, count);
+
+	double total = 0.0;
+	for (const XMFLOAT3& value : irradiance)
+		total += value.x + value.y + value.z;
+	printf("mean irradiance %.4f\n", total / (3.0 * count));
+	return 0;
+}
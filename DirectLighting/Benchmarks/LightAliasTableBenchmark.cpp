@@ -0,0 +1,67 @@
+#include <random>
+#include <vector>
+
+#include "Benchmark.h"
+#include "JobSystem.h"
+#include "LightAliasTable.h"
+
+using namespace DirectX;
+
+// LightAliasTable over a million emitters by default, a tenth of them off. times a full build on one thread and on the
+// job system, the rebuild after one light changes, and ten samples per light
+int main(int _argc, char* _argv[])
+{
+	unsigned int count = Benchmark::Size(_argc, _argv, 1000000);
+	JobSystem jobSystem;
+	jobSystem.Init();
+	printf("%u lights, %u workers\n", count, jobSystem.ThreadCount());
+
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::vector<Light> lights(count);
+	for (Light& light : lights)
+	{
+		float power = unit(random) < 0.1f ? 0.0f : 0.1f + 10.0f * unit(random) * unit(random);
+		light.position = XMFLOAT3(0.0f, 0.0f, 0.0f);
+		light.range = 1.0f;
+		light.color = XMFLOAT3(power, power, power);
+		light.type = LIGHT_POINT;
+		light.direction = XMFLOAT3(0.0f, 0.0f, 1.0f);
+		light.cosOuterAngle = -1.0f;
+	}
+
+	// a new table every time, so nothing is skipped as unchanged
+	Benchmark::Run("build, one thread", 5, [&]()
+	{
+		LightAliasTable table;
+		table.Build(lights.data(), count);
+	}, count);
+	LightAliasTable table;
+	Benchmark::Run("build, job system", 5, [&]()
+	{
+		table = LightAliasTable();
+		table.Build(lights.data(), count, &jobSystem);
+	}, count);
+
+	unsigned int changed = 0;
+	Benchmark::Run("rebuild after one light changed", 5, [&]()
+	{
+		lights[changed++ * 7919 % count].color.y += 1.0f;
+		table.Build(lights.data(), count, &jobSystem);
+	});
+	printf("%u of %u blocks rebuilt\n", table.RebuiltBlocks(), table.BlockCount());
+
+	const unsigned int samples = 10 * count;
+	unsigned int found = 0;
+	Benchmark::Run("sample", 3, [&]()
+	{
+		found = 0;
+		for (unsigned int i = 0; i < samples; ++i)
+		{
+			LightAliasSample sample;
+			found += table.Sample((i + 0.5f) / samples, unit(random), sample) ? 1 : 0;
+		}
+	}, samples);
+	printf("%.1f%% of the samples found a light\n", 100.0 * found / samples);
+	return 0;
+}
@@ -0,0 +1,73 @@
+#include <random>
+#include <vector>
+
+#include "Benchmark.h"
+#include "JobSystem.h"
+#include "LightBvh.h"
+
+using namespace DirectX;
+
+// LightBvh over 100k lights by default, scattered over a 200 unit square a few units deep, a third of them spots.
+// times the build and the refit on one thread and on the job system, then ten samples per light at points on the floor
+int main(int _argc, char* _argv[])
+{
+	unsigned int count = Benchmark::Size(_argc, _argv, 100000);
+	JobSystem jobSystem;
+	jobSystem.Init();
+	printf("%u lights, %u workers\n", count, jobSystem.ThreadCount());
+
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> spread(-100.0f, 100.0f);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::vector<Light> lights(count);
+	for (Light& light : lights)
+	{
+		light.position = XMFLOAT3(spread(random), 5.0f * unit(random), spread(random));
+		light.range = 1.0f + 9.0f * unit(random);
+		light.color = XMFLOAT3(unit(random), unit(random), unit(random));
+		light.type = unit(random) < 0.3f ? LIGHT_SPOT : LIGHT_POINT;
+		XMStoreFloat3(&light.direction, XMVector3Normalize(XMVectorSet(spread(random), -100.0f, spread(random), 0.0f)));
+		light.cosOuterAngle = light.type == LIGHT_SPOT ? 0.7f : -1.0f;
+	}
+
+	LightBvh bvh;
+	Benchmark::Run("build, one thread", 5, [&]()
+	{
+		bvh.Build(lights.data(), count);
+	}, count);
+	Benchmark::Run("build, job system", 5, [&]()
+	{
+		bvh.Build(lights.data(), count, &jobSystem);
+	}, count);
+
+	// every light drifts a little each frame
+	std::vector<Light> moved = lights;
+	for (Light& light : moved)
+		light.position.y += 0.1f;
+	Benchmark::Run("refit, one thread", 5, [&]()
+	{
+		bvh.Refit(moved.data());
+	}, count);
+	Benchmark::Run("refit, job system", 5, [&]()
+	{
+		bvh.Refit(moved.data(), &jobSystem);
+	}, count);
+
+	const unsigned int samples = 10 * count;
+	std::vector<XMFLOAT3> positions(1024);
+	for (XMFLOAT3& position : positions)
+		position = XMFLOAT3(spread(random), 0.0f, spread(random));
+	const XMFLOAT3 normal(0.0f, 1.0f, 0.0f);
+	unsigned int found = 0;
+	Benchmark::Run("sample", 3, [&]()
+	{
+		found = 0;
+		for (unsigned int i = 0; i < samples; ++i)
+		{
+			LightBvhSample sample;
+			found += bvh.Sample(positions[i % positions.size()], normal, (i + 0.5f) / samples, sample) ? 1 : 0;
+		}
+	}, samples);
+	printf("%.1f%% of the samples found a light, %zu nodes\n", 100.0 * found / samples, bvh.Nodes().size());
+	return 0;
+}
@@ -0,0 +1,66 @@
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "Benchmark.h"
+#include "JobSystem.h"
+#include "LightClusters.h"
+
+using namespace DirectX;
+
+// LightClusters::Build at 1920x1080 with the renderer's camera and cluster grid, over 10k lights by default. the lights
+// fill the first 60 units in front of the camera, a quarter of them spots. besides the build times it prints how many
+// lights the pixel shader loops over per cluster and how big the index list gets against what ClusteredLighting uploads
+int main(int _argc, char* _argv[])
+{
+	unsigned int count = Benchmark::Size(_argc, _argv, 10000);
+	JobSystem jobSystem;
+	jobSystem.Init();
+
+	XMFLOAT4X4 view, proj;
+	XMStoreFloat4x4(&view, XMMatrixLookAtLH(XMVectorSet(0.0f, 2.0f, -4.0f, 1.0f), XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)));
+	XMStoreFloat4x4(&proj, XMMatrixPerspectiveFovLH(45.0f * (3.14f / 180.0f), 1920.0f / 1080.0f, 0.1f, 1000.0f));
+	LightClusterDesc desc;
+	desc.screenWidth = 1920;
+	desc.screenHeight = 1080;
+	LightClusters clusters;
+	clusters.Init(desc, proj);
+	printf("%u lights, %u x %u x %u clusters, %u workers\n", count, clusters.ClustersX(), clusters.ClustersY(), clusters.ClustersZ(), jobSystem.ThreadCount());
+
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::vector<Light> lights(count);
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		Light& light = lights[i];
+		float z = 60.0f * unit(random);
+		float halfWidth = 1.0f + z * 0.45f;
+		light.position = XMFLOAT3(halfWidth * (2.0f * unit(random) - 1.0f), 4.0f * unit(random) - 1.0f, z);
+		light.range = 0.5f + 2.5f * unit(random);
+		light.color = XMFLOAT3(1.0f, 1.0f, 1.0f);
+		light.type = i % 4 == 3 ? LIGHT_SPOT : LIGHT_POINT;
+		light.direction = XMFLOAT3(0.0f, -1.0f, 0.0f);
+		light.cosOuterAngle = light.type == LIGHT_SPOT ? 0.7f : -1.0f;
+	}
+
+	Benchmark::Run("build, one thread", 5, [&]()
+	{
+		clusters.Build(lights.data(), count, view, nullptr);
+	}, count);
+	Benchmark::Run("build, job system", 5, [&]()
+	{
+		clusters.Build(lights.data(), count, view, &jobSystem);
+	}, count);
+
+	uint32_t busiest = 0;
+	uint32_t lit = 0;
+	for (const LightCluster& cluster : clusters.Clusters())
+	{
+		busiest = std::max(busiest, cluster.count);
+		lit += cluster.count > 0 ? 1 : 0;
+	}
+	size_t indices = clusters.LightIndices().size();
+	printf("%zu indices (%.1f%% of the 1M uploaded), %.1f lights per lit cluster, %u at most\n",
+		indices, 100.0 * indices / (1 << 20), lit > 0 ? static_cast<double>(indices) / lit : 0.0, busiest);
+	return 0;
+}
@@ -0,0 +1,186 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "Benchmark.h"
+#include "JobSystem.h"
+#include "MeshImporter.h"
+
+using namespace DirectX;
+
+namespace
+{
+	const uint32_t GRID_WIDTH = 2048; // vertices along a row of the generated grid
+
+	// a wavy grid as an obj of about _megabytes, each row's v, vt and vn lines followed by the quads joining it to the
+	// row before. returns the vertex count
+	uint32_t WriteObj(const std::string& _fileName, uint64_t _megabytes)
+	{
+		std::ofstream file(_fileName, std::ios::binary);
+		std::string text;
+		char line[160];
+		uint64_t written = 0;
+		uint32_t rows = 0;
+		while (written < (_megabytes << 20) || rows < 2)
+		{
+			text.clear();
+			for (uint32_t x = 0; x < GRID_WIDTH; ++x)
+			{
+				float height = 0.05f * static_cast<float>((x * 7 + rows * 13) % 17);
+				text.append(line, snprintf(line, sizeof(line), "v %.4f %.4f %.6f\n", x * 0.01f, rows * 0.01f, height));
+				text.append(line, snprintf(line, sizeof(line), "vt %.5f %.5f\n", x / static_cast<float>(GRID_WIDTH), rows / 1024.0f));
+				text.append(line, snprintf(line, sizeof(line), "vn %.4f %.4f 0.9950\n", 0.07f * (x % 3), -0.07f * (rows % 3)));
+			}
+			if (rows > 0)
+			{
+				for (uint32_t x = 0; x + 1 < GRID_WIDTH; ++x)
+				{
+					uint32_t a = (rows - 1) * GRID_WIDTH + x + 1;
+					uint32_t b = a + GRID_WIDTH;
+					text.append(line, snprintf(line, sizeof(line), "f %u/%u/%u %u/%u/%u %u/%u/%u %u/%u/%u\n", a, a, a, b, b, b, b + 1, b + 1, b + 1, a + 1, a + 1, a + 1));
+				}
+			}
+			file.write(text.data(), text.size());
+			written += text.size();
+			++rows;
+		}
+		return rows * GRID_WIDTH;
+	}
+
+	// the same grid as a glb: float positions, normals and uvs and 32 bit indices in one binary chunk
+	uint64_t WriteGlb(const std::string& _fileName, uint32_t _vertexCount)
+	{
+		uint32_t rows = _vertexCount / GRID_WIDTH;
+		uint32_t indexCount = (rows - 1) * (GRID_WIDTH - 1) * 6;
+		uint64_t positionBytes = static_cast<uint64_t>(_vertexCount) * 12;
+		uint64_t uvBytes = static_cast<uint64_t>(_vertexCount) * 8;
+		uint64_t indexBytes = static_cast<uint64_t>(indexCount) * 4;
+		uint64_t binaryBytes = positionBytes * 2 + uvBytes + indexBytes;
+
+		std::string json = "{\"asset\":{\"version\":\"2.0\"},\"scene\":0,\"scenes\":[{\"nodes\":[0]}],\"nodes\":[{\"mesh\":0}],"
+			"\"meshes\":[{\"primitives\":[{\"attributes\":{\"POSITION\":0,\"NORMAL\":1,\"TEXCOORD_0\":2},\"indices\":3}]}],"
+			"\"buffers\":[{\"byteLength\":" + std::to_string(binaryBytes) + "}],\"bufferViews\":[" +
+			"{\"buffer\":0,\"byteOffset\":0,\"byteLength\":" + std::to_string(positionBytes) + "}," +
+			"{\"buffer\":0,\"byteOffset\":" + std::to_string(positionBytes) + ",\"byteLength\":" + std::to_string(positionBytes) + "}," +
+			"{\"buffer\":0,\"byteOffset\":" + std::to_string(positionBytes * 2) + ",\"byteLength\":" + std::to_string(uvBytes) + "}," +
+			"{\"buffer\":0,\"byteOffset\":" + std::to_string(positionBytes * 2 + uvBytes) + ",\"byteLength\":" + std::to_string(indexBytes) + "}]," +
+			"\"accessors\":[{\"bufferView\":0,\"componentType\":5126,\"count\":" + std::to_string(_vertexCount) + ",\"type\":\"VEC3\"}," +
+			"{\"bufferView\":1,\"componentType\":5126,\"count\":" + std::to_string(_vertexCount) + ",\"type\":\"VEC3\"}," +
+			"{\"bufferView\":2,\"componentType\":5126,\"count\":" + std::to_string(_vertexCount) + ",\"type\":\"VEC2\"}," +
+			"{\"bufferView\":3,\"componentType\":5125,\"count\":" + std::to_string(indexCount) + ",\"type\":\"SCALAR\"}]}";
+		while (json.size() % 4 != 0)
+			json += ' ';
+
+		std::ofstream file(_fileName, std::ios::binary);
+		uint32_t header[3] = { 0x46546c67, 2, static_cast<uint32_t>(12 + 8 + json.size() + 8 + binaryBytes) };
+		uint32_t jsonChunk[2] = { static_cast<uint32_t>(json.size()), 0x4e4f534a };
+		uint32_t binaryChunk[2] = { static_cast<uint32_t>(binaryBytes), 0x004e4942 };
+		file.write(reinterpret_cast<const char*>(header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(jsonChunk), sizeof(jsonChunk));
+		file.write(json.data(), json.size());
+		file.write(reinterpret_cast<const char*>(binaryChunk), sizeof(binaryChunk));
+
+		// a row at a time, so nothing the size of the file is ever held
+		std::vector<float> row(GRID_WIDTH * 3);
+		for (uint32_t y = 0; y < rows; ++y)
+		{
+			for (uint32_t x = 0; x < GRID_WIDTH; ++x)
+			{
+				row[x * 3 + 0] = x * 0.01f;
+				row[x * 3 + 1] = y * 0.01f;
+				row[x * 3 + 2] = 0.05f * static_cast<float>((x * 7 + y * 13) % 17);
+			}
+			file.write(reinterpret_cast<const char*>(row.data()), GRID_WIDTH * 12);
+		}
+		for (uint32_t y = 0; y < rows; ++y)
+		{
+			for (uint32_t x = 0; x < GRID_WIDTH; ++x)
+			{
+				row[x * 3 + 0] = 0.0f;
+				row[x * 3 + 1] = 0.0f;
+				row[x * 3 + 2] = 1.0f;
+			}
+			file.write(reinterpret_cast<const char*>(row.data()), GRID_WIDTH * 12);
+		}
+		for (uint32_t y = 0; y < rows; ++y)
+		{
+			for (uint32_t x = 0; x < GRID_WIDTH; ++x)
+			{
+				row[x * 2 + 0] = x / static_cast<float>(GRID_WIDTH);
+				row[x * 2 + 1] = y / 1024.0f;
+			}
+			file.write(reinterpret_cast<const char*>(row.data()), GRID_WIDTH * 8);
+		}
+		std::vector<uint32_t> quads((GRID_WIDTH - 1) * 6);
+		for (uint32_t y = 0; y + 1 < rows; ++y)
+		{
+			for (uint32_t x = 0; x + 1 < GRID_WIDTH; ++x)
+			{
+				uint32_t a = y * GRID_WIDTH + x;
+				uint32_t b = a + GRID_WIDTH;
+				const uint32_t quad[6] = { a, b, b + 1, a, b + 1, a + 1 };
+				memcpy(&quads[x * 6], quad, sizeof(quad));
+			}
+			file.write(reinterpret_cast<const char*>(quads.data()), quads.size() * 4);
+		}
+		return 12 + 8 + json.size() + 8 + binaryBytes;
+	}
+
+	double Megabytes(uint64_t _bytes) { return _bytes / (1024.0 * 1024.0); }
+}
+
+// MeshImporter on a generated grid written as an obj of 2 GB by default (the first argument, in megabytes), and the
+// same grid as a glb. times the obj on one thread and on the job system, then the glb on the job system, and prints
+// where the time went. the throughput is in millions of bytes of file per second. the files are written to the working
+// folder and deleted again; at the default size the import needs about 2 GB of memory on top of the page cache
+int main(int _argc, char* _argv[])
+{
+	unsigned int megabytes = Benchmark::Size(_argc, _argv, 2048);
+	JobSystem jobSystem;
+	jobSystem.Init();
+
+	const std::string objFile = "MeshImporterBenchmark.obj";
+	const std::string glbFile = "MeshImporterBenchmark.glb";
+	uint32_t vertexCount = WriteObj(objFile, megabytes);
+	std::ifstream objSize(objFile, std::ios::binary | std::ios::ate);
+	uint64_t objBytes = static_cast<uint64_t>(objSize.tellg());
+	objSize.close();
+	uint64_t glbBytes = WriteGlb(glbFile, vertexCount);
+	printf("%u vertices, obj %.1f MB, glb %.1f MB, %u workers\n", vertexCount, Megabytes(objBytes), Megabytes(glbBytes), jobSystem.ThreadCount());
+
+	MeshImporter importer;
+	ImportedMesh mesh;
+	bool loaded = true;
+	Benchmark::Run("obj, one thread", 2, [&]()
+	{
+		loaded = importer.Load(objFile, mesh) && loaded;
+	}, static_cast<double>(objBytes));
+	Benchmark::Run("obj, job system", 3, [&]()
+	{
+		loaded = importer.Load(objFile, mesh, &jobSystem) && loaded;
+	}, static_cast<double>(objBytes));
+	const MeshImportStats& objStats = importer.Stats();
+	printf("obj: %u corners welded to %u vertices, read %.1f ms, parse %.1f ms, weld %.1f ms\n",
+		objStats.corners, objStats.vertices, objStats.readMs, objStats.parseMs, objStats.weldMs);
+	loaded = loaded && mesh.vertices.size() == vertexCount;
+
+	Benchmark::Run("glb, job system", 3, [&]()
+	{
+		loaded = importer.Load(glbFile, mesh, &jobSystem) && loaded;
+	}, static_cast<double>(glbBytes));
+	const MeshImportStats& glbStats = importer.Stats();
+	printf("glb: %u corners welded to %u vertices, read %.1f ms, parse %.1f ms, weld %.1f ms\n",
+		glbStats.corners, glbStats.vertices, glbStats.readMs, glbStats.parseMs, glbStats.weldMs);
+	loaded = loaded && mesh.vertices.size() == vertexCount;
+
+	std::remove(objFile.c_str());
+	std::remove(glbFile.c_str());
+	if (!loaded)
+	{
+		printf("an import failed\n");
+		return 1;
+	}
+	return 0;
+}
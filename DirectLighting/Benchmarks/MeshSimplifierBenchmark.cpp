@@ -0,0 +1,126 @@
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "Benchmark.h"
+#include "Culling.h"
+#include "JobSystem.h"
+#include "MeshImporter.h"
+#include "MeshSimplifier.h"
+
+using namespace DirectX;
+
+namespace
+{
+	const uint32_t INSTANCE_COUNT = 1000000; // objects the lod selection picks a level for
+}
+
+// MeshSimplifier on a bumpy sphere of 512 rings by default (the first argument), twice as many segments, so about a
+// million triangles. times one level at half the triangles, then the default four level chain on one thread and
+// on the job system, and last picking a level of that chain for a million instances scattered around the camera, the
+// per object cost of Culling::SelectLod in the culling pass
+int main(int _argc, char* _argv[])
+{
+	unsigned int rings = Benchmark::Size(_argc, _argv, 512);
+	unsigned int segments = rings * 2;
+	JobSystem jobSystem;
+	jobSystem.Init();
+
+	ImportedMesh mesh;
+	for (unsigned int ring = 0; ring <= rings; ++ring)
+	{
+		float theta = 3.14159265f * ring / rings;
+		for (unsigned int segment = 0; segment < segments; ++segment)
+		{
+			float phi = 2.0f * 3.14159265f * segment / segments;
+			float radius = 1.0f + 0.02f * std::sin(theta * 12.0f) * std::cos(phi * 9.0f);
+			MeshVertex vertex;
+			vertex.normal = XMFLOAT3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+			vertex.position = XMFLOAT3(vertex.normal.x * radius, vertex.normal.y * radius, vertex.normal.z * radius);
+			vertex.uv = XMFLOAT2(static_cast<float>(segment) / segments, static_cast<float>(ring) / rings);
+			vertex.color = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
+			mesh.vertices.push_back(vertex);
+		}
+	}
+	for (unsigned int ring = 0; ring < rings; ++ring)
+	{
+		for (unsigned int segment = 0; segment < segments; ++segment)
+		{
+			uint32_t a = ring * segments + segment;
+			uint32_t b = ring * segments + (segment + 1) % segments;
+			const uint32_t quad[6] = { a, b, b + segments, a, b + segments, a + segments };
+			mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+		}
+	}
+	mesh.boundsMin = XMFLOAT3(-1.02f, -1.02f, -1.02f);
+	mesh.boundsMax = XMFLOAT3(1.02f, 1.02f, 1.02f);
+	uint32_t indexCount = static_cast<uint32_t>(mesh.indices.size());
+	printf("%u triangles, %u workers\n", indexCount / 3, jobSystem.ThreadCount());
+
+	std::vector<uint32_t> half;
+	float error = 0.0f;
+	Benchmark::Run("one level at half", 3, [&]()
+	{
+		error = MeshSimplifier::Simplify(mesh.indices.data(), indexCount, mesh.vertices.data(), static_cast<uint32_t>(mesh.vertices.size()),
+			indexCount / 2, 1.0f, half);
+	}, indexCount / 3.0);
+	printf("%u triangles, error %g\n", static_cast<uint32_t>(half.size() / 3), error);
+
+	std::vector<MeshLodLevel> levels;
+	Benchmark::Run("lod chain, one thread", 3, [&]()
+	{
+		MeshSimplifier::GenerateLods(mesh, MeshLodDesc(), levels);
+	}, indexCount / 3.0);
+	Benchmark::Run("lod chain, job system", 3, [&]()
+	{
+		MeshSimplifier::GenerateLods(mesh, MeshLodDesc(), levels, &jobSystem);
+	}, indexCount / 3.0);
+	for (size_t lod = 0; lod < levels.size(); ++lod)
+		printf("lod %u: %u triangles, error %g\n", static_cast<uint32_t>(lod), static_cast<uint32_t>(levels[lod].indices.size() / 3), levels[lod].error);
+
+	// instances up to 200 units away at scales from half to twice the mesh, seen at 1080p through a 45 degree lens
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::vector<XMFLOAT4X4> worlds(INSTANCE_COUNT);
+	std::vector<XMFLOAT4> spheres(INSTANCE_COUNT);
+	for (uint32_t i = 0; i < INSTANCE_COUNT; ++i)
+	{
+		XMMATRIX world = XMMatrixScaling(0.5f + 1.5f * unit(random), 0.5f + 1.5f * unit(random), 0.5f + 1.5f * unit(random)) *
+			XMMatrixTranslation(400.0f * unit(random) - 200.0f, 20.0f * unit(random), 400.0f * unit(random) - 200.0f);
+		XMStoreFloat4x4(&worlds[i], world);
+		spheres[i] = Culling::BoundingSphere(worlds[i], 1.02f);
+	}
+	std::vector<float> errors(levels.size());
+	for (size_t lod = 0; lod < levels.size(); ++lod)
+		errors[lod] = levels[lod].error;
+	uint32_t lodCount = static_cast<uint32_t>(levels.size());
+	const XMFLOAT3 eye(0.0f, 2.0f, 0.0f);
+	const float pixelsPerUnit = 1.0f / std::tan(3.14159265f / 8.0f) * 540.0f;
+	std::vector<uint32_t> selected(INSTANCE_COUNT);
+	Benchmark::Run("select lod, one thread", 10, [&]()
+	{
+		for (uint32_t i = 0; i < INSTANCE_COUNT; ++i)
+			selected[i] = Culling::SelectLod(errors.data(), sizeof(float), lodCount, worlds[i], spheres[i], eye, pixelsPerUnit, 1.0f);
+	}, INSTANCE_COUNT);
+	Benchmark::Run("select lod, job system", 10, [&]()
+	{
+		jobSystem.ParallelFor(INSTANCE_COUNT, 4096, [&](unsigned int _begin, unsigned int _end)
+		{
+			for (unsigned int i = _begin; i < _end; ++i)
+				selected[i] = Culling::SelectLod(errors.data(), sizeof(float), lodCount, worlds[i], spheres[i], eye, pixelsPerUnit, 1.0f);
+		});
+	}, INSTANCE_COUNT);
+
+	// what the selection saved, the way the renderer reports it
+	std::vector<uint32_t> perLevel(lodCount, 0);
+	uint64_t saved = 0;
+	for (uint32_t lod : selected)
+	{
+		perLevel[lod]++;
+		saved += (levels[0].indices.size() - levels[lod].indices.size()) / 3;
+	}
+	for (uint32_t lod = 0; lod < lodCount; ++lod)
+		printf("lod %u picked %u times\n", lod, perLevel[lod]);
+	printf("%.1f triangles saved per instance\n", static_cast<double>(saved) / INSTANCE_COUNT);
+	return 0;
+}
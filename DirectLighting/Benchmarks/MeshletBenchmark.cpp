@@ -0,0 +1,122 @@
+#include <cmath>
+#include <vector>
+
+#include "Benchmark.h"
+#include "Culling.h"
+#include "DepthPyramid.h"
+#include "JobSystem.h"
+#include "MeshOptimizer.h"
+#include "MeshletBuilder.h"
+#include "MeshletCulling.h"
+
+using namespace DirectX;
+
+namespace
+{
+	const uint32_t SCREEN_WIDTH = 1920;
+	const uint32_t SCREEN_HEIGHT = 1080;
+}
+
+// MeshletBuilder and MeshletCuller on a unit sphere of 1024 rings by default (the first argument), twice as many
+// segments, so four million triangles, in cache order. times the build, then culling every meshlet against a camera
+// that sees part of the sphere, with the frustum and cone tests alone and with a depth pyramid hiding the left half
+// of the screen, and building that pyramid at 1080p, on one thread and on the job system
+int main(int _argc, char* _argv[])
+{
+	unsigned int rings = Benchmark::Size(_argc, _argv, 1024);
+	unsigned int segments = rings * 2;
+	JobSystem jobSystem;
+	jobSystem.Init();
+
+	std::vector<XMFLOAT3> positions;
+	for (unsigned int ring = 0; ring <= rings; ++ring)
+	{
+		float theta = 3.14159265f * ring / rings;
+		for (unsigned int segment = 0; segment < segments; ++segment)
+		{
+			float phi = 2.0f * 3.14159265f * segment / segments;
+			positions.push_back(XMFLOAT3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi)));
+		}
+	}
+	std::vector<uint32_t> indices;
+	for (unsigned int ring = 0; ring < rings; ++ring)
+	{
+		for (unsigned int segment = 0; segment < segments; ++segment)
+		{
+			uint32_t a = ring * segments + segment;
+			uint32_t b = ring * segments + (segment + 1) % segments;
+			const uint32_t quad[6] = { a, b, b + segments, a, b + segments, a + segments };
+			indices.insert(indices.end(), quad, quad + 6);
+		}
+	}
+	uint32_t indexCount = static_cast<uint32_t>(indices.size());
+	uint32_t vertexCount = static_cast<uint32_t>(positions.size());
+	MeshOptimizer::OptimizeVertexCache(indices.data(), indexCount, vertexCount);
+	printf("%u triangles, %u workers\n", indexCount / 3, jobSystem.ThreadCount());
+
+	MeshletData data;
+	Benchmark::Run("build", 3, [&]()
+	{
+		MeshletBuilder::Build(indices.data(), indexCount, &positions[0].x, sizeof(XMFLOAT3), vertexCount, data);
+	}, indexCount / 3.0);
+	uint32_t meshletCount = static_cast<uint32_t>(data.meshlets.size());
+	printf("%u meshlets, %.1f triangles each\n", meshletCount, indexCount / 3.0 / meshletCount);
+
+	MeshletCuller culler;
+	Benchmark::Run("init", 5, [&]()
+	{
+		culler.Init(data.meshlets.data(), meshletCount);
+	}, meshletCount);
+
+	// close enough that the frustum cuts the sphere, from a little above
+	MeshletCullParams params;
+	XMStoreFloat4x4(&params.world, XMMatrixScaling(2.0f, 2.0f, 2.0f) * XMMatrixRotationY(0.3f));
+	params.cameraPosition = XMFLOAT3(0.0f, 1.0f, -3.5f);
+	XMMATRIX proj = XMMatrixPerspectiveFovLH(0.8f, static_cast<float>(SCREEN_WIDTH) / SCREEN_HEIGHT, 0.1f, 100.0f);
+	XMMATRIX view = XMMatrixLookAtLH(XMLoadFloat3(&params.cameraPosition), XMVectorZero(), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+	XMStoreFloat4x4(&params.occlusionViewProj, view * proj);
+	Culling::ExtractFrustum(params.occlusionViewProj, params.frustum);
+
+	Benchmark::Run("frustum and cone, one thread", 20, [&]()
+	{
+		culler.Cull(params);
+	}, meshletCount);
+	Benchmark::Run("frustum and cone, job system", 20, [&]()
+	{
+		culler.Cull(params, &jobSystem);
+	}, meshletCount);
+	MeshletCullStats stats = culler.Stats();
+	printf("%u outside, %u backfacing, %u visible\n", stats.frustumCulled, stats.backfaceCulled, static_cast<uint32_t>(culler.Visible().size()));
+
+	// a wall just in front of the camera over the left half of the screen, nothing over the right
+	XMFLOAT4 wall;
+	XMStoreFloat4(&wall, XMVector4Transform(XMVectorSet(0.0f, 0.0f, 1.0f, 1.0f), proj));
+	std::vector<float> depth(SCREEN_WIDTH * SCREEN_HEIGHT, 1.0f);
+	for (uint32_t y = 0; y < SCREEN_HEIGHT; ++y)
+	{
+		for (uint32_t x = 0; x < SCREEN_WIDTH / 2; ++x)
+			depth[y * SCREEN_WIDTH + x] = wall.z / wall.w;
+	}
+	DepthPyramid pyramid;
+	Benchmark::Run("pyramid, one thread", 10, [&]()
+	{
+		pyramid.Build(depth.data(), SCREEN_WIDTH, SCREEN_HEIGHT);
+	}, SCREEN_WIDTH * SCREEN_HEIGHT);
+	Benchmark::Run("pyramid, job system", 10, [&]()
+	{
+		pyramid.Build(depth.data(), SCREEN_WIDTH, SCREEN_HEIGHT, &jobSystem);
+	}, SCREEN_WIDTH * SCREEN_HEIGHT);
+
+	params.pOcclusion = &pyramid;
+	Benchmark::Run("with occlusion, one thread", 20, [&]()
+	{
+		culler.Cull(params);
+	}, meshletCount);
+	Benchmark::Run("with occlusion, job system", 20, [&]()
+	{
+		culler.Cull(params, &jobSystem);
+	}, meshletCount);
+	stats = culler.Stats();
+	printf("%u occluded, %u visible\n", stats.occlusionCulled, static_cast<uint32_t>(culler.Visible().size()));
+	return 0;
+}
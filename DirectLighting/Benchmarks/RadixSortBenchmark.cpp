@@ -0,0 +1,52 @@
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "Benchmark.h"
+#include "JobSystem.h"
+#include "RadixSort.h"
+
+// RadixSort64 against std::stable_sort over the same keys, 1M by default. random keys need every pass, keys shaped
+// like SortKey's skip most of them
+int main(int _argc, char* _argv[])
+{
+	unsigned int count = Benchmark::Size(_argc, _argv, 1000000);
+	JobSystem jobSystem;
+	jobSystem.Init();
+	printf("%u keys, %u workers\n", count, jobSystem.ThreadCount());
+
+	const char* patternNames[] = { "random", "draw keys" };
+	for (int pattern = 0; pattern < 2; ++pattern)
+	{
+		std::mt19937_64 random(pattern);
+		std::vector<uint64_t> source(count);
+		for (uint64_t& key : source)
+			key = pattern == 0 ? random() : ((random() % 4) << 60 | (random() % 16) << 48 | (random() & 0xFFFFFFFF));
+
+		std::vector<uint64_t> keys(count), tempKeys(count);
+		std::vector<uint32_t> values(count), tempValues(count);
+		std::vector<std::pair<uint64_t, uint32_t>> pairs(count);
+		printf("%s:\n", patternNames[pattern]);
+		Benchmark::Run("  std::stable_sort", 3, [&]()
+		{
+			for (unsigned int i = 0; i < count; ++i)
+				pairs[i] = std::make_pair(source[i], i);
+			std::stable_sort(pairs.begin(), pairs.end(),
+				[](const std::pair<uint64_t, uint32_t>& _a, const std::pair<uint64_t, uint32_t>& _b) { return _a.first < _b.first; });
+		}, count);
+
+		JobSystem* pJobSystems[] = { nullptr, &jobSystem };
+		const char* runNames[] = { "  radix, one thread", "  radix, job system" };
+		for (int run = 0; run < 2; ++run)
+		{
+			Benchmark::Run(runNames[run], 3, [&]()
+			{
+				keys = source;
+				for (unsigned int i = 0; i < count; ++i)
+					values[i] = i;
+				RadixSort64(keys.data(), values.data(), tempKeys.data(), tempValues.data(), count, pJobSystems[run]);
+			}, count);
+		}
+	}
+	return 0;
+}
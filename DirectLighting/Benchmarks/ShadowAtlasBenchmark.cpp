@@ -0,0 +1,70 @@
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "Benchmark.h"
+#include "ShadowAtlas.h"
+
+// ShadowAtlas::Update once a frame with one request per light face, over 256 lights by default with every fourth a spot
+// and the rest point lights asking for six faces. times a frame where every light drifts a little in size and a third
+// of them see moving casters, and one where nothing changes, and prints how many tiles were rendered
+int main(int _argc, char* _argv[])
+{
+	unsigned int lightCount = Benchmark::Size(_argc, _argv, 256);
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	std::vector<ShadowAtlasRequest> requests;
+	std::vector<float> sizes;
+	for (unsigned int i = 0; i < lightCount; ++i)
+	{
+		// most lights are far off and small on screen, a few fill much of it
+		float size = 32.0f + 2000.0f * unit(random) * unit(random) * unit(random);
+		unsigned int faceCount = i % 4 == 3 ? 1 : 6;
+		for (unsigned int face = 0; face < faceCount; ++face)
+		{
+			ShadowAtlasRequest request = { i * 6 + face, size, i };
+			requests.push_back(request);
+			sizes.push_back(size);
+		}
+	}
+	unsigned int count = static_cast<unsigned int>(requests.size());
+	std::vector<ShadowAtlasTile> tiles(count);
+	printf("%u lights, %u shadow maps\n", lightCount, count);
+
+	ShadowAtlasDesc desc;
+	ShadowAtlas atlas;
+	atlas.Init(desc);
+	atlas.Update(requests.data(), count, tiles.data());
+
+	const unsigned int frames = 100;
+	unsigned int frame = 0;
+	unsigned int renders = 0;
+	Benchmark::Run("update, sizes and casters moving", 5, [&]()
+	{
+		for (unsigned int f = 0; f < frames; ++f, ++frame)
+		{
+			for (unsigned int i = 0; i < count; ++i)
+			{
+				sizes[i] = std::max(1.0f, sizes[i] * (0.98f + 0.04f * unit(random)));
+				requests[i].desiredSize = sizes[i];
+				requests[i].contentHash = requests[i].key % 3 == 0 ? frame : 0;
+			}
+			atlas.Update(requests.data(), count, tiles.data());
+			for (const ShadowAtlasTile& tile : tiles)
+				renders += tile.render ? 1 : 0;
+		}
+	}, static_cast<double>(count) * frames);
+	printf("%.1f of %u shadow maps rendered a frame, %.1f%% of the atlas used\n", static_cast<double>(renders) / (5 * frames), count,
+		100.0 * atlas.UsedArea() / (static_cast<double>(atlas.AtlasSize()) * atlas.AtlasSize()));
+
+	for (ShadowAtlasRequest& request : requests)
+		request.contentHash = 0;
+	atlas.Update(requests.data(), count, tiles.data());
+	Benchmark::Run("update, nothing changing", 5, [&]()
+	{
+		for (unsigned int f = 0; f < frames; ++f)
+			atlas.Update(requests.data(), count, tiles.data());
+	}, static_cast<double>(count) * frames);
+	return 0;
+}
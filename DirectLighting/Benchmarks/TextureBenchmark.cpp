@@ -0,0 +1,56 @@
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "Benchmark.h"
+#include "BlockCompression.h"
+#include "ImageImporter.h"
+#include "JobSystem.h"
+#include "TextureProcessing.h"
+
+// the mip chain and every BC encoder over a size x size image, 2048 by default
+int main(int _argc, char* _argv[])
+{
+	unsigned int size = Benchmark::Size(_argc, _argv, 2048);
+	JobSystem jobSystem;
+	jobSystem.Init();
+
+	Image image;
+	image.width = image.height = size;
+	image.pixels.resize(static_cast<size_t>(size) * size * 4);
+	for (unsigned int y = 0; y < size; ++y)
+	{
+		for (unsigned int x = 0; x < size; ++x)
+		{
+			uint8_t* pTexel = &image.pixels[(static_cast<size_t>(y) * size + x) * 4];
+			pTexel[0] = static_cast<uint8_t>((x * y) >> 8);
+			pTexel[1] = static_cast<uint8_t>(x ^ y);
+			pTexel[2] = static_cast<uint8_t>(128.0f + 127.0f * sinf(x * 0.01f));
+			pTexel[3] = 255;
+		}
+	}
+	double texels = static_cast<double>(size) * size;
+
+	TextureDesc desc;
+	std::vector<TextureMip> mips(1);
+	Benchmark::Run("to linear and mips", 3, [&]()
+	{
+		mips.resize(1);
+		TextureProcessing::ToLinear(image, desc, mips[0]);
+		TextureProcessing::GenerateMips(mips, desc, &jobSystem);
+	}, texels);
+
+	std::vector<uint8_t> pixels;
+	Benchmark::Run("to rgba8", 3, [&]() { TextureProcessing::ToRgba8(mips[0], desc, pixels, &jobSystem); }, texels);
+
+	const char* formatNames[] = { "rgba8", "bc1", "bc3", "bc5", "bc7" };
+	for (uint32_t format = TEXTURE_FORMAT_BC1; format <= TEXTURE_FORMAT_BC7; ++format)
+	{
+		std::vector<uint8_t> blocks;
+		Benchmark::Run((std::string("encode ") + formatNames[format]).c_str(), 3, [&]()
+		{
+			BlockCompression::Compress(pixels.data(), size, size, static_cast<TextureFormat>(format), blocks, &jobSystem);
+		}, texels);
+	}
+	return 0;
+}
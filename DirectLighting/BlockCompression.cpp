@@ -0,0 +1,703 @@
+#include "BlockCompression.h"
+
+#include <DirectXMath.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include "JobSystem.h"
+
+using namespace DirectX;
+
+namespace
+{
+	const uint32_t BLOCK_ROWS_PER_JOB = 4;
+	const uint32_t REFINE_ITERATIONS = 2;
+	const uint32_t POWER_ITERATIONS = 8;
+
+	//==============================================================================================================
+	// fitting
+	//==============================================================================================================
+
+	// the mean of _count texels and the direction they spread furthest along, zero if they are all the same. the
+	// direction is the principal eigenvector of their covariance, found by power iteration from the covariance
+	// row with the largest variance, which cannot be at right angles to it
+	void FitLine(const XMVECTOR* _pTexels, uint32_t _count, XMVECTOR& _mean, XMVECTOR& _axis)
+	{
+		XMVECTOR sum = XMVectorZero();
+		for (uint32_t i = 0; i < _count; ++i)
+			sum = XMVectorAdd(sum, _pTexels[i]);
+		_mean = XMVectorScale(sum, 1.0f / _count);
+
+		float covariance[4][4] = {};
+		for (uint32_t i = 0; i < _count; ++i)
+		{
+			XMFLOAT4 d;
+			XMStoreFloat4(&d, XMVectorSubtract(_pTexels[i], _mean));
+			const float v[4] = { d.x, d.y, d.z, d.w };
+			for (uint32_t row = 0; row < 4; ++row)
+				for (uint32_t column = row; column < 4; ++column)
+					covariance[row][column] += v[row] * v[column];
+		}
+		uint32_t largest = 0;
+		for (uint32_t row = 0; row < 4; ++row)
+		{
+			for (uint32_t column = 0; column < row; ++column)
+				covariance[row][column] = covariance[column][row];
+			if (covariance[row][row] > covariance[largest][largest])
+				largest = row;
+		}
+		if (covariance[largest][largest] <= 0.0f)
+		{
+			_axis = XMVectorZero();
+			return;
+		}
+
+		float axis[4] = { covariance[largest][0], covariance[largest][1], covariance[largest][2], covariance[largest][3] };
+		for (uint32_t iteration = 0; iteration < POWER_ITERATIONS; ++iteration)
+		{
+			float next[4] = {};
+			float scale = 0.0f;
+			for (uint32_t row = 0; row < 4; ++row)
+			{
+				for (uint32_t column = 0; column < 4; ++column)
+					next[row] += covariance[row][column] * axis[column];
+				scale = std::max(scale, std::fabs(next[row]));
+			}
+			if (scale == 0.0f)
+				break;
+			for (uint32_t row = 0; row < 4; ++row)
+				axis[row] = next[row] / scale;
+		}
+		_axis = XMVector4Normalize(XMVectorSet(axis[0], axis[1], axis[2], axis[3]));
+	}
+
+	// the two ends of the texels' spread along _axis
+	void LineEnds(const XMVECTOR* _pTexels, uint32_t _count, FXMVECTOR _mean, FXMVECTOR _axis, XMVECTOR& _high, XMVECTOR& _low)
+	{
+		float minT = 0.0f;
+		float maxT = 0.0f;
+		for (uint32_t i = 0; i < _count; ++i)
+		{
+			float t = XMVectorGetX(XMVector4Dot(XMVectorSubtract(_pTexels[i], _mean), _axis));
+			minT = std::min(minT, t);
+			maxT = std::max(maxT, t);
+		}
+		_high = XMVectorMultiplyAdd(_axis, XMVectorReplicate(maxT), _mean);
+		_low = XMVectorMultiplyAdd(_axis, XMVectorReplicate(minT), _mean);
+	}
+
+	// the end points that best reproduce _count texels, given how much of each end (_pWeights, pairs) every texel
+	// takes. false when the weights cannot tell the ends apart, every texel using the same mix
+	bool SolveEnds(const XMVECTOR* _pTexels, const float (*_pWeights)[2], uint32_t _count, XMVECTOR& _end0, XMVECTOR& _end1)
+	{
+		float aa = 0.0f;
+		float ab = 0.0f;
+		float bb = 0.0f;
+		XMVECTOR ax = XMVectorZero();
+		XMVECTOR bx = XMVectorZero();
+		for (uint32_t i = 0; i < _count; ++i)
+		{
+			float a = _pWeights[i][0];
+			float b = _pWeights[i][1];
+			aa += a * a;
+			ab += a * b;
+			bb += b * b;
+			ax = XMVectorMultiplyAdd(_pTexels[i], XMVectorReplicate(a), ax);
+			bx = XMVectorMultiplyAdd(_pTexels[i], XMVectorReplicate(b), bx);
+		}
+		float determinant = aa * bb - ab * ab;
+		if (std::fabs(determinant) < 1e-6f)
+			return false;
+		float inverse = 1.0f / determinant;
+		_end0 = XMVectorScale(XMVectorSubtract(XMVectorScale(ax, bb), XMVectorScale(bx, ab)), inverse);
+		_end1 = XMVectorScale(XMVectorSubtract(XMVectorScale(bx, aa), XMVectorScale(ax, ab)), inverse);
+		return true;
+	}
+
+	//==============================================================================================================
+	// BC1
+	//==============================================================================================================
+
+	uint16_t To565(FXMVECTOR _color)
+	{
+		XMFLOAT4 c;
+		XMStoreFloat4(&c, XMVectorClamp(_color, XMVectorZero(), XMVectorReplicate(255.0f)));
+		uint32_t r = static_cast<uint32_t>(c.x * 31.0f / 255.0f + 0.5f);
+		uint32_t g = static_cast<uint32_t>(c.y * 63.0f / 255.0f + 0.5f);
+		uint32_t b = static_cast<uint32_t>(c.z * 31.0f / 255.0f + 0.5f);
+		return static_cast<uint16_t>(r << 11 | g << 5 | b);
+	}
+
+	uint32_t Expand5(uint32_t _value) { return _value << 3 | _value >> 2; }
+	uint32_t Expand6(uint32_t _value) { return _value << 2 | _value >> 4; }
+
+	XMVECTOR From565(uint16_t _color)
+	{
+		return XMVectorSet(static_cast<float>(Expand5(_color >> 11)), static_cast<float>(Expand6((_color >> 5) & 63)),
+			static_cast<float>(Expand5(_color & 31)), 0.0f);
+	}
+
+	// for every byte, the pair of 5 and of 6 bit end points whose two thirds blend comes nearest to it, a little in
+	// favour of close pairs, which every decoder rounds alike
+	struct SingleColorTables
+	{
+		uint8_t ends5[256][2];
+		uint8_t ends6[256][2];
+
+		SingleColorTables()
+		{
+			Build(ends5, 32, Expand5);
+			Build(ends6, 64, Expand6);
+		}
+
+		static void Build(uint8_t (*_pEnds)[2], uint32_t _levels, uint32_t (*_expand)(uint32_t))
+		{
+			for (uint32_t value = 0; value < 256; ++value)
+			{
+				float bestError = 1e9f;
+				for (uint32_t a = 0; a < _levels; ++a)
+				{
+					for (uint32_t b = 0; b < _levels; ++b)
+					{
+						float blend = (2.0f * _expand(a) + _expand(b)) / 3.0f;
+						float error = std::fabs(blend - value) + 0.03f * std::fabs(static_cast<float>(_expand(a)) - _expand(b));
+						if (error < bestError)
+						{
+							bestError = error;
+							_pEnds[value][0] = static_cast<uint8_t>(a);
+							_pEnds[value][1] = static_cast<uint8_t>(b);
+						}
+					}
+				}
+			}
+		}
+	};
+
+	const SingleColorTables& SingleColor()
+	{
+		static const SingleColorTables tables;
+		return tables;
+	}
+
+	struct Bc1Block
+	{
+		uint16_t color0;
+		uint16_t color1;
+		uint32_t indices;
+		float error;
+	};
+
+	// how much of each end point the indices stand for, in four colour and in three colour mode
+	const float BC1_WEIGHTS[2][4][2] =
+	{
+		{ { 1.0f, 0.0f }, { 0.0f, 1.0f }, { 2.0f / 3.0f, 1.0f / 3.0f }, { 1.0f / 3.0f, 2.0f / 3.0f } },
+		{ { 1.0f, 0.0f }, { 0.0f, 1.0f }, { 0.5f, 0.5f }, { 0.0f, 0.0f } },
+	};
+
+	// picks each texel's nearest colour for the end points in _block. in three colour mode index 3 is transparent
+	// black and is left for the transparent texels
+	void EvaluateBC1(const XMVECTOR* _pTexels, const bool* _pTransparent, bool _threeColor, Bc1Block& _block)
+	{
+		XMVECTOR palette[4];
+		palette[0] = From565(_block.color0);
+		palette[1] = From565(_block.color1);
+		if (_threeColor)
+		{
+			palette[2] = XMVectorScale(XMVectorAdd(palette[0], palette[1]), 0.5f);
+			palette[3] = XMVectorZero();
+		}
+		else
+		{
+			palette[2] = XMVectorLerp(palette[0], palette[1], 1.0f / 3.0f);
+			palette[3] = XMVectorLerp(palette[0], palette[1], 2.0f / 3.0f);
+		}
+
+		uint32_t colors = _threeColor ? 3 : 4;
+		_block.indices = 0;
+		_block.error = 0.0f;
+		for (uint32_t i = 0; i < 16; ++i)
+		{
+			uint32_t best = 3;
+			if (!_pTransparent[i])
+			{
+				float bestError = XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(_pTexels[i], palette[0])));
+				best = 0;
+				for (uint32_t color = 1; color < colors; ++color)
+				{
+					float error = XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(_pTexels[i], palette[color])));
+					if (error < bestError)
+					{
+						bestError = error;
+						best = color;
+					}
+				}
+				_block.error += bestError;
+			}
+			_block.indices |= best << (i * 2);
+		}
+	}
+
+	// rounds the end points to 565 and orders them for the mode: the first larger for four colours, not larger for three
+	void TryBC1(const XMVECTOR* _pTexels, const bool* _pTransparent, bool _threeColor, FXMVECTOR _end0, FXMVECTOR _end1, Bc1Block& _best)
+	{
+		Bc1Block block;
+		block.color0 = To565(_end0);
+		block.color1 = To565(_end1);
+		if ((block.color0 < block.color1) != _threeColor && block.color0 != block.color1)
+			std::swap(block.color0, block.color1);
+		EvaluateBC1(_pTexels, _pTransparent, _threeColor, block);
+		if (block.error < _best.error)
+			_best = block;
+	}
+
+	void EncodeColor(const uint8_t* _pBlock, uint8_t* _pOut, bool _allowTransparent)
+	{
+		XMVECTOR texels[16];
+		bool transparent[16];
+		XMVECTOR opaque[16];
+		uint32_t opaqueCount = 0;
+		bool singleColor = true;
+		for (uint32_t i = 0; i < 16; ++i)
+		{
+			const uint8_t* p = _pBlock + i * 4;
+			texels[i] = XMVectorSet(p[0], p[1], p[2], 0.0f);
+			transparent[i] = _allowTransparent && p[3] < 128;
+			if (!transparent[i])
+			{
+				opaque[opaqueCount++] = texels[i];
+				singleColor = singleColor && memcmp(p, _pBlock, 3) == 0;
+			}
+		}
+
+		Bc1Block best = {};
+		best.error = 1e30f;
+		bool threeColor = opaqueCount < 16;
+		if (opaqueCount == 0)
+		{
+			best.indices = 0xffffffff;
+		}
+		else if (singleColor && !threeColor)
+		{
+			// every texel takes the two thirds blend, index 2, or index 3 when the order has to be turned around
+			const SingleColorTables& tables = SingleColor();
+			best.color0 = static_cast<uint16_t>(tables.ends5[_pBlock[0]][0] << 11 | tables.ends6[_pBlock[1]][0] << 5 | tables.ends5[_pBlock[2]][0]);
+			best.color1 = static_cast<uint16_t>(tables.ends5[_pBlock[0]][1] << 11 | tables.ends6[_pBlock[1]][1] << 5 | tables.ends5[_pBlock[2]][1]);
+			best.indices = 0xaaaaaaaa;
+			if (best.color0 < best.color1)
+			{
+				std::swap(best.color0, best.color1);
+				best.indices = 0xffffffff;
+			}
+			else if (best.color0 == best.color1)
+				best.indices = 0;
+		}
+		else
+		{
+			XMVECTOR mean;
+			XMVECTOR axis;
+			XMVECTOR high;
+			XMVECTOR low;
+			FitLine(opaque, opaqueCount, mean, axis);
+			LineEnds(opaque, opaqueCount, mean, axis, high, low);
+			TryBC1(texels, transparent, threeColor, high, low, best);
+
+			for (uint32_t iteration = 0; iteration < REFINE_ITERATIONS; ++iteration)
+			{
+				float weights[16][2];
+				uint32_t count = 0;
+				for (uint32_t i = 0; i < 16; ++i)
+				{
+					if (transparent[i])
+						continue;
+					uint32_t index = (best.indices >> (i * 2)) & 3;
+					weights[count][0] = BC1_WEIGHTS[threeColor][index][0];
+					weights[count][1] = BC1_WEIGHTS[threeColor][index][1];
+					count++;
+				}
+				XMVECTOR end0;
+				XMVECTOR end1;
+				if (!SolveEnds(opaque, weights, count, end0, end1))
+					break;
+				TryBC1(texels, transparent, threeColor, end0, end1, best);
+			}
+		}
+
+		memcpy(_pOut, &best.color0, 2);
+		memcpy(_pOut + 2, &best.color1, 2);
+		memcpy(_pOut + 4, &best.indices, 4);
+	}
+
+	//==============================================================================================================
+	// BC4
+	//==============================================================================================================
+
+	struct Bc4Block
+	{
+		uint8_t end0;
+		uint8_t end1;
+		uint8_t indices[16];
+		float error;
+	};
+
+	// eight values when end0 > end1, otherwise six and then 0 and 255
+	void EvaluateBC4(const uint8_t* _pValues, Bc4Block& _block)
+	{
+		float palette[8];
+		float a = _block.end0;
+		float b = _block.end1;
+		palette[0] = a;
+		palette[1] = b;
+		if (_block.end0 > _block.end1)
+		{
+			for (uint32_t i = 1; i < 7; ++i)
+				palette[i + 1] = ((7 - i) * a + i * b) / 7.0f;
+		}
+		else
+		{
+			for (uint32_t i = 1; i < 5; ++i)
+				palette[i + 1] = ((5 - i) * a + i * b) / 5.0f;
+			palette[6] = 0.0f;
+			palette[7] = 255.0f;
+		}
+
+		_block.error = 0.0f;
+		for (uint32_t i = 0; i < 16; ++i)
+		{
+			float bestError = 1e30f;
+			for (uint32_t index = 0; index < 8; ++index)
+			{
+				float error = (palette[index] - _pValues[i]) * (palette[index] - _pValues[i]);
+				if (error < bestError)
+				{
+					bestError = error;
+					_block.indices[i] = static_cast<uint8_t>(index);
+				}
+			}
+			_block.error += bestError;
+		}
+	}
+
+	uint8_t ToByte(float _value)
+	{
+		return static_cast<uint8_t>(std::min(std::max(_value, 0.0f), 255.0f) + 0.5f);
+	}
+
+	//==============================================================================================================
+	// BC7
+	//==============================================================================================================
+
+	const uint32_t BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	// for a position 0..64 along the end points, the index whose weight is nearest
+	struct Bc7IndexTable
+	{
+		uint8_t nearest[65];
+
+		Bc7IndexTable()
+		{
+			for (uint32_t t = 0; t <= 64; ++t)
+			{
+				uint32_t best = 0;
+				for (uint32_t index = 1; index < 16; ++index)
+					if (abs(static_cast<int>(BC7_WEIGHTS[index]) - static_cast<int>(t)) < abs(static_cast<int>(BC7_WEIGHTS[best]) - static_cast<int>(t)))
+						best = index;
+				nearest[t] = static_cast<uint8_t>(best);
+			}
+		}
+	};
+
+	const Bc7IndexTable& Bc7Indices()
+	{
+		static const Bc7IndexTable table;
+		return table;
+	}
+
+	struct Bc7Block
+	{
+		uint8_t ends[2][4]; // seven bit end points, shared bit not included
+		uint32_t pbits[2];
+		uint8_t indices[16];
+		float error;
+	};
+
+	// tries _end0 and _end1 with all four combinations of shared bits and keeps the best in _best
+	void TryBC7(const XMVECTOR* _pTexels, FXMVECTOR _end0, FXMVECTOR _end1, Bc7Block& _best)
+	{
+		const Bc7IndexTable& table = Bc7Indices();
+		XMFLOAT4 ends[2];
+		XMStoreFloat4(&ends[0], _end0);
+		XMStoreFloat4(&ends[1], _end1);
+		for (uint32_t combination = 0; combination < 4; ++combination)
+		{
+			Bc7Block block;
+			block.pbits[0] = combination & 1;
+			block.pbits[1] = combination >> 1;
+
+			// the nearest of the values the end point can take with this shared bit, 2 * q + p
+			uint32_t values[2][4];
+			for (uint32_t end = 0; end < 2; ++end)
+			{
+				const float channels[4] = { ends[end].x, ends[end].y, ends[end].z, ends[end].w };
+				for (uint32_t channel = 0; channel < 4; ++channel)
+				{
+					float q = std::floor((channels[channel] - block.pbits[end]) * 0.5f + 0.5f);
+					block.ends[end][channel] = static_cast<uint8_t>(std::min(std::max(q, 0.0f), 127.0f));
+					values[end][channel] = block.ends[end][channel] * 2u + block.pbits[end];
+				}
+			}
+
+			// the palette is on a line between the ends, so a texel's index follows from how far along it is
+			XMVECTOR a = XMVectorSet(static_cast<float>(values[0][0]), static_cast<float>(values[0][1]), static_cast<float>(values[0][2]), static_cast<float>(values[0][3]));
+			XMVECTOR b = XMVectorSet(static_cast<float>(values[1][0]), static_cast<float>(values[1][1]), static_cast<float>(values[1][2]), static_cast<float>(values[1][3]));
+			XMVECTOR direction = XMVectorSubtract(b, a);
+			float lengthSq = XMVectorGetX(XMVector4LengthSq(direction));
+			XMVECTOR toPosition = lengthSq > 0.0f ? XMVectorScale(direction, 64.0f / lengthSq) : XMVectorZero();
+
+			XMVECTOR palette[16];
+			for (uint32_t index = 0; index < 16; ++index)
+			{
+				uint32_t w = BC7_WEIGHTS[index];
+				palette[index] = XMVectorSet(static_cast<float>(((64 - w) * values[0][0] + w * values[1][0] + 32) >> 6),
+					static_cast<float>(((64 - w) * values[0][1] + w * values[1][1] + 32) >> 6),
+					static_cast<float>(((64 - w) * values[0][2] + w * values[1][2] + 32) >> 6),
+					static_cast<float>(((64 - w) * values[0][3] + w * values[1][3] + 32) >> 6));
+			}
+
+			block.error = 0.0f;
+			for (uint32_t i = 0; i < 16 && block.error < _best.error; ++i)
+			{
+				float t = XMVectorGetX(XMVector4Dot(XMVectorSubtract(_pTexels[i], a), toPosition));
+				uint32_t index = table.nearest[static_cast<uint32_t>(std::min(std::max(t, 0.0f), 64.0f) + 0.5f)];
+				block.indices[i] = static_cast<uint8_t>(index);
+				block.error += XMVectorGetX(XMVector4LengthSq(XMVectorSubtract(_pTexels[i], palette[index])));
+			}
+			if (block.error < _best.error)
+				_best = block;
+		}
+	}
+
+	// fills in a 128 bit block from its lowest bit up
+	struct BitWriter
+	{
+		uint64_t words[2] = {};
+		uint32_t position = 0;
+
+		void Write(uint32_t _value, uint32_t _count)
+		{
+			for (uint32_t bit = 0; bit < _count; ++bit, ++position)
+				words[position / 64] |= static_cast<uint64_t>((_value >> bit) & 1) << (position % 64);
+		}
+	};
+}
+
+uint32_t BlockCompression::BlockBytes(TextureFormat _format)
+{
+	switch (_format)
+	{
+	case TEXTURE_FORMAT_BC1: return 8;
+	case TEXTURE_FORMAT_BC3:
+	case TEXTURE_FORMAT_BC5:
+	case TEXTURE_FORMAT_BC7: return 16;
+	default: return 0;
+	}
+}
+
+void BlockCompression::EncodeBC1(const uint8_t* _pBlock, uint8_t* _pOut, bool _allowTransparent)
+{
+	EncodeColor(_pBlock, _pOut, _allowTransparent);
+}
+
+void BlockCompression::EncodeBC3(const uint8_t* _pBlock, uint8_t* _pOut)
+{
+	// the colour half of BC3 is always read in four colour mode
+	EncodeBC4(_pBlock + 3, 4, _pOut);
+	EncodeColor(_pBlock, _pOut + 8, false);
+}
+
+void BlockCompression::EncodeBC5(const uint8_t* _pBlock, uint8_t* _pOut)
+{
+	EncodeBC4(_pBlock, 4, _pOut);
+	EncodeBC4(_pBlock + 1, 4, _pOut + 8);
+}
+
+void BlockCompression::EncodeBC4(const uint8_t* _pValues, uint32_t _stride, uint8_t* _pOut)
+{
+	uint8_t values[16];
+	uint8_t low = 255;
+	uint8_t high = 0;
+	uint8_t innerLow = 255;
+	uint8_t innerHigh = 0;
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		values[i] = _pValues[i * _stride];
+		low = std::min(low, values[i]);
+		high = std::max(high, values[i]);
+		if (values[i] != 0 && values[i] != 255)
+		{
+			innerLow = std::min(innerLow, values[i]);
+			innerHigh = std::max(innerHigh, values[i]);
+		}
+	}
+
+	// eight values spanning the block, refined by least squares while the ends stay in that order
+	Bc4Block best;
+	best.end0 = high;
+	best.end1 = low;
+	EvaluateBC4(values, best);
+	for (uint32_t iteration = 0; iteration < REFINE_ITERATIONS && high > low; ++iteration)
+	{
+		float aa = 0.0f;
+		float ab = 0.0f;
+		float bb = 0.0f;
+		float ax = 0.0f;
+		float bx = 0.0f;
+		for (uint32_t i = 0; i < 16; ++i)
+		{
+			uint32_t index = best.indices[i];
+			float b = index == 0 ? 0.0f : index == 1 ? 1.0f : (index - 1) / 7.0f;
+			float a = 1.0f - b;
+			aa += a * a;
+			ab += a * b;
+			bb += b * b;
+			ax += a * values[i];
+			bx += b * values[i];
+		}
+		float determinant = aa * bb - ab * ab;
+		if (std::fabs(determinant) < 1e-6f)
+			break;
+		Bc4Block block;
+		block.end0 = ToByte((ax * bb - bx * ab) / determinant);
+		block.end1 = ToByte((bx * aa - ax * ab) / determinant);
+		if (block.end0 <= block.end1)
+			break;
+		EvaluateBC4(values, block);
+		if (block.error >= best.error)
+			break;
+		best = block;
+	}
+
+	// six values between the ends other than 0 and 255, which come exact
+	if (best.error > 0.0f)
+	{
+		Bc4Block block;
+		block.end0 = innerLow <= innerHigh ? innerLow : 0;
+		block.end1 = innerLow <= innerHigh ? innerHigh : 255;
+		EvaluateBC4(values, block);
+		if (block.error < best.error)
+			best = block;
+	}
+
+	uint64_t indices = 0;
+	for (uint32_t i = 0; i < 16; ++i)
+		indices |= static_cast<uint64_t>(best.indices[i]) << (i * 3);
+	_pOut[0] = best.end0;
+	_pOut[1] = best.end1;
+	for (uint32_t i = 0; i < 6; ++i)
+		_pOut[2 + i] = static_cast<uint8_t>(indices >> (i * 8));
+}
+
+void BlockCompression::EncodeBC7(const uint8_t* _pBlock, uint8_t* _pOut)
+{
+	XMVECTOR texels[16];
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		const uint8_t* p = _pBlock + i * 4;
+		texels[i] = XMVectorSet(p[0], p[1], p[2], p[3]);
+	}
+
+	XMVECTOR mean;
+	XMVECTOR axis;
+	XMVECTOR high;
+	XMVECTOR low;
+	FitLine(texels, 16, mean, axis);
+	LineEnds(texels, 16, mean, axis, high, low);
+	Bc7Block best = {};
+	best.error = 1e30f;
+	TryBC7(texels, high, low, best);
+
+	for (uint32_t iteration = 0; iteration < REFINE_ITERATIONS && best.error > 0.0f; ++iteration)
+	{
+		float weights[16][2];
+		for (uint32_t i = 0; i < 16; ++i)
+		{
+			weights[i][1] = BC7_WEIGHTS[best.indices[i]] / 64.0f;
+			weights[i][0] = 1.0f - weights[i][1];
+		}
+		XMVECTOR end0;
+		XMVECTOR end1;
+		if (!SolveEnds(texels, weights, 16, end0, end1))
+			break;
+		TryBC7(texels, end0, end1, best);
+	}
+
+	// the first texel's index has its top bit left out, so it must be below 8: if not, the ends change places
+	if (best.indices[0] >= 8)
+	{
+		for (uint32_t channel = 0; channel < 4; ++channel)
+			std::swap(best.ends[0][channel], best.ends[1][channel]);
+		std::swap(best.pbits[0], best.pbits[1]);
+		for (uint32_t i = 0; i < 16; ++i)
+			best.indices[i] = static_cast<uint8_t>(15 - best.indices[i]);
+	}
+
+	// mode 6 is six 0 bits and a 1, the end points channel by channel, the two shared bits and the indices
+	BitWriter bits;
+	bits.Write(1 << 6, 7);
+	for (uint32_t channel = 0; channel < 4; ++channel)
+	{
+		bits.Write(best.ends[0][channel], 7);
+		bits.Write(best.ends[1][channel], 7);
+	}
+	bits.Write(best.pbits[0], 1);
+	bits.Write(best.pbits[1], 1);
+	bits.Write(best.indices[0], 3);
+	for (uint32_t i = 1; i < 16; ++i)
+		bits.Write(best.indices[i], 4);
+	memcpy(_pOut, bits.words, 16);
+}
+
+void BlockCompression::Compress(const uint8_t* _pPixels, uint32_t _width, uint32_t _height, TextureFormat _format,
+	std::vector<uint8_t>& _out, JobSystem* _pJobSystem)
+{
+	uint32_t blockBytes = BlockBytes(_format);
+	uint32_t blocksWide = (_width + 3) / 4;
+	uint32_t blocksHigh = (_height + 3) / 4;
+	_out.resize(static_cast<size_t>(blocksWide) * blocksHigh * blockBytes);
+
+	auto encode = [&](unsigned int _begin, unsigned int _end)
+	{
+		uint8_t block[64];
+		for (unsigned int blockY = _begin; blockY < _end; ++blockY)
+		{
+			for (uint32_t blockX = 0; blockX < blocksWide; ++blockX)
+			{
+				for (uint32_t y = 0; y < 4; ++y)
+				{
+					uint32_t sourceY = std::min(blockY * 4 + y, _height - 1);
+					for (uint32_t x = 0; x < 4; ++x)
+					{
+						uint32_t sourceX = std::min(blockX * 4 + x, _width - 1);
+						memcpy(block + (y * 4 + x) * 4, _pPixels + (static_cast<size_t>(sourceY) * _width + sourceX) * 4, 4);
+					}
+				}
+
+				uint8_t* pOut = &_out[(static_cast<size_t>(blockY) * blocksWide + blockX) * blockBytes];
+				switch (_format)
+				{
+				case TEXTURE_FORMAT_BC1: EncodeBC1(block, pOut); break;
+				case TEXTURE_FORMAT_BC3: EncodeBC3(block, pOut); break;
+				case TEXTURE_FORMAT_BC5: EncodeBC5(block, pOut); break;
+				case TEXTURE_FORMAT_BC7: EncodeBC7(block, pOut); break;
+				default: break;
+				}
+			}
+		}
+	};
+	if (_pJobSystem && blocksHigh > BLOCK_ROWS_PER_JOB)
+		_pJobSystem->ParallelFor(blocksHigh, BLOCK_ROWS_PER_JOB, encode);
+	else
+		encode(0, blocksHigh);
+}
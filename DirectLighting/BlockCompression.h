@@ -0,0 +1,41 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "TextureProcessing.h"
+
+class JobSystem;
+
+// encodes 4x4 blocks of rgba8 texels in the BC formats the gpu samples from directly.
+//
+// BC1 colours are fitted along the principal axis of the block's colours, then the end points are solved again by
+// least squares for the indices they picked, twice, keeping whichever is closest once rounded to 565. blocks of a
+// single colour use a table of the 565 pairs whose blend lands nearest each byte instead. a BC1 block with texels
+// below half alpha switches to three colours and transparent black.
+//
+// BC4 (the alpha of BC3, both channels of BC5) tries both of its modes: eight values between the block's extremes,
+// and six between the extremes other than 0 and 255, with 0 and 255 exact.
+//
+// BC7 uses mode 6 only: one subset, rgba end points of seven bits plus a shared bit each, and 16 levels between them.
+// it is fitted like BC1 but in four dimensions, trying all four combinations of the shared bits. the other seven
+// modes split blocks into subsets or rotate channels, which suits hard edges better but costs a search per block;
+// mode 6 alone is already well ahead of BC1 and BC3 on smooth content
+namespace BlockCompression
+{
+	// bytes in a block of _format, 0 for TEXTURE_FORMAT_RGBA8
+	uint32_t BlockBytes(TextureFormat _format);
+
+	// _pBlock is 16 texels of rgba8, a row of four at a time
+	void EncodeBC1(const uint8_t* _pBlock, uint8_t* _pOut, bool _allowTransparent = true);
+	void EncodeBC3(const uint8_t* _pBlock, uint8_t* _pOut);
+	void EncodeBC5(const uint8_t* _pBlock, uint8_t* _pOut);
+	void EncodeBC7(const uint8_t* _pBlock, uint8_t* _pOut);
+
+	// one channel of 16 texels, _stride bytes apart
+	void EncodeBC4(const uint8_t* _pValues, uint32_t _stride, uint8_t* _pOut);
+
+	// a whole level of _width x _height rgba8 texels, rows of blocks top to bottom. the blocks past the right and bottom
+	// edges repeat the last column and row. rows of blocks are shared out on the job system
+	void Compress(const uint8_t* _pPixels, uint32_t _width, uint32_t _height, TextureFormat _format, std::vector<uint8_t>& _out,
+		JobSystem* _pJobSystem = nullptr);
+}
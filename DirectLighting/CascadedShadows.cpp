@@ -0,0 +1,204 @@
+#include "CascadedShadows.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "JobSystem.h"
+
+using namespace DirectX;
+
+namespace
+{
+	const uint32_t QUADS_PER_BLOCK = 1024; // casters are culled 4096 at a time
+	const uint32_t MIN_CASTERS_PER_BLOCK = 1024;
+
+	// rounding the radius up stops it from wobbling with the float error in the camera's matrices
+	const float RADIUS_STEP = 1.0f / 16.0f;
+}
+
+void CascadedShadows::ComputeSplits(float _near, float _far, uint32_t _count, float _lambda, float* _splits)
+{
+	// the logarithmic split gives every cascade the same ratio of far to near, which matches how perspective
+	// shrinks things, but it spends nearly everything on the first few metres. the even split is blended in to
+	// make up for that
+	for (uint32_t i = 0; i <= _count; ++i)
+	{
+		float fraction = static_cast<float>(i) / _count;
+		float logarithmic = _near * std::pow(_far / _near, fraction);
+		float uniform = _near + (_far - _near) * fraction;
+		_splits[i] = _lambda * logarithmic + (1.0f - _lambda) * uniform;
+	}
+	_splits[0] = _near;
+	_splits[_count] = _far;
+}
+
+void CascadedShadows::Init(const ShadowCascadeDesc& _desc, const XMFLOAT4X4& _proj)
+{
+	m_desc = _desc;
+	m_desc.cascadeCount = std::min(std::max(m_desc.cascadeCount, 1u), MAX_SHADOW_CASCADES);
+
+	// a left handed perspective projection gives depth = _33 + _43 / viewZ
+	float nearZ = -_proj._43 / _proj._33;
+	float farZ = nearZ * _proj._33 / (_proj._33 - 1.0f);
+	if (m_desc.maxDistance > 0.0f)
+		farZ = std::min(farZ, m_desc.maxDistance);
+	ComputeSplits(nearZ, farZ, m_desc.cascadeCount, m_desc.splitLambda, m_splits);
+
+	float tanHalfX = 1.0f / _proj._11;
+	float tanHalfY = 1.0f / _proj._22;
+	m_tanHalfDiagonal = std::sqrt(tanHalfX * tanHalfX + tanHalfY * tanHalfY);
+
+	for (uint32_t cascade = 0; cascade < MAX_SHADOW_CASCADES; ++cascade)
+		m_casters[cascade].clear();
+}
+
+void CascadedShadows::Update(const XMFLOAT4X4& _view, const XMFLOAT3& _lightDirection)
+{
+	XMMATRIX inverseView = XMMatrixInverse(nullptr, XMLoadFloat4x4(&_view));
+	XMVECTOR direction = XMVector3Normalize(XMLoadFloat3(&_lightDirection));
+
+	// any up vector works as long as it does not change from frame to frame, or the texel grid turns with it
+	XMVECTOR up = std::fabs(_lightDirection.y) > 0.99f * XMVectorGetX(XMVector3Length(XMLoadFloat3(&_lightDirection))) ?
+		XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f) : XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+
+	float k2 = m_tanHalfDiagonal * m_tanHalfDiagonal;
+	float resolution = static_cast<float>(m_desc.resolution);
+	for (uint32_t i = 0; i < m_desc.cascadeCount; ++i)
+	{
+		ShadowCascade& cascade = m_cascades[i];
+		float nearZ = m_splits[i];
+		float farZ = m_splits[i + 1];
+		cascade.splitNear = nearZ;
+		cascade.splitFar = farZ;
+
+		// the smallest sphere around the slice has its centre on the view axis, the same distance from the near and
+		// the far corners. a long thin slice is better off with the sphere around its far end. it only depends on the
+		// depths and the field of view, so turning the camera never changes it
+		float centerZ = 0.5f * (nearZ + farZ) * (1.0f + k2);
+		float radius;
+		if (centerZ >= farZ)
+		{
+			centerZ = farZ;
+			radius = farZ * m_tanHalfDiagonal;
+		}
+		else
+		{
+			radius = std::sqrt((centerZ - nearZ) * (centerZ - nearZ) + nearZ * nearZ * k2);
+		}
+		radius = std::ceil(radius / RADIUS_STEP) * RADIUS_STEP;
+
+		XMVECTOR center = XMVector3TransformCoord(XMVectorSet(0.0f, 0.0f, centerZ, 1.0f), inverseView);
+		XMStoreFloat4(&cascade.sphere, XMVectorSetW(center, radius));
+
+		// the light looks at the middle of the sphere from its edge, and the box around the sphere is the projection
+		XMVECTOR eye = XMVectorSubtract(center, XMVectorScale(direction, radius));
+		XMMATRIX view = XMMatrixLookToLH(eye, direction, up);
+		XMMATRIX proj = XMMatrixOrthographicOffCenterLH(-radius, radius, -radius, radius, 0.0f, 2.0f * radius);
+
+		// where the world's origin lands in texels, moved onto the nearest texel corner
+		XMVECTOR origin = XMVectorScale(XMVector3TransformCoord(XMVectorZero(), view * proj), 0.5f * resolution);
+		XMVECTOR offset = XMVectorScale(XMVectorSubtract(XMVectorRound(origin), origin), 2.0f / resolution);
+		proj.r[3] = XMVectorAdd(proj.r[3], XMVectorSetW(XMVectorSetZ(offset, 0.0f), 0.0f));
+
+		XMStoreFloat4x4(&cascade.view, view);
+		XMStoreFloat4x4(&cascade.proj, proj);
+		XMStoreFloat4x4(&cascade.viewProj, view * proj);
+	}
+}
+
+void CascadedShadows::SetCasters(const XMFLOAT4* _spheres, uint32_t _count, JobSystem* _pJobSystem)
+{
+	// pad to whole quads with spheres that can never be inside anything
+	m_casterCount = _count;
+	uint32_t quadCount = (_count + 3) / 4;
+	m_casterQuads.resize(quadCount);
+
+	auto pack = [&](unsigned int _begin, unsigned int _end)
+	{
+		for (unsigned int quad = _begin; quad < _end; ++quad)
+		{
+			XMFLOAT4 spheres[4];
+			for (uint32_t lane = 0; lane < 4; ++lane)
+			{
+				uint32_t i = quad * 4 + lane;
+				spheres[lane] = i < _count ? _spheres[i] : XMFLOAT4(0.0f, 0.0f, 0.0f, -1.0f);
+			}
+			CasterQuad& casters = m_casterQuads[quad];
+			casters.x = XMVectorSet(spheres[0].x, spheres[1].x, spheres[2].x, spheres[3].x);
+			casters.y = XMVectorSet(spheres[0].y, spheres[1].y, spheres[2].y, spheres[3].y);
+			casters.z = XMVectorSet(spheres[0].z, spheres[1].z, spheres[2].z, spheres[3].z);
+			casters.radius = XMVectorSet(spheres[0].w, spheres[1].w, spheres[2].w, spheres[3].w);
+		}
+	};
+	if (_pJobSystem && _count >= 2 * MIN_CASTERS_PER_BLOCK)
+		_pJobSystem->ParallelFor(quadCount, MIN_CASTERS_PER_BLOCK / 4, pack);
+	else
+		pack(0, quadCount);
+}
+
+void CascadedShadows::Cull(JobSystem* _pJobSystem)
+{
+	uint32_t quadCount = static_cast<uint32_t>(m_casterQuads.size());
+	uint32_t blockCount = std::max((quadCount + QUADS_PER_BLOCK - 1) / QUADS_PER_BLOCK, 1u);
+	m_blockCasters.resize(m_desc.cascadeCount * blockCount);
+
+	// every (cascade, block) pair is a job of its own
+	auto cull = [&](unsigned int _begin, unsigned int _end)
+	{
+		for (unsigned int job = _begin; job < _end; ++job)
+		{
+			uint32_t cascade = job / blockCount;
+			uint32_t block = job % blockCount;
+			std::vector<uint32_t>& out = m_blockCasters[job];
+			out.clear();
+
+			// the projection is orthographic, so a caster's clip space x, y and z are just dot products, and the
+			// sphere's radius scales by the same amount on every caster. the near plane is left out on purpose
+			const ShadowCascade& shadowCascade = m_cascades[cascade];
+			const XMFLOAT4X4& m = shadowCascade.viewProj;
+			XMVECTOR scaleX = XMVectorReplicate(std::fabs(shadowCascade.proj._11));
+			XMVECTOR scaleY = XMVectorReplicate(std::fabs(shadowCascade.proj._22));
+			XMVECTOR scaleZ = XMVectorReplicate(std::fabs(shadowCascade.proj._33));
+			XMVECTOR one = XMVectorReplicate(1.0f);
+
+			uint32_t firstQuad = block * QUADS_PER_BLOCK;
+			uint32_t lastQuad = std::min(firstQuad + QUADS_PER_BLOCK, quadCount);
+			for (uint32_t quad = firstQuad; quad < lastQuad; ++quad)
+			{
+				const CasterQuad& casters = m_casterQuads[quad];
+				XMVECTOR clipX = XMVectorMultiplyAdd(casters.x, XMVectorReplicate(m._11), XMVectorMultiplyAdd(casters.y, XMVectorReplicate(m._21), XMVectorMultiplyAdd(casters.z, XMVectorReplicate(m._31), XMVectorReplicate(m._41))));
+				XMVECTOR clipY = XMVectorMultiplyAdd(casters.x, XMVectorReplicate(m._12), XMVectorMultiplyAdd(casters.y, XMVectorReplicate(m._22), XMVectorMultiplyAdd(casters.z, XMVectorReplicate(m._32), XMVectorReplicate(m._42))));
+				XMVECTOR clipZ = XMVectorMultiplyAdd(casters.x, XMVectorReplicate(m._13), XMVectorMultiplyAdd(casters.y, XMVectorReplicate(m._23), XMVectorMultiplyAdd(casters.z, XMVectorReplicate(m._33), XMVectorReplicate(m._43))));
+
+				XMVECTOR inside = XMVectorLessOrEqual(XMVectorAbs(clipX), XMVectorMultiplyAdd(casters.radius, scaleX, one));
+				inside = XMVectorAndInt(inside, XMVectorLessOrEqual(XMVectorAbs(clipY), XMVectorMultiplyAdd(casters.radius, scaleY, one)));
+				inside = XMVectorAndInt(inside, XMVectorLessOrEqual(XMVectorNegativeMultiplySubtract(casters.radius, scaleZ, clipZ), one));
+				inside = XMVectorAndInt(inside, XMVectorGreaterOrEqual(casters.radius, XMVectorZero()));
+
+				uint32_t mask[4];
+				XMStoreInt4(mask, inside);
+				for (uint32_t lane = 0; lane < 4; ++lane)
+				{
+					if (mask[lane])
+						out.push_back(quad * 4 + lane);
+				}
+			}
+		}
+	};
+	uint32_t jobCount = m_desc.cascadeCount * blockCount;
+	if (_pJobSystem && jobCount > 1)
+		_pJobSystem->ParallelFor(jobCount, 1, cull);
+	else
+		cull(0, jobCount);
+
+	for (uint32_t cascade = 0; cascade < m_desc.cascadeCount; ++cascade)
+	{
+		std::vector<uint32_t>& casters = m_casters[cascade];
+		casters.clear();
+		for (uint32_t block = 0; block < blockCount; ++block)
+		{
+			const std::vector<uint32_t>& blockCasters = m_blockCasters[cascade * blockCount + block];
+			casters.insert(casters.end(), blockCasters.begin(), blockCasters.end());
+		}
+	}
+}
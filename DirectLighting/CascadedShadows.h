@@ -0,0 +1,86 @@
+#pragma once
+#include <DirectXMath.h>
+
+#include <cstdint>
+#include <vector>
+
+class JobSystem;
+
+const uint32_t MAX_SHADOW_CASCADES = 4;
+
+struct ShadowCascadeDesc
+{
+	uint32_t cascadeCount = 4;
+	uint32_t resolution = 2048; // texels along each side of a cascade's shadow map
+	float splitLambda = 0.75f; // 0 splits the distance evenly, 1 logarithmically
+	float maxDistance = 0.0f; // how far out the shadows go. 0 goes to the projection's far plane
+};
+
+struct ShadowCascade
+{
+	DirectX::XMFLOAT4X4 view; // the light's view, looking along its direction at the middle of the cascade
+	DirectX::XMFLOAT4X4 proj; // orthographic, snapped to whole texels
+	DirectX::XMFLOAT4X4 viewProj;
+	float splitNear; // the camera's view space depth range the cascade covers
+	float splitFar;
+	DirectX::XMFLOAT4 sphere; // world space sphere around that slice of the view frustum
+};
+
+// shadows from a directional light over the camera's view, split into cascades that each cover a slice of the view
+// depth with a shadow map of their own, so the texels near the camera are small and the far ones large.
+//
+// the splits blend a logarithmic and an even split of the depth range (the practical split scheme). each cascade is
+// fit to a sphere around its slice rather than a tight box, so its size never changes as the camera turns, and the
+// projection is moved so the world's origin stays on a texel corner. together they stop the shadow edges from
+// crawling when the camera moves. the maps are rendered without depth clipping, so casters between the light and
+// the cascade are flattened onto its near plane and the cull only has to test the sides and the far end.
+//
+// the caster cull works on bounding spheres, four at a time in DirectXMath vectors, and splits every cascade into
+// blocks that run in parallel. the blocks are stitched back together in order, so the result is the same however
+// many threads ran
+class CascadedShadows
+{
+public:
+	CascadedShadows() = default;
+	~CascadedShadows() = default;
+
+	// works out the split depths. call again when the projection changes. the projection has to be symmetric
+	void Init(const ShadowCascadeDesc& _desc, const DirectX::XMFLOAT4X4& _proj);
+
+	// fits every cascade to the camera. _lightDirection is the way the light travels, world space
+	void Update(const DirectX::XMFLOAT4X4& _view, const DirectX::XMFLOAT3& _lightDirection);
+
+	// world space bounding spheres (centre xyz, radius) of everything that casts shadows
+	void SetCasters(const DirectX::XMFLOAT4* _spheres, uint32_t _count, JobSystem* _pJobSystem = nullptr);
+
+	// finds the casters for every cascade
+	void Cull(JobSystem* _pJobSystem = nullptr);
+
+	// _count + 1 depths from _near to _far. _lambda blends between an even split (0) and a logarithmic one (1)
+	static void ComputeSplits(float _near, float _far, uint32_t _count, float _lambda, float* _splits);
+
+	uint32_t CascadeCount() { return m_desc.cascadeCount; }
+	uint32_t Resolution() { return m_desc.resolution; }
+	const ShadowCascade& Cascade(uint32_t _cascade) { return m_cascades[_cascade]; }
+	const std::vector<uint32_t>& Casters(uint32_t _cascade) { return m_casters[_cascade]; } // indices into SetCasters' spheres
+
+private:
+	// four casters side by side, one component per vector
+	struct CasterQuad
+	{
+		DirectX::XMVECTOR x;
+		DirectX::XMVECTOR y;
+		DirectX::XMVECTOR z;
+		DirectX::XMVECTOR radius;
+	};
+
+	ShadowCascadeDesc m_desc;
+	float m_tanHalfDiagonal = 0.0f; // how far the frustum's corners are off its axis at a view depth of 1
+	float m_splits[MAX_SHADOW_CASCADES + 1] = {};
+	ShadowCascade m_cascades[MAX_SHADOW_CASCADES];
+
+	std::vector<CasterQuad> m_casterQuads;
+	uint32_t m_casterCount = 0;
+	std::vector<std::vector<uint32_t>> m_blockCasters; // [cascade * blocks + block]
+	std::vector<uint32_t> m_casters[MAX_SHADOW_CASCADES];
+};
@@ -0,0 +1,41 @@
+// the sun's shadow from the cascades ShadowMapPass renders, see CascadedShadows.h for how they are fit to the view.
+// ShadowMapPass uploads the constants and binds the shadow map for the scene's pixel shader
+
+#define MAX_SHADOW_CASCADES 4
+
+// ShadowMapConstants in ShadowMapPass.h
+cbuffer ShadowConstants : register(b3)
+{
+	float4x4 cascadeViewProj[MAX_SHADOW_CASCADES];
+	float4 cascadeSplitFar; // the view space depth each cascade ends at
+	uint cascadeCount; // 0 while nothing was rendered this frame
+	float shadowTexelSize;
+};
+
+Texture2DArray<float> shadowMap : register(t13);
+SamplerComparisonState shadowSampler : register(s1);
+
+// 1 where the sun reaches position, 0 where it is in shadow. viewDepth picks the first cascade that covers it, and
+// four filtered comparisons half a texel apart soften the edge. beyond the last cascade nothing is shadowed
+float SunShadow(float viewDepth, float3 position)
+{
+	uint cascade = 0;
+	while (cascade < cascadeCount && viewDepth > cascadeSplitFar[cascade])
+		cascade++;
+	if (cascade >= cascadeCount)
+		return 1.0f;
+
+	float4 shadowPosition = mul(float4(position, 1.0f), cascadeViewProj[cascade]);
+	float2 uv = shadowPosition.xy * float2(0.5f, -0.5f) + 0.5f;
+	// casters in front of the cascade were flattened onto its near plane, so a receiver there is clamped onto it too
+	float depth = saturate(shadowPosition.z);
+
+	float shadow = 0.0f;
+	[unroll]
+	for (uint i = 0; i < 4; ++i)
+	{
+		float2 offset = (float2(i & 1, i >> 1) - 0.5f) * shadowTexelSize;
+		shadow += shadowMap.SampleCmpLevelZero(shadowSampler, float3(uv + offset, cascade), depth);
+	}
+	return shadow * 0.25f;
+}
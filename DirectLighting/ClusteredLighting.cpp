@@ -0,0 +1,135 @@
+#include "ClusteredLighting.h"
+
+#include <cstring>
+
+#include "D3dx12.h"
+
+using namespace DirectX;
+
+static_assert(sizeof(ClusteredLightingConstants) == 144, "ClusteredLightingConstants must match the cbuffer in LightClusters.hlsli");
+static_assert(sizeof(Light) == 48, "Light must match the struct in LightClusters.hlsli");
+static_assert(sizeof(LightBvhNode) == 64, "LightBvhNode must match the struct in LightBvh.hlsli");
+
+namespace
+{
+	// a constant buffer view has to start on 256 bytes, the srvs behind it are kept on the same boundary
+	UINT64 AlignOffset(UINT64 _offset)
+	{
+		return (_offset + 255) & ~static_cast<UINT64>(255);
+	}
+}
+
+void ClusteredLighting::AddRootParameters(RootSignatureDesc& _rootSignatureDesc)
+{
+	m_rootConstants = _rootSignatureDesc.AddCBV(1, D3D12_SHADER_VISIBILITY_PIXEL);
+	m_rootLights = _rootSignatureDesc.AddSRV(0, D3D12_SHADER_VISIBILITY_PIXEL);
+	m_rootClusters = _rootSignatureDesc.AddSRV(1, D3D12_SHADER_VISIBILITY_PIXEL);
+	m_rootIndices = _rootSignatureDesc.AddSRV(2, D3D12_SHADER_VISIBILITY_PIXEL);
+	m_rootLightBvh = _rootSignatureDesc.AddSRV(3, D3D12_SHADER_VISIBILITY_PIXEL);
+}
+
+bool ClusteredLighting::Init(ID3D12Device* _pDevice, UINT _maxLights, UINT _maxClusters, UINT _maxLightIndices, UINT _frameCount)
+{
+	if (_frameCount > MAX_FRAMES)
+	{
+		return false;
+	}
+	m_maxLights = _maxLights;
+	m_maxClusters = _maxClusters;
+	m_maxLightIndices = _maxLightIndices;
+
+	m_lightsOffset = AlignOffset(sizeof(ClusteredLightingConstants));
+	// a bvh over n lights has 2n - 1 nodes
+	m_lightBvhOffset = AlignOffset(m_lightsOffset + static_cast<UINT64>(_maxLights) * sizeof(Light));
+	m_clustersOffset = AlignOffset(m_lightBvhOffset + static_cast<UINT64>(_maxLights) * 2 * sizeof(LightBvhNode));
+	m_indicesOffset = AlignOffset(m_clustersOffset + static_cast<UINT64>(_maxClusters) * sizeof(LightCluster));
+	UINT64 uploadSize = m_indicesOffset + static_cast<UINT64>(_maxLightIndices) * sizeof(uint32_t);
+
+	for (UINT i = 0; i < _frameCount; ++i)
+	{
+		HRESULT hr = _pDevice->CreateCommittedResource(
+			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+			D3D12_HEAP_FLAG_NONE,
+			&CD3DX12_RESOURCE_DESC::Buffer(uploadSize),
+			D3D12_RESOURCE_STATE_GENERIC_READ,
+			nullptr,
+			IID_PPV_ARGS(&m_pUploadBuffer[i]));
+		if (FAILED(hr))
+		{
+			return false;
+		}
+		m_pUploadBuffer[i]->SetName(L"Clustered Lighting Upload Resource Heap");
+
+		CD3DX12_RANGE readRange(0, 0); // we never read it on the cpu
+		hr = m_pUploadBuffer[i]->Map(0, &readRange, reinterpret_cast<void**>(&m_pUploadData[i]));
+		if (FAILED(hr))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool ClusteredLighting::Upload(const Light* _lights, UINT _count, LightClusters& _clusters, LightBvh& _bvh, const XMFLOAT4X4& _viewProj,
+	UINT _screenWidth, UINT _screenHeight, const XMFLOAT3& _ambient, const XMFLOAT3& _sunDirection, const XMFLOAT3& _sunColor, UINT _frameIndex)
+{
+	ClusteredLightingConstants constants = {};
+	XMStoreFloat4x4(&constants.invViewProj, XMMatrixTranspose(XMMatrixInverse(nullptr, XMLoadFloat4x4(&_viewProj))));
+	constants.ambient = _ambient;
+	constants.sunDirection = _sunDirection;
+	constants.sunColor = _sunColor;
+	constants.clustersX = _clusters.ClustersX();
+	constants.clustersY = _clusters.ClustersY();
+	constants.clustersZ = _clusters.ClustersZ();
+	constants.tileSize = _clusters.TileSize();
+	constants.sliceScale = _clusters.SliceScale();
+	constants.sliceBias = _clusters.SliceBias();
+	constants.invScreenSize = XMFLOAT2(1.0f / _screenWidth, 1.0f / _screenHeight);
+
+	const std::vector<LightCluster>& clusters = _clusters.Clusters();
+	const std::vector<uint32_t>& indices = _clusters.LightIndices();
+	const std::vector<LightBvhNode>& nodes = _bvh.Nodes();
+	bool fits = _count <= m_maxLights && _bvh.LightCount() == _count;
+	bool clustersFit = clusters.size() <= m_maxClusters && indices.size() <= m_maxLightIndices;
+	constants.lightCount = fits ? _count : 0;
+	constants.lightBvhSamples = fits && !clustersFit ? LIGHT_BVH_SAMPLES : 0;
+
+	UINT8* pData = m_pUploadData[_frameIndex];
+	memcpy(pData, &constants, sizeof(constants));
+	if (!fits)
+	{
+		return false;
+	}
+	if (_count > 0)
+		memcpy(pData + m_lightsOffset, _lights, _count * sizeof(Light));
+	if (!nodes.empty())
+		memcpy(pData + m_lightBvhOffset, nodes.data(), nodes.size() * sizeof(LightBvhNode));
+	if (!clustersFit)
+		return true;
+	if (!clusters.empty())
+		memcpy(pData + m_clustersOffset, clusters.data(), clusters.size() * sizeof(LightCluster));
+	if (!indices.empty())
+		memcpy(pData + m_indicesOffset, indices.data(), indices.size() * sizeof(uint32_t));
+	return true;
+}
+
+void ClusteredLighting::Bind(GraphicsCommandRecorder& _recorder, UINT _frameIndex)
+{
+	D3D12_GPU_VIRTUAL_ADDRESS uploadAddress = m_pUploadBuffer[_frameIndex]->GetGPUVirtualAddress();
+	_recorder.SetGraphicsRootConstantBufferView(m_rootConstants, uploadAddress);
+	_recorder.SetGraphicsRootShaderResourceView(m_rootLights, uploadAddress + m_lightsOffset);
+	_recorder.SetGraphicsRootShaderResourceView(m_rootClusters, uploadAddress + m_clustersOffset);
+	_recorder.SetGraphicsRootShaderResourceView(m_rootIndices, uploadAddress + m_indicesOffset);
+	_recorder.SetGraphicsRootShaderResourceView(m_rootLightBvh, uploadAddress + m_lightBvhOffset);
+}
+
+void ClusteredLighting::Release()
+{
+	for (UINT i = 0; i < MAX_FRAMES; ++i)
+	{
+		if (m_pUploadBuffer[i])
+			m_pUploadBuffer[i]->Release();
+		m_pUploadBuffer[i] = nullptr;
+		m_pUploadData[i] = nullptr;
+	}
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <Windows.h>
+#include <D3d12.h>
+#include <DirectXMath.h>
+
+#include "CommandRecorder.h"
+#include "LightBvh.h"
+#include "LightClusters.h"
+#include "RootSignature.h"
+
+// the scene pixel shader's view of the lights, as it sits in the constant buffer at b1 (see LightClusters.hlsli).
+// the layout follows hlsl's packing rules, nothing may straddle a 16 byte boundary
+struct ClusteredLightingConstants
+{
+	DirectX::XMFLOAT4X4 invViewProj; // transposed, takes a pixel's ndc position back to world space
+	DirectX::XMFLOAT3 ambient;
+	uint32_t lightCount; // 0 when the lights did not fit, the shader then only applies the ambient
+	uint32_t clustersX;
+	uint32_t clustersY;
+	uint32_t clustersZ;
+	uint32_t tileSize;
+	float sliceScale; // LightClusters::SliceScale and SliceBias
+	float sliceBias;
+	DirectX::XMFLOAT2 invScreenSize;
+	uint32_t lightBvhSamples; // 0 while the clusters fit, otherwise how many lights a pixel picks from the light bvh
+	DirectX::XMFLOAT3 sunDirection; // the way the sun's light travels, normalised
+	DirectX::XMFLOAT3 sunColor; // irradiance on a surface facing the sun
+	uint32_t pad;
+};
+
+// gets the lights and a LightClusters' grid and index list to the scene's pixel shader. every frame has its own upload
+// buffer holding the constants, then the lights, then a LightBvh's nodes, then the clusters, then the indices, and the
+// shader reads them straight from there through root descriptors. the buffers are sized once, for the most lights and
+// indices we expect. when the lights crowd into the clusters so much that their indices do not fit, the shader stops
+// looping over clusters and picks a few lights per pixel from the bvh instead, which is noisy but costs the same however
+// many lights there are
+class ClusteredLighting
+{
+public:
+	static const UINT MAX_FRAMES = 3;
+	static const UINT LIGHT_BVH_SAMPLES = 4;
+
+	ClusteredLighting() = default;
+	~ClusteredLighting() = default;
+
+	// the constant buffer at b1 and the srvs at t0 to t3, all for the pixel shader
+	void AddRootParameters(RootSignatureDesc& _rootSignatureDesc);
+
+	bool Init(ID3D12Device* _pDevice, UINT _maxLights, UINT _maxClusters, UINT _maxLightIndices, UINT _frameCount);
+
+	// copies the lights, _bvh's nodes and _clusters' lists into this frame's upload buffer. _clusters and _bvh have to
+	// have been built from the same lights. if only the cluster lists are too big the frame is lit from the bvh, returns
+	// false if the lights themselves are more than Init was told about, the frame is then lit by the ambient and the
+	// sun only
+	bool Upload(const Light* _lights, UINT _count, LightClusters& _clusters, LightBvh& _bvh, const DirectX::XMFLOAT4X4& _viewProj,
+		UINT _screenWidth, UINT _screenHeight, const DirectX::XMFLOAT3& _ambient, const DirectX::XMFLOAT3& _sunDirection,
+		const DirectX::XMFLOAT3& _sunColor, UINT _frameIndex);
+
+	// the root signature AddRootParameters was given has to be set
+	void Bind(GraphicsCommandRecorder& _recorder, UINT _frameIndex);
+
+	void Release();
+
+private:
+	ID3D12Resource* m_pUploadBuffer[MAX_FRAMES] = {};
+	UINT8* m_pUploadData[MAX_FRAMES] = {};
+	UINT64 m_lightsOffset = 0;
+	UINT64 m_lightBvhOffset = 0;
+	UINT64 m_clustersOffset = 0;
+	UINT64 m_indicesOffset = 0;
+
+	UINT m_maxLights = 0;
+	UINT m_maxClusters = 0;
+	UINT m_maxLightIndices = 0;
+
+	UINT m_rootConstants = 0;
+	UINT m_rootLights = 0;
+	UINT m_rootLightBvh = 0;
+	UINT m_rootClusters = 0;
+	UINT m_rootIndices = 0;
+};
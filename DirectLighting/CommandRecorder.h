@@ -0,0 +1,364 @@
+#pragma once
+#include <Windows.h>
+#include <D3d12.h>
+
+#include <cstring>
+#include <vector>
+
+// counts for one recorded frame. "skipped" calls were dropped because they would not have changed any state
+struct CommandStats
+{
+	UINT issued = 0; // state setting calls that reached the command list
+	UINT skipped = 0; // redundant state setting calls that were dropped
+	UINT barriersRequested = 0; // transitions asked for
+	UINT barriersIssued = 0; // transitions that reached the command list after merging
+	UINT barrierBatches = 0; // ResourceBarrier calls made
+};
+
+// sits in front of a command list and remembers what has been bound, so setting the same root signature,
+// viewport, buffers etc. again is dropped. transitions are queued and sent as one ResourceBarrier call just
+// before the next command that needs them, and a transition that is undone before it is flushed cancels out.
+// it is a template on the command list so the tracking can be driven by a recording stub instead of a real list
+template<typename TCommandList>
+class CommandRecorder
+{
+public:
+	static const UINT MAX_ROOT_PARAMETERS = 16;
+	static const UINT MAX_ROOT_CONSTANTS = 64; // the whole root signature is 64 DWORDs
+
+	// call right after the command list is reset. a reset list has no state bound except the initial pso
+	void Begin(TCommandList* _pCommandList, ID3D12PipelineState* _pInitialState)
+	{
+		m_pCommandList = _pCommandList;
+		m_stats = CommandStats();
+		m_pPipelineState = _pInitialState;
+		m_pRootSignature = nullptr;
+		m_hasViewport = false;
+		m_hasScissorRect = false;
+		m_topology = D3D_PRIMITIVE_TOPOLOGY_UNDEFINED;
+		m_hasVertexBuffer = false;
+		m_hasIndexBuffer = false;
+		m_pendingBarriers.clear();
+		InvalidateRootArguments();
+	}
+
+	// flushes any queued transitions. the returned stats are for everything since Begin
+	const CommandStats& End()
+	{
+		FlushBarriers();
+		return m_stats;
+	}
+
+	const CommandStats& Stats() { return m_stats; }
+
+	void SetPipelineState(ID3D12PipelineState* _pPipelineState)
+	{
+		if (m_pPipelineState == _pPipelineState)
+		{
+			m_stats.skipped++;
+			return;
+		}
+		m_pPipelineState = _pPipelineState;
+		m_pCommandList->SetPipelineState(_pPipelineState);
+		m_stats.issued++;
+	}
+
+	void SetGraphicsRootSignature(ID3D12RootSignature* _pRootSignature)
+	{
+		if (m_pRootSignature == _pRootSignature)
+		{
+			m_stats.skipped++;
+			return;
+		}
+		// changing the root signature throws away every root argument bound so far
+		m_pRootSignature = _pRootSignature;
+		InvalidateRootArguments();
+		m_pCommandList->SetGraphicsRootSignature(_pRootSignature);
+		m_stats.issued++;
+	}
+
+	void SetGraphicsRoot32BitConstants(UINT _rootParameterIndex, UINT _num32BitValues, const void* _pSrcData, UINT _destOffsetIn32BitValues)
+	{
+		// only the first block of constants in each slot is tracked, anything else goes straight through. it still
+		// changes what the slot holds, so the next set of the first block cannot be dropped as a repeat
+		if (_rootParameterIndex >= MAX_ROOT_PARAMETERS || _destOffsetIn32BitValues != 0 || _num32BitValues > MAX_ROOT_CONSTANTS)
+		{
+			if (_rootParameterIndex < MAX_ROOT_PARAMETERS)
+				m_rootArguments[_rootParameterIndex].valid = false;
+			m_pCommandList->SetGraphicsRoot32BitConstants(_rootParameterIndex, _num32BitValues, _pSrcData, _destOffsetIn32BitValues);
+			m_stats.issued++;
+			return;
+		}
+
+		RootArgument& argument = m_rootArguments[_rootParameterIndex];
+		size_t size = _num32BitValues * sizeof(UINT);
+		if (argument.valid && argument.num32BitValues == _num32BitValues && memcmp(argument.constants, _pSrcData, size) == 0)
+		{
+			m_stats.skipped++;
+			return;
+		}
+		argument.valid = true;
+		argument.num32BitValues = _num32BitValues;
+		argument.address = 0;
+		memcpy(argument.constants, _pSrcData, size);
+		m_pCommandList->SetGraphicsRoot32BitConstants(_rootParameterIndex, _num32BitValues, _pSrcData, _destOffsetIn32BitValues);
+		m_stats.issued++;
+	}
+
+	void SetGraphicsRootConstantBufferView(UINT _rootParameterIndex, D3D12_GPU_VIRTUAL_ADDRESS _bufferLocation)
+	{
+		if (SetRootAddress(_rootParameterIndex, _bufferLocation))
+			m_pCommandList->SetGraphicsRootConstantBufferView(_rootParameterIndex, _bufferLocation);
+	}
+
+	void SetGraphicsRootShaderResourceView(UINT _rootParameterIndex, D3D12_GPU_VIRTUAL_ADDRESS _bufferLocation)
+	{
+		if (SetRootAddress(_rootParameterIndex, _bufferLocation))
+			m_pCommandList->SetGraphicsRootShaderResourceView(_rootParameterIndex, _bufferLocation);
+	}
+
+	void SetGraphicsRootDescriptorTable(UINT _rootParameterIndex, D3D12_GPU_DESCRIPTOR_HANDLE _baseDescriptor)
+	{
+		if (SetRootAddress(_rootParameterIndex, _baseDescriptor.ptr))
+			m_pCommandList->SetGraphicsRootDescriptorTable(_rootParameterIndex, _baseDescriptor);
+	}
+
+	// only a single viewport and scissor rect are tracked, which is all we ever bind
+	void RSSetViewport(const D3D12_VIEWPORT& _viewport)
+	{
+		if (m_hasViewport && memcmp(&m_viewport, &_viewport, sizeof(D3D12_VIEWPORT)) == 0)
+		{
+			m_stats.skipped++;
+			return;
+		}
+		m_hasViewport = true;
+		m_viewport = _viewport;
+		m_pCommandList->RSSetViewports(1, &_viewport);
+		m_stats.issued++;
+	}
+
+	void RSSetScissorRect(const D3D12_RECT& _scissorRect)
+	{
+		if (m_hasScissorRect && memcmp(&m_scissorRect, &_scissorRect, sizeof(D3D12_RECT)) == 0)
+		{
+			m_stats.skipped++;
+			return;
+		}
+		m_hasScissorRect = true;
+		m_scissorRect = _scissorRect;
+		m_pCommandList->RSSetScissorRects(1, &_scissorRect);
+		m_stats.issued++;
+	}
+
+	void IASetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY _topology)
+	{
+		if (m_topology == _topology)
+		{
+			m_stats.skipped++;
+			return;
+		}
+		m_topology = _topology;
+		m_pCommandList->IASetPrimitiveTopology(_topology);
+		m_stats.issued++;
+	}
+
+	// slot 0 only, we do not use multiple vertex streams
+	void IASetVertexBuffer(const D3D12_VERTEX_BUFFER_VIEW& _view)
+	{
+		if (m_hasVertexBuffer && memcmp(&m_vertexBufferView, &_view, sizeof(D3D12_VERTEX_BUFFER_VIEW)) == 0)
+		{
+			m_stats.skipped++;
+			return;
+		}
+		m_hasVertexBuffer = true;
+		m_vertexBufferView = _view;
+		m_pCommandList->IASetVertexBuffers(0, 1, &_view);
+		m_stats.issued++;
+	}
+
+	void IASetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW& _view)
+	{
+		if (m_hasIndexBuffer && memcmp(&m_indexBufferView, &_view, sizeof(D3D12_INDEX_BUFFER_VIEW)) == 0)
+		{
+			m_stats.skipped++;
+			return;
+		}
+		m_hasIndexBuffer = true;
+		m_indexBufferView = _view;
+		m_pCommandList->IASetIndexBuffer(&_view);
+		m_stats.issued++;
+	}
+
+	// queues a transition. it is merged with a pending transition of the same resource where it can be:
+	// A->B then B->C becomes A->C, and A->B then B->A disappears. barriers in one call run in order, so a
+	// transition queued before an aliasing or uav barrier has to stay there and is never merged with one after it
+	void Transition(ID3D12Resource* _pResource, D3D12_RESOURCE_STATES _before, D3D12_RESOURCE_STATES _after, UINT _subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES)
+	{
+		m_stats.barriersRequested++;
+		if (_before == _after)
+			return;
+
+		// only the latest transition of the resource can be the one this follows
+		for (size_t i = m_pendingBarriers.size(); i-- > 0;)
+		{
+			if (m_pendingBarriers[i].Type != D3D12_RESOURCE_BARRIER_TYPE_TRANSITION)
+				break;
+			D3D12_RESOURCE_TRANSITION_BARRIER& pending = m_pendingBarriers[i].Transition;
+			if (pending.pResource != _pResource || pending.Subresource != _subresource)
+				continue;
+			if (pending.StateAfter != _before)
+				break;
+
+			if (pending.StateBefore == _after)
+			{
+				m_pendingBarriers.erase(m_pendingBarriers.begin() + i);
+			}
+			else
+			{
+				pending.StateAfter = _after;
+			}
+			return;
+		}
+
+		D3D12_RESOURCE_BARRIER barrier = {};
+		barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+		barrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+		barrier.Transition.pResource = _pResource;
+		barrier.Transition.Subresource = _subresource;
+		barrier.Transition.StateBefore = _before;
+		barrier.Transition.StateAfter = _after;
+		m_pendingBarriers.push_back(barrier);
+	}
+
+	// queues an aliasing barrier. _pBefore can be null when any resource in the same memory may have been used
+	void Aliasing(ID3D12Resource* _pBefore, ID3D12Resource* _pAfter)
+	{
+		m_stats.barriersRequested++;
+		D3D12_RESOURCE_BARRIER barrier = {};
+		barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_ALIASING;
+		barrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+		barrier.Aliasing.pResourceBefore = _pBefore;
+		barrier.Aliasing.pResourceAfter = _pAfter;
+		m_pendingBarriers.push_back(barrier);
+	}
+
+	// queues a barrier between two passes that both write the resource as an unordered access view
+	void UAVBarrier(ID3D12Resource* _pResource)
+	{
+		m_stats.barriersRequested++;
+		D3D12_RESOURCE_BARRIER barrier = {};
+		barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
+		barrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+		barrier.UAV.pResource = _pResource;
+		m_pendingBarriers.push_back(barrier);
+	}
+
+	// sends every queued transition in one call. done automatically before any command that reads or writes resources
+	void FlushBarriers()
+	{
+		if (m_pendingBarriers.empty())
+			return;
+
+		m_pCommandList->ResourceBarrier(static_cast<UINT>(m_pendingBarriers.size()), m_pendingBarriers.data());
+		m_stats.barriersIssued += static_cast<UINT>(m_pendingBarriers.size());
+		m_stats.barrierBatches++;
+		m_pendingBarriers.clear();
+	}
+
+	void OMSetRenderTargets(UINT _numRenderTargets, const D3D12_CPU_DESCRIPTOR_HANDLE* _pRenderTargetDescriptors, BOOL _singleHandleToDescriptorRange, const D3D12_CPU_DESCRIPTOR_HANDLE* _pDepthStencilDescriptor)
+	{
+		FlushBarriers();
+		m_pCommandList->OMSetRenderTargets(_numRenderTargets, _pRenderTargetDescriptors, _singleHandleToDescriptorRange, _pDepthStencilDescriptor);
+	}
+
+	void ClearRenderTargetView(D3D12_CPU_DESCRIPTOR_HANDLE _renderTargetView, const FLOAT _colorRGBA[4])
+	{
+		FlushBarriers();
+		m_pCommandList->ClearRenderTargetView(_renderTargetView, _colorRGBA, 0, nullptr);
+	}
+
+	void ClearDepthStencilView(D3D12_CPU_DESCRIPTOR_HANDLE _depthStencilView, D3D12_CLEAR_FLAGS _clearFlags, FLOAT _depth, UINT8 _stencil)
+	{
+		FlushBarriers();
+		m_pCommandList->ClearDepthStencilView(_depthStencilView, _clearFlags, _depth, _stencil, 0, nullptr);
+	}
+
+	void DrawIndexedInstanced(UINT _indexCountPerInstance, UINT _instanceCount, UINT _startIndexLocation, INT _baseVertexLocation, UINT _startInstanceLocation)
+	{
+		FlushBarriers();
+		m_pCommandList->DrawIndexedInstanced(_indexCountPerInstance, _instanceCount, _startIndexLocation, _baseVertexLocation, _startInstanceLocation);
+	}
+
+	// a command signature that sets root arguments leaves them holding whatever the last record wrote,
+	// so after this the root arguments are unknown and the next Set call always goes through
+	void ExecuteIndirect(ID3D12CommandSignature* _pCommandSignature, UINT _maxCommandCount, ID3D12Resource* _pArgumentBuffer, UINT64 _argumentBufferOffset)
+	{
+		FlushBarriers();
+		m_pCommandList->ExecuteIndirect(_pCommandSignature, _maxCommandCount, _pArgumentBuffer, _argumentBufferOffset, nullptr, 0);
+		InvalidateRootArguments();
+	}
+
+	// for anything not wrapped here. flushes transitions first since we cannot know what the caller will touch
+	TCommandList* CommandList()
+	{
+		FlushBarriers();
+		return m_pCommandList;
+	}
+
+private:
+	struct RootArgument
+	{
+		bool valid;
+		UINT num32BitValues; // 0 for descriptors and tables
+		UINT64 address; // gpu virtual address or descriptor handle
+		UINT constants[MAX_ROOT_CONSTANTS];
+	};
+
+	void InvalidateRootArguments()
+	{
+		for (UINT i = 0; i < MAX_ROOT_PARAMETERS; ++i)
+		{
+			m_rootArguments[i].valid = false;
+		}
+	}
+
+	// returns true if the call needs to go to the command list
+	bool SetRootAddress(UINT _rootParameterIndex, UINT64 _address)
+	{
+		if (_rootParameterIndex < MAX_ROOT_PARAMETERS)
+		{
+			RootArgument& argument = m_rootArguments[_rootParameterIndex];
+			if (argument.valid && argument.num32BitValues == 0 && argument.address == _address)
+			{
+				m_stats.skipped++;
+				return false;
+			}
+			argument.valid = true;
+			argument.num32BitValues = 0;
+			argument.address = _address;
+		}
+		m_stats.issued++;
+		return true;
+	}
+
+	TCommandList* m_pCommandList = nullptr;
+	CommandStats m_stats;
+
+	ID3D12PipelineState* m_pPipelineState = nullptr;
+	ID3D12RootSignature* m_pRootSignature = nullptr;
+	RootArgument m_rootArguments[MAX_ROOT_PARAMETERS];
+
+	bool m_hasViewport = false;
+	D3D12_VIEWPORT m_viewport;
+	bool m_hasScissorRect = false;
+	D3D12_RECT m_scissorRect;
+	D3D12_PRIMITIVE_TOPOLOGY m_topology = D3D_PRIMITIVE_TOPOLOGY_UNDEFINED;
+	bool m_hasVertexBuffer = false;
+	D3D12_VERTEX_BUFFER_VIEW m_vertexBufferView;
+	bool m_hasIndexBuffer = false;
+	D3D12_INDEX_BUFFER_VIEW m_indexBufferView;
+
+	std::vector<D3D12_RESOURCE_BARRIER> m_pendingBarriers;
+};
+
+typedef CommandRecorder<ID3D12GraphicsCommandList> GraphicsCommandRecorder;
@@ -0,0 +1,87 @@
+#include "Culling.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+void Culling::ExtractFrustum(const XMFLOAT4X4& _viewProj, Frustum& _frustum)
+{
+	// with row vectors clip = v * M, so each clip coordinate is v dotted with a column of M.
+	// a point is inside when -w <= x <= w, -w <= y <= w and 0 <= z <= w
+	const XMFLOAT4X4& m = _viewProj;
+	XMVECTOR column0 = XMVectorSet(m._11, m._21, m._31, m._41);
+	XMVECTOR column1 = XMVectorSet(m._12, m._22, m._32, m._42);
+	XMVECTOR column2 = XMVectorSet(m._13, m._23, m._33, m._43);
+	XMVECTOR column3 = XMVectorSet(m._14, m._24, m._34, m._44);
+
+	XMVECTOR planes[Frustum::PLANE_COUNT];
+	planes[Frustum::PLANE_LEFT] = XMVectorAdd(column3, column0);
+	planes[Frustum::PLANE_RIGHT] = XMVectorSubtract(column3, column0);
+	planes[Frustum::PLANE_BOTTOM] = XMVectorAdd(column3, column1);
+	planes[Frustum::PLANE_TOP] = XMVectorSubtract(column3, column1);
+	planes[Frustum::PLANE_NEAR] = column2;
+	planes[Frustum::PLANE_FAR] = XMVectorSubtract(column3, column2);
+
+	// normalise so the plane distance is in world units, which the sphere test needs
+	for (int i = 0; i < Frustum::PLANE_COUNT; ++i)
+	{
+		XMStoreFloat4(&_frustum.planes[i], XMPlaneNormalize(planes[i]));
+	}
+}
+
+bool Culling::SphereInFrustum(const Frustum& _frustum, const XMFLOAT4& _sphere)
+{
+	XMVECTOR center = XMVectorSet(_sphere.x, _sphere.y, _sphere.z, 1.0f);
+	for (int i = 0; i < Frustum::PLANE_COUNT; ++i)
+	{
+		float distance = XMVectorGetX(XMVector4Dot(XMLoadFloat4(&_frustum.planes[i]), center));
+		if (distance < -_sphere.w)
+			return false;
+	}
+	return true;
+}
+
+XMFLOAT4 Culling::BoundingSphere(const XMFLOAT4X4& _world, float _localRadius)
+{
+	// the longest basis vector is the largest scale the matrix applies
+	float scaleX = std::sqrt(_world._11 * _world._11 + _world._12 * _world._12 + _world._13 * _world._13);
+	float scaleY = std::sqrt(_world._21 * _world._21 + _world._22 * _world._22 + _world._23 * _world._23);
+	float scaleZ = std::sqrt(_world._31 * _world._31 + _world._32 * _world._32 + _world._33 * _world._33);
+	float scale = std::max(scaleX, std::max(scaleY, scaleZ));
+	return XMFLOAT4(_world._41, _world._42, _world._43, _localRadius * scale);
+}
+
+float Culling::ProjectedError(float _error, const XMFLOAT4& _sphere, const XMFLOAT3& _eye, float _pixelsPerUnit)
+{
+	float dx = _sphere.x - _eye.x;
+	float dy = _sphere.y - _eye.y;
+	float dz = _sphere.z - _eye.z;
+	float distance = std::sqrt(dx * dx + dy * dy + dz * dz) - _sphere.w;
+	if (distance <= 0.0f)
+		return FLT_MAX;
+	return _error * _pixelsPerUnit / distance;
+}
+
+uint32_t Culling::SelectLod(const float* _pErrors, uint32_t _stride, uint32_t _lodCount, const XMFLOAT4X4& _world, const XMFLOAT4& _sphere,
+	const XMFLOAT3& _eye, float _pixelsPerUnit, float _maxPixelError)
+{
+	float scale = BoundingSphere(_world, 1.0f).w;
+	for (uint32_t lod = _lodCount > 0 ? _lodCount - 1 : 0; lod > 0; --lod)
+	{
+		float error = *reinterpret_cast<const float*>(reinterpret_cast<const uint8_t*>(_pErrors) + static_cast<size_t>(lod) * _stride);
+		if (ProjectedError(error * scale, _sphere, _eye, _pixelsPerUnit) <= _maxPixelError)
+			return lod;
+	}
+	return 0;
+}
+
+bool Culling::SpheresOverlap(const XMFLOAT4& _a, const XMFLOAT4& _b)
+{
+	float dx = _a.x - _b.x;
+	float dy = _a.y - _b.y;
+	float dz = _a.z - _b.z;
+	float radius = _a.w + _b.w;
+	return dx * dx + dy * dy + dz * dz <= radius * radius;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <DirectXMath.h>
+
+#include <cstdint>
+
+// planes are stored as (nx, ny, nz, d) with the normals pointing into the frustum, so a point p
+// is inside when dot(n, p) + d >= 0 for all six
+struct Frustum
+{
+	enum Plane
+	{
+		PLANE_LEFT = 0,
+		PLANE_RIGHT,
+		PLANE_BOTTOM,
+		PLANE_TOP,
+		PLANE_NEAR,
+		PLANE_FAR,
+		PLANE_COUNT
+	};
+
+	DirectX::XMFLOAT4 planes[PLANE_COUNT];
+};
+
+namespace Culling
+{
+	// pulls the planes out of a view * projection matrix. uses the same row vector convention as the rest of
+	// the renderer (v * M) and d3d's 0..1 clip depth. pass a projection matrix alone to get view space planes
+	void ExtractFrustum(const DirectX::XMFLOAT4X4& _viewProj, Frustum& _frustum);
+
+	// _sphere is (center xyz, radius). conservative: a sphere outside the frustum near a corner can pass
+	bool SphereInFrustum(const Frustum& _frustum, const DirectX::XMFLOAT4& _sphere);
+
+	// moves a sphere of _localRadius around the object's origin into world space. non uniform scale uses the longest axis
+	DirectX::XMFLOAT4 BoundingSphere(const DirectX::XMFLOAT4X4& _world, float _localRadius);
+
+	// how many pixels _error world units cover at the nearest point of _sphere to _eye. _pixelsPerUnit is what one
+	// unit covers at a distance of one, the projection's _22 times half the viewport's height. FLT_MAX with the eye
+	// inside the sphere
+	float ProjectedError(float _error, const DirectX::XMFLOAT4& _sphere, const DirectX::XMFLOAT3& _eye, float _pixelsPerUnit);
+
+	// the coarsest of _lodCount levels whose error stays within _maxPixelError pixels on screen, 0 when none does.
+	// the errors are object space floats read _stride bytes apart, level 0 first, and grow with _world's scale like
+	// _sphere (the object's world space bounds) did
+	uint32_t SelectLod(const float* _pErrors, uint32_t _stride, uint32_t _lodCount, const DirectX::XMFLOAT4X4& _world, const DirectX::XMFLOAT4& _sphere,
+		const DirectX::XMFLOAT3& _eye, float _pixelsPerUnit, float _maxPixelError);
+
+	// true when two (center xyz, radius) spheres touch
+	bool SpheresOverlap(const DirectX::XMFLOAT4& _a, const DirectX::XMFLOAT4& _b);
+}
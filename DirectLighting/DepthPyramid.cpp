@@ -0,0 +1,118 @@
+#include "DepthPyramid.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "JobSystem.h"
+
+using namespace DirectX;
+
+namespace
+{
+	const uint32_t ROWS_PER_JOB = 64;
+}
+
+void DepthPyramid::Build(const float* _pDepth, uint32_t _width, uint32_t _height, JobSystem* _pJobSystem)
+{
+	m_levels.clear();
+	if (_width == 0 || _height == 0)
+		return;
+
+	Level base;
+	base.width = _width;
+	base.height = _height;
+	base.depth.assign(_pDepth, _pDepth + static_cast<size_t>(_width) * _height);
+	m_levels.push_back(std::move(base));
+
+	// sizes round up, so an odd row or column is folded into the last texel instead of lost
+	while (m_levels.back().width > 1 || m_levels.back().height > 1)
+	{
+		const Level& source = m_levels.back();
+		Level level;
+		level.width = (source.width + 1) / 2;
+		level.height = (source.height + 1) / 2;
+		level.depth.resize(static_cast<size_t>(level.width) * level.height);
+
+		auto reduceRows = [&](unsigned int _begin, unsigned int _end)
+		{
+			for (unsigned int y = _begin; y < _end; ++y)
+			{
+				uint32_t y0 = y * 2;
+				uint32_t y1 = std::min(y0 + 1, source.height - 1);
+				for (uint32_t x = 0; x < level.width; ++x)
+				{
+					uint32_t x0 = x * 2;
+					uint32_t x1 = std::min(x0 + 1, source.width - 1);
+					float farthest = std::max(std::max(source.depth[y0 * source.width + x0], source.depth[y0 * source.width + x1]),
+						std::max(source.depth[y1 * source.width + x0], source.depth[y1 * source.width + x1]));
+					level.depth[y * level.width + x] = farthest;
+				}
+			}
+		};
+		if (_pJobSystem && level.height > ROWS_PER_JOB)
+			_pJobSystem->ParallelFor(level.height, ROWS_PER_JOB, reduceRows);
+		else
+			reduceRows(0, level.height);
+		m_levels.push_back(std::move(level));
+	}
+}
+
+bool DepthPyramid::SphereOccluded(const XMFLOAT4& _sphere, const XMFLOAT4X4& _viewProj)
+{
+	if (m_levels.empty())
+		return false;
+
+	// the corners of the box around the sphere give its screen rectangle and its nearest depth
+	XMMATRIX viewProj = XMLoadFloat4x4(&_viewProj);
+	float minX = 1.0f;
+	float maxX = -1.0f;
+	float minY = 1.0f;
+	float maxY = -1.0f;
+	float nearest = 1.0f;
+	for (uint32_t corner = 0; corner < 8; ++corner)
+	{
+		XMVECTOR point = XMVectorSet(
+			_sphere.x + ((corner & 1) ? _sphere.w : -_sphere.w),
+			_sphere.y + ((corner & 2) ? _sphere.w : -_sphere.w),
+			_sphere.z + ((corner & 4) ? _sphere.w : -_sphere.w), 1.0f);
+		XMFLOAT4 clip;
+		XMStoreFloat4(&clip, XMVector4Transform(point, viewProj));
+		if (clip.w <= 0.0f || clip.z < 0.0f)
+			return false;
+		float x = clip.x / clip.w;
+		float y = clip.y / clip.w;
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minY = std::min(minY, y);
+		maxY = std::max(maxY, y);
+		nearest = std::min(nearest, clip.z / clip.w);
+	}
+	if (minX < -1.0f || maxX > 1.0f || minY < -1.0f || maxY > 1.0f)
+		return false;
+
+	// the rectangle in level 0 pixels, y down
+	const Level& base = m_levels[0];
+	float left = (minX * 0.5f + 0.5f) * base.width;
+	float right = (maxX * 0.5f + 0.5f) * base.width;
+	float top = (0.5f - maxY * 0.5f) * base.height;
+	float bottom = (0.5f - minY * 0.5f) * base.height;
+
+	// the level where the rectangle is at most two texels across, so it touches at most three in each direction
+	float size = std::max(std::max(right - left, bottom - top), 1.0f);
+	int wantedLevel = std::max(static_cast<int>(std::ceil(std::log2(size * 0.5f))), 0);
+	uint32_t levelIndex = std::min(static_cast<uint32_t>(wantedLevel), static_cast<uint32_t>(m_levels.size() - 1));
+	const Level& level = m_levels[levelIndex];
+	float scale = 1.0f / static_cast<float>(1u << levelIndex);
+	uint32_t x0 = std::min(static_cast<uint32_t>(left * scale), level.width - 1);
+	uint32_t x1 = std::min(static_cast<uint32_t>(right * scale), level.width - 1);
+	uint32_t y0 = std::min(static_cast<uint32_t>(top * scale), level.height - 1);
+	uint32_t y1 = std::min(static_cast<uint32_t>(bottom * scale), level.height - 1);
+
+	float farthest = 0.0f;
+	for (uint32_t y = y0; y <= y1; ++y)
+	{
+		for (uint32_t x = x0; x <= x1; ++x)
+			farthest = std::max(farthest, level.depth[y * level.width + x]);
+	}
+	return nearest > farthest;
+}
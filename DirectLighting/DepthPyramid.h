@@ -0,0 +1,38 @@
+#pragma once
+#include <DirectXMath.h>
+
+#include <cstdint>
+#include <vector>
+
+class JobSystem;
+
+// a chain of ever smaller copies of a depth buffer (d3d depth, 0 at the near plane and 1 at the far one), each texel
+// holding the farthest depth of the four below it. anything whose nearest point is farther than the farthest depth
+// over the pixels it covers is hidden, and a sphere's whole screen rectangle can be checked with at most 3x3 reads
+// by picking the level where it is about two texels across.
+//
+// built from last frame's depth it finds what is still hidden this frame, conservatively only as long as the
+// camera has not moved much
+class DepthPyramid
+{
+public:
+	DepthPyramid() = default;
+	~DepthPyramid() = default;
+
+	// _pDepth is _width * _height values, row by row from the top of the screen
+	void Build(const float* _pDepth, uint32_t _width, uint32_t _height, JobSystem* _pJobSystem = nullptr);
+	bool IsBuilt() { return !m_levels.empty(); }
+
+	// true when the (center xyz, radius) world space sphere is entirely behind the depth. _viewProj is the matrix
+	// the depth was drawn with. spheres that reach the near plane or leave the screen are never occluded
+	bool SphereOccluded(const DirectX::XMFLOAT4& _sphere, const DirectX::XMFLOAT4X4& _viewProj);
+
+private:
+	struct Level
+	{
+		uint32_t width;
+		uint32_t height;
+		std::vector<float> depth;
+	};
+	std::vector<Level> m_levels; // level 0 is the depth buffer itself
+};
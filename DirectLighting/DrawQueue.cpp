@@ -0,0 +1,144 @@
+#include "DrawQueue.h"
+
+#include <cstring>
+
+#include "RadixSort.h"
+
+uint64_t SortKey::Make(uint32_t _pass, uint32_t _pipeline, uint32_t _material, float _viewDepth, bool _backToFront)
+{
+	// for a non negative float the raw bits compare in the same order as the value, so the depth can
+	// go into the key as is. anything behind the camera would have been culled, clamp it just in case
+	if (!(_viewDepth > 0.0f))
+		_viewDepth = 0.0f;
+	uint32_t depthBits;
+	memcpy(&depthBits, &_viewDepth, sizeof(depthBits));
+	if (_backToFront)
+		depthBits = ~depthBits;
+
+	uint64_t key = 0;
+	key |= static_cast<uint64_t>(_pass & ((1u << PASS_BITS) - 1)) << (PIPELINE_BITS + MATERIAL_BITS + DEPTH_BITS);
+	key |= static_cast<uint64_t>(_pipeline & ((1u << PIPELINE_BITS) - 1)) << (MATERIAL_BITS + DEPTH_BITS);
+	key |= static_cast<uint64_t>(_material & ((1u << MATERIAL_BITS) - 1)) << DEPTH_BITS;
+	key |= depthBits;
+	return key;
+}
+
+void DrawQueue::Clear()
+{
+	m_items.clear();
+	m_keys.clear();
+	m_order.clear();
+}
+
+void DrawQueue::Add(const DrawItem& _item, uint64_t _sortKey)
+{
+	m_order.push_back(static_cast<uint32_t>(m_items.size()));
+	m_items.push_back(_item);
+	m_keys.push_back(_sortKey);
+}
+
+uint64_t DrawQueue::MakeKey(const DrawItem& _item, uint32_t _pass, float _viewDepth, bool _backToFront)
+{
+	uint32_t pipeline = m_pipelineIds.emplace(std::make_pair(_item.pPipelineState, _item.pRootSignature),
+		static_cast<uint32_t>(m_pipelineIds.size())).first->second;
+	uint32_t material = m_materialIds.emplace(std::make_tuple(_item.pVertexBufferView, _item.pIndexBufferView, _item.rootConstantsParameter),
+		static_cast<uint32_t>(m_materialIds.size())).first->second;
+	return SortKey::Make(_pass, pipeline, material, _viewDepth, _backToFront);
+}
+
+void DrawQueue::Sort(JobSystem* _pJobSystem)
+{
+	m_tempKeys.resize(m_keys.size());
+	m_tempOrder.resize(m_order.size());
+	RadixSort64(m_keys.data(), m_order.data(), m_tempKeys.data(), m_tempOrder.data(), static_cast<uint32_t>(m_keys.size()), _pJobSystem);
+}
+
+void DrawQueue::Submit(GraphicsCommandRecorder& _recorder, const BindFunc& _bind)
+{
+	_recorder.IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+	ID3D12RootSignature* pBoundRootSignature = nullptr;
+	for (uint32_t index : m_order)
+	{
+		const DrawItem& item = m_items[index];
+		_recorder.SetPipelineState(item.pPipelineState);
+		_recorder.SetGraphicsRootSignature(item.pRootSignature);
+		if (_bind && item.pRootSignature != pBoundRootSignature)
+			_bind(item.pRootSignature);
+		pBoundRootSignature = item.pRootSignature;
+		_recorder.IASetVertexBuffer(*item.pVertexBufferView);
+		_recorder.IASetIndexBuffer(*item.pIndexBufferView);
+		_recorder.SetGraphicsRoot32BitConstants(item.rootConstantsParameter, item.num32BitConstants, item.pConstants, 0);
+		_recorder.DrawIndexedInstanced(item.indexCount, 1, item.startIndex, item.baseVertex, 0);
+	}
+}
+
+UINT DrawQueue::SubmitIndirect(GraphicsCommandRecorder& _recorder, const CommandSignatureFunc& _commandSignature, ID3D12Resource* _pArgumentBuffer,
+	IndirectDrawRecord* _pRecords, UINT _maxRecords, const Frustum& _frustum, JobSystem* _pJobSystem, const BindFunc& _bind)
+{
+	// the argument buffer can hold _maxRecords draws, so never hand more than that to the compaction
+	UINT count = static_cast<UINT>(m_order.size());
+	if (count > _maxRecords)
+		count = _maxRecords;
+
+	// start a new bucket whenever anything other than the root constants changes between sorted neighbours
+	m_indirectSources.resize(count);
+	m_bucketFirstItem.clear();
+	const DrawItem* pPrevious = nullptr;
+	for (UINT i = 0; i < count; ++i)
+	{
+		const DrawItem& item = m_items[m_order[i]];
+		if (pPrevious == nullptr ||
+			item.pPipelineState != pPrevious->pPipelineState ||
+			item.pRootSignature != pPrevious->pRootSignature ||
+			item.pVertexBufferView != pPrevious->pVertexBufferView ||
+			item.pIndexBufferView != pPrevious->pIndexBufferView ||
+			item.rootConstantsParameter != pPrevious->rootConstantsParameter)
+		{
+			m_bucketFirstItem.push_back(m_order[i]);
+		}
+		pPrevious = &item;
+
+		IndirectDrawSource& source = m_indirectSources[i];
+		source.boundingSphere = item.boundingSphere;
+		source.bucket = static_cast<uint32_t>(m_bucketFirstItem.size() - 1);
+		source.pRootConstants = item.pConstants;
+		source.draw.indexCountPerInstance = item.indexCount;
+		source.draw.instanceCount = 1;
+		source.draw.startIndexLocation = item.startIndex;
+		source.draw.baseVertexLocation = item.baseVertex;
+		source.draw.startInstanceLocation = 0;
+	}
+
+	UINT bucketCount = static_cast<UINT>(m_bucketFirstItem.size());
+	m_bucketOffsets.resize(bucketCount);
+	m_bucketCounts.resize(bucketCount);
+	UINT visible = CompactIndirectDraws(m_indirectSources.data(), count, _frustum, bucketCount, _pRecords,
+		m_bucketOffsets.data(), m_bucketCounts.data(), _pJobSystem);
+
+	_recorder.IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+	for (UINT bucket = 0; bucket < bucketCount; ++bucket)
+	{
+		if (m_bucketCounts[bucket] == 0)
+			continue;
+
+		// the first draw's state stands for the whole bucket, the root constants come from the records
+		const DrawItem& item = m_items[m_bucketFirstItem[bucket]];
+		ID3D12CommandSignature* pCommandSignature = _commandSignature(item.pRootSignature, item.rootConstantsParameter);
+		if (pCommandSignature == nullptr)
+		{
+			visible -= m_bucketCounts[bucket];
+			continue;
+		}
+		_recorder.SetPipelineState(item.pPipelineState);
+		_recorder.SetGraphicsRootSignature(item.pRootSignature);
+		if (_bind)
+			_bind(item.pRootSignature);
+		_recorder.IASetVertexBuffer(*item.pVertexBufferView);
+		_recorder.IASetIndexBuffer(*item.pIndexBufferView);
+		_recorder.ExecuteIndirect(pCommandSignature, m_bucketCounts[bucket], _pArgumentBuffer, m_bucketOffsets[bucket] * sizeof(IndirectDrawRecord));
+	}
+
+	return visible;
+}
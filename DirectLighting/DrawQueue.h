@@ -0,0 +1,124 @@
+#pragma once
+#include <Windows.h>
+#include <D3d12.h>
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <tuple>
+#include <vector>
+
+#include "CommandRecorder.h"
+#include "IndirectDraw.h"
+#include "JobSystem.h"
+
+// passes are drawn in this order
+enum RenderPass
+{
+	RENDER_PASS_OPAQUE = 0,
+	RENDER_PASS_TRANSPARENT = 1,
+	RENDER_PASS_COUNT
+};
+
+// a draw sort key, most significant bits first:
+//   pass (4) | pipeline (12) | material (16) | depth (32)
+// sorting the keys groups draws by pass, then pso, then material, so state changes only happen at group
+// boundaries, and within a group draws go front to back so early z rejects as much as possible
+namespace SortKey
+{
+	const uint32_t PASS_BITS = 4;
+	const uint32_t PIPELINE_BITS = 12;
+	const uint32_t MATERIAL_BITS = 16;
+	const uint32_t DEPTH_BITS = 32;
+
+	// _viewDepth is the view space z of the object. transparent draws want _backToFront so they blend correctly
+	uint64_t Make(uint32_t _pass, uint32_t _pipeline, uint32_t _material, float _viewDepth, bool _backToFront = false);
+
+	inline uint32_t Pass(uint64_t _key) { return static_cast<uint32_t>(_key >> (PIPELINE_BITS + MATERIAL_BITS + DEPTH_BITS)); }
+	inline uint32_t Pipeline(uint64_t _key) { return static_cast<uint32_t>(_key >> (MATERIAL_BITS + DEPTH_BITS)) & ((1u << PIPELINE_BITS) - 1); }
+	inline uint32_t Material(uint64_t _key) { return static_cast<uint32_t>(_key >> DEPTH_BITS) & ((1u << MATERIAL_BITS) - 1); }
+}
+
+// everything needed to record one draw. the pointers must stay valid until the queue is submitted
+struct DrawItem
+{
+	ID3D12PipelineState* pPipelineState;
+	ID3D12RootSignature* pRootSignature;
+	const D3D12_VERTEX_BUFFER_VIEW* pVertexBufferView;
+	const D3D12_INDEX_BUFFER_VIEW* pIndexBufferView;
+
+	UINT rootConstantsParameter; // root slot the per object constants go to
+	UINT num32BitConstants;
+	const void* pConstants;
+
+	UINT indexCount;
+	UINT startIndex;
+	INT baseVertex;
+
+	DirectX::XMFLOAT4 boundingSphere; // world space centre and radius, only used by the indirect path
+};
+
+// collects a frame's visible draws with their sort keys, sorts them and records them in key order
+class DrawQueue
+{
+public:
+	DrawQueue() = default;
+	~DrawQueue() = default;
+
+	void Clear();
+	void Add(const DrawItem& _item, uint64_t _sortKey);
+
+	// a command signature names the root signature and slot its constants go to, so a bucket needs the one made for both
+	typedef std::function<ID3D12CommandSignature*(ID3D12RootSignature* _pRootSignature, UINT _rootConstantsParameter)> CommandSignatureFunc;
+
+	// binds the root arguments every draw with that root signature shares, like the frame's lights. setting a root
+	// signature and ExecuteIndirect both leave them undefined, so this is called again after each
+	typedef std::function<void(ID3D12RootSignature* _pRootSignature)> BindFunc;
+
+	// a sort key for _item with its pipeline and material fields filled in. the pipeline is the pso and root signature,
+	// the material is everything else SubmitIndirect starts a new bucket on: the buffers and the constants' slot. each
+	// distinct one gets the next number the first time it is seen and keeps it across frames, so draws that can share
+	// a bucket sort next to each other. numbers past what the key holds wrap, which only costs some grouping
+	uint64_t MakeKey(const DrawItem& _item, uint32_t _pass, float _viewDepth, bool _backToFront = false);
+
+	// sorts with the parallel radix sort, the draws themselves do not move, only their indices
+	void Sort(JobSystem* _pJobSystem);
+
+	// records every draw in sorted order. the recorder drops the state that does not change between neighbours.
+	// _bind, if there is one, is called whenever the root signature changes
+	void Submit(GraphicsCommandRecorder& _recorder, const BindFunc& _bind = nullptr);
+
+	// culls the sorted draws and packs the visible ones into _pRecords, which must be _pArgumentBuffer mapped.
+	// neighbouring draws that share every piece of state but the root constants go out in a single ExecuteIndirect,
+	// so the number of api calls follows the number of state changes instead of the number of draws.
+	// _commandSignature gives each bucket a signature for its root signature and constants slot, which has to set
+	// the root constants then draw indexed, see IndirectDrawRecord. a bucket it has no signature for is not drawn.
+	// every draw in the queue must carry INDIRECT_ROOT_CONSTANTS values of root constants.
+	// _bind, if there is one, is called in front of every bucket.
+	// returns how many draws survived culling, anything past _maxRecords is dropped
+	UINT SubmitIndirect(GraphicsCommandRecorder& _recorder, const CommandSignatureFunc& _commandSignature, ID3D12Resource* _pArgumentBuffer,
+		IndirectDrawRecord* _pRecords, UINT _maxRecords, const Frustum& _frustum, JobSystem* _pJobSystem, const BindFunc& _bind = nullptr);
+
+	UINT Count() { return static_cast<UINT>(m_items.size()); }
+	const DrawItem& SortedItem(UINT _index) { return m_items[m_order[_index]]; }
+	uint64_t SortedKey(UINT _index) { return m_keys[_index]; }
+
+private:
+	std::vector<DrawItem> m_items;
+	std::vector<uint64_t> m_keys;
+	std::vector<uint32_t> m_order; // m_order[i] is the item with the i'th smallest key once sorted
+
+	// the numbers MakeKey hands out, kept from frame to frame
+	std::map<std::pair<const void*, const void*>, uint32_t> m_pipelineIds;
+	std::map<std::tuple<const void*, const void*, UINT>, uint32_t> m_materialIds;
+
+	// scratch for the sort, kept between frames so we do not allocate every frame
+	std::vector<uint64_t> m_tempKeys;
+	std::vector<uint32_t> m_tempOrder;
+
+	// scratch for the indirect path
+	std::vector<IndirectDrawSource> m_indirectSources;
+	std::vector<uint32_t> m_bucketFirstItem; // item whose state each bucket binds
+	std::vector<uint32_t> m_bucketOffsets;
+	std::vector<uint32_t> m_bucketCounts;
+};
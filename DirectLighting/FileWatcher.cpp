@@ -0,0 +1,214 @@
+#include "FileWatcher.h"
+
+#ifndef _WIN32
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+FileWatcher::~FileWatcher()
+{
+	Stop();
+}
+
+bool FileWatcher::Start(const std::string& _directory, unsigned int _debounceMs)
+{
+	if (m_running)
+		return true;
+
+	m_directory = _directory;
+	m_debounce = std::chrono::milliseconds(_debounceMs);
+
+#ifdef _WIN32
+	// FILE_FLAG_OVERLAPPED so the watch thread can wait on both the change and the stop event
+	m_hDirectory = CreateFileA(m_directory.c_str(),
+		FILE_LIST_DIRECTORY,
+		FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		nullptr,
+		OPEN_EXISTING,
+		FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED,
+		nullptr);
+	if (m_hDirectory == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	m_hStopEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+	if (m_hStopEvent == NULL)
+	{
+		CloseHandle(m_hDirectory);
+		m_hDirectory = INVALID_HANDLE_VALUE;
+		return false;
+	}
+#else
+	m_inotifyFd = inotify_init1(IN_NONBLOCK);
+	if (m_inotifyFd < 0)
+	{
+		return false;
+	}
+
+	// close_write catches in-place saves, moved_to catches editors that save to a temp file and rename it over
+	m_watchFd = inotify_add_watch(m_inotifyFd, m_directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+	if (m_watchFd < 0)
+	{
+		close(m_inotifyFd);
+		m_inotifyFd = -1;
+		return false;
+	}
+#endif
+
+	m_running = true;
+	m_thread = std::thread(&FileWatcher::WatchLoop, this);
+	return true;
+}
+
+void FileWatcher::Stop()
+{
+	if (!m_running)
+		return;
+
+	m_running = false;
+#ifdef _WIN32
+	SetEvent(m_hStopEvent);
+#endif
+	if (m_thread.joinable())
+		m_thread.join();
+
+#ifdef _WIN32
+	CloseHandle(m_hStopEvent);
+	m_hStopEvent = NULL;
+	CloseHandle(m_hDirectory);
+	m_hDirectory = INVALID_HANDLE_VALUE;
+#else
+	inotify_rm_watch(m_inotifyFd, m_watchFd);
+	close(m_inotifyFd);
+	m_watchFd = -1;
+	m_inotifyFd = -1;
+#endif
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_pending.clear();
+}
+
+void FileWatcher::PollChanges(std::vector<std::string>& _changedFiles)
+{
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (auto it = m_pending.begin(); it != m_pending.end();)
+	{
+		// still being written to, leave it for a later poll
+		if (now - it->second < m_debounce)
+		{
+			++it;
+			continue;
+		}
+		_changedFiles.push_back(it->first);
+		it = m_pending.erase(it);
+	}
+}
+
+void FileWatcher::OnFileChanged(const std::string& _fileName)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_pending[_fileName] = std::chrono::steady_clock::now();
+}
+
+void FileWatcher::WatchLoop()
+{
+#ifdef _WIN32
+	// DWORD aligned buffer that ReadDirectoryChangesW fills with FILE_NOTIFY_INFORMATION records
+	DWORD buffer[4096];
+	OVERLAPPED overlapped = {};
+	overlapped.hEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+	if (overlapped.hEvent == NULL)
+	{
+		m_running = false;
+		return;
+	}
+
+	HANDLE waitHandles[] = { overlapped.hEvent, m_hStopEvent };
+	while (m_running)
+	{
+		ResetEvent(overlapped.hEvent);
+		BOOL issued = ReadDirectoryChangesW(m_hDirectory,
+			buffer,
+			sizeof(buffer),
+			FALSE, // only the top level directory
+			FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE,
+			nullptr,
+			&overlapped,
+			nullptr);
+		if (!issued)
+		{
+			break;
+		}
+
+		DWORD signalled = WaitForMultipleObjects(_countof(waitHandles), waitHandles, FALSE, INFINITE);
+		if (signalled != WAIT_OBJECT_0)
+		{
+			// stop was requested, cancel the outstanding read before the buffer goes out of scope
+			CancelIoEx(m_hDirectory, &overlapped);
+			DWORD ignored;
+			GetOverlappedResult(m_hDirectory, &overlapped, &ignored, TRUE);
+			break;
+		}
+
+		DWORD bytesReturned = 0;
+		if (!GetOverlappedResult(m_hDirectory, &overlapped, &bytesReturned, FALSE) || bytesReturned == 0)
+		{
+			// the buffer overflowed and the changes were lost, carry on watching
+			continue;
+		}
+
+		BYTE* pRecord = reinterpret_cast<BYTE*>(buffer);
+		while (true)
+		{
+			FILE_NOTIFY_INFORMATION* pInfo = reinterpret_cast<FILE_NOTIFY_INFORMATION*>(pRecord);
+			if (pInfo->Action == FILE_ACTION_MODIFIED || pInfo->Action == FILE_ACTION_ADDED || pInfo->Action == FILE_ACTION_RENAMED_NEW_NAME)
+			{
+				// FileNameLength is in bytes and the name is not null terminated
+				int wideLength = static_cast<int>(pInfo->FileNameLength / sizeof(WCHAR));
+				int length = WideCharToMultiByte(CP_ACP, 0, pInfo->FileName, wideLength, nullptr, 0, nullptr, nullptr);
+				std::string fileName(length, '\0');
+				WideCharToMultiByte(CP_ACP, 0, pInfo->FileName, wideLength, &fileName[0], length, nullptr, nullptr);
+				OnFileChanged(fileName);
+			}
+
+			if (pInfo->NextEntryOffset == 0)
+				break;
+			pRecord += pInfo->NextEntryOffset;
+		}
+	}
+
+	CloseHandle(overlapped.hEvent);
+#else
+	// inotify_event records are variable length, align the buffer for the first one
+	alignas(inotify_event) char buffer[4096];
+	pollfd descriptor = {};
+	descriptor.fd = m_inotifyFd;
+	descriptor.events = POLLIN;
+
+	while (m_running)
+	{
+		// wake up regularly so Stop() does not have to wait for a change
+		int ready = poll(&descriptor, 1, 100);
+		if (ready <= 0)
+			continue;
+
+		ssize_t bytesRead = read(m_inotifyFd, buffer, sizeof(buffer));
+		if (bytesRead <= 0)
+			continue;
+
+		for (char* pRecord = buffer; pRecord < buffer + bytesRead;)
+		{
+			inotify_event* pEvent = reinterpret_cast<inotify_event*>(pRecord);
+			if (pEvent->len > 0 && !(pEvent->mask & IN_ISDIR))
+			{
+				OnFileChanged(std::string(pEvent->name));
+			}
+			pRecord += sizeof(inotify_event) + pEvent->len;
+		}
+	}
+#endif
+}
@@ -0,0 +1,50 @@
+#pragma once
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// watches a single directory on a background thread (ReadDirectoryChangesW on windows, inotify on linux).
+// editors tend to write a file several times per save, so a change is only reported once the file
+// has been quiet for the debounce window
+class FileWatcher
+{
+public:
+	FileWatcher() = default;
+	~FileWatcher();
+
+	bool Start(const std::string& _directory, unsigned int _debounceMs = 200);
+	void Stop();
+
+	// appends the names (relative to the watched directory) of files that have settled since the last call
+	void PollChanges(std::vector<std::string>& _changedFiles);
+
+	bool IsRunning() { return m_running; }
+
+private:
+	void WatchLoop();
+	void OnFileChanged(const std::string& _fileName);
+
+	std::string m_directory;
+	std::chrono::milliseconds m_debounce{ 200 };
+
+	std::thread m_thread;
+	std::atomic<bool> m_running{ false };
+
+	std::mutex m_mutex;
+	std::unordered_map<std::string, std::chrono::steady_clock::time_point> m_pending; // file name -> time of its last change
+
+#ifdef _WIN32
+	HANDLE m_hDirectory = INVALID_HANDLE_VALUE;
+	HANDLE m_hStopEvent = NULL;
+#else
+	int m_inotifyFd = -1;
+	int m_watchFd = -1;
+#endif
+};
@@ -0,0 +1,425 @@
+#include "FrameGraph.h"
+
+#include <algorithm>
+
+namespace
+{
+	bool IsReadOnly(uint32_t _state)
+	{
+		return _state != 0 && (_state & ~FG_READ_STATES) == 0;
+	}
+
+	uint64_t AlignUp(uint64_t _value, uint64_t _alignment)
+	{
+		if (_alignment == 0)
+			return _value;
+		return (_value + _alignment - 1) / _alignment * _alignment;
+	}
+}
+
+void FrameGraph::Reset()
+{
+	m_passes.clear();
+	m_resources.clear();
+	m_barriers.clear();
+	m_finalBarrierBegin = 0;
+	m_finalBarrierCount = 0;
+	m_stats = FrameGraphStats();
+}
+
+uint32_t FrameGraph::Import(const std::string& _name, uint32_t _initialState, uint32_t _finalState)
+{
+	Resource resource;
+	resource.name = _name;
+	resource.initialState = _initialState;
+	resource.finalState = _finalState;
+	m_resources.push_back(resource);
+	return static_cast<uint32_t>(m_resources.size() - 1);
+}
+
+uint32_t FrameGraph::CreateTransient(const std::string& _name, const TransientDesc& _desc)
+{
+	Resource resource;
+	resource.name = _name;
+	resource.transient = true;
+	resource.desc = _desc;
+	m_resources.push_back(resource);
+	return static_cast<uint32_t>(m_resources.size() - 1);
+}
+
+uint32_t FrameGraph::AddPass(const std::string& _name, ExecuteFunc _execute)
+{
+	Pass pass;
+	pass.name = _name;
+	pass.execute = _execute;
+	m_passes.push_back(pass);
+	return static_cast<uint32_t>(m_passes.size() - 1);
+}
+
+void FrameGraph::Read(uint32_t _pass, uint32_t _resource, uint32_t _state)
+{
+	AddUse(_pass, _resource, _state, ACCESS_READ);
+}
+
+void FrameGraph::Write(uint32_t _pass, uint32_t _resource, uint32_t _state)
+{
+	AddUse(_pass, _resource, _state, ACCESS_WRITE);
+}
+
+void FrameGraph::ReadWrite(uint32_t _pass, uint32_t _resource, uint32_t _state)
+{
+	AddUse(_pass, _resource, _state, ACCESS_READ_WRITE);
+}
+
+void FrameGraph::SetSideEffects(uint32_t _pass)
+{
+	m_passes[_pass].sideEffects = true;
+}
+
+void FrameGraph::AddUse(uint32_t _pass, uint32_t _resource, uint32_t _state, Access _access)
+{
+	ResourceUse use;
+	use.resource = _resource;
+	use.state = _state;
+	use.access = _access;
+	m_passes[_pass].uses.push_back(use);
+}
+
+bool FrameGraph::Compile()
+{
+	m_barriers.clear();
+	m_stats = FrameGraphStats();
+	m_stats.passesDeclared = static_cast<uint32_t>(m_passes.size());
+
+	CullPasses();
+	PlaceTransients();
+	return BuildBarriers();
+}
+
+void FrameGraph::CullPasses()
+{
+	// walk backwards keeping track of which resources still have a reader waiting on their contents.
+	// imported resources are read after the frame, so their contents are wanted from the start.
+	// a pass is live if it writes something that is wanted. a full Write satisfies the reader, so passes
+	// before it that wrote the same resource are not needed for it, and whatever a live pass reads becomes wanted
+	std::vector<bool> wanted(m_resources.size());
+	for (size_t i = 0; i < m_resources.size(); ++i)
+	{
+		wanted[i] = !m_resources[i].transient;
+	}
+
+	for (size_t p = m_passes.size(); p-- > 0;)
+	{
+		Pass& pass = m_passes[p];
+		pass.live = pass.sideEffects;
+		for (const ResourceUse& use : pass.uses)
+		{
+			if (use.access != ACCESS_READ && wanted[use.resource])
+				pass.live = true;
+		}
+
+		if (!pass.live)
+		{
+			m_stats.passesCulled++;
+			continue;
+		}
+
+		for (const ResourceUse& use : pass.uses)
+		{
+			if (use.access == ACCESS_WRITE)
+				wanted[use.resource] = false;
+		}
+		for (const ResourceUse& use : pass.uses)
+		{
+			if (use.access != ACCESS_WRITE)
+				wanted[use.resource] = true;
+		}
+	}
+
+	// lifetimes only count live passes
+	for (Resource& resource : m_resources)
+	{
+		resource.firstPass = INVALID_HANDLE;
+		resource.lastPass = INVALID_HANDLE;
+		resource.aliased = false;
+		resource.heapOffset = 0;
+	}
+	for (uint32_t p = 0; p < m_passes.size(); ++p)
+	{
+		if (!m_passes[p].live)
+			continue;
+		for (const ResourceUse& use : m_passes[p].uses)
+		{
+			Resource& resource = m_resources[use.resource];
+			if (resource.firstPass == INVALID_HANDLE)
+				resource.firstPass = p;
+			resource.lastPass = p;
+		}
+	}
+}
+
+void FrameGraph::PlaceTransients()
+{
+	// biggest first, then each one goes at the lowest offset that does not overlap anything alive at the same time.
+	// this is the usual greedy interval packing, it is not optimal but gets close for the handful of targets a frame has
+	std::vector<uint32_t> order;
+	for (uint32_t i = 0; i < m_resources.size(); ++i)
+	{
+		if (m_resources[i].transient && m_resources[i].firstPass != INVALID_HANDLE)
+			order.push_back(i);
+	}
+	std::sort(order.begin(), order.end(), [this](uint32_t _a, uint32_t _b)
+	{
+		const Resource& a = m_resources[_a];
+		const Resource& b = m_resources[_b];
+		if (a.desc.sizeInBytes != b.desc.sizeInBytes)
+			return a.desc.sizeInBytes > b.desc.sizeInBytes;
+		if (a.firstPass != b.firstPass)
+			return a.firstPass < b.firstPass;
+		return _a < _b;
+	});
+
+	std::vector<uint32_t> placed;
+	for (uint32_t index : order)
+	{
+		Resource& resource = m_resources[index];
+		m_stats.transientBytes += resource.desc.sizeInBytes;
+
+		// the answer is either 0 or just past the end of a block that is alive at the same time
+		std::vector<uint64_t> candidates(1, 0);
+		for (uint32_t other : placed)
+		{
+			const Resource& block = m_resources[other];
+			if (block.firstPass <= resource.lastPass && resource.firstPass <= block.lastPass)
+				candidates.push_back(block.heapOffset + block.desc.sizeInBytes);
+		}
+		std::sort(candidates.begin(), candidates.end());
+
+		for (uint64_t candidate : candidates)
+		{
+			uint64_t offset = AlignUp(candidate, resource.desc.alignment);
+			bool fits = true;
+			for (uint32_t other : placed)
+			{
+				const Resource& block = m_resources[other];
+				bool livesTogether = block.firstPass <= resource.lastPass && resource.firstPass <= block.lastPass;
+				bool overlaps = offset < block.heapOffset + block.desc.sizeInBytes && block.heapOffset < offset + resource.desc.sizeInBytes;
+				if (livesTogether && overlaps)
+				{
+					fits = false;
+					break;
+				}
+			}
+			if (fits)
+			{
+				resource.heapOffset = offset;
+				break;
+			}
+		}
+
+		placed.push_back(index);
+		m_stats.heapBytes = std::max(m_stats.heapBytes, resource.heapOffset + resource.desc.sizeInBytes);
+	}
+
+	// a resource whose memory another transient uses needs an aliasing barrier in front of its first pass. that goes
+	// for the first owner of the memory too, the last owner from the previous frame is still the active one
+	for (uint32_t a : placed)
+	{
+		for (uint32_t b : placed)
+		{
+			if (a != b && Overlaps(a, b))
+			{
+				m_resources[a].aliased = true;
+				break;
+			}
+		}
+	}
+}
+
+bool FrameGraph::Overlaps(uint32_t _a, uint32_t _b)
+{
+	const Resource& a = m_resources[_a];
+	const Resource& b = m_resources[_b];
+	return a.heapOffset < b.heapOffset + b.desc.sizeInBytes && b.heapOffset < a.heapOffset + a.desc.sizeInBytes;
+}
+
+bool FrameGraph::BuildBarriers()
+{
+	std::vector<uint32_t> current(m_resources.size());
+	std::vector<bool> lastUseWrote(m_resources.size(), false);
+	for (uint32_t i = 0; i < m_resources.size(); ++i)
+	{
+		Resource& resource = m_resources[i];
+		if (!resource.transient || resource.firstPass == INVALID_HANDLE)
+		{
+			current[i] = resource.initialState;
+			continue;
+		}
+
+		// transients start the frame in whatever state their first pass wants, and the first pass has to fill them
+		const Pass& first = m_passes[resource.firstPass];
+		uint32_t state = 0;
+		for (const ResourceUse& use : first.uses)
+		{
+			if (use.resource != i)
+				continue;
+			if (use.access != ACCESS_WRITE)
+				return false;
+			state |= use.state;
+		}
+		resource.initialState = state;
+		resource.finalState = state;
+		current[i] = state;
+	}
+
+	for (uint32_t p = 0; p < m_passes.size(); ++p)
+	{
+		Pass& pass = m_passes[p];
+		pass.barrierBegin = static_cast<uint32_t>(m_barriers.size());
+		pass.barrierCount = 0;
+		if (!pass.live)
+			continue;
+
+		// a pass can use the same resource more than once (read as depth and as a texture), merge them first
+		std::vector<uint32_t> resources;
+		std::vector<uint32_t> states;
+		std::vector<bool> writes;
+		for (const ResourceUse& use : pass.uses)
+		{
+			size_t slot = std::find(resources.begin(), resources.end(), use.resource) - resources.begin();
+			if (slot == resources.size())
+			{
+				resources.push_back(use.resource);
+				states.push_back(0);
+				writes.push_back(false);
+			}
+			states[slot] |= use.state;
+			if (use.access != ACCESS_READ)
+				writes[slot] = true;
+		}
+
+		for (size_t i = 0; i < resources.size(); ++i)
+		{
+			uint32_t index = resources[i];
+			const Resource& resource = m_resources[index];
+			uint32_t wanted = states[i];
+
+			if (resource.transient && resource.firstPass == p && resource.aliased)
+			{
+				// whatever had the memory before this frame is done with is put back in its final state now, while it
+				// still owns the memory. once the aliasing barrier hands it over, a transition could decompress or
+				// change the layout of memory that belongs to this resource
+				for (uint32_t other = 0; other < m_resources.size(); ++other)
+				{
+					const Resource& earlier = m_resources[other];
+					if (!earlier.transient || earlier.firstPass == INVALID_HANDLE || earlier.lastPass >= p || !Overlaps(index, other) ||
+						current[other] == earlier.finalState)
+						continue;
+					FrameGraphBarrier restore = { FrameGraphBarrier::TYPE_TRANSITION, other, current[other], earlier.finalState };
+					m_barriers.push_back(restore);
+					current[other] = earlier.finalState;
+				}
+				FrameGraphBarrier barrier = { FrameGraphBarrier::TYPE_ALIASING, index, 0, 0 };
+				m_barriers.push_back(barrier);
+			}
+
+			if (IsReadOnly(wanted))
+			{
+				// already readable the way this pass wants
+				if (IsReadOnly(current[index]) && (current[index] & wanted) == wanted)
+				{
+					lastUseWrote[index] = false;
+					continue;
+				}
+
+				// fold in every read until the next write, so a run of readers costs one transition
+				for (uint32_t next = p + 1; next < m_passes.size(); ++next)
+				{
+					if (!m_passes[next].live)
+						continue;
+					bool written = false;
+					uint32_t read = 0;
+					for (const ResourceUse& use : m_passes[next].uses)
+					{
+						if (use.resource != index)
+							continue;
+						if (use.access != ACCESS_READ || !IsReadOnly(use.state))
+							written = true;
+						else
+							read |= use.state;
+					}
+					if (written)
+						break;
+					wanted |= read;
+				}
+			}
+
+			if (current[index] != wanted)
+			{
+				FrameGraphBarrier barrier = { FrameGraphBarrier::TYPE_TRANSITION, index, current[index], wanted };
+				m_barriers.push_back(barrier);
+				current[index] = wanted;
+			}
+			else if (wanted == FG_STATE_UNORDERED_ACCESS && lastUseWrote[index])
+			{
+				FrameGraphBarrier barrier = { FrameGraphBarrier::TYPE_UAV, index, 0, 0 };
+				m_barriers.push_back(barrier);
+			}
+			lastUseWrote[index] = writes[i];
+		}
+
+		pass.barrierCount = static_cast<uint32_t>(m_barriers.size()) - pass.barrierBegin;
+		if (pass.barrierCount > 0)
+			m_stats.barrierBatches++;
+	}
+
+	// put everything back where the next frame expects to find it. transients that handed their memory on were put
+	// back before they did, so this only finds the ones that still own theirs
+	m_finalBarrierBegin = static_cast<uint32_t>(m_barriers.size());
+	for (uint32_t i = 0; i < m_resources.size(); ++i)
+	{
+		const Resource& resource = m_resources[i];
+		if (resource.transient && resource.firstPass == INVALID_HANDLE)
+			continue;
+		if (current[i] != resource.finalState)
+		{
+			FrameGraphBarrier barrier = { FrameGraphBarrier::TYPE_TRANSITION, i, current[i], resource.finalState };
+			m_barriers.push_back(barrier);
+		}
+	}
+	m_finalBarrierCount = static_cast<uint32_t>(m_barriers.size()) - m_finalBarrierBegin;
+	if (m_finalBarrierCount > 0)
+		m_stats.barrierBatches++;
+
+	m_stats.barriers = static_cast<uint32_t>(m_barriers.size());
+	return true;
+}
+
+void FrameGraph::Execute(const BarrierFunc& _barriers)
+{
+	for (Pass& pass : m_passes)
+	{
+		if (!pass.live)
+			continue;
+		if (pass.barrierCount > 0)
+			_barriers(&m_barriers[pass.barrierBegin], pass.barrierCount);
+		if (pass.execute)
+			pass.execute();
+	}
+
+	if (m_finalBarrierCount > 0)
+		_barriers(&m_barriers[m_finalBarrierBegin], m_finalBarrierCount);
+}
+
+void FrameGraph::PassBarriers(uint32_t _pass, const FrameGraphBarrier** _ppBarriers, uint32_t* _pCount)
+{
+	const Pass& pass = m_passes[_pass];
+	*_pCount = pass.live ? pass.barrierCount : 0;
+	*_ppBarriers = *_pCount > 0 ? &m_barriers[pass.barrierBegin] : nullptr;
+}
+
+void FrameGraph::FinalBarriers(const FrameGraphBarrier** _ppBarriers, uint32_t* _pCount)
+{
+	*_pCount = m_finalBarrierCount;
+	*_ppBarriers = m_finalBarrierCount > 0 ? &m_barriers[m_finalBarrierBegin] : nullptr;
+}
@@ -0,0 +1,183 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// resource states, same values as D3D12_RESOURCE_STATES so they can be cast straight across.
+// redeclared so the graph can be built and compiled without any d3d headers
+enum FrameGraphState : uint32_t
+{
+	FG_STATE_COMMON = 0,
+	FG_STATE_VERTEX_AND_CONSTANT_BUFFER = 0x1,
+	FG_STATE_INDEX_BUFFER = 0x2,
+	FG_STATE_RENDER_TARGET = 0x4,
+	FG_STATE_UNORDERED_ACCESS = 0x8,
+	FG_STATE_DEPTH_WRITE = 0x10,
+	FG_STATE_DEPTH_READ = 0x20,
+	FG_STATE_NON_PIXEL_SHADER_RESOURCE = 0x40,
+	FG_STATE_PIXEL_SHADER_RESOURCE = 0x80,
+	FG_STATE_INDIRECT_ARGUMENT = 0x200,
+	FG_STATE_COPY_DEST = 0x400,
+	FG_STATE_COPY_SOURCE = 0x800,
+	FG_STATE_PRESENT = 0
+};
+
+// states that only read. any number of them can be combined into one state, so a resource that is read
+// in different ways by several passes in a row only needs a single transition
+const uint32_t FG_READ_STATES = FG_STATE_VERTEX_AND_CONSTANT_BUFFER | FG_STATE_INDEX_BUFFER | FG_STATE_DEPTH_READ |
+	FG_STATE_NON_PIXEL_SHADER_RESOURCE | FG_STATE_PIXEL_SHADER_RESOURCE | FG_STATE_INDIRECT_ARGUMENT | FG_STATE_COPY_SOURCE;
+
+// a texture the graph owns for part of a frame. size and alignment come from the device
+// (GetResourceAllocationInfo), everything else is only carried through for whoever creates it
+struct TransientDesc
+{
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint32_t format = 0; // DXGI_FORMAT
+	uint32_t flags = 0; // D3D12_RESOURCE_FLAGS
+	float clearValue[4] = { 0.0f, 0.0f, 0.0f, 0.0f }; // colour, or depth in [0] and stencil in [1]
+	uint64_t sizeInBytes = 0;
+	uint64_t alignment = 0;
+};
+
+struct FrameGraphBarrier
+{
+	enum Type
+	{
+		TYPE_TRANSITION = 0,
+		TYPE_ALIASING, // resource is about to use memory another transient uses this frame, or used last frame
+		TYPE_UAV // unordered access writes have to finish before the next unordered access
+	};
+
+	Type type;
+	uint32_t resource;
+	uint32_t before; // FrameGraphState, transitions only
+	uint32_t after;
+};
+
+struct FrameGraphStats
+{
+	uint32_t passesDeclared = 0;
+	uint32_t passesCulled = 0;
+	uint32_t barriers = 0;
+	uint32_t barrierBatches = 0;
+	uint64_t transientBytes = 0; // what the transients would take with a resource each
+	uint64_t heapBytes = 0; // what they take once aliased
+};
+
+// passes declare the resources they read and write, and the graph works out the rest:
+// - passes whose results nothing uses are culled
+// - the barriers in front of each pass are worked out from the declared states and sent as one batch
+// - transient resources whose lifetimes do not overlap are given the same memory
+// building and compiling the graph does not touch d3d, Execute hands the barriers and passes back to the caller.
+// passes run in the order they are added, so add them in an order that respects their dependencies
+class FrameGraph
+{
+public:
+	static const uint32_t INVALID_HANDLE = 0xffffffff;
+
+	typedef std::function<void()> ExecuteFunc;
+	typedef std::function<void(const FrameGraphBarrier* _pBarriers, uint32_t _count)> BarrierFunc;
+
+	FrameGraph() = default;
+	~FrameGraph() = default;
+
+	// forgets every pass and resource, call at the start of each frame
+	void Reset();
+
+	// a resource that lives outside the graph, like the back buffer. it is in _initialState when the frame starts and
+	// is put in _finalState at the end. imported resources count as outputs, so the passes writing them are never culled
+	uint32_t Import(const std::string& _name, uint32_t _initialState, uint32_t _finalState);
+
+	// a resource that only lives for part of the frame. it can share memory with any transient it is never alive at
+	// the same time as, so the first pass to use it has to Write it (clear or fully overwrite it)
+	uint32_t CreateTransient(const std::string& _name, const TransientDesc& _desc);
+
+	uint32_t AddPass(const std::string& _name, ExecuteFunc _execute);
+
+	// the pass uses the resource in _state. Write means the pass replaces the whole contents, ReadWrite means it
+	// keeps what was there (blending, depth testing against an earlier pass)
+	void Read(uint32_t _pass, uint32_t _resource, uint32_t _state);
+	void Write(uint32_t _pass, uint32_t _resource, uint32_t _state);
+	void ReadWrite(uint32_t _pass, uint32_t _resource, uint32_t _state);
+
+	// the pass does something the graph cannot see (readback, present), so it is never culled
+	void SetSideEffects(uint32_t _pass);
+
+	// culls passes, places transients and works out the barriers. returns false if the graph is malformed
+	// (a transient read before anything writes it)
+	bool Compile();
+
+	// for each pass that survived: sends its barrier batch, then runs it. the last batch puts imported resources
+	// back in their final states
+	void Execute(const BarrierFunc& _barriers);
+
+	uint32_t ResourceCount() { return static_cast<uint32_t>(m_resources.size()); }
+	bool IsTransient(uint32_t _resource) { return m_resources[_resource].transient; }
+	const TransientDesc& Desc(uint32_t _resource) { return m_resources[_resource].desc; }
+	uint64_t HeapOffset(uint32_t _resource) { return m_resources[_resource].heapOffset; } // transients used by a live pass only
+	bool IsUsed(uint32_t _resource) { return m_resources[_resource].firstPass != INVALID_HANDLE; }
+	uint32_t InitialState(uint32_t _resource) { return m_resources[_resource].initialState; } // for transients, the state the first pass wants
+	const std::string& ResourceName(uint32_t _resource) { return m_resources[_resource].name; }
+
+	bool IsPassCulled(uint32_t _pass) { return !m_passes[_pass].live; }
+	uint64_t HeapSize() { return m_stats.heapBytes; }
+	const FrameGraphStats& Stats() { return m_stats; }
+
+	// the barrier batch in front of a pass, and the one after the last pass
+	void PassBarriers(uint32_t _pass, const FrameGraphBarrier** _ppBarriers, uint32_t* _pCount);
+	void FinalBarriers(const FrameGraphBarrier** _ppBarriers, uint32_t* _pCount);
+
+private:
+	enum Access
+	{
+		ACCESS_READ = 0,
+		ACCESS_WRITE,
+		ACCESS_READ_WRITE
+	};
+
+	struct ResourceUse
+	{
+		uint32_t resource;
+		uint32_t state;
+		Access access;
+	};
+
+	struct Pass
+	{
+		std::string name;
+		ExecuteFunc execute;
+		std::vector<ResourceUse> uses;
+		bool sideEffects = false;
+		bool live = false;
+		uint32_t barrierBegin = 0;
+		uint32_t barrierCount = 0;
+	};
+
+	struct Resource
+	{
+		std::string name;
+		bool transient = false;
+		TransientDesc desc;
+		uint32_t initialState = FG_STATE_COMMON;
+		uint32_t finalState = FG_STATE_COMMON;
+		uint32_t firstPass = INVALID_HANDLE; // first and last live pass that uses it
+		uint32_t lastPass = INVALID_HANDLE;
+		uint64_t heapOffset = 0;
+		bool aliased = false; // another transient uses some of its memory, before or after it
+	};
+
+	void AddUse(uint32_t _pass, uint32_t _resource, uint32_t _state, Access _access);
+	void CullPasses();
+	void PlaceTransients();
+	bool Overlaps(uint32_t _a, uint32_t _b); // placed transients that share memory
+	bool BuildBarriers();
+
+	std::vector<Pass> m_passes;
+	std::vector<Resource> m_resources;
+	std::vector<FrameGraphBarrier> m_barriers;
+	uint32_t m_finalBarrierBegin = 0;
+	uint32_t m_finalBarrierCount = 0;
+	FrameGraphStats m_stats;
+};
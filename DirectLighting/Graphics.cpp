@@ -1,5 +1,47 @@
 #include "Graphics.h"
 
+namespace
+{
+	// The input layout is used by the Input Assembler so that it knows
+	// how to read the vertex data bound to it. the scene and the shadow maps share it
+	const D3D12_INPUT_ELEMENT_DESC VERTEX_INPUT_LAYOUT[] =
+	{
+		{ "POSITION", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+		{ "NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, 8, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+		{ "COLOR", 0, DXGI_FORMAT_R8G8B8A8_UNORM, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
+	};
+
+	D3D12_INPUT_LAYOUT_DESC VertexInputLayout()
+	{
+		D3D12_INPUT_LAYOUT_DESC inputLayoutDesc = {};
+		inputLayoutDesc.NumElements = _countof(VERTEX_INPUT_LAYOUT);
+		inputLayoutDesc.pInputElementDescs = VERTEX_INPUT_LAYOUT;
+		return inputLayoutDesc;
+	}
+
+	// the normals are in object space, and the inverse transpose of the world matrix takes them to world space. the
+	// shader reads its columns, which are the rows of the inverse
+	void StoreNormalMatrix(const XMFLOAT4X4& _world, XMFLOAT4 _normalMat[3])
+	{
+		XMMATRIX inverse = XMMatrixInverse(nullptr, XMLoadFloat4x4(&_world));
+		for (int i = 0; i < 3; ++i)
+			XMStoreFloat4(&_normalMat[i], inverse.r[i]);
+	}
+
+	// whether a mesh file's vertices are laid out like PackedVertex and VERTEX_INPUT_LAYOUT
+	bool MatchesVertex(MeshFile& _mesh)
+	{
+		const MeshVertexAttribute* pPosition = _mesh.FindAttribute(MESH_SEMANTIC_POSITION);
+		const MeshVertexAttribute* pNormal = _mesh.FindAttribute(MESH_SEMANTIC_NORMAL);
+		const MeshVertexAttribute* pColor = _mesh.FindAttribute(MESH_SEMANTIC_COLOR);
+		return _mesh.Header().vertexStride == sizeof(PackedVertex) &&
+			pPosition && pPosition->format == DXGI_FORMAT_R16G16B16A16_UNORM && pPosition->offset == offsetof(PackedVertex, position) &&
+			pNormal && pNormal->format == DXGI_FORMAT_R16G16_SNORM && pNormal->offset == offsetof(PackedVertex, normal) &&
+			pColor && pColor->format == DXGI_FORMAT_R8G8B8A8_UNORM && pColor->offset == offsetof(PackedVertex, color) &&
+			_mesh.LodCount() > 0 && _mesh.Lods()[0].submeshCount > 0;
+	}
+}
+
 bool Graphics::OnInit(LWindow &_window)
 {
 	HRESULT hr;
@@ -9,6 +51,12 @@ bool Graphics::OnInit(LWindow &_window)
 		return false;
 	}
 
+	m_hwnd = _window.getWindow();
+	char title[256] = {};
+	GetWindowTextA(m_hwnd, title, sizeof(title));
+	m_windowTitle = title;
+	m_statsTime = std::chrono::steady_clock::now();
+
 	// Fill out the Viewport
 	m_viewport.TopLeftX = 0;
 	m_viewport.TopLeftY = 0;
@@ -23,17 +71,32 @@ bool Graphics::OnInit(LWindow &_window)
 	m_scissorRect.right = _window.getWidth();
 	m_scissorRect.bottom = _window.getHeight();
 
+	m_jobSystem.Init();
+
 	bool setup = InitDevice() && InitCommandQueue() && InitSwapchain(_window) && InitRenderTargets() && InitCommandAllocators() && InitCommandList() && InitFence();
 
-	setup = InitRootSignature();
+	// each step needs the ones before it, so the first one to fail stops the rest
+	setup = setup && InitRootSignature();
 
 	//setup = InitRootSignature() && CompileMyShaders() && CreateInputLayout()   CreateConstantBuffer();
+	setup = setup && CreateDepthBuffer(_window);
+	setup = setup && CreatePSO(m_psoData);
+	setup = setup && CreateIndirectDrawResources();
+	setup = setup && CreateDepthReadback();
+	setup = setup && m_shadowMapPass.Init(m_pDevice, m_pRootSignature, m_rootParamPerObject, m_vertexShaderFile, VertexInputLayout(),
+		m_shadowDesc.resolution, m_shadowDesc.cascadeCount, m_frameBufferCount);
 	if (setup)
 	{
-		setup = CreateDepthBuffer(_window);
-		setup = CreatePerObjectConstantBuffer();
-		setup = CreatePSO(m_psoData);
-		//setup = Test(_window.getWidth(), _window.getHeight(), _window.getWindow());
+		// watch the working directory, which is where the shaders are loaded from
+		m_shaderHotReload.Init(&m_jobSystem, ".", [this](ID3DBlob* _pVertexShader, ID3DBlob* _pPixelShader)
+		{
+			return BuildPipelineState(_pVertexShader, _pPixelShader);
+		});
+		// the cascades are drawn with the scene's vertex shader, so their pso is rebuilt along with the scene's
+		m_shadowPipeline = m_shaderHotReload.AddPipeline([this](ID3DBlob* _pVertexShader, ID3DBlob*)
+		{
+			return m_shadowMapPass.BuildPipelineState(_pVertexShader);
+		});
 		
 		// Now we execute the command list to upload the initial assets (triangle data)
 		m_pCommandList->Close();
@@ -47,9 +110,7 @@ bool Graphics::OnInit(LWindow &_window)
 			return false;
 		}
 	}
-	setup = InitScene(_window.getWidth(), _window.getHeight());
-		
-
+	setup = setup && InitScene(_window.getWidth(), _window.getHeight());
 
 	return setup;
 }
@@ -76,16 +137,15 @@ void Graphics::Update()
     // store cube1's world matrix
     XMStoreFloat4x4(&m_cube1WorldMat, worldMat);
 
-    // update constant buffer for cube1
-    // create the wvp matrix and store in constant buffer
+    // update the root constants for cube1
+    // create the wvp matrix and store it, it is copied into the command list when we draw
     XMMATRIX viewMat = XMLoadFloat4x4(&m_cameraViewMat); // load view matrix
     XMMATRIX projMat = XMLoadFloat4x4(&m_cameraProjMat); // load projection matrix
-    XMMATRIX wvpMat = XMLoadFloat4x4(&m_cube1WorldMat) * viewMat * projMat; // create wvp matrix
+    XMMATRIX decodeMat = XMLoadFloat4x4(&m_meshDecodeMat); // the mesh's positions are stored 0..1 inside its bounds
+    XMMATRIX wvpMat = decodeMat * XMLoadFloat4x4(&m_cube1WorldMat) * viewMat * projMat; // create wvp matrix
     XMMATRIX transposed = XMMatrixTranspose(wvpMat); // must transpose wvp matrix for the gpu
-    XMStoreFloat4x4(&m_cbPerObject.wvpMat, transposed); // store transposed wvp matrix in constant buffer
-
-    // copy our ConstantBuffer instance to the mapped constant buffer resource
-    memcpy(m_pCBVGPUAddress[m_frameIndex], &m_cbPerObject, sizeof(m_cbPerObject));
+    XMStoreFloat4x4(&m_cube1Constants.wvpMat, transposed); // store transposed wvp matrix
+    StoreNormalMatrix(m_cube1WorldMat, m_cube1Constants.normalMat);
 
     // now do cube2's world matrix
     // create rotation matrices for cube2
@@ -110,30 +170,80 @@ void Graphics::Update()
     // finally we move it to cube 1's position, which will cause it to rotate around cube 1
     worldMat = scaleMat * translationOffsetMat * rotMat * translationMat;
 
-    wvpMat = XMLoadFloat4x4(&m_cube2WorldMat) * viewMat * projMat; // create wvp matrix
+    wvpMat = decodeMat * XMLoadFloat4x4(&m_cube2WorldMat) * viewMat * projMat; // create wvp matrix
     transposed = XMMatrixTranspose(wvpMat); // must transpose wvp matrix for the gpu
-    XMStoreFloat4x4(&m_cbPerObject.wvpMat, transposed); // store transposed wvp matrix in constant buffer
-
-    // copy our ConstantBuffer instance to the mapped constant buffer resource
-    memcpy(m_pCBVGPUAddress[m_frameIndex] + m_ConstantBufferPerObjectAlignedSize, &m_cbPerObject, sizeof(m_cbPerObject));
+    XMStoreFloat4x4(&m_cube2Constants.wvpMat, transposed); // store transposed wvp matrix
+    StoreNormalMatrix(m_cube2WorldMat, m_cube2Constants.normalMat); // from the same world matrix as the wvp
 
     // store cube2's world matrix
     XMStoreFloat4x4(&m_cube2WorldMat, worldMat);
 }
 
-void Graphics::UpdatePipeline()
+bool Graphics::UpdatePipeline()
 {
 	HRESULT hr;
 
 	// We have to wait for the gpu to finish with the command allocator before we reset it
 	WaitForPreviousFrame();
 
+	// pick up a pso rebuilt from edited shaders before we start recording with it
+	SwapReloadedPipelineState();
+	// and the probes, once their bake has finished. they replace the flat ambient from this frame on
+	if (m_volumeBakeRunning && m_volumeBakeDone)
+	{
+		m_bakedLighting.LoadIrradianceVolume(m_irradianceVolume);
+		m_volumeBakeDone = false;
+		m_volumeBakeRunning = false;
+	}
+	m_frameCount++;
+
+	// the frame that last used this index is done, so its depth can hide this frame's meshlets
+	ReadBackDepth();
+	BuildDrawQueue();
+
+	// the cascades follow the camera, and each one is recorded on its own list while the main list is built
+	m_cascadedShadows.Update(m_cameraViewMat, m_sunDirection);
+	m_cascadedShadows.SetCasters(m_shadowCasterSpheres.data(), static_cast<uint32_t>(m_shadowCasterSpheres.size()), &m_jobSystem);
+	m_cascadedShadows.Cull(&m_jobSystem);
+	m_shadowMapPass.Record(m_frameIndex, m_cascadedShadows, m_shadowCasters.data(), &m_jobSystem);
+
+	m_lightClusters.Build(m_lights.data(), static_cast<uint32_t>(m_lights.size()), m_cameraViewMat, &m_jobSystem);
+	// the light bvh only needs rebuilding when lights come or go, moving them is just a refit
+	if (m_lightBvh.LightCount() != m_lights.size())
+		m_lightBvh.Build(m_lights.data(), static_cast<uint32_t>(m_lights.size()), &m_jobSystem);
+	else
+		m_lightBvh.Refit(m_lights.data(), &m_jobSystem);
+	XMFLOAT4X4 viewProj;
+	XMStoreFloat4x4(&viewProj, XMLoadFloat4x4(&m_cameraViewMat) * XMLoadFloat4x4(&m_cameraProjMat));
+	m_clusteredLighting.Upload(m_lights.data(), static_cast<UINT>(m_lights.size()), m_lightClusters, m_lightBvh, viewProj,
+		static_cast<UINT>(m_viewport.Width), static_cast<UINT>(m_viewport.Height), m_ambientLight, m_sunDirection, m_sunColor, m_frameIndex);
+	if (!BuildFrameGraph())
+	{
+		return false;
+	}
+
+	// give the graph's transients memory. the depth buffer may have been placed again, in which case its view has to follow it
+	if (!m_transientPool.Realize(m_pDevice, m_frameGraph, m_frameCount, m_frameBufferCount))
+	{
+		return false;
+	}
+	ID3D12Resource* pDepthStencilBuffer = m_transientPool.Resource(m_frameGraphDepth);
+	if (pDepthStencilBuffer != m_pDepthStencilBuffer)
+	{
+		m_pDepthStencilBuffer = pDepthStencilBuffer;
+		D3D12_DEPTH_STENCIL_VIEW_DESC depthStencilDesc = {};
+		depthStencilDesc.Format = DXGI_FORMAT_D32_FLOAT;
+		depthStencilDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2D;
+		depthStencilDesc.Flags = D3D12_DSV_FLAG_NONE;
+		m_pDevice->CreateDepthStencilView(m_pDepthStencilBuffer, &depthStencilDesc, m_pDSDescriptorHeap->GetCPUDescriptorHandleForHeapStart());
+	}
+
 	// we can only reset an allocator once the gpu is done with it
 	// resetting an allocator frees the memory that the command list was stored in
 	hr = m_pCommandAllocator[m_frameIndex]->Reset();
 	if (FAILED(hr))
 	{
-		return;//Running = false;
+		return false;
 	}
 
 	// reset the command list. by resetting the command list we are putting it into
@@ -149,14 +259,275 @@ void Graphics::UpdatePipeline()
 	hr = m_pCommandList->Reset(m_pCommandAllocator[m_frameIndex], m_pPipelineStateObject);
 	if (FAILED(hr))
 	{
-		return;//Running = false;
+		return false;
 	}
 
 	// here we start recording commands into the commandList (which all the commands will be stored in the commandAllocator)
+	// everything goes through the recorder, which drops state that is already set and batches barriers
+	m_commandRecorder.Begin(m_pCommandList, m_pPipelineStateObject);
+
+	// a lightmap loaded since the last frame is copied to the gpu ahead of everything that reads it
+	m_bakedLighting.Update(m_commandRecorder, m_frameCount);
+
+	// the frame graph sends each pass's barriers as one batch before running it, including moving the
+	// back buffer out of and back into the present state
+	m_shadowCommandListCount = 0;
+	m_frameGraph.Execute([this](const FrameGraphBarrier* _pBarriers, uint32_t _count)
+	{
+		for (uint32_t i = 0; i < _count; ++i)
+		{
+			const FrameGraphBarrier& barrier = _pBarriers[i];
+			ID3D12Resource* pResource = FrameGraphResource(barrier.resource);
+			if (barrier.type == FrameGraphBarrier::TYPE_TRANSITION)
+				m_commandRecorder.Transition(pResource, static_cast<D3D12_RESOURCE_STATES>(barrier.before), static_cast<D3D12_RESOURCE_STATES>(barrier.after));
+			else if (barrier.type == FrameGraphBarrier::TYPE_ALIASING)
+				m_commandRecorder.Aliasing(nullptr, pResource);
+			else
+				m_commandRecorder.UAVBarrier(pResource);
+		}
+	});
+
+	// flushes the last barriers, keep the counts so they can be shown or logged
+	m_commandStats = m_commandRecorder.End();
+
+	hr = m_pCommandList->Close();
+	return SUCCEEDED(hr);
+}
+
+bool Graphics::RenderReference(const std::string& _fileName, uint32_t _passes, uint32_t _maxBounces)
+{
+	PathTracerDesc desc;
+	desc.width = static_cast<uint32_t>(m_viewport.Width);
+	desc.height = static_cast<uint32_t>(m_viewport.Height);
+	desc.maxBounces = _maxBounces;
+
+	PathTracer pathTracer;
+	pathTracer.Init(desc);
+	FillCpuScene(pathTracer);
+	pathTracer.SetCamera(m_cameraViewMat, m_cameraProjMat);
+	pathTracer.Render(_passes, &m_jobSystem);
+	return pathTracer.SavePfm(_fileName);
+}
+
+bool Graphics::BakeLightmap(const std::string& _fileName)
+{
+	// the bake scene keeps no image, it is only there for its rays
+	PathTracerDesc desc;
+	desc.width = 1;
+	desc.height = 1;
+	m_bakeScene.Init(desc);
+	FillCpuScene(m_bakeScene);
+
+	// the charts only change with the geometry. when only the lights have changed, Bake just redoes the charts they reach
+	const std::vector<XMFLOAT3>& positions = m_bakeScene.Positions();
+	bool geometryChanged = positions.size() != m_bakedPositions.size() ||
+		!std::equal(positions.begin(), positions.end(), m_bakedPositions.begin(), [](const XMFLOAT3& _a, const XMFLOAT3& _b)
+		{
+			return _a.x == _b.x && _a.y == _b.y && _a.z == _b.z;
+		});
+	if (geometryChanged)
+	{
+		if (!m_lightmapBaker.Build(m_bakeScene, LightmapDesc()))
+		{
+			return false;
+		}
+		m_bakedPositions = positions;
+	}
+	m_lightmapBaker.Bake(m_bakeScene, &m_jobSystem);
+
+	// the renderer reads it back like any other lightmap file, from the next frame on
+	return m_lightmapBaker.Save(_fileName) && m_bakedLighting.LoadLightmap(_fileName);
+}
+
+void Graphics::BakeIrradianceVolume()
+{
+	PrepareIrradianceVolumeBake();
+	m_irradianceVolume.Bake(m_volumeBakeScene, &m_jobSystem);
+
+	// it replaces the flat ambient in the pixel shader from the next frame on
+	m_bakedLighting.LoadIrradianceVolume(m_irradianceVolume);
+}
+
+void Graphics::StartIrradianceVolumeBake()
+{
+	PrepareIrradianceVolumeBake();
+	m_volumeBakeRunning = true;
+
+	// the bake's ParallelFor shares the workers with the frames' own, the job only keeps the main thread out of it
+	m_jobSystem.Submit([this]()
+	{
+		m_irradianceVolume.Bake(m_volumeBakeScene, &m_jobSystem);
+		m_volumeBakeDone = true;
+	});
+}
+
+void Graphics::PrepareIrradianceVolumeBake()
+{
+	// a bake still running owns the volume, so it has to finish first
+	if (m_volumeBakeRunning)
+	{
+		m_jobSystem.Wait();
+		m_volumeBakeDone = false;
+		m_volumeBakeRunning = false;
+	}
+
+	// the scene is copied out on this thread, the bake only reads the copy
+	PathTracerDesc desc;
+	desc.width = 1;
+	desc.height = 1;
+	m_volumeBakeScene.Init(desc);
+	FillCpuScene(m_volumeBakeScene);
+
+	// the default volume is a few metres around the cubes, which sit at the origin
+	m_irradianceVolume.Init(IrradianceVolumeDesc());
+}
+
+void Graphics::FillCpuScene(PathTracer& _scene)
+{
+	_scene.ClearScene();
+
+	// the path tracer works in floats and 32 bit indices, so the packed mesh is expanded once for both cubes
+	struct FloatVertex
+	{
+		XMFLOAT3 position;
+		XMFLOAT4 color;
+	};
+	const MeshFileHeader& header = m_mesh.Header();
+	const PackedVertex* pPacked = static_cast<const PackedVertex*>(m_mesh.Vertices());
+	std::vector<FloatVertex> vertices(header.vertexCount);
+	for (uint32_t i = 0; i < header.vertexCount; ++i)
+	{
+		vertices[i].position = VertexCompression::DecodePosition(pPacked[i].position, header.boundsMin, header.boundsMax);
+		vertices[i].color = VertexCompression::UnpackRgba8(pPacked[i].color);
+	}
+	// only the full detail level, the others follow it in the index buffer
+	const MeshSubmesh& submesh = m_mesh.Submeshes()[m_mesh.Lods()[0].firstSubmesh];
+	std::vector<uint32_t> indices(submesh.indexCount);
+	for (uint32_t i = 0; i < submesh.indexCount; ++i)
+	{
+		uint32_t index = submesh.firstIndex + i;
+		indices[i] = header.indexSize == sizeof(uint16_t) ? static_cast<const uint16_t*>(m_mesh.Indices())[index] :
+			static_cast<const uint32_t*>(m_mesh.Indices())[index];
+	}
+
+	const XMFLOAT4X4* pWorldMats[] = { &m_cube1WorldMat, &m_cube2WorldMat };
+	for (int i = 0; i < _countof(pWorldMats); ++i)
+	{
+		_scene.AddMesh(vertices.data(), header.vertexCount, sizeof(FloatVertex), offsetof(FloatVertex, position), offsetof(FloatVertex, color),
+			indices.data(), submesh.indexCount, *pWorldMats[i]);
+	}
+	_scene.SetLights(m_lights.data(), static_cast<uint32_t>(m_lights.size()));
+	_scene.SetSun(m_sunDirection, m_sunColor);
+	_scene.Commit();
+}
+
+void Graphics::CreateLights()
+{
+	// the same lights every run: mostly point lights scattered over a box around the cubes, and every fourth one a
+	// spot light pointing down at them
+	std::mt19937 random(2024);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	m_lights.resize(m_sceneLightCount);
+	for (UINT i = 0; i < m_sceneLightCount; ++i)
+	{
+		Light& light = m_lights[i];
+		light.position = XMFLOAT3(-4.0f + 8.0f * unit(random), 0.5f + 2.0f * unit(random), -3.0f + 6.0f * unit(random));
+		light.range = 1.5f + 1.5f * unit(random);
+
+		// a saturated colour, so neighbouring lights are easy to tell apart
+		float hue = 6.0f * unit(random);
+		XMVECTOR color = XMVectorSaturate(XMVectorSet(std::abs(hue - 3.0f) - 1.0f, 2.0f - std::abs(hue - 2.0f), 2.0f - std::abs(hue - 4.0f), 0.0f));
+		XMStoreFloat3(&light.color, XMVectorScale(color, 0.5f + unit(random)));
+
+		if (i % 4 == 3)
+		{
+			light.type = LIGHT_SPOT;
+			XMStoreFloat3(&light.direction, XMVector3Normalize(XMVectorSet(-light.position.x * 0.3f, -1.0f, -light.position.z * 0.3f, 0.0f)));
+			light.cosOuterAngle = std::cos(0.4f + 0.4f * unit(random));
+			light.range *= 1.5f;
+		}
+		else
+		{
+			light.type = LIGHT_POINT;
+			light.direction = XMFLOAT3(0.0f, -1.0f, 0.0f);
+			light.cosOuterAngle = -1.0f;
+		}
+	}
+}
+
+bool Graphics::BuildFrameGraph()
+{
+	m_frameGraph.Reset();
+
+	m_frameGraphBackBuffer = m_frameGraph.Import("Back Buffer", FG_STATE_PRESENT, FG_STATE_PRESENT);
+	m_frameGraphDepth = m_frameGraph.CreateTransient("Depth", m_depthDesc);
+
+	// each cascade is a pass of its own, but its commands were recorded on its own list in parallel before the graph
+	// runs, so the pass only hands that list over to be submitted ahead of the main list. that only works because no
+	// barrier ever goes in front of them: the shadow map starts and ends the frame in depth write, and they come first.
+	// every cascade draws into its own slice, so after the first one they keep what the others wrote. the scene pass
+	// reads them, so the graph moves the map to a shader resource on the main list and back to depth write at the end
+	m_frameGraphShadowMap = FrameGraph::INVALID_HANDLE;
+	if (m_shadowMapPass.CommandListCount() > 0)
+	{
+		m_frameGraphShadowMap = m_frameGraph.Import("Shadow Map", FG_STATE_DEPTH_WRITE, FG_STATE_DEPTH_WRITE);
+		for (UINT i = 0; i < m_shadowMapPass.CommandListCount(); ++i)
+		{
+			uint32_t cascadePass = m_frameGraph.AddPass("Shadow Cascade " + std::to_string(i), [this, i]()
+			{
+				m_pShadowCommandLists[m_shadowCommandListCount++] = m_shadowMapPass.CommandList(i);
+			});
+			if (i == 0)
+				m_frameGraph.Write(cascadePass, m_frameGraphShadowMap, FG_STATE_DEPTH_WRITE);
+			else
+				m_frameGraph.ReadWrite(cascadePass, m_frameGraphShadowMap, FG_STATE_DEPTH_WRITE);
+		}
+	}
+
+	// the scene pass clears both targets, so it writes them rather than reading them
+	uint32_t scenePass = m_frameGraph.AddPass("Scene", [this]() { RecordScenePass(); });
+	m_frameGraph.Write(scenePass, m_frameGraphBackBuffer, FG_STATE_RENDER_TARGET);
+	m_frameGraph.Write(scenePass, m_frameGraphDepth, FG_STATE_DEPTH_WRITE);
+	if (m_frameGraphShadowMap != FrameGraph::INVALID_HANDLE)
+		m_frameGraph.Read(scenePass, m_frameGraphShadowMap, FG_STATE_PIXEL_SHADER_RESOURCE);
+
+	// the depth goes to this frame's readback buffer for the occlusion culling a few frames from now, which the graph
+	// cannot see, so the pass is kept alive by marking it as having side effects
+	if (m_useOcclusionCulling)
+	{
+		uint32_t readbackPass = m_frameGraph.AddPass("Depth Readback", [this]()
+		{
+			m_commandRecorder.FlushBarriers();
+			CD3DX12_TEXTURE_COPY_LOCATION destination(m_pDepthReadback[m_frameIndex], m_depthReadbackFootprint);
+			CD3DX12_TEXTURE_COPY_LOCATION source(FrameGraphResource(m_frameGraphDepth), 0);
+			m_commandRecorder.CommandList()->CopyTextureRegion(&destination, 0, 0, 0, &source, nullptr);
+			XMStoreFloat4x4(&m_depthReadbackViewProj[m_frameIndex], XMLoadFloat4x4(&m_cameraViewMat) * XMLoadFloat4x4(&m_cameraProjMat));
+			m_depthReadbackRecorded[m_frameIndex] = true;
+		});
+		m_frameGraph.Read(readbackPass, m_frameGraphDepth, FG_STATE_COPY_SOURCE);
+		m_frameGraph.SetSideEffects(readbackPass);
+	}
+
+	// a graph that does not compile has only some of its barriers, running it would use resources in the wrong state
+	if (!m_frameGraph.Compile())
+	{
+		OutputDebugStringA("the frame graph did not compile, a transient is read before anything writes it\n");
+		return false;
+	}
+	return true;
+}
 
-// transition the "frameIndex" render target from the present state to the render target state so the command list draws to it starting from here
-	m_pCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_pRenderTargets[m_frameIndex], D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET));
+ID3D12Resource* Graphics::FrameGraphResource(uint32_t _resource)
+{
+	if (_resource == m_frameGraphBackBuffer)
+		return m_pRenderTargets[m_frameIndex];
+	if (_resource == m_frameGraphShadowMap)
+		return m_shadowMapPass.ShadowMap();
+	return m_transientPool.Resource(_resource);
+}
 
+void Graphics::RecordScenePass()
+{
 	// here we again get the handle to our current render target view so we can set it as the render target in the output merger stage of the pipeline
 	CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(m_pRTVDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), m_frameIndex, m_rtvDescriptorSize);
 
@@ -164,69 +535,332 @@ void Graphics::UpdatePipeline()
 	CD3DX12_CPU_DESCRIPTOR_HANDLE dsvHandle(m_pDSDescriptorHeap->GetCPUDescriptorHandleForHeapStart());
 
 	// set the render target for the output merger stage (the output of the pipeline)
-	m_pCommandList->OMSetRenderTargets(1, &rtvHandle, FALSE, &dsvHandle);
+	m_commandRecorder.OMSetRenderTargets(1, &rtvHandle, FALSE, &dsvHandle);
 
 	// Clear the render target by using the ClearRenderTargetView command
 	const float clearColor[] = { 0.0f, 0.2f, 0.4f, 1.0f };
-	m_pCommandList->ClearRenderTargetView(rtvHandle, clearColor, 0, nullptr);
+	m_commandRecorder.ClearRenderTargetView(rtvHandle, clearColor);
 
 	// clear the depth/stencil buffer
-	m_pCommandList->ClearDepthStencilView(m_pDSDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
+	m_commandRecorder.ClearDepthStencilView(m_pDSDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0);
+
+	// draw everything in sort key order. each draw sets everything it needs and the recorder only sends
+	// what actually changed, so after the first cube only the per object constants reach the command list
+	m_commandRecorder.RSSetViewport(m_viewport); // set the viewports
+	m_commandRecorder.RSSetScissorRect(m_scissorRect); // set the scissor rects
+
+	// the scene's draws all read this frame's lights
+	DrawQueue::BindFunc bindLights = [this](ID3D12RootSignature* _pRootSignature)
+	{
+		if (_pRootSignature == m_pRootSignature)
+		{
+			m_clusteredLighting.Bind(m_commandRecorder, m_frameIndex);
+			m_bakedLighting.Bind(m_commandRecorder);
+			m_shadowMapPass.Bind(m_commandRecorder, m_frameIndex, m_bakedLighting.SharedViewGpu(m_shadowMapView));
+		}
+	};
+	if (m_useIndirectDraws)
+	{
+		DrawQueue::CommandSignatureFunc commandSignature = [this](ID3D12RootSignature* _pRootSignature, UINT _rootConstantsParameter)
+		{
+			return CommandSignature(_pRootSignature, _rootConstantsParameter);
+		};
+		m_visibleDraws = m_drawQueue.SubmitIndirect(m_commandRecorder, commandSignature, m_pIndirectArgumentBuffer[m_frameIndex],
+			m_pIndirectRecords[m_frameIndex], m_maxIndirectDraws, m_cameraFrustum, &m_jobSystem, bindLights);
+	}
+	else
+	{
+		m_drawQueue.Submit(m_commandRecorder, bindLights);
+		m_visibleDraws = m_drawQueue.Count();
+	}
+}
+
+void Graphics::BuildDrawQueue()
+{
+	m_drawQueue.Clear();
+	m_shadowCasters.clear();
+	m_shadowCasterSpheres.clear();
+	m_lodTrianglesSaved = 0;
+	m_occludedMeshlets = 0;
+
+	XMMATRIX viewMat = XMLoadFloat4x4(&m_cameraViewMat);
+
+	// the indirect path culls against this
+	XMFLOAT4X4 viewProj;
+	XMStoreFloat4x4(&viewProj, viewMat * XMLoadFloat4x4(&m_cameraProjMat));
+	Culling::ExtractFrustum(viewProj, m_cameraFrustum);
+
+	// both cubes share the same pso and mesh, so they only differ in their constants and depth
+	DrawItem cube = {};
+	cube.pPipelineState = m_pPipelineStateObject;
+	cube.pRootSignature = m_pRootSignature;
+	cube.pVertexBufferView = &m_vertexBufferView;
+	cube.pIndexBufferView = &m_indexBufferView;
+	cube.rootConstantsParameter = m_rootParamPerObject;
+	cube.num32BitConstants = sizeof(ConstantBufferPerObject) / sizeof(UINT);
+
+	const XMFLOAT4X4* pWorldMats[] = { &m_cube1WorldMat, &m_cube2WorldMat };
+	ConstantBufferPerObject* pConstants[] = { &m_cube1Constants, &m_cube2Constants };
+	for (int i = 0; i < _countof(pWorldMats); ++i)
+	{
+		// the view space z of the object's origin is good enough to order whole objects front to back
+		XMVECTOR worldPos = XMVectorSet(pWorldMats[i]->_41, pWorldMats[i]->_42, pWorldMats[i]->_43, 1.0f);
+		float viewDepth = XMVectorGetZ(XMVector3TransformCoord(worldPos, viewMat));
+
+		cube.pConstants = pConstants[i];
+		cube.boundingSphere = Culling::BoundingSphere(*pWorldMats[i], m_mesh.Header().boundingRadius);
+
+		// the lod is picked here, where the sphere is at hand, and the shadows use the same one
+		uint32_t lod = SelectLod(*pWorldMats[i], cube.boundingSphere);
+		const MeshSubmesh& submesh = m_mesh.Submeshes()[m_mesh.Lods()[lod].firstSubmesh];
+		m_lodTrianglesSaved += (m_mesh.Submeshes()[m_mesh.Lods()[0].firstSubmesh].indexCount - submesh.indexCount) / 3;
+		cube.startIndex = submesh.firstIndex;
+		cube.indexCount = submesh.indexCount;
+
+		// the meshlets only cover the full detail level
+		if (lod == 0 && m_useMeshletCulling && m_mesh.MeshletCount() > 0)
+		{
+			// one draw per meshlet that is in view, facing us and not behind the last finished frame's depth, each over
+			// its own run of the index buffer. the indirect path culls them again by their spheres, which costs little
+			// and catches nothing new
+			MeshletCullParams params;
+			params.world = *pWorldMats[i];
+			params.frustum = m_cameraFrustum;
+			params.cameraPosition = XMFLOAT3(m_cameraPosition.x, m_cameraPosition.y, m_cameraPosition.z);
+			if (m_useOcclusionCulling && m_depthPyramid.IsBuilt())
+			{
+				params.pOcclusion = &m_depthPyramid;
+				params.occlusionViewProj = m_depthPyramidViewProj;
+			}
+			m_meshletCuller.Cull(params, &m_jobSystem);
+			m_occludedMeshlets += m_meshletCuller.Stats().occlusionCulled;
+
+			XMMATRIX worldMat = XMLoadFloat4x4(pWorldMats[i]);
+			DrawItem meshletDraw = cube;
+			for (uint32_t meshletIndex : m_meshletCuller.Visible())
+			{
+				const Meshlet& meshlet = m_mesh.Meshlets()[meshletIndex];
+				XMVECTOR center = XMVector3TransformCoord(XMLoadFloat3(&meshlet.center), worldMat);
+				float radius = Culling::BoundingSphere(*pWorldMats[i], meshlet.radius).w;
+				XMStoreFloat4(&meshletDraw.boundingSphere, XMVectorSetW(center, radius));
+				meshletDraw.startIndex = meshlet.firstIndex;
+				meshletDraw.indexCount = meshlet.triangleCount * 3;
+				m_drawQueue.Add(meshletDraw, m_drawQueue.MakeKey(meshletDraw, RENDER_PASS_OPAQUE, XMVectorGetZ(XMVector3TransformCoord(center, viewMat))));
+			}
+		}
+		else
+		{
+			m_drawQueue.Add(cube, m_drawQueue.MakeKey(cube, RENDER_PASS_OPAQUE, viewDepth));
+		}
+
+		ShadowCaster caster;
+		XMStoreFloat4x4(&caster.world, XMLoadFloat4x4(&m_meshDecodeMat) * XMLoadFloat4x4(pWorldMats[i]));
+		caster.pVertexBufferView = &m_vertexBufferView;
+		caster.pIndexBufferView = &m_indexBufferView;
+		caster.indexCount = submesh.indexCount;
+		caster.startIndex = submesh.firstIndex;
+		m_shadowCasters.push_back(caster);
+		m_shadowCasterSpheres.push_back(cube.boundingSphere);
+	}
 
-	// set root signature
-	m_pCommandList->SetGraphicsRootSignature(m_pRootSignature); // set the root signature
+	m_drawQueue.Sort(&m_jobSystem);
+}
 
-	// draw triangle
-	m_pCommandList->RSSetViewports(1, &m_viewport); // set the viewports
-	m_pCommandList->RSSetScissorRects(1, &m_scissorRect); // set the scissor rects
-	m_pCommandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST); // set the primitive topology
-	m_pCommandList->IASetVertexBuffers(0, 1, &m_vertexBufferView); // set the vertex buffer (using the vertex buffer view)
-	m_pCommandList->IASetIndexBuffer(&m_indexBufferView);
+uint32_t Graphics::SelectLod(const XMFLOAT4X4& _world, const XMFLOAT4& _sphere)
+{
+	float pixelsPerUnit = m_cameraProjMat._22 * m_viewport.Height * 0.5f;
+	XMFLOAT3 eye(m_cameraPosition.x, m_cameraPosition.y, m_cameraPosition.z);
+	return Culling::SelectLod(&m_mesh.Lods()[0].error, sizeof(MeshLod), m_mesh.LodCount(), _world, _sphere, eye, pixelsPerUnit, m_lodPixelError);
+}
 
-	// first cube
+ID3D12CommandSignature* Graphics::CommandSignature(ID3D12RootSignature* _pRootSignature, UINT _rootConstantsParameter)
+{
+	std::pair<ID3D12RootSignature*, UINT> key(_pRootSignature, _rootConstantsParameter);
+	auto found = m_commandSignatures.find(key);
+	if (found != m_commandSignatures.end())
+		return found->second;
+
+	// each command sets the per object constants, then draws
+	D3D12_INDIRECT_ARGUMENT_DESC arguments[2] = {};
+	arguments[0].Type = D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT;
+	arguments[0].Constant.RootParameterIndex = _rootConstantsParameter;
+	arguments[0].Constant.DestOffsetIn32BitValues = 0;
+	arguments[0].Constant.Num32BitValuesToSet = INDIRECT_ROOT_CONSTANTS;
+	arguments[1].Type = D3D12_INDIRECT_ARGUMENT_TYPE_DRAW_INDEXED;
+
+	D3D12_COMMAND_SIGNATURE_DESC signatureDesc = {};
+	signatureDesc.ByteStride = sizeof(IndirectDrawRecord);
+	signatureDesc.NumArgumentDescs = _countof(arguments);
+	signatureDesc.pArgumentDescs = arguments;
+
+	// a signature that changes root arguments needs the root signature it changes them in. a failure is kept too,
+	// so a bad pairing costs one CreateCommandSignature rather than one a frame
+	ID3D12CommandSignature* pCommandSignature = nullptr;
+	HRESULT hr = m_pDevice->CreateCommandSignature(&signatureDesc, _pRootSignature, IID_PPV_ARGS(&pCommandSignature));
+	if (FAILED(hr))
+	{
+		pCommandSignature = nullptr;
+	}
+	m_commandSignatures[key] = pCommandSignature;
+	return pCommandSignature;
+}
 
-	// set cube1's constant buffer
-	m_pCommandList->SetGraphicsRootConstantBufferView(0, m_pConstantBufferUploadHeaps[m_frameIndex]->GetGPUVirtualAddress());
+bool Graphics::CreateIndirectDrawResources()
+{
+	// the record layout has to line up with the arguments in CommandSignature
+	static_assert(sizeof(DrawIndexedArguments) == sizeof(D3D12_DRAW_INDEXED_ARGUMENTS), "DrawIndexedArguments must match D3D12_DRAW_INDEXED_ARGUMENTS");
+	static_assert(INDIRECT_ROOT_CONSTANTS == sizeof(ConstantBufferPerObject) / sizeof(UINT), "indirect records carry one ConstantBufferPerObject");
 
-	// draw first cube
-	m_pCommandList->DrawIndexedInstanced(m_numCubeIndices, 1, 0, 0, 0);
+	// the scene's own draws need this one, so make it now and fail at startup if it can't be made.
+	// any other root signature or slot in the queue gets its signature the first frame it shows up
+	if (CommandSignature(m_pRootSignature, m_rootParamPerObject) == nullptr)
+	{
+		return false;
+	}
 
-	// second cube
+	// the cpu writes the records every frame, so the argument buffers live in upload heaps and stay mapped
+	for (int i = 0; i < m_frameBufferCount; ++i)
+	{
+		HRESULT hr = m_pDevice->CreateCommittedResource(
+			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+			D3D12_HEAP_FLAG_NONE,
+			&CD3DX12_RESOURCE_DESC::Buffer(m_maxIndirectDraws * sizeof(IndirectDrawRecord)),
+			D3D12_RESOURCE_STATE_GENERIC_READ, // upload heaps have to stay in generic read, which includes indirect argument
+			nullptr,
+			IID_PPV_ARGS(&m_pIndirectArgumentBuffer[i]));
+		if (FAILED(hr))
+		{
+			return false;
+		}
+		m_pIndirectArgumentBuffer[i]->SetName(L"Indirect Argument Upload Resource Heap");
 
-	// set cube2's constant buffer. You can see we are adding the size of ConstantBufferPerObject to the constant buffer
-	// resource heaps address. This is because cube1's constant buffer is stored at the beginning of the resource heap, while
-	// cube2's constant buffer data is stored after (256 bits from the start of the heap).
-	m_pCommandList->SetGraphicsRootConstantBufferView(0, m_pConstantBufferUploadHeaps[m_frameIndex]->GetGPUVirtualAddress() + m_ConstantBufferPerObjectAlignedSize);
+		CD3DX12_RANGE readRange(0, 0); // we never read it on the cpu
+		hr = m_pIndirectArgumentBuffer[i]->Map(0, &readRange, reinterpret_cast<void**>(&m_pIndirectRecords[i]));
+		if (FAILED(hr))
+		{
+			return false;
+		}
+	}
 
-	// draw second cube
-	m_pCommandList->DrawIndexedInstanced(m_numCubeIndices, 1, 0, 0, 0);
+	return true;
+}
 
-	// transition the "frameIndex" render target from the render target state to the present state. If the debug layer is enabled, you will receive a
-	// warning if present is called on the render target when it's not in the present state
-	m_pCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_pRenderTargets[m_frameIndex], D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT));
+bool Graphics::CreateDepthReadback()
+{
+	// laid out the way a copy of the depth buffer wants it, which pads every row out to the pitch alignment
+	D3D12_RESOURCE_DESC depthDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R32_TYPELESS, m_depthDesc.width, m_depthDesc.height, 1, 1, 1, 0,
+		D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL);
+	UINT64 readbackSize;
+	m_pDevice->GetCopyableFootprints(&depthDesc, 0, 1, 0, &m_depthReadbackFootprint, nullptr, nullptr, &readbackSize);
+	m_readbackDepth.resize(static_cast<size_t>(m_depthDesc.width) * m_depthDesc.height);
 
-	hr = m_pCommandList->Close();
-	if (FAILED(hr))
+	for (int i = 0; i < m_frameBufferCount; ++i)
+	{
+		HRESULT hr = m_pDevice->CreateCommittedResource(
+			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK),
+			D3D12_HEAP_FLAG_NONE,
+			&CD3DX12_RESOURCE_DESC::Buffer(readbackSize),
+			D3D12_RESOURCE_STATE_COPY_DEST, // readback heaps have to stay in copy dest
+			nullptr,
+			IID_PPV_ARGS(&m_pDepthReadback[i]));
+		if (FAILED(hr))
+		{
+			return false;
+		}
+		m_pDepthReadback[i]->SetName(L"Depth Readback Heap");
+	}
+
+	return true;
+}
+
+void Graphics::ReadBackDepth()
+{
+	if (!m_useOcclusionCulling || !m_depthReadbackRecorded[m_frameIndex])
+	{
+		return;
+	}
+
+	CD3DX12_RANGE readRange(0, static_cast<SIZE_T>(m_depthReadbackFootprint.Offset + static_cast<UINT64>(m_depthReadbackFootprint.Footprint.RowPitch) * m_depthDesc.height));
+	uint8_t* pMapped = nullptr;
+	if (FAILED(m_pDepthReadback[m_frameIndex]->Map(0, &readRange, reinterpret_cast<void**>(&pMapped))))
 	{
 		return;
 	}
+	for (uint32_t y = 0; y < m_depthDesc.height; ++y)
+	{
+		memcpy(&m_readbackDepth[static_cast<size_t>(y) * m_depthDesc.width], pMapped + m_depthReadbackFootprint.Offset +
+			static_cast<size_t>(y) * m_depthReadbackFootprint.Footprint.RowPitch, m_depthDesc.width * sizeof(float));
+	}
+	CD3DX12_RANGE writtenRange(0, 0); // nothing was written
+	m_pDepthReadback[m_frameIndex]->Unmap(0, &writtenRange);
+
+	m_depthPyramid.Build(m_readbackDepth.data(), m_depthDesc.width, m_depthDesc.height, &m_jobSystem);
+	m_depthPyramidViewProj = m_depthReadbackViewProj[m_frameIndex];
 }
 
-void Graphics::Render()
+void Graphics::SwapReloadedPipelineState()
 {
-	UpdatePipeline(); // update the pipeline by sending commands to the commandqueue
+	// release retired psos once the gpu can no longer be using them
+	for (size_t i = 0; i < m_retiredPSOs.size();)
+	{
+		if (m_retiredPSOs[i].releaseFrame <= m_frameCount)
+		{
+			m_retiredPSOs[i].pPSO->Release();
+			m_retiredPSOs[i] = m_retiredPSOs.back();
+			m_retiredPSOs.pop_back();
+			continue;
+		}
+		++i;
+	}
+
+	m_shaderHotReload.Update();
+
+	// frames already submitted may still reference the old psos, so keep them alive until each
+	// frame buffer has been waited on once more
+	auto retire = [this](ID3D12PipelineState* _pPSO)
+	{
+		RetiredPSO retired;
+		retired.pPSO = _pPSO;
+		retired.releaseFrame = m_frameCount + m_frameBufferCount;
+		m_retiredPSOs.push_back(retired);
+	};
+
+	ID3D12PipelineState* pReloadedPSO = m_shaderHotReload.TakeReadyPSO();
+	if (pReloadedPSO)
+	{
+		retire(m_pPipelineStateObject);
+		m_pPipelineStateObject = pReloadedPSO;
+	}
+	ID3D12PipelineState* pReloadedShadowPSO = m_shaderHotReload.TakeReadyPSO(m_shadowPipeline);
+	if (pReloadedShadowPSO)
+		retire(m_shadowMapPass.SwapPipelineState(pReloadedShadowPSO));
+}
 
-	// create an array of command lists (only one command list here)
-	ID3D12CommandList* ppCommandLists[] = { m_pCommandList };
+void Graphics::Render()
+{
+	// update the pipeline by sending commands to the commandqueue. a frame that could not be recorded is dropped, but
+	// the fence is still signalled below, or the next wait on this frame index would never return
+	bool recorded = UpdatePipeline();
+	if (recorded)
+	{
+		// the shadow cascades the frame graph ran go first so their maps are done before anything in the main list could read them
+		ID3D12CommandList* ppCommandLists[MAX_SHADOW_CASCADES + 1];
+		UINT commandListCount = 0;
+		for (UINT i = 0; i < m_shadowCommandListCount; ++i)
+		{
+			ppCommandLists[commandListCount++] = m_pShadowCommandLists[i];
+		}
+		ppCommandLists[commandListCount++] = m_pCommandList;
 
-	// execute the array of command lists
-	m_pCommandQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
+		// execute the array of command lists
+		m_pCommandQueue->ExecuteCommandLists(commandListCount, ppCommandLists);
+	}
 
 	// this command goes in at the end of our command queue. we will know when our command queue 
 	// has finished because the fence value will be set to "fenceValue" from the GPU since the command
 	// queue is being executed on the GPU
 	HRESULT hr = m_pCommandQueue->Signal(m_pFence[m_frameIndex], m_fenceValue[m_frameIndex]);
-	if (FAILED(hr))
+	if (FAILED(hr) || !recorded)
 	{
 		return;
 	}
@@ -237,6 +871,29 @@ void Graphics::Render()
 	{
 		return;
 	}
+
+	ShowFrameStats();
+}
+
+void Graphics::ShowFrameStats()
+{
+	// twice a second is often enough to read and rare enough not to cost anything
+	m_statsFrames++;
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	double seconds = std::chrono::duration<double>(now - m_statsTime).count();
+	if (seconds < 0.5)
+	{
+		return;
+	}
+
+	const CommandStats& commands = LastFrameCommandStats();
+	char title[512];
+	sprintf_s(title, "%s | %.0f fps | state %u set, %u skipped | barriers %u of %u in %u batches | %u draws | lods saved %u triangles | %u meshlets occluded",
+		m_windowTitle.c_str(), m_statsFrames / seconds, commands.issued, commands.skipped, commands.barriersIssued, commands.barriersRequested,
+		commands.barrierBatches, m_visibleDraws, m_lodTrianglesSaved, m_occludedMeshlets);
+	SetWindowTextA(m_hwnd, title);
+	m_statsTime = now;
+	m_statsFrames = 0;
 }
 
 void Graphics::WaitForPreviousFrame()
@@ -268,6 +925,10 @@ void Graphics::WaitForPreviousFrame()
 
 void Graphics::CleanUp()
 {
+	// stop the watcher and let any in flight rebuild or bake finish before the device goes away
+	m_shaderHotReload.Shutdown();
+	m_jobSystem.Shutdown();
+
 	// wait for the gpu to finish all frames
 	for (int i = 0; i < m_frameBufferCount; ++i)
 	{
@@ -291,10 +952,30 @@ void Graphics::CleanUp()
 		m_pRenderTargets[i]->Release();
 		m_pCommandAllocator[i]->Release();
 		m_pFence[i]->Release();
+		m_pIndirectArgumentBuffer[i]->Release();
+		m_pDepthReadback[i]->Release();
 	};
+	for (auto& commandSignature : m_commandSignatures)
+	{
+		if (commandSignature.second)
+			commandSignature.second->Release();
+	}
+	m_commandSignatures.clear();
+
+	for (RetiredPSO& retired : m_retiredPSOs)
+	{
+		retired.pPSO->Release();
+	}
+	m_retiredPSOs.clear();
 
 	m_pPipelineStateObject->Release();
-	m_pRootSignature->Release();
+	m_transientPool.Release();
+	m_clusteredLighting.Release();
+	m_bakedLighting.Release();
+	m_shadowMapPass.Release();
+	m_pDepthStencilBuffer = nullptr;
+	m_rootSignatureCache.Release();
+	m_pRootSignature = nullptr;
 	m_pVertexBuffer->Release();
 }
 
@@ -505,36 +1186,27 @@ bool Graphics::InitFence()
 
 bool Graphics::InitRootSignature()
 {
-	D3D12_ROOT_DESCRIPTOR rootCBVDescriptor;
-	rootCBVDescriptor.RegisterSpace = 0;
-	rootCBVDescriptor.ShaderRegister = 0;
-
-	// create a root parameter and fill it out
-	D3D12_ROOT_PARAMETER  rootParameters[1]; // only one parameter right now
-	rootParameters[0].ParameterType = D3D12_ROOT_PARAMETER_TYPE_CBV; // this is a constant buffer view root descriptor
-	rootParameters[0].Descriptor = rootCBVDescriptor; // this is the root descriptor for this root parameter
-	rootParameters[0].ShaderVisibility = D3D12_SHADER_VISIBILITY_VERTEX; // our pixel shader will be the only shader accessing this parameter for now
-
-	CD3DX12_ROOT_SIGNATURE_DESC rootSignatureDesc;
-	rootSignatureDesc.Init(_countof(rootParameters), // we have 1 root parameter
-		rootParameters, // a pointer to the beginning of our root parameters array
-		0,
-		nullptr,
-		D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT | // we can deny shader stages here for better performance
+	RootSignatureDesc rootSignatureDesc;
+
+	// the per object data is the wvp matrix and the normal matrix (28 DWORDs), which fits in the root signature as
+	// constants. the vertex shader reads it from b0 exactly as it would a constant buffer
+	m_rootParamPerObject = rootSignatureDesc.AddConstants(0, sizeof(ConstantBufferPerObject) / sizeof(UINT), D3D12_SHADER_VISIBILITY_VERTEX);
+
+	// the pixel shader lights with the clusters, which it reads straight from the upload buffers
+	m_clusteredLighting.AddRootParameters(rootSignatureDesc);
+	// and takes the light on anything that was baked from the lightmap instead
+	m_bakedLighting.AddRootParameters(rootSignatureDesc);
+	// the sun's light is shadowed by the cascades
+	m_shadowMapPass.AddRootParameters(rootSignatureDesc);
+
+	rootSignatureDesc.SetFlags(D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT | // we can deny shader stages here for better performance
 		D3D12_ROOT_SIGNATURE_FLAG_DENY_HULL_SHADER_ROOT_ACCESS |
 		D3D12_ROOT_SIGNATURE_FLAG_DENY_DOMAIN_SHADER_ROOT_ACCESS |
-		D3D12_ROOT_SIGNATURE_FLAG_DENY_GEOMETRY_SHADER_ROOT_ACCESS |
-		D3D12_ROOT_SIGNATURE_FLAG_DENY_PIXEL_SHADER_ROOT_ACCESS);
-
-	ID3DBlob* signature;
-	HRESULT hr = D3D12SerializeRootSignature(&rootSignatureDesc, D3D_ROOT_SIGNATURE_VERSION_1, &signature, nullptr);
-	if (FAILED(hr))
-	{
-		return false;
-	}
+		D3D12_ROOT_SIGNATURE_FLAG_DENY_GEOMETRY_SHADER_ROOT_ACCESS);
 
-	hr = m_pDevice->CreateRootSignature(0, signature->GetBufferPointer(), signature->GetBufferSize(), IID_PPV_ARGS(&m_pRootSignature));
-	if (FAILED(hr))
+	// the cache owns the root signature, any other pso asking for the same layout gets this one back
+	m_pRootSignature = m_rootSignatureCache.GetOrCreate(m_pDevice, rootSignatureDesc);
+	if (m_pRootSignature == nullptr)
 	{
 		return false;
 	}
@@ -609,8 +1281,9 @@ bool Graphics::CreateInputLayout()
 	// how to read the vertex data bound to it.
 	D3D12_INPUT_ELEMENT_DESC inputLayout[] =
 	{
-		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-		{ "COLOR", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
+		{ "POSITION", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+		{ "NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, 8, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+		{ "COLOR", 0, DXGI_FORMAT_R8G8B8A8_UNORM, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
 	};
 
 	// fill out an input layout description structure
@@ -625,85 +1298,23 @@ bool Graphics::CreateInputLayout()
 }
 
 
-bool Graphics::CreatePSO(PSOData& _psoData)
+ID3D12PipelineState* Graphics::BuildPipelineState(ID3DBlob* _pVertexShader, ID3DBlob* _pPixelShader)
 {
+	// this is also called from the shader hot reload worker, so it only uses the (free threaded) device
 
-	// create root signature
-	HRESULT hr;
-	//CreateConstantBuffer();
+	// fill out a shader bytecode structure, which is basically just a pointer
+	// to the shader bytecode and the size of the shader bytecode
+	D3D12_SHADER_BYTECODE vertexShaderBytecode = {};
+	vertexShaderBytecode.BytecodeLength = _pVertexShader->GetBufferSize();
+	vertexShaderBytecode.pShaderBytecode = _pVertexShader->GetBufferPointer();
 
-	// create vertex and pixel shaders
+	// fill out shader bytecode structure for pixel shader
+	D3D12_SHADER_BYTECODE pixelShaderBytecode = {};
+	pixelShaderBytecode.BytecodeLength = _pPixelShader->GetBufferSize();
+	pixelShaderBytecode.pShaderBytecode = _pPixelShader->GetBufferPointer();
 
-	// when debugging, we can compile the shader files at runtime.
-	// but for release versions, we can compile the hlsl shaders
-	// with fxc.exe to create .cso files, which contain the shader
-	// bytecode. We can load the .cso files at runtime to get the
-	// shader bytecode, which of course is faster than compiling
-	// them at runtime
-
-	// compile vertex shader
-	ID3DBlob* vertexShader; // d3d blob for holding vertex shader bytecode
-	ID3DBlob* errorBuff; // a buffer holding the error data if any
-	hr = D3DCompileFromFile(L"VertexShader.hlsl",
-		nullptr,
-		nullptr,
-		"main",
-		"vs_5_0",
-		D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION,
-		0,
-		&vertexShader,
-		&errorBuff);
-	if (FAILED(hr))
-	{
-		OutputDebugStringA((char*)errorBuff->GetBufferPointer());
-		return false;
-	}
-
-	// fill out a shader bytecode structure, which is basically just a pointer
-	// to the shader bytecode and the size of the shader bytecode
-	D3D12_SHADER_BYTECODE vertexShaderBytecode = {};
-	vertexShaderBytecode.BytecodeLength = vertexShader->GetBufferSize();
-	vertexShaderBytecode.pShaderBytecode = vertexShader->GetBufferPointer();
-
-	// compile pixel shader
-	ID3DBlob* pixelShader;
-	hr = D3DCompileFromFile(L"PixelShader.hlsl",
-		nullptr,
-		nullptr,
-		"main",
-		"ps_5_0",
-		D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION,
-		0,
-		&pixelShader,
-		&errorBuff);
-	if (FAILED(hr))
-	{
-		OutputDebugStringA((char*)errorBuff->GetBufferPointer());
-		return false;
-	}
-
-	// fill out shader bytecode structure for pixel shader
-	D3D12_SHADER_BYTECODE pixelShaderBytecode = {};
-	pixelShaderBytecode.BytecodeLength = pixelShader->GetBufferSize();
-	pixelShaderBytecode.pShaderBytecode = pixelShader->GetBufferPointer();
-
-	// create input layout
-
-	// The input layout is used by the Input Assembler so that it knows
-	// how to read the vertex data bound to it.
-
-	D3D12_INPUT_ELEMENT_DESC inputLayout[] =
-	{
-		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-		{ "COLOR", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
-	};
-
-	// fill out an input layout description structure
-	D3D12_INPUT_LAYOUT_DESC inputLayoutDesc = {};
-
-	// we can get the number of elements in an array by "sizeof(array) / sizeof(arrayElementType)"
-	inputLayoutDesc.NumElements = sizeof(inputLayout) / sizeof(D3D12_INPUT_ELEMENT_DESC);
-	inputLayoutDesc.pInputElementDescs = inputLayout;
+	// fill out an input layout description structure
+	D3D12_INPUT_LAYOUT_DESC inputLayoutDesc = VertexInputLayout();
 
 	// create a pipeline state object (PSO)
 
@@ -733,52 +1344,57 @@ bool Graphics::CreatePSO(PSOData& _psoData)
 	psoDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT); // a default blent state.
 	psoDesc.NumRenderTargets = 1; // we are only binding one render target
 	psoDesc.DepthStencilState = CD3DX12_DEPTH_STENCIL_DESC(D3D12_DEFAULT); // a default depth stencil state
+
 	// create the pso
-	hr = m_pDevice->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&m_pPipelineStateObject));
+	ID3D12PipelineState* pPipelineState = nullptr;
+	HRESULT hr = m_pDevice->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&pPipelineState));
 	if (FAILED(hr))
+	{
+		return nullptr;
+	}
+	return pPipelineState;
+}
+
+bool Graphics::CreatePSO(PSOData& _psoData)
+{
+	HRESULT hr = S_OK;
+
+	// create vertex and pixel shaders
+	ID3DBlob* vertexShader; // d3d blob for holding vertex shader bytecode
+	std::vector<std::string> vertexIncludes;
+	if (!ShaderHotReload::CompileShader(m_vertexShaderFile, "vs_5_0", &vertexShader, &vertexIncludes))
 	{
 		return false;
 	}
 
-	Vertex vList[] = {
-		// front face
-		Vertex({ -0.5f,  0.5f, -0.5f}, {1.0f, 0.0f, 0.0f, 1.0f }),
-		Vertex({  0.5f, -0.5f, -0.5f}, { 1.0f, 0.0f, 1.0f, 1.0f }),
-		Vertex({ -0.5f, -0.5f, -0.5f}, { 0.0f, 0.0f, 1.0f, 1.0f }),
-		Vertex({  0.5f,  0.5f, -0.5f}, { 0.0f, 1.0f, 0.0f, 1.0f }),
-
-		// right side face
-		Vertex({  0.5f, -0.5f, -0.5f}, { 1.0f, 0.0f, 0.0f, 1.0f }),
-		Vertex({  0.5f,  0.5f,  0.5f}, { 1.0f, 0.0f, 1.0f, 1.0f }),
-		Vertex({  0.5f, -0.5f,  0.5f}, { 0.0f, 0.0f, 1.0f, 1.0f }),
-		Vertex({  0.5f,  0.5f, -0.5f}, { 0.0f, 1.0f, 0.0f, 1.0f }),
-
-		// left side face
-		Vertex({ -0.5f,  0.5f,  0.5f}, { 1.0f, 0.0f, 0.0f, 1.0f }),
-		Vertex({ -0.5f, -0.5f, -0.5f}, { 1.0f, 0.0f, 1.0f, 1.0f }),
-		Vertex({ -0.5f, -0.5f,  0.5f}, { 0.0f, 0.0f, 1.0f, 1.0f }),
-		Vertex({ -0.5f,  0.5f, -0.5f}, { 0.0f, 1.0f, 0.0f, 1.0f }),
-
-		// back face
-		Vertex({  0.5f,  0.5f,  0.5f}, { 1.0f, 0.0f, 0.0f, 1.0f }),
-		Vertex({ -0.5f, -0.5f,  0.5f}, { 1.0f, 0.0f, 1.0f, 1.0f }),
-		Vertex({  0.5f, -0.5f,  0.5f}, { 0.0f, 0.0f, 1.0f, 1.0f }),
-		Vertex({ -0.5f,  0.5f,  0.5f}, { 0.0f, 1.0f, 0.0f, 1.0f }),
-
-		// top face
-		Vertex({ -0.5f,  0.5f, -0.5f}, { 1.0f, 0.0f, 0.0f, 1.0f }),
-		Vertex({ 0.5f,  0.5f,  0.5f}, { 1.0f, 0.0f, 1.0f, 1.0f }),
-		Vertex({ 0.5f,  0.5f, -0.5f}, { 0.0f, 0.0f, 1.0f, 1.0f }),
-		Vertex({ -0.5f,  0.5f,  0.5f}, { 0.0f, 1.0f, 0.0f, 1.0f }),
-
-		// bottom face
-		Vertex({  0.5f, -0.5f,  0.5f}, { 1.0f, 0.0f, 0.0f, 1.0f }),
-		Vertex({ -0.5f, -0.5f, -0.5f}, { 1.0f, 0.0f, 1.0f, 1.0f }),
-		Vertex({  0.5f, -0.5f, -0.5f}, { 0.0f, 0.0f, 1.0f, 1.0f }),
-		Vertex({ -0.5f, -0.5f,  0.5f}, {0.0f, 1.0f, 0.0f, 1.0f })
-	};
+	ID3DBlob* pixelShader;
+	std::vector<std::string> pixelIncludes;
+	if (!ShaderHotReload::CompileShader(m_pixelShaderFile, "ps_5_0", &pixelShader, &pixelIncludes))
+	{
+		vertexShader->Release();
+		return false;
+	}
+
+	m_pPipelineStateObject = BuildPipelineState(vertexShader, pixelShader);
+
+	// hot reload keeps the blobs so that editing one shader only recompiles that one
+	m_shaderHotReload.SetVertexShader(m_vertexShaderFile, vertexShader, vertexIncludes);
+	m_shaderHotReload.SetPixelShader(m_pixelShaderFile, pixelShader, pixelIncludes);
+	vertexShader->Release();
+	pixelShader->Release();
+
+	if (m_pPipelineStateObject == nullptr)
+	{
+		return false;
+	}
+
+	if (!LoadMesh())
+	{
+		return false;
+	}
 
-	int vBufferSize = sizeof(vList);
+	// the vertices go from the mapped file straight into the upload heap
+	int vBufferSize = static_cast<int>(m_mesh.VertexBytes());
 
 	// create default heap
 	// default heap is memory on the GPU. Only the GPU has access to this memory
@@ -811,7 +1427,7 @@ bool Graphics::CreatePSO(PSOData& _psoData)
 
 	// store vertex buffer in upload heap
 	D3D12_SUBRESOURCE_DATA vertexData = {};
-	vertexData.pData = reinterpret_cast<BYTE*>(vList); // pointer to our vertex array
+	vertexData.pData = m_mesh.Vertices(); // pointer to our vertex array
 	vertexData.RowPitch = vBufferSize; // size of all our triangle vertex data
 	vertexData.SlicePitch = vBufferSize; // also the size of our triangle vertex data
 
@@ -837,11 +1453,51 @@ bool Graphics::CreatePSO(PSOData& _psoData)
 
 	// create a vertex buffer view for the triangle. We get the GPU memory address to the vertex pointer using the GetGPUVirtualAddress() method
 	m_vertexBufferView.BufferLocation = m_pVertexBuffer->GetGPUVirtualAddress();
-	m_vertexBufferView.StrideInBytes = sizeof(Vertex);
+	m_vertexBufferView.StrideInBytes = sizeof(PackedVertex);
 	m_vertexBufferView.SizeInBytes = vBufferSize;
 	return true;
 }
 
+bool Graphics::LoadMesh()
+{
+	// the source is converted once into a .mesh next to it, which every later start maps and uploads as it is. it is
+	// converted again when the source changes or the file does not match what we draw with
+	std::string binaryFile = m_meshFile.substr(0, m_meshFile.find_last_of('.')) + ".mesh";
+	uint64_t sourceSize;
+	uint64_t sourceTime;
+	MeshFile::SourceStamp(m_meshFile, sourceSize, sourceTime);
+
+	bool loaded = m_mesh.Open(binaryFile, true, &m_jobSystem) && MatchesVertex(m_mesh) &&
+		(sourceSize == 0 || (m_mesh.Header().sourceSize == sourceSize && m_mesh.Header().sourceTime == sourceTime));
+	if (!loaded)
+	{
+		m_mesh.Close();
+		MeshOptimizeStats stats;
+		loaded = MeshFile::Convert(m_meshFile, binaryFile, &m_jobSystem, &stats) && m_mesh.Open(binaryFile, false) && MatchesVertex(m_mesh);
+
+		// what reordering did for the vertex cache and what the lods came to, to the debugger's output window
+		if (loaded)
+		{
+			char message[160];
+			sprintf_s(message, "%s: acmr %.3f -> %.3f, atvr %.3f -> %.3f\n", m_meshFile.c_str(), stats.before.acmr, stats.after.acmr,
+				stats.before.atvr, stats.after.atvr);
+			OutputDebugStringA(message);
+			for (uint32_t lod = 0; lod < m_mesh.LodCount(); ++lod)
+			{
+				sprintf_s(message, "  lod %u: %u triangles, error %g\n", lod, m_mesh.Submeshes()[m_mesh.Lods()[lod].firstSubmesh].indexCount / 3,
+					m_mesh.Lods()[lod].error);
+				OutputDebugStringA(message);
+			}
+		}
+	}
+	if (loaded)
+	{
+		m_meshDecodeMat = VertexCompression::PositionDecodeMatrix(m_mesh.Header().boundsMin, m_mesh.Header().boundsMax);
+		m_meshletCuller.Init(m_mesh.Meshlets(), m_mesh.MeshletCount());
+	}
+	return loaded;
+}
+
 bool Graphics::CreateVertexBuffer()
 {
 	// a triangle
@@ -852,35 +1508,8 @@ bool Graphics::CreateVertexBuffer()
 
 bool Graphics::CreateIndexBuffer(int _vBufferSize, ID3D12Resource* _pVBufferUploadHeap)
 {
-	DWORD iList[] = {
-		// ffront face
-		0, 1, 2, // first triangle
-		0, 3, 1, // second triangle
-
-		// left face
-		4, 5, 6, // first triangle
-		4, 7, 5, // second triangle
-
-		// right face
-		8, 9, 10, // first triangle
-		8, 11, 9, // second triangle
-
-		// back face
-		12, 13, 14, // first triangle
-		12, 15, 13, // second triangle
-
-		// top face
-		16, 17, 18, // first triangle
-		16, 19, 17, // second triangle
-
-		// bottom face
-		20, 21, 22, // first triangle
-		20, 23, 21, // second triangle
-	};
-	int iBufferSize = sizeof(iList);
-
-	m_numCubeIndices = sizeof(iList) / sizeof(DWORD);
-
+	int iBufferSize = static_cast<int>(m_mesh.IndexBytes());
+	m_numCubeIndices = static_cast<int>(m_mesh.Submeshes()[m_mesh.Lods()[0].firstSubmesh].indexCount);
 
 	// create default heap to hold index buffer
 	m_pDevice->CreateCommittedResource(
@@ -898,15 +1527,15 @@ bool Graphics::CreateIndexBuffer(int _vBufferSize, ID3D12Resource* _pVBufferUplo
 	m_pDevice->CreateCommittedResource(
 		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD), // upload heap
 		D3D12_HEAP_FLAG_NONE, // no flags
-		&CD3DX12_RESOURCE_DESC::Buffer(_vBufferSize), // resource description for a buffer
+		&CD3DX12_RESOURCE_DESC::Buffer(iBufferSize), // resource description for a buffer
 		D3D12_RESOURCE_STATE_GENERIC_READ, // GPU will read from this buffer and copy its contents to the default heap
 		nullptr,
 		IID_PPV_ARGS(&iBufferUploadHeap));
-	_pVBufferUploadHeap->SetName(L"Index Buffer Upload Resource Heap");
+	iBufferUploadHeap->SetName(L"Index Buffer Upload Resource Heap");
 
 	// store vertex buffer in upload heap
 	D3D12_SUBRESOURCE_DATA indexData = {};
-	indexData.pData = reinterpret_cast<BYTE*>(iList); // pointer to our index array
+	indexData.pData = m_mesh.Indices(); // pointer to our index array
 	indexData.RowPitch = iBufferSize; // size of all our index buffer
 	indexData.SlicePitch = iBufferSize; // also the size of our index buffer
 
@@ -919,7 +1548,8 @@ bool Graphics::CreateIndexBuffer(int _vBufferSize, ID3D12Resource* _pVBufferUplo
 
 	// create a vertex buffer view for the triangle. We get the GPU memory address to the vertex pointer using the GetGPUVirtualAddress() method
 	m_indexBufferView.BufferLocation = m_pIndexBuffer->GetGPUVirtualAddress();
-	m_indexBufferView.Format = DXGI_FORMAT_R32_UINT; // 32-bit unsigned integer (this is what a dword is, double word, a word is 2 bytes)
+	// 16-bit indices when the mesh has few enough vertices, otherwise 32-bit (a dword, double word, a word is 2 bytes)
+	m_indexBufferView.Format = m_mesh.Header().indexSize == sizeof(uint16_t) ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
 	m_indexBufferView.SizeInBytes = iBufferSize;
 	return true;
 }
@@ -937,58 +1567,15 @@ bool Graphics::CreateDepthBuffer(LWindow& _window)
 		return false;
 	}
 
-	D3D12_DEPTH_STENCIL_VIEW_DESC depthStencilDesc = {};
-	depthStencilDesc.Format = DXGI_FORMAT_D32_FLOAT;
-	depthStencilDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2D;
-	depthStencilDesc.Flags = D3D12_DSV_FLAG_NONE;
-
-	D3D12_CLEAR_VALUE depthOptimizedClearValue = {};
-	depthOptimizedClearValue.Format = DXGI_FORMAT_D32_FLOAT;
-	depthOptimizedClearValue.DepthStencil.Depth = 1.0f;
-	depthOptimizedClearValue.DepthStencil.Stencil = 0;
-	
-	m_pDevice->CreateCommittedResource(
-		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-		D3D12_HEAP_FLAG_NONE,
-		&CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_D32_FLOAT, _window.getWidth(), _window.getHeight(), 1, 0, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL),
-		D3D12_RESOURCE_STATE_DEPTH_WRITE,
-		&depthOptimizedClearValue,
-		IID_PPV_ARGS(&m_pDepthStencilBuffer)
-	);
 	m_pDSDescriptorHeap->SetName(L"Depth/Stencil Resource Heap");
 
-	m_pDevice->CreateDepthStencilView(m_pDepthStencilBuffer, &depthStencilDesc, m_pDSDescriptorHeap->GetCPUDescriptorHandleForHeapStart());
-
-	return true;
-}
-
-bool Graphics::CreatePerObjectConstantBuffer()
-{
-	HRESULT hr;
-	for (int i = 0; i < m_frameBufferCount; ++i)
-	{
-		// create resource for cube 1
-		hr = m_pDevice->CreateCommittedResource(
-			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD), // this heap will be used to upload the constant buffer data
-			D3D12_HEAP_FLAG_NONE, // no flags
-			&CD3DX12_RESOURCE_DESC::Buffer(1024 * 64), // size of the resource heap. Must be a multiple of 64KB for single-textures and constant buffers
-			D3D12_RESOURCE_STATE_GENERIC_READ, // will be data that is read from so we keep it in the generic read state
-			nullptr, // we do not have use an optimized clear value for constant buffers
-			IID_PPV_ARGS(&m_pConstantBufferUploadHeaps[i]));
-		m_pConstantBufferUploadHeaps[i]->SetName(L"Constant Buffer Upload Resource Heap");
-
-		ZeroMemory(&m_cbPerObject, sizeof(m_cbPerObject));
-
-		CD3DX12_RANGE readRange(0, 0);    // We do not intend to read from this resource on the CPU. (so end is less than or equal to begin)
+	// the depth buffer itself belongs to the frame graph, which places it in the transient heap.
+	// the view is created once the first frame has given it memory. it is typeless so the
+	// depth readback's footprint matches it
+	const FLOAT depthClear[4] = { 1.0f, 0.0f, 0.0f, 0.0f };
+	m_depthDesc = TransientResourcePool::DescribeTexture(m_pDevice, _window.getWidth(), _window.getHeight(), DXGI_FORMAT_R32_TYPELESS,
+		D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL, depthClear);
 
-		// map the resource heap to get a gpu virtual address to the beginning of the heap
-		hr = m_pConstantBufferUploadHeaps[i]->Map(0, &readRange, reinterpret_cast<void**>(&m_pCBVGPUAddress[i]));
-
-		// Because of the constant read alignment requirements, constant buffer views must be 256 bit aligned. Our buffers are smaller than 256 bits,
-		// so we need to add spacing between the two buffers, so that the second buffer starts at 256 bits from the beginning of the resource heap.
-		memcpy(m_pCBVGPUAddress[i], &m_cbPerObject, sizeof(m_cbPerObject)); // cube1's constant buffer data
-		memcpy(m_pCBVGPUAddress[i] + m_ConstantBufferPerObjectAlignedSize, &m_cbPerObject, sizeof(m_cbPerObject)); // cube2's constant buffer data
-	}
 	return true;
 }
 
@@ -1027,636 +1614,35 @@ bool Graphics::InitScene(int _width, int _height)
 	tmpMat = XMMatrixTranslationFromVector(posVec); // create translation matrix from cube2's position offset vector
 	XMStoreFloat4x4(&m_cube2RotMat, XMMatrixIdentity()); // initialize cube2's rotation matrix to identity matrix
 	XMStoreFloat4x4(&m_cube2WorldMat, tmpMat); // store cube2's world matrix
-	return true;
-}
-
-bool Graphics::Test(int _width, int _height, HWND _hwnd)
-{
-	HRESULT hr;
-
-	// -- Create the Device -- //
-
-	IDXGIFactory4* dxgiFactory;
-	hr = CreateDXGIFactory1(IID_PPV_ARGS(&dxgiFactory));
-	if (FAILED(hr))
-	{
-		return false;
-	}
-
-	IDXGIAdapter1* adapter; // adapters are the graphics card (this includes the embedded graphics on the motherboard)
-
-	int adapterIndex = 0; // we'll start looking for directx 12  compatible graphics devices starting at index 0
-
-	bool adapterFound = false; // set this to true when a good one was found
-
-								 // find first hardware gpu that supports d3d 12
-	while (dxgiFactory->EnumAdapters1(adapterIndex, &adapter) != DXGI_ERROR_NOT_FOUND)
-	{
-		DXGI_ADAPTER_DESC1 desc;
-		adapter->GetDesc1(&desc);
-
-		if (desc.Flags & DXGI_ADAPTER_FLAG_SOFTWARE)
-		{
-			// we dont want a software device
-			continue;
-		}
-
-		// we want a device that is compatible with direct3d 12 (feature level 11 or higher)
-		hr = D3D12CreateDevice(adapter, D3D_FEATURE_LEVEL_11_0, _uuidof(ID3D12Device), nullptr);
-		if (SUCCEEDED(hr))
-		{
-			adapterFound = true;
-			break;
-		}
-
-		adapterIndex++;
-	}
-
-	if (!adapterFound)
-	{
-		return false;
-	}
-
-	// Create the device
-	hr = D3D12CreateDevice(
-		adapter,
-		D3D_FEATURE_LEVEL_11_0,
-		IID_PPV_ARGS(&m_pDevice)
-	);
-	if (FAILED(hr))
-	{
-		return false;
-	}
-
-	// -- Create a direct command queue -- //
-
-	D3D12_COMMAND_QUEUE_DESC cqDesc = {};
-	cqDesc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
-	cqDesc.Type = D3D12_COMMAND_LIST_TYPE_DIRECT; // direct means the gpu can directly execute this command queue
-
-	hr = m_pDevice->CreateCommandQueue(&cqDesc, IID_PPV_ARGS(&m_pCommandQueue)); // create the command queue
-	if (FAILED(hr))
-	{
-		return false;
-	}
-
-	// -- Create the Swap Chain (double/tripple buffering) -- //
-
-	DXGI_MODE_DESC backBufferDesc = {}; // this is to describe our display mode
-	backBufferDesc.Width = _width; // buffer width
-	backBufferDesc.Height = _height; // buffer height
-	backBufferDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM; // format of the buffer (rgba 32 bits, 8 bits for each chanel)
-
-														// describe our multi-sampling. We are not multi-sampling, so we set the count to 1 (we need at least one sample of course)
-	DXGI_SAMPLE_DESC sampleDesc = {};
-	sampleDesc.Count = 1; // multisample count (no multisampling, so we just put 1, since we still need 1 sample)
-
-							// Describe and create the swap chain.
-	DXGI_SWAP_CHAIN_DESC swapChainDesc = {};
-	swapChainDesc.BufferCount = m_frameBufferCount; // number of buffers we have
-	swapChainDesc.BufferDesc = backBufferDesc; // our back buffer description
-	swapChainDesc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT; // this says the pipeline will render to this swap chain
-	swapChainDesc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD; // dxgi will discard the buffer (data) after we call present
-	swapChainDesc.OutputWindow = _hwnd; // handle to our window
-	swapChainDesc.SampleDesc = sampleDesc; // our multi-sampling description
-	swapChainDesc.Windowed = true; // set to true, then if in fullscreen must call SetFullScreenState with true for full screen to get uncapped fps
-
-	IDXGISwapChain* tempSwapChain;
-
-	dxgiFactory->CreateSwapChain(
-		m_pCommandQueue, // the queue will be flushed once the swap chain is created
-		&swapChainDesc, // give it the swap chain description we created above
-		&tempSwapChain // store the created swap chain in a temp IDXGISwapChain interface
-	);
-
-	m_pSwapChain = static_cast<IDXGISwapChain3*>(tempSwapChain);
-
-	m_frameIndex = m_pSwapChain->GetCurrentBackBufferIndex();
-
-	// -- Create the Back Buffers (render target views) Descriptor Heap -- //
-
-	// describe an rtv descriptor heap and create
-	D3D12_DESCRIPTOR_HEAP_DESC rtvHeapDesc = {};
-	rtvHeapDesc.NumDescriptors = m_frameBufferCount; // number of descriptors for this heap.
-	rtvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV; // this heap is a render target view heap
 
-														 // This heap will not be directly referenced by the shaders (not shader visible), as this will store the output from the pipeline
-														 // otherwise we would set the heap's flag to D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE
-	rtvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
-	hr = m_pDevice->CreateDescriptorHeap(&rtvHeapDesc, IID_PPV_ARGS(&m_pRTVDescriptorHeap));
-	if (FAILED(hr))
+	// split the view frustum into light clusters. the lights are culled against them every frame
+	LightClusterDesc clusterDesc;
+	clusterDesc.screenWidth = _width;
+	clusterDesc.screenHeight = _height;
+	m_lightClusters.Init(clusterDesc, m_cameraProjMat);
+	if (!m_clusteredLighting.Init(m_pDevice, m_maxClusteredLights, m_lightClusters.ClusterCount(), m_maxClusteredLightIndices, m_frameBufferCount))
 	{
 		return false;
 	}
+	CreateLights();
 
-	// get the size of a descriptor in this heap (this is a rtv heap, so only rtv descriptors should be stored in it.
-	// descriptor sizes may vary from device to device, which is why there is no set size and we must ask the 
-	// device to give us the size. we will use this size to increment a descriptor handle offset
-	m_rtvDescriptorSize = m_pDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
-
-	// get a handle to the first descriptor in the descriptor heap. a handle is basically a pointer,
-	// but we cannot literally use it like a c++ pointer.
-	CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(m_pRTVDescriptorHeap->GetCPUDescriptorHandleForHeapStart());
-
-	// Create a RTV for each buffer (double buffering is two buffers, tripple buffering is 3).
-	for (int i = 0; i < m_frameBufferCount; i++)
-	{
-		// first we get the n'th buffer in the swap chain and store it in the n'th
-		// position of our ID3D12Resource array
-		hr = m_pSwapChain->GetBuffer(i, IID_PPV_ARGS(&m_pRenderTargets[i]));
-		if (FAILED(hr))
-		{
-			return false;
-		}
-
-		// the we "create" a render target view which binds the swap chain buffer (ID3D12Resource[n]) to the rtv handle
-		m_pDevice->CreateRenderTargetView(m_pRenderTargets[i], nullptr, rtvHandle);
-
-		// we increment the rtv handle by the rtv descriptor size we got above
-		rtvHandle.Offset(1, m_rtvDescriptorSize);
-	}
-
-	// -- Create the Command Allocators -- //
-
-	for (int i = 0; i < m_frameBufferCount; i++)
-	{
-		hr = m_pDevice->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&m_pCommandAllocator[i]));
-		if (FAILED(hr))
-		{
-			return false;
-		}
-	}
-
-	// -- Create a Command List -- //
+	// the sun comes in from above at an angle
+	XMStoreFloat3(&m_sunDirection, XMVector3Normalize(XMVectorSet(0.3f, -1.0f, 0.4f, 0.0f)));
+	// the far plane is a long way out, so the shadows stop well before it
+	m_shadowDesc.maxDistance = 100.0f;
+	m_cascadedShadows.Init(m_shadowDesc, m_cameraProjMat);
 
-	// create the command list with the first allocator
-	hr = m_pDevice->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, m_pCommandAllocator[m_frameIndex], NULL, IID_PPV_ARGS(&m_pCommandList));
-	if (FAILED(hr))
+	// a lightmap from an earlier run or from the tool's "-bake", if there is one. without it everything is lit from the clusters
+	if (!m_bakedLighting.Init(m_pDevice))
 	{
 		return false;
 	}
+	m_bakedLighting.LoadLightmap(m_lightmapFile);
+	// the baked lighting's heap is the one set for the scene's draws, so the shadow map's view goes in there too
+	m_shadowMapPass.WriteView(m_pDevice, m_bakedLighting.SharedViewCpu(m_shadowMapView));
 
-	// -- Create a Fence & Fence Event -- //
-
-	// create the fences
-	for (int i = 0; i < m_frameBufferCount; i++)
-	{
-		hr = m_pDevice->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_pFence[i]));
-		if (FAILED(hr))
-		{
-			return false;
-		}
-		m_fenceValue[i] = 0; // set the initial fence value to 0
-	}
-
-	// create a handle to a fence event
-	m_fenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
-	if (m_fenceEvent == nullptr)
-	{
-		return false;
-	}
-
-
-	// create root signature
-
-	// create a root descriptor, which explains where to find the data for this root parameter
-	D3D12_ROOT_DESCRIPTOR rootCBVDescriptor;
-	rootCBVDescriptor.RegisterSpace = 0;
-	rootCBVDescriptor.ShaderRegister = 0;
-
-	// create a root parameter and fill it out
-	D3D12_ROOT_PARAMETER  rootParameters[1]; // only one parameter right now
-	rootParameters[0].ParameterType = D3D12_ROOT_PARAMETER_TYPE_CBV; // this is a constant buffer view root descriptor
-	rootParameters[0].Descriptor = rootCBVDescriptor; // this is the root descriptor for this root parameter
-	rootParameters[0].ShaderVisibility = D3D12_SHADER_VISIBILITY_VERTEX; // our pixel shader will be the only shader accessing this parameter for now
-
-	CD3DX12_ROOT_SIGNATURE_DESC rootSignatureDesc;
-	rootSignatureDesc.Init(_countof(rootParameters), // we have 1 root parameter
-		rootParameters, // a pointer to the beginning of our root parameters array
-		0,
-		nullptr,
-		D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT | // we can deny shader stages here for better performance
-		D3D12_ROOT_SIGNATURE_FLAG_DENY_HULL_SHADER_ROOT_ACCESS |
-		D3D12_ROOT_SIGNATURE_FLAG_DENY_DOMAIN_SHADER_ROOT_ACCESS |
-		D3D12_ROOT_SIGNATURE_FLAG_DENY_GEOMETRY_SHADER_ROOT_ACCESS |
-		D3D12_ROOT_SIGNATURE_FLAG_DENY_PIXEL_SHADER_ROOT_ACCESS);
-
-	ID3DBlob* signature;
-	hr = D3D12SerializeRootSignature(&rootSignatureDesc, D3D_ROOT_SIGNATURE_VERSION_1, &signature, nullptr);
-	if (FAILED(hr))
-	{
-		return false;
-	}
-
-	hr = m_pDevice->CreateRootSignature(0, signature->GetBufferPointer(), signature->GetBufferSize(), IID_PPV_ARGS(&m_pRootSignature));
-	if (FAILED(hr))
-	{
-		return false;
-	}
-
-	// create vertex and pixel shaders
-
-	// when debugging, we can compile the shader files at runtime.
-	// but for release versions, we can compile the hlsl shaders
-	// with fxc.exe to create .cso files, which contain the shader
-	// bytecode. We can load the .cso files at runtime to get the
-	// shader bytecode, which of course is faster than compiling
-	// them at runtime
-
-	// compile vertex shader
-	ID3DBlob* vertexShader; // d3d blob for holding vertex shader bytecode
-	ID3DBlob* errorBuff; // a buffer holding the error data if any
-	hr = D3DCompileFromFile(L"VertexShader.hlsl",
-		nullptr,
-		nullptr,
-		"main",
-		"vs_5_0",
-		D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION,
-		0,
-		&vertexShader,
-		&errorBuff);
-	if (FAILED(hr))
-	{
-		OutputDebugStringA((char*)errorBuff->GetBufferPointer());
-		return false;
-	}
-
-	// fill out a shader bytecode structure, which is basically just a pointer
-	// to the shader bytecode and the size of the shader bytecode
-	D3D12_SHADER_BYTECODE vertexShaderBytecode = {};
-	vertexShaderBytecode.BytecodeLength = vertexShader->GetBufferSize();
-	vertexShaderBytecode.pShaderBytecode = vertexShader->GetBufferPointer();
-
-	// compile pixel shader
-	ID3DBlob* pixelShader;
-	hr = D3DCompileFromFile(L"PixelShader.hlsl",
-		nullptr,
-		nullptr,
-		"main",
-		"ps_5_0",
-		D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION,
-		0,
-		&pixelShader,
-		&errorBuff);
-	if (FAILED(hr))
-	{
-		OutputDebugStringA((char*)errorBuff->GetBufferPointer());
-		return false;
-	}
-
-	// fill out shader bytecode structure for pixel shader
-	D3D12_SHADER_BYTECODE pixelShaderBytecode = {};
-	pixelShaderBytecode.BytecodeLength = pixelShader->GetBufferSize();
-	pixelShaderBytecode.pShaderBytecode = pixelShader->GetBufferPointer();
-
-	// create input layout
-
-	// The input layout is used by the Input Assembler so that it knows
-	// how to read the vertex data bound to it.
-
-	D3D12_INPUT_ELEMENT_DESC inputLayout[] =
-	{
-		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-		{ "COLOR", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
-	};
-
-	// fill out an input layout description structure
-	D3D12_INPUT_LAYOUT_DESC inputLayoutDesc = {};
-
-	// we can get the number of elements in an array by "sizeof(array) / sizeof(arrayElementType)"
-	inputLayoutDesc.NumElements = sizeof(inputLayout) / sizeof(D3D12_INPUT_ELEMENT_DESC);
-	inputLayoutDesc.pInputElementDescs = inputLayout;
-
-	// create a pipeline state object (PSO)
-
-	// In a real application, you will have many pso's. for each different shader
-	// or different combinations of shaders, different blend states or different rasterizer states,
-	// different topology types (point, line, triangle, patch), or a different number
-	// of render targets you will need a pso
-
-	// VS is the only required shader for a pso. You might be wondering when a case would be where
-	// you only set the VS. It's possible that you have a pso that only outputs data with the stream
-	// output, and not on a render target, which means you would not need anything after the stream
-	// output.
-
-	D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc = {}; // a structure to define a pso
-	psoDesc.InputLayout = inputLayoutDesc; // the structure describing our input layout
-	psoDesc.pRootSignature = m_pRootSignature; // the root signature that describes the input data this pso needs
-	psoDesc.VS = vertexShaderBytecode; // structure describing where to find the vertex shader bytecode and how large it is
-	psoDesc.PS = pixelShaderBytecode; // same as VS but for pixel shader
-	psoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE; // type of topology we are drawing
-	psoDesc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM; // format of the render target
-	psoDesc.SampleDesc = sampleDesc; // must be the same sample description as the swapchain and depth/stencil buffer
-	psoDesc.SampleMask = 0xffffffff; // sample mask has to do with multi-sampling. 0xffffffff means point sampling is done
-	psoDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT); // a default rasterizer state.
-	psoDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT); // a default blent state.
-	psoDesc.NumRenderTargets = 1; // we are only binding one render target
-	psoDesc.DepthStencilState = CD3DX12_DEPTH_STENCIL_DESC(D3D12_DEFAULT); // a default depth stencil state
-
-	// create the pso
-	hr = m_pDevice->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&m_pPipelineStateObject));
-	if (FAILED(hr))
-	{
-		return false;
-	}
-
-	// Create vertex buffer
-
-	// a quad
-	Vertex vList[] = {
-		// front face
-	Vertex({ -0.5f,  0.5f, -0.5f}, {1.0f, 0.0f, 0.0f, 1.0f }),
-	Vertex({  0.5f, -0.5f, -0.5f}, { 1.0f, 0.0f, 1.0f, 1.0f }),
-	Vertex({ -0.5f, -0.5f, -0.5f}, { 0.0f, 0.0f, 1.0f, 1.0f }),
-	Vertex({  0.5f,  0.5f, -0.5f}, { 0.0f, 1.0f, 0.0f, 1.0f }),
-
-	// right side face
-	Vertex({  0.5f, -0.5f, -0.5f}, { 1.0f, 0.0f, 0.0f, 1.0f }),
-	Vertex({  0.5f,  0.5f,  0.5f}, { 1.0f, 0.0f, 1.0f, 1.0f }),
-	Vertex({  0.5f, -0.5f,  0.5f}, { 0.0f, 0.0f, 1.0f, 1.0f }),
-	Vertex({  0.5f,  0.5f, -0.5f}, { 0.0f, 1.0f, 0.0f, 1.0f }),
-
-	// left side face
-	Vertex({ -0.5f,  0.5f,  0.5f}, { 1.0f, 0.0f, 0.0f, 1.0f }),
-	Vertex({ -0.5f, -0.5f, -0.5f}, { 1.0f, 0.0f, 1.0f, 1.0f }),
-	Vertex({ -0.5f, -0.5f,  0.5f}, { 0.0f, 0.0f, 1.0f, 1.0f }),
-	Vertex({ -0.5f,  0.5f, -0.5f}, { 0.0f, 1.0f, 0.0f, 1.0f }),
-
-	// back face
-	Vertex({  0.5f,  0.5f,  0.5f}, { 1.0f, 0.0f, 0.0f, 1.0f }),
-	Vertex({ -0.5f, -0.5f,  0.5f}, { 1.0f, 0.0f, 1.0f, 1.0f }),
-	Vertex({  0.5f, -0.5f,  0.5f}, { 0.0f, 0.0f, 1.0f, 1.0f }),
-	Vertex({ -0.5f,  0.5f,  0.5f}, { 0.0f, 1.0f, 0.0f, 1.0f }),
-
-	// top face
-	Vertex({ -0.5f,  0.5f, -0.5f}, { 1.0f, 0.0f, 0.0f, 1.0f }),
-	Vertex({ 0.5f,  0.5f,  0.5f}, { 1.0f, 0.0f, 1.0f, 1.0f }),
-	Vertex({ 0.5f,  0.5f, -0.5f}, { 0.0f, 0.0f, 1.0f, 1.0f }),
-	Vertex({ -0.5f,  0.5f,  0.5f}, { 0.0f, 1.0f, 0.0f, 1.0f }),
-
-	// bottom face
-	Vertex({  0.5f, -0.5f,  0.5f}, { 1.0f, 0.0f, 0.0f, 1.0f }),
-	Vertex({ -0.5f, -0.5f, -0.5f}, { 1.0f, 0.0f, 1.0f, 1.0f }),
-	Vertex({  0.5f, -0.5f, -0.5f}, { 0.0f, 0.0f, 1.0f, 1.0f }),
-	Vertex({ -0.5f, -0.5f,  0.5f}, {0.0f, 1.0f, 0.0f, 1.0f })
-	};
-
-	int vBufferSize = sizeof(vList);
-
-	// create default heap
-	// default heap is memory on the GPU. Only the GPU has access to this memory
-	// To get data into this heap, we will have to upload the data using
-	// an upload heap
-	m_pDevice->CreateCommittedResource(
-		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT), // a default heap
-		D3D12_HEAP_FLAG_NONE, // no flags
-		&CD3DX12_RESOURCE_DESC::Buffer(vBufferSize), // resource description for a buffer
-		D3D12_RESOURCE_STATE_COPY_DEST, // we will start this heap in the copy destination state since we will copy data
-										// from the upload heap to this heap
-		nullptr, // optimized clear value must be null for this type of resource. used for render targets and depth/stencil buffers
-		IID_PPV_ARGS(&m_pVertexBuffer));
-
-	// we can give resource heaps a name so when we debug with the graphics debugger we know what resource we are looking at
-	m_pVertexBuffer->SetName(L"Vertex Buffer Resource Heap");
-
-	// create upload heap
-	// upload heaps are used to upload data to the GPU. CPU can write to it, GPU can read from it
-	// We will upload the vertex buffer using this heap to the default heap
-	ID3D12Resource* vBufferUploadHeap;
-	m_pDevice->CreateCommittedResource(
-		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD), // upload heap
-		D3D12_HEAP_FLAG_NONE, // no flags
-		&CD3DX12_RESOURCE_DESC::Buffer(vBufferSize), // resource description for a buffer
-		D3D12_RESOURCE_STATE_GENERIC_READ, // GPU will read from this buffer and copy its contents to the default heap
-		nullptr,
-		IID_PPV_ARGS(&vBufferUploadHeap));
-	vBufferUploadHeap->SetName(L"Vertex Buffer Upload Resource Heap");
-
-	// store vertex buffer in upload heap
-	D3D12_SUBRESOURCE_DATA vertexData = {};
-	vertexData.pData = reinterpret_cast<BYTE*>(vList); // pointer to our vertex array
-	vertexData.RowPitch = vBufferSize; // size of all our triangle vertex data
-	vertexData.SlicePitch = vBufferSize; // also the size of our triangle vertex data
-
-	// we are now creating a command with the command list to copy the data from
-	// the upload heap to the default heap
-	UpdateSubresources(m_pCommandList, m_pVertexBuffer, vBufferUploadHeap, 0, 0, 1, &vertexData);
-
-	// transition the vertex buffer data from copy destination state to vertex buffer state
-	m_pCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_pVertexBuffer, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER));
-
-	// Create index buffer
-
-	// a quad (2 triangles)
-	DWORD iList[] = {
-		// ffront face
-		0, 1, 2, // first triangle
-		0, 3, 1, // second triangle
-
-		// left face
-		4, 5, 6, // first triangle
-		4, 7, 5, // second triangle
-
-		// right face
-		8, 9, 10, // first triangle
-		8, 11, 9, // second triangle
-
-		// back face
-		12, 13, 14, // first triangle
-		12, 15, 13, // second triangle
-
-		// top face
-		16, 17, 18, // first triangle
-		16, 19, 17, // second triangle
-
-		// bottom face
-		20, 21, 22, // first triangle
-		20, 23, 21, // second triangle
-	};
-
-	int iBufferSize = sizeof(iList);
-
-	m_numCubeIndices = sizeof(iList) / sizeof(DWORD);
-
-	// create default heap to hold index buffer
-	m_pDevice->CreateCommittedResource(
-		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT), // a default heap
-		D3D12_HEAP_FLAG_NONE, // no flags
-		&CD3DX12_RESOURCE_DESC::Buffer(iBufferSize), // resource description for a buffer
-		D3D12_RESOURCE_STATE_COPY_DEST, // start in the copy destination state
-		nullptr, // optimized clear value must be null for this type of resource
-		IID_PPV_ARGS(&m_pIndexBuffer));
-
-	// we can give resource heaps a name so when we debug with the graphics debugger we know what resource we are looking at
-	m_pVertexBuffer->SetName(L"Index Buffer Resource Heap");
-
-	// create upload heap to upload index buffer
-	ID3D12Resource* iBufferUploadHeap;
-	m_pDevice->CreateCommittedResource(
-		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD), // upload heap
-		D3D12_HEAP_FLAG_NONE, // no flags
-		&CD3DX12_RESOURCE_DESC::Buffer(vBufferSize), // resource description for a buffer
-		D3D12_RESOURCE_STATE_GENERIC_READ, // GPU will read from this buffer and copy its contents to the default heap
-		nullptr,
-		IID_PPV_ARGS(&iBufferUploadHeap));
-	vBufferUploadHeap->SetName(L"Index Buffer Upload Resource Heap");
-
-	// store vertex buffer in upload heap
-	D3D12_SUBRESOURCE_DATA indexData = {};
-	indexData.pData = reinterpret_cast<BYTE*>(iList); // pointer to our index array
-	indexData.RowPitch = iBufferSize; // size of all our index buffer
-	indexData.SlicePitch = iBufferSize; // also the size of our index buffer
-
-	// we are now creating a command with the command list to copy the data from
-	// the upload heap to the default heap
-	UpdateSubresources(m_pCommandList, m_pIndexBuffer, iBufferUploadHeap, 0, 0, 1, &indexData);
-
-	// transition the vertex buffer data from copy destination state to vertex buffer state
-	m_pCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_pIndexBuffer, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER));
-
-	// Create the depth/stencil buffer
-
-	// create a depth stencil descriptor heap so we can get a pointer to the depth stencil buffer
-	D3D12_DESCRIPTOR_HEAP_DESC dsvHeapDesc = {};
-	dsvHeapDesc.NumDescriptors = 1;
-	dsvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_DSV;
-	dsvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
-	hr = m_pDevice->CreateDescriptorHeap(&dsvHeapDesc, IID_PPV_ARGS(&m_pDSDescriptorHeap));
-	if (FAILED(hr))
-	{
-		return false;
-	}
-
-	D3D12_DEPTH_STENCIL_VIEW_DESC depthStencilDesc = {};
-	depthStencilDesc.Format = DXGI_FORMAT_D32_FLOAT;
-	depthStencilDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2D;
-	depthStencilDesc.Flags = D3D12_DSV_FLAG_NONE;
-
-	D3D12_CLEAR_VALUE depthOptimizedClearValue = {};
-	depthOptimizedClearValue.Format = DXGI_FORMAT_D32_FLOAT;
-	depthOptimizedClearValue.DepthStencil.Depth = 1.0f;
-	depthOptimizedClearValue.DepthStencil.Stencil = 0;
-
-	m_pDevice->CreateCommittedResource(
-		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-		D3D12_HEAP_FLAG_NONE,
-		&CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_D32_FLOAT, _width, _height, 1, 0, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL),
-		D3D12_RESOURCE_STATE_DEPTH_WRITE,
-		&depthOptimizedClearValue,
-		IID_PPV_ARGS(&m_pDepthStencilBuffer)
-	);
-	m_pDSDescriptorHeap->SetName(L"Depth/Stencil Resource Heap");
-
-	m_pDevice->CreateDepthStencilView(m_pDepthStencilBuffer, &depthStencilDesc, m_pDSDescriptorHeap->GetCPUDescriptorHandleForHeapStart());
-
-	// create the constant buffer resource heap
-	// We will update the constant buffer one or more times per frame, so we will use only an upload heap
-	// unlike previously we used an upload heap to upload the vertex and index data, and then copied over
-	// to a default heap. If you plan to use a resource for more than a couple frames, it is usually more
-	// efficient to copy to a default heap where it stays on the gpu. In this case, our constant buffer
-	// will be modified and uploaded at least once per frame, so we only use an upload heap
-
-	// first we will create a resource heap (upload heap) for each frame for the cubes constant buffers
-	// As you can see, we are allocating 64KB for each resource we create. Buffer resource heaps must be
-	// an alignment of 64KB. We are creating 3 resources, one for each frame. Each constant buffer is 
-	// only a 4x4 matrix of floats in this tutorial. So with a float being 4 bytes, we have 
-	// 16 floats in one constant buffer, and we will store 2 constant buffers in each
-	// heap, one for each cube, thats only 64x2 bits, or 128 bits we are using for each
-	// resource, and each resource must be at least 64KB (65536 bits)
-	for (int i = 0; i < m_frameBufferCount; ++i)
-	{
-		// create resource for cube 1
-		hr = m_pDevice->CreateCommittedResource(
-			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD), // this heap will be used to upload the constant buffer data
-			D3D12_HEAP_FLAG_NONE, // no flags
-			&CD3DX12_RESOURCE_DESC::Buffer(1024 * 64), // size of the resource heap. Must be a multiple of 64KB for single-textures and constant buffers
-			D3D12_RESOURCE_STATE_GENERIC_READ, // will be data that is read from so we keep it in the generic read state
-			nullptr, // we do not have use an optimized clear value for constant buffers
-			IID_PPV_ARGS(&m_pConstantBufferUploadHeaps[i]));
-		m_pConstantBufferUploadHeaps[i]->SetName(L"Constant Buffer Upload Resource Heap");
-
-		ZeroMemory(&m_cbPerObject, sizeof(m_cbPerObject));
-
-		CD3DX12_RANGE readRange(0, 0);	// We do not intend to read from this resource on the CPU. (so end is less than or equal to begin)
-
-		// map the resource heap to get a gpu virtual address to the beginning of the heap
-		hr = m_pConstantBufferUploadHeaps[i]->Map(0, &readRange, reinterpret_cast<void**>(&m_pCBVGPUAddress[i]));
-
-		// Because of the constant read alignment requirements, constant buffer views must be 256 bit aligned. Our buffers are smaller than 256 bits,
-		// so we need to add spacing between the two buffers, so that the second buffer starts at 256 bits from the beginning of the resource heap.
-		memcpy(m_pCBVGPUAddress[i], &m_cbPerObject, sizeof(m_cbPerObject)); // cube1's constant buffer data
-		memcpy(m_pCBVGPUAddress[i] + m_ConstantBufferPerObjectAlignedSize, &m_cbPerObject, sizeof(m_cbPerObject)); // cube2's constant buffer data
-	}
-
-	// Now we execute the command list to upload the initial assets (triangle data)
-	m_pCommandList->Close();
-	ID3D12CommandList* ppCommandLists[] = { m_pCommandList };
-	m_pCommandQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
-
-	// increment the fence value now, otherwise the buffer might not be uploaded by the time we start drawing
-	m_fenceValue[m_frameIndex]++;
-	hr = m_pCommandQueue->Signal(m_pFence[m_frameIndex], m_fenceValue[m_frameIndex]);
-	if (FAILED(hr))
-	{
-		return false;
-	}
-
-	// create a vertex buffer view for the triangle. We get the GPU memory address to the vertex pointer using the GetGPUVirtualAddress() method
-	m_vertexBufferView.BufferLocation = m_pVertexBuffer->GetGPUVirtualAddress();
-	m_vertexBufferView.StrideInBytes = sizeof(Vertex);
-	m_vertexBufferView.SizeInBytes = vBufferSize;
-
-	// create a vertex buffer view for the triangle. We get the GPU memory address to the vertex pointer using the GetGPUVirtualAddress() method
-	m_indexBufferView.BufferLocation = m_pIndexBuffer->GetGPUVirtualAddress();
-	m_indexBufferView.Format = DXGI_FORMAT_R32_UINT; // 32-bit unsigned integer (this is what a dword is, double word, a word is 2 bytes)
-	m_indexBufferView.SizeInBytes = iBufferSize;
-
-	// Fill out the Viewport
-	m_viewport.TopLeftX = 0;
-	m_viewport.TopLeftY = 0;
-	m_viewport.Width = _width;
-	m_viewport.Height = _height;
-	m_viewport.MinDepth = 0.0f;
-	m_viewport.MaxDepth = 1.0f;
-
-	// Fill out a scissor rect
-	m_scissorRect.left = 0;
-	m_scissorRect.top = 0;
-	m_scissorRect.right = _width;
-	m_scissorRect.bottom = _height;
-
-	// build projection and view matrix
-	XMMATRIX tmpMat = XMMatrixPerspectiveFovLH(45.0f * (3.14f / 180.0f), (float)_width / (float)_height, 0.1f, 1000.0f);
-	XMStoreFloat4x4(&m_cameraProjMat, tmpMat);
-
-	// set starting camera state
-	m_cameraPosition = XMFLOAT4(0.0f, 2.0f, -4.0f, 0.0f);
-	m_cameraTarget = XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
-	m_cameraUp = XMFLOAT4(0.0f, 1.0f, 0.0f, 0.0f);
-
-	// build view matrix
-	XMVECTOR cPos = XMLoadFloat4(&m_cameraPosition);
-	XMVECTOR cTarg = XMLoadFloat4(&m_cameraTarget);
-	XMVECTOR cUp = XMLoadFloat4(&m_cameraUp);
-	tmpMat = XMMatrixLookAtLH(cPos, cTarg, cUp);
-	XMStoreFloat4x4(&m_cameraViewMat, tmpMat);
-
-	// set starting cubes position
-	// first cube
-	m_cube1Position = XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f); // set cube 1's position
-	XMVECTOR posVec = XMLoadFloat4(&m_cube1Position); // create xmvector for cube1's position
-
-	tmpMat = XMMatrixTranslationFromVector(posVec); // create translation matrix from cube1's position vector
-	XMStoreFloat4x4(&m_cube1RotMat, XMMatrixIdentity()); // initialize cube1's rotation matrix to identity matrix
-	XMStoreFloat4x4(&m_cube1WorldMat, tmpMat); // store cube1's world matrix
-
-	// second cube
-	m_cube2PositionOffset = XMFLOAT4(1.5f, 0.0f, 0.0f, 0.0f);
-	posVec = XMLoadFloat4(&m_cube2PositionOffset) + XMLoadFloat4(&m_cube1Position); // create xmvector for cube2's position
-																				// we are rotating around cube1 here, so add cube2's position to cube1
-
-	tmpMat = XMMatrixTranslationFromVector(posVec); // create translation matrix from cube2's position offset vector
-	XMStoreFloat4x4(&m_cube2RotMat, XMMatrixIdentity()); // initialize cube2's rotation matrix to identity matrix
-	XMStoreFloat4x4(&m_cube2WorldMat, tmpMat); // store cube2's world matrix
+	// the probes light whatever moves with the light bouncing off the cubes. they take a moment, so they are baked on
+	// the job system while the first frames use the flat ambient
+	StartIrradianceVolumeBake();
 	return true;
 }
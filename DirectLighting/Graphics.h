@@ -21,29 +21,53 @@
 #pragma comment(lib, "d3dcompiler")
 
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
 #include "D3dx12.h"
 #include "LWindow.h"
 
+#include "BakedLighting.h"
+#include "CascadedShadows.h"
+#include "ClusteredLighting.h"
+#include "CommandRecorder.h"
+#include "DrawQueue.h"
+#include "FrameGraph.h"
+#include "Culling.h"
+#include "DepthPyramid.h"
 #include "GraphicsData.h"
+#include "IndirectDraw.h"
+#include "IrradianceVolume.h"
+#include "JobSystem.h"
+#include "LightmapBaker.h"
+#include "LightBvh.h"
+#include "LightClusters.h"
+#include "MeshFile.h"
+#include "MeshletCulling.h"
+#include "PathTracer.h"
+#include "RootSignature.h"
+#include "ShaderHotReload.h"
+#include "ShadowMapPass.h"
+#include "TransientResourcePool.h"
 
 
 //using namespace GData;
 using namespace DirectX;
 using namespace Microsoft::WRL;
-struct Vertex
-{
-	Vertex(XMFLOAT3 _pos, XMFLOAT4 _col)
-	{
-		col = _col;
-		pos = _pos;
-	}
-	XMFLOAT3 pos;
-	XMFLOAT4 col;
-};
-// this is the structure of our constant buffer.
+// the vertices we draw are PackedVertex (VertexCompression.h), as MeshFile::Convert writes them
+// this is the structure of our per object constants. it is passed as root constants,
+// so keep it small (the whole root signature is limited to 64 DWORDs)
 struct ConstantBufferPerObject 
 {
 	XMFLOAT4X4 wvpMat;
+	XMFLOAT4 normalMat[3]; // the first three rows of the inverse world matrix, which take the normals to world space
 };
 class Graphics
 {
@@ -54,11 +78,27 @@ public:
 	bool OnInit(LWindow& _window);
 
 	void Update();
-	void UpdatePipeline();
+	bool UpdatePipeline(); // false if the frame could not be recorded, it must not be executed
 	void Render();
 	void WaitForPreviousFrame();
 	void CleanUp();
 
+	// path traces the scene as it is right now on the cpu and saves it as a float map, as the ground truth for the
+	// real time lighting. _maxBounces 0 only gives the direct light
+	bool RenderReference(const std::string& _fileName, uint32_t _passes, uint32_t _maxBounces = 0);
+
+	// bakes the direct light on the scene as it is right now into a lightmap file and lights with it from the next
+	// frame on. only the charts whose lights changed since the last bake are baked again, unless the geometry moved
+	bool BakeLightmap(const std::string& _fileName);
+
+	// bakes the probes that light dynamic objects with the light bouncing off the scene as it is right now, and lights
+	// with them from the next frame on. it blocks until they are done, which suits a tool or a bake asked for by hand
+	void BakeIrradianceVolume();
+
+	// the same bake as a job on the job system, so the frames go on with the flat ambient meanwhile and the probes are
+	// used from the first frame after it finishes. InitScene starts one
+	void StartIrradianceVolumeBake();
+
 	//Gets
 	ID3D12Device* Device(){return m_pDevice;}
 	IDXGISwapChain3* SwapChain(){return m_pSwapChain;}
@@ -71,6 +111,7 @@ public:
 	HANDLE FenceEvent(){return m_fenceEvent;}
 	int FrameIndex(){return m_frameIndex;}
 	UINT64* FenceValue(){return m_fenceValue;}
+	const CommandStats& LastFrameCommandStats(){return m_commandStats;}
 private:
 
 	//Pipeline 
@@ -87,15 +128,28 @@ private:
 	bool CompileMyShaders();
 	bool CreateInputLayout();
 	bool CreatePSO(PSOData& _psoData);
+	ID3D12PipelineState* BuildPipelineState(ID3DBlob* _pVertexShader, ID3DBlob* _pPixelShader);
+	void SwapReloadedPipelineState();
+	void ShowFrameStats(); // the frame rate and what the last frame did, in the window title
+	void BuildDrawQueue();
+	uint32_t SelectLod(const XMFLOAT4X4& _world, const XMFLOAT4& _sphere); // the coarsest lod of m_mesh that looks the same from the camera
+	void CreateLights(); // a fixed set of point and spot lights around the cubes
+	void FillCpuScene(PathTracer& _scene); // the cubes, lights and sun for the cpu ray tracers
+	void PrepareIrradianceVolumeBake(); // waits for a bake that is still running, then sets up the volume and its scene
+	bool BuildFrameGraph(); // false if the graph does not compile
+	void RecordScenePass();
+	ID3D12Resource* FrameGraphResource(uint32_t _resource);
+	ID3D12CommandSignature* CommandSignature(ID3D12RootSignature* _pRootSignature, UINT _rootConstantsParameter); // made the first time it is asked for
+	bool CreateIndirectDrawResources();
+	bool CreateDepthReadback();
+	void ReadBackDepth(); // builds the depth pyramid from the frame the gpu has just finished
+	bool LoadMesh();
 	bool CreateVertexBuffer();
 	bool CreateIndexBuffer(int _vBufferSize, ID3D12Resource* _pVBufferUploadHeap);
   bool CreateDepthBuffer(LWindow& _window);
 
-	bool CreatePerObjectConstantBuffer();
-
 	bool InitScene(int _width, int _height);
 
-	bool Test(int _width, int _height, HWND _hwnd);
 	//-------
 
 	//For Setting Up The Pipeline
@@ -117,6 +171,35 @@ private:
 
 	ID3D12GraphicsCommandList* m_pCommandList = nullptr; // a command list we can record commands into, then execute them to render the frame
 
+	GraphicsCommandRecorder m_commandRecorder; // filters redundant state changes and batches barriers on the way into the command list
+	CommandStats m_commandStats; // what the recorder did for the last frame
+
+	HWND m_hwnd = NULL;
+	std::string m_windowTitle; // as the window was created, the frame stats go after it
+	std::chrono::steady_clock::time_point m_statsTime; // when the title last changed
+	UINT m_statsFrames = 0; // frames since then
+
+	DrawQueue m_drawQueue; // this frame's draws, sorted by pass, pso, material and depth
+
+	FrameGraph m_frameGraph; // the frame's passes and what they read and write, rebuilt every frame
+	TransientResourcePool m_transientPool; // memory for the frame graph's transient resources
+	uint32_t m_frameGraphBackBuffer = FrameGraph::INVALID_HANDLE;
+	uint32_t m_frameGraphDepth = FrameGraph::INVALID_HANDLE;
+	uint32_t m_frameGraphShadowMap = FrameGraph::INVALID_HANDLE;
+	// the cascades' own command lists, put here by their passes as the graph runs and submitted ahead of the main list
+	ID3D12CommandList* m_pShadowCommandLists[MAX_SHADOW_CASCADES] = {};
+	UINT m_shadowCommandListCount = 0;
+
+	// the indirect path culls the draw queue and writes the visible draws into an argument buffer,
+	// then each run of draws with the same state is one ExecuteIndirect
+	static const UINT m_maxIndirectDraws = 16384;
+	bool m_useIndirectDraws = true; // false records every draw with DrawIndexedInstanced
+	std::map<std::pair<ID3D12RootSignature*, UINT>, ID3D12CommandSignature*> m_commandSignatures; // per root signature and constants slot, each sets the constants then draws indexed
+	ID3D12Resource* m_pIndirectArgumentBuffer[m_frameBufferCount]; // upload heap, one per frame so we never write one the gpu is reading
+	IndirectDrawRecord* m_pIndirectRecords[m_frameBufferCount]; // the argument buffers, mapped for the life of the app
+	Frustum m_cameraFrustum; // world space, rebuilt every frame
+	UINT m_visibleDraws = 0; // draws that survived culling last frame
+
 	ID3D12Fence* m_pFence[m_frameBufferCount];    // an object that is locked while our command list is being executed by the gpu. We need as many 
 																					 //as we have allocators (more if we want to know when the gpu is finished with an asset)
 
@@ -132,7 +215,28 @@ private:
 	PSOData m_psoData;
 	ID3D12PipelineState* m_pPipelineStateObject; // pso containing a pipeline state
 
+	std::string m_vertexShaderFile = "VertexShader.hlsl";
+	std::string m_pixelShaderFile = "PixelShader.hlsl";
+	std::string m_meshFile = "Cube.obj"; // any obj, gltf or glb in the working directory, converted to a .mesh beside it
+	std::string m_lightmapFile = "Scene.lmap"; // made with BakeLightmap or "-bake", loaded at startup when it is there
+
+	JobSystem m_jobSystem; // worker threads for anything that can be done off the render thread
+	ShaderHotReload m_shaderHotReload; // rebuilds the psos when the shader files change
+	UINT m_shadowPipeline = 0; // the shadow map pass's pso among the ones hot reload rebuilds
+
+	// psos replaced by a hot reload. the gpu may still be using them, so they are released once
+	// every frame buffer has been through the pipeline since the swap
+	struct RetiredPSO
+	{
+		ID3D12PipelineState* pPSO;
+		UINT64 releaseFrame;
+	};
+	std::vector<RetiredPSO> m_retiredPSOs;
+	UINT64 m_frameCount = 0; // number of frames recorded so far
+
 	ID3D12RootSignature* m_pRootSignature; // root signature defines data shaders will access
+	RootSignatureCache m_rootSignatureCache; // owns every root signature we create
+	UINT m_rootParamPerObject = 0; // root slot of the per object constants
 
 	D3D12_VIEWPORT m_viewport; // area that output from rasterizer will be stretched to.
 
@@ -146,17 +250,30 @@ private:
 	ID3D12Resource* m_pIndexBuffer;
 	D3D12_INDEX_BUFFER_VIEW m_indexBufferView; 
 
-	ID3D12Resource* m_pDepthStencilBuffer; // This is the memory for our depth buffer. it will also be used for a stencil buffer in a later tutorial
+	ID3D12Resource* m_pDepthStencilBuffer = nullptr; // the depth buffer the dsv points at. owned by the transient pool
+	TransientDesc m_depthDesc; // what the frame graph asks the pool for
 	ID3D12DescriptorHeap* m_pDSDescriptorHeap; // This is a heap for our depth/stencil buffer descriptor
 	
-	int m_ConstantBufferPerObjectAlignedSize = (sizeof(ConstantBufferPerObject) + 255) & ~255;
-
-	ConstantBufferPerObject m_cbPerObject; // this is the constant buffer data we will send to the gpu 
-																					// (which will be placed in the resource we created above)
-
-	ID3D12Resource* m_pConstantBufferUploadHeaps[m_frameBufferCount]; // this is the memory on the gpu where constant buffers for each frame will be placed
-
-	UINT8* m_pCBVGPUAddress[m_frameBufferCount]; // this is a pointer to each of the constant buffer resource heaps
+	ConstantBufferPerObject m_cube1Constants; // per object data we send to the gpu as root constants
+	ConstantBufferPerObject m_cube2Constants;
+
+	std::vector<Light> m_lights; // every light in the scene, world space
+	static const UINT m_sceneLightCount = 256; // how many CreateLights scatters around the cubes
+	LightClusters m_lightClusters; // which lights touch which part of the view frustum, rebuilt every frame
+	ClusteredLighting m_clusteredLighting; // the lights and clusters in upload buffers, for the scene's pixel shader
+	static const UINT m_maxClusteredLights = 16384;
+	static const UINT m_maxClusteredLightIndices = 1 << 20; // 4MB a frame
+	XMFLOAT3 m_ambientLight = XMFLOAT3(0.15f, 0.15f, 0.18f); // what a surface no light reaches still gets
+	LightBvh m_lightBvh; // for picking lights by importance when there are too many to loop over, the scene's pixel shader falls back to it when the clusters overflow
+
+	ShadowCascadeDesc m_shadowDesc; // cascade count and resolution, the rest of the shadows are set up from it
+	CascadedShadows m_cascadedShadows; // cascade matrices and the casters each one draws, rebuilt every frame
+	ShadowMapPass m_shadowMapPass; // records the cascades in parallel on lists of their own, the frame graph submits them
+	static const UINT m_shadowMapView = 0; // the shadow map's place among the baked lighting's shared views
+	std::vector<ShadowCaster> m_shadowCasters; // everything that casts shadows this frame
+	std::vector<XMFLOAT4> m_shadowCasterSpheres; // and their world space bounds, in the same order
+	XMFLOAT3 m_sunDirection; // the way the sun's light travels
+	XMFLOAT3 m_sunColor = XMFLOAT3(1.0f, 1.0f, 1.0f); // irradiance from the sun on a surface facing it
 
 	XMFLOAT4X4 m_cameraProjMat; // this will store our projection matrix
 	XMFLOAT4X4 m_cameraViewMat; // this will store our view matrix
@@ -174,5 +291,32 @@ private:
 	XMFLOAT4 m_cube2PositionOffset; // our second cube will rotate around the first cube, so this is the position offset from the first cube
 
 	int m_numCubeIndices; // the number of indices to draw the cube
+	MeshFile m_mesh; // mapped for as long as we run, so the cpu scene reads the same vertices the gpu was given
+	XMFLOAT4X4 m_meshDecodeMat; // takes the mesh's quantised positions back to object space, ahead of the world matrix
+	MeshletCuller m_meshletCuller; // over m_mesh's meshlets, run once per cube
+	bool m_useMeshletCulling = true; // false draws each cube whole
+	bool m_useOcclusionCulling = true; // false skips the depth pyramid test on the meshlets
+	UINT m_occludedMeshlets = 0; // meshlets the depth pyramid hid last frame
+
+	// every frame's depth is copied into a readback buffer of its own, and read once that frame's fence comes back, so
+	// the pyramid is always from the last frame the gpu finished, drawn with the matrix kept beside it
+	ID3D12Resource* m_pDepthReadback[m_frameBufferCount] = {};
+	D3D12_PLACED_SUBRESOURCE_FOOTPRINT m_depthReadbackFootprint = {};
+	XMFLOAT4X4 m_depthReadbackViewProj[m_frameBufferCount]; // the matrix each buffer's depth was drawn with
+	bool m_depthReadbackRecorded[m_frameBufferCount] = {}; // false until a frame has copied into it
+	std::vector<float> m_readbackDepth; // the depth rows without their pitch, for the pyramid
+	DepthPyramid m_depthPyramid;
+	XMFLOAT4X4 m_depthPyramidViewProj; // the matrix m_depthPyramid was drawn with
+	float m_lodPixelError = 1.0f; // how many pixels a lod may stray on screen
+	UINT m_lodTrianglesSaved = 0; // triangles the chosen lods left out last frame
+
+	PathTracer m_bakeScene; // the scene the lightmap was last baked from
+	LightmapBaker m_lightmapBaker;
+	std::vector<XMFLOAT3> m_bakedPositions; // the geometry the charts were built for
+	IrradianceVolume m_irradianceVolume; // probes around the cubes, for anything that moves
+	PathTracer m_volumeBakeScene; // the scene the probes are baked from, apart from m_bakeScene so a lightmap bake can run alongside
+	bool m_volumeBakeRunning = false; // a StartIrradianceVolumeBake job owns the volume and its scene
+	std::atomic<bool> m_volumeBakeDone{ false }; // set by the job, UpdatePipeline hands the probes over when it sees it
+	BakedLighting m_bakedLighting; // the lightmap and the irradiance volume on the gpu, for the scene's pixel shader
 };
 
@@ -0,0 +1,693 @@
+#include "ImageImporter.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include "MappedFile.h"
+
+namespace
+{
+	//==============================================================================================================
+	// inflate
+	//==============================================================================================================
+
+	// bits come out of a deflate stream least significant first. the reader keeps up to 64 of them in a register and
+	// refills a byte at a time, reading zeros past the end so a truncated stream only fails at the end, in Overrun
+	class BitReader
+	{
+	public:
+		BitReader(const uint8_t* _pData, size_t _size) : m_pData(_pData), m_size(_size) {}
+
+		void Refill()
+		{
+			while (m_count <= 56)
+			{
+				uint64_t byte = m_pos < m_size ? m_pData[m_pos] : 0;
+				m_bits |= byte << m_count;
+				m_pos++;
+				m_count += 8;
+			}
+		}
+
+		uint32_t Peek(uint32_t _count) { return static_cast<uint32_t>(m_bits & ((1ull << _count) - 1)); }
+		void Consume(uint32_t _count) { m_bits >>= _count; m_count -= _count; }
+
+		uint32_t Read(uint32_t _count)
+		{
+			if (_count == 0)
+				return 0;
+			Refill();
+			uint32_t value = Peek(_count);
+			Consume(_count);
+			return value;
+		}
+
+		void AlignToByte() { Consume(m_count & 7); }
+
+		// the bytes taken from the stream so far, whole bytes only after AlignToByte
+		size_t BytesConsumed() { return m_pos - m_count / 8; }
+		bool Overrun() { return m_pos * 8 - m_count > m_size * 8; }
+
+	private:
+		const uint8_t* m_pData;
+		size_t m_size;
+		size_t m_pos = 0;
+		uint64_t m_bits = 0;
+		uint32_t m_count = 0;
+	};
+
+	const uint32_t MAX_CODE_LENGTH = 15;
+	const uint32_t FAST_BITS = 10;
+
+	// a canonical huffman code. codes up to FAST_BITS long are found with one lookup of the next FAST_BITS bits, the
+	// rare longer ones are walked bit by bit through the counts of each length
+	struct Huffman
+	{
+		uint16_t fast[1 << FAST_BITS]; // symbol << 4 | length, 0 for codes longer than FAST_BITS
+		uint16_t counts[MAX_CODE_LENGTH + 1];
+		uint16_t symbols[288]; // by length and then by symbol
+
+		// false if the lengths describe more codes than fit. fewer is allowed, deflate uses it for a single distance
+		bool Build(const uint8_t* _pLengths, uint32_t _count)
+		{
+			memset(counts, 0, sizeof(counts));
+			for (uint32_t symbol = 0; symbol < _count; ++symbol)
+				counts[_pLengths[symbol]]++;
+			counts[0] = 0;
+
+			int left = 1;
+			for (uint32_t length = 1; length <= MAX_CODE_LENGTH; ++length)
+			{
+				left = (left << 1) - counts[length];
+				if (left < 0)
+					return false;
+			}
+
+			uint16_t offsets[MAX_CODE_LENGTH + 2];
+			uint32_t nextCode[MAX_CODE_LENGTH + 2];
+			offsets[1] = 0;
+			nextCode[1] = 0;
+			for (uint32_t length = 1; length <= MAX_CODE_LENGTH; ++length)
+			{
+				offsets[length + 1] = offsets[length] + counts[length];
+				nextCode[length + 1] = (nextCode[length] + counts[length]) << 1;
+			}
+
+			memset(fast, 0, sizeof(fast));
+			for (uint32_t symbol = 0; symbol < _count; ++symbol)
+			{
+				uint32_t length = _pLengths[symbol];
+				if (length == 0)
+					continue;
+				symbols[offsets[length]++] = static_cast<uint16_t>(symbol);
+				uint32_t code = nextCode[length]++;
+				if (length > FAST_BITS)
+					continue;
+
+				// the code is sent most significant bit first, so it sits reversed in the bit reader
+				uint32_t reversed = 0;
+				for (uint32_t bit = 0; bit < length; ++bit)
+					reversed |= ((code >> bit) & 1) << (length - 1 - bit);
+				for (uint32_t entry = reversed; entry < (1u << FAST_BITS); entry += 1u << length)
+					fast[entry] = static_cast<uint16_t>(symbol << 4 | length);
+			}
+			return true;
+		}
+
+		// -1 for a code that is not in the table
+		int Decode(BitReader& _bits)
+		{
+			_bits.Refill();
+			uint32_t entry = fast[_bits.Peek(FAST_BITS)];
+			if (entry)
+			{
+				_bits.Consume(entry & 15);
+				return static_cast<int>(entry >> 4);
+			}
+
+			int code = 0;
+			int first = 0;
+			int index = 0;
+			for (uint32_t length = 1; length <= MAX_CODE_LENGTH; ++length)
+			{
+				code |= static_cast<int>(_bits.Read(1));
+				int count = counts[length];
+				if (code - first < count)
+					return symbols[index + code - first];
+				index += count;
+				first = (first + count) << 1;
+				code <<= 1;
+			}
+			return -1;
+		}
+	};
+
+	const uint16_t LENGTH_BASE[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115,
+		131, 163, 195, 227, 258 };
+	const uint8_t LENGTH_EXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	const uint16_t DISTANCE_BASE[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025,
+		1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+	const uint8_t DISTANCE_EXTRA[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12,
+		12, 13, 13 };
+	const uint8_t CODE_LENGTH_ORDER[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+	bool InflateBlock(BitReader& _bits, Huffman& _literals, Huffman& _distances, std::vector<uint8_t>& _out, size_t _start)
+	{
+		for (;;)
+		{
+			// past the end the reader makes up zeros, which can decode to literals for ever
+			int symbol = _literals.Decode(_bits);
+			if (symbol < 0 || _bits.Overrun())
+				return false;
+			if (symbol < 256)
+			{
+				_out.push_back(static_cast<uint8_t>(symbol));
+				continue;
+			}
+			if (symbol == 256)
+				return true;
+
+			symbol -= 257;
+			if (symbol >= 29)
+				return false;
+			uint32_t length = LENGTH_BASE[symbol] + _bits.Read(LENGTH_EXTRA[symbol]);
+			int distanceSymbol = _distances.Decode(_bits);
+			if (distanceSymbol < 0 || distanceSymbol >= 30)
+				return false;
+			size_t distance = DISTANCE_BASE[distanceSymbol] + _bits.Read(DISTANCE_EXTRA[distanceSymbol]);
+			if (distance > _out.size() - _start)
+				return false;
+
+			// the copy may overlap what it writes, a distance of 1 repeats one byte, so it goes a byte at a time
+			size_t at = _out.size();
+			_out.resize(at + length);
+			uint8_t* pCopy = _out.data() + at;
+			const uint8_t* pFrom = pCopy - distance;
+			for (uint32_t i = 0; i < length; ++i)
+				pCopy[i] = pFrom[i];
+		}
+	}
+
+	bool ReadDynamicTables(BitReader& _bits, Huffman& _literals, Huffman& _distances)
+	{
+		uint32_t literalCount = _bits.Read(5) + 257;
+		uint32_t distanceCount = _bits.Read(5) + 1;
+		uint32_t codeLengthCount = _bits.Read(4) + 4;
+		if (literalCount > 286 || distanceCount > 30)
+			return false;
+
+		uint8_t codeLengthLengths[19] = {};
+		for (uint32_t i = 0; i < codeLengthCount; ++i)
+			codeLengthLengths[CODE_LENGTH_ORDER[i]] = static_cast<uint8_t>(_bits.Read(3));
+		Huffman codeLengths;
+		if (!codeLengths.Build(codeLengthLengths, 19))
+			return false;
+
+		// both tables' lengths are one run, a repeat may cross from one into the other
+		uint8_t lengths[286 + 30] = {};
+		uint32_t total = literalCount + distanceCount;
+		for (uint32_t i = 0; i < total;)
+		{
+			int symbol = codeLengths.Decode(_bits);
+			if (symbol < 0)
+				return false;
+			if (symbol < 16)
+			{
+				lengths[i++] = static_cast<uint8_t>(symbol);
+				continue;
+			}
+
+			uint8_t value = 0;
+			uint32_t repeat;
+			if (symbol == 16)
+			{
+				if (i == 0)
+					return false;
+				value = lengths[i - 1];
+				repeat = 3 + _bits.Read(2);
+			}
+			else if (symbol == 17)
+				repeat = 3 + _bits.Read(3);
+			else
+				repeat = 11 + _bits.Read(7);
+			if (i + repeat > total)
+				return false;
+			memset(lengths + i, value, repeat);
+			i += repeat;
+		}
+		if (lengths[256] == 0)
+			return false;
+
+		return _literals.Build(lengths, literalCount) && _distances.Build(lengths + literalCount, distanceCount);
+	}
+
+	uint32_t Adler32(const uint8_t* _pData, size_t _size)
+	{
+		// 5552 bytes is the most that can be summed before the 32 bit sums have to be reduced
+		uint32_t a = 1;
+		uint32_t b = 0;
+		while (_size > 0)
+		{
+			size_t count = std::min<size_t>(_size, 5552);
+			for (size_t i = 0; i < count; ++i)
+			{
+				a += _pData[i];
+				b += a;
+			}
+			a %= 65521;
+			b %= 65521;
+			_pData += count;
+			_size -= count;
+		}
+		return b << 16 | a;
+	}
+
+	//==============================================================================================================
+	// png
+	//==============================================================================================================
+
+	const uint8_t PNG_SIGNATURE[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+
+	enum PngColorType
+	{
+		PNG_GREY = 0,
+		PNG_RGB = 2,
+		PNG_PALETTE = 3,
+		PNG_GREY_ALPHA = 4,
+		PNG_RGBA = 6,
+	};
+
+	uint32_t ReadBigEndian32(const uint8_t* _p)
+	{
+		return static_cast<uint32_t>(_p[0]) << 24 | static_cast<uint32_t>(_p[1]) << 16 | static_cast<uint32_t>(_p[2]) << 8 | _p[3];
+	}
+
+	uint8_t Paeth(uint8_t _a, uint8_t _b, uint8_t _c)
+	{
+		int p = _a + _b - _c;
+		int pa = abs(p - _a);
+		int pb = abs(p - _b);
+		int pc = abs(p - _c);
+		if (pa <= pb && pa <= pc)
+			return _a;
+		return pb <= pc ? _b : _c;
+	}
+
+	// undoes the filter in front of every row, in place. _pixelBytes is how far back the "left" byte is, at least 1
+	bool Unfilter(uint8_t* _pData, uint32_t _rowBytes, uint32_t _height, uint32_t _pixelBytes)
+	{
+		const uint8_t* pPrevious = nullptr;
+		for (uint32_t y = 0; y < _height; ++y)
+		{
+			uint8_t filter = _pData[0];
+			uint8_t* pRow = _pData + 1;
+			switch (filter)
+			{
+			case 0:
+				break;
+			case 1:
+				for (uint32_t x = _pixelBytes; x < _rowBytes; ++x)
+					pRow[x] = static_cast<uint8_t>(pRow[x] + pRow[x - _pixelBytes]);
+				break;
+			case 2:
+				if (pPrevious)
+					for (uint32_t x = 0; x < _rowBytes; ++x)
+						pRow[x] = static_cast<uint8_t>(pRow[x] + pPrevious[x]);
+				break;
+			case 3:
+				for (uint32_t x = 0; x < _rowBytes; ++x)
+				{
+					uint32_t left = x >= _pixelBytes ? pRow[x - _pixelBytes] : 0;
+					uint32_t up = pPrevious ? pPrevious[x] : 0;
+					pRow[x] = static_cast<uint8_t>(pRow[x] + ((left + up) >> 1));
+				}
+				break;
+			case 4:
+				for (uint32_t x = 0; x < _rowBytes; ++x)
+				{
+					uint8_t left = x >= _pixelBytes ? pRow[x - _pixelBytes] : 0;
+					uint8_t up = pPrevious ? pPrevious[x] : 0;
+					uint8_t upLeft = pPrevious && x >= _pixelBytes ? pPrevious[x - _pixelBytes] : 0;
+					pRow[x] = static_cast<uint8_t>(pRow[x] + Paeth(left, up, upLeft));
+				}
+				break;
+			default:
+				return false;
+			}
+			pPrevious = pRow;
+			_pData += _rowBytes + 1;
+		}
+		return true;
+	}
+
+	//==============================================================================================================
+	// tga
+	//==============================================================================================================
+
+	enum TgaImageType
+	{
+		TGA_TRUE_COLOR = 2,
+		TGA_GREY = 3,
+		TGA_RLE_TRUE_COLOR = 10,
+		TGA_RLE_GREY = 11,
+	};
+
+	const uint8_t TGA_TOP_ORIGIN = 0x20; // in the descriptor byte, rows are stored top first instead of bottom first
+
+	// one tga pixel, stored as bgr(a) or grey, as rgba
+	void TgaPixel(const uint8_t* _p, uint32_t _bytes, uint8_t* _pOut)
+	{
+		if (_bytes == 1)
+		{
+			_pOut[0] = _pOut[1] = _pOut[2] = _p[0];
+			_pOut[3] = 255;
+			return;
+		}
+		_pOut[0] = _p[2];
+		_pOut[1] = _p[1];
+		_pOut[2] = _p[0];
+		_pOut[3] = _bytes == 4 ? _p[3] : 255;
+	}
+}
+
+bool ImageImporter::Load(const std::string& _fileName, Image& _image)
+{
+	MappedFile file;
+	if (!file.Open(_fileName))
+		return false;
+
+	const uint8_t* pData = file.Data();
+	size_t size = static_cast<size_t>(file.Size());
+	if (size >= sizeof(PNG_SIGNATURE) && memcmp(pData, PNG_SIGNATURE, sizeof(PNG_SIGNATURE)) == 0)
+		return DecodePng(pData, size, _image);
+	return DecodeTga(pData, size, _image);
+}
+
+bool ImageImporter::Inflate(const uint8_t* _pData, size_t _size, std::vector<uint8_t>& _out, size_t _expectedSize)
+{
+	// the zlib header: deflate with a window of at most 32k, no preset dictionary, and a check that makes it a
+	// multiple of 31
+	if (_size < 6)
+		return false;
+	uint32_t cmf = _pData[0];
+	uint32_t flags = _pData[1];
+	if ((cmf & 15) != 8 || (cmf >> 4) > 7 || (cmf << 8 | flags) % 31 != 0 || (flags & 0x20))
+		return false;
+
+	// deflate packs at most 258 bytes into a bit or so, so a damaged size can not ask for more than that
+	size_t start = _out.size();
+	_out.reserve(start + std::min(_expectedSize, _size * 1032));
+	BitReader bits(_pData + 2, _size - 2);
+	Huffman literals;
+	Huffman distances;
+	bool last = false;
+	while (!last)
+	{
+		last = bits.Read(1) != 0;
+		uint32_t type = bits.Read(2);
+		if (type == 0)
+		{
+			bits.AlignToByte();
+			uint32_t length = bits.Read(16);
+			uint32_t complement = bits.Read(16);
+			if ((length ^ 0xffff) != complement)
+				return false;
+			for (uint32_t i = 0; i < length; ++i)
+				_out.push_back(static_cast<uint8_t>(bits.Read(8)));
+			if (bits.Overrun())
+				return false;
+			continue;
+		}
+
+		if (type == 1)
+		{
+			uint8_t lengths[288 + 30];
+			memset(lengths, 8, 144);
+			memset(lengths + 144, 9, 112);
+			memset(lengths + 256, 7, 24);
+			memset(lengths + 280, 8, 8);
+			memset(lengths + 288, 5, 30);
+			literals.Build(lengths, 288);
+			distances.Build(lengths + 288, 30);
+		}
+		else if (type != 2 || !ReadDynamicTables(bits, literals, distances))
+			return false;
+
+		if (!InflateBlock(bits, literals, distances, _out, start))
+			return false;
+	}
+
+	// the adler-32 of what came out follows, most significant byte first
+	bits.AlignToByte();
+	size_t end = 2 + bits.BytesConsumed();
+	if (end + 4 > _size)
+		return false;
+	return ReadBigEndian32(_pData + end) == Adler32(_out.data() + start, _out.size() - start);
+}
+
+bool ImageImporter::DecodePng(const uint8_t* _pData, size_t _size, Image& _image)
+{
+	if (_size < sizeof(PNG_SIGNATURE) || memcmp(_pData, PNG_SIGNATURE, sizeof(PNG_SIGNATURE)) != 0)
+		return false;
+
+	// every chunk is a length, a four letter type, the data and a crc. the crc is not checked, the zlib checksum
+	// already covers the pixels
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint32_t bitDepth = 0;
+	uint32_t colorType = 0;
+	uint8_t palette[256][4] = {};
+	uint32_t paletteSize = 0;
+	bool hasColorKey = false;
+	uint16_t colorKey[3] = {};
+	std::vector<uint8_t> compressed;
+	bool seenHeader = false;
+	bool seenEnd = false;
+	for (size_t offset = sizeof(PNG_SIGNATURE); offset + 12 <= _size && !seenEnd;)
+	{
+		uint32_t length = ReadBigEndian32(_pData + offset);
+		const uint8_t* pType = _pData + offset + 4;
+		const uint8_t* pChunk = _pData + offset + 8;
+		if (length > _size - offset - 12)
+			return false;
+		offset += 12 + static_cast<size_t>(length);
+
+		if (memcmp(pType, "IHDR", 4) == 0)
+		{
+			if (length < 13)
+				return false;
+			width = ReadBigEndian32(pChunk);
+			height = ReadBigEndian32(pChunk + 4);
+			bitDepth = pChunk[8];
+			colorType = pChunk[9];
+			uint32_t interlace = pChunk[12];
+			if (pChunk[10] != 0 || pChunk[11] != 0 || interlace != 0)
+				return false;
+			seenHeader = true;
+		}
+		else if (memcmp(pType, "PLTE", 4) == 0)
+		{
+			paletteSize = std::min(length / 3, 256u);
+			for (uint32_t i = 0; i < paletteSize; ++i)
+			{
+				palette[i][0] = pChunk[i * 3];
+				palette[i][1] = pChunk[i * 3 + 1];
+				palette[i][2] = pChunk[i * 3 + 2];
+				palette[i][3] = 255;
+			}
+		}
+		else if (memcmp(pType, "tRNS", 4) == 0)
+		{
+			// alphas for the first palette entries, or the one grey or rgb value that is transparent
+			if (colorType == PNG_PALETTE)
+			{
+				for (uint32_t i = 0; i < std::min(length, 256u); ++i)
+					palette[i][3] = pChunk[i];
+			}
+			else if (colorType == PNG_GREY && length >= 2)
+			{
+				hasColorKey = true;
+				colorKey[0] = static_cast<uint16_t>(pChunk[0] << 8 | pChunk[1]);
+			}
+			else if (colorType == PNG_RGB && length >= 6)
+			{
+				hasColorKey = true;
+				for (uint32_t channel = 0; channel < 3; ++channel)
+					colorKey[channel] = static_cast<uint16_t>(pChunk[channel * 2] << 8 | pChunk[channel * 2 + 1]);
+			}
+		}
+		else if (memcmp(pType, "IDAT", 4) == 0)
+			compressed.insert(compressed.end(), pChunk, pChunk + length);
+		else if (memcmp(pType, "IEND", 4) == 0)
+			seenEnd = true;
+	}
+
+	uint32_t channels;
+	switch (colorType)
+	{
+	case PNG_GREY: channels = 1; break;
+	case PNG_RGB: channels = 3; break;
+	case PNG_PALETTE: channels = 1; break;
+	case PNG_GREY_ALPHA: channels = 2; break;
+	case PNG_RGBA: channels = 4; break;
+	default: return false;
+	}
+	bool lowBitDepth = bitDepth == 1 || bitDepth == 2 || bitDepth == 4;
+	bool validDepth = bitDepth == 8 || (bitDepth == 16 && colorType != PNG_PALETTE) ||
+		(lowBitDepth && (colorType == PNG_GREY || colorType == PNG_PALETTE));
+	if (!seenHeader || !validDepth || width == 0 || height == 0 || (colorType == PNG_PALETTE && paletteSize == 0))
+		return false;
+	if (width > (1u << 16) || height > (1u << 16) || static_cast<uint64_t>(width) * height > (1ull << 28))
+		return false;
+
+	uint32_t bitsPerPixel = channels * bitDepth;
+	uint32_t rowBytes = (width * bitsPerPixel + 7) / 8;
+	size_t filteredSize = static_cast<size_t>(rowBytes + 1) * height;
+	std::vector<uint8_t> filtered;
+	if (!Inflate(compressed.data(), compressed.size(), filtered, filteredSize) || filtered.size() < filteredSize)
+		return false;
+	if (!Unfilter(filtered.data(), rowBytes, height, std::max(1u, bitsPerPixel / 8)))
+		return false;
+
+	_image.width = width;
+	_image.height = height;
+	_image.pixels.resize(static_cast<size_t>(width) * height * 4);
+	uint32_t maxSample = (1u << bitDepth) - 1;
+	for (uint32_t y = 0; y < height; ++y)
+	{
+		const uint8_t* pRow = filtered.data() + static_cast<size_t>(y) * (rowBytes + 1) + 1;
+		uint8_t* pOut = _image.pixels.data() + static_cast<size_t>(y) * width * 4;
+		for (uint32_t x = 0; x < width; ++x, pOut += 4)
+		{
+			// the raw samples of the pixel, at the file's depth
+			uint32_t samples[4];
+			for (uint32_t channel = 0; channel < channels; ++channel)
+			{
+				uint32_t sample = x * channels + channel;
+				if (bitDepth == 8)
+					samples[channel] = pRow[sample];
+				else if (bitDepth == 16)
+					samples[channel] = static_cast<uint32_t>(pRow[sample * 2]) << 8 | pRow[sample * 2 + 1];
+				else
+				{
+					uint32_t bit = sample * bitDepth;
+					samples[channel] = (pRow[bit / 8] >> (8 - bitDepth - bit % 8)) & maxSample;
+				}
+			}
+
+			if (colorType == PNG_PALETTE)
+			{
+				if (samples[0] >= paletteSize)
+					return false;
+				memcpy(pOut, palette[samples[0]], 4);
+				continue;
+			}
+
+			uint8_t values[4];
+			for (uint32_t channel = 0; channel < channels; ++channel)
+				values[channel] = static_cast<uint8_t>(bitDepth == 16 ? samples[channel] >> 8 : samples[channel] * 255 / maxSample);
+			switch (colorType)
+			{
+			case PNG_GREY:
+				pOut[0] = pOut[1] = pOut[2] = values[0];
+				pOut[3] = hasColorKey && samples[0] == colorKey[0] ? 0 : 255;
+				break;
+			case PNG_RGB:
+				pOut[0] = values[0];
+				pOut[1] = values[1];
+				pOut[2] = values[2];
+				pOut[3] = hasColorKey && samples[0] == colorKey[0] && samples[1] == colorKey[1] && samples[2] == colorKey[2] ? 0 : 255;
+				break;
+			case PNG_GREY_ALPHA:
+				pOut[0] = pOut[1] = pOut[2] = values[0];
+				pOut[3] = values[1];
+				break;
+			default:
+				memcpy(pOut, values, 4);
+				break;
+			}
+		}
+	}
+	return true;
+}
+
+bool ImageImporter::DecodeTga(const uint8_t* _pData, size_t _size, Image& _image)
+{
+	if (_size < 18)
+		return false;
+	uint32_t idLength = _pData[0];
+	uint32_t colorMapType = _pData[1];
+	uint32_t imageType = _pData[2];
+	uint32_t width = _pData[12] | _pData[13] << 8;
+	uint32_t height = _pData[14] | _pData[15] << 8;
+	uint32_t pixelDepth = _pData[16];
+	uint32_t descriptor = _pData[17];
+
+	bool grey = imageType == TGA_GREY || imageType == TGA_RLE_GREY;
+	bool rle = imageType == TGA_RLE_TRUE_COLOR || imageType == TGA_RLE_GREY;
+	if (colorMapType != 0 || (!grey && imageType != TGA_TRUE_COLOR && imageType != TGA_RLE_TRUE_COLOR))
+		return false;
+	if ((grey && pixelDepth != 8) || (!grey && pixelDepth != 24 && pixelDepth != 32) || width == 0 || height == 0)
+		return false;
+
+	uint32_t bytes = pixelDepth / 8;
+	size_t pixelCount = static_cast<size_t>(width) * height;
+	const uint8_t* p = _pData + 18 + idLength;
+	const uint8_t* pEnd = _pData + _size;
+	if (p > pEnd)
+		return false;
+
+	// a run length packet is at least two bytes and at most 128 pixels, so a damaged header can not ask for more
+	size_t available = static_cast<size_t>(pEnd - p);
+	if ((!rle && available < pixelCount * bytes) || (rle && available < pixelCount / 64))
+		return false;
+
+	// the pixels in file order first, the rows are flipped after if they start at the bottom
+	_image.width = width;
+	_image.height = height;
+	_image.pixels.resize(pixelCount * 4);
+	uint8_t* pOut = _image.pixels.data();
+	if (!rle)
+	{
+		for (size_t i = 0; i < pixelCount; ++i, p += bytes)
+			TgaPixel(p, bytes, pOut + i * 4);
+	}
+	else
+	{
+		// packets of up to 128 pixels, either one pixel repeated or that many stored as they are
+		for (size_t i = 0; i < pixelCount;)
+		{
+			if (p >= pEnd)
+				return false;
+			uint32_t packet = *p++;
+			size_t count = std::min<size_t>((packet & 127) + 1, pixelCount - i);
+			if (packet & 128)
+			{
+				if (static_cast<size_t>(pEnd - p) < bytes)
+					return false;
+				uint8_t pixel[4];
+				TgaPixel(p, bytes, pixel);
+				p += bytes;
+				for (size_t j = 0; j < count; ++j)
+					memcpy(pOut + (i + j) * 4, pixel, 4);
+			}
+			else
+			{
+				if (static_cast<size_t>(pEnd - p) < count * bytes)
+					return false;
+				for (size_t j = 0; j < count; ++j, p += bytes)
+					TgaPixel(p, bytes, pOut + (i + j) * 4);
+			}
+			i += count;
+		}
+	}
+
+	if (!(descriptor & TGA_TOP_ORIGIN))
+	{
+		size_t rowSize = static_cast<size_t>(width) * 4;
+		for (uint32_t y = 0; y < height / 2; ++y)
+			std::swap_ranges(pOut + y * rowSize, pOut + (y + 1) * rowSize, pOut + (height - 1 - y) * rowSize);
+	}
+	return true;
+}
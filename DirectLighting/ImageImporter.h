@@ -0,0 +1,32 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct Image
+{
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<uint8_t> pixels; // rgba8, rows top to bottom with nothing between them
+};
+
+// reads the source images of the texture pipeline into rgba8, whatever they were stored as.
+//
+// png: every colour type and bit depth, tRNS transparency included. 16 bit channels keep their high byte. interlaced
+// files are rejected, so are files with a preset zlib dictionary. the IDAT stream goes through a small inflate with
+// a 10 bit lookup table for both huffman trees, and the zlib checksum is checked, so a damaged file fails instead of
+// giving a damaged texture
+//
+// tga: uncompressed and run length encoded, true colour (24 and 32 bit) and greyscale, either origin
+namespace ImageImporter
+{
+	// png when the file starts with its signature, tga otherwise. false if it is neither or is malformed
+	bool Load(const std::string& _fileName, Image& _image);
+
+	bool DecodePng(const uint8_t* _pData, size_t _size, Image& _image);
+	bool DecodeTga(const uint8_t* _pData, size_t _size, Image& _image);
+
+	// a zlib stream (rfc 1950 around rfc 1951 deflate) appended to _out. _expectedSize only sizes the first allocation
+	bool Inflate(const uint8_t* _pData, size_t _size, std::vector<uint8_t>& _out, size_t _expectedSize = 0);
+}
@@ -0,0 +1,96 @@
+#include "IndirectDraw.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "JobSystem.h"
+
+namespace
+{
+	// culling one draw is cheap, so blocks need to be large before threads are worth it
+	const uint32_t MIN_DRAWS_PER_BLOCK = 4096;
+}
+
+uint32_t CompactIndirectDraws(const IndirectDrawSource* _sources, uint32_t _count, const Frustum& _frustum,
+	uint32_t _bucketCount, IndirectDrawRecord* _records, uint32_t* _bucketOffsets, uint32_t* _bucketCounts, JobSystem* _pJobSystem)
+{
+	memset(_bucketCounts, 0, _bucketCount * sizeof(uint32_t));
+	memset(_bucketOffsets, 0, _bucketCount * sizeof(uint32_t));
+	if (_count == 0 || _bucketCount == 0)
+		return 0;
+
+	uint32_t blockCount = 1;
+	if (_pJobSystem)
+	{
+		uint32_t maxBlocks = std::max(1u, _count / MIN_DRAWS_PER_BLOCK);
+		blockCount = std::min(_pJobSystem->ThreadCount() + 1, maxBlocks);
+	}
+	uint32_t blockSize = (_count + blockCount - 1) / blockCount;
+
+	auto runBlocks = [&](const std::function<void(unsigned int, unsigned int)>& _func)
+	{
+		if (_pJobSystem && blockCount > 1)
+			_pJobSystem->ParallelFor(blockCount, 1, _func);
+		else
+			_func(0, blockCount);
+	};
+
+	// visibility pass: test every draw and count the visible ones per block and bucket
+	std::vector<uint8_t> visible(_count);
+	std::vector<uint32_t> blockOffsets(static_cast<size_t>(blockCount) * _bucketCount, 0); // [block][bucket]
+	runBlocks([&](unsigned int _begin, unsigned int _end)
+	{
+		for (unsigned int block = _begin; block < _end; ++block)
+		{
+			uint32_t* pCounts = &blockOffsets[static_cast<size_t>(block) * _bucketCount];
+			uint32_t first = block * blockSize;
+			uint32_t last = std::min(first + blockSize, _count);
+			for (uint32_t i = first; i < last; ++i)
+			{
+				bool inside = _sources[i].bucket < _bucketCount && Culling::SphereInFrustum(_frustum, _sources[i].boundingSphere);
+				visible[i] = inside ? 1 : 0;
+				if (inside)
+					pCounts[_sources[i].bucket]++;
+			}
+		}
+	});
+
+	// prefix sum in (bucket, block) order: buckets are contiguous, and inside a bucket block 0 comes first
+	uint32_t running = 0;
+	for (uint32_t bucket = 0; bucket < _bucketCount; ++bucket)
+	{
+		_bucketOffsets[bucket] = running;
+		for (uint32_t block = 0; block < blockCount; ++block)
+		{
+			uint32_t& offset = blockOffsets[static_cast<size_t>(block) * _bucketCount + bucket];
+			uint32_t count = offset;
+			offset = running;
+			running += count;
+		}
+		_bucketCounts[bucket] = running - _bucketOffsets[bucket];
+	}
+
+	// scatter pass: pack each visible draw's root constants and draw arguments into its slot
+	runBlocks([&](unsigned int _begin, unsigned int _end)
+	{
+		for (unsigned int block = _begin; block < _end; ++block)
+		{
+			uint32_t* pOffsets = &blockOffsets[static_cast<size_t>(block) * _bucketCount];
+			uint32_t first = block * blockSize;
+			uint32_t last = std::min(first + blockSize, _count);
+			for (uint32_t i = first; i < last; ++i)
+			{
+				if (!visible[i])
+					continue;
+
+				const IndirectDrawSource& source = _sources[i];
+				IndirectDrawRecord& record = _records[pOffsets[source.bucket]++];
+				memcpy(record.rootConstants, source.pRootConstants, sizeof(record.rootConstants));
+				record.draw = source.draw;
+			}
+		}
+	});
+
+	return running;
+}
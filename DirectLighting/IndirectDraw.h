@@ -0,0 +1,49 @@
+#pragma once
+#include <DirectXMath.h>
+
+#include <cstdint>
+
+#include "Culling.h"
+
+class JobSystem;
+
+// same layout as D3D12_DRAW_INDEXED_ARGUMENTS, redeclared so this file has no d3d dependency
+struct DrawIndexedArguments
+{
+	uint32_t indexCountPerInstance;
+	uint32_t instanceCount;
+	uint32_t startIndexLocation;
+	int32_t baseVertexLocation;
+	uint32_t startInstanceLocation;
+};
+
+// root constants carried by each indirect draw. matches ConstantBufferPerObject (a 4x4 matrix and three rows of another)
+const uint32_t INDIRECT_ROOT_CONSTANTS = 28;
+
+// one record in the argument buffer. the command signature sets the root constants then draws,
+// so this layout has to match the argument descriptions in Graphics::CommandSignature
+struct IndirectDrawRecord
+{
+	uint32_t rootConstants[INDIRECT_ROOT_CONSTANTS];
+	DrawIndexedArguments draw;
+};
+
+// a draw before culling
+struct IndirectDrawSource
+{
+	DirectX::XMFLOAT4 boundingSphere; // world space centre and radius
+	uint32_t bucket; // draws in a bucket share all state and go out in one ExecuteIndirect
+	const void* pRootConstants; // INDIRECT_ROOT_CONSTANTS values
+	DrawIndexedArguments draw;
+};
+
+// culls the sources against the frustum and packs the visible ones into _records, grouped by bucket.
+// bucket b's records start at _bucketOffsets[b] and there are _bucketCounts[b] of them. within a bucket
+// the records keep the order of the sources, so sorted input stays sorted. returns the number of records.
+//
+// this is the cpu version of what the culling compute shader will do: a visibility pass that counts
+// visible draws per (block, bucket), a prefix sum that hands each block its own output ranges, then a
+// scatter. because the ranges come from the prefix sum the output is the same however many blocks run,
+// so it doubles as the reference the gpu results are checked against
+uint32_t CompactIndirectDraws(const IndirectDrawSource* _sources, uint32_t _count, const Frustum& _frustum,
+	uint32_t _bucketCount, IndirectDrawRecord* _records, uint32_t* _bucketOffsets, uint32_t* _bucketCounts, JobSystem* _pJobSystem = nullptr);
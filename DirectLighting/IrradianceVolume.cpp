@@ -0,0 +1,245 @@
+#include "IrradianceVolume.h"
+
+#include <DirectXPackedVector.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include "JobSystem.h"
+#include "PathTracer.h"
+
+using namespace DirectX;
+
+namespace
+{
+	// the real spherical harmonics up to l = 2, without their dependence on the direction
+	const float SH_Y00 = 0.282095f;
+	const float SH_Y1 = 0.488603f;
+	const float SH_Y2 = 1.092548f;
+	const float SH_Y20 = 0.315392f;
+	const float SH_Y22 = 0.546274f;
+
+	// convolving with max(cos, 0) scales each band by these (ramamoorthi and hanrahan 2001)
+	const float COSINE_BAND0 = XM_PI;
+	const float COSINE_BAND1 = 2.0f * XM_PI / 3.0f;
+	const float COSINE_BAND2 = XM_PI / 4.0f;
+
+	void Basis(const XMFLOAT3& _n, float* _basis)
+	{
+		_basis[0] = SH_Y00;
+		_basis[1] = SH_Y1 * _n.y;
+		_basis[2] = SH_Y1 * _n.z;
+		_basis[3] = SH_Y1 * _n.x;
+		_basis[4] = SH_Y2 * _n.x * _n.y;
+		_basis[5] = SH_Y2 * _n.y * _n.z;
+		_basis[6] = SH_Y20 * (3.0f * _n.z * _n.z - 1.0f);
+		_basis[7] = SH_Y2 * _n.x * _n.z;
+		_basis[8] = SH_Y22 * (_n.x * _n.x - _n.y * _n.y);
+	}
+}
+
+void IrradianceVolume::Init(const IrradianceVolumeDesc& _desc)
+{
+	m_desc = _desc;
+	m_desc.countX = std::max(m_desc.countX, 2u);
+	m_desc.countY = std::max(m_desc.countY, 2u);
+	m_desc.countZ = std::max(m_desc.countZ, 2u);
+	m_spacing = XMFLOAT3(
+		(m_desc.boundsMax.x - m_desc.boundsMin.x) / (m_desc.countX - 1),
+		(m_desc.boundsMax.y - m_desc.boundsMin.y) / (m_desc.countY - 1),
+		(m_desc.boundsMax.z - m_desc.boundsMin.z) / (m_desc.countZ - 1));
+	m_strata = std::max(static_cast<uint32_t>(std::sqrt(static_cast<float>(m_desc.samplesPerProbe))), 2u);
+
+	ShCoefficients black;
+	for (XMVECTOR& v : black.v)
+		v = XMVectorZero();
+	m_probes.assign(m_desc.countX * m_desc.countY * m_desc.countZ, black);
+}
+
+XMFLOAT3 IrradianceVolume::ProbePosition(uint32_t _x, uint32_t _y, uint32_t _z)
+{
+	return XMFLOAT3(
+		m_desc.boundsMin.x + _x * m_spacing.x,
+		m_desc.boundsMin.y + _y * m_spacing.y,
+		m_desc.boundsMin.z + _z * m_spacing.z);
+}
+
+void IrradianceVolume::Bake(PathTracer& _scene, JobSystem* _pJobSystem)
+{
+	uint32_t probeCount = ProbeCount();
+	auto bake = [&](unsigned int _begin, unsigned int _end)
+	{
+		for (unsigned int probe = _begin; probe < _end; ++probe)
+			BakeProbe(_scene, probe);
+	};
+	if (_pJobSystem)
+		_pJobSystem->ParallelFor(probeCount, 1, bake);
+	else
+		bake(0, probeCount);
+}
+
+void IrradianceVolume::BakeProbe(PathTracer& _scene, uint32_t _probe)
+{
+	uint32_t x = _probe % m_desc.countX;
+	uint32_t y = (_probe / m_desc.countX) % m_desc.countY;
+	uint32_t z = _probe / (m_desc.countX * m_desc.countY);
+	XMFLOAT3 position = ProbePosition(x, y, z);
+
+	// one direction in every cell of a grid over the sphere's area, so the samples cannot all bunch up
+	uint32_t sampleCount = m_strata * m_strata;
+	std::vector<XMFLOAT3> directions(sampleCount);
+	std::vector<XMFLOAT3> radiance(sampleCount);
+	PathRandom random(_probe);
+	for (uint32_t i = 0; i < sampleCount; ++i)
+	{
+		float u = ((i % m_strata) + random.Next()) / m_strata;
+		float v = ((i / m_strata) + random.Next()) / m_strata;
+		float cosTheta = 1.0f - 2.0f * u;
+		float sinTheta = std::sqrt(std::max(0.0f, 1.0f - cosTheta * cosTheta));
+		float phi = 2.0f * XM_PI * v;
+		directions[i] = XMFLOAT3(sinTheta * std::cos(phi), sinTheta * std::sin(phi), cosTheta);
+		radiance[i] = _scene.Radiance(position, directions[i], random);
+	}
+	ProjectIrradiance(directions.data(), radiance.data(), sampleCount, m_probes[_probe]);
+}
+
+void IrradianceVolume::ProjectIrradiance(const XMFLOAT3* _directions, const XMFLOAT3* _radiance, uint32_t _count, ShCoefficients& _coefficients)
+{
+	// 27 running sums, four directions to a vector. the lanes are only added together at the end
+	XMVECTOR sums[27];
+	for (XMVECTOR& sum : sums)
+		sum = XMVectorZero();
+
+	XMVECTOR y1 = XMVectorReplicate(SH_Y1);
+	XMVECTOR y2 = XMVectorReplicate(SH_Y2);
+	XMVECTOR y20 = XMVectorReplicate(SH_Y20);
+	XMVECTOR y22 = XMVectorReplicate(SH_Y22);
+	XMVECTOR three = XMVectorReplicate(3.0f);
+	XMVECTOR one = XMVectorReplicate(1.0f);
+	for (uint32_t first = 0; first < _count; first += 4)
+	{
+		// the last quad is padded with directions that carry no light
+		XMFLOAT3 d[4];
+		XMFLOAT3 l[4];
+		for (uint32_t lane = 0; lane < 4; ++lane)
+		{
+			bool used = first + lane < _count;
+			d[lane] = used ? _directions[first + lane] : XMFLOAT3(0.0f, 0.0f, 1.0f);
+			l[lane] = used ? _radiance[first + lane] : XMFLOAT3(0.0f, 0.0f, 0.0f);
+		}
+		XMVECTOR x = XMVectorSet(d[0].x, d[1].x, d[2].x, d[3].x);
+		XMVECTOR y = XMVectorSet(d[0].y, d[1].y, d[2].y, d[3].y);
+		XMVECTOR z = XMVectorSet(d[0].z, d[1].z, d[2].z, d[3].z);
+		XMVECTOR channels[3] =
+		{
+			XMVectorSet(l[0].x, l[1].x, l[2].x, l[3].x),
+			XMVectorSet(l[0].y, l[1].y, l[2].y, l[3].y),
+			XMVectorSet(l[0].z, l[1].z, l[2].z, l[3].z)
+		};
+
+		XMVECTOR basis[9] =
+		{
+			XMVectorReplicate(SH_Y00),
+			XMVectorMultiply(y1, y),
+			XMVectorMultiply(y1, z),
+			XMVectorMultiply(y1, x),
+			XMVectorMultiply(y2, XMVectorMultiply(x, y)),
+			XMVectorMultiply(y2, XMVectorMultiply(y, z)),
+			XMVectorMultiply(y20, XMVectorMultiplyAdd(three, XMVectorMultiply(z, z), XMVectorNegate(one))),
+			XMVectorMultiply(y2, XMVectorMultiply(x, z)),
+			XMVectorMultiply(y22, XMVectorSubtract(XMVectorMultiply(x, x), XMVectorMultiply(y, y)))
+		};
+		for (uint32_t k = 0; k < 9; ++k)
+		{
+			for (uint32_t c = 0; c < 3; ++c)
+				sums[k * 3 + c] = XMVectorMultiplyAdd(basis[k], channels[c], sums[k * 3 + c]);
+		}
+	}
+
+	// every sample stands for 4 pi / count of the sphere
+	float weight = 4.0f * XM_PI / std::max(_count, 1u);
+	const float bandScale[9] = { COSINE_BAND0, COSINE_BAND1, COSINE_BAND1, COSINE_BAND1, COSINE_BAND2, COSINE_BAND2, COSINE_BAND2, COSINE_BAND2, COSINE_BAND2 };
+	float coefficients[28] = {};
+	for (uint32_t i = 0; i < 27; ++i)
+	{
+		XMFLOAT4 lanes;
+		XMStoreFloat4(&lanes, sums[i]);
+		coefficients[i] = (lanes.x + lanes.y + lanes.z + lanes.w) * weight * bandScale[i / 3];
+	}
+	for (uint32_t i = 0; i < 7; ++i)
+		_coefficients.v[i] = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&coefficients[i * 4]));
+}
+
+XMFLOAT3 IrradianceVolume::Evaluate(const ShCoefficients& _coefficients, const XMFLOAT3& _normal)
+{
+	float coefficients[28];
+	for (uint32_t i = 0; i < 7; ++i)
+		XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&coefficients[i * 4]), _coefficients.v[i]);
+
+	float basis[9];
+	Basis(_normal, basis);
+	XMFLOAT3 irradiance(0.0f, 0.0f, 0.0f);
+	for (uint32_t k = 0; k < 9; ++k)
+	{
+		irradiance.x += basis[k] * coefficients[k * 3 + 0];
+		irradiance.y += basis[k] * coefficients[k * 3 + 1];
+		irradiance.z += basis[k] * coefficients[k * 3 + 2];
+	}
+
+	// ringing can take l2 a little below zero opposite a bright light
+	return XMFLOAT3(std::max(irradiance.x, 0.0f), std::max(irradiance.y, 0.0f), std::max(irradiance.z, 0.0f));
+}
+
+void IrradianceVolume::Sample(const XMFLOAT3& _position, ShCoefficients& _coefficients)
+{
+	// the probe cell the point is in and how far across it, clamped to the volume
+	float gx = std::min(std::max((_position.x - m_desc.boundsMin.x) / m_spacing.x, 0.0f), static_cast<float>(m_desc.countX - 1));
+	float gy = std::min(std::max((_position.y - m_desc.boundsMin.y) / m_spacing.y, 0.0f), static_cast<float>(m_desc.countY - 1));
+	float gz = std::min(std::max((_position.z - m_desc.boundsMin.z) / m_spacing.z, 0.0f), static_cast<float>(m_desc.countZ - 1));
+	uint32_t x = std::min(static_cast<uint32_t>(gx), m_desc.countX - 2);
+	uint32_t y = std::min(static_cast<uint32_t>(gy), m_desc.countY - 2);
+	uint32_t z = std::min(static_cast<uint32_t>(gz), m_desc.countZ - 2);
+	float fx = gx - x;
+	float fy = gy - y;
+	float fz = gz - z;
+
+	for (XMVECTOR& v : _coefficients.v)
+		v = XMVectorZero();
+	for (uint32_t corner = 0; corner < 8; ++corner)
+	{
+		uint32_t cx = corner & 1;
+		uint32_t cy = (corner >> 1) & 1;
+		uint32_t cz = corner >> 2;
+		float weight = (cx ? fx : 1.0f - fx) * (cy ? fy : 1.0f - fy) * (cz ? fz : 1.0f - fz);
+		XMVECTOR w = XMVectorReplicate(weight);
+		const ShCoefficients& probe = m_probes[ProbeIndex(x + cx, y + cy, z + cz)];
+		for (uint32_t i = 0; i < 7; ++i)
+			_coefficients.v[i] = XMVectorMultiplyAdd(probe.v[i], w, _coefficients.v[i]);
+	}
+}
+
+XMFLOAT3 IrradianceVolume::Irradiance(const XMFLOAT3& _position, const XMFLOAT3& _normal)
+{
+	ShCoefficients coefficients;
+	Sample(_position, coefficients);
+	return Evaluate(coefficients, _normal);
+}
+
+void IrradianceVolume::GpuTexels(std::vector<uint16_t>& _halfs)
+{
+	uint32_t probeCount = ProbeCount();
+	_halfs.resize(GPU_TEXTURE_COUNT * probeCount * 4);
+	for (uint32_t texture = 0; texture < GPU_TEXTURE_COUNT; ++texture)
+	{
+		for (uint32_t probe = 0; probe < probeCount; ++probe)
+		{
+			XMFLOAT4 texel;
+			XMStoreFloat4(&texel, m_probes[probe].v[texture]);
+			uint16_t* pOut = &_halfs[(texture * probeCount + probe) * 4];
+			pOut[0] = PackedVector::XMConvertFloatToHalf(texel.x);
+			pOut[1] = PackedVector::XMConvertFloatToHalf(texel.y);
+			pOut[2] = PackedVector::XMConvertFloatToHalf(texel.z);
+			pOut[3] = PackedVector::XMConvertFloatToHalf(texel.w);
+		}
+	}
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <DirectXMath.h>
+
+#include <cstdint>
+#include <vector>
+
+class JobSystem;
+class PathTracer;
+
+// nine L2 spherical harmonic coefficients for each of red, green and blue, 27 floats as coefficient * 3 + channel,
+// padded to seven vectors. this is also one probe's seven texels on the gpu
+struct ShCoefficients
+{
+	DirectX::XMVECTOR v[7];
+};
+
+struct IrradianceVolumeDesc
+{
+	DirectX::XMFLOAT3 boundsMin = DirectX::XMFLOAT3(-10.0f, -1.0f, -10.0f); // the corner probes sit on the bounds
+	DirectX::XMFLOAT3 boundsMax = DirectX::XMFLOAT3(10.0f, 9.0f, 10.0f);
+	uint32_t countX = 8; // probes along each axis, at least 2
+	uint32_t countY = 4;
+	uint32_t countZ = 8;
+	uint32_t samplesPerProbe = 256; // rounded down to a square number, at least 4
+};
+
+// a grid of light probes that each hold the irradiance arriving from every direction as L2 spherical harmonics, for
+// lighting dynamic objects with the light bouncing around the static scene without looping over any lights.
+//
+// Bake shoots rays out of every probe through the PathTracer, stratified over the sphere, and projects the radiance
+// that comes back onto the nine basis functions four directions at a time in DirectXMath vectors. the result is
+// convolved with the cosine lobe, so a probe's coefficients evaluated for a normal give the irradiance straight away.
+// probes are baked in parallel, each with its own random numbers, so the volume is the same however many threads ran.
+//
+// on the cpu a point blends the eight probes around it trilinearly, seven vectors a probe, then evaluates the blend.
+// on the gpu GpuTexels is seven rgba16f 3d textures with one probe per texel, so the hardware does the trilinear
+// blend and IrradianceVolume.hlsli only evaluates the result
+class IrradianceVolume
+{
+public:
+	static const uint32_t GPU_TEXTURE_COUNT = 7;
+
+	IrradianceVolume() = default;
+	~IrradianceVolume() = default;
+
+	void Init(const IrradianceVolumeDesc& _desc);
+
+	// the scene has to be committed. _pJobSystem splits the probes up
+	void Bake(PathTracer& _scene, JobSystem* _pJobSystem = nullptr);
+
+	// the blend of the probes around _position, clamped to the volume
+	void Sample(const DirectX::XMFLOAT3& _position, ShCoefficients& _coefficients);
+
+	// the irradiance on a surface at _position facing _normal (normalised)
+	DirectX::XMFLOAT3 Irradiance(const DirectX::XMFLOAT3& _position, const DirectX::XMFLOAT3& _normal);
+
+	// projects radiance arriving from _directions (normalised, each carrying 4 pi / _count of the sphere) onto the
+	// basis, and convolves it with the cosine lobe
+	static void ProjectIrradiance(const DirectX::XMFLOAT3* _directions, const DirectX::XMFLOAT3* _radiance, uint32_t _count, ShCoefficients& _coefficients);
+
+	// evaluates irradiance coefficients for _normal
+	static DirectX::XMFLOAT3 Evaluate(const ShCoefficients& _coefficients, const DirectX::XMFLOAT3& _normal);
+
+	DirectX::XMFLOAT3 ProbePosition(uint32_t _x, uint32_t _y, uint32_t _z);
+	uint32_t ProbeIndex(uint32_t _x, uint32_t _y, uint32_t _z) { return (_z * m_desc.countY + _y) * m_desc.countX + _x; }
+	uint32_t ProbeCount() { return static_cast<uint32_t>(m_probes.size()); }
+	const ShCoefficients& Probe(uint32_t _probe) { return m_probes[_probe]; }
+	const IrradianceVolumeDesc& Desc() { return m_desc; }
+
+	// half floats for GPU_TEXTURE_COUNT textures of countX * countY * countZ rgba texels, texture after texture,
+	// each in x, y, z order
+	void GpuTexels(std::vector<uint16_t>& _halfs);
+
+private:
+	void BakeProbe(PathTracer& _scene, uint32_t _probe);
+
+	IrradianceVolumeDesc m_desc;
+	DirectX::XMFLOAT3 m_spacing = DirectX::XMFLOAT3(1.0f, 1.0f, 1.0f);
+	uint32_t m_strata = 2; // the samples are a strata * strata grid over the sphere
+	std::vector<ShCoefficients> m_probes;
+};
@@ -0,0 +1,45 @@
+// lighting from an IrradianceVolume's GpuTexels: seven rgba16f 3d textures with one probe per texel, sampled with a
+// trilinear clamped sampler so the hardware blends the eight probes around the point. texel t holds floats 4t to
+// 4t + 3 of the coefficients, stored as coefficient * 3 + channel and already convolved with the cosine lobe
+
+#define IRRADIANCE_VOLUME_TEXTURES 7 // IrradianceVolume::GPU_TEXTURE_COUNT
+
+// where a world space point is in the textures. probes sit on the bounds and the texel centres, so the coordinate is
+// pulled in by half a texel at each end
+float3 IrradianceVolumeUvw(float3 position, float3 boundsMin, float3 boundsMax, float3 probeCount)
+{
+	float3 grid = saturate((position - boundsMin) / (boundsMax - boundsMin)) * (probeCount - 1.0f);
+	return (grid + 0.5f) / probeCount;
+}
+
+float3 SampleIrradianceVolume(Texture3D<float4> coefficients[IRRADIANCE_VOLUME_TEXTURES], SamplerState linearClamp, float3 uvw, float3 normal)
+{
+	float c[28];
+	[unroll]
+	for (uint i = 0; i < IRRADIANCE_VOLUME_TEXTURES; ++i)
+	{
+		float4 texel = coefficients[i].SampleLevel(linearClamp, uvw, 0.0f);
+		c[i * 4 + 0] = texel.x;
+		c[i * 4 + 1] = texel.y;
+		c[i * 4 + 2] = texel.z;
+		c[i * 4 + 3] = texel.w;
+	}
+
+	// the same basis as IrradianceVolume.cpp
+	float basis[9];
+	basis[0] = 0.282095f;
+	basis[1] = 0.488603f * normal.y;
+	basis[2] = 0.488603f * normal.z;
+	basis[3] = 0.488603f * normal.x;
+	basis[4] = 1.092548f * normal.x * normal.y;
+	basis[5] = 1.092548f * normal.y * normal.z;
+	basis[6] = 0.315392f * (3.0f * normal.z * normal.z - 1.0f);
+	basis[7] = 1.092548f * normal.x * normal.z;
+	basis[8] = 0.546274f * (normal.x * normal.x - normal.y * normal.y);
+
+	float3 irradiance = 0.0f;
+	[unroll]
+	for (uint k = 0; k < 9; ++k)
+		irradiance += basis[k] * float3(c[k * 3 + 0], c[k * 3 + 1], c[k * 3 + 2]);
+	return max(irradiance, 0.0f);
+}
@@ -0,0 +1,156 @@
+#include "JobSystem.h"
+
+#include <memory>
+
+JobSystem::~JobSystem()
+{
+	Shutdown();
+}
+
+bool JobSystem::Init(unsigned int _threadCount)
+{
+	if (m_running)
+		return true;
+
+	if (_threadCount == 0)
+	{
+		// hardware_concurrency can return 0 when it cannot tell, in which case we still want one worker
+		unsigned int hardwareThreads = std::thread::hardware_concurrency();
+		_threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+	}
+
+	m_running = true;
+	for (unsigned int i = 0; i < _threadCount; ++i)
+	{
+		m_workers.emplace_back(&JobSystem::WorkerLoop, this);
+	}
+	return true;
+}
+
+void JobSystem::Shutdown()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (!m_running)
+			return;
+		m_running = false;
+	}
+	m_wakeCondition.notify_all();
+
+	for (std::thread& worker : m_workers)
+	{
+		if (worker.joinable())
+			worker.join();
+	}
+	m_workers.clear();
+	m_queue.clear();
+}
+
+void JobSystem::Submit(std::function<void()> _job)
+{
+	// no workers, just run it here
+	if (m_workers.empty())
+	{
+		_job();
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_queue.push_back(std::move(_job));
+	}
+	m_wakeCondition.notify_one();
+}
+
+void JobSystem::ParallelFor(unsigned int _count, unsigned int _grainSize, const std::function<void(unsigned int _begin, unsigned int _end)>& _func)
+{
+	if (_count == 0)
+		return;
+	if (_grainSize == 0)
+		_grainSize = 1;
+
+	unsigned int chunkCount = (_count + _grainSize - 1) / _grainSize;
+	if (chunkCount == 1 || m_workers.empty())
+	{
+		_func(0, _count);
+		return;
+	}
+
+	// shared between the caller and the helper jobs. helpers can start after the caller has
+	// returned (if every chunk was already taken) so the state is reference counted
+	struct ForState
+	{
+		std::atomic<unsigned int> nextChunk{ 0 };
+		std::atomic<unsigned int> doneChunks{ 0 };
+		std::mutex mutex;
+		std::condition_variable doneCondition;
+	};
+	std::shared_ptr<ForState> state = std::make_shared<ForState>();
+
+	// the function is only referenced while chunks remain, and the caller does not return until
+	// every chunk is done, so holding a pointer to it is safe
+	const std::function<void(unsigned int, unsigned int)>* pFunc = &_func;
+	unsigned int count = _count;
+	unsigned int grainSize = _grainSize;
+
+	auto runChunks = [state, pFunc, count, grainSize, chunkCount]()
+	{
+		unsigned int chunk;
+		while ((chunk = state->nextChunk.fetch_add(1)) < chunkCount)
+		{
+			unsigned int begin = chunk * grainSize;
+			unsigned int end = begin + grainSize < count ? begin + grainSize : count;
+			(*pFunc)(begin, end);
+
+			if (state->doneChunks.fetch_add(1) + 1 == chunkCount)
+			{
+				std::lock_guard<std::mutex> lock(state->mutex);
+				state->doneCondition.notify_all();
+			}
+		}
+	};
+
+	unsigned int helpers = chunkCount - 1 < ThreadCount() ? chunkCount - 1 : ThreadCount();
+	for (unsigned int i = 0; i < helpers; ++i)
+	{
+		Submit(runChunks);
+	}
+
+	// the caller works too, then waits for whichever chunks are still running on other threads
+	runChunks();
+
+	std::unique_lock<std::mutex> lock(state->mutex);
+	state->doneCondition.wait(lock, [&state, chunkCount]() { return state->doneChunks.load() == chunkCount; });
+}
+
+void JobSystem::Wait()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_idleCondition.wait(lock, [this]() { return m_queue.empty() && m_activeJobs == 0; });
+}
+
+void JobSystem::WorkerLoop()
+{
+	while (true)
+	{
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wakeCondition.wait(lock, [this]() { return !m_running || !m_queue.empty(); });
+			if (!m_running)
+				return;
+
+			job = std::move(m_queue.front());
+			m_queue.pop_front();
+			m_activeJobs++;
+		}
+
+		job();
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_activeJobs--;
+		}
+		m_idleCondition.notify_all();
+	}
+}
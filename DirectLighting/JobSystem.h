@@ -0,0 +1,42 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// a small pool of worker threads. jobs are plain functions pushed onto a shared queue,
+// ParallelFor splits a range into chunks and the calling thread helps out until every
+// chunk is done, so it is safe to call from inside another job
+class JobSystem
+{
+public:
+	JobSystem() = default;
+	~JobSystem();
+
+	bool Init(unsigned int _threadCount = 0); // 0 = one worker per hardware thread minus the main thread
+	void Shutdown();
+
+	void Submit(std::function<void()> _job);
+
+	// calls _func(begin, end) over [0, _count) in chunks of _grainSize. blocks until all chunks are done
+	void ParallelFor(unsigned int _count, unsigned int _grainSize, const std::function<void(unsigned int _begin, unsigned int _end)>& _func);
+
+	// blocks until the queue is empty and no worker is running a job
+	void Wait();
+
+	unsigned int ThreadCount() { return static_cast<unsigned int>(m_workers.size()); }
+
+private:
+	void WorkerLoop();
+
+	std::vector<std::thread> m_workers;
+	std::deque<std::function<void()>> m_queue;
+	std::mutex m_mutex;
+	std::condition_variable m_wakeCondition; // signalled when a job is queued or we are shutting down
+	std::condition_variable m_idleCondition; // signalled when a worker finishes a job
+	unsigned int m_activeJobs = 0;
+	bool m_running = false;
+};
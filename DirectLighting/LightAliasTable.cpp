@@ -0,0 +1,179 @@
+#include "LightAliasTable.h"
+
+#include <algorithm>
+
+#include "JobSystem.h"
+
+namespace
+{
+	const float ONE_MINUS_EPSILON = 0.99999994f; // the largest float below 1
+
+	// a slot from a uniform number, and the fraction left over to choose between the slot's item and its alias.
+	// LightAliasTable.hlsli does exactly the same operations
+	uint32_t PickSlot(const LightAliasEntry* _entries, uint32_t _count, float _u, float& _pmf)
+	{
+		float scaled = _u * static_cast<float>(_count);
+		uint32_t slot = std::min(static_cast<uint32_t>(scaled), _count - 1);
+		float fraction = scaled - static_cast<float>(slot);
+		const LightAliasEntry& entry = _entries[slot];
+		if (fraction < entry.threshold)
+		{
+			_pmf = entry.pmf;
+			return slot;
+		}
+		_pmf = entry.aliasPmf;
+		return entry.alias;
+	}
+}
+
+void LightAliasTable::BuildTable(const float* _weights, uint32_t _count, double _total, LightAliasEntry* _entries, std::vector<uint32_t>& _small, std::vector<uint32_t>& _large, std::vector<double>& _scaled)
+{
+	// nothing to choose from, keep the table valid and let the pmfs say it is never picked
+	if (_total <= 0.0)
+	{
+		for (uint32_t i = 0; i < _count; ++i)
+			_entries[i] = { 1.0f, i, 0.0f, 0.0f };
+		return;
+	}
+
+	// scale the weights so they average 1. a slot under 1 is topped up by one over 1, which then gives up what it lent.
+	// doubles keep the leftovers from drifting over a few thousand slots
+	_small.clear();
+	_large.clear();
+	_scaled.resize(_count);
+	for (uint32_t i = 0; i < _count; ++i)
+	{
+		_scaled[i] = _weights[i] * static_cast<double>(_count) / _total;
+		if (_scaled[i] < 1.0)
+			_small.push_back(i);
+		else
+			_large.push_back(i);
+	}
+
+	while (!_small.empty() && !_large.empty())
+	{
+		uint32_t less = _small.back();
+		_small.pop_back();
+		uint32_t more = _large.back();
+
+		_entries[less].threshold = static_cast<float>(_scaled[less]);
+		_entries[less].alias = more;
+		_scaled[more] = (_scaled[more] + _scaled[less]) - 1.0;
+		if (_scaled[more] < 1.0)
+		{
+			_large.pop_back();
+			_small.push_back(more);
+		}
+	}
+
+	// whatever is left is 1 give or take rounding
+	for (uint32_t i : _large)
+		_entries[i] = { 1.0f, i, 0.0f, 0.0f };
+	for (uint32_t i : _small)
+		_entries[i] = { 1.0f, i, 0.0f, 0.0f };
+
+	for (uint32_t i = 0; i < _count; ++i)
+	{
+		_entries[i].pmf = static_cast<float>(_weights[i] / _total);
+		_entries[i].aliasPmf = static_cast<float>(_weights[_entries[i].alias] / _total);
+	}
+}
+
+void LightAliasTable::BuildBlock(uint32_t _block)
+{
+	uint32_t first = _block * LIGHT_ALIAS_BLOCK_SIZE;
+	uint32_t count = std::min(LightCount() - first, LIGHT_ALIAS_BLOCK_SIZE);
+	std::vector<uint32_t> small;
+	std::vector<uint32_t> large;
+	std::vector<double> scaled;
+	small.reserve(count);
+	large.reserve(count);
+	BuildTable(&m_power[first], count, m_blockPower[_block], &m_entries[BlockCount() + first], small, large, scaled);
+}
+
+void LightAliasTable::Build(const Light* _lights, uint32_t _count, JobSystem* _pJobSystem)
+{
+	// a different number of lights moves every block, so start again
+	bool rebuildAll = _count != LightCount();
+	uint32_t blockCount = (_count + LIGHT_ALIAS_BLOCK_SIZE - 1) / LIGHT_ALIAS_BLOCK_SIZE;
+	if (rebuildAll)
+	{
+		m_power.assign(_count, 0.0f);
+		m_blockPower.assign(blockCount, 0.0);
+		m_entries.resize(blockCount + _count);
+	}
+
+	// refresh the powers a block at a time and rebuild the blocks where one changed
+	std::vector<uint8_t> rebuilt(blockCount, 0);
+	auto blocks = [&](unsigned int _begin, unsigned int _end)
+	{
+		for (unsigned int block = _begin; block < _end; ++block)
+		{
+			uint32_t first = block * LIGHT_ALIAS_BLOCK_SIZE;
+			uint32_t last = std::min(first + LIGHT_ALIAS_BLOCK_SIZE, _count);
+			bool changed = rebuildAll;
+			double total = 0.0;
+			for (uint32_t i = first; i < last; ++i)
+			{
+				float power = std::max(LightPower(_lights[i]), 0.0f);
+				changed = changed || power != m_power[i];
+				m_power[i] = power;
+				total += power;
+			}
+			if (!changed)
+				continue;
+			m_blockPower[block] = total;
+			BuildBlock(block);
+			rebuilt[block] = 1;
+		}
+	};
+	if (_pJobSystem && blockCount > 1)
+		_pJobSystem->ParallelFor(blockCount, 1, blocks);
+	else
+		blocks(0, blockCount);
+
+	m_rebuiltBlocks = 0;
+	for (uint8_t blockRebuilt : rebuilt)
+		m_rebuiltBlocks += blockRebuilt;
+	if (m_rebuiltBlocks == 0)
+	{
+		return;
+	}
+
+	// the table over the blocks is a few hundred entries at most, so it is always rebuilt in one go
+	double total = 0.0;
+	for (double power : m_blockPower)
+		total += power;
+	std::vector<float> blockWeights(m_blockPower.begin(), m_blockPower.end());
+	std::vector<uint32_t> small;
+	std::vector<uint32_t> large;
+	std::vector<double> scaled;
+	BuildTable(blockWeights.data(), blockCount, total, m_entries.data(), small, large, scaled);
+}
+
+bool LightAliasTable::Sample(float _u0, float _u1, LightAliasSample& _sample)
+{
+	uint32_t blockCount = BlockCount();
+	if (blockCount == 0)
+		return false;
+
+	float blockPmf;
+	uint32_t block = PickSlot(m_entries.data(), blockCount, std::min(_u0, ONE_MINUS_EPSILON), blockPmf);
+	if (blockPmf <= 0.0f)
+		return false;
+
+	uint32_t first = block * LIGHT_ALIAS_BLOCK_SIZE;
+	uint32_t count = std::min(LightCount() - first, LIGHT_ALIAS_BLOCK_SIZE);
+	float lightPmf;
+	uint32_t light = PickSlot(&m_entries[blockCount + first], count, std::min(_u1, ONE_MINUS_EPSILON), lightPmf);
+
+	_sample.light = first + light;
+	_sample.pmf = blockPmf * lightPmf;
+	return true;
+}
+
+float LightAliasTable::Pmf(uint32_t _light)
+{
+	uint32_t block = _light / LIGHT_ALIAS_BLOCK_SIZE;
+	return m_entries[block].pmf * m_entries[BlockCount() + _light].pmf;
+}
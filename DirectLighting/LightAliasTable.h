@@ -0,0 +1,66 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "LightClusters.h"
+
+class JobSystem;
+
+// has to match LIGHT_ALIAS_BLOCK_SIZE in LightAliasTable.hlsli
+const uint32_t LIGHT_ALIAS_BLOCK_SIZE = 4096;
+
+// one slot of an alias table, 16 bytes so the table can go straight into a structured buffer (LightAliasEntry in
+// LightAliasTable.hlsli). a slot keeps its own item when the random fraction is below threshold, otherwise it gives
+// alias. both pmfs are in the slot so picking an item never needs a second read
+struct LightAliasEntry
+{
+	float threshold;
+	uint32_t alias;
+	float pmf; // of the slot's own item, within its table
+	float aliasPmf;
+};
+
+struct LightAliasSample
+{
+	uint32_t light;
+	float pmf;
+};
+
+// picks lights in proportion to their power in constant time, whatever the number of lights, with vose's alias method.
+//
+// the lights are split into blocks of LIGHT_ALIAS_BLOCK_SIZE, each with an alias table of its own, and a small table
+// over the blocks picks one by its total power. the blocks are built in parallel, and a Build with the same number of
+// lights only rebuilds the blocks where a light's power changed, then the table over the blocks. a light's pmf is its
+// block's pmf times its pmf within the block.
+//
+// Entries() is the layout the shader reads: the block table first, then every block's table in light order.
+// LightAliasTable.hlsli samples it with the same float operations as Sample, so both pick the same light for the same
+// random numbers
+class LightAliasTable
+{
+public:
+	LightAliasTable() = default;
+	~LightAliasTable() = default;
+
+	void Build(const Light* _lights, uint32_t _count, JobSystem* _pJobSystem = nullptr);
+
+	// _u0 picks the block and _u1 the light in it, both uniform in [0, 1). returns false if no light gives off any light
+	bool Sample(float _u0, float _u1, LightAliasSample& _sample);
+	float Pmf(uint32_t _light);
+
+	uint32_t LightCount() { return static_cast<uint32_t>(m_power.size()); }
+	uint32_t BlockCount() { return static_cast<uint32_t>(m_blockPower.size()); }
+	uint32_t RebuiltBlocks() { return m_rebuiltBlocks; } // by the last Build
+	const std::vector<LightAliasEntry>& Entries() { return m_entries; }
+
+private:
+	void BuildBlock(uint32_t _block);
+
+	// vose's method over _count weights summing to _total, written to _entries
+	static void BuildTable(const float* _weights, uint32_t _count, double _total, LightAliasEntry* _entries, std::vector<uint32_t>& _small, std::vector<uint32_t>& _large, std::vector<double>& _scaled);
+
+	std::vector<float> m_power; // per light, as of the last Build
+	std::vector<double> m_blockPower; // summed in light order
+	std::vector<LightAliasEntry> m_entries;
+	uint32_t m_rebuiltBlocks = 0;
+};
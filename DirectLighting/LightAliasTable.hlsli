@@ -0,0 +1,52 @@
+// picking a light in proportion to its power from a LightAliasTable's Entries(). the same operations as
+// LightAliasTable::Sample, marked precise so the shader and the cpu pick the same light for the same random numbers
+
+#define LIGHT_ALIAS_BLOCK_SIZE 4096 // LIGHT_ALIAS_BLOCK_SIZE in LightAliasTable.h
+#define LIGHT_ALIAS_ONE_MINUS_EPSILON 0.99999994f
+
+// LightAliasEntry in LightAliasTable.h
+struct LightAliasEntry
+{
+	float threshold;
+	uint alias;
+	float pmf;
+	float aliasPmf;
+};
+
+uint LightAliasPickSlot(StructuredBuffer<LightAliasEntry> entries, uint first, uint count, float u, out float pmf)
+{
+	precise float scaled = u * (float)count;
+	uint slot = min((uint)scaled, count - 1);
+	precise float fraction = scaled - (float)slot;
+	LightAliasEntry entry = entries[first + slot];
+	if (fraction < entry.threshold)
+	{
+		pmf = entry.pmf;
+		return slot;
+	}
+	pmf = entry.aliasPmf;
+	return entry.alias;
+}
+
+// u.x picks the block and u.y the light in it. returns false if no light gives off any light
+bool SampleLightAliasTable(StructuredBuffer<LightAliasEntry> entries, uint lightCount, float2 u, out uint light, out float pmf)
+{
+	light = 0;
+	pmf = 0.0f;
+	uint blockCount = (lightCount + LIGHT_ALIAS_BLOCK_SIZE - 1) / LIGHT_ALIAS_BLOCK_SIZE;
+	if (blockCount == 0)
+		return false;
+
+	float blockPmf;
+	uint block = LightAliasPickSlot(entries, 0, blockCount, min(u.x, LIGHT_ALIAS_ONE_MINUS_EPSILON), blockPmf);
+	if (blockPmf <= 0.0f)
+		return false;
+
+	uint first = block * LIGHT_ALIAS_BLOCK_SIZE;
+	uint count = min(lightCount - first, LIGHT_ALIAS_BLOCK_SIZE);
+	float lightPmf;
+	light = first + LightAliasPickSlot(entries, blockCount + first, count, min(u.y, LIGHT_ALIAS_ONE_MINUS_EPSILON), lightPmf);
+	precise float product = blockPmf * lightPmf;
+	pmf = product;
+	return true;
+}
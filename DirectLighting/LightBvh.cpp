@@ -0,0 +1,564 @@
+#include "LightBvh.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#include "JobSystem.h"
+
+using namespace DirectX;
+
+namespace
+{
+	const float PI = 3.14159265f;
+	const float ONE_MINUS_EPSILON = 0.99999994f; // the largest float below 1
+	const float MIN_DISTANCE_SQ = 1e-4f; // keeps the importance finite for a point sitting on a light
+
+	const uint32_t BIN_COUNT = 12;
+	const uint32_t BIN_BLOCK_SIZE = 8192;
+	const uint32_t PARALLEL_BIN_LIGHTS = 2 * BIN_BLOCK_SIZE; // nodes with at least this many lights bin them in parallel
+	const uint32_t PARALLEL_BUILD_LIGHTS = 4096; // and nodes with at least this many build their two children in parallel
+	const uint32_t MIN_LIGHTS_PER_BLOCK = 1024;
+	const uint32_t REFIT_SUBTREES = 64; // roughly how many pieces the refit is split into
+
+	float SafeAcos(float _value)
+	{
+		return std::acos(std::min(std::max(_value, -1.0f), 1.0f));
+	}
+
+	float SafeSqrt(float _value)
+	{
+		return std::sqrt(std::max(_value, 0.0f));
+	}
+
+	// cos and sin of the angle a - b, clamped to 0 when b is larger. both angles are in [0, pi]
+	float CosSubClamped(float _sinA, float _cosA, float _sinB, float _cosB)
+	{
+		if (_cosA > _cosB)
+			return 1.0f;
+		return _cosA * _cosB + _sinA * _sinB;
+	}
+
+	float SinSubClamped(float _sinA, float _cosA, float _sinB, float _cosB)
+	{
+		if (_cosA > _cosB)
+			return 0.0f;
+		return _sinA * _cosB - _cosA * _sinB;
+	}
+
+	LightBvhNode EmptyBounds()
+	{
+		LightBvhNode bounds = {};
+		bounds.boundsMin = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+		bounds.boundsMax = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		bounds.cosThetaO = 1.0f;
+		bounds.cosThetaE = 1.0f;
+		return bounds;
+	}
+
+	LightBvhNode LightBounds(const Light& _light, uint32_t _index)
+	{
+		LightBvhNode bounds = {};
+		bounds.boundsMin = _light.position;
+		bounds.boundsMax = _light.position;
+		bounds.range = _light.range;
+		bounds.secondChild = _index;
+		bounds.lightCount = 1;
+
+		bounds.power = LightPower(_light);
+
+		// a point light shines in every direction, a spot light only inside its cone and with a hard edge
+		if (_light.type == LIGHT_SPOT)
+		{
+			bounds.axis = _light.direction;
+			bounds.cosThetaO = _light.cosOuterAngle;
+			bounds.cosThetaE = 1.0f;
+		}
+		else
+		{
+			bounds.axis = XMFLOAT3(0.0f, 0.0f, 1.0f);
+			bounds.cosThetaO = -1.0f;
+			bounds.cosThetaE = 0.0f;
+		}
+		return bounds;
+	}
+
+	// the smallest cone around two cones, widened to the whole sphere if they point too far apart
+	void MergeCones(XMFLOAT3& _axis, float& _cosTheta, const XMFLOAT3& _otherAxis, float _otherCosTheta)
+	{
+		// point lights shine everywhere, so most cones end up as the whole sphere. no need for any trigonometry then
+		if (_cosTheta <= -1.0f)
+			return;
+		if (_otherCosTheta <= -1.0f)
+		{
+			_cosTheta = -1.0f;
+			return;
+		}
+
+		XMVECTOR axisA = XMLoadFloat3(&_axis);
+		XMVECTOR axisB = XMLoadFloat3(&_otherAxis);
+		float thetaA = SafeAcos(_cosTheta);
+		float thetaB = SafeAcos(_otherCosTheta);
+		float thetaD = SafeAcos(XMVectorGetX(XMVector3Dot(axisA, axisB)));
+		if (std::min(thetaD + thetaB, PI) <= thetaA)
+			return;
+		if (std::min(thetaD + thetaA, PI) <= thetaB)
+		{
+			_axis = _otherAxis;
+			_cosTheta = _otherCosTheta;
+			return;
+		}
+
+		float thetaO = 0.5f * (thetaA + thetaD + thetaB);
+		XMVECTOR rotationAxis = XMVector3Cross(axisA, axisB);
+		float rotationLength = XMVectorGetX(XMVector3Length(rotationAxis));
+		if (thetaO >= PI || rotationLength < 1e-6f)
+		{
+			_cosTheta = -1.0f;
+			return;
+		}
+
+		// turn a's axis towards b's until the cone just reaches both. the axis is perpendicular to the one it turns
+		// around, so the rotation is just the first two terms of rodrigues' formula
+		float thetaR = thetaO - thetaA;
+		rotationAxis = XMVectorScale(rotationAxis, 1.0f / rotationLength);
+		XMVECTOR axis = XMVectorAdd(XMVectorScale(axisA, std::cos(thetaR)), XMVectorScale(XMVector3Cross(rotationAxis, axisA), std::sin(thetaR)));
+		XMStoreFloat3(&_axis, XMVector3Normalize(axis));
+		_cosTheta = std::cos(thetaO);
+	}
+
+	// grows _bounds to cover _other. lightCount is used to tell empty bounds apart
+	void MergeBounds(LightBvhNode& _bounds, const LightBvhNode& _other)
+	{
+		if (_other.lightCount == 0)
+			return;
+		if (_bounds.lightCount == 0)
+		{
+			_bounds = _other;
+			return;
+		}
+
+		XMStoreFloat3(&_bounds.boundsMin, XMVectorMin(XMLoadFloat3(&_bounds.boundsMin), XMLoadFloat3(&_other.boundsMin)));
+		XMStoreFloat3(&_bounds.boundsMax, XMVectorMax(XMLoadFloat3(&_bounds.boundsMax), XMLoadFloat3(&_other.boundsMax)));
+		_bounds.power += _other.power;
+		MergeCones(_bounds.axis, _bounds.cosThetaO, _other.axis, _other.cosThetaO);
+		_bounds.cosThetaE = std::min(_bounds.cosThetaE, _other.cosThetaE);
+		_bounds.range = std::max(_bounds.range, _other.range);
+		_bounds.lightCount += _other.lightCount;
+	}
+
+	// the surface area orientation heuristic: power, times how much of the sphere the lights can shine into, times the
+	// area of the box. _kr favours splitting across the box's long side
+	float SplitCost(const LightBvhNode& _bounds, float _kr)
+	{
+		// the whole sphere comes out as 4 pi, which is most nodes
+		float orientation = 4.0f * PI;
+		if (_bounds.cosThetaO > -1.0f)
+		{
+			float thetaO = SafeAcos(_bounds.cosThetaO);
+			float thetaE = SafeAcos(_bounds.cosThetaE);
+			float thetaW = std::min(thetaO + thetaE, PI);
+			float sinThetaO = SafeSqrt(1.0f - _bounds.cosThetaO * _bounds.cosThetaO);
+			orientation = 2.0f * PI * (1.0f - _bounds.cosThetaO) +
+				0.5f * PI * (2.0f * thetaW * sinThetaO - std::cos(thetaO - 2.0f * thetaW) - 2.0f * thetaO * sinThetaO + _bounds.cosThetaO);
+		}
+
+		float dx = _bounds.boundsMax.x - _bounds.boundsMin.x;
+		float dy = _bounds.boundsMax.y - _bounds.boundsMin.y;
+		float dz = _bounds.boundsMax.z - _bounds.boundsMin.z;
+		float area = 2.0f * (dx * dy + dy * dz + dz * dx);
+		return _bounds.power * orientation * _kr * area;
+	}
+
+	struct Bins
+	{
+		LightBvhNode bins[3][BIN_COUNT];
+	};
+}
+
+void LightBvh::Build(const Light* _lights, uint32_t _count, JobSystem* _pJobSystem)
+{
+	m_nodes.clear();
+	m_parents.clear();
+	m_lightLeaves.clear();
+	m_refitRoots.clear();
+	m_refitTop.clear();
+	if (_count == 0)
+	{
+		return;
+	}
+
+	m_nodes.resize(2 * _count - 1);
+	m_parents.resize(2 * _count - 1);
+	m_lightLeaves.resize(_count);
+	m_primitives.resize(_count);
+	m_order.resize(_count);
+
+	auto prepare = [&](unsigned int _begin, unsigned int _end)
+	{
+		for (unsigned int i = _begin; i < _end; ++i)
+		{
+			m_primitives[i] = LightBounds(_lights[i], i);
+			m_order[i] = i;
+		}
+	};
+	if (_pJobSystem && _count >= 2 * MIN_LIGHTS_PER_BLOCK)
+		_pJobSystem->ParallelFor(_count, MIN_LIGHTS_PER_BLOCK, prepare);
+	else
+		prepare(0, _count);
+
+	BuildNode(0, 0, _count, UINT32_MAX, _pJobSystem);
+	CollectRefitRoots(0, std::max(_count / REFIT_SUBTREES, MIN_LIGHTS_PER_BLOCK));
+}
+
+void LightBvh::BuildNode(uint32_t _node, uint32_t _begin, uint32_t _end, uint32_t _parent, JobSystem* _pJobSystem)
+{
+	m_parents[_node] = _parent;
+	if (_end - _begin == 1)
+	{
+		uint32_t light = m_order[_begin];
+		m_nodes[_node] = m_primitives[light];
+		m_lightLeaves[light] = _node;
+		return;
+	}
+
+	// the first child's subtree takes up the 2m - 1 nodes after this one, m being the lights that went into it
+	uint32_t middle = Split(_begin, _end, _pJobSystem);
+	uint32_t firstChild = _node + 1;
+	uint32_t secondChild = _node + 2 * (middle - _begin);
+	if (_pJobSystem && _end - _begin >= PARALLEL_BUILD_LIGHTS)
+	{
+		_pJobSystem->ParallelFor(2, 1, [&](unsigned int _first, unsigned int _last)
+		{
+			for (unsigned int child = _first; child < _last; ++child)
+			{
+				if (child == 0)
+					BuildNode(firstChild, _begin, middle, _node, _pJobSystem);
+				else
+					BuildNode(secondChild, middle, _end, _node, _pJobSystem);
+			}
+		});
+	}
+	else
+	{
+		BuildNode(firstChild, _begin, middle, _node, _pJobSystem);
+		BuildNode(secondChild, middle, _end, _node, _pJobSystem);
+	}
+	m_nodes[_node].secondChild = secondChild;
+	m_nodes[_node].lightCount = _end - _begin;
+	RefitNode(_node);
+}
+
+uint32_t LightBvh::Split(uint32_t _begin, uint32_t _end, JobSystem* _pJobSystem)
+{
+	uint32_t count = _end - _begin;
+	uint32_t blockCount = (count + BIN_BLOCK_SIZE - 1) / BIN_BLOCK_SIZE;
+	bool parallel = _pJobSystem && count >= PARALLEL_BIN_LIGHTS;
+
+	// the lights are points, so the box around them is also the box around their centroids. every block works out its
+	// own, then they are merged in order so the result does not depend on the threads
+	std::vector<XMFLOAT3> blockMin(blockCount);
+	std::vector<XMFLOAT3> blockMax(blockCount);
+	auto bound = [&](unsigned int _first, unsigned int _last)
+	{
+		for (unsigned int block = _first; block < _last; ++block)
+		{
+			uint32_t end = std::min(_begin + (block + 1) * BIN_BLOCK_SIZE, _end);
+			XMVECTOR minimum = XMVectorReplicate(FLT_MAX);
+			XMVECTOR maximum = XMVectorReplicate(-FLT_MAX);
+			for (uint32_t i = _begin + block * BIN_BLOCK_SIZE; i < end; ++i)
+			{
+				XMVECTOR position = XMLoadFloat3(&m_primitives[m_order[i]].boundsMin);
+				minimum = XMVectorMin(minimum, position);
+				maximum = XMVectorMax(maximum, position);
+			}
+			XMStoreFloat3(&blockMin[block], minimum);
+			XMStoreFloat3(&blockMax[block], maximum);
+		}
+	};
+	if (parallel)
+		_pJobSystem->ParallelFor(blockCount, 1, bound);
+	else
+		bound(0, blockCount);
+
+	XMVECTOR minimum = XMLoadFloat3(&blockMin[0]);
+	XMVECTOR maximum = XMLoadFloat3(&blockMax[0]);
+	for (uint32_t block = 1; block < blockCount; ++block)
+	{
+		minimum = XMVectorMin(minimum, XMLoadFloat3(&blockMin[block]));
+		maximum = XMVectorMax(maximum, XMLoadFloat3(&blockMax[block]));
+	}
+	XMFLOAT3 boundsMin, extent;
+	XMStoreFloat3(&boundsMin, minimum);
+	XMStoreFloat3(&extent, XMVectorSubtract(maximum, minimum));
+	const float origin[3] = { boundsMin.x, boundsMin.y, boundsMin.z };
+	const float size[3] = { extent.x, extent.y, extent.z };
+	float maxSize = std::max(size[0], std::max(size[1], size[2]));
+	if (maxSize <= 0.0f)
+	{
+		// every light is in the same place, any split is as good as another
+		return _begin + count / 2;
+	}
+
+	float binScale[3];
+	for (uint32_t axis = 0; axis < 3; ++axis)
+		binScale[axis] = size[axis] > 0.0f ? BIN_COUNT / size[axis] : 0.0f;
+	auto binIndex = [&](const XMFLOAT3& _position, uint32_t _axis)
+	{
+		const float coordinates[3] = { _position.x, _position.y, _position.z };
+		uint32_t bin = static_cast<uint32_t>((coordinates[_axis] - origin[_axis]) * binScale[_axis]);
+		return std::min(bin, BIN_COUNT - 1);
+	};
+
+	std::vector<Bins> blockBins(blockCount);
+	auto bin = [&](unsigned int _first, unsigned int _last)
+	{
+		for (unsigned int block = _first; block < _last; ++block)
+		{
+			Bins& bins = blockBins[block];
+			for (uint32_t axis = 0; axis < 3; ++axis)
+				for (uint32_t b = 0; b < BIN_COUNT; ++b)
+					bins.bins[axis][b] = EmptyBounds();
+
+			uint32_t end = std::min(_begin + (block + 1) * BIN_BLOCK_SIZE, _end);
+			for (uint32_t i = _begin + block * BIN_BLOCK_SIZE; i < end; ++i)
+			{
+				const LightBvhNode& primitive = m_primitives[m_order[i]];
+				for (uint32_t axis = 0; axis < 3; ++axis)
+				{
+					if (size[axis] > 0.0f)
+						MergeBounds(bins.bins[axis][binIndex(primitive.boundsMin, axis)], primitive);
+				}
+			}
+		}
+	};
+	if (parallel)
+		_pJobSystem->ParallelFor(blockCount, 1, bin);
+	else
+		bin(0, blockCount);
+
+	Bins& bins = blockBins[0];
+	for (uint32_t block = 1; block < blockCount; ++block)
+		for (uint32_t axis = 0; axis < 3; ++axis)
+			for (uint32_t b = 0; b < BIN_COUNT; ++b)
+				MergeBounds(bins.bins[axis][b], blockBins[block].bins[axis][b]);
+
+	// cost of splitting after every bin, from the bounds of everything below it and everything above it
+	float bestCost = FLT_MAX;
+	uint32_t bestAxis = 0;
+	uint32_t bestBin = BIN_COUNT;
+	for (uint32_t axis = 0; axis < 3; ++axis)
+	{
+		if (size[axis] <= 0.0f)
+			continue;
+		float kr = maxSize / size[axis];
+
+		LightBvhNode above[BIN_COUNT];
+		above[BIN_COUNT - 1] = bins.bins[axis][BIN_COUNT - 1];
+		for (uint32_t b = BIN_COUNT - 1; b > 0; --b)
+		{
+			above[b - 1] = above[b];
+			MergeBounds(above[b - 1], bins.bins[axis][b - 1]);
+		}
+
+		LightBvhNode below = EmptyBounds();
+		for (uint32_t b = 0; b + 1 < BIN_COUNT; ++b)
+		{
+			MergeBounds(below, bins.bins[axis][b]);
+			if (below.lightCount == 0 || above[b + 1].lightCount == 0)
+				continue;
+			float cost = SplitCost(below, kr) + SplitCost(above[b + 1], kr);
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestBin = b;
+			}
+		}
+	}
+	if (bestBin == BIN_COUNT)
+	{
+		return _begin + count / 2;
+	}
+
+	uint32_t* pMiddle = std::partition(&m_order[0] + _begin, &m_order[0] + _end, [&](uint32_t _light)
+	{
+		return binIndex(m_primitives[_light].boundsMin, bestAxis) <= bestBin;
+	});
+	return static_cast<uint32_t>(pMiddle - &m_order[0]);
+}
+
+void LightBvh::RefitNode(uint32_t _node)
+{
+	// the same order as the build, first child then second, so a refit of lights that did not move changes nothing
+	LightBvhNode& node = m_nodes[_node];
+	uint32_t secondChild = node.secondChild;
+	if (node.lightCount == 1)
+		return;
+	node = m_nodes[_node + 1];
+	MergeBounds(node, m_nodes[secondChild]);
+	node.secondChild = secondChild;
+}
+
+void LightBvh::CollectRefitRoots(uint32_t _node, uint32_t _maxLights)
+{
+	const LightBvhNode& node = m_nodes[_node];
+	if (node.lightCount <= _maxLights)
+	{
+		m_refitRoots.push_back(_node);
+		return;
+	}
+	m_refitTop.push_back(_node);
+	CollectRefitRoots(_node + 1, _maxLights);
+	CollectRefitRoots(node.secondChild, _maxLights);
+}
+
+void LightBvh::Refit(const Light* _lights, JobSystem* _pJobSystem)
+{
+	uint32_t count = LightCount();
+	if (count == 0)
+	{
+		return;
+	}
+
+	auto leaves = [&](unsigned int _begin, unsigned int _end)
+	{
+		for (unsigned int i = _begin; i < _end; ++i)
+			m_nodes[m_lightLeaves[i]] = LightBounds(_lights[i], i);
+	};
+	if (_pJobSystem && count >= 2 * MIN_LIGHTS_PER_BLOCK)
+		_pJobSystem->ParallelFor(count, MIN_LIGHTS_PER_BLOCK, leaves);
+	else
+		leaves(0, count);
+
+	// children always come after their parent, so going backwards over a subtree's nodes refits it bottom up
+	auto subtrees = [&](unsigned int _begin, unsigned int _end)
+	{
+		for (unsigned int i = _begin; i < _end; ++i)
+		{
+			uint32_t root = m_refitRoots[i];
+			uint32_t last = root + 2 * m_nodes[root].lightCount - 2;
+			for (uint32_t node = last + 1; node-- > root;)
+				RefitNode(node);
+		}
+	};
+	uint32_t subtreeCount = static_cast<uint32_t>(m_refitRoots.size());
+	if (_pJobSystem && subtreeCount > 1)
+		_pJobSystem->ParallelFor(subtreeCount, 1, subtrees);
+	else
+		subtrees(0, subtreeCount);
+
+	for (size_t i = m_refitTop.size(); i-- > 0;)
+		RefitNode(m_refitTop[i]);
+}
+
+float LightBvh::Importance(const LightBvhNode& _node, const XMFLOAT3& _position, const XMFLOAT3& _normal)
+{
+	XMVECTOR position = XMLoadFloat3(&_position);
+	XMVECTOR boundsMin = XMLoadFloat3(&_node.boundsMin);
+	XMVECTOR boundsMax = XMLoadFloat3(&_node.boundsMax);
+
+	// out of range of every light under the node
+	XMVECTOR outside = XMVectorMax(XMVectorMax(XMVectorSubtract(boundsMin, position), XMVectorSubtract(position, boundsMax)), XMVectorZero());
+	if (XMVectorGetX(XMVector3LengthSq(outside)) > _node.range * _node.range)
+		return 0.0f;
+
+	// distance and direction from the middle of the box. inside the box a light could be anywhere, so the distance is
+	// never taken to be less than the box's size
+	XMVECTOR center = XMVectorScale(XMVectorAdd(boundsMin, boundsMax), 0.5f);
+	float radiusSq = 0.25f * XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(boundsMax, boundsMin)));
+	XMVECTOR toPoint = XMVectorSubtract(position, center);
+	float distanceSq = XMVectorGetX(XMVector3LengthSq(toPoint));
+	float clampedDistanceSq = std::max(distanceSq, std::max(radiusSq, MIN_DISTANCE_SQ));
+	XMVECTOR direction = distanceSq > 0.0f ? XMVectorScale(toPoint, 1.0f / std::sqrt(distanceSq)) : XMLoadFloat3(&_node.axis);
+
+	// theta b is the angle the box's bounding sphere covers seen from the point, anything in the box is at most
+	// that far off the direction to its middle
+	float cosThetaB = distanceSq > radiusSq ? SafeSqrt(1.0f - radiusSq / distanceSq) : -1.0f;
+	float sinThetaB = SafeSqrt(1.0f - cosThetaB * cosThetaB);
+
+	// the smallest angle between the point and any direction the lights emit in: the angle to the axis, less the
+	// cone's width, less the box's size
+	float cosThetaW = XMVectorGetX(XMVector3Dot(XMLoadFloat3(&_node.axis), direction));
+	float sinThetaW = SafeSqrt(1.0f - cosThetaW * cosThetaW);
+	float sinThetaO = SafeSqrt(1.0f - _node.cosThetaO * _node.cosThetaO);
+	float cosThetaX = CosSubClamped(sinThetaW, cosThetaW, sinThetaO, _node.cosThetaO);
+	float sinThetaX = SinSubClamped(sinThetaW, cosThetaW, sinThetaO, _node.cosThetaO);
+	float cosThetaP = CosSubClamped(sinThetaX, cosThetaX, sinThetaB, cosThetaB);
+	if (cosThetaP < _node.cosThetaE)
+		return 0.0f;
+
+	float importance = _node.power * cosThetaP / clampedDistanceSq;
+
+	// the surface only gets light from above it. the same widening by the box's size applies
+	XMVECTOR normal = XMLoadFloat3(&_normal);
+	if (XMVectorGetX(XMVector3LengthSq(normal)) > 0.0f)
+	{
+		float cosThetaI = -XMVectorGetX(XMVector3Dot(direction, normal));
+		float sinThetaI = SafeSqrt(1.0f - cosThetaI * cosThetaI);
+		importance *= std::max(CosSubClamped(sinThetaI, cosThetaI, sinThetaB, cosThetaB), 0.0f);
+	}
+	return std::max(importance, 0.0f);
+}
+
+bool LightBvh::Sample(const XMFLOAT3& _position, const XMFLOAT3& _normal, float _u, LightBvhSample& _sample)
+{
+	if (m_nodes.empty() || Importance(m_nodes[0], _position, _normal) <= 0.0f)
+		return false;
+
+	uint32_t node = 0;
+	float pmf = 1.0f;
+	while (m_nodes[node].lightCount > 1)
+	{
+		// pick a child in proportion to its importance, then stretch the part of _u that picked it back over [0, 1)
+		uint32_t firstChild = node + 1;
+		uint32_t secondChild = m_nodes[node].secondChild;
+		float firstImportance = Importance(m_nodes[firstChild], _position, _normal);
+		float secondImportance = Importance(m_nodes[secondChild], _position, _normal);
+		if (firstImportance <= 0.0f && secondImportance <= 0.0f)
+			return false;
+
+		float firstProbability = firstImportance / (firstImportance + secondImportance);
+		if (_u < firstProbability)
+		{
+			node = firstChild;
+			pmf *= firstProbability;
+			_u = std::min(_u / firstProbability, ONE_MINUS_EPSILON);
+		}
+		else
+		{
+			node = secondChild;
+			pmf *= 1.0f - firstProbability;
+			_u = std::min((_u - firstProbability) / (1.0f - firstProbability), ONE_MINUS_EPSILON);
+		}
+	}
+
+	_sample.light = m_nodes[node].secondChild;
+	_sample.pmf = pmf;
+	return true;
+}
+
+float LightBvh::Pmf(const XMFLOAT3& _position, const XMFLOAT3& _normal, uint32_t _light)
+{
+	if (m_nodes.empty() || Importance(m_nodes[0], _position, _normal) <= 0.0f)
+		return 0.0f;
+
+	// walk up from the light's leaf, working out each choice the same way Sample does
+	float pmf = 1.0f;
+	uint32_t node = m_lightLeaves[_light];
+	while (node != 0)
+	{
+		uint32_t parent = m_parents[node];
+		uint32_t firstChild = parent + 1;
+		uint32_t secondChild = m_nodes[parent].secondChild;
+		float firstImportance = Importance(m_nodes[firstChild], _position, _normal);
+		float secondImportance = Importance(m_nodes[secondChild], _position, _normal);
+		if (firstImportance <= 0.0f && secondImportance <= 0.0f)
+			return 0.0f;
+
+		float firstProbability = firstImportance / (firstImportance + secondImportance);
+		pmf *= node == firstChild ? firstProbability : 1.0f - firstProbability;
+		node = parent;
+	}
+	return pmf;
+}
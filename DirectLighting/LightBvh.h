@@ -0,0 +1,85 @@
+#pragma once
+#include <DirectXMath.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "LightClusters.h"
+
+class JobSystem;
+
+// one node of a LightBvh, 64 bytes so the array can go straight into a structured buffer (LightBvhNode in LightBvh.hlsli).
+// nodes are stored depth first and every leaf holds exactly one light, so an interior node's first child is always the
+// node right after it and a subtree of n lights is 2n - 1 nodes in a row
+struct LightBvhNode
+{
+	DirectX::XMFLOAT3 boundsMin; // box around the positions of the lights under the node
+	float power; // their summed power
+	DirectX::XMFLOAT3 boundsMax;
+	uint32_t secondChild; // interior nodes: index of the second child. leaves: index of the light
+	DirectX::XMFLOAT3 axis; // every light under the node emits within the angle cosThetaO of this direction
+	float cosThetaO;
+	float cosThetaE; // and nothing further than cosThetaE outside of that
+	float range; // the longest range under the node, a point further than this from the box is not lit at all
+	uint32_t lightCount; // 1 for a leaf
+	uint32_t pad;
+};
+
+struct LightBvhSample
+{
+	uint32_t light;
+	float pmf; // probability of picking this light for the point it was sampled for
+};
+
+// a bounding volume hierarchy over the lights for many light importance sampling. instead of looping over every light,
+// a pixel walks from the root to a single light, at each node picking a child with a probability proportional to an
+// estimate of how much light it gets from it: the child's power over the distance squared, reduced by how far the point
+// is outside of the cone the child's lights emit in and by the angle to the surface normal. dividing the light's
+// contribution by the pmf keeps the result unbiased, and the noise goes down as the estimate gets better.
+//
+// the tree is built with the surface area orientation heuristic over binned light positions, and the two halves of
+// every large node are built in parallel. node indices only depend on how many lights go each way, so the result is
+// the same however many threads ran. moving lights only need a Refit, which keeps the tree and recomputes the bounds
+class LightBvh
+{
+public:
+	LightBvh() = default;
+	~LightBvh() = default;
+
+	void Build(const Light* _lights, uint32_t _count, JobSystem* _pJobSystem = nullptr);
+
+	// recomputes every node's bounds for lights that have moved or changed. _lights must be the same number of lights
+	// in the same order as the last Build, build again when lights are added or removed
+	void Refit(const Light* _lights, JobSystem* _pJobSystem = nullptr);
+
+	// picks a light for a point with the normal _normal, or a zero normal for a point in a volume. _u is uniform in [0, 1).
+	// returns false if no light can reach the point
+	bool Sample(const DirectX::XMFLOAT3& _position, const DirectX::XMFLOAT3& _normal, float _u, LightBvhSample& _sample);
+
+	// the probability Sample gives to picking _light at this point, to within rounding
+	float Pmf(const DirectX::XMFLOAT3& _position, const DirectX::XMFLOAT3& _normal, uint32_t _light);
+
+	// the estimate the sampling is proportional to, 0 when nothing under the node can light the point
+	static float Importance(const LightBvhNode& _node, const DirectX::XMFLOAT3& _position, const DirectX::XMFLOAT3& _normal);
+
+	uint32_t LightCount() { return static_cast<uint32_t>(m_lightLeaves.size()); }
+	const std::vector<LightBvhNode>& Nodes() { return m_nodes; }
+
+private:
+	void BuildNode(uint32_t _node, uint32_t _begin, uint32_t _end, uint32_t _parent, JobSystem* _pJobSystem);
+	uint32_t Split(uint32_t _begin, uint32_t _end, JobSystem* _pJobSystem);
+	void CollectRefitRoots(uint32_t _node, uint32_t _maxLights);
+	void RefitNode(uint32_t _node);
+
+	std::vector<LightBvhNode> m_nodes;
+	std::vector<uint32_t> m_parents; // per node, the root's parent is UINT32_MAX
+	std::vector<uint32_t> m_lightLeaves; // per light, the leaf it ended up in
+
+	// build only
+	std::vector<LightBvhNode> m_primitives; // a single light's bounds, indexed by light
+	std::vector<uint32_t> m_order; // light indices, partitioned in place as the tree is built
+
+	// the refit does the subtrees under m_refitRoots in parallel, then the few nodes above them
+	std::vector<uint32_t> m_refitRoots;
+	std::vector<uint32_t> m_refitTop; // depth first, so parents come before their children
+};
@@ -0,0 +1,114 @@
+// picking one light out of a LightBvh in a shader. the same walk as LightBvh::Sample, see LightBvh.h for how it works.
+// bind the nodes as a StructuredBuffer<LightBvhNode> and call SampleLightBvh with one uniform random number per sample
+
+#define LIGHT_BVH_MIN_DISTANCE_SQ 1e-4f
+#define LIGHT_BVH_ONE_MINUS_EPSILON 0.99999994f
+
+// LightBvhNode in LightBvh.h
+struct LightBvhNode
+{
+	float3 boundsMin;
+	float power;
+	float3 boundsMax;
+	uint secondChild; // the light's index in a leaf
+	float3 axis;
+	float cosThetaO;
+	float cosThetaE;
+	float range;
+	uint lightCount;
+	uint pad;
+};
+
+// cos and sin of a - b, clamped to 0 when b is larger
+float LightBvhCosSubClamped(float sinA, float cosA, float sinB, float cosB)
+{
+	return cosA > cosB ? 1.0f : cosA * cosB + sinA * sinB;
+}
+
+float LightBvhSinSubClamped(float sinA, float cosA, float sinB, float cosB)
+{
+	return cosA > cosB ? 0.0f : sinA * cosB - cosA * sinB;
+}
+
+// LightBvh::Importance. a zero normal is a point in a volume
+float LightBvhImportance(LightBvhNode node, float3 position, float3 normal)
+{
+	float3 outside = max(max(node.boundsMin - position, position - node.boundsMax), 0.0f);
+	if (dot(outside, outside) > node.range * node.range)
+		return 0.0f;
+
+	float3 center = 0.5f * (node.boundsMin + node.boundsMax);
+	float3 diagonal = node.boundsMax - node.boundsMin;
+	float radiusSq = 0.25f * dot(diagonal, diagonal);
+	float3 toPoint = position - center;
+	float distanceSq = dot(toPoint, toPoint);
+	float clampedDistanceSq = max(distanceSq, max(radiusSq, LIGHT_BVH_MIN_DISTANCE_SQ));
+	float3 direction = distanceSq > 0.0f ? toPoint * rsqrt(distanceSq) : node.axis;
+
+	float cosThetaB = distanceSq > radiusSq ? sqrt(max(1.0f - radiusSq / distanceSq, 0.0f)) : -1.0f;
+	float sinThetaB = sqrt(max(1.0f - cosThetaB * cosThetaB, 0.0f));
+
+	float cosThetaW = dot(node.axis, direction);
+	float sinThetaW = sqrt(max(1.0f - cosThetaW * cosThetaW, 0.0f));
+	float sinThetaO = sqrt(max(1.0f - node.cosThetaO * node.cosThetaO, 0.0f));
+	float cosThetaX = LightBvhCosSubClamped(sinThetaW, cosThetaW, sinThetaO, node.cosThetaO);
+	float sinThetaX = LightBvhSinSubClamped(sinThetaW, cosThetaW, sinThetaO, node.cosThetaO);
+	float cosThetaP = LightBvhCosSubClamped(sinThetaX, cosThetaX, sinThetaB, cosThetaB);
+	if (cosThetaP < node.cosThetaE)
+		return 0.0f;
+
+	float importance = node.power * cosThetaP / clampedDistanceSq;
+	if (dot(normal, normal) > 0.0f)
+	{
+		float cosThetaI = -dot(direction, normal);
+		float sinThetaI = sqrt(max(1.0f - cosThetaI * cosThetaI, 0.0f));
+		importance *= max(LightBvhCosSubClamped(sinThetaI, cosThetaI, sinThetaB, cosThetaB), 0.0f);
+	}
+	return max(importance, 0.0f);
+}
+
+// LightBvh::Sample. returns false when no light reaches the point, otherwise the light's index and the probability
+// of having picked it, which its contribution is divided by
+bool SampleLightBvh(StructuredBuffer<LightBvhNode> nodes, float3 position, float3 normal, float u, out uint light, out float pmf)
+{
+	light = 0;
+	pmf = 0.0f;
+	if (LightBvhImportance(nodes[0], position, normal) <= 0.0f)
+		return false;
+
+	uint node = 0;
+	float probability = 1.0f;
+	LightBvhNode current = nodes[0];
+	[loop]
+	while (current.lightCount > 1)
+	{
+		uint firstChild = node + 1;
+		uint secondChild = current.secondChild;
+		LightBvhNode first = nodes[firstChild];
+		LightBvhNode second = nodes[secondChild];
+		float firstImportance = LightBvhImportance(first, position, normal);
+		float secondImportance = LightBvhImportance(second, position, normal);
+		if (firstImportance <= 0.0f && secondImportance <= 0.0f)
+			return false;
+
+		float firstProbability = firstImportance / (firstImportance + secondImportance);
+		if (u < firstProbability)
+		{
+			node = firstChild;
+			current = first;
+			probability *= firstProbability;
+			u = min(u / firstProbability, LIGHT_BVH_ONE_MINUS_EPSILON);
+		}
+		else
+		{
+			node = secondChild;
+			current = second;
+			probability *= 1.0f - firstProbability;
+			u = min((u - firstProbability) / (1.0f - firstProbability), LIGHT_BVH_ONE_MINUS_EPSILON);
+		}
+	}
+
+	light = current.secondChild;
+	pmf = probability;
+	return true;
+}
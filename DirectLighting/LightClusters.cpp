@@ -0,0 +1,327 @@
+#include "LightClusters.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#include "JobSystem.h"
+
+using namespace DirectX;
+
+namespace
+{
+	// lights per block when moving them into view space
+	const uint32_t MIN_LIGHTS_PER_BLOCK = 1024;
+}
+
+XMFLOAT4 LightBoundingSphere(const Light& _light)
+{
+	if (_light.type != LIGHT_SPOT)
+		return XMFLOAT4(_light.position.x, _light.position.y, _light.position.z, _light.range);
+
+	// a wide cone fits in the sphere around the circle at its end, a narrow one needs a sphere through the apex too
+	float cosAngle = std::max(_light.cosOuterAngle, 0.0f);
+	float distance;
+	float radius;
+	if (cosAngle < 0.70710678f)
+	{
+		distance = _light.range * cosAngle;
+		radius = _light.range * std::sqrt(1.0f - cosAngle * cosAngle);
+	}
+	else
+	{
+		distance = _light.range / (2.0f * cosAngle);
+		radius = distance;
+	}
+	return XMFLOAT4(_light.position.x + _light.direction.x * distance,
+		_light.position.y + _light.direction.y * distance,
+		_light.position.z + _light.direction.z * distance,
+		radius);
+}
+
+float LightPower(const Light& _light)
+{
+	// a point light shines over the whole sphere, a spot light over the cap its cone cuts out of it
+	float luminance = 0.2126f * _light.color.x + 0.7152f * _light.color.y + 0.0722f * _light.color.z;
+	float solidAngle = _light.type == LIGHT_SPOT ? 2.0f * XM_PI * (1.0f - _light.cosOuterAngle) : 4.0f * XM_PI;
+	return solidAngle * luminance;
+}
+
+float LightAttenuation(const Light& _light, const XMFLOAT3& _position, XMFLOAT3& _toLight, float& _distance)
+{
+	XMFLOAT3 offset(_light.position.x - _position.x, _light.position.y - _position.y, _light.position.z - _position.z);
+	float distanceSq = offset.x * offset.x + offset.y * offset.y + offset.z * offset.z;
+	_distance = std::sqrt(distanceSq);
+	_toLight = _distance > 0.0f ? XMFLOAT3(offset.x / _distance, offset.y / _distance, offset.z / _distance) : XMFLOAT3(0.0f, 1.0f, 0.0f);
+	if (_distance >= _light.range)
+		return 0.0f;
+
+	if (_light.type == LIGHT_SPOT)
+	{
+		float cosAngle = -(_toLight.x * _light.direction.x + _toLight.y * _light.direction.y + _toLight.z * _light.direction.z);
+		if (cosAngle < _light.cosOuterAngle)
+			return 0.0f;
+	}
+
+	// (1 - (d / range)^4)^2 is close to 1 near the light and reaches 0 smoothly at the range
+	float ratio = distanceSq / (_light.range * _light.range);
+	float window = 1.0f - ratio * ratio;
+	return window * window / std::max(distanceSq, 1e-4f);
+}
+
+void LightClusters::Init(const LightClusterDesc& _desc, const XMFLOAT4X4& _proj)
+{
+	m_desc = _desc;
+	m_clustersX = (_desc.screenWidth + _desc.tileSize - 1) / _desc.tileSize;
+	m_clustersY = (_desc.screenHeight + _desc.tileSize - 1) / _desc.tileSize;
+	m_clustersZ = _desc.depthSlices;
+
+	// for a left handed perspective projection _33 = f / (f - n) and _43 = -n * f / (f - n)
+	m_nearZ = _desc.nearZ > 0.0f ? _desc.nearZ : -_proj._43 / _proj._33;
+	m_farZ = _desc.farZ > 0.0f ? _desc.farZ : m_nearZ * _proj._33 / (_proj._33 - 1.0f);
+
+	// slice k starts at near * (far / near)^(k / slices), so log2(z) maps linearly onto the slice index
+	float logRange = std::log2(m_farZ / m_nearZ);
+	m_sliceScale = static_cast<float>(m_clustersZ) / logRange;
+	m_sliceBias = -m_sliceScale * std::log2(m_nearZ);
+
+	// a tile's edges in ndc become lines through the eye, x = (ndc - _31) * z / _11, so its bounds at a slice
+	// come from the four corners at the slice's near and far depth
+	m_clusterBounds.resize(ClusterCount());
+	m_rowBounds.resize(static_cast<size_t>(m_clustersZ) * m_clustersY);
+	for (uint32_t z = 0; z < m_clustersZ; ++z)
+	{
+		float depths[2];
+		depths[0] = m_nearZ * std::pow(m_farZ / m_nearZ, static_cast<float>(z) / m_clustersZ);
+		depths[1] = m_nearZ * std::pow(m_farZ / m_nearZ, static_cast<float>(z + 1) / m_clustersZ);
+
+		for (uint32_t y = 0; y < m_clustersY; ++y)
+		{
+			// tile rows count down from the top of the screen, like SV_Position
+			float ndcTop = 1.0f - 2.0f * (y * _desc.tileSize) / _desc.screenHeight;
+			float ndcBottom = std::max(1.0f - 2.0f * ((y + 1) * _desc.tileSize) / _desc.screenHeight, -1.0f);
+
+			Bounds& row = m_rowBounds[static_cast<size_t>(z) * m_clustersY + y];
+			row.min = XMFLOAT3(FLT_MAX, FLT_MAX, depths[0]);
+			row.max = XMFLOAT3(-FLT_MAX, -FLT_MAX, depths[1]);
+
+			for (uint32_t x = 0; x < m_clustersX; ++x)
+			{
+				float ndcLeft = -1.0f + 2.0f * (x * _desc.tileSize) / _desc.screenWidth;
+				float ndcRight = std::min(-1.0f + 2.0f * ((x + 1) * _desc.tileSize) / _desc.screenWidth, 1.0f);
+
+				Bounds& bounds = m_clusterBounds[ClusterIndex(x, y, z)];
+				bounds.min = XMFLOAT3(FLT_MAX, FLT_MAX, depths[0]);
+				bounds.max = XMFLOAT3(-FLT_MAX, -FLT_MAX, depths[1]);
+				for (float depth : depths)
+				{
+					float left = (ndcLeft - _proj._31) * depth / _proj._11;
+					float right = (ndcRight - _proj._31) * depth / _proj._11;
+					float bottom = (ndcBottom - _proj._32) * depth / _proj._22;
+					float top = (ndcTop - _proj._32) * depth / _proj._22;
+					bounds.min.x = std::min(bounds.min.x, left);
+					bounds.max.x = std::max(bounds.max.x, right);
+					bounds.min.y = std::min(bounds.min.y, bottom);
+					bounds.max.y = std::max(bounds.max.y, top);
+				}
+
+				row.min.x = std::min(row.min.x, bounds.min.x);
+				row.max.x = std::max(row.max.x, bounds.max.x);
+				row.min.y = std::min(row.min.y, bounds.min.y);
+				row.max.y = std::max(row.max.y, bounds.max.y);
+			}
+		}
+	}
+
+	m_clusters.assign(ClusterCount(), LightCluster());
+	m_sliceIndices.resize(m_clustersZ);
+}
+
+uint32_t LightClusters::Slice(float _viewZ)
+{
+	if (!(_viewZ > m_nearZ))
+		return 0;
+	float slice = std::floor(std::log2(_viewZ) * m_sliceScale + m_sliceBias);
+	return std::min(static_cast<uint32_t>(std::max(slice, 0.0f)), m_clustersZ - 1);
+}
+
+void LightClusters::Build(const Light* _lights, uint32_t _count, const XMFLOAT4X4& _view, JobSystem* _pJobSystem)
+{
+	// bounding spheres into view space
+	m_viewSpheres.resize(_count);
+	XMMATRIX view = XMLoadFloat4x4(&_view);
+	auto transform = [&](unsigned int _begin, unsigned int _end)
+	{
+		for (unsigned int i = _begin; i < _end; ++i)
+		{
+			XMFLOAT4 sphere = LightBoundingSphere(_lights[i]);
+			XMVECTOR center = XMVector3TransformCoord(XMVectorSet(sphere.x, sphere.y, sphere.z, 1.0f), view);
+			XMStoreFloat4(&m_viewSpheres[i], XMVectorSetW(center, sphere.w));
+		}
+	};
+	if (_pJobSystem && _count >= 2 * MIN_LIGHTS_PER_BLOCK)
+		_pJobSystem->ParallelFor(_count, MIN_LIGHTS_PER_BLOCK, transform);
+	else
+		transform(0, _count);
+
+	// bin the lights by the slices their depth range covers. counting first keeps it to two flat arrays
+	std::vector<uint32_t> firstSlice(_count);
+	std::vector<uint32_t> lastSlice(_count);
+	m_sliceLightOffsets.assign(m_clustersZ + 1, 0);
+	for (uint32_t i = 0; i < _count; ++i)
+	{
+		const XMFLOAT4& sphere = m_viewSpheres[i];
+		if (sphere.z + sphere.w < m_nearZ || sphere.z - sphere.w > m_farZ)
+		{
+			firstSlice[i] = 1;
+			lastSlice[i] = 0;
+			continue;
+		}
+		firstSlice[i] = Slice(sphere.z - sphere.w);
+		lastSlice[i] = Slice(sphere.z + sphere.w);
+		for (uint32_t slice = firstSlice[i]; slice <= lastSlice[i]; ++slice)
+		{
+			m_sliceLightOffsets[slice + 1]++;
+		}
+	}
+	for (uint32_t slice = 0; slice < m_clustersZ; ++slice)
+	{
+		m_sliceLightOffsets[slice + 1] += m_sliceLightOffsets[slice];
+	}
+	m_sliceLights.resize(m_sliceLightOffsets[m_clustersZ]);
+	std::vector<uint32_t> cursor(m_sliceLightOffsets.begin(), m_sliceLightOffsets.end() - 1);
+	for (uint32_t i = 0; i < _count; ++i)
+	{
+		for (uint32_t slice = firstSlice[i]; slice <= lastSlice[i]; ++slice)
+		{
+			m_sliceLights[cursor[slice]++] = i;
+		}
+	}
+
+	// cull every slice on its own
+	auto buildSlices = [this](unsigned int _begin, unsigned int _end)
+	{
+		for (unsigned int slice = _begin; slice < _end; ++slice)
+		{
+			BuildSlice(slice);
+		}
+	};
+	if (_pJobSystem)
+		_pJobSystem->ParallelFor(m_clustersZ, 1, buildSlices);
+	else
+		buildSlices(0, m_clustersZ);
+
+	// stitch the slices' lists together in slice order
+	std::vector<uint32_t> sliceBase(m_clustersZ + 1, 0);
+	for (uint32_t slice = 0; slice < m_clustersZ; ++slice)
+	{
+		sliceBase[slice + 1] = sliceBase[slice] + static_cast<uint32_t>(m_sliceIndices[slice].size());
+	}
+	m_lightIndices.resize(sliceBase[m_clustersZ]);
+
+	auto stitch = [&](unsigned int _begin, unsigned int _end)
+	{
+		for (unsigned int slice = _begin; slice < _end; ++slice)
+		{
+			const std::vector<uint32_t>& indices = m_sliceIndices[slice];
+			if (!indices.empty())
+				memcpy(&m_lightIndices[sliceBase[slice]], indices.data(), indices.size() * sizeof(uint32_t));
+
+			uint32_t first = ClusterIndex(0, 0, slice);
+			uint32_t last = first + m_clustersX * m_clustersY;
+			for (uint32_t cluster = first; cluster < last; ++cluster)
+			{
+				m_clusters[cluster].offset += sliceBase[slice];
+			}
+		}
+	};
+	if (_pJobSystem)
+		_pJobSystem->ParallelFor(m_clustersZ, 1, stitch);
+	else
+		stitch(0, m_clustersZ);
+}
+
+void LightClusters::BuildSlice(uint32_t _slice)
+{
+	std::vector<uint32_t>& output = m_sliceIndices[_slice];
+	output.clear();
+
+	const uint32_t* pSliceLights = m_sliceLights.data() + m_sliceLightOffsets[_slice];
+	uint32_t sliceLightCount = m_sliceLightOffsets[_slice + 1] - m_sliceLightOffsets[_slice];
+
+	std::vector<LightQuad> sliceQuads;
+	std::vector<LightQuad> rowQuads;
+	std::vector<uint32_t> rowLights(sliceLightCount + 4);
+	std::vector<uint32_t> clusterLights(sliceLightCount + 4);
+	PackQuads(m_viewSpheres.data(), pSliceLights, sliceLightCount, sliceQuads);
+
+	for (uint32_t y = 0; y < m_clustersY; ++y)
+	{
+		// the row test throws away most lights before they are tested against each cluster in the row
+		const Bounds& row = m_rowBounds[static_cast<size_t>(_slice) * m_clustersY + y];
+		uint32_t rowCount = TestQuads(sliceQuads, pSliceLights, sliceLightCount, row, rowLights.data());
+		PackQuads(m_viewSpheres.data(), rowLights.data(), rowCount, rowQuads);
+
+		for (uint32_t x = 0; x < m_clustersX; ++x)
+		{
+			uint32_t cluster = ClusterIndex(x, y, _slice);
+			uint32_t count = TestQuads(rowQuads, rowLights.data(), rowCount, m_clusterBounds[cluster], clusterLights.data());
+			m_clusters[cluster].offset = static_cast<uint32_t>(output.size());
+			m_clusters[cluster].count = count;
+			output.insert(output.end(), clusterLights.begin(), clusterLights.begin() + count);
+		}
+	}
+}
+
+void LightClusters::PackQuads(const XMFLOAT4* _spheres, const uint32_t* _indices, uint32_t _count, std::vector<LightQuad>& _quads)
+{
+	// the last quad is padded with lights too far away to touch anything
+	_quads.resize((_count + 3) / 4);
+	for (uint32_t quad = 0; quad < _quads.size(); ++quad)
+	{
+		XMFLOAT4 lanes[4];
+		for (uint32_t lane = 0; lane < 4; ++lane)
+		{
+			uint32_t i = quad * 4 + lane;
+			lanes[lane] = i < _count ? _spheres[_indices[i]] : XMFLOAT4(1e18f, 1e18f, 1e18f, 0.0f);
+		}
+		_quads[quad].x = XMVectorSet(lanes[0].x, lanes[1].x, lanes[2].x, lanes[3].x);
+		_quads[quad].y = XMVectorSet(lanes[0].y, lanes[1].y, lanes[2].y, lanes[3].y);
+		_quads[quad].z = XMVectorSet(lanes[0].z, lanes[1].z, lanes[2].z, lanes[3].z);
+		_quads[quad].radius = XMVectorSet(lanes[0].w, lanes[1].w, lanes[2].w, lanes[3].w);
+	}
+}
+
+uint32_t LightClusters::TestQuads(const std::vector<LightQuad>& _quads, const uint32_t* _indices, uint32_t _count, const Bounds& _bounds, uint32_t* _out)
+{
+	// sphere against box: the squared distance from the centre to the closest point of the box
+	XMVECTOR minX = XMVectorReplicate(_bounds.min.x);
+	XMVECTOR minY = XMVectorReplicate(_bounds.min.y);
+	XMVECTOR minZ = XMVectorReplicate(_bounds.min.z);
+	XMVECTOR maxX = XMVectorReplicate(_bounds.max.x);
+	XMVECTOR maxY = XMVectorReplicate(_bounds.max.y);
+	XMVECTOR maxZ = XMVectorReplicate(_bounds.max.z);
+	XMVECTOR zero = XMVectorZero();
+
+	uint32_t written = 0;
+	for (uint32_t quad = 0; quad < _quads.size(); ++quad)
+	{
+		const LightQuad& lights = _quads[quad];
+		XMVECTOR dx = XMVectorMax(XMVectorMax(XMVectorSubtract(minX, lights.x), XMVectorSubtract(lights.x, maxX)), zero);
+		XMVECTOR dy = XMVectorMax(XMVectorMax(XMVectorSubtract(minY, lights.y), XMVectorSubtract(lights.y, maxY)), zero);
+		XMVECTOR dz = XMVectorMax(XMVectorMax(XMVectorSubtract(minZ, lights.z), XMVectorSubtract(lights.z, maxZ)), zero);
+		XMVECTOR distanceSq = XMVectorMultiplyAdd(dx, dx, XMVectorMultiplyAdd(dy, dy, XMVectorMultiply(dz, dz)));
+		XMVECTOR inside = XMVectorLessOrEqual(distanceSq, XMVectorMultiply(lights.radius, lights.radius));
+
+		uint32_t mask[4];
+		XMStoreInt4(mask, inside);
+		for (uint32_t lane = 0; lane < 4; ++lane)
+		{
+			uint32_t i = quad * 4 + lane;
+			if (mask[lane] && i < _count)
+				_out[written++] = _indices[i];
+		}
+	}
+	return written;
+}
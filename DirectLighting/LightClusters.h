@@ -0,0 +1,130 @@
+#pragma once
+#include <DirectXMath.h>
+
+#include <cstdint>
+#include <vector>
+
+class JobSystem;
+
+enum LightType : uint32_t
+{
+	LIGHT_POINT = 0,
+	LIGHT_SPOT = 1
+};
+
+// a light as the shaders see it, 48 bytes so an array of them can go straight into a structured buffer
+struct Light
+{
+	DirectX::XMFLOAT3 position; // world space
+	float range; // the light has no effect past this distance
+	DirectX::XMFLOAT3 color; // already multiplied by the intensity
+	uint32_t type; // LightType
+	DirectX::XMFLOAT3 direction; // spot lights only, normalised
+	float cosOuterAngle; // spot lights only, cosine of the half angle of the cone
+};
+
+// the smallest sphere around a light's area of effect as (centre, radius). a spot light's cone is much smaller than its range
+DirectX::XMFLOAT4 LightBoundingSphere(const Light& _light);
+
+// the total light a light gives off, as luminance times the solid angle it covers. used to pick lights in proportion to it
+float LightPower(const Light& _light);
+
+// how much of a light's color reaches _position: inverse square, faded to nothing at the range so the light really
+// ends there, and nothing outside a spot light's cone. _toLight is set to the normalised direction to the light
+float LightAttenuation(const Light& _light, const DirectX::XMFLOAT3& _position, DirectX::XMFLOAT3& _toLight, float& _distance);
+
+struct LightClusterDesc
+{
+	uint32_t screenWidth = 1920;
+	uint32_t screenHeight = 1080;
+	uint32_t tileSize = 64; // clusters are tileSize x tileSize pixels on screen
+	uint32_t depthSlices = 24;
+	// depth range the slices cover. 0 takes the near/far planes from the projection matrix.
+	// a far plane closer than the projection's gives the slices more precision where the lights are
+	float nearZ = 0.0f;
+	float farZ = 0.0f;
+};
+
+// where a cluster's lights are in the index list
+struct LightCluster
+{
+	uint32_t offset;
+	uint32_t count;
+};
+
+// splits the view frustum into froxels: screen tiles, each cut into depth slices that grow exponentially with distance
+// so every cluster is roughly cube shaped. Build assigns every light to the clusters its bounding sphere touches, and
+// the pixel shader finds its cluster from its screen position and view depth, then only loops over that cluster's lights.
+//
+// the culling is done per depth slice in parallel. each slice first gathers the lights that reach its depth range, then
+// tests them against each row of tiles and then each cluster in the row, four lights at a time with DirectXMath
+// vectors. the index list is stitched together afterwards with a prefix sum over the slices, so the output is the same
+// however many threads ran
+class LightClusters
+{
+public:
+	LightClusters() = default;
+	~LightClusters() = default;
+
+	// works out the clusters' view space bounds. call again when the projection or the screen size changes
+	void Init(const LightClusterDesc& _desc, const DirectX::XMFLOAT4X4& _proj);
+
+	// _view is the camera's view matrix, the lights are in world space
+	void Build(const Light* _lights, uint32_t _count, const DirectX::XMFLOAT4X4& _view, JobSystem* _pJobSystem = nullptr);
+
+	uint32_t ClustersX() { return m_clustersX; }
+	uint32_t ClustersY() { return m_clustersY; }
+	uint32_t ClustersZ() { return m_clustersZ; }
+	uint32_t ClusterCount() { return m_clustersX * m_clustersY * m_clustersZ; }
+	uint32_t TileSize() { return m_desc.tileSize; }
+	uint32_t ClusterIndex(uint32_t _x, uint32_t _y, uint32_t _z) { return (_z * m_clustersY + _y) * m_clustersX + _x; }
+
+	const std::vector<LightCluster>& Clusters() { return m_clusters; }
+	const std::vector<uint32_t>& LightIndices() { return m_lightIndices; }
+
+	// the shader's slice lookup: slice = floor(log2(viewZ) * SliceScale() + SliceBias())
+	float SliceScale() { return m_sliceScale; }
+	float SliceBias() { return m_sliceBias; }
+	uint32_t Slice(float _viewZ);
+
+private:
+	struct Bounds
+	{
+		DirectX::XMFLOAT3 min;
+		DirectX::XMFLOAT3 max;
+	};
+
+	// four lights side by side, one component per vector
+	struct LightQuad
+	{
+		DirectX::XMVECTOR x;
+		DirectX::XMVECTOR y;
+		DirectX::XMVECTOR z;
+		DirectX::XMVECTOR radius;
+	};
+
+	void BuildSlice(uint32_t _slice);
+	static void PackQuads(const DirectX::XMFLOAT4* _spheres, const uint32_t* _indices, uint32_t _count, std::vector<LightQuad>& _quads);
+	static uint32_t TestQuads(const std::vector<LightQuad>& _quads, const uint32_t* _indices, uint32_t _count, const Bounds& _bounds, uint32_t* _out);
+
+	LightClusterDesc m_desc;
+	uint32_t m_clustersX = 0;
+	uint32_t m_clustersY = 0;
+	uint32_t m_clustersZ = 0;
+	float m_nearZ = 0.0f;
+	float m_farZ = 0.0f;
+	float m_sliceScale = 0.0f;
+	float m_sliceBias = 0.0f;
+
+	std::vector<Bounds> m_clusterBounds; // view space, indexed like the clusters
+	std::vector<Bounds> m_rowBounds; // a row of clusters in one slice, [slice][y]
+
+	// per frame
+	std::vector<DirectX::XMFLOAT4> m_viewSpheres; // view space bounding sphere of every light
+	std::vector<uint32_t> m_sliceLightOffsets; // lights that reach each slice, as ranges into m_sliceLights
+	std::vector<uint32_t> m_sliceLights;
+	std::vector<std::vector<uint32_t>> m_sliceIndices; // each slice's part of the index list, offsets in m_clusters are relative to it
+
+	std::vector<LightCluster> m_clusters;
+	std::vector<uint32_t> m_lightIndices;
+};
@@ -0,0 +1,136 @@
+// lighting a pixel from the clusters LightClusters builds on the cpu, see LightClusters.h for how they are laid out.
+// ClusteredLighting uploads everything declared here and binds it for the scene's pixel shader
+
+#include "LightBvh.hlsli"
+
+#define LIGHT_SPOT 1
+
+// ClusteredLightingConstants in ClusteredLighting.h
+cbuffer LightingConstants : register(b1)
+{
+	float4x4 invViewProj;
+	float3 ambient;
+	uint lightCount; // 0 when the lights did not fit this frame
+	uint clustersX;
+	uint clustersY;
+	uint clustersZ;
+	uint tileSize;
+	float sliceScale;
+	float sliceBias;
+	float2 invScreenSize;
+	uint lightBvhSamples; // 0 while the clusters fit
+	float3 sunDirection; // the way the sun's light travels
+	float3 sunColor;
+};
+
+// Light in LightClusters.h
+struct Light
+{
+	float3 position;
+	float range;
+	float3 color;
+	uint type;
+	float3 direction;
+	float cosOuterAngle;
+};
+
+// LightCluster in LightClusters.h
+struct LightCluster
+{
+	uint offset;
+	uint count;
+};
+
+StructuredBuffer<Light> lights : register(t0);
+StructuredBuffer<LightCluster> clusters : register(t1);
+StructuredBuffer<uint> lightIndices : register(t2);
+StructuredBuffer<LightBvhNode> lightBvhNodes : register(t3);
+
+// LightAttenuation in LightClusters.cpp, the two have to fall off the same way
+float LightAttenuation(Light light, float3 position, out float3 toLight)
+{
+	float3 offset = light.position - position;
+	float distanceSq = dot(offset, offset);
+	float distance = sqrt(distanceSq);
+	toLight = distance > 0.0f ? offset / distance : float3(0.0f, 1.0f, 0.0f);
+	if (distance >= light.range)
+		return 0.0f;
+	if (light.type == LIGHT_SPOT && -dot(toLight, light.direction) < light.cosOuterAngle)
+		return 0.0f;
+
+	float ratio = distanceSq / (light.range * light.range);
+	float window = 1.0f - ratio * ratio;
+	return window * window / max(distanceSq, 1e-4f);
+}
+
+// the cluster a pixel falls in from its SV_Position, whose w is the view space depth. LightClusters::Slice does the
+// same, anything in front of the first slice or past the last goes into it
+uint LightClusterIndex(float4 svPosition)
+{
+	uint x = min(uint(svPosition.x) / tileSize, clustersX - 1);
+	uint y = min(uint(svPosition.y) / tileSize, clustersY - 1);
+	float slice = floor(log2(max(svPosition.w, 1e-6f)) * sliceScale + sliceBias);
+	uint z = uint(clamp(slice, 0.0f, float(clustersZ - 1)));
+	return (z * clustersY + y) * clustersX + x;
+}
+
+// the world position under a pixel, from its SV_Position
+float3 LightClusterWorldPosition(float4 svPosition)
+{
+	float2 ndc = float2(svPosition.x * invScreenSize.x * 2.0f - 1.0f, 1.0f - svPosition.y * invScreenSize.y * 2.0f);
+	float4 world = mul(float4(ndc, svPosition.z, 1.0f), invViewProj);
+	return world.xyz / world.w;
+}
+
+// a random number in [0, 1) for the pixel and sample, from a pcg hash of both
+float LightSampleRandom(float4 svPosition, uint sample)
+{
+	uint state = (uint(svPosition.y) * 8192u + uint(svPosition.x)) * 747796405u + sample * 2891336453u;
+	uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+	return float((word >> 22u) ^ word) * (1.0f / 4294967296.0f);
+}
+
+// the same light as ClusteredDiffuse, estimated from lightBvhSamples lights picked by importance
+float3 SampledDiffuse(float4 svPosition, float3 position, float3 normal)
+{
+	float3 result = 0.0f;
+	for (uint i = 0; i < lightBvhSamples; ++i)
+	{
+		uint index;
+		float pmf;
+		if (!SampleLightBvh(lightBvhNodes, position, normal, LightSampleRandom(svPosition, i), index, pmf))
+			continue; // the walk ran into a node nothing under which reaches the point
+		Light light = lights[index];
+		float3 toLight;
+		float attenuation = LightAttenuation(light, position, toLight);
+		result += light.color * (attenuation * saturate(dot(normal, toLight)) / pmf);
+	}
+	return result / lightBvhSamples;
+}
+
+// the sun's light on a surface with the given normal, the same as PathTracer's but without the shadow, which SunShadow adds
+float3 SunDiffuse(float3 normal)
+{
+	return sunColor * saturate(-dot(normal, sunDirection));
+}
+
+// the diffuse light reaching a surface at position with the given normal, from every light in the pixel's cluster, on
+// top of the indirect light it already gets (the flat ambient or an irradiance volume)
+float3 ClusteredDiffuse(float4 svPosition, float3 position, float3 normal, float3 indirect)
+{
+	float3 result = indirect;
+	if (lightCount == 0)
+		return result;
+	if (lightBvhSamples > 0)
+		return result + SampledDiffuse(svPosition, position, normal);
+
+	LightCluster cluster = clusters[LightClusterIndex(svPosition)];
+	for (uint i = 0; i < cluster.count; ++i)
+	{
+		Light light = lights[lightIndices[cluster.offset + i]];
+		float3 toLight;
+		float attenuation = LightAttenuation(light, position, toLight);
+		result += light.color * (attenuation * saturate(dot(normal, toLight)));
+	}
+	return result;
+}
@@ -0,0 +1,597 @@
+#include "LightmapBaker.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <numeric>
+#include <tuple>
+#include <unordered_map>
+
+#include "JobSystem.h"
+#include "PathTracer.h"
+
+using namespace DirectX;
+
+namespace
+{
+	const float CHART_NORMAL_COSINE = 0.98f; // neighbours that bend by more than about 11 degrees start a new chart
+	const float WELD_SCALE = 1e4f; // positions closer than this many units apart are the same vertex
+	const uint32_t PACK_ATTEMPTS = 16;
+	const float PACK_SHRINK = 0.8f; // the density is lowered by this much every time the charts do not fit
+
+	struct ChartJob
+	{
+		uint32_t chart;
+		uint32_t tileX;
+		uint32_t tileY;
+	};
+
+	uint32_t FindRoot(std::vector<uint32_t>& _parents, uint32_t _i)
+	{
+		while (_parents[_i] != _i)
+		{
+			_parents[_i] = _parents[_parents[_i]];
+			_i = _parents[_i];
+		}
+		return _i;
+	}
+
+	float Dot(const XMFLOAT3& _a, const XMFLOAT3& _b) { return _a.x * _b.x + _a.y * _b.y + _a.z * _b.z; }
+
+	void HashBytes(uint64_t& _hash, const void* _pData, size_t _size)
+	{
+		const unsigned char* pBytes = static_cast<const unsigned char*>(_pData);
+		for (size_t byte = 0; byte < _size; ++byte)
+		{
+			_hash ^= pBytes[byte];
+			_hash *= 1099511628211ull;
+		}
+	}
+
+	bool SphereTouchesBox(const XMFLOAT4& _sphere, const XMFLOAT3& _min, const XMFLOAT3& _max)
+	{
+		float dx = std::max(std::max(_min.x - _sphere.x, _sphere.x - _max.x), 0.0f);
+		float dy = std::max(std::max(_min.y - _sphere.y, _sphere.y - _max.y), 0.0f);
+		float dz = std::max(std::max(_min.z - _sphere.z, _sphere.z - _max.z), 0.0f);
+		return dx * dx + dy * dy + dz * dz <= _sphere.w * _sphere.w;
+	}
+}
+
+bool LightmapBaker::Build(PathTracer& _scene, const LightmapDesc& _desc)
+{
+	m_desc = _desc;
+	m_desc.tileSize = std::max(m_desc.tileSize, 1u);
+	for (uint32_t attempt = 0; attempt < PACK_ATTEMPTS; ++attempt)
+	{
+		BuildCharts(_scene);
+		if (PackCharts())
+		{
+			uint32_t texelCount = m_desc.size * m_desc.size;
+			m_irradiance.assign(texelCount, XMFLOAT3(0.0f, 0.0f, 0.0f));
+			m_covered.assign(texelCount, 0);
+			m_packed.assign(texelCount, 0);
+
+			// every corner's uv, now that the charts have their place
+			const std::vector<XMFLOAT3>& positions = _scene.Positions();
+			const std::vector<uint32_t>& indices = _scene.Indices();
+			m_triangleUvs.resize(indices.size());
+			float inverseSize = 1.0f / m_desc.size;
+			for (const LightmapChart& chart : m_charts)
+			{
+				for (uint32_t i = 0; i < chart.triangleCount; ++i)
+				{
+					uint32_t triangle = m_chartTriangles[chart.firstTriangle + i];
+					for (uint32_t corner = 0; corner < 3; ++corner)
+					{
+						const XMFLOAT3& position = positions[indices[triangle * 3 + corner]];
+						m_triangleUvs[triangle * 3 + corner] = XMFLOAT2(
+							(chart.x + Dot(position, chart.axisU) - chart.offsetU) * inverseSize,
+							(chart.y + Dot(position, chart.axisV) - chart.offsetV) * inverseSize);
+					}
+				}
+			}
+			m_invalidated = true;
+			return true;
+		}
+		m_desc.texelsPerUnit *= PACK_SHRINK;
+	}
+	m_charts.clear();
+	m_chartTriangles.clear();
+	return false;
+}
+
+void LightmapBaker::BuildCharts(PathTracer& _scene)
+{
+	const std::vector<XMFLOAT3>& positions = _scene.Positions();
+	const std::vector<uint32_t>& indices = _scene.Indices();
+	const std::vector<XMFLOAT3>& normals = _scene.TriangleNormals();
+	uint32_t triangleCount = static_cast<uint32_t>(normals.size());
+
+	// meshes usually split their vertices wherever the normal or colour changes, so the triangles are joined up by
+	// position instead of by index
+	std::map<std::tuple<int64_t, int64_t, int64_t>, uint32_t> weldedIds;
+	std::vector<uint32_t> welded(positions.size());
+	for (size_t i = 0; i < positions.size(); ++i)
+	{
+		auto key = std::make_tuple(
+			static_cast<int64_t>(std::floor(positions[i].x * WELD_SCALE + 0.5f)),
+			static_cast<int64_t>(std::floor(positions[i].y * WELD_SCALE + 0.5f)),
+			static_cast<int64_t>(std::floor(positions[i].z * WELD_SCALE + 0.5f)));
+		auto it = weldedIds.insert(std::make_pair(key, static_cast<uint32_t>(weldedIds.size()))).first;
+		welded[i] = it->second;
+	}
+
+	// triangles that share an edge and face the same way go in the same chart
+	std::vector<uint32_t> parents(triangleCount);
+	std::iota(parents.begin(), parents.end(), 0u);
+	std::unordered_map<uint64_t, uint32_t> edges;
+	for (uint32_t triangle = 0; triangle < triangleCount; ++triangle)
+	{
+		for (uint32_t corner = 0; corner < 3; ++corner)
+		{
+			uint32_t a = welded[indices[triangle * 3 + corner]];
+			uint32_t b = welded[indices[triangle * 3 + (corner + 1) % 3]];
+			uint64_t edge = (static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b);
+			auto it = edges.find(edge);
+			if (it == edges.end())
+			{
+				edges[edge] = triangle;
+				continue;
+			}
+			if (Dot(normals[triangle], normals[it->second]) >= CHART_NORMAL_COSINE)
+			{
+				uint32_t rootA = FindRoot(parents, triangle);
+				uint32_t rootB = FindRoot(parents, it->second);
+				if (rootA != rootB)
+					parents[std::max(rootA, rootB)] = std::min(rootA, rootB);
+			}
+		}
+	}
+
+	// charts are numbered in the order of their first triangle, and list their triangles in order
+	std::vector<uint32_t> chartOfRoot(triangleCount, 0xffffffff);
+	std::vector<uint32_t> chartOfTriangle(triangleCount);
+	m_charts.clear();
+	for (uint32_t triangle = 0; triangle < triangleCount; ++triangle)
+	{
+		uint32_t root = FindRoot(parents, triangle);
+		if (chartOfRoot[root] == 0xffffffff)
+		{
+			chartOfRoot[root] = static_cast<uint32_t>(m_charts.size());
+			LightmapChart chart = {};
+			chart.firstTriangle = triangle; // the chart's first triangle until the list is built
+			m_charts.push_back(chart);
+		}
+		chartOfTriangle[triangle] = chartOfRoot[root];
+		++m_charts[chartOfRoot[root]].triangleCount;
+	}
+
+	uint32_t offset = 0;
+	std::vector<uint32_t> fill(m_charts.size(), 0);
+	std::vector<uint32_t> firstTriangles(m_charts.size());
+	for (size_t chart = 0; chart < m_charts.size(); ++chart)
+	{
+		firstTriangles[chart] = m_charts[chart].firstTriangle;
+		m_charts[chart].firstTriangle = offset;
+		offset += m_charts[chart].triangleCount;
+	}
+	m_chartTriangles.resize(triangleCount);
+	for (uint32_t triangle = 0; triangle < triangleCount; ++triangle)
+	{
+		uint32_t chart = chartOfTriangle[triangle];
+		m_chartTriangles[m_charts[chart].firstTriangle + fill[chart]++] = triangle;
+	}
+
+	// flatten every chart onto the plane of its first triangle
+	float texelsPerUnit = m_desc.texelsPerUnit;
+	float padding = static_cast<float>(m_desc.padding);
+	for (size_t i = 0; i < m_charts.size(); ++i)
+	{
+		LightmapChart& chart = m_charts[i];
+		const XMFLOAT3& normal = normals[firstTriangles[i]];
+		XMVECTOR n = XMLoadFloat3(&normal);
+		XMVECTOR helper = std::fabs(normal.y) < 0.99f ? XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f) : XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f);
+		XMVECTOR u = XMVector3Normalize(XMVector3Cross(helper, n));
+		XMVECTOR v = XMVector3Cross(n, u);
+		XMStoreFloat3(&chart.axisU, XMVectorScale(u, texelsPerUnit));
+		XMStoreFloat3(&chart.axisV, XMVectorScale(v, texelsPerUnit));
+		chart.normal = normal;
+		chart.planeDistance = Dot(normal, positions[indices[firstTriangles[i] * 3]]);
+
+		float minU = FLT_MAX;
+		float minV = FLT_MAX;
+		float maxU = -FLT_MAX;
+		float maxV = -FLT_MAX;
+		chart.boundsMin = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+		chart.boundsMax = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		for (uint32_t t = 0; t < chart.triangleCount; ++t)
+		{
+			uint32_t triangle = m_chartTriangles[chart.firstTriangle + t];
+			for (uint32_t corner = 0; corner < 3; ++corner)
+			{
+				const XMFLOAT3& position = positions[indices[triangle * 3 + corner]];
+				float pu = Dot(position, chart.axisU);
+				float pv = Dot(position, chart.axisV);
+				minU = std::min(minU, pu);
+				minV = std::min(minV, pv);
+				maxU = std::max(maxU, pu);
+				maxV = std::max(maxV, pv);
+				chart.boundsMin = XMFLOAT3(std::min(chart.boundsMin.x, position.x), std::min(chart.boundsMin.y, position.y), std::min(chart.boundsMin.z, position.z));
+				chart.boundsMax = XMFLOAT3(std::max(chart.boundsMax.x, position.x), std::max(chart.boundsMax.y, position.y), std::max(chart.boundsMax.z, position.z));
+			}
+		}
+		chart.offsetU = minU - padding;
+		chart.offsetV = minV - padding;
+		chart.width = static_cast<uint32_t>(std::ceil(maxU - minU)) + 1 + 2 * m_desc.padding;
+		chart.height = static_cast<uint32_t>(std::ceil(maxV - minV)) + 1 + 2 * m_desc.padding;
+		chart.lightHash = 0;
+	}
+}
+
+bool LightmapBaker::PackCharts()
+{
+	// shelves, tallest charts first so every shelf wastes as little height as it can
+	std::vector<uint32_t> order(m_charts.size());
+	std::iota(order.begin(), order.end(), 0u);
+	std::sort(order.begin(), order.end(), [&](uint32_t _a, uint32_t _b)
+	{
+		if (m_charts[_a].height != m_charts[_b].height)
+			return m_charts[_a].height > m_charts[_b].height;
+		if (m_charts[_a].width != m_charts[_b].width)
+			return m_charts[_a].width > m_charts[_b].width;
+		return _a < _b;
+	});
+
+	uint32_t shelfX = 0;
+	uint32_t shelfY = 0;
+	uint32_t shelfHeight = 0;
+	for (uint32_t i : order)
+	{
+		LightmapChart& chart = m_charts[i];
+		if (chart.width > m_desc.size)
+			return false;
+		if (shelfX + chart.width > m_desc.size)
+		{
+			shelfY += shelfHeight;
+			shelfX = 0;
+			shelfHeight = 0;
+		}
+		if (shelfY + chart.height > m_desc.size)
+			return false;
+
+		chart.x = shelfX;
+		chart.y = shelfY;
+		shelfX += chart.width;
+		shelfHeight = std::max(shelfHeight, chart.height);
+	}
+	return true;
+}
+
+void LightmapBaker::Invalidate()
+{
+	m_invalidated = true;
+}
+
+uint64_t LightmapBaker::LightHash(PathTracer& _scene, uint32_t _chart, std::vector<uint32_t>& _lights)
+{
+	const LightmapChart& chart = m_charts[_chart];
+	const std::vector<Light>& lights = _scene.Lights();
+	_lights.clear();
+
+	// 64 bit FNV-1a over every light that reaches the chart, with its index so reordering them counts as a change
+	uint64_t hash = 14695981039346656037ull;
+	for (uint32_t i = 0; i < lights.size(); ++i)
+	{
+		if (!SphereTouchesBox(LightBoundingSphere(lights[i]), chart.boundsMin, chart.boundsMax))
+			continue;
+		_lights.push_back(i);
+		HashBytes(hash, &i, sizeof(i));
+		HashBytes(hash, &lights[i], sizeof(Light));
+	}
+	HashBytes(hash, &_scene.SunDirection(), sizeof(XMFLOAT3));
+	HashBytes(hash, &_scene.SunColor(), sizeof(XMFLOAT3));
+	return hash;
+}
+
+uint32_t LightmapBaker::Bake(PathTracer& _scene, JobSystem* _pJobSystem)
+{
+	// which charts are out of date, and the lights that reach each of them
+	std::vector<uint32_t> dirtyCharts;
+	std::vector<std::vector<uint32_t>> chartLights(m_charts.size());
+	std::vector<ChartJob> jobs;
+	for (uint32_t chart = 0; chart < m_charts.size(); ++chart)
+	{
+		uint64_t hash = LightHash(_scene, chart, chartLights[chart]);
+		if (!m_invalidated && hash == m_charts[chart].lightHash)
+			continue;
+
+		m_charts[chart].lightHash = hash;
+		dirtyCharts.push_back(chart);
+		uint32_t tilesX = (m_charts[chart].width + m_desc.tileSize - 1) / m_desc.tileSize;
+		uint32_t tilesY = (m_charts[chart].height + m_desc.tileSize - 1) / m_desc.tileSize;
+		for (uint32_t tileY = 0; tileY < tilesY; ++tileY)
+		{
+			for (uint32_t tileX = 0; tileX < tilesX; ++tileX)
+				jobs.push_back({ chart, tileX, tileY });
+		}
+	}
+	m_invalidated = false;
+
+	// charts never overlap, so neither do the tiles and every job writes its own texels
+	auto bake = [&](unsigned int _begin, unsigned int _end)
+	{
+		for (unsigned int job = _begin; job < _end; ++job)
+			BakeTile(_scene, jobs[job].chart, jobs[job].tileX, jobs[job].tileY, chartLights[jobs[job].chart]);
+	};
+	auto dilate = [&](unsigned int _begin, unsigned int _end)
+	{
+		for (unsigned int i = _begin; i < _end; ++i)
+			Dilate(dirtyCharts[i]);
+	};
+	uint32_t jobCount = static_cast<uint32_t>(jobs.size());
+	uint32_t dirtyCount = static_cast<uint32_t>(dirtyCharts.size());
+	if (_pJobSystem)
+	{
+		_pJobSystem->ParallelFor(jobCount, 1, bake);
+		_pJobSystem->ParallelFor(dirtyCount, 1, dilate);
+	}
+	else
+	{
+		bake(0, jobCount);
+		dilate(0, dirtyCount);
+	}
+	return dirtyCount;
+}
+
+void LightmapBaker::BakeTile(PathTracer& _scene, uint32_t _chart, uint32_t _tileX, uint32_t _tileY, const std::vector<uint32_t>& _lights)
+{
+	const LightmapChart& chart = m_charts[_chart];
+	const std::vector<XMFLOAT3>& positions = _scene.Positions();
+	const std::vector<uint32_t>& indices = _scene.Indices();
+	const std::vector<XMFLOAT3>& normals = _scene.TriangleNormals();
+	const std::vector<Light>& lights = _scene.Lights();
+	XMFLOAT3 toSun(-_scene.SunDirection().x, -_scene.SunDirection().y, -_scene.SunDirection().z);
+	const XMFLOAT3& sunColor = _scene.SunColor();
+	bool sunLit = sunColor.x > 0.0f || sunColor.y > 0.0f || sunColor.z > 0.0f;
+
+	uint32_t firstX = _tileX * m_desc.tileSize;
+	uint32_t firstY = _tileY * m_desc.tileSize;
+	uint32_t lastX = std::min(firstX + m_desc.tileSize, chart.width);
+	uint32_t lastY = std::min(firstY + m_desc.tileSize, chart.height);
+
+	// the chart's triangles flattened into its rectangle, keeping only the ones that overlap the tile
+	struct FlatTriangle
+	{
+		uint32_t triangle;
+		XMFLOAT2 corners[3];
+	};
+	std::vector<FlatTriangle> flatTriangles;
+	for (uint32_t t = 0; t < chart.triangleCount; ++t)
+	{
+		FlatTriangle flat;
+		flat.triangle = m_chartTriangles[chart.firstTriangle + t];
+		float minX = FLT_MAX;
+		float minY = FLT_MAX;
+		float maxX = -FLT_MAX;
+		float maxY = -FLT_MAX;
+		for (uint32_t corner = 0; corner < 3; ++corner)
+		{
+			const XMFLOAT3& position = positions[indices[flat.triangle * 3 + corner]];
+			flat.corners[corner] = XMFLOAT2(Dot(position, chart.axisU) - chart.offsetU, Dot(position, chart.axisV) - chart.offsetV);
+			minX = std::min(minX, flat.corners[corner].x);
+			minY = std::min(minY, flat.corners[corner].y);
+			maxX = std::max(maxX, flat.corners[corner].x);
+			maxY = std::max(maxY, flat.corners[corner].y);
+		}
+		if (maxX >= firstX && minX <= lastX && maxY >= firstY && minY <= lastY)
+			flatTriangles.push_back(flat);
+	}
+
+	for (uint32_t y = firstY; y < lastY; ++y)
+	{
+		for (uint32_t x = firstX; x < lastX; ++x)
+		{
+			uint32_t texel = (chart.y + y) * m_desc.size + chart.x + x;
+			m_irradiance[texel] = XMFLOAT3(0.0f, 0.0f, 0.0f);
+			m_covered[texel] = 0;
+
+			// find the triangle under the texel's centre and where on it the centre is
+			XMFLOAT2 centre(x + 0.5f, y + 0.5f);
+			for (const FlatTriangle& flat : flatTriangles)
+			{
+				const XMFLOAT2& a = flat.corners[0];
+				const XMFLOAT2& b = flat.corners[1];
+				const XMFLOAT2& c = flat.corners[2];
+				float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+				if (std::fabs(area) < 1e-12f)
+					continue;
+				float w1 = ((centre.x - a.x) * (c.y - a.y) - (centre.y - a.y) * (c.x - a.x)) / area;
+				float w2 = ((b.x - a.x) * (centre.y - a.y) - (b.y - a.y) * (centre.x - a.x)) / area;
+				float w0 = 1.0f - w1 - w2;
+				if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+					continue;
+
+				const XMFLOAT3& p0 = positions[indices[flat.triangle * 3 + 0]];
+				const XMFLOAT3& p1 = positions[indices[flat.triangle * 3 + 1]];
+				const XMFLOAT3& p2 = positions[indices[flat.triangle * 3 + 2]];
+				XMFLOAT3 position(
+					p0.x * w0 + p1.x * w1 + p2.x * w2,
+					p0.y * w0 + p1.y * w1 + p2.y * w2,
+					p0.z * w0 + p1.z * w1 + p2.z * w2);
+				const XMFLOAT3& normal = normals[flat.triangle];
+				XMFLOAT3 origin = PathTracer::OffsetRayOrigin(position, normal);
+
+				XMFLOAT3 irradiance(0.0f, 0.0f, 0.0f);
+				for (uint32_t light : _lights)
+				{
+					XMFLOAT3 toLight;
+					float distance;
+					float attenuation = LightAttenuation(lights[light], position, toLight, distance);
+					float cosine = Dot(normal, toLight);
+					if (attenuation <= 0.0f || cosine <= 0.0f || _scene.Occluded(origin, toLight, distance))
+						continue;
+					irradiance.x += lights[light].color.x * attenuation * cosine;
+					irradiance.y += lights[light].color.y * attenuation * cosine;
+					irradiance.z += lights[light].color.z * attenuation * cosine;
+				}
+				float sunCosine = Dot(normal, toSun);
+				if (sunLit && sunCosine > 0.0f && !_scene.Occluded(origin, toSun, FLT_MAX))
+				{
+					irradiance.x += sunColor.x * sunCosine;
+					irradiance.y += sunColor.y * sunCosine;
+					irradiance.z += sunColor.z * sunCosine;
+				}
+
+				m_irradiance[texel] = irradiance;
+				m_covered[texel] = 1;
+				break;
+			}
+		}
+	}
+}
+
+void LightmapBaker::Dilate(uint32_t _chart)
+{
+	// grow the covered texels outwards one ring at a time, so the padding and any gaps along the edges between
+	// triangles take the average of their covered neighbours and bilinear filtering never pulls in black
+	const LightmapChart& chart = m_charts[_chart];
+	std::vector<std::pair<uint32_t, XMFLOAT3>> filled;
+	for (uint32_t pass = 0; pass < m_desc.padding + 1; ++pass)
+	{
+		filled.clear();
+		for (uint32_t y = 0; y < chart.height; ++y)
+		{
+			for (uint32_t x = 0; x < chart.width; ++x)
+			{
+				uint32_t texel = (chart.y + y) * m_desc.size + chart.x + x;
+				if (m_covered[texel])
+					continue;
+
+				XMFLOAT3 sum(0.0f, 0.0f, 0.0f);
+				uint32_t count = 0;
+				for (int32_t dy = -1; dy <= 1; ++dy)
+				{
+					for (int32_t dx = -1; dx <= 1; ++dx)
+					{
+						int32_t nx = static_cast<int32_t>(x) + dx;
+						int32_t ny = static_cast<int32_t>(y) + dy;
+						if (nx < 0 || ny < 0 || nx >= static_cast<int32_t>(chart.width) || ny >= static_cast<int32_t>(chart.height))
+							continue;
+						uint32_t neighbour = (chart.y + ny) * m_desc.size + chart.x + nx;
+						if (!m_covered[neighbour])
+							continue;
+						sum.x += m_irradiance[neighbour].x;
+						sum.y += m_irradiance[neighbour].y;
+						sum.z += m_irradiance[neighbour].z;
+						++count;
+					}
+				}
+				if (count > 0)
+					filled.push_back(std::make_pair(texel, XMFLOAT3(sum.x / count, sum.y / count, sum.z / count)));
+			}
+		}
+		if (filled.empty())
+			break;
+		for (const auto& fill : filled)
+		{
+			m_irradiance[fill.first] = fill.second;
+			m_covered[fill.first] = 2; // filled in, not baked
+		}
+	}
+
+	for (uint32_t y = 0; y < chart.height; ++y)
+	{
+		for (uint32_t x = 0; x < chart.width; ++x)
+		{
+			uint32_t texel = (chart.y + y) * m_desc.size + chart.x + x;
+			m_packed[texel] = PackRGB9E5(m_irradiance[texel]);
+		}
+	}
+}
+
+bool LightmapBaker::Save(const std::string& _fileName)
+{
+	std::ofstream file(_fileName, std::ios::binary);
+	if (!file)
+		return false;
+
+	FileHeader header;
+	header.magic = FILE_MAGIC;
+	header.version = FILE_VERSION;
+	header.width = m_desc.size;
+	header.height = m_desc.size;
+	header.dxgiFormat = DXGI_FORMAT_RGB9E5;
+	header.rowPitch = m_desc.size * sizeof(uint32_t);
+	header.chartCount = static_cast<uint32_t>(m_charts.size());
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(m_packed.data()), m_packed.size() * sizeof(uint32_t));
+
+	// the chart's place in the lightmap goes into its offsets, so a point's texel is just two dot products
+	std::vector<LightmapFileChart> charts(m_charts.size());
+	for (size_t i = 0; i < m_charts.size(); ++i)
+	{
+		const LightmapChart& chart = m_charts[i];
+		LightmapFileChart& fileChart = charts[i];
+		fileChart.axisU = chart.axisU;
+		fileChart.offsetU = chart.offsetU - static_cast<float>(chart.x);
+		fileChart.axisV = chart.axisV;
+		fileChart.offsetV = chart.offsetV - static_cast<float>(chart.y);
+		fileChart.normal = chart.normal;
+		fileChart.planeDistance = chart.planeDistance;
+		fileChart.boundsMin = chart.boundsMin;
+		fileChart.pad0 = 0.0f;
+		fileChart.boundsMax = chart.boundsMax;
+		fileChart.pad1 = 0.0f;
+	}
+	file.write(reinterpret_cast<const char*>(charts.data()), charts.size() * sizeof(LightmapFileChart));
+	return static_cast<bool>(file);
+}
+
+bool LightmapBaker::Load(const std::string& _fileName, FileHeader& _header, std::vector<uint32_t>& _texels, std::vector<LightmapFileChart>& _charts)
+{
+	std::ifstream file(_fileName, std::ios::binary);
+	if (!file || !file.read(reinterpret_cast<char*>(&_header), sizeof(_header)))
+		return false;
+	if (_header.magic != FILE_MAGIC || _header.version != FILE_VERSION || _header.dxgiFormat != DXGI_FORMAT_RGB9E5 ||
+		_header.rowPitch != _header.width * sizeof(uint32_t))
+		return false;
+
+	_texels.resize(static_cast<size_t>(_header.width) * _header.height);
+	_charts.resize(_header.chartCount);
+	file.read(reinterpret_cast<char*>(_texels.data()), _texels.size() * sizeof(uint32_t));
+	file.read(reinterpret_cast<char*>(_charts.data()), _charts.size() * sizeof(LightmapFileChart));
+	return static_cast<bool>(file);
+}
+
+uint32_t LightmapBaker::PackRGB9E5(const XMFLOAT3& _color)
+{
+	// nine bit mantissas with a five bit exponent shared between them, biased by 15
+	const float MAX_VALUE = 65408.0f; // (511 / 512) * 2^16
+	float r = _color.x > 0.0f ? std::min(_color.x, MAX_VALUE) : 0.0f;
+	float g = _color.y > 0.0f ? std::min(_color.y, MAX_VALUE) : 0.0f;
+	float b = _color.z > 0.0f ? std::min(_color.z, MAX_VALUE) : 0.0f;
+	float largest = std::max(r, std::max(g, b));
+	if (largest <= 0.0f)
+		return 0;
+
+	int32_t exponent = std::max(-16, static_cast<int32_t>(std::floor(std::log2(largest)))) + 16;
+	float scale = std::exp2(static_cast<float>(exponent - 24));
+	if (static_cast<uint32_t>(std::floor(largest / scale + 0.5f)) == 512)
+	{
+		scale *= 2.0f;
+		++exponent;
+	}
+
+	uint32_t red = static_cast<uint32_t>(std::floor(r / scale + 0.5f));
+	uint32_t green = static_cast<uint32_t>(std::floor(g / scale + 0.5f));
+	uint32_t blue = static_cast<uint32_t>(std::floor(b / scale + 0.5f));
+	return red | (green << 9) | (blue << 18) | (static_cast<uint32_t>(exponent) << 27);
+}
+
+XMFLOAT3 LightmapBaker::UnpackRGB9E5(uint32_t _packed)
+{
+	float scale = std::exp2(static_cast<float>(static_cast<int32_t>(_packed >> 27) - 24));
+	return XMFLOAT3((_packed & 0x1ff) * scale, ((_packed >> 9) & 0x1ff) * scale, ((_packed >> 18) & 0x1ff) * scale);
+}
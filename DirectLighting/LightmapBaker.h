@@ -0,0 +1,134 @@
+#pragma once
+#include <DirectXMath.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class JobSystem;
+class PathTracer;
+
+struct LightmapDesc
+{
+	uint32_t size = 1024; // texels along each side of the lightmap
+	float texelsPerUnit = 16.0f; // lowered by Build until every chart fits
+	uint32_t padding = 2; // texels around every chart, filled from its edge so filtering never reads another chart
+	uint32_t tileSize = 16; // texels along the side of one job
+};
+
+// a patch of triangles that face the same way, flattened onto their plane and given a rectangle of the lightmap
+struct LightmapChart
+{
+	uint32_t x; // the rectangle in the lightmap, padding included
+	uint32_t y;
+	uint32_t width;
+	uint32_t height;
+	DirectX::XMFLOAT3 axisU; // the lightmap's x and y across the chart's plane, scaled so a dot product with a point is in texels
+	DirectX::XMFLOAT3 axisV;
+	float offsetU; // subtracted from a point's projection onto the axes to get its texel in the rectangle
+	float offsetV;
+	DirectX::XMFLOAT3 boundsMin; // world space
+	DirectX::XMFLOAT3 boundsMax;
+	DirectX::XMFLOAT3 normal; // of the plane the chart was flattened onto, its first triangle's
+	float planeDistance; // dot(normal, point) for a point on that plane
+	uint32_t firstTriangle; // in ChartTriangles()
+	uint32_t triangleCount;
+	uint64_t lightHash; // the lights that reached the chart when it was last baked
+};
+
+// a chart as Save writes it after the texels, for whoever draws with the lightmap to find the texel under a point.
+// the layout is LightmapChart in BakedLighting.hlsli
+struct LightmapFileChart
+{
+	DirectX::XMFLOAT3 axisU; // dot(point, axisU) - offsetU is the point's texel across the whole lightmap
+	float offsetU;
+	DirectX::XMFLOAT3 axisV;
+	float offsetV;
+	DirectX::XMFLOAT3 normal;
+	float planeDistance;
+	DirectX::XMFLOAT3 boundsMin;
+	float pad0;
+	DirectX::XMFLOAT3 boundsMax;
+	float pad1;
+};
+
+// bakes the direct light on static geometry into a lightmap.
+//
+// Build splits the scene into charts of connected triangles that face the same way, projects each onto its own
+// plane at the desc's texel density and packs the rectangles into the lightmap on shelves, tallest first, lowering
+// the density until they fit. Bake finds the texels whose centres lie on a chart's triangles, in world space, and
+// adds up the light from every point and spot light that reaches the chart and the sun, with a shadow ray each
+// through the PathTracer's bvh. the padding is then filled from the chart's edge texels.
+//
+// the work is split into tiles of every chart's rectangle that run on the job system. every chart remembers a hash
+// of the lights that reached it, so a Bake after lights have moved only bakes the charts whose lights changed.
+//
+// the texels hold irradiance (multiply by albedo / pi for the light leaving the surface) and are saved as
+// R9G9B9E5_SHAREDEXP, four bytes a texel that the gpu filters as it is, behind a small header and followed by the
+// charts, so a renderer can look up a world space point without the scene the lightmap was baked from
+class LightmapBaker
+{
+public:
+	static const uint32_t FILE_MAGIC = 0x50414d4c; // "LMAP"
+	static const uint32_t FILE_VERSION = 2;
+	static const uint32_t DXGI_FORMAT_RGB9E5 = 67; // DXGI_FORMAT_R9G9B9E5_SHAREDEXP
+
+	// what Save writes ahead of the texels, which follow row by row, then chartCount LightmapFileCharts
+	struct FileHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t width;
+		uint32_t height;
+		uint32_t dxgiFormat;
+		uint32_t rowPitch; // bytes
+		uint32_t chartCount;
+	};
+
+	LightmapBaker() = default;
+	~LightmapBaker() = default;
+
+	// makes and packs the charts for everything in _scene. false if they would not fit even at a very low density
+	bool Build(PathTracer& _scene, const LightmapDesc& _desc);
+
+	// bakes every chart whose lights changed since it was last baked. returns the number of charts baked
+	uint32_t Bake(PathTracer& _scene, JobSystem* _pJobSystem = nullptr);
+
+	// every chart is baked on the next Bake, e.g. after static geometry moved
+	void Invalidate();
+
+	bool Save(const std::string& _fileName);
+
+	// reads back what Save wrote. false if the file is missing, from another version or cut short
+	static bool Load(const std::string& _fileName, FileHeader& _header, std::vector<uint32_t>& _texels, std::vector<LightmapFileChart>& _charts);
+
+	// the lightmap uv of every corner of every triangle of the scene, three per triangle, 0 to 1
+	const std::vector<DirectX::XMFLOAT2>& TriangleUvs() { return m_triangleUvs; }
+
+	DirectX::XMFLOAT3 Texel(uint32_t _x, uint32_t _y) { return m_irradiance[_y * m_desc.size + _x]; }
+	const std::vector<uint32_t>& PackedTexels() { return m_packed; }
+	const std::vector<LightmapChart>& Charts() { return m_charts; }
+	const std::vector<uint32_t>& ChartTriangles() { return m_chartTriangles; }
+	float TexelsPerUnit() { return m_desc.texelsPerUnit; }
+
+	// shared exponent packing the way d3d defines it
+	static uint32_t PackRGB9E5(const DirectX::XMFLOAT3& _color);
+	static DirectX::XMFLOAT3 UnpackRGB9E5(uint32_t _packed);
+
+private:
+	void BuildCharts(PathTracer& _scene);
+	bool PackCharts();
+	void BakeTile(PathTracer& _scene, uint32_t _chart, uint32_t _tileX, uint32_t _tileY, const std::vector<uint32_t>& _lights);
+	void Dilate(uint32_t _chart);
+	uint64_t LightHash(PathTracer& _scene, uint32_t _chart, std::vector<uint32_t>& _lights);
+
+	LightmapDesc m_desc;
+	std::vector<LightmapChart> m_charts;
+	std::vector<uint32_t> m_chartTriangles; // every chart's triangles, one after another
+	std::vector<DirectX::XMFLOAT2> m_triangleUvs;
+
+	std::vector<DirectX::XMFLOAT3> m_irradiance; // size * size
+	std::vector<uint8_t> m_covered; // whether a texel's centre is on a triangle
+	std::vector<uint32_t> m_packed;
+	bool m_invalidated = true;
+};
@@ -0,0 +1,182 @@
+#include "LzCodec.h"
+
+#include <cstring>
+#include <vector>
+
+namespace
+{
+	const uint32_t HASH_BITS = 14;
+	const uint32_t LENGTH_MASK = 15; // a length nibble this big goes on in the bytes after
+	const uint32_t SKIP_SHIFT = 5; // every 32 misses in a row the search steps one byte further
+
+	uint32_t Read32(const uint8_t* _p)
+	{
+		uint32_t value;
+		memcpy(&value, _p, sizeof(value));
+		return value;
+	}
+
+	uint64_t Read64(const uint8_t* _p)
+	{
+		uint64_t value;
+		memcpy(&value, _p, sizeof(value));
+		return value;
+	}
+
+	uint32_t Hash(uint32_t _value)
+	{
+		return (_value * 2654435761u) >> (32 - HASH_BITS);
+	}
+
+	uint8_t* WriteLength(uint8_t* _pOut, size_t _length)
+	{
+		for (; _length >= 255; _length -= 255)
+			*_pOut++ = 255;
+		*_pOut++ = static_cast<uint8_t>(_length);
+		return _pOut;
+	}
+
+	// false when the length runs past the end of the input
+	bool ReadLength(const uint8_t*& _p, const uint8_t* _pEnd, size_t& _length)
+	{
+		uint8_t byte;
+		do
+		{
+			if (_p == _pEnd)
+				return false;
+			byte = *_p++;
+			_length += byte;
+		} while (byte == 255);
+		return true;
+	}
+
+	// _literalCount bytes from _pLiterals, then a match of _matchLength at _distance back unless _matchLength is 0
+	uint8_t* WriteSequence(uint8_t* _pOut, const uint8_t* _pLiterals, size_t _literalCount, uint32_t _distance, size_t _matchLength)
+	{
+		uint8_t* pToken = _pOut++;
+		size_t matchCode = _matchLength > 0 ? _matchLength - LzCodec::MIN_MATCH : 0;
+		*pToken = static_cast<uint8_t>((_literalCount < LENGTH_MASK ? _literalCount : LENGTH_MASK) << 4 |
+			(matchCode < LENGTH_MASK ? matchCode : LENGTH_MASK));
+		if (_literalCount >= LENGTH_MASK)
+			_pOut = WriteLength(_pOut, _literalCount - LENGTH_MASK);
+		memcpy(_pOut, _pLiterals, _literalCount);
+		_pOut += _literalCount;
+		if (_matchLength == 0)
+			return _pOut;
+
+		*_pOut++ = static_cast<uint8_t>(_distance);
+		*_pOut++ = static_cast<uint8_t>(_distance >> 8);
+		if (matchCode >= LENGTH_MASK)
+			_pOut = WriteLength(_pOut, matchCode - LENGTH_MASK);
+		return _pOut;
+	}
+}
+
+size_t LzCodec::MaxCompressedSize(size_t _size)
+{
+	// all literals: the token, the length bytes and the data
+	return _size + _size / 255 + 16;
+}
+
+size_t LzCodec::Compress(const uint8_t* _pData, size_t _size, uint8_t* _pOut)
+{
+	uint8_t* pOut = _pOut;
+	size_t anchor = 0; // the first byte not yet written
+	if (_size > MIN_MATCH)
+	{
+		// where the four bytes at each hash were last seen. a stale or empty slot is caught by comparing the bytes
+		std::vector<uint32_t> table(1u << HASH_BITS, 0);
+		size_t limit = _size - MIN_MATCH;
+		size_t position = 1;
+		uint32_t misses = 0;
+		while (position <= limit)
+		{
+			uint32_t value = Read32(_pData + position);
+			uint32_t& slot = table[Hash(value)];
+			size_t candidate = slot;
+			slot = static_cast<uint32_t>(position);
+			if (candidate >= position || position - candidate > MAX_DISTANCE || Read32(_pData + candidate) != value)
+			{
+				position += 1 + (misses++ >> SKIP_SHIFT);
+				continue;
+			}
+
+			// grow the match back over literals that match too, then forward eight bytes at a time
+			while (position > anchor && candidate > 0 && _pData[position - 1] == _pData[candidate - 1])
+			{
+				position--;
+				candidate--;
+			}
+			size_t length = MIN_MATCH;
+			while (position + length + 8 <= _size && Read64(_pData + position + length) == Read64(_pData + candidate + length))
+				length += 8;
+			while (position + length < _size && _pData[position + length] == _pData[candidate + length])
+				length++;
+
+			pOut = WriteSequence(pOut, _pData + anchor, position - anchor, static_cast<uint32_t>(position - candidate), length);
+			position += length;
+			anchor = position;
+			misses = 0;
+
+			// the match's own last bytes are often where the next one starts
+			if (position - 2 <= limit)
+				table[Hash(Read32(_pData + position - 2))] = static_cast<uint32_t>(position - 2);
+		}
+	}
+	return static_cast<size_t>(WriteSequence(pOut, _pData + anchor, _size - anchor, 0, 0) - _pOut);
+}
+
+bool LzCodec::Decompress(const uint8_t* _pData, size_t _size, uint8_t* _pOut, size_t _outSize)
+{
+	const uint8_t* p = _pData;
+	const uint8_t* pEnd = _pData + _size;
+	uint8_t* pOut = _pOut;
+	uint8_t* pOutEnd = _pOut + _outSize;
+	while (p < pEnd)
+	{
+		uint8_t token = *p++;
+		size_t literalCount = token >> 4;
+		if (literalCount == LENGTH_MASK && !ReadLength(p, pEnd, literalCount))
+			return false;
+		if (literalCount > static_cast<size_t>(pEnd - p) || literalCount > static_cast<size_t>(pOutEnd - pOut))
+			return false;
+
+		// short runs, the common case, are copied as a fixed 16 bytes where both buffers have room for the overshoot
+		if (literalCount <= 16 && pEnd - p >= 16 && pOutEnd - pOut >= 16)
+			memcpy(pOut, p, 16);
+		else
+			memcpy(pOut, p, literalCount);
+		p += literalCount;
+		pOut += literalCount;
+
+		// only the last sequence ends after its literals
+		if (p == pEnd)
+			break;
+		if (pEnd - p < 2)
+			return false;
+		size_t distance = p[0] | static_cast<size_t>(p[1]) << 8;
+		p += 2;
+		size_t length = token & LENGTH_MASK;
+		if (length == LENGTH_MASK && !ReadLength(p, pEnd, length))
+			return false;
+		length += MIN_MATCH;
+		if (distance == 0 || distance > static_cast<size_t>(pOut - _pOut) || length > static_cast<size_t>(pOutEnd - pOut))
+			return false;
+
+		// a match can overlap what it writes, a distance of 1 repeats one byte. eight bytes at a time are fine once the
+		// distance is at least that, and as long as the overshoot stays inside the output it is written over later
+		const uint8_t* pMatch = pOut - distance;
+		if (distance >= 8 && length + 8 <= static_cast<size_t>(pOutEnd - pOut))
+		{
+			for (size_t i = 0; i < length; i += 8)
+				memcpy(pOut + i, pMatch + i, 8);
+		}
+		else
+		{
+			for (size_t i = 0; i < length; ++i)
+				pOut[i] = pMatch[i];
+		}
+		pOut += length;
+	}
+	return pOut == pOutEnd;
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// a byte oriented lz77 codec in the spirit of lz4, for asset data that has to come off disk faster than it could be
+// read uncompressed.
+//
+// compressed data is a run of sequences. each starts with a token byte: the high four bits count the literals that
+// follow it, the low four bits the length of the match after them less MIN_MATCH. 15 in either means more bytes of
+// the length follow, each adding up to 255, the last one less than 255. then come the literals, then the match as a
+// two byte little endian distance back into what has been written so far. the last sequence is literals only.
+//
+// Compress finds matches with a single hash of the next four bytes, greedy, and skips ahead faster through data that
+// will not compress, so incompressible data costs little. Decompress checks every length and distance against both
+// buffers, corrupt input makes it fail rather than read or write out of bounds. neither keeps state between calls,
+// so blocks compressed separately can be decompressed in any order on any thread
+namespace LzCodec
+{
+	const uint32_t MIN_MATCH = 4;
+	const uint32_t MAX_DISTANCE = 65535;
+
+	// the most Compress can write for _size bytes of input
+	size_t MaxCompressedSize(size_t _size);
+
+	// compresses _size bytes into _pOut, which has room for MaxCompressedSize(_size). returns the bytes written
+	size_t Compress(const uint8_t* _pData, size_t _size, uint8_t* _pOut);
+
+	// false unless _pData decompresses to exactly _outSize bytes
+	bool Decompress(const uint8_t* _pData, size_t _size, uint8_t* _pOut, size_t _outSize);
+}
@@ -0,0 +1,103 @@
+#include "MappedFile.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+bool MappedFile::Open(const std::string& _fileName)
+{
+	Close();
+
+#ifdef _WIN32
+	m_hFile = CreateFileA(_fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (m_hFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(m_hFile, &size) || size.QuadPart == 0)
+	{
+		Close();
+		return false;
+	}
+	m_size = static_cast<uint64_t>(size.QuadPart);
+
+	m_hMapping = CreateFileMappingA(m_hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (m_hMapping == NULL)
+	{
+		Close();
+		return false;
+	}
+	m_pData = static_cast<const uint8_t*>(MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0));
+#else
+	m_fd = open(_fileName.c_str(), O_RDONLY);
+	if (m_fd < 0)
+		return false;
+
+	struct stat status;
+	if (fstat(m_fd, &status) != 0 || status.st_size == 0)
+	{
+		Close();
+		return false;
+	}
+	m_size = static_cast<uint64_t>(status.st_size);
+
+	void* pData = mmap(nullptr, static_cast<size_t>(m_size), PROT_READ, MAP_PRIVATE, m_fd, 0);
+	m_pData = pData == MAP_FAILED ? nullptr : static_cast<const uint8_t*>(pData);
+#endif
+
+	if (!m_pData)
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::Close()
+{
+#ifdef _WIN32
+	if (m_pData)
+		UnmapViewOfFile(m_pData);
+	if (m_hMapping != NULL)
+		CloseHandle(m_hMapping);
+	if (m_hFile != INVALID_HANDLE_VALUE)
+		CloseHandle(m_hFile);
+	m_hMapping = NULL;
+	m_hFile = INVALID_HANDLE_VALUE;
+#else
+	if (m_pData)
+		munmap(const_cast<uint8_t*>(m_pData), static_cast<size_t>(m_size));
+	if (m_fd >= 0)
+		close(m_fd);
+	m_fd = -1;
+#endif
+	m_pData = nullptr;
+	m_size = 0;
+}
+
+void MappedFile::Prefetch(uint64_t _offset, uint64_t _size)
+{
+	if (!m_pData || _offset >= m_size)
+		return;
+	_size = _size < m_size - _offset ? _size : m_size - _offset;
+
+#ifdef _WIN32
+	WIN32_MEMORY_RANGE_ENTRY range;
+	range.VirtualAddress = const_cast<uint8_t*>(m_pData + _offset);
+	range.NumberOfBytes = static_cast<SIZE_T>(_size);
+	PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#else
+	// madvise wants a page aligned start
+	uint64_t pageSize = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+	uint64_t start = _offset & ~(pageSize - 1);
+	madvise(const_cast<uint8_t*>(m_pData + start), static_cast<size_t>(_size + _offset - start), MADV_WILLNEED);
+#endif
+}
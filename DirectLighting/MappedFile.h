@@ -0,0 +1,39 @@
+#pragma once
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+#include <cstdint>
+#include <string>
+
+// a whole file mapped read only into the address space (CreateFileMapping on windows, mmap on linux). pages are
+// only read from disk when they are first touched, and the os keeps them cached between runs, so data laid out the
+// way it is used can be handed on without reading or copying it first
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// false if the file could not be opened or is empty
+	bool Open(const std::string& _fileName);
+	void Close();
+
+	// asks the os to start reading _size bytes from _offset in the background, for data that is about to be used
+	void Prefetch(uint64_t _offset, uint64_t _size);
+
+	const uint8_t* Data() { return m_pData; }
+	uint64_t Size() { return m_size; }
+	bool IsOpen() { return m_pData != nullptr; }
+
+private:
+#ifdef _WIN32
+	HANDLE m_hFile = INVALID_HANDLE_VALUE;
+	HANDLE m_hMapping = NULL;
+#else
+	int m_fd = -1;
+#endif
+	const uint8_t* m_pData = nullptr;
+	uint64_t m_size = 0;
+};
@@ -0,0 +1,410 @@
+#include "MeshFile.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "JobSystem.h"
+#include "MeshImporter.h"
+#include "MeshSimplifier.h"
+
+using namespace DirectX;
+
+namespace
+{
+	const uint64_t CHECKSUM_BLOCK_SIZE = 1 << 20;
+	const uint64_t PRIME_1 = 0x9e3779b185ebca87ull; // xxhash64's
+	const uint64_t PRIME_2 = 0xc2b2ae3d27d4eb4full;
+	const uint64_t PRIME_3 = 0x165667b19e3779f9ull;
+	const uint64_t PRIME_4 = 0x85ebca77c2b2ae63ull;
+	const uint64_t PRIME_5 = 0x27d4eb2f165667c5ull;
+
+	static_assert(sizeof(MeshFileHeader) == 88, "the header is written as it is, so it must not change size");
+	static_assert(sizeof(MeshFileSection) == 32, "sections are written as they are, so they must not change size");
+	static_assert(sizeof(MeshSubmesh) == 40 && sizeof(MeshLod) == 16, "submeshes and lods are read straight from the file");
+	static_assert(sizeof(Meshlet) == 64, "meshlets are read straight from the file");
+
+	uint64_t Align(uint64_t _value, uint64_t _alignment)
+	{
+		return (_value + _alignment - 1) & ~(_alignment - 1);
+	}
+
+	uint64_t RotateLeft(uint64_t _value, uint32_t _bits)
+	{
+		return (_value << _bits) | (_value >> (64 - _bits));
+	}
+
+	uint64_t Read64(const uint8_t* _p)
+	{
+		uint64_t value;
+		memcpy(&value, _p, sizeof(value));
+		return value;
+	}
+
+	uint32_t Read32(const uint8_t* _p)
+	{
+		uint32_t value;
+		memcpy(&value, _p, sizeof(value));
+		return value;
+	}
+
+	uint64_t Round(uint64_t _lane, uint64_t _word)
+	{
+		return RotateLeft(_lane + _word * PRIME_2, 31) * PRIME_1;
+	}
+
+	uint64_t MergeRound(uint64_t _hash, uint64_t _lane)
+	{
+		return (_hash ^ Round(0, _lane)) * PRIME_1 + PRIME_4;
+	}
+
+	// xxhash64. the rotations carry every bit of a word into the low bits of its lane, and the final mix spreads them
+	// over the whole hash, so no two bit flips cancel the way they would with multiplies alone
+	uint64_t HashBlock(const uint8_t* _pData, uint64_t _size, uint64_t _seed)
+	{
+		const uint8_t* p = _pData;
+		const uint8_t* pEnd = _pData + _size;
+		uint64_t hash;
+		if (_size >= 32)
+		{
+			uint64_t lanes[4] = { _seed + PRIME_1 + PRIME_2, _seed + PRIME_2, _seed, _seed - PRIME_1 };
+			for (; p + 32 <= pEnd; p += 32)
+			{
+				for (uint32_t lane = 0; lane < 4; ++lane)
+					lanes[lane] = Round(lanes[lane], Read64(p + lane * 8));
+			}
+			hash = RotateLeft(lanes[0], 1) + RotateLeft(lanes[1], 7) + RotateLeft(lanes[2], 12) + RotateLeft(lanes[3], 18);
+			for (uint32_t lane = 0; lane < 4; ++lane)
+				hash = MergeRound(hash, lanes[lane]);
+		}
+		else
+			hash = _seed + PRIME_5;
+		hash += _size;
+
+		for (; p + 8 <= pEnd; p += 8)
+			hash = RotateLeft(hash ^ Round(0, Read64(p)), 27) * PRIME_1 + PRIME_4;
+		if (p + 4 <= pEnd)
+		{
+			hash = RotateLeft(hash ^ Read32(p) * PRIME_1, 23) * PRIME_2 + PRIME_3;
+			p += 4;
+		}
+		for (; p < pEnd; ++p)
+			hash = RotateLeft(hash ^ *p * PRIME_5, 11) * PRIME_1;
+
+		hash ^= hash >> 33;
+		hash *= PRIME_2;
+		hash ^= hash >> 29;
+		hash *= PRIME_3;
+		hash ^= hash >> 32;
+		return hash;
+	}
+
+	uint64_t HeaderChecksum(const MeshFileHeader& _header, const MeshFileSection* _pSections)
+	{
+		std::vector<uint8_t> bytes(sizeof(MeshFileHeader) + _header.sectionCount * sizeof(MeshFileSection));
+		memcpy(bytes.data(), &_header, sizeof(MeshFileHeader));
+		memcpy(bytes.data() + sizeof(MeshFileHeader), _pSections, _header.sectionCount * sizeof(MeshFileSection));
+		memset(bytes.data() + offsetof(MeshFileHeader, checksum), 0, sizeof(uint64_t));
+		return MeshFile::Checksum(bytes.data(), bytes.size());
+	}
+
+	// the size every section has to be for the header's counts
+	uint64_t ExpectedSize(const MeshFileHeader& _header, const MeshFileSection& _section)
+	{
+		switch (_section.type)
+		{
+		case MESH_SECTION_ATTRIBUTES: return static_cast<uint64_t>(_section.count) * sizeof(MeshVertexAttribute);
+		case MESH_SECTION_VERTICES: return static_cast<uint64_t>(_header.vertexCount) * _header.vertexStride;
+		case MESH_SECTION_INDICES: return static_cast<uint64_t>(_header.indexCount) * _header.indexSize;
+		case MESH_SECTION_SUBMESHES: return static_cast<uint64_t>(_section.count) * sizeof(MeshSubmesh);
+		case MESH_SECTION_LODS: return static_cast<uint64_t>(_section.count) * sizeof(MeshLod);
+		case MESH_SECTION_MESHLETS: return static_cast<uint64_t>(_section.count) * sizeof(Meshlet);
+		case MESH_SECTION_MESHLET_VERTICES: return static_cast<uint64_t>(_section.count) * sizeof(uint32_t);
+		case MESH_SECTION_MESHLET_TRIANGLES: return _section.count;
+		default: return _section.size;
+		}
+	}
+}
+
+bool MeshFile::Open(const std::string& _fileName, bool _verifyChecksums, JobSystem* _pJobSystem)
+{
+	Close();
+	if (!m_file.Open(_fileName))
+		return false;
+
+	const uint8_t* pData = m_file.Data();
+	uint64_t size = m_file.Size();
+	const MeshFileHeader* pHeader = reinterpret_cast<const MeshFileHeader*>(pData);
+	if (size < sizeof(MeshFileHeader) || pHeader->magic != FILE_MAGIC || pHeader->version != FILE_VERSION || pHeader->fileSize != size ||
+		pHeader->sectionCount > (size - sizeof(MeshFileHeader)) / sizeof(MeshFileSection) ||
+		(pHeader->indexSize != 2 && pHeader->indexSize != 4) || pHeader->vertexStride == 0)
+	{
+		Close();
+		return false;
+	}
+
+	// the vertices and indices are about to go to the gpu, so start reading them in now
+	m_file.Prefetch(0, size);
+
+	const MeshFileSection* pSections = reinterpret_cast<const MeshFileSection*>(pData + sizeof(MeshFileHeader));
+	if (HeaderChecksum(*pHeader, pSections) != pHeader->checksum)
+	{
+		Close();
+		return false;
+	}
+
+	// sections of types this version does not know are skipped, the ones it does know have to add up
+	bool valid = true;
+	for (uint32_t i = 0; i < pHeader->sectionCount && valid; ++i)
+	{
+		const MeshFileSection& section = pSections[i];
+		valid = section.offset % SECTION_ALIGNMENT == 0 && section.offset <= size && section.size <= size - section.offset &&
+			section.size == ExpectedSize(*pHeader, section);
+		if (valid && section.type < MESH_SECTION_COUNT)
+		{
+			valid = m_pSections[section.type] == nullptr;
+			m_pSections[section.type] = pData + section.offset;
+			m_counts[section.type] = section.count;
+		}
+	}
+	valid = valid && m_pSections[MESH_SECTION_ATTRIBUTES] && m_pSections[MESH_SECTION_VERTICES] && m_pSections[MESH_SECTION_INDICES];
+
+	// ranges inside the mesh are checked once here so nothing that reads them has to
+	for (uint32_t i = 0; valid && i < m_counts[MESH_SECTION_ATTRIBUTES]; ++i)
+		valid = static_cast<const MeshVertexAttribute*>(m_pSections[MESH_SECTION_ATTRIBUTES])[i].offset < pHeader->vertexStride;
+	for (uint32_t i = 0; valid && i < m_counts[MESH_SECTION_SUBMESHES]; ++i)
+	{
+		const MeshSubmesh& submesh = static_cast<const MeshSubmesh*>(m_pSections[MESH_SECTION_SUBMESHES])[i];
+		valid = submesh.firstIndex <= pHeader->indexCount && submesh.indexCount <= pHeader->indexCount - submesh.firstIndex;
+	}
+	for (uint32_t i = 0; valid && i < m_counts[MESH_SECTION_LODS]; ++i)
+	{
+		const MeshLod& lod = static_cast<const MeshLod*>(m_pSections[MESH_SECTION_LODS])[i];
+		valid = lod.firstSubmesh <= m_counts[MESH_SECTION_SUBMESHES] && lod.submeshCount <= m_counts[MESH_SECTION_SUBMESHES] - lod.firstSubmesh;
+	}
+	uint32_t meshletTriangleCount = m_counts[MESH_SECTION_MESHLET_TRIANGLES] / 3;
+	for (uint32_t i = 0; valid && i < m_counts[MESH_SECTION_MESHLETS]; ++i)
+	{
+		const Meshlet& meshlet = static_cast<const Meshlet*>(m_pSections[MESH_SECTION_MESHLETS])[i];
+		valid = meshlet.triangleCount <= pHeader->indexCount / 3 && meshlet.firstIndex <= pHeader->indexCount - meshlet.triangleCount * 3 &&
+			meshlet.vertexOffset <= m_counts[MESH_SECTION_MESHLET_VERTICES] && meshlet.vertexCount <= m_counts[MESH_SECTION_MESHLET_VERTICES] - meshlet.vertexOffset &&
+			meshlet.triangleOffset <= meshletTriangleCount && meshlet.triangleCount <= meshletTriangleCount - meshlet.triangleOffset;
+	}
+	for (uint32_t i = 0; valid && i < m_counts[MESH_SECTION_MESHLET_VERTICES]; ++i)
+		valid = static_cast<const uint32_t*>(m_pSections[MESH_SECTION_MESHLET_VERTICES])[i] < pHeader->vertexCount;
+
+	for (uint32_t i = 0; valid && _verifyChecksums && i < pHeader->sectionCount; ++i)
+		valid = Checksum(pData + pSections[i].offset, pSections[i].size, _pJobSystem) == pSections[i].checksum;
+
+	if (!valid)
+	{
+		Close();
+		return false;
+	}
+	m_pHeader = pHeader;
+	return true;
+}
+
+void MeshFile::Close()
+{
+	m_file.Close();
+	m_pHeader = nullptr;
+	std::fill(m_pSections, m_pSections + MESH_SECTION_COUNT, nullptr);
+	std::fill(m_counts, m_counts + MESH_SECTION_COUNT, 0);
+}
+
+const MeshVertexAttribute* MeshFile::FindAttribute(MeshAttributeSemantic _semantic)
+{
+	for (uint32_t i = 0; i < AttributeCount(); ++i)
+	{
+		if (Attributes()[i].semantic == _semantic)
+			return &Attributes()[i];
+	}
+	return nullptr;
+}
+
+bool MeshFile::Write(const std::string& _fileName, const MeshFileContents& _contents)
+{
+	struct SectionSource
+	{
+		MeshSectionType type;
+		uint32_t count;
+		const void* pData;
+		uint64_t size;
+	};
+	SectionSource sources[] = {
+		{ MESH_SECTION_ATTRIBUTES, static_cast<uint32_t>(_contents.attributes.size()), _contents.attributes.data(), _contents.attributes.size() * sizeof(MeshVertexAttribute) },
+		{ MESH_SECTION_VERTICES, _contents.vertexCount, _contents.pVertices, static_cast<uint64_t>(_contents.vertexCount) * _contents.vertexStride },
+		{ MESH_SECTION_INDICES, _contents.indexCount, _contents.pIndices, static_cast<uint64_t>(_contents.indexCount) * _contents.indexSize },
+		{ MESH_SECTION_SUBMESHES, static_cast<uint32_t>(_contents.submeshes.size()), _contents.submeshes.data(), _contents.submeshes.size() * sizeof(MeshSubmesh) },
+		{ MESH_SECTION_LODS, static_cast<uint32_t>(_contents.lods.size()), _contents.lods.data(), _contents.lods.size() * sizeof(MeshLod) },
+		{ MESH_SECTION_MESHLETS, static_cast<uint32_t>(_contents.meshlets.size()), _contents.meshlets.data(), _contents.meshlets.size() * sizeof(Meshlet) },
+		{ MESH_SECTION_MESHLET_VERTICES, static_cast<uint32_t>(_contents.meshletVertices.size()), _contents.meshletVertices.data(),
+			_contents.meshletVertices.size() * sizeof(uint32_t) },
+		{ MESH_SECTION_MESHLET_TRIANGLES, static_cast<uint32_t>(_contents.meshletTriangles.size()), _contents.meshletTriangles.data(),
+			_contents.meshletTriangles.size() },
+	};
+	const uint32_t sectionCount = sizeof(sources) / sizeof(sources[0]);
+
+	MeshFileHeader header = {};
+	header.magic = FILE_MAGIC;
+	header.version = FILE_VERSION;
+	header.sectionCount = sectionCount;
+	header.vertexCount = _contents.vertexCount;
+	header.vertexStride = _contents.vertexStride;
+	header.indexCount = _contents.indexCount;
+	header.indexSize = _contents.indexSize;
+	header.boundingRadius = _contents.boundingRadius;
+	header.boundsMin = _contents.boundsMin;
+	header.boundsMax = _contents.boundsMax;
+	header.sourceSize = _contents.sourceSize;
+	header.sourceTime = _contents.sourceTime;
+
+	MeshFileSection sections[sectionCount];
+	uint64_t offset = Align(sizeof(MeshFileHeader) + sizeof(sections), SECTION_ALIGNMENT);
+	for (uint32_t i = 0; i < sectionCount; ++i)
+	{
+		sections[i].type = sources[i].type;
+		sections[i].count = sources[i].count;
+		sections[i].offset = offset;
+		sections[i].size = sources[i].size;
+		sections[i].checksum = Checksum(sources[i].pData, sources[i].size);
+		offset = Align(offset + sources[i].size, SECTION_ALIGNMENT);
+	}
+	header.fileSize = sections[sectionCount - 1].offset + sections[sectionCount - 1].size;
+	header.checksum = HeaderChecksum(header, sections);
+
+	std::ofstream file(_fileName, std::ios::binary);
+	if (!file)
+		return false;
+
+	const char padding[SECTION_ALIGNMENT] = {};
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(sections), sizeof(sections));
+	uint64_t written = sizeof(header) + sizeof(sections);
+	for (uint32_t i = 0; i < sectionCount; ++i)
+	{
+		file.write(padding, static_cast<std::streamsize>(sections[i].offset - written));
+		file.write(static_cast<const char*>(sources[i].pData), static_cast<std::streamsize>(sources[i].size));
+		written = sections[i].offset + sections[i].size;
+	}
+	return static_cast<bool>(file);
+}
+
+bool MeshFile::Convert(const std::string& _source, const std::string& _destination, JobSystem* _pJobSystem, MeshOptimizeStats* _pStats)
+{
+	MeshImporter importer;
+	ImportedMesh mesh;
+	if (!importer.Load(_source, mesh, _pJobSystem))
+		return false;
+
+	// the triangles in vertex cache order and the vertices in the order they are fetched
+	MeshOptimizer::Optimize(mesh, MeshOptimizeDesc(), _pStats);
+
+	// the coarser levels use the same vertices, so they are made before anything renumbers them
+	std::vector<MeshLodLevel> levels;
+	MeshSimplifier::GenerateLods(mesh, MeshLodDesc(), levels, _pJobSystem);
+
+	// the meshlets take over level 0's part of the index buffer and the other levels follow it, after which the
+	// vertices are put back in the order they are now used
+	MeshletData meshlets;
+	if (!mesh.vertices.empty())
+	{
+		MeshletBuilder::Build(levels[0].indices.data(), static_cast<uint32_t>(levels[0].indices.size()), &mesh.vertices[0].position.x,
+			sizeof(MeshVertex), static_cast<uint32_t>(mesh.vertices.size()), meshlets);
+		mesh.indices.swap(meshlets.indices);
+		for (size_t level = 1; level < levels.size(); ++level)
+			mesh.indices.insert(mesh.indices.end(), levels[level].indices.begin(), levels[level].indices.end());
+		std::vector<uint32_t> remap;
+		MeshOptimizer::OptimizeVertexFetch(mesh, &remap);
+		for (uint32_t& vertex : meshlets.vertices)
+			vertex = remap[vertex];
+	}
+
+	float radiusSquared = 0.0f;
+	for (const MeshVertex& vertex : mesh.vertices)
+		radiusSquared = std::max(radiusSquared, XMVectorGetX(XMVector3LengthSq(XMLoadFloat3(&vertex.position))));
+
+	std::vector<PackedVertex> vertices(mesh.vertices.size());
+	VertexCompression::Compress(mesh.vertices.data(), static_cast<uint32_t>(vertices.size()), mesh.hasColors, mesh.boundsMin, mesh.boundsMax,
+		vertices.data(), _pJobSystem);
+
+	// half the index bandwidth for any mesh that can be addressed with 16 bits
+	std::vector<uint16_t> shortIndices;
+	bool useShortIndices = VertexCompression::FitsIn16Bits(static_cast<uint32_t>(vertices.size()));
+	if (useShortIndices)
+		shortIndices.assign(mesh.indices.begin(), mesh.indices.end());
+
+	MeshFileContents contents;
+	contents.pVertices = vertices.data();
+	contents.vertexCount = static_cast<uint32_t>(vertices.size());
+	contents.vertexStride = sizeof(PackedVertex);
+	contents.attributes.push_back({ MESH_SEMANTIC_POSITION, FORMAT_UNORM16X4, static_cast<uint32_t>(offsetof(PackedVertex, position)) });
+	contents.attributes.push_back({ MESH_SEMANTIC_NORMAL, FORMAT_SNORM16X2, static_cast<uint32_t>(offsetof(PackedVertex, normal)) });
+	contents.attributes.push_back({ MESH_SEMANTIC_COLOR, FORMAT_RGBA8, static_cast<uint32_t>(offsetof(PackedVertex, color)) });
+	contents.pIndices = useShortIndices ? static_cast<const void*>(shortIndices.data()) : mesh.indices.data();
+	contents.indexCount = static_cast<uint32_t>(mesh.indices.size());
+	contents.indexSize = useShortIndices ? sizeof(uint16_t) : sizeof(uint32_t);
+
+	// one submesh per level, in the order they were put in the index buffer
+	uint32_t firstIndex = 0;
+	for (uint32_t level = 0; level < levels.size(); ++level)
+	{
+		uint32_t indexCount = static_cast<uint32_t>(levels[level].indices.size());
+		MeshSubmesh submesh = { firstIndex, indexCount, 0, level, mesh.boundsMin, mesh.boundsMax };
+		contents.submeshes.push_back(submesh);
+		MeshLod lod = { level, 1, levels[level].error, 0 };
+		contents.lods.push_back(lod);
+		firstIndex += indexCount;
+	}
+	contents.meshlets.swap(meshlets.meshlets);
+	contents.meshletVertices.swap(meshlets.vertices);
+	contents.meshletTriangles.swap(meshlets.triangles);
+	contents.boundsMin = mesh.boundsMin;
+	contents.boundsMax = mesh.boundsMax;
+	contents.boundingRadius = std::sqrt(radiusSquared);
+	SourceStamp(_source, contents.sourceSize, contents.sourceTime);
+	return Write(_destination, contents);
+}
+
+void MeshFile::SourceStamp(const std::string& _fileName, uint64_t& _size, uint64_t& _time)
+{
+#ifdef _WIN32
+	struct _stat64 status;
+	bool found = _stat64(_fileName.c_str(), &status) == 0;
+#else
+	struct stat status;
+	bool found = stat(_fileName.c_str(), &status) == 0;
+#endif
+	_size = found ? static_cast<uint64_t>(status.st_size) : 0;
+	_time = found ? static_cast<uint64_t>(status.st_mtime) : 0;
+}
+
+uint64_t MeshFile::Checksum(const void* _pData, uint64_t _size, JobSystem* _pJobSystem)
+{
+	const uint8_t* pData = static_cast<const uint8_t*>(_pData);
+	uint32_t blockCount = static_cast<uint32_t>((_size + CHECKSUM_BLOCK_SIZE - 1) / CHECKSUM_BLOCK_SIZE);
+	std::vector<uint64_t> blockHashes(blockCount);
+	auto hashBlocks = [&](unsigned int _begin, unsigned int _end)
+	{
+		for (unsigned int block = _begin; block < _end; ++block)
+		{
+			uint64_t offset = block * CHECKSUM_BLOCK_SIZE;
+			blockHashes[block] = HashBlock(pData + offset, std::min(CHECKSUM_BLOCK_SIZE, _size - offset), 0);
+		}
+	};
+	if (_pJobSystem && blockCount > 1)
+		_pJobSystem->ParallelFor(blockCount, 1, hashBlocks);
+	else
+		hashBlocks(0, blockCount);
+
+	// data that fits one block is that block's hash, as xxhash64 itself would give. more blocks are hashed again in
+	// order, seeded with the size
+	if (blockCount <= 1)
+		return blockCount == 1 ? blockHashes[0] : HashBlock(pData, 0, 0);
+	return HashBlock(reinterpret_cast<const uint8_t*>(blockHashes.data()), blockHashes.size() * sizeof(uint64_t), _size);
+}
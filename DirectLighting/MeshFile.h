@@ -0,0 +1,181 @@
+#pragma once
+#include <DirectXMath.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+#include "MeshletBuilder.h"
+#include "MeshOptimizer.h"
+#include "VertexCompression.h"
+
+class JobSystem;
+
+enum MeshSectionType : uint32_t
+{
+	MESH_SECTION_ATTRIBUTES, // MeshVertexAttribute[]
+	MESH_SECTION_VERTICES, // vertexCount * vertexStride bytes, ready to copy into a vertex buffer
+	MESH_SECTION_INDICES, // indexCount * indexSize bytes, ready to copy into an index buffer
+	MESH_SECTION_SUBMESHES, // MeshSubmesh[]
+	MESH_SECTION_LODS, // MeshLod[]
+	MESH_SECTION_MESHLETS, // Meshlet[]
+	MESH_SECTION_MESHLET_VERTICES, // uint32_t[], see MeshletData::vertices
+	MESH_SECTION_MESHLET_TRIANGLES, // uint8_t[], see MeshletData::triangles
+	MESH_SECTION_COUNT,
+};
+
+enum MeshAttributeSemantic : uint32_t
+{
+	MESH_SEMANTIC_POSITION,
+	MESH_SEMANTIC_NORMAL,
+	MESH_SEMANTIC_TEXCOORD,
+	MESH_SEMANTIC_COLOR,
+};
+
+// one element of the vertex, so a loader can check the file matches its input layout before using it
+struct MeshVertexAttribute
+{
+	uint32_t semantic; // MeshAttributeSemantic
+	uint32_t format; // a DXGI_FORMAT
+	uint32_t offset; // bytes into the vertex
+};
+
+struct MeshSubmesh
+{
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	int32_t baseVertex;
+	uint32_t lod;
+	DirectX::XMFLOAT3 boundsMin;
+	DirectX::XMFLOAT3 boundsMax;
+};
+
+struct MeshLod
+{
+	uint32_t firstSubmesh;
+	uint32_t submeshCount;
+	float error; // how far, in object space units, this level strays from the full mesh
+	uint32_t padding;
+};
+
+struct MeshFileSection
+{
+	uint32_t type; // MeshSectionType
+	uint32_t count; // elements in the section
+	uint64_t offset; // bytes from the start of the file, a multiple of SECTION_ALIGNMENT
+	uint64_t size; // bytes
+	uint64_t checksum; // MeshFile::Checksum of the section's bytes
+};
+
+struct MeshFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t fileSize;
+	uint32_t sectionCount; // the section table follows the header
+	uint32_t vertexCount;
+	uint32_t vertexStride;
+	uint32_t indexCount;
+	uint32_t indexSize; // 2 or 4 bytes
+	float boundingRadius; // around the mesh's origin
+	DirectX::XMFLOAT3 boundsMin; // also what quantised positions are relative to
+	DirectX::XMFLOAT3 boundsMax;
+	uint64_t sourceSize; // of the file it was converted from, to tell when it is out of date
+	uint64_t sourceTime;
+	uint64_t checksum; // of the header, with this set to 0, and the section table
+};
+
+// everything Write puts in a file. the pointers are only read during the call
+struct MeshFileContents
+{
+	const void* pVertices = nullptr;
+	uint32_t vertexCount = 0;
+	uint32_t vertexStride = 0;
+	std::vector<MeshVertexAttribute> attributes;
+	const void* pIndices = nullptr;
+	uint32_t indexCount = 0;
+	uint32_t indexSize = 4;
+	std::vector<MeshSubmesh> submeshes;
+	std::vector<MeshLod> lods;
+	std::vector<Meshlet> meshlets;
+	std::vector<uint32_t> meshletVertices;
+	std::vector<uint8_t> meshletTriangles;
+	DirectX::XMFLOAT3 boundsMin = DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
+	DirectX::XMFLOAT3 boundsMax = DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
+	float boundingRadius = 0.0f;
+	uint64_t sourceSize = 0;
+	uint64_t sourceTime = 0;
+};
+
+// the runtime mesh container. a file is a header, a table of sections and then the sections themselves, each
+// starting on a SECTION_ALIGNMENT boundary, in exactly the layout the gpu and the rest of the engine read them in.
+// Open maps the file and checks it, after which the vertex and index sections are pointers into the mapping that
+// go straight to the upload heap: nothing is parsed, converted or copied per vertex.
+//
+// the header and every section carry a checksum, which is checked block by block on the job system, and checking
+// can be turned off for files that were just written. files from another version are rejected, to be converted
+// again
+class MeshFile
+{
+public:
+	static const uint32_t FILE_MAGIC = 0x4853454d; // "MESH"
+	static const uint32_t FILE_VERSION = 4; // 2: PackedVertex and 16 bit indices, 3: meshlets, 4: xxhash64 checksums
+	static const uint32_t SECTION_ALIGNMENT = 64;
+	static const uint32_t FORMAT_FLOAT3 = 6; // DXGI_FORMAT_R32G32B32_FLOAT
+	static const uint32_t FORMAT_FLOAT4 = 2; // DXGI_FORMAT_R32G32B32A32_FLOAT
+	static const uint32_t FORMAT_UNORM16X4 = 11; // DXGI_FORMAT_R16G16B16A16_UNORM
+	static const uint32_t FORMAT_RGB10A2 = 24; // DXGI_FORMAT_R10G10B10A2_UNORM
+	static const uint32_t FORMAT_RGBA8 = 28; // DXGI_FORMAT_R8G8B8A8_UNORM
+	static const uint32_t FORMAT_SNORM16X2 = 37; // DXGI_FORMAT_R16G16_SNORM
+
+	MeshFile() = default;
+	~MeshFile() = default;
+
+	// false if the file is missing, truncated, from another version or fails a checksum
+	bool Open(const std::string& _fileName, bool _verifyChecksums = true, JobSystem* _pJobSystem = nullptr);
+	void Close();
+	bool IsOpen() { return m_pHeader != nullptr; }
+
+	const MeshFileHeader& Header() { return *m_pHeader; }
+	const void* Vertices() { return m_pSections[MESH_SECTION_VERTICES]; }
+	const void* Indices() { return m_pSections[MESH_SECTION_INDICES]; }
+	uint64_t VertexBytes() { return static_cast<uint64_t>(m_pHeader->vertexCount) * m_pHeader->vertexStride; }
+	uint64_t IndexBytes() { return static_cast<uint64_t>(m_pHeader->indexCount) * m_pHeader->indexSize; }
+	const MeshVertexAttribute* Attributes() { return static_cast<const MeshVertexAttribute*>(m_pSections[MESH_SECTION_ATTRIBUTES]); }
+	uint32_t AttributeCount() { return m_counts[MESH_SECTION_ATTRIBUTES]; }
+	const MeshSubmesh* Submeshes() { return static_cast<const MeshSubmesh*>(m_pSections[MESH_SECTION_SUBMESHES]); }
+	uint32_t SubmeshCount() { return m_counts[MESH_SECTION_SUBMESHES]; }
+	const MeshLod* Lods() { return static_cast<const MeshLod*>(m_pSections[MESH_SECTION_LODS]); }
+	uint32_t LodCount() { return m_counts[MESH_SECTION_LODS]; }
+	const Meshlet* Meshlets() { return static_cast<const Meshlet*>(m_pSections[MESH_SECTION_MESHLETS]); }
+	uint32_t MeshletCount() { return m_counts[MESH_SECTION_MESHLETS]; }
+	const uint32_t* MeshletVertices() { return static_cast<const uint32_t*>(m_pSections[MESH_SECTION_MESHLET_VERTICES]); }
+	const uint8_t* MeshletTriangles() { return static_cast<const uint8_t*>(m_pSections[MESH_SECTION_MESHLET_TRIANGLES]); }
+
+	// the attribute with _semantic, nullptr if the vertex has none
+	const MeshVertexAttribute* FindAttribute(MeshAttributeSemantic _semantic);
+
+	static bool Write(const std::string& _fileName, const MeshFileContents& _contents);
+
+	// imports _source (anything MeshImporter reads), reorders it with MeshOptimizer, makes its lods with
+	// MeshSimplifier, splits the full mesh into meshlets and writes it to _destination as PackedVertex, with 16 bit
+	// indices whenever there are few enough vertices. the index buffer holds the meshlets one after the other, so each
+	// one can be drawn on its own, followed by the coarser levels, one submesh and one MeshLod each. _pStats gets what
+	// the reordering did
+	static bool Convert(const std::string& _source, const std::string& _destination, JobSystem* _pJobSystem = nullptr,
+		MeshOptimizeStats* _pStats = nullptr);
+
+	// the size and modification time of a file, 0 if there is no such file
+	static void SourceStamp(const std::string& _fileName, uint64_t& _size, uint64_t& _time);
+
+	// xxhash64, four independent lanes so it keeps up with memory. the data is hashed in blocks that _pJobSystem shares
+	// out, and the block hashes are hashed in order, so the result is always the same
+	static uint64_t Checksum(const void* _pData, uint64_t _size, JobSystem* _pJobSystem = nullptr);
+
+private:
+	MappedFile m_file;
+	const MeshFileHeader* m_pHeader = nullptr;
+	const void* m_pSections[MESH_SECTION_COUNT] = {};
+	uint32_t m_counts[MESH_SECTION_COUNT] = {};
+};
@@ -0,0 +1,1520 @@
+#include "MeshImporter.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cctype>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <functional>
+
+#include "JobSystem.h"
+
+using namespace DirectX;
+
+namespace
+{
+	const uint32_t NO_INDEX = 0xffffffff;
+	const uint32_t VERTICES_PER_JOB = 16384;
+	const uint32_t TRIANGLES_PER_JOB = 16384;
+	const uint32_t MAX_JSON_DEPTH = 64;
+
+	typedef std::chrono::high_resolution_clock Clock;
+
+	double MillisecondsSince(Clock::time_point _start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - _start).count();
+	}
+
+	void ForRange(JobSystem* _pJobSystem, uint32_t _count, uint32_t _grainSize, const std::function<void(unsigned int, unsigned int)>& _func)
+	{
+		if (_pJobSystem)
+			_pJobSystem->ParallelFor(_count, _grainSize, _func);
+		else
+			_func(0, _count);
+	}
+
+	// reserves room for _size elements, at least doubling so growing a window at a time stays linear
+	template <typename T>
+	void GrowCapacity(std::vector<T>& _vector, size_t _size)
+	{
+		if (_size > _vector.capacity())
+			_vector.reserve(std::max(_size, _vector.capacity() * 2));
+	}
+
+	bool ReadWholeFile(const std::string& _fileName, std::vector<uint8_t>& _data)
+	{
+		std::ifstream file(_fileName, std::ios::binary | std::ios::ate);
+		if (!file)
+			return false;
+
+		std::streamoff size = file.tellg();
+		file.seekg(0, std::ios::beg);
+		_data.resize(static_cast<size_t>(size));
+		file.read(reinterpret_cast<char*>(_data.data()), size);
+		return static_cast<bool>(file);
+	}
+
+	//==============================================================================================================
+	// numbers
+	//==============================================================================================================
+
+	bool IsSpace(char _c) { return _c == ' ' || _c == '\t' || _c == '\r'; }
+	bool IsDigit(char _c) { return _c >= '0' && _c <= '9'; }
+
+	const char* SkipSpaces(const char* _p, const char* _end)
+	{
+		while (_p < _end && IsSpace(*_p))
+			++_p;
+		return _p;
+	}
+
+	// strtod is locale dependent and far slower than it needs to be for the numbers meshes are made of. up to 19
+	// significant digits go into an integer that is scaled by an exact power of ten once, which is correctly rounded
+	// for the floats an exporter writes. returns nullptr if there is no number at _p
+	const char* ParseNumber(const char* _p, const char* _end, double& _value)
+	{
+		static const double POWERS_OF_TEN[] = {
+			1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+			1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+		bool negative = false;
+		if (_p < _end && (*_p == '-' || *_p == '+'))
+		{
+			negative = *_p == '-';
+			++_p;
+		}
+
+		uint64_t mantissa = 0;
+		int32_t exponent = 0;
+		uint32_t significantDigits = 0;
+		bool anyDigits = false;
+		for (; _p < _end && IsDigit(*_p); ++_p)
+		{
+			anyDigits = true;
+			if (significantDigits < 19)
+			{
+				mantissa = mantissa * 10 + (*_p - '0');
+				significantDigits += mantissa != 0;
+			}
+			else
+				++exponent;
+		}
+		if (_p < _end && *_p == '.')
+		{
+			for (++_p; _p < _end && IsDigit(*_p); ++_p)
+			{
+				anyDigits = true;
+				if (significantDigits < 19)
+				{
+					mantissa = mantissa * 10 + (*_p - '0');
+					significantDigits += mantissa != 0;
+					--exponent;
+				}
+			}
+		}
+		if (!anyDigits)
+			return nullptr;
+
+		if (_p < _end && (*_p == 'e' || *_p == 'E'))
+		{
+			const char* p = _p + 1;
+			bool negativeExponent = false;
+			if (p < _end && (*p == '-' || *p == '+'))
+			{
+				negativeExponent = *p == '-';
+				++p;
+			}
+			if (p < _end && IsDigit(*p))
+			{
+				int32_t value = 0;
+				for (; p < _end && IsDigit(*p); ++p)
+					value = std::min(value * 10 + (*p - '0'), 100000);
+				exponent += negativeExponent ? -value : value;
+				_p = p;
+			}
+		}
+
+		double result = static_cast<double>(mantissa);
+		if (exponent < 0)
+			result = exponent >= -22 ? result / POWERS_OF_TEN[-exponent] : result * std::pow(10.0, exponent);
+		else if (exponent > 0)
+			result = exponent <= 22 ? result * POWERS_OF_TEN[exponent] : result * std::pow(10.0, exponent);
+		_value = negative ? -result : result;
+		return _p;
+	}
+
+	const char* ParseFloat(const char* _p, const char* _end, float& _value)
+	{
+		double value;
+		_p = ParseNumber(SkipSpaces(_p, _end), _end, value);
+		_value = static_cast<float>(value);
+		return _p;
+	}
+
+	const char* ParseInteger(const char* _p, const char* _end, int32_t& _value)
+	{
+		bool negative = false;
+		if (_p < _end && *_p == '-')
+		{
+			negative = true;
+			++_p;
+		}
+		if (_p >= _end || !IsDigit(*_p))
+			return nullptr;
+
+		int64_t value = 0;
+		for (; _p < _end && IsDigit(*_p); ++_p)
+		{
+			value = value * 10 + (*_p - '0');
+			if (value > INT32_MAX)
+				return nullptr;
+		}
+		_value = static_cast<int32_t>(negative ? -value : value);
+		return _p;
+	}
+
+	//==============================================================================================================
+	// obj
+	//==============================================================================================================
+
+	const uint32_t RELATIVE_POSITION = 1;
+	const uint32_t RELATIVE_UV = 2;
+	const uint32_t RELATIVE_NORMAL = 4;
+	const int32_t MISSING = INT32_MIN;
+
+	// one corner of a triangle as the file gave it. indices are 0 based, either absolute or, for the file's negative
+	// indices, relative to the first element of the chunk the corner was parsed in
+	struct ObjCorner
+	{
+		int32_t position;
+		int32_t uv;
+		int32_t normal;
+		uint32_t relative; // RELATIVE_ flags
+	};
+
+	// everything parsed from one run of whole lines
+	struct ObjChunk
+	{
+		const char* begin;
+		const char* end;
+		std::vector<XMFLOAT3> positions;
+		std::vector<XMFLOAT3> colors; // empty until the chunk's first coloured position, then one per position
+		std::vector<XMFLOAT2> uvs;
+		std::vector<XMFLOAT3> normals;
+		std::vector<ObjCorner> corners; // three per triangle
+		bool failed;
+	};
+
+	// the welded vertex, as absolute indices into the file's arrays
+	struct ObjVertexKey
+	{
+		uint32_t position;
+		uint32_t uv;
+		uint32_t normal;
+	};
+
+	// welds corners by chaining every vertex off its position. a position rarely has more than a handful of
+	// uv/normal pairs, and faces use positions near each other in the file, so this stays in cache far better than
+	// hashing the whole key would
+	class ObjWelder
+	{
+	public:
+		uint32_t Insert(std::vector<ObjVertexKey>& _keys, const ObjVertexKey& _key)
+		{
+			if (_key.position >= m_heads.size())
+				m_heads.resize(std::max<size_t>(_key.position + 1, m_heads.size() * 2), NO_INDEX);
+
+			for (uint32_t vertex = m_heads[_key.position]; vertex != NO_INDEX; vertex = m_next[vertex])
+			{
+				if (_keys[vertex].uv == _key.uv && _keys[vertex].normal == _key.normal)
+					return vertex;
+			}
+
+			uint32_t vertex = static_cast<uint32_t>(_keys.size());
+			_keys.push_back(_key);
+			m_next.push_back(m_heads[_key.position]);
+			m_heads[_key.position] = vertex;
+			return vertex;
+		}
+
+	private:
+		std::vector<uint32_t> m_heads; // the last vertex made for every position
+		std::vector<uint32_t> m_next; // the vertex made before it for the same position
+	};
+
+	bool IsKeyword(const char* _p, const char* _end, const char* _keyword)
+	{
+		for (; *_keyword; ++_keyword, ++_p)
+		{
+			if (_p >= _end || *_p != *_keyword)
+				return false;
+		}
+		return _p < _end && IsSpace(*_p);
+	}
+
+	bool ResolveIndex(int32_t _index, size_t _count, uint32_t _flag, int32_t& _resolved, uint32_t& _relative)
+	{
+		if (_index > 0)
+		{
+			_resolved = _index - 1;
+			return true;
+		}
+		if (_index < 0)
+		{
+			_resolved = static_cast<int32_t>(_count) + _index;
+			_relative |= _flag;
+			return true;
+		}
+		return false;
+	}
+
+	// "v", "v/vt", "v//vn" or "v/vt/vn"
+	const char* ParseCorner(const char* _p, const char* _end, const ObjChunk& _chunk, ObjCorner& _corner)
+	{
+		_corner.uv = MISSING;
+		_corner.normal = MISSING;
+		_corner.relative = 0;
+
+		int32_t index;
+		_p = ParseInteger(_p, _end, index);
+		if (!_p || !ResolveIndex(index, _chunk.positions.size(), RELATIVE_POSITION, _corner.position, _corner.relative))
+			return nullptr;
+		if (_p >= _end || *_p != '/')
+			return _p;
+
+		++_p;
+		if (_p < _end && *_p != '/')
+		{
+			_p = ParseInteger(_p, _end, index);
+			if (!_p || !ResolveIndex(index, _chunk.uvs.size(), RELATIVE_UV, _corner.uv, _corner.relative))
+				return nullptr;
+		}
+		if (_p < _end && *_p == '/')
+		{
+			_p = ParseInteger(_p + 1, _end, index);
+			if (!_p || !ResolveIndex(index, _chunk.normals.size(), RELATIVE_NORMAL, _corner.normal, _corner.relative))
+				return nullptr;
+		}
+		return _p;
+	}
+
+	void ParseObjChunk(ObjChunk& _chunk)
+	{
+		_chunk.positions.clear();
+		_chunk.colors.clear();
+		_chunk.uvs.clear();
+		_chunk.normals.clear();
+		_chunk.corners.clear();
+		_chunk.failed = false;
+
+		const XMFLOAT3 white(1.0f, 1.0f, 1.0f);
+		const char* p = _chunk.begin;
+		while (p < _chunk.end && !_chunk.failed)
+		{
+			const char* lineEnd = static_cast<const char*>(memchr(p, '\n', _chunk.end - p));
+			if (!lineEnd)
+				lineEnd = _chunk.end;
+			p = SkipSpaces(p, lineEnd);
+
+			if (IsKeyword(p, lineEnd, "v"))
+			{
+				XMFLOAT3 position;
+				p = ParseFloat(p + 1, lineEnd, position.x);
+				p = p ? ParseFloat(p, lineEnd, position.y) : nullptr;
+				p = p ? ParseFloat(p, lineEnd, position.z) : nullptr;
+				if (!p)
+				{
+					_chunk.failed = true;
+					break;
+				}
+				_chunk.positions.push_back(position);
+
+				// anything after the position is either a w we do not need or the rgb colour extension
+				XMFLOAT3 color;
+				const char* q = ParseFloat(p, lineEnd, color.x);
+				q = q ? ParseFloat(q, lineEnd, color.y) : nullptr;
+				q = q ? ParseFloat(q, lineEnd, color.z) : nullptr;
+				if (q)
+				{
+					_chunk.colors.resize(_chunk.positions.size() - 1, white);
+					_chunk.colors.push_back(color);
+				}
+				else if (!_chunk.colors.empty())
+					_chunk.colors.push_back(white);
+			}
+			else if (IsKeyword(p, lineEnd, "vt"))
+			{
+				// obj puts v = 0 at the bottom of the texture, d3d at the top
+				XMFLOAT2 uv(0.0f, 0.0f);
+				p = ParseFloat(p + 2, lineEnd, uv.x);
+				if (!p)
+				{
+					_chunk.failed = true;
+					break;
+				}
+				ParseFloat(p, lineEnd, uv.y);
+				uv.y = 1.0f - uv.y;
+				_chunk.uvs.push_back(uv);
+			}
+			else if (IsKeyword(p, lineEnd, "vn"))
+			{
+				XMFLOAT3 normal;
+				p = ParseFloat(p + 2, lineEnd, normal.x);
+				p = p ? ParseFloat(p, lineEnd, normal.y) : nullptr;
+				p = p ? ParseFloat(p, lineEnd, normal.z) : nullptr;
+				if (!p)
+				{
+					_chunk.failed = true;
+					break;
+				}
+				_chunk.normals.push_back(normal);
+			}
+			else if (IsKeyword(p, lineEnd, "f"))
+			{
+				// polygons are fanned out from their first corner
+				ObjCorner first = {};
+				ObjCorner previous = {};
+				uint32_t cornerCount = 0;
+				for (p = SkipSpaces(p + 1, lineEnd); p < lineEnd; p = SkipSpaces(p, lineEnd))
+				{
+					ObjCorner corner;
+					p = ParseCorner(p, lineEnd, _chunk, corner);
+					if (!p)
+					{
+						_chunk.failed = true;
+						break;
+					}
+
+					if (cornerCount == 0)
+						first = corner;
+					else if (cornerCount >= 2)
+					{
+						_chunk.corners.push_back(first);
+						_chunk.corners.push_back(previous);
+						_chunk.corners.push_back(corner);
+					}
+					previous = corner;
+					++cornerCount;
+				}
+			}
+
+			// comments, groups, materials and smoothing groups are skipped
+			p = lineEnd + 1;
+		}
+
+		if (!_chunk.colors.empty())
+			_chunk.colors.resize(_chunk.positions.size(), white);
+	}
+
+	//==============================================================================================================
+	// welding
+	//==============================================================================================================
+
+	uint32_t HashWords(const uint32_t* _words, uint32_t _count)
+	{
+		// fnv-1a a word at a time, folded down to 32 bits
+		uint64_t hash = 0xcbf29ce484222325ull;
+		for (uint32_t i = 0; i < _count; ++i)
+		{
+			hash ^= _words[i];
+			hash *= 0x100000001b3ull;
+		}
+		return static_cast<uint32_t>(hash ^ (hash >> 32));
+	}
+
+	// an open addressing table of indices into an array of keys, kept at most half full, for welding whole vertices
+	template <typename Key>
+	class WeldTable
+	{
+	public:
+		// the index of _key in _keys, appending it if it is new
+		uint32_t Insert(std::vector<Key>& _keys, const Key& _key)
+		{
+			if ((_keys.size() + 1) * 2 > m_slots.size())
+				Grow(_keys);
+
+			uint32_t mask = static_cast<uint32_t>(m_slots.size()) - 1;
+			uint32_t slot = Hash(_key) & mask;
+			while (m_slots[slot] != NO_INDEX)
+			{
+				if (memcmp(&_keys[m_slots[slot]], &_key, sizeof(Key)) == 0)
+					return m_slots[slot];
+				slot = (slot + 1) & mask;
+			}
+			m_slots[slot] = static_cast<uint32_t>(_keys.size());
+			_keys.push_back(_key);
+			return m_slots[slot];
+		}
+
+	private:
+		static uint32_t Hash(const Key& _key) { return HashWords(reinterpret_cast<const uint32_t*>(&_key), sizeof(Key) / sizeof(uint32_t)); }
+
+		void Grow(const std::vector<Key>& _keys)
+		{
+			m_slots.assign(std::max<size_t>(m_slots.size() * 2, 1024), NO_INDEX);
+			uint32_t mask = static_cast<uint32_t>(m_slots.size()) - 1;
+			for (uint32_t i = 0; i < _keys.size(); ++i)
+			{
+				uint32_t slot = Hash(_keys[i]) & mask;
+				while (m_slots[slot] != NO_INDEX)
+					slot = (slot + 1) & mask;
+				m_slots[slot] = i;
+			}
+		}
+
+		std::vector<uint32_t> m_slots;
+	};
+
+	//==============================================================================================================
+	// json
+	//==============================================================================================================
+
+	enum JsonType : uint8_t
+	{
+		JSON_OBJECT,
+		JSON_ARRAY,
+		JSON_STRING,
+		JSON_PRIMITIVE, // numbers, true, false and null
+	};
+
+	struct JsonToken
+	{
+		JsonType type;
+		uint32_t start; // strings without their quotes
+		uint32_t end;
+		uint32_t size; // members of an object, elements of an array
+		uint32_t next; // the token after this one and everything inside it
+	};
+
+	// the whole document as a flat array of tokens that point back into the text, in the order they appear. an
+	// object's members are a key string token followed by the value's tokens
+	class JsonDocument
+	{
+	public:
+		bool Parse(const char* _text, size_t _length)
+		{
+			m_pText = _text;
+			m_length = _length;
+			m_position = 0;
+			m_tokens.clear();
+			if (m_length >= 3 && memcmp(m_pText, "\xef\xbb\xbf", 3) == 0)
+				m_position = 3; // a utf-8 byte order mark
+			if (!ParseValue(0))
+				return false;
+			SkipWhitespace();
+			return m_position == m_length;
+		}
+
+		uint32_t Root() { return 0; }
+
+		// the value of _key in _object, NO_INDEX if it has none
+		uint32_t Find(uint32_t _object, const char* _key)
+		{
+			if (_object == NO_INDEX || m_tokens[_object].type != JSON_OBJECT)
+				return NO_INDEX;
+
+			uint32_t token = _object + 1;
+			for (uint32_t i = 0; i < m_tokens[_object].size; ++i)
+			{
+				if (Equals(token, _key))
+					return token + 1;
+				token = m_tokens[token + 1].next;
+			}
+			return NO_INDEX;
+		}
+
+		void Elements(uint32_t _array, std::vector<uint32_t>& _elements)
+		{
+			_elements.clear();
+			if (_array == NO_INDEX || m_tokens[_array].type != JSON_ARRAY)
+				return;
+
+			uint32_t token = _array + 1;
+			for (uint32_t i = 0; i < m_tokens[_array].size; ++i)
+			{
+				_elements.push_back(token);
+				token = m_tokens[token].next;
+			}
+		}
+
+		uint32_t Size(uint32_t _token) { return _token == NO_INDEX ? 0 : m_tokens[_token].size; }
+
+		double Number(uint32_t _token, double _default)
+		{
+			double value;
+			if (_token == NO_INDEX || m_tokens[_token].type != JSON_PRIMITIVE ||
+				!ParseNumber(m_pText + m_tokens[_token].start, m_pText + m_tokens[_token].end, value))
+				return _default;
+			return value;
+		}
+
+		double Number(uint32_t _object, const char* _key, double _default) { return Number(Find(_object, _key), _default); }
+
+		uint32_t Index(uint32_t _object, const char* _key)
+		{
+			double value = Number(_object, _key, -1.0);
+			return value >= 0.0 && value < NO_INDEX ? static_cast<uint32_t>(value) : NO_INDEX;
+		}
+
+		bool Bool(uint32_t _object, const char* _key)
+		{
+			uint32_t token = Find(_object, _key);
+			return token != NO_INDEX && m_tokens[token].type == JSON_PRIMITIVE && m_pText[m_tokens[token].start] == 't';
+		}
+
+		bool Equals(uint32_t _token, const char* _text)
+		{
+			if (_token == NO_INDEX || m_tokens[_token].type != JSON_STRING)
+				return false;
+			size_t length = m_tokens[_token].end - m_tokens[_token].start;
+			return strlen(_text) == length && memcmp(m_pText + m_tokens[_token].start, _text, length) == 0;
+		}
+
+		std::string String(uint32_t _token)
+		{
+			std::string text;
+			if (_token == NO_INDEX || m_tokens[_token].type != JSON_STRING)
+				return text;
+
+			for (uint32_t i = m_tokens[_token].start; i < m_tokens[_token].end; ++i)
+			{
+				// uris and names only ever need the simple escapes
+				if (m_pText[i] == '\\' && i + 1 < m_tokens[_token].end)
+					++i;
+				text.push_back(m_pText[i]);
+			}
+			return text;
+		}
+
+	private:
+		void SkipWhitespace()
+		{
+			while (m_position < m_length && (m_pText[m_position] == ' ' || m_pText[m_position] == '\t' ||
+				m_pText[m_position] == '\r' || m_pText[m_position] == '\n'))
+				++m_position;
+		}
+
+		uint32_t AddToken(JsonType _type, uint32_t _start)
+		{
+			JsonToken token = { _type, _start, _start, 0, 0 };
+			m_tokens.push_back(token);
+			return static_cast<uint32_t>(m_tokens.size() - 1);
+		}
+
+		bool ParseString()
+		{
+			uint32_t token = AddToken(JSON_STRING, static_cast<uint32_t>(m_position + 1));
+			for (++m_position; m_position < m_length; ++m_position)
+			{
+				if (m_pText[m_position] == '\\')
+					++m_position;
+				else if (m_pText[m_position] == '"')
+				{
+					m_tokens[token].end = static_cast<uint32_t>(m_position++);
+					m_tokens[token].next = token + 1;
+					return true;
+				}
+			}
+			return false;
+		}
+
+		bool ParseValue(uint32_t _depth)
+		{
+			SkipWhitespace();
+			if (m_position >= m_length || _depth > MAX_JSON_DEPTH)
+				return false;
+
+			char c = m_pText[m_position];
+			if (c == '"')
+				return ParseString();
+
+			if (c == '{' || c == '[')
+			{
+				bool isObject = c == '{';
+				char close = isObject ? '}' : ']';
+				uint32_t token = AddToken(isObject ? JSON_OBJECT : JSON_ARRAY, static_cast<uint32_t>(m_position++));
+				uint32_t size = 0;
+				SkipWhitespace();
+				if (m_position < m_length && m_pText[m_position] == close)
+					++m_position;
+				else
+				{
+					while (true)
+					{
+						if (isObject)
+						{
+							SkipWhitespace();
+							if (m_position >= m_length || m_pText[m_position] != '"' || !ParseString())
+								return false;
+							SkipWhitespace();
+							if (m_position >= m_length || m_pText[m_position++] != ':')
+								return false;
+						}
+						if (!ParseValue(_depth + 1))
+							return false;
+						++size;
+
+						SkipWhitespace();
+						if (m_position >= m_length)
+							return false;
+						char separator = m_pText[m_position++];
+						if (separator == close)
+							break;
+						if (separator != ',')
+							return false;
+					}
+				}
+				m_tokens[token].end = static_cast<uint32_t>(m_position);
+				m_tokens[token].size = size;
+				m_tokens[token].next = static_cast<uint32_t>(m_tokens.size());
+				return true;
+			}
+
+			uint32_t token = AddToken(JSON_PRIMITIVE, static_cast<uint32_t>(m_position));
+			while (m_position < m_length && !strchr(",]} \t\r\n", m_pText[m_position]))
+				++m_position;
+			m_tokens[token].end = static_cast<uint32_t>(m_position);
+			m_tokens[token].next = token + 1;
+			return m_tokens[token].end > m_tokens[token].start;
+		}
+
+		const char* m_pText = nullptr;
+		size_t m_length = 0;
+		size_t m_position = 0;
+		std::vector<JsonToken> m_tokens;
+	};
+
+	//==============================================================================================================
+	// gltf
+	//==============================================================================================================
+
+	const uint32_t GLB_MAGIC = 0x46546c67; // "glTF"
+	const uint32_t GLB_CHUNK_JSON = 0x4e4f534a; // "JSON"
+	const uint32_t GLB_CHUNK_BIN = 0x004e4942; // "BIN\0"
+	const uint32_t GLTF_TRIANGLES = 4;
+
+	enum GltfComponentType
+	{
+		GLTF_BYTE = 5120,
+		GLTF_UNSIGNED_BYTE = 5121,
+		GLTF_SHORT = 5122,
+		GLTF_UNSIGNED_SHORT = 5123,
+		GLTF_UNSIGNED_INT = 5125,
+		GLTF_FLOAT = 5126,
+	};
+
+	struct GltfBytes
+	{
+		const uint8_t* pData;
+		size_t length;
+	};
+
+	// where every element of an accessor is, checked to lie inside its buffer
+	struct GltfAccessor
+	{
+		const uint8_t* pData = nullptr; // nullptr for an accessor without a buffer view, which is all zeroes
+		uint32_t count = 0;
+		uint32_t stride = 0;
+		uint32_t componentType = GLTF_FLOAT;
+		uint32_t components = 0;
+		bool normalized = false;
+	};
+
+	struct GltfPrimitive
+	{
+		GltfAccessor positions;
+		GltfAccessor normals; // components is 0 for attributes the primitive does not have
+		GltfAccessor uvs;
+		GltfAccessor colors;
+		GltfAccessor indices;
+		XMFLOAT4X4 world;
+		XMFLOAT4X4 normalWorld; // the inverse transpose of world
+		bool reverseWinding;
+		uint32_t firstVertex; // in the output
+		uint32_t firstTriangle;
+		uint32_t triangleCount;
+	};
+
+	uint32_t ComponentSize(uint32_t _componentType)
+	{
+		switch (_componentType)
+		{
+		case GLTF_BYTE:
+		case GLTF_UNSIGNED_BYTE: return 1;
+		case GLTF_SHORT:
+		case GLTF_UNSIGNED_SHORT: return 2;
+		case GLTF_UNSIGNED_INT:
+		case GLTF_FLOAT: return 4;
+		default: return 0;
+		}
+	}
+
+	uint32_t ComponentCount(JsonDocument& _json, uint32_t _type)
+	{
+		const char* TYPES[] = { "SCALAR", "VEC2", "VEC3", "VEC4" };
+		for (uint32_t i = 0; i < sizeof(TYPES) / sizeof(TYPES[0]); ++i)
+		{
+			if (_json.Equals(_type, TYPES[i]))
+				return i + 1;
+		}
+		return 0;
+	}
+
+	// up to _count components of element _element as floats, normalised integers mapped to 0..1 or -1..1
+	void ReadFloats(const GltfAccessor& _accessor, uint32_t _element, float* _values, uint32_t _count)
+	{
+		uint32_t count = std::min(_count, _accessor.components);
+		if (!_accessor.pData)
+		{
+			std::fill(_values, _values + count, 0.0f);
+			return;
+		}
+
+		const uint8_t* pElement = _accessor.pData + static_cast<size_t>(_element) * _accessor.stride;
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			switch (_accessor.componentType)
+			{
+			case GLTF_FLOAT:
+				memcpy(&_values[i], pElement + i * 4, 4);
+				break;
+			case GLTF_UNSIGNED_BYTE:
+				_values[i] = pElement[i] * (_accessor.normalized ? 1.0f / 255.0f : 1.0f);
+				break;
+			case GLTF_BYTE:
+			{
+				float value = static_cast<float>(static_cast<int8_t>(pElement[i]));
+				_values[i] = _accessor.normalized ? std::max(value / 127.0f, -1.0f) : value;
+				break;
+			}
+			case GLTF_UNSIGNED_SHORT:
+			{
+				uint16_t value;
+				memcpy(&value, pElement + i * 2, 2);
+				_values[i] = value * (_accessor.normalized ? 1.0f / 65535.0f : 1.0f);
+				break;
+			}
+			case GLTF_SHORT:
+			{
+				int16_t value;
+				memcpy(&value, pElement + i * 2, 2);
+				_values[i] = _accessor.normalized ? std::max(value / 32767.0f, -1.0f) : static_cast<float>(value);
+				break;
+			}
+			case GLTF_UNSIGNED_INT:
+			{
+				uint32_t value;
+				memcpy(&value, pElement + i * 4, 4);
+				_values[i] = static_cast<float>(value);
+				break;
+			}
+			}
+		}
+	}
+
+	uint32_t ReadIndex(const GltfAccessor& _accessor, uint32_t _element)
+	{
+		if (!_accessor.pData)
+			return 0;
+
+		const uint8_t* pElement = _accessor.pData + static_cast<size_t>(_element) * _accessor.stride;
+		switch (_accessor.componentType)
+		{
+		case GLTF_UNSIGNED_BYTE:
+			return pElement[0];
+		case GLTF_UNSIGNED_SHORT:
+		{
+			uint16_t value;
+			memcpy(&value, pElement, 2);
+			return value;
+		}
+		default:
+		{
+			uint32_t value;
+			memcpy(&value, pElement, 4);
+			return value;
+		}
+		}
+	}
+
+	bool DecodeBase64(const char* _text, size_t _length, std::vector<uint8_t>& _bytes)
+	{
+		uint32_t bits = 0;
+		uint32_t bitCount = 0;
+		for (size_t i = 0; i < _length && _text[i] != '='; ++i)
+		{
+			char c = _text[i];
+			uint32_t value;
+			if (c >= 'A' && c <= 'Z') value = c - 'A';
+			else if (c >= 'a' && c <= 'z') value = c - 'a' + 26;
+			else if (c >= '0' && c <= '9') value = c - '0' + 52;
+			else if (c == '+') value = 62;
+			else if (c == '/') value = 63;
+			else return false;
+
+			bits = (bits << 6) | value;
+			bitCount += 6;
+			if (bitCount >= 8)
+			{
+				bitCount -= 8;
+				_bytes.push_back(static_cast<uint8_t>(bits >> bitCount));
+			}
+		}
+		return true;
+	}
+
+	// uris are relative to the gltf and may have spaces and the like escaped as %XX
+	std::string UriToPath(const std::string& _directory, const std::string& _uri)
+	{
+		std::string path = _directory;
+		for (size_t i = 0; i < _uri.size(); ++i)
+		{
+			if (_uri[i] == '%' && i + 2 < _uri.size() && isxdigit(static_cast<unsigned char>(_uri[i + 1])) && isxdigit(static_cast<unsigned char>(_uri[i + 2])))
+			{
+				path.push_back(static_cast<char>(std::stoi(_uri.substr(i + 1, 2), nullptr, 16)));
+				i += 2;
+			}
+			else
+				path.push_back(_uri[i]);
+		}
+		return path;
+	}
+
+	bool ReadAccessor(JsonDocument& _json, const std::vector<uint32_t>& _accessors, const std::vector<uint32_t>& _views,
+		const std::vector<GltfBytes>& _buffers, uint32_t _index, GltfAccessor& _accessor)
+	{
+		if (_index >= _accessors.size())
+			return false;
+
+		uint32_t accessor = _accessors[_index];
+		_accessor.count = static_cast<uint32_t>(_json.Number(accessor, "count", 0));
+		_accessor.componentType = static_cast<uint32_t>(_json.Number(accessor, "componentType", 0));
+		_accessor.components = ComponentCount(_json, _json.Find(accessor, "type"));
+		_accessor.normalized = _json.Bool(accessor, "normalized");
+		uint32_t elementSize = _accessor.components * ComponentSize(_accessor.componentType);
+		if (elementSize == 0)
+			return false;
+
+		_accessor.stride = elementSize;
+		_accessor.pData = nullptr;
+		uint32_t viewIndex = _json.Index(accessor, "bufferView");
+		if (viewIndex == NO_INDEX || _accessor.count == 0)
+			return true;
+		if (viewIndex >= _views.size())
+			return false;
+
+		uint32_t view = _views[viewIndex];
+		uint32_t bufferIndex = _json.Index(view, "buffer");
+		if (bufferIndex >= _buffers.size())
+			return false;
+
+		size_t viewOffset = static_cast<size_t>(_json.Number(view, "byteOffset", 0));
+		size_t viewLength = static_cast<size_t>(_json.Number(view, "byteLength", 0));
+		size_t offset = static_cast<size_t>(_json.Number(accessor, "byteOffset", 0));
+		_accessor.stride = std::max(static_cast<uint32_t>(_json.Number(view, "byteStride", 0)), elementSize);
+		if (viewOffset + viewLength > _buffers[bufferIndex].length ||
+			offset + static_cast<size_t>(_accessor.count - 1) * _accessor.stride + elementSize > viewLength)
+			return false;
+
+		_accessor.pData = _buffers[bufferIndex].pData + viewOffset + offset;
+		return true;
+	}
+
+	XMMATRIX NodeMatrix(JsonDocument& _json, uint32_t _node)
+	{
+		uint32_t matrix = _json.Find(_node, "matrix");
+		if (_json.Size(matrix) == 16)
+		{
+			// gltf stores column major matrices for column vectors, which read in order is the row major matrix for
+			// the row vectors DirectXMath uses
+			std::vector<uint32_t> elements;
+			_json.Elements(matrix, elements);
+			XMFLOAT4X4 m;
+			for (uint32_t i = 0; i < 16; ++i)
+				m.m[i / 4][i % 4] = static_cast<float>(_json.Number(elements[i], 0.0));
+			return XMLoadFloat4x4(&m);
+		}
+
+		float t[3] = { 0.0f, 0.0f, 0.0f };
+		float r[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+		float s[3] = { 1.0f, 1.0f, 1.0f };
+		std::vector<uint32_t> elements;
+		_json.Elements(_json.Find(_node, "translation"), elements);
+		for (uint32_t i = 0; i < std::min<size_t>(elements.size(), 3); ++i)
+			t[i] = static_cast<float>(_json.Number(elements[i], 0.0));
+		_json.Elements(_json.Find(_node, "rotation"), elements);
+		for (uint32_t i = 0; i < std::min<size_t>(elements.size(), 4); ++i)
+			r[i] = static_cast<float>(_json.Number(elements[i], 0.0));
+		_json.Elements(_json.Find(_node, "scale"), elements);
+		for (uint32_t i = 0; i < std::min<size_t>(elements.size(), 3); ++i)
+			s[i] = static_cast<float>(_json.Number(elements[i], 1.0));
+
+		return XMMatrixScaling(s[0], s[1], s[2]) *
+			XMMatrixRotationQuaternion(XMVectorSet(r[0], r[1], r[2], r[3])) *
+			XMMatrixTranslation(t[0], t[1], t[2]);
+	}
+}
+
+bool MeshImporter::Load(const std::string& _fileName, ImportedMesh& _mesh, JobSystem* _pJobSystem, const MeshImportDesc& _desc)
+{
+	size_t dot = _fileName.find_last_of('.');
+	std::string extension = dot == std::string::npos ? "" : _fileName.substr(dot + 1);
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](char _c) { return static_cast<char>(tolower(_c)); });
+
+	if (extension == "obj")
+		return LoadObj(_fileName, _mesh, _pJobSystem, _desc);
+	if (extension == "gltf" || extension == "glb")
+		return LoadGltf(_fileName, _mesh, _pJobSystem, _desc);
+	return false;
+}
+
+bool MeshImporter::LoadObj(const std::string& _fileName, ImportedMesh& _mesh, JobSystem* _pJobSystem, const MeshImportDesc& _desc)
+{
+	m_stats = MeshImportStats();
+	_mesh = ImportedMesh();
+
+	Clock::time_point start = Clock::now();
+	std::ifstream file(_fileName, std::ios::binary | std::ios::ate);
+	if (!file)
+		return false;
+	uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+	file.seekg(0, std::ios::beg);
+	m_stats.readMs += MillisecondsSince(start);
+
+	// small files get a window their own size, big ones are streamed through a fixed one
+	std::vector<char> window(static_cast<size_t>(std::max<uint64_t>(std::min<uint64_t>(_desc.windowSize, fileSize), 1)));
+	std::vector<ObjChunk> chunks;
+	std::vector<XMFLOAT3> positions;
+	std::vector<XMFLOAT3> colors; // empty while no position has had a colour
+	std::vector<XMFLOAT2> uvs;
+	std::vector<XMFLOAT3> normals;
+	std::vector<ObjVertexKey> keys; // one per output vertex
+	ObjWelder welder;
+	const XMFLOAT3 white(1.0f, 1.0f, 1.0f);
+
+	size_t carried = 0; // bytes of a partial line left at the front of the window by the last read
+	uint64_t bytesRead = 0;
+	while (true)
+	{
+		start = Clock::now();
+		file.read(window.data() + carried, window.size() - carried);
+		size_t size = carried + static_cast<size_t>(file.gcount());
+		bytesRead += static_cast<uint64_t>(file.gcount());
+		m_stats.readMs += MillisecondsSince(start);
+		bool lastWindow = bytesRead >= fileSize || file.gcount() == 0;
+
+		// only whole lines are parsed. the partial one at the end is moved to the front of the next window, and if
+		// one line fills the whole window the window grows
+		size_t parsed = size;
+		if (!lastWindow)
+		{
+			while (parsed > 0 && window[parsed - 1] != '\n')
+				--parsed;
+			if (parsed == 0)
+			{
+				carried = size;
+				window.resize(window.size() * 2);
+				continue;
+			}
+		}
+
+		start = Clock::now();
+		uint32_t chunkCount = 0;
+		for (const char* p = window.data(); p < window.data() + parsed; ++chunkCount)
+		{
+			const char* end = window.data() + parsed;
+			const char* chunkEnd = p + std::min<size_t>(std::max(_desc.chunkSize, 1u), end - p);
+			const char* lineEnd = chunkEnd < end ? static_cast<const char*>(memchr(chunkEnd, '\n', end - chunkEnd)) : nullptr;
+			chunkEnd = lineEnd ? lineEnd + 1 : end;
+
+			if (chunkCount == chunks.size())
+				chunks.emplace_back();
+			chunks[chunkCount].begin = p;
+			chunks[chunkCount].end = chunkEnd;
+			p = chunkEnd;
+		}
+
+		ForRange(_pJobSystem, chunkCount, 1, [&](unsigned int _begin, unsigned int _end)
+		{
+			for (unsigned int i = _begin; i < _end; ++i)
+				ParseObjChunk(chunks[i]);
+		});
+		m_stats.parseMs += MillisecondsSince(start);
+
+		// appending in order turns the chunk relative indices into absolute ones, and welding as the corners come in
+		// means the corners never have to be kept
+		start = Clock::now();
+		size_t windowPositions = 0;
+		size_t windowCorners = 0;
+		for (uint32_t i = 0; i < chunkCount; ++i)
+		{
+			windowPositions += chunks[i].positions.size();
+			windowCorners += chunks[i].corners.size();
+		}
+		GrowCapacity(positions, positions.size() + windowPositions);
+		GrowCapacity(_mesh.indices, _mesh.indices.size() + windowCorners);
+
+		for (uint32_t i = 0; i < chunkCount; ++i)
+		{
+			ObjChunk& chunk = chunks[i];
+			if (chunk.failed)
+				return false;
+
+			int64_t positionBase = static_cast<int64_t>(positions.size());
+			int64_t uvBase = static_cast<int64_t>(uvs.size());
+			int64_t normalBase = static_cast<int64_t>(normals.size());
+			if (!chunk.colors.empty() || !colors.empty())
+			{
+				colors.resize(positions.size(), white);
+				if (chunk.colors.empty())
+					colors.resize(positions.size() + chunk.positions.size(), white);
+				else
+					colors.insert(colors.end(), chunk.colors.begin(), chunk.colors.end());
+			}
+			positions.insert(positions.end(), chunk.positions.begin(), chunk.positions.end());
+			uvs.insert(uvs.end(), chunk.uvs.begin(), chunk.uvs.end());
+			normals.insert(normals.end(), chunk.normals.begin(), chunk.normals.end());
+
+			for (const ObjCorner& corner : chunk.corners)
+			{
+				int64_t position = corner.position + ((corner.relative & RELATIVE_POSITION) ? positionBase : 0);
+				int64_t uv = corner.uv == MISSING ? NO_INDEX : corner.uv + ((corner.relative & RELATIVE_UV) ? uvBase : 0);
+				int64_t normal = corner.normal == MISSING ? NO_INDEX : corner.normal + ((corner.relative & RELATIVE_NORMAL) ? normalBase : 0);
+				if (position < 0 || uv < 0 || normal < 0)
+					return false;
+
+				ObjVertexKey key = { static_cast<uint32_t>(position), static_cast<uint32_t>(uv), static_cast<uint32_t>(normal) };
+				if (_desc.weld)
+					_mesh.indices.push_back(welder.Insert(keys, key));
+				else
+				{
+					_mesh.indices.push_back(static_cast<uint32_t>(keys.size()));
+					keys.push_back(key);
+				}
+			}
+		}
+		m_stats.weldMs += MillisecondsSince(start);
+
+		memmove(window.data(), window.data() + parsed, size - parsed);
+		carried = size - parsed;
+		if (lastWindow)
+			break;
+	}
+
+	// the vertices are only filled in now, since faces may use positions further down the file
+	start = Clock::now();
+	std::atomic<bool> outOfRange(false);
+	_mesh.vertices.resize(keys.size());
+	ForRange(_pJobSystem, static_cast<uint32_t>(keys.size()), VERTICES_PER_JOB, [&](unsigned int _begin, unsigned int _end)
+	{
+		for (unsigned int i = _begin; i < _end; ++i)
+		{
+			const ObjVertexKey& key = keys[i];
+			MeshVertex& vertex = _mesh.vertices[i];
+			if (key.position >= positions.size() || (key.uv != NO_INDEX && key.uv >= uvs.size()) || (key.normal != NO_INDEX && key.normal >= normals.size()))
+			{
+				outOfRange = true;
+				return;
+			}
+
+			vertex.position = positions[key.position];
+			vertex.normal = key.normal != NO_INDEX ? normals[key.normal] : XMFLOAT3(0.0f, 0.0f, 0.0f);
+			vertex.uv = key.uv != NO_INDEX ? uvs[key.uv] : XMFLOAT2(0.0f, 0.0f);
+			const XMFLOAT3& color = colors.empty() ? white : colors[key.position];
+			vertex.color = XMFLOAT4(color.x, color.y, color.z, 1.0f);
+		}
+	});
+	if (outOfRange)
+		return false;
+
+	_mesh.hasNormals = !normals.empty();
+	_mesh.hasUvs = !uvs.empty();
+	_mesh.hasColors = !colors.empty();
+	if (!_mesh.hasNormals && _desc.generateNormals)
+		GenerateNormals(_mesh);
+	ComputeBounds(_mesh);
+	m_stats.weldMs += MillisecondsSince(start);
+
+	m_stats.bytes = bytesRead;
+	m_stats.corners = static_cast<uint32_t>(_mesh.indices.size());
+	m_stats.vertices = static_cast<uint32_t>(_mesh.vertices.size());
+	return true;
+}
+
+bool MeshImporter::LoadGltf(const std::string& _fileName, ImportedMesh& _mesh, JobSystem* _pJobSystem, const MeshImportDesc& _desc)
+{
+	m_stats = MeshImportStats();
+	_mesh = ImportedMesh();
+
+	Clock::time_point start = Clock::now();
+	std::vector<uint8_t> file;
+	if (!ReadWholeFile(_fileName, file))
+		return false;
+	m_stats.bytes = file.size();
+	m_stats.readMs += MillisecondsSince(start);
+
+	// a glb is a header and then chunks, the json first and the binary buffer after it
+	const char* pJsonText = reinterpret_cast<const char*>(file.data());
+	size_t jsonLength = file.size();
+	GltfBytes glbBuffer = { nullptr, 0 };
+	uint32_t magic = 0;
+	if (file.size() >= 12)
+		memcpy(&magic, file.data(), 4);
+	if (magic == GLB_MAGIC)
+	{
+		pJsonText = nullptr;
+		for (size_t offset = 12; offset + 8 <= file.size();)
+		{
+			uint32_t chunkLength;
+			uint32_t chunkType;
+			memcpy(&chunkLength, file.data() + offset, 4);
+			memcpy(&chunkType, file.data() + offset + 4, 4);
+			offset += 8;
+			if (offset + chunkLength > file.size())
+				return false;
+
+			if (chunkType == GLB_CHUNK_JSON)
+			{
+				pJsonText = reinterpret_cast<const char*>(file.data() + offset);
+				jsonLength = chunkLength;
+			}
+			else if (chunkType == GLB_CHUNK_BIN)
+				glbBuffer = { file.data() + offset, chunkLength };
+			offset += chunkLength;
+		}
+		if (!pJsonText)
+			return false;
+	}
+
+	start = Clock::now();
+	JsonDocument json;
+	if (!json.Parse(pJsonText, jsonLength))
+		return false;
+	m_stats.parseMs += MillisecondsSince(start);
+
+	// buffers are read whole: from the glb, a base64 data uri or a file next to the gltf
+	start = Clock::now();
+	size_t slash = _fileName.find_last_of("/\\");
+	std::string directory = slash == std::string::npos ? "" : _fileName.substr(0, slash + 1);
+	std::vector<uint32_t> elements;
+	json.Elements(json.Find(json.Root(), "buffers"), elements);
+	std::vector<std::vector<uint8_t>> bufferStorage(elements.size());
+	std::vector<GltfBytes> buffers(elements.size());
+	for (uint32_t i = 0; i < elements.size(); ++i)
+	{
+		uint32_t uri = json.Find(elements[i], "uri");
+		size_t byteLength = static_cast<size_t>(json.Number(elements[i], "byteLength", 0));
+		if (uri == NO_INDEX)
+		{
+			buffers[i] = glbBuffer;
+		}
+		else
+		{
+			std::string text = json.String(uri);
+			size_t comma = text.find(',');
+			if (text.compare(0, 5, "data:") == 0)
+			{
+				if (comma == std::string::npos || text.rfind(";base64", comma) == std::string::npos ||
+					!DecodeBase64(text.c_str() + comma + 1, text.size() - comma - 1, bufferStorage[i]))
+					return false;
+			}
+			else if (!ReadWholeFile(UriToPath(directory, text), bufferStorage[i]))
+				return false;
+
+			m_stats.bytes += bufferStorage[i].size();
+			buffers[i] = { bufferStorage[i].data(), bufferStorage[i].size() };
+		}
+		if (buffers[i].length < byteLength)
+			return false;
+	}
+	m_stats.readMs += MillisecondsSince(start);
+
+	start = Clock::now();
+	std::vector<uint32_t> views;
+	std::vector<uint32_t> accessors;
+	std::vector<uint32_t> meshes;
+	std::vector<uint32_t> nodes;
+	json.Elements(json.Find(json.Root(), "bufferViews"), views);
+	json.Elements(json.Find(json.Root(), "accessors"), accessors);
+	json.Elements(json.Find(json.Root(), "meshes"), meshes);
+	json.Elements(json.Find(json.Root(), "nodes"), nodes);
+
+	// every mesh the default scene places, with its world matrix. without any scenes every mesh is placed once
+	struct MeshInstance
+	{
+		uint32_t mesh;
+		XMFLOAT4X4 world;
+	};
+	std::vector<MeshInstance> instances;
+	XMFLOAT4X4 handedness;
+	XMStoreFloat4x4(&handedness, _desc.flipGltfHandedness ? XMMatrixScaling(1.0f, 1.0f, -1.0f) : XMMatrixIdentity());
+	std::vector<uint32_t> scenes;
+	json.Elements(json.Find(json.Root(), "scenes"), scenes);
+	if (scenes.empty())
+	{
+		for (uint32_t i = 0; i < meshes.size(); ++i)
+		{
+			MeshInstance instance = { i, handedness };
+			instances.push_back(instance);
+		}
+	}
+	else
+	{
+		uint32_t scene = static_cast<uint32_t>(json.Number(json.Root(), "scene", 0));
+		if (scene >= scenes.size())
+			return false;
+
+		struct NodeVisit
+		{
+			uint32_t node;
+			XMFLOAT4X4 parentWorld;
+		};
+		std::vector<NodeVisit> stack;
+		json.Elements(json.Find(scenes[scene], "nodes"), elements);
+		for (uint32_t element : elements)
+		{
+			NodeVisit visit = { static_cast<uint32_t>(json.Number(element, -1.0)), handedness };
+			stack.push_back(visit);
+		}
+
+		// nodes form trees, so a file that makes us visit more nodes than it has is malformed
+		uint32_t visits = 0;
+		while (!stack.empty())
+		{
+			NodeVisit visit = stack.back();
+			stack.pop_back();
+			if (visit.node >= nodes.size() || ++visits > nodes.size())
+				return false;
+
+			uint32_t node = nodes[visit.node];
+			XMFLOAT4X4 world;
+			XMStoreFloat4x4(&world, NodeMatrix(json, node) * XMLoadFloat4x4(&visit.parentWorld));
+			uint32_t mesh = json.Index(node, "mesh");
+			if (mesh != NO_INDEX)
+			{
+				if (mesh >= meshes.size())
+					return false;
+				MeshInstance instance = { mesh, world };
+				instances.push_back(instance);
+			}
+
+			json.Elements(json.Find(node, "children"), elements);
+			for (uint32_t element : elements)
+			{
+				NodeVisit child = { static_cast<uint32_t>(json.Number(element, -1.0)), world };
+				stack.push_back(child);
+			}
+		}
+	}
+
+	// every triangle primitive gets its own range of the output so they can all be decoded at once
+	std::vector<GltfPrimitive> primitives;
+	uint32_t vertexCount = 0;
+	uint32_t triangleCount = 0;
+	bool allNormals = true;
+	for (const MeshInstance& instance : instances)
+	{
+		std::vector<uint32_t> meshPrimitives;
+		json.Elements(json.Find(meshes[instance.mesh], "primitives"), meshPrimitives);
+		for (uint32_t element : meshPrimitives)
+		{
+			if (static_cast<uint32_t>(json.Number(element, "mode", GLTF_TRIANGLES)) != GLTF_TRIANGLES)
+				continue;
+
+			GltfPrimitive primitive = {};
+			uint32_t attributes = json.Find(element, "attributes");
+			uint32_t positionAccessor = json.Index(attributes, "POSITION");
+			if (positionAccessor == NO_INDEX)
+				continue;
+			if (!ReadAccessor(json, accessors, views, buffers, positionAccessor, primitive.positions) || primitive.positions.components != 3)
+				return false;
+
+			const char* OPTIONAL_ATTRIBUTES[] = { "NORMAL", "TEXCOORD_0", "COLOR_0" };
+			GltfAccessor* pOptional[] = { &primitive.normals, &primitive.uvs, &primitive.colors };
+			for (uint32_t a = 0; a < sizeof(OPTIONAL_ATTRIBUTES) / sizeof(OPTIONAL_ATTRIBUTES[0]); ++a)
+			{
+				uint32_t index = json.Index(attributes, OPTIONAL_ATTRIBUTES[a]);
+				if (index != NO_INDEX && (!ReadAccessor(json, accessors, views, buffers, index, *pOptional[a]) ||
+					pOptional[a]->count != primitive.positions.count))
+					return false;
+			}
+
+			uint32_t indexAccessor = json.Index(element, "indices");
+			uint32_t indexCount = primitive.positions.count;
+			if (indexAccessor != NO_INDEX)
+			{
+				if (!ReadAccessor(json, accessors, views, buffers, indexAccessor, primitive.indices) ||
+					primitive.indices.components != 1 || primitive.indices.componentType == GLTF_FLOAT)
+					return false;
+				indexCount = primitive.indices.count;
+			}
+
+			// a front face's edges cross towards its front in gltf just as they do for us (counter clockwise in a right
+			// handed space is clockwise in a left handed one), so only a matrix that mirrors, like the handedness
+			// flip, has to turn the triangles around
+			XMMATRIX world = XMLoadFloat4x4(&instance.world);
+			primitive.world = instance.world;
+			XMStoreFloat4x4(&primitive.normalWorld, XMMatrixTranspose(XMMatrixInverse(nullptr, world)));
+			primitive.reverseWinding = XMVectorGetX(XMMatrixDeterminant(world)) < 0.0f;
+			primitive.firstVertex = vertexCount;
+			primitive.firstTriangle = triangleCount;
+			primitive.triangleCount = indexCount / 3;
+			vertexCount += primitive.positions.count;
+			triangleCount += primitive.triangleCount;
+			allNormals &= primitive.normals.components != 0;
+			_mesh.hasUvs |= primitive.uvs.components != 0;
+			_mesh.hasColors |= primitive.colors.components != 0;
+			primitives.push_back(primitive);
+		}
+	}
+
+	auto findPrimitive = [&](uint32_t _first, uint32_t GltfPrimitive::* _member)
+	{
+		auto it = std::upper_bound(primitives.begin(), primitives.end(), _first, [&](uint32_t _value, const GltfPrimitive& _primitive)
+		{
+			return _value < _primitive.*_member;
+		});
+		return static_cast<uint32_t>(it - primitives.begin()) - 1;
+	};
+
+	_mesh.vertices.resize(vertexCount);
+	ForRange(_pJobSystem, vertexCount, VERTICES_PER_JOB, [&](unsigned int _begin, unsigned int _end)
+	{
+		for (uint32_t p = findPrimitive(_begin, &GltfPrimitive::firstVertex); p < primitives.size() && primitives[p].firstVertex < _end; ++p)
+		{
+			const GltfPrimitive& primitive = primitives[p];
+			XMMATRIX world = XMLoadFloat4x4(&primitive.world);
+			XMMATRIX normalWorld = XMLoadFloat4x4(&primitive.normalWorld);
+			uint32_t first = std::max(_begin, primitive.firstVertex) - primitive.firstVertex;
+			uint32_t last = std::min(_end, primitive.firstVertex + primitive.positions.count) - primitive.firstVertex;
+			for (uint32_t i = first; i < last; ++i)
+			{
+				MeshVertex& vertex = _mesh.vertices[primitive.firstVertex + i];
+				float values[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+				ReadFloats(primitive.positions, i, values, 3);
+				XMStoreFloat3(&vertex.position, XMVector3TransformCoord(XMVectorSet(values[0], values[1], values[2], 1.0f), world));
+
+				values[0] = values[1] = values[2] = 0.0f;
+				ReadFloats(primitive.normals, i, values, 3);
+				XMStoreFloat3(&vertex.normal, XMVector3Normalize(XMVector3TransformNormal(XMVectorSet(values[0], values[1], values[2], 0.0f), normalWorld)));
+
+				values[0] = values[1] = 0.0f;
+				ReadFloats(primitive.uvs, i, values, 2);
+				vertex.uv = XMFLOAT2(values[0], values[1]);
+
+				values[0] = values[1] = values[2] = values[3] = 1.0f;
+				ReadFloats(primitive.colors, i, values, 4);
+				vertex.color = XMFLOAT4(values[0], values[1], values[2], values[3]);
+			}
+		}
+	});
+
+	std::atomic<bool> outOfRange(false);
+	_mesh.indices.resize(static_cast<size_t>(triangleCount) * 3);
+	ForRange(_pJobSystem, triangleCount, TRIANGLES_PER_JOB, [&](unsigned int _begin, unsigned int _end)
+	{
+		for (uint32_t p = findPrimitive(_begin, &GltfPrimitive::firstTriangle); p < primitives.size() && primitives[p].firstTriangle < _end; ++p)
+		{
+			const GltfPrimitive& primitive = primitives[p];
+			uint32_t first = std::max(_begin, primitive.firstTriangle) - primitive.firstTriangle;
+			uint32_t last = std::min(_end, primitive.firstTriangle + primitive.triangleCount) - primitive.firstTriangle;
+			for (uint32_t t = first; t < last; ++t)
+			{
+				uint32_t corners[3];
+				for (uint32_t c = 0; c < 3; ++c)
+				{
+					corners[c] = primitive.indices.components ? ReadIndex(primitive.indices, t * 3 + c) : t * 3 + c;
+					if (corners[c] >= primitive.positions.count)
+						outOfRange = true;
+				}
+				uint32_t* pTriangle = &_mesh.indices[(static_cast<size_t>(primitive.firstTriangle) + t) * 3];
+				pTriangle[0] = primitive.firstVertex + corners[0];
+				pTriangle[1] = primitive.firstVertex + corners[primitive.reverseWinding ? 2 : 1];
+				pTriangle[2] = primitive.firstVertex + corners[primitive.reverseWinding ? 1 : 2];
+			}
+		}
+	});
+	if (outOfRange)
+		return false;
+	m_stats.parseMs += MillisecondsSince(start);
+
+	// gltf is indexed already, but exporters split vertices per primitive and often per face
+	start = Clock::now();
+	m_stats.corners = static_cast<uint32_t>(_mesh.indices.size());
+	if (_desc.weld)
+		WeldVertices(_mesh);
+	_mesh.hasNormals = allNormals && !primitives.empty();
+	if (!_mesh.hasNormals && _desc.generateNormals)
+		GenerateNormals(_mesh);
+	ComputeBounds(_mesh);
+	m_stats.weldMs += MillisecondsSince(start);
+	m_stats.vertices = static_cast<uint32_t>(_mesh.vertices.size());
+	return true;
+}
+
+void MeshImporter::GenerateNormals(ImportedMesh& _mesh)
+{
+	std::vector<XMFLOAT3> sums(_mesh.vertices.size(), XMFLOAT3(0.0f, 0.0f, 0.0f));
+	for (size_t i = 0; i + 2 < _mesh.indices.size(); i += 3)
+	{
+		const uint32_t* pTriangle = &_mesh.indices[i];
+		XMVECTOR a = XMLoadFloat3(&_mesh.vertices[pTriangle[0]].position);
+		XMVECTOR b = XMLoadFloat3(&_mesh.vertices[pTriangle[1]].position);
+		XMVECTOR c = XMLoadFloat3(&_mesh.vertices[pTriangle[2]].position);
+
+		// the cross product's length is twice the area, so bigger triangles count for more. clockwise triangles face
+		// the way (b - a) x (c - a) points in a left handed space
+		XMVECTOR faceNormal = XMVector3Cross(b - a, c - a);
+		for (uint32_t corner = 0; corner < 3; ++corner)
+			XMStoreFloat3(&sums[pTriangle[corner]], XMLoadFloat3(&sums[pTriangle[corner]]) + faceNormal);
+	}
+
+	for (size_t i = 0; i < _mesh.vertices.size(); ++i)
+	{
+		XMVECTOR sum = XMLoadFloat3(&sums[i]);
+		if (XMVectorGetX(XMVector3LengthSq(sum)) > 0.0f)
+			XMStoreFloat3(&_mesh.vertices[i].normal, XMVector3Normalize(sum));
+		else
+			_mesh.vertices[i].normal = XMFLOAT3(0.0f, 1.0f, 0.0f);
+	}
+}
+
+void MeshImporter::WeldVertices(ImportedMesh& _mesh)
+{
+	static_assert(sizeof(MeshVertex) % sizeof(uint32_t) == 0, "vertices are hashed a word at a time");
+
+	std::vector<uint32_t> remap(_mesh.vertices.size(), NO_INDEX);
+	std::vector<MeshVertex> welded;
+	welded.reserve(_mesh.vertices.size());
+	WeldTable<MeshVertex> weldTable;
+	for (uint32_t& index : _mesh.indices)
+	{
+		if (remap[index] == NO_INDEX)
+			remap[index] = weldTable.Insert(welded, _mesh.vertices[index]);
+		index = remap[index];
+	}
+	_mesh.vertices.swap(welded);
+}
+
+void MeshImporter::ComputeBounds(ImportedMesh& _mesh)
+{
+	if (_mesh.vertices.empty())
+	{
+		_mesh.boundsMin = _mesh.boundsMax = XMFLOAT3(0.0f, 0.0f, 0.0f);
+		return;
+	}
+
+	XMVECTOR boundsMin = XMLoadFloat3(&_mesh.vertices[0].position);
+	XMVECTOR boundsMax = boundsMin;
+	for (const MeshVertex& vertex : _mesh.vertices)
+	{
+		XMVECTOR position = XMLoadFloat3(&vertex.position);
+		boundsMin = XMVectorMin(boundsMin, position);
+		boundsMax = XMVectorMax(boundsMax, position);
+	}
+	XMStoreFloat3(&_mesh.boundsMin, boundsMin);
+	XMStoreFloat3(&_mesh.boundsMax, boundsMax);
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include <DirectXMath.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class JobSystem;
+
+// one vertex of an imported mesh. the streams come out interleaved so they can be copied straight into a buffer
+struct MeshVertex
+{
+	DirectX::XMFLOAT3 position;
+	DirectX::XMFLOAT3 normal;
+	DirectX::XMFLOAT2 uv;
+	DirectX::XMFLOAT4 color; // white when the file has none
+};
+
+struct ImportedMesh
+{
+	std::vector<MeshVertex> vertices;
+	std::vector<uint32_t> indices; // a triangle list
+	DirectX::XMFLOAT3 boundsMin = DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
+	DirectX::XMFLOAT3 boundsMax = DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
+	bool hasNormals = false; // false if the normals were generated from the triangles
+	bool hasUvs = false;
+	bool hasColors = false;
+};
+
+struct MeshImportDesc
+{
+	uint32_t windowSize = 64 << 20; // bytes of an obj read from the file at a time
+	uint32_t chunkSize = 1 << 20; // bytes of a window parsed by one job
+	bool weld = true; // share vertices that are exactly the same
+	bool generateNormals = true; // for files without any
+	bool flipGltfHandedness = true; // gltf is right handed: z is negated and the winding reversed so models are not mirrored
+};
+
+// how long the last Load took, and how much welding saved
+struct MeshImportStats
+{
+	uint64_t bytes = 0; // read from disk, buffers included
+	uint32_t corners = 0; // triangle corners, i.e. vertices if nothing was shared
+	uint32_t vertices = 0;
+	double readMs = 0.0; // waiting on the file
+	double parseMs = 0.0;
+	double weldMs = 0.0; // building the vertex stream, generating normals included
+};
+
+// loads Wavefront OBJ and glTF 2.0 (.gltf with its .bin or data uri buffers, or .glb) into one indexed triangle mesh.
+//
+// an obj is read through a fixed window instead of all at once. every window is cut into chunks at line ends that
+// are parsed on the job system into the chunk's own arrays, so nothing is shared while parsing; relative (negative)
+// indices are kept relative to the chunk and resolved when the chunks are appended in order. faces are fanned into
+// triangles and every position/uv/normal triplet is welded into one vertex, chained off its position, so the
+// output is the same whatever the thread count. the "v x y z r g b" vertex colour extension is read too.
+//
+// a gltf's json is tokenised in place, then every triangle primitive of every node in the default scene is written
+// out in world space. the vertices and indices are split into ranges over all primitives so even one huge primitive
+// is decoded in parallel. any component type is read, normalised or not. sparse accessors, morph targets and skins
+// are ignored
+class MeshImporter
+{
+public:
+	MeshImporter() = default;
+	~MeshImporter() = default;
+
+	// picks the format from the extension. false if the file could not be read or is malformed
+	bool Load(const std::string& _fileName, ImportedMesh& _mesh, JobSystem* _pJobSystem = nullptr, const MeshImportDesc& _desc = MeshImportDesc());
+
+	bool LoadObj(const std::string& _fileName, ImportedMesh& _mesh, JobSystem* _pJobSystem = nullptr, const MeshImportDesc& _desc = MeshImportDesc());
+	bool LoadGltf(const std::string& _fileName, ImportedMesh& _mesh, JobSystem* _pJobSystem = nullptr, const MeshImportDesc& _desc = MeshImportDesc());
+
+	const MeshImportStats& Stats() { return m_stats; }
+
+	// area weighted normals, for meshes without any
+	static void GenerateNormals(ImportedMesh& _mesh);
+
+	// merges vertices that are exactly the same and remaps the indices, keeping the order vertices are first used in
+	static void WeldVertices(ImportedMesh& _mesh);
+
+	static void ComputeBounds(ImportedMesh& _mesh);
+
+private:
+	MeshImportStats m_stats;
+};
@@ -0,0 +1,366 @@
+#include "MeshOptimizer.h"
+
+#include <DirectXMath.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <vector>
+
+#include "JobSystem.h"
+#include "MeshImporter.h"
+
+using namespace DirectX;
+
+namespace
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	const uint32_t NO_VERTEX = 0xffffffff;
+
+	double MillisecondsSince(Clock::time_point _start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - _start).count();
+	}
+
+	// a fifo cache kept as the time each vertex went in, so it never has to be searched or shifted. a vertex is in the
+	// cache while fewer than cacheSize others have gone in after it, and Reset just moves time past all of them
+	class FifoCache
+	{
+	public:
+		FifoCache(uint32_t _vertexCount, uint32_t _cacheSize) : m_insertedAt(_vertexCount, 0), m_time(_cacheSize + 1), m_cacheSize(_cacheSize) {}
+
+		bool Contains(uint32_t _vertex) { return m_time - m_insertedAt[_vertex] <= m_cacheSize; }
+
+		// true on a miss
+		bool Touch(uint32_t _vertex)
+		{
+			if (Contains(_vertex))
+				return false;
+			m_insertedAt[_vertex] = m_time++;
+			return true;
+		}
+
+		void Reset() { m_time += m_cacheSize + 1; }
+
+		// how long ago _vertex went in, counted in misses. it drops out once this passes the cache size
+		uint32_t Age(uint32_t _vertex) { return m_time - m_insertedAt[_vertex]; }
+
+	private:
+		std::vector<uint32_t> m_insertedAt;
+		uint32_t m_time;
+		uint32_t m_cacheSize;
+	};
+
+	// the triangles around every vertex, as offsets into one array
+	struct Adjacency
+	{
+		std::vector<uint32_t> offsets; // vertexCount + 1
+		std::vector<uint32_t> triangles;
+	};
+
+	void BuildAdjacency(const uint32_t* _pIndices, uint32_t _indexCount, uint32_t _vertexCount, Adjacency& _adjacency)
+	{
+		_adjacency.offsets.assign(_vertexCount + 1, 0);
+		for (uint32_t i = 0; i < _indexCount; ++i)
+			_adjacency.offsets[_pIndices[i] + 1]++;
+		for (uint32_t vertex = 0; vertex < _vertexCount; ++vertex)
+			_adjacency.offsets[vertex + 1] += _adjacency.offsets[vertex];
+
+		std::vector<uint32_t> cursor(_adjacency.offsets.begin(), _adjacency.offsets.end() - 1);
+		_adjacency.triangles.resize(_indexCount);
+		for (uint32_t i = 0; i < _indexCount; ++i)
+			_adjacency.triangles[cursor[_pIndices[i]]++] = i / 3;
+	}
+
+	XMFLOAT3 LoadPosition(const float* _pPositions, uint32_t _stride, uint32_t _vertex)
+	{
+		XMFLOAT3 position;
+		memcpy(&position, reinterpret_cast<const uint8_t*>(_pPositions) + static_cast<size_t>(_vertex) * _stride, sizeof(position));
+		return position;
+	}
+}
+
+VertexCacheStats MeshOptimizer::AnalyzeVertexCache(const uint32_t* _pIndices, uint32_t _indexCount, uint32_t _vertexCount, uint32_t _cacheSize)
+{
+	VertexCacheStats stats;
+	if (_indexCount < 3)
+		return stats;
+
+	FifoCache cache(_vertexCount, _cacheSize);
+	std::vector<bool> used(_vertexCount, false);
+	uint32_t misses = 0;
+	uint32_t usedCount = 0;
+	for (uint32_t i = 0; i < _indexCount; ++i)
+	{
+		uint32_t vertex = _pIndices[i];
+		misses += cache.Touch(vertex) ? 1 : 0;
+		if (!used[vertex])
+		{
+			used[vertex] = true;
+			usedCount++;
+		}
+	}
+	stats.acmr = static_cast<float>(misses) / (_indexCount / 3);
+	stats.atvr = static_cast<float>(misses) / usedCount;
+	return stats;
+}
+
+void MeshOptimizer::OptimizeVertexCache(uint32_t* _pIndices, uint32_t _indexCount, uint32_t _vertexCount, uint32_t _cacheSize)
+{
+	uint32_t triangleCount = _indexCount / 3;
+	if (triangleCount == 0)
+		return;
+
+	Adjacency adjacency;
+	BuildAdjacency(_pIndices, _indexCount, _vertexCount, adjacency);
+
+	std::vector<uint32_t> liveTriangles(_vertexCount);
+	for (uint32_t vertex = 0; vertex < _vertexCount; ++vertex)
+		liveTriangles[vertex] = adjacency.offsets[vertex + 1] - adjacency.offsets[vertex];
+
+	std::vector<uint32_t> source(_pIndices, _pIndices + _indexCount);
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<uint32_t> deadEnd; // vertices of recent fans, to fall back on when the last fan leads nowhere
+	std::vector<uint32_t> candidates;
+	deadEnd.reserve(_indexCount);
+	FifoCache cache(_vertexCount, _cacheSize);
+
+	uint32_t written = 0;
+	uint32_t cursor = 0; // the lowest vertex that might still have triangles, for when the dead end stack runs out
+	uint32_t fan = NO_VERTEX;
+	while (cursor < _vertexCount && liveTriangles[cursor] == 0)
+		cursor++;
+	fan = cursor < _vertexCount ? cursor : NO_VERTEX;
+
+	while (fan != NO_VERTEX)
+	{
+		// every remaining triangle around the fanning vertex goes out, and its vertices are what we pick the next from
+		candidates.clear();
+		for (uint32_t i = adjacency.offsets[fan]; i < adjacency.offsets[fan + 1]; ++i)
+		{
+			uint32_t triangle = adjacency.triangles[i];
+			if (emitted[triangle])
+				continue;
+			emitted[triangle] = true;
+			for (uint32_t corner = 0; corner < 3; ++corner)
+			{
+				uint32_t vertex = source[triangle * 3 + corner];
+				_pIndices[written++] = vertex;
+				deadEnd.push_back(vertex);
+				candidates.push_back(vertex);
+				liveTriangles[vertex]--;
+				cache.Touch(vertex);
+			}
+		}
+
+		// the candidate that will still be in the cache after its own fan has gone out, the oldest of those first
+		// since it is closest to dropping out. vertices that would fall out are only picked if nothing else can be
+		fan = NO_VERTEX;
+		int32_t bestPriority = -1;
+		for (uint32_t vertex : candidates)
+		{
+			if (liveTriangles[vertex] == 0)
+				continue;
+			int32_t priority = 0;
+			if (cache.Age(vertex) + 2 * liveTriangles[vertex] <= _cacheSize)
+				priority = static_cast<int32_t>(cache.Age(vertex));
+			if (priority > bestPriority)
+			{
+				bestPriority = priority;
+				fan = vertex;
+			}
+		}
+
+		// nothing useful in the last fan: go back through recent vertices, then on through the rest of the mesh
+		while (fan == NO_VERTEX && !deadEnd.empty())
+		{
+			uint32_t vertex = deadEnd.back();
+			deadEnd.pop_back();
+			if (liveTriangles[vertex] > 0)
+				fan = vertex;
+		}
+		while (fan == NO_VERTEX && cursor < _vertexCount)
+		{
+			if (liveTriangles[cursor] > 0)
+				fan = cursor;
+			else
+				cursor++;
+		}
+	}
+}
+
+uint32_t MeshOptimizer::OptimizeOverdraw(uint32_t* _pIndices, uint32_t _indexCount, const float* _pPositions, uint32_t _stride, uint32_t _vertexCount,
+	uint32_t _cacheSize, float _threshold)
+{
+	uint32_t triangleCount = _indexCount / 3;
+	if (triangleCount == 0)
+		return 0;
+
+	// hard boundaries are where the cache order starts over anyway: a triangle none of whose vertices are cached
+	std::vector<uint32_t> hardClusters;
+	{
+		FifoCache cache(_vertexCount, _cacheSize);
+		for (uint32_t triangle = 0; triangle < triangleCount; ++triangle)
+		{
+			uint32_t misses = 0;
+			for (uint32_t corner = 0; corner < 3; ++corner)
+				misses += cache.Touch(_pIndices[triangle * 3 + corner]) ? 1 : 0;
+			if (misses == 3 || triangle == 0)
+				hardClusters.push_back(triangle);
+		}
+		hardClusters.push_back(triangleCount);
+	}
+
+	// each hard cluster is cut again wherever the part before the cut, drawn with a cold cache, costs no more than
+	// _threshold times the whole cluster does. a cut there loses next to nothing and gives the sort more to work with
+	std::vector<uint32_t> clusters;
+	{
+		FifoCache cache(_vertexCount, _cacheSize);
+		for (size_t hard = 0; hard + 1 < hardClusters.size(); ++hard)
+		{
+			uint32_t begin = hardClusters[hard];
+			uint32_t end = hardClusters[hard + 1];
+
+			cache.Reset();
+			uint32_t clusterMisses = 0;
+			for (uint32_t i = begin * 3; i < end * 3; ++i)
+				clusterMisses += cache.Touch(_pIndices[i]) ? 1 : 0;
+			float limit = _threshold * clusterMisses / (end - begin);
+
+			cache.Reset();
+			clusters.push_back(begin);
+			uint32_t start = begin;
+			uint32_t misses = 0;
+			for (uint32_t triangle = begin; triangle < end; ++triangle)
+			{
+				for (uint32_t corner = 0; corner < 3; ++corner)
+					misses += cache.Touch(_pIndices[triangle * 3 + corner]) ? 1 : 0;
+				if (triangle + 1 < end && static_cast<float>(misses) / (triangle + 1 - start) <= limit)
+				{
+					start = triangle + 1;
+					misses = 0;
+					cache.Reset();
+					clusters.push_back(start);
+				}
+			}
+		}
+		clusters.push_back(triangleCount);
+	}
+	uint32_t clusterCount = static_cast<uint32_t>(clusters.size() - 1);
+
+	// area weighted centres and normals, of every cluster and of the whole mesh
+	std::vector<XMFLOAT3> centroids(clusterCount);
+	std::vector<XMFLOAT3> normals(clusterCount);
+	XMVECTOR meshCentroid = XMVectorZero();
+	float meshArea = 0.0f;
+	for (uint32_t cluster = 0; cluster < clusterCount; ++cluster)
+	{
+		XMVECTOR centroid = XMVectorZero();
+		XMVECTOR normal = XMVectorZero();
+		float area = 0.0f;
+		for (uint32_t triangle = clusters[cluster]; triangle < clusters[cluster + 1]; ++triangle)
+		{
+			XMFLOAT3 p0 = LoadPosition(_pPositions, _stride, _pIndices[triangle * 3 + 0]);
+			XMFLOAT3 p1 = LoadPosition(_pPositions, _stride, _pIndices[triangle * 3 + 1]);
+			XMFLOAT3 p2 = LoadPosition(_pPositions, _stride, _pIndices[triangle * 3 + 2]);
+			XMVECTOR a = XMLoadFloat3(&p0);
+			XMVECTOR b = XMLoadFloat3(&p1);
+			XMVECTOR c = XMLoadFloat3(&p2);
+			XMVECTOR cross = XMVector3Cross(XMVectorSubtract(b, a), XMVectorSubtract(c, a));
+			float triangleArea = XMVectorGetX(XMVector3Length(cross));
+			centroid = XMVectorAdd(centroid, XMVectorScale(XMVectorAdd(XMVectorAdd(a, b), c), triangleArea / 3.0f));
+			normal = XMVectorAdd(normal, cross);
+			area += triangleArea;
+		}
+		meshCentroid = XMVectorAdd(meshCentroid, centroid);
+		meshArea += area;
+		XMStoreFloat3(&centroids[cluster], area > 0.0f ? XMVectorScale(centroid, 1.0f / area) : centroid);
+		XMStoreFloat3(&normals[cluster], XMVector3Normalize(normal));
+	}
+	if (meshArea > 0.0f)
+		meshCentroid = XMVectorScale(meshCentroid, 1.0f / meshArea);
+
+	// clusters that face away from the centre are more likely to hide the others, so they go first
+	std::vector<float> sortKeys(clusterCount);
+	for (uint32_t cluster = 0; cluster < clusterCount; ++cluster)
+	{
+		XMVECTOR offset = XMVectorSubtract(XMLoadFloat3(&centroids[cluster]), meshCentroid);
+		sortKeys[cluster] = XMVectorGetX(XMVector3Dot(offset, XMLoadFloat3(&normals[cluster])));
+	}
+	std::vector<uint32_t> order(clusterCount);
+	for (uint32_t cluster = 0; cluster < clusterCount; ++cluster)
+		order[cluster] = cluster;
+	std::stable_sort(order.begin(), order.end(), [&sortKeys](uint32_t _a, uint32_t _b) { return sortKeys[_a] > sortKeys[_b]; });
+
+	std::vector<uint32_t> source(_pIndices, _pIndices + triangleCount * 3);
+	uint32_t written = 0;
+	for (uint32_t cluster : order)
+	{
+		uint32_t begin = clusters[cluster] * 3;
+		uint32_t end = clusters[cluster + 1] * 3;
+		memcpy(_pIndices + written, source.data() + begin, (end - begin) * sizeof(uint32_t));
+		written += end - begin;
+	}
+	return clusterCount;
+}
+
+void MeshOptimizer::OptimizeVertexFetch(ImportedMesh& _mesh, std::vector<uint32_t>* _pRemap)
+{
+	std::vector<uint32_t> remap(_mesh.vertices.size(), NO_VERTEX);
+	std::vector<MeshVertex> vertices;
+	vertices.reserve(_mesh.vertices.size());
+	for (uint32_t& index : _mesh.indices)
+	{
+		if (remap[index] == NO_VERTEX)
+		{
+			remap[index] = static_cast<uint32_t>(vertices.size());
+			vertices.push_back(_mesh.vertices[index]);
+		}
+		index = remap[index];
+	}
+	_mesh.vertices.swap(vertices);
+	if (_pRemap)
+		_pRemap->swap(remap);
+}
+
+void MeshOptimizer::Optimize(ImportedMesh& _mesh, const MeshOptimizeDesc& _desc, MeshOptimizeStats* _pStats)
+{
+	Clock::time_point start = Clock::now();
+	uint32_t indexCount = static_cast<uint32_t>(_mesh.indices.size());
+	uint32_t vertexCount = static_cast<uint32_t>(_mesh.vertices.size());
+	MeshOptimizeStats stats;
+	stats.before = AnalyzeVertexCache(_mesh.indices.data(), indexCount, vertexCount, _desc.cacheSize);
+
+	OptimizeVertexCache(_mesh.indices.data(), indexCount, vertexCount, _desc.cacheSize);
+	if (_desc.reduceOverdraw && !_mesh.vertices.empty())
+	{
+		stats.clusterCount = OptimizeOverdraw(_mesh.indices.data(), indexCount, &_mesh.vertices[0].position.x, sizeof(MeshVertex),
+			vertexCount, _desc.cacheSize, _desc.overdrawThreshold);
+	}
+
+	if (_desc.optimizeVertexFetch)
+	{
+		OptimizeVertexFetch(_mesh);
+		vertexCount = static_cast<uint32_t>(_mesh.vertices.size());
+	}
+
+	stats.after = AnalyzeVertexCache(_mesh.indices.data(), indexCount, vertexCount, _desc.cacheSize);
+	stats.ms = MillisecondsSince(start);
+	if (_pStats)
+		*_pStats = stats;
+}
+
+void MeshOptimizer::OptimizeMeshes(ImportedMesh* _pMeshes, uint32_t _count, const MeshOptimizeDesc& _desc, MeshOptimizeStats* _pStats, JobSystem* _pJobSystem)
+{
+	// one mesh per job: each one is a serial pass over its own arrays
+	auto optimizeRange = [&](unsigned int _begin, unsigned int _end)
+	{
+		for (unsigned int i = _begin; i < _end; ++i)
+			Optimize(_pMeshes[i], _desc, _pStats ? &_pStats[i] : nullptr);
+	};
+	if (_pJobSystem)
+		_pJobSystem->ParallelFor(_count, 1, optimizeRange);
+	else
+		optimizeRange(0, _count);
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+class JobSystem;
+struct ImportedMesh;
+
+// how well an index order uses a fifo post transform cache of a given size
+struct VertexCacheStats
+{
+	float acmr = 0.0f; // average cache miss ratio: vertices shaded per triangle, 0.5 at best on a big regular mesh, 3 at worst
+	float atvr = 0.0f; // average transformed vertex ratio: vertices shaded per vertex used, 1 at best
+};
+
+struct MeshOptimizeDesc
+{
+	uint32_t cacheSize = 16; // entries of the cache tipsify plans for. small enough to suit any gpu's real cache
+	bool reduceOverdraw = true; // reorder clusters of triangles so the outward facing ones come first
+	float overdrawThreshold = 1.05f; // how much worse than the cache order alone the acmr may get for that
+	bool optimizeVertexFetch = true; // store the vertices in the order they are first used
+};
+
+struct MeshOptimizeStats
+{
+	VertexCacheStats before;
+	VertexCacheStats after;
+	uint32_t clusterCount = 0; // triangle clusters the overdraw pass sorted
+	double ms = 0.0;
+};
+
+// reorders a mesh's triangles and vertices for the gpu, without changing what it looks like.
+//
+// the triangles are put in vertex cache order with tipsify (Sander, Nehab and Barczak, "Fast triangle reordering
+// for vertex locality and reduced overdraw", 2007): it fans around one vertex at a time and moves on to whichever
+// vertex of the last fan will still be in the cache, so it runs in linear time. the cache order is then cut into
+// clusters, wherever the cache started over or where a cut costs less than overdrawThreshold, and the clusters are
+// sorted so those facing away from the mesh's centre are drawn first and hide the rest. last, the vertices are
+// renumbered in the order the triangles first use them so vertex fetch walks through memory.
+//
+// everything is deterministic and single threaded per mesh; OptimizeMeshes runs many meshes on the job system
+namespace MeshOptimizer
+{
+	// simulates a fifo cache of _cacheSize entries over the triangle list
+	VertexCacheStats AnalyzeVertexCache(const uint32_t* _pIndices, uint32_t _indexCount, uint32_t _vertexCount, uint32_t _cacheSize = 16);
+
+	// rewrites _pIndices in tipsify order
+	void OptimizeVertexCache(uint32_t* _pIndices, uint32_t _indexCount, uint32_t _vertexCount, uint32_t _cacheSize = 16);
+
+	// reorders the clusters of an index list already in cache order. positions are three floats read _stride bytes
+	// apart. returns the number of clusters
+	uint32_t OptimizeOverdraw(uint32_t* _pIndices, uint32_t _indexCount, const float* _pPositions, uint32_t _stride, uint32_t _vertexCount,
+		uint32_t _cacheSize = 16, float _threshold = 1.05f);
+
+	// renumbers the vertices in the order the indices first reach them and drops any nothing uses. _pRemap, if given,
+	// gets the new number of every old vertex, or 0xffffffff for those dropped
+	void OptimizeVertexFetch(ImportedMesh& _mesh, std::vector<uint32_t>* _pRemap = nullptr);
+
+	// everything above, in order, on one mesh
+	void Optimize(ImportedMesh& _mesh, const MeshOptimizeDesc& _desc = MeshOptimizeDesc(), MeshOptimizeStats* _pStats = nullptr);
+
+	// Optimize on _count meshes at once. _pStats, if given, has one entry per mesh
+	void OptimizeMeshes(ImportedMesh* _pMeshes, uint32_t _count, const MeshOptimizeDesc& _desc = MeshOptimizeDesc(),
+		MeshOptimizeStats* _pStats = nullptr, JobSystem* _pJobSystem = nullptr);
+}
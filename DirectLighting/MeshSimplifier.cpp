@@ -0,0 +1,478 @@
+#include "MeshSimplifier.h"
+
+#include <DirectXMath.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#include "JobSystem.h"
+#include "MeshImporter.h"
+#include "MeshOptimizer.h"
+
+using namespace DirectX;
+
+namespace
+{
+	const double BORDER_WEIGHT = 10.0; // how much more moving an open edge costs than moving the surface
+	const float NORMAL_WEIGHT = 0.5f; // of a normal's change over an edge, per unit of the edge's length
+	const float COLOR_WEIGHT = 0.5f;
+	const float MIN_FLIP_DOT = 0.25f; // no triangle may turn by more than about 75 degrees
+	const float MIN_LEVEL_SAVING = 0.9f; // a level has to drop at least a tenth of the triangles of the one before
+	const uint32_t NO_VERTEX = 0xffffffff;
+
+	enum VertexKind : uint8_t
+	{
+		KIND_MANIFOLD, // inside the surface, may collapse onto any neighbour
+		KIND_BORDER, // on one open border, may only collapse along it
+		KIND_LOCKED, // on a seam, a non manifold edge or where borders meet
+	};
+
+	// a symmetric 4x4 matrix Q with error(p) = [p 1] Q [p 1]^T, the weighted sum of the squared distances from p to
+	// every plane added to it. only the upper triangle is kept. doubles, as the terms cancel out a lot
+	struct Quadric
+	{
+		double a00, a01, a02, a11, a12, a22;
+		double b0, b1, b2;
+		double c;
+		double weight;
+	};
+
+	void AddPlane(Quadric& _quadric, XMVECTOR _normal, XMVECTOR _point, double _weight)
+	{
+		XMFLOAT3 n;
+		XMStoreFloat3(&n, _normal);
+		double d = -XMVectorGetX(XMVector3Dot(_normal, _point));
+		_quadric.a00 += _weight * n.x * n.x;
+		_quadric.a01 += _weight * n.x * n.y;
+		_quadric.a02 += _weight * n.x * n.z;
+		_quadric.a11 += _weight * n.y * n.y;
+		_quadric.a12 += _weight * n.y * n.z;
+		_quadric.a22 += _weight * n.z * n.z;
+		_quadric.b0 += _weight * n.x * d;
+		_quadric.b1 += _weight * n.y * d;
+		_quadric.b2 += _weight * n.z * d;
+		_quadric.c += _weight * d * d;
+		_quadric.weight += _weight;
+	}
+
+	void AddQuadric(Quadric& _quadric, const Quadric& _other)
+	{
+		_quadric.a00 += _other.a00;
+		_quadric.a01 += _other.a01;
+		_quadric.a02 += _other.a02;
+		_quadric.a11 += _other.a11;
+		_quadric.a12 += _other.a12;
+		_quadric.a22 += _other.a22;
+		_quadric.b0 += _other.b0;
+		_quadric.b1 += _other.b1;
+		_quadric.b2 += _other.b2;
+		_quadric.c += _other.c;
+		_quadric.weight += _other.weight;
+	}
+
+	// the root mean square distance from _point to the planes of _a and _b together
+	float QuadricError(const Quadric& _a, const Quadric& _b, const XMFLOAT3& _point)
+	{
+		double weight = _a.weight + _b.weight;
+		if (weight <= 0.0)
+			return 0.0f;
+		double x = _point.x;
+		double y = _point.y;
+		double z = _point.z;
+		double error = (_a.a00 + _b.a00) * x * x + (_a.a11 + _b.a11) * y * y + (_a.a22 + _b.a22) * z * z +
+			2.0 * ((_a.a01 + _b.a01) * x * y + (_a.a02 + _b.a02) * x * z + (_a.a12 + _b.a12) * y * z) +
+			2.0 * ((_a.b0 + _b.b0) * x + (_a.b1 + _b.b1) * y + (_a.b2 + _b.b2) * z) + _a.c + _b.c;
+		return static_cast<float>(std::sqrt(std::max(error, 0.0) / weight));
+	}
+
+	uint64_t EdgeKey(uint32_t _a, uint32_t _b)
+	{
+		return (static_cast<uint64_t>(_a) << 32) | _b;
+	}
+
+	// one id per distinct position, the lowest numbered vertex there, so vertices that differ only in their
+	// attributes share an id
+	std::vector<uint32_t> PositionIds(const MeshVertex* _pVertices, uint32_t _vertexCount)
+	{
+		std::vector<uint32_t> order(_vertexCount);
+		for (uint32_t vertex = 0; vertex < _vertexCount; ++vertex)
+			order[vertex] = vertex;
+		auto compare = [&](uint32_t _a, uint32_t _b)
+		{
+			int difference = memcmp(&_pVertices[_a].position, &_pVertices[_b].position, sizeof(XMFLOAT3));
+			return difference != 0 ? difference < 0 : _a < _b;
+		};
+		std::sort(order.begin(), order.end(), compare);
+
+		std::vector<uint32_t> ids(_vertexCount);
+		for (uint32_t i = 0; i < _vertexCount; ++i)
+		{
+			bool samePosition = i > 0 && memcmp(&_pVertices[order[i]].position, &_pVertices[order[i - 1]].position, sizeof(XMFLOAT3)) == 0;
+			ids[order[i]] = samePosition ? ids[order[i - 1]] : order[i];
+		}
+		return ids;
+	}
+
+	// everything Simplify needs about the mesh, shared by its passes
+	class Simplifier
+	{
+	public:
+		Simplifier(const MeshVertex* _pVertices, uint32_t _vertexCount) : m_pVertices(_pVertices), m_vertexCount(_vertexCount),
+			m_positionIds(PositionIds(_pVertices, _vertexCount)), m_quadrics(_vertexCount, Quadric()), m_kinds(_vertexCount, KIND_MANIFOLD) {}
+
+		// the planes of the triangles and of the borders, each kept at its position's id
+		void InitQuadrics(const std::vector<uint32_t>& _indices)
+		{
+			Classify(_indices);
+			for (size_t i = 0; i < _indices.size(); i += 3)
+			{
+				XMVECTOR p[3];
+				for (uint32_t corner = 0; corner < 3; ++corner)
+					p[corner] = XMLoadFloat3(&m_pVertices[_indices[i + corner]].position);
+				XMVECTOR cross = XMVector3Cross(XMVectorSubtract(p[1], p[0]), XMVectorSubtract(p[2], p[0]));
+				float length = XMVectorGetX(XMVector3Length(cross));
+				if (length <= 0.0f)
+					continue;
+				XMVECTOR normal = XMVectorScale(cross, 1.0f / length);
+				for (uint32_t corner = 0; corner < 3; ++corner)
+					AddPlane(m_quadrics[m_positionIds[_indices[i + corner]]], normal, p[0], length * 0.5);
+
+				// a plane through each open edge at right angles to the triangle holds the border in place
+				for (uint32_t corner = 0; corner < 3; ++corner)
+				{
+					uint32_t a = m_positionIds[_indices[i + corner]];
+					uint32_t b = m_positionIds[_indices[i + (corner + 1) % 3]];
+					if (!IsBorderEdge(a, b))
+						continue;
+					XMVECTOR edge = XMVectorSubtract(p[(corner + 1) % 3], p[corner]);
+					XMVECTOR borderNormal = XMVector3Normalize(XMVector3Cross(edge, normal));
+					double weight = BORDER_WEIGHT * XMVectorGetX(XMVector3LengthSq(edge));
+					AddPlane(m_quadrics[a], borderNormal, p[corner], weight);
+					AddPlane(m_quadrics[b], borderNormal, p[corner], weight);
+				}
+			}
+		}
+
+		// works out every position's VertexKind and the open edges for the triangles as they are now
+		void Classify(const std::vector<uint32_t>& _indices)
+		{
+			// positions reached by more than one vertex are seams
+			std::vector<uint32_t> wedges(m_vertexCount, NO_VERTEX);
+			std::fill(m_kinds.begin(), m_kinds.end(), KIND_MANIFOLD);
+			for (uint32_t vertex : _indices)
+			{
+				uint32_t id = m_positionIds[vertex];
+				if (wedges[id] == NO_VERTEX)
+					wedges[id] = vertex;
+				else if (wedges[id] != vertex)
+					m_kinds[id] = KIND_LOCKED;
+			}
+
+			m_edges.clear();
+			for (size_t i = 0; i < _indices.size(); i += 3)
+			{
+				for (uint32_t corner = 0; corner < 3; ++corner)
+				{
+					uint32_t a = m_positionIds[_indices[i + corner]];
+					uint32_t b = m_positionIds[_indices[i + (corner + 1) % 3]];
+					if (a != b)
+						m_edges.push_back({ EdgeKey(std::min(a, b), std::max(a, b)), a > b });
+				}
+			}
+			std::sort(m_edges.begin(), m_edges.end(), [](const Edge& _a, const Edge& _b) { return _a.key < _b.key; });
+
+			// an edge used by one triangle is open. one used twice the same way, or more than twice, is not manifold
+			std::vector<uint32_t> borderEdges(m_vertexCount, 0);
+			m_borderEdges.clear();
+			for (size_t first = 0, last = 0; first < m_edges.size(); first = last)
+			{
+				uint32_t uses[2] = {};
+				for (last = first; last < m_edges.size() && m_edges[last].key == m_edges[first].key; ++last)
+					uses[m_edges[last].reversed]++;
+				uint32_t a = static_cast<uint32_t>(m_edges[first].key >> 32);
+				uint32_t b = static_cast<uint32_t>(m_edges[first].key);
+				if (uses[0] > 1 || uses[1] > 1)
+				{
+					m_kinds[a] = KIND_LOCKED;
+					m_kinds[b] = KIND_LOCKED;
+				}
+				else if (uses[0] + uses[1] == 1)
+				{
+					m_borderEdges.push_back(m_edges[first].key);
+					borderEdges[a]++;
+					borderEdges[b]++;
+				}
+			}
+			for (uint32_t id = 0; id < m_vertexCount; ++id)
+			{
+				if (borderEdges[id] > 0 && m_kinds[id] == KIND_MANIFOLD)
+					m_kinds[id] = borderEdges[id] == 2 ? KIND_BORDER : KIND_LOCKED;
+			}
+		}
+
+		bool IsBorderEdge(uint32_t _a, uint32_t _b)
+		{
+			return std::binary_search(m_borderEdges.begin(), m_borderEdges.end(), EdgeKey(std::min(_a, _b), std::max(_a, _b)));
+		}
+
+		bool IsOpenEdge(uint32_t _a, uint32_t _b)
+		{
+			uint32_t a = m_positionIds[_a];
+			uint32_t b = m_positionIds[_b];
+			return m_kinds[a] != KIND_MANIFOLD && m_kinds[b] != KIND_MANIFOLD && IsBorderEdge(a, b);
+		}
+
+		bool CanCollapse(uint32_t _from, uint32_t _to)
+		{
+			uint32_t from = m_positionIds[_from];
+			uint32_t to = m_positionIds[_to];
+			if (from == to)
+				return false;
+			if (m_kinds[from] == KIND_MANIFOLD)
+				return true;
+			return m_kinds[from] == KIND_BORDER && IsBorderEdge(from, to);
+		}
+
+		// the quadric error of moving _from onto _to, plus what the change in normal and colour along the edge costs
+		float CollapseCost(uint32_t _from, uint32_t _to)
+		{
+			const MeshVertex& from = m_pVertices[_from];
+			const MeshVertex& to = m_pVertices[_to];
+			float error = QuadricError(m_quadrics[m_positionIds[_from]], m_quadrics[m_positionIds[_to]], to.position);
+
+			float length = XMVectorGetX(XMVector3Length(XMVectorSubtract(XMLoadFloat3(&to.position), XMLoadFloat3(&from.position))));
+			float normalChange = XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(XMLoadFloat3(&to.normal), XMLoadFloat3(&from.normal))));
+			float colorChange = XMVectorGetX(XMVector4LengthSq(XMVectorSubtract(XMLoadFloat4(&to.color), XMLoadFloat4(&from.color))));
+			return error + std::sqrt(NORMAL_WEIGHT * normalChange + COLOR_WEIGHT * colorChange) * length;
+		}
+
+		void MergeQuadric(uint32_t _from, uint32_t _to)
+		{
+			AddQuadric(m_quadrics[m_positionIds[_to]], m_quadrics[m_positionIds[_from]]);
+		}
+
+		uint32_t PositionId(uint32_t _vertex) { return m_positionIds[_vertex]; }
+		const XMFLOAT3& Position(uint32_t _vertex) { return m_pVertices[_vertex].position; }
+
+	private:
+		const MeshVertex* m_pVertices;
+		uint32_t m_vertexCount;
+		std::vector<uint32_t> m_positionIds;
+		std::vector<Quadric> m_quadrics; // by position id
+		std::vector<VertexKind> m_kinds; // by position id
+		struct Edge
+		{
+			uint64_t key; // lower position id first
+			uint32_t reversed; // 1 if the triangle runs from the higher id to the lower
+		};
+		std::vector<Edge> m_edges; // every triangle's edges, sorted by key
+		std::vector<uint64_t> m_borderEdges; // the keys of the open ones, sorted
+	};
+
+	struct Collapse
+	{
+		float cost;
+		uint32_t from;
+		uint32_t to;
+
+		bool operator<(const Collapse& _other) const
+		{
+			if (cost != _other.cost)
+				return cost < _other.cost;
+			return from != _other.from ? from < _other.from : to < _other.to;
+		}
+	};
+}
+
+float MeshSimplifier::Simplify(const uint32_t* _pIndices, uint32_t _indexCount, const MeshVertex* _pVertices, uint32_t _vertexCount,
+	uint32_t _targetIndexCount, float _maxError, std::vector<uint32_t>& _result)
+{
+	_result.assign(_pIndices, _pIndices + _indexCount / 3 * 3);
+	if (_result.size() <= _targetIndexCount)
+		return 0.0f;
+
+	Simplifier simplifier(_pVertices, _vertexCount);
+	simplifier.InitQuadrics(_result);
+
+	float error = 0.0f;
+	std::vector<uint32_t> offsets(_vertexCount + 1);
+	std::vector<uint32_t> adjacency;
+	std::vector<Collapse> collapses;
+	std::vector<uint32_t> collapseTo(_vertexCount);
+	std::vector<uint8_t> locked(_vertexCount);
+	for (uint32_t pass = 0; _result.size() > _targetIndexCount; ++pass)
+	{
+		if (pass > 0)
+			simplifier.Classify(_result);
+		uint32_t triangleCount = static_cast<uint32_t>(_result.size() / 3);
+
+		// the triangles around every vertex
+		std::fill(offsets.begin(), offsets.end(), 0);
+		for (uint32_t vertex : _result)
+			offsets[vertex + 1]++;
+		for (uint32_t vertex = 0; vertex < _vertexCount; ++vertex)
+			offsets[vertex + 1] += offsets[vertex];
+		adjacency.resize(_result.size());
+		{
+			std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+			for (uint32_t i = 0; i < _result.size(); ++i)
+				adjacency[cursor[_result[i]]++] = i / 3;
+		}
+
+		// the cheaper way to collapse every edge. an inner edge is seen once each way, so it is taken from the
+		// triangle where it runs from the lower position id, an open edge is seen only once
+		collapses.clear();
+		for (uint32_t i = 0; i < _result.size(); ++i)
+		{
+			uint32_t a = _result[i];
+			uint32_t b = _result[i - i % 3 + (i % 3 + 1) % 3];
+			if (simplifier.PositionId(a) > simplifier.PositionId(b) && !simplifier.IsOpenEdge(a, b))
+				continue;
+			Collapse forward = { FLT_MAX, a, b };
+			Collapse backward = { FLT_MAX, b, a };
+			if (simplifier.CanCollapse(a, b))
+				forward.cost = simplifier.CollapseCost(a, b);
+			if (simplifier.CanCollapse(b, a))
+				backward.cost = simplifier.CollapseCost(b, a);
+			const Collapse& collapse = backward < forward ? backward : forward;
+			if (collapse.cost <= _maxError)
+				collapses.push_back(collapse);
+		}
+		std::sort(collapses.begin(), collapses.end());
+
+		// take them in order, skipping any that touch a triangle already changed this pass
+		for (uint32_t vertex = 0; vertex < _vertexCount; ++vertex)
+			collapseTo[vertex] = vertex;
+		std::fill(locked.begin(), locked.end(), 0);
+		uint32_t trianglesToRemove = triangleCount - static_cast<uint32_t>(_targetIndexCount / 3);
+		uint32_t removed = 0;
+		uint32_t collapsed = 0;
+		for (const Collapse& collapse : collapses)
+		{
+			if (removed >= trianglesToRemove)
+				break;
+			uint32_t fromId = simplifier.PositionId(collapse.from);
+			uint32_t toId = simplifier.PositionId(collapse.to);
+			if (locked[fromId] || locked[toId])
+				continue;
+
+			// the triangles that keep their area must not turn around
+			XMVECTOR target = XMLoadFloat3(&simplifier.Position(collapse.to));
+			bool flips = false;
+			uint32_t dropped = 0;
+			for (uint32_t j = offsets[collapse.from]; j < offsets[collapse.from + 1] && !flips; ++j)
+			{
+				const uint32_t* pTriangle = &_result[adjacency[j] * 3];
+				XMVECTOR before[3];
+				XMVECTOR after[3];
+				bool touchesTarget = false;
+				for (uint32_t corner = 0; corner < 3; ++corner)
+				{
+					touchesTarget = touchesTarget || simplifier.PositionId(pTriangle[corner]) == toId;
+					before[corner] = XMLoadFloat3(&simplifier.Position(pTriangle[corner]));
+					after[corner] = pTriangle[corner] == collapse.from ? target : before[corner];
+				}
+				if (touchesTarget)
+				{
+					dropped++;
+					continue;
+				}
+				XMVECTOR normalBefore = XMVector3Cross(XMVectorSubtract(before[1], before[0]), XMVectorSubtract(before[2], before[0]));
+				XMVECTOR normalAfter = XMVector3Cross(XMVectorSubtract(after[1], after[0]), XMVectorSubtract(after[2], after[0]));
+				float lengths = XMVectorGetX(XMVector3Length(normalBefore)) * XMVectorGetX(XMVector3Length(normalAfter));
+				float dot = XMVectorGetX(XMVector3Dot(normalBefore, normalAfter));
+				flips = XMVectorGetX(XMVector3LengthSq(normalBefore)) > 0.0f && dot <= MIN_FLIP_DOT * lengths;
+			}
+			if (flips)
+				continue;
+
+			collapseTo[collapse.from] = collapse.to;
+			simplifier.MergeQuadric(collapse.from, collapse.to);
+			error = std::max(error, collapse.cost);
+			removed += dropped;
+			collapsed++;
+
+			// everything around the moved vertex now has new triangles, so nothing else may use them this pass
+			for (uint32_t j = offsets[collapse.from]; j < offsets[collapse.from + 1]; ++j)
+			{
+				const uint32_t* pTriangle = &_result[adjacency[j] * 3];
+				for (uint32_t corner = 0; corner < 3; ++corner)
+					locked[simplifier.PositionId(pTriangle[corner])] = 1;
+			}
+		}
+		if (collapsed == 0)
+			break;
+
+		// move the collapsed vertices and drop the triangles that lost their area
+		uint32_t write = 0;
+		for (uint32_t triangle = 0; triangle < triangleCount; ++triangle)
+		{
+			uint32_t a = collapseTo[_result[triangle * 3 + 0]];
+			uint32_t b = collapseTo[_result[triangle * 3 + 1]];
+			uint32_t c = collapseTo[_result[triangle * 3 + 2]];
+			uint32_t idA = simplifier.PositionId(a);
+			uint32_t idB = simplifier.PositionId(b);
+			uint32_t idC = simplifier.PositionId(c);
+			if (idA == idB || idB == idC || idA == idC)
+				continue;
+			_result[write++] = a;
+			_result[write++] = b;
+			_result[write++] = c;
+		}
+		_result.resize(write);
+	}
+	return error;
+}
+
+void MeshSimplifier::GenerateLods(const ImportedMesh& _mesh, const MeshLodDesc& _desc, std::vector<MeshLodLevel>& _levels, JobSystem* _pJobSystem)
+{
+	_levels.clear();
+	_levels.resize(1);
+	_levels[0].indices = _mesh.indices;
+	uint32_t vertexCount = static_cast<uint32_t>(_mesh.vertices.size());
+	if (vertexCount == 0)
+		return;
+
+	// the triangle count every level aims for
+	std::vector<uint32_t> targets;
+	uint32_t triangles = static_cast<uint32_t>(_mesh.indices.size() / 3);
+	for (uint32_t lod = 1; lod < _desc.maxLods; ++lod)
+	{
+		triangles = static_cast<uint32_t>(triangles * _desc.reduction);
+		if (triangles < _desc.minTriangles)
+			break;
+		targets.push_back(triangles * 3);
+	}
+
+	// each level starts from the full mesh, so they do not wait for each other
+	XMVECTOR extent = XMVectorSubtract(XMLoadFloat3(&_mesh.boundsMax), XMLoadFloat3(&_mesh.boundsMin));
+	float maxError = _desc.maxError * XMVectorGetX(XMVector3Length(extent));
+	std::vector<MeshLodLevel> levels(targets.size());
+	auto simplifyLevels = [&](unsigned int _begin, unsigned int _end)
+	{
+		for (unsigned int i = _begin; i < _end; ++i)
+		{
+			std::vector<uint32_t>& indices = levels[i].indices;
+			levels[i].error = Simplify(_mesh.indices.data(), static_cast<uint32_t>(_mesh.indices.size()), _mesh.vertices.data(), vertexCount,
+				targets[i], maxError, indices);
+			MeshOptimizer::OptimizeVertexCache(indices.data(), static_cast<uint32_t>(indices.size()), vertexCount);
+		}
+	};
+	uint32_t levelCount = static_cast<uint32_t>(levels.size());
+	if (_pJobSystem && levelCount > 1)
+		_pJobSystem->ParallelFor(levelCount, 1, simplifyLevels);
+	else
+		simplifyLevels(0, levelCount);
+
+	// levels stuck at maxError come out the same as the one before them
+	for (MeshLodLevel& level : levels)
+	{
+		const MeshLodLevel& previous = _levels.back();
+		if (level.indices.empty() || level.indices.size() > previous.indices.size() * MIN_LEVEL_SAVING)
+			continue;
+		level.error = std::max(level.error, previous.error);
+		_levels.push_back(std::move(level));
+	}
+}
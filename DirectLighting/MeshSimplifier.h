@@ -0,0 +1,49 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+class JobSystem;
+struct ImportedMesh;
+struct MeshVertex;
+
+struct MeshLodDesc
+{
+	uint32_t maxLods = 4; // levels, the full mesh included
+	float reduction = 0.5f; // each level aims for this fraction of the triangles of the one before
+	uint32_t minTriangles = 32; // no level is made with fewer
+	float maxError = 0.05f; // no level strays further than this fraction of the mesh's bounding box diagonal
+};
+
+struct MeshLodLevel
+{
+	std::vector<uint32_t> indices; // into the full mesh's vertices
+	float error = 0.0f; // how far it strays from the full mesh, in object space units
+};
+
+// makes coarser versions of a mesh for drawing it far away.
+//
+// Simplify collapses edges, cheapest first, where the cost is the quadric error metric (Garland and Heckbert,
+// "Surface simplification using quadric error metrics", 1997): every vertex keeps the planes of the triangles around
+// it, weighted by their area, and moving it costs the root mean square distance to those planes. a vertex only ever
+// collapses onto one of its neighbours, so the levels need no vertices of their own and share the full mesh's vertex
+// buffer. on top of that:
+// - open edges add planes at right angles to the surface, so borders resist being pulled in, and a border vertex
+//   may only slide along its border
+// - a position shared by several vertices (a seam in the normals, colours or uvs) never moves, so seams stay sharp
+// - collapsing across a change in normal or colour costs extra, in proportion to the edge's length
+// - a collapse that turns any triangle around too far is skipped
+//
+// each pass picks the cheapest collapses that do not touch each other, so passes are deterministic and the error
+// only grows
+namespace MeshSimplifier
+{
+	// collapses edges of _pIndices until at most _targetIndexCount indices are left or the next collapse would stray
+	// more than _maxError object space units. returns how far _result strays
+	float Simplify(const uint32_t* _pIndices, uint32_t _indexCount, const MeshVertex* _pVertices, uint32_t _vertexCount,
+		uint32_t _targetIndexCount, float _maxError, std::vector<uint32_t>& _result);
+
+	// level 0 is _mesh's own triangles. the others are all simplified from it at once on the job system and put in
+	// vertex cache order. a level that comes out hardly smaller than the one before is dropped, so there can be
+	// fewer than maxLods
+	void GenerateLods(const ImportedMesh& _mesh, const MeshLodDesc& _desc, std::vector<MeshLodLevel>& _levels, JobSystem* _pJobSystem = nullptr);
+}
@@ -0,0 +1,341 @@
+#include "MeshletBuilder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "MeshOptimizer.h"
+
+using namespace DirectX;
+
+namespace
+{
+	const uint32_t NO_INDEX = 0xffffffff;
+	const float NO_CONE_CUTOFF = 2.0f; // more than any dot product can reach
+	const float MIN_CONE_DOT = 0.1f; // normals spread wider than this (about 84 degrees) make a cone too wide to ever cull
+
+	XMFLOAT3 LoadPosition(const float* _pPositions, uint32_t _stride, uint32_t _vertex)
+	{
+		XMFLOAT3 position;
+		memcpy(&position, reinterpret_cast<const uint8_t*>(_pPositions) + static_cast<size_t>(_vertex) * _stride, sizeof(position));
+		return position;
+	}
+
+	// for every vertex, the lowest numbered vertex at exactly the same position
+	std::vector<uint32_t> PositionIds(const float* _pPositions, uint32_t _stride, uint32_t _vertexCount)
+	{
+		std::vector<XMFLOAT3> positions(_vertexCount);
+		std::vector<uint32_t> order(_vertexCount);
+		for (uint32_t vertex = 0; vertex < _vertexCount; ++vertex)
+		{
+			positions[vertex] = LoadPosition(_pPositions, _stride, vertex);
+			order[vertex] = vertex;
+		}
+		auto less = [&positions](uint32_t _a, uint32_t _b)
+		{
+			int compare = memcmp(&positions[_a], &positions[_b], sizeof(XMFLOAT3));
+			return compare < 0 || (compare == 0 && _a < _b);
+		};
+		std::sort(order.begin(), order.end(), less);
+
+		std::vector<uint32_t> ids(_vertexCount);
+		for (uint32_t i = 0; i < _vertexCount; ++i)
+		{
+			bool same = i > 0 && memcmp(&positions[order[i]], &positions[order[i - 1]], sizeof(XMFLOAT3)) == 0;
+			ids[order[i]] = same ? ids[order[i - 1]] : order[i];
+		}
+		return ids;
+	}
+
+	// Ritter's sphere: start from the two extreme points furthest apart along an axis, then grow to take in the rest
+	void BoundingSphere(const std::vector<XMFLOAT3>& _points, Meshlet& _meshlet)
+	{
+		uint32_t minimum[3] = { 0, 0, 0 };
+		uint32_t maximum[3] = { 0, 0, 0 };
+		for (uint32_t i = 0; i < _points.size(); ++i)
+		{
+			const float* p = &_points[i].x;
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				if (p[axis] < (&_points[minimum[axis]].x)[axis])
+					minimum[axis] = i;
+				if (p[axis] > (&_points[maximum[axis]].x)[axis])
+					maximum[axis] = i;
+			}
+		}
+
+		XMVECTOR a = XMVectorZero();
+		XMVECTOR b = XMVectorZero();
+		float spanSq = -1.0f;
+		for (uint32_t axis = 0; axis < 3; ++axis)
+		{
+			XMVECTOR p0 = XMLoadFloat3(&_points[minimum[axis]]);
+			XMVECTOR p1 = XMLoadFloat3(&_points[maximum[axis]]);
+			float distanceSq = XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(p1, p0)));
+			if (distanceSq > spanSq)
+			{
+				spanSq = distanceSq;
+				a = p0;
+				b = p1;
+			}
+		}
+
+		XMVECTOR center = XMVectorScale(XMVectorAdd(a, b), 0.5f);
+		float radius = std::sqrt(spanSq) * 0.5f;
+		for (const XMFLOAT3& point : _points)
+		{
+			XMVECTOR p = XMLoadFloat3(&point);
+			float distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(p, center)));
+			if (distance > radius)
+			{
+				// move the centre towards the point just far enough for the sphere to reach it
+				float grownRadius = (radius + distance) * 0.5f;
+				center = XMVectorAdd(center, XMVectorScale(XMVectorSubtract(p, center), (grownRadius - radius) / distance));
+				radius = grownRadius;
+			}
+		}
+		XMStoreFloat3(&_meshlet.center, center);
+		_meshlet.radius = radius;
+	}
+
+	// the cone around every triangle's normal, with its apex moved back far enough that a view ray through the apex
+	// sees the back of every triangle whenever it is inside the cone
+	void NormalCone(const std::vector<XMFLOAT3>& _points, const uint32_t* _pTriangles, uint32_t _triangleCount, Meshlet& _meshlet)
+	{
+		std::vector<XMFLOAT3> normals;
+		normals.reserve(_triangleCount);
+		XMVECTOR sum = XMVectorZero();
+		for (uint32_t triangle = 0; triangle < _triangleCount; ++triangle)
+		{
+			XMVECTOR a = XMLoadFloat3(&_points[_pTriangles[triangle * 3 + 0]]);
+			XMVECTOR b = XMLoadFloat3(&_points[_pTriangles[triangle * 3 + 1]]);
+			XMVECTOR c = XMLoadFloat3(&_points[_pTriangles[triangle * 3 + 2]]);
+			XMVECTOR cross = XMVector3Cross(XMVectorSubtract(b, a), XMVectorSubtract(c, a));
+			if (XMVectorGetX(XMVector3LengthSq(cross)) <= 0.0f)
+			{
+				normals.push_back(XMFLOAT3(0.0f, 0.0f, 0.0f));
+				continue;
+			}
+			XMVECTOR normal = XMVector3Normalize(cross);
+			XMFLOAT3 stored;
+			XMStoreFloat3(&stored, normal);
+			normals.push_back(stored);
+			sum = XMVectorAdd(sum, normal);
+		}
+
+		_meshlet.coneAxis = XMFLOAT3(0.0f, 0.0f, 0.0f);
+		_meshlet.coneCutoff = NO_CONE_CUTOFF;
+		_meshlet.coneApex = _meshlet.center;
+		if (XMVectorGetX(XMVector3LengthSq(sum)) <= 0.0f)
+			return;
+		XMVECTOR axis = XMVector3Normalize(sum);
+
+		float minimumDot = 1.0f;
+		for (const XMFLOAT3& normal : normals)
+		{
+			if (normal.x != 0.0f || normal.y != 0.0f || normal.z != 0.0f)
+				minimumDot = std::min(minimumDot, XMVectorGetX(XMVector3Dot(XMLoadFloat3(&normal), axis)));
+		}
+		if (minimumDot <= MIN_CONE_DOT)
+			return;
+
+		// how far back along the axis from the centre the apex has to go to be behind every triangle's plane
+		XMVECTOR center = XMLoadFloat3(&_meshlet.center);
+		float maxT = 0.0f;
+		for (uint32_t triangle = 0; triangle < _triangleCount; ++triangle)
+		{
+			XMVECTOR normal = XMLoadFloat3(&normals[triangle]);
+			float facing = XMVectorGetX(XMVector3Dot(normal, axis));
+			if (facing <= 0.0f)
+				continue;
+			XMVECTOR corner = XMLoadFloat3(&_points[_pTriangles[triangle * 3]]);
+			float t = XMVectorGetX(XMVector3Dot(XMVectorSubtract(center, corner), normal)) / facing;
+			maxT = std::max(maxT, t);
+		}
+
+		XMStoreFloat3(&_meshlet.coneAxis, axis);
+		XMStoreFloat3(&_meshlet.coneApex, XMVectorSubtract(center, XMVectorScale(axis, maxT)));
+		_meshlet.coneCutoff = std::sqrt(1.0f - minimumDot * minimumDot);
+	}
+}
+
+void MeshletBuilder::Build(const uint32_t* _pIndices, uint32_t _indexCount, const float* _pPositions, uint32_t _stride, uint32_t _vertexCount,
+	MeshletData& _data, uint32_t _maxVertices, uint32_t _maxTriangles)
+{
+	_data.meshlets.clear();
+	_data.vertices.clear();
+	_data.triangles.clear();
+	_data.indices.clear();
+	uint32_t triangleCount = _indexCount / 3;
+	if (triangleCount == 0)
+		return;
+	_maxVertices = std::max(std::min(_maxVertices, 256u), 3u); // local indices are bytes
+	_maxTriangles = std::max(_maxTriangles, 1u);
+	_data.indices.reserve(triangleCount * 3);
+	_data.triangles.reserve(triangleCount * 3);
+
+	// the triangles around every position
+	std::vector<uint32_t> positionIds = PositionIds(_pPositions, _stride, _vertexCount);
+	std::vector<uint32_t> offsets(_vertexCount + 1, 0);
+	for (uint32_t i = 0; i < triangleCount * 3; ++i)
+		offsets[positionIds[_pIndices[i]] + 1]++;
+	for (uint32_t vertex = 0; vertex < _vertexCount; ++vertex)
+		offsets[vertex + 1] += offsets[vertex];
+	std::vector<uint32_t> adjacency(triangleCount * 3);
+	{
+		std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+		for (uint32_t i = 0; i < triangleCount * 3; ++i)
+			adjacency[cursor[positionIds[_pIndices[i]]]++] = i / 3;
+	}
+
+	std::vector<XMFLOAT3> centroids(triangleCount);
+	for (uint32_t triangle = 0; triangle < triangleCount; ++triangle)
+	{
+		XMVECTOR sum = XMVectorZero();
+		for (uint32_t corner = 0; corner < 3; ++corner)
+		{
+			XMFLOAT3 position = LoadPosition(_pPositions, _stride, _pIndices[triangle * 3 + corner]);
+			sum = XMVectorAdd(sum, XMLoadFloat3(&position));
+		}
+		XMStoreFloat3(&centroids[triangle], XMVectorScale(sum, 1.0f / 3.0f));
+	}
+
+	std::vector<bool> used(triangleCount, false);
+	std::vector<uint32_t> candidateOf(triangleCount, NO_INDEX); // the meshlet a triangle was last made a candidate for
+	std::vector<uint32_t> localIndex(_vertexCount, NO_INDEX);
+	std::vector<uint32_t> meshletVertices;
+	std::vector<uint32_t> meshletTriangles;
+	std::vector<uint32_t> candidates;
+	XMVECTOR centroidSum = XMVectorZero();
+	uint32_t seedCursor = 0;
+
+	auto newVertexCount = [&](uint32_t _triangle)
+	{
+		const uint32_t* pCorners = _pIndices + _triangle * 3;
+		uint32_t count = 0;
+		for (uint32_t corner = 0; corner < 3; ++corner)
+		{
+			bool repeated = (corner > 0 && pCorners[corner] == pCorners[0]) || (corner > 1 && pCorners[corner] == pCorners[1]);
+			if (localIndex[pCorners[corner]] == NO_INDEX && !repeated)
+				count++;
+		}
+		return count;
+	};
+
+	auto addTriangle = [&](uint32_t _triangle)
+	{
+		used[_triangle] = true;
+		meshletTriangles.push_back(_triangle);
+		centroidSum = XMVectorAdd(centroidSum, XMLoadFloat3(&centroids[_triangle]));
+		uint32_t meshletIndex = static_cast<uint32_t>(_data.meshlets.size());
+		for (uint32_t corner = 0; corner < 3; ++corner)
+		{
+			uint32_t vertex = _pIndices[_triangle * 3 + corner];
+			if (localIndex[vertex] == NO_INDEX)
+			{
+				localIndex[vertex] = static_cast<uint32_t>(meshletVertices.size());
+				meshletVertices.push_back(vertex);
+			}
+			uint32_t position = positionIds[vertex];
+			for (uint32_t i = offsets[position]; i < offsets[position + 1]; ++i)
+			{
+				uint32_t neighbour = adjacency[i];
+				if (!used[neighbour] && candidateOf[neighbour] != meshletIndex)
+				{
+					candidateOf[neighbour] = meshletIndex;
+					candidates.push_back(neighbour);
+				}
+			}
+		}
+	};
+
+	auto finishMeshlet = [&]()
+	{
+		if (meshletTriangles.empty())
+			return;
+
+		// the meshlet's own triangles in cache order, in meshlet vertices
+		uint32_t meshletTriangleCount = static_cast<uint32_t>(meshletTriangles.size());
+		std::vector<uint32_t> local(meshletTriangleCount * 3);
+		for (uint32_t triangle = 0; triangle < meshletTriangleCount; ++triangle)
+		{
+			for (uint32_t corner = 0; corner < 3; ++corner)
+				local[triangle * 3 + corner] = localIndex[_pIndices[meshletTriangles[triangle] * 3 + corner]];
+		}
+		MeshOptimizer::OptimizeVertexCache(local.data(), meshletTriangleCount * 3, static_cast<uint32_t>(meshletVertices.size()));
+
+		Meshlet meshlet = {};
+		meshlet.firstIndex = static_cast<uint32_t>(_data.indices.size());
+		meshlet.triangleCount = meshletTriangleCount;
+		meshlet.vertexOffset = static_cast<uint32_t>(_data.vertices.size());
+		meshlet.vertexCount = static_cast<uint32_t>(meshletVertices.size());
+		meshlet.triangleOffset = static_cast<uint32_t>(_data.triangles.size() / 3);
+		for (uint32_t index : local)
+		{
+			_data.indices.push_back(meshletVertices[index]);
+			_data.triangles.push_back(static_cast<uint8_t>(index));
+		}
+		_data.vertices.insert(_data.vertices.end(), meshletVertices.begin(), meshletVertices.end());
+
+		std::vector<XMFLOAT3> points(meshletVertices.size());
+		for (size_t i = 0; i < meshletVertices.size(); ++i)
+			points[i] = LoadPosition(_pPositions, _stride, meshletVertices[i]);
+		BoundingSphere(points, meshlet);
+		NormalCone(points, local.data(), meshletTriangleCount, meshlet);
+		_data.meshlets.push_back(meshlet);
+
+		for (uint32_t vertex : meshletVertices)
+			localIndex[vertex] = NO_INDEX;
+		meshletVertices.clear();
+		meshletTriangles.clear();
+		candidates.clear();
+		centroidSum = XMVectorZero();
+	};
+
+	for (uint32_t added = 0; added < triangleCount; ++added)
+	{
+		// the neighbour that brings the fewest new vertices, then the one nearest the meshlet's centre
+		uint32_t best = NO_INDEX;
+		uint32_t bestNew = 4;
+		float bestDistanceSq = std::numeric_limits<float>::max();
+		XMVECTOR center = meshletTriangles.empty() ? XMVectorZero() : XMVectorScale(centroidSum, 1.0f / static_cast<float>(meshletTriangles.size()));
+		for (size_t i = 0; i < candidates.size();)
+		{
+			uint32_t candidate = candidates[i];
+			if (used[candidate])
+			{
+				candidates[i] = candidates.back();
+				candidates.pop_back();
+				continue;
+			}
+			++i;
+
+			uint32_t newVertices = newVertexCount(candidate);
+			if (meshletVertices.size() + newVertices > _maxVertices || newVertices > bestNew)
+				continue;
+			float distanceSq = XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(XMLoadFloat3(&centroids[candidate]), center)));
+			if (newVertices < bestNew || distanceSq < bestDistanceSq || (distanceSq == bestDistanceSq && candidate < best))
+			{
+				best = candidate;
+				bestNew = newVertices;
+				bestDistanceSq = distanceSq;
+			}
+		}
+
+		// nothing next to the meshlet fits, so go on with the next triangle in index order
+		if (best == NO_INDEX)
+		{
+			while (used[seedCursor])
+				seedCursor++;
+			if (meshletVertices.size() + newVertexCount(seedCursor) > _maxVertices)
+				finishMeshlet();
+			best = seedCursor;
+		}
+
+		addTriangle(best);
+		if (meshletTriangles.size() >= _maxTriangles)
+			finishMeshlet();
+	}
+	finishMeshlet();
+}
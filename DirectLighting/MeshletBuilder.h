@@ -0,0 +1,50 @@
+#pragma once
+#include <DirectXMath.h>
+
+#include <cstdint>
+#include <vector>
+
+// a small cluster of a mesh's triangles with its own bounds, so whole clusters can be culled before any of their
+// vertices are shaded. 64 bytes, stored as it is in mesh files
+struct Meshlet
+{
+	DirectX::XMFLOAT3 center; // bounding sphere, object space
+	float radius;
+	DirectX::XMFLOAT3 coneAxis; // the average facing of the triangles
+	float coneCutoff; // every triangle faces away from an eye with dot(normalize(coneApex - eye), coneAxis) >= coneCutoff. over 1 when no eye can see that
+	DirectX::XMFLOAT3 coneApex;
+	uint32_t firstIndex; // the triangles are the mesh's indices firstIndex .. firstIndex + triangleCount * 3
+	uint32_t triangleCount;
+	uint32_t vertexOffset; // into MeshletData::vertices
+	uint32_t vertexCount;
+	uint32_t triangleOffset; // into MeshletData::triangles, in triangles
+};
+
+struct MeshletData
+{
+	std::vector<Meshlet> meshlets;
+	std::vector<uint32_t> vertices; // the mesh vertex behind each meshlet vertex
+	std::vector<uint8_t> triangles; // three meshlet vertices per triangle, for a mesh shader
+	std::vector<uint32_t> indices; // the mesh's triangles again, each meshlet's together and in its own cache order
+};
+
+// splits a mesh into meshlets of at most MAX_VERTICES vertices and MAX_TRIANGLES triangles, the sizes mesh shaders
+// like best (124 triangles leave room for the primitive indices to pack into 128 entries).
+//
+// a meshlet grows from a seed triangle by adding whichever triangle next to it brings the fewest new vertices, the
+// nearest to the meshlet's centre first, so meshlets come out round and their bounds tight. triangles count as
+// next to each other when they share a position, not just a vertex, so uv and normal seams do not split meshlets.
+// when nothing next to it fits, the next unused triangle in index order seeds or continues it; the indices are
+// expected to be in cache order already, which keeps those neighbours close too.
+//
+// each meshlet gets a bounding sphere (Ritter's) and a normal cone whose apex makes the backface test exact for
+// any eye position outside the cone (the same cone as meshoptimizer's meshopt_computeMeshletBounds)
+namespace MeshletBuilder
+{
+	const uint32_t MAX_VERTICES = 64;
+	const uint32_t MAX_TRIANGLES = 124;
+
+	// positions are three floats read _stride bytes apart
+	void Build(const uint32_t* _pIndices, uint32_t _indexCount, const float* _pPositions, uint32_t _stride, uint32_t _vertexCount,
+		MeshletData& _data, uint32_t _maxVertices = MAX_VERTICES, uint32_t _maxTriangles = MAX_TRIANGLES);
+}
@@ -0,0 +1,182 @@
+#include "MeshletCulling.h"
+
+#include <algorithm>
+
+#include "DepthPyramid.h"
+#include "JobSystem.h"
+#include "MeshletBuilder.h"
+
+using namespace DirectX;
+
+namespace
+{
+	// a block of meshlets is a job, culling one is cheap so blocks are large
+	const uint32_t QUADS_PER_BLOCK = 256;
+}
+
+void MeshletCuller::Init(const Meshlet* _pMeshlets, uint32_t _count)
+{
+	m_pMeshlets = _pMeshlets;
+	m_count = _count;
+	uint32_t quadCount = (_count + 3) / 4;
+	m_quads.resize(quadCount);
+
+	// padding lanes get a negative radius, which no frustum test passes
+	Meshlet padding = {};
+	padding.radius = -1.0f;
+	padding.coneCutoff = 2.0f;
+	for (uint32_t quad = 0; quad < quadCount; ++quad)
+	{
+		const Meshlet* m[4];
+		for (uint32_t lane = 0; lane < 4; ++lane)
+		{
+			uint32_t i = quad * 4 + lane;
+			m[lane] = i < _count ? &_pMeshlets[i] : &padding;
+		}
+		MeshletQuad& meshlets = m_quads[quad];
+		meshlets.centerX = XMVectorSet(m[0]->center.x, m[1]->center.x, m[2]->center.x, m[3]->center.x);
+		meshlets.centerY = XMVectorSet(m[0]->center.y, m[1]->center.y, m[2]->center.y, m[3]->center.y);
+		meshlets.centerZ = XMVectorSet(m[0]->center.z, m[1]->center.z, m[2]->center.z, m[3]->center.z);
+		meshlets.radius = XMVectorSet(m[0]->radius, m[1]->radius, m[2]->radius, m[3]->radius);
+		meshlets.axisX = XMVectorSet(m[0]->coneAxis.x, m[1]->coneAxis.x, m[2]->coneAxis.x, m[3]->coneAxis.x);
+		meshlets.axisY = XMVectorSet(m[0]->coneAxis.y, m[1]->coneAxis.y, m[2]->coneAxis.y, m[3]->coneAxis.y);
+		meshlets.axisZ = XMVectorSet(m[0]->coneAxis.z, m[1]->coneAxis.z, m[2]->coneAxis.z, m[3]->coneAxis.z);
+		meshlets.cutoff = XMVectorSet(m[0]->coneCutoff, m[1]->coneCutoff, m[2]->coneCutoff, m[3]->coneCutoff);
+		meshlets.apexX = XMVectorSet(m[0]->coneApex.x, m[1]->coneApex.x, m[2]->coneApex.x, m[3]->coneApex.x);
+		meshlets.apexY = XMVectorSet(m[0]->coneApex.y, m[1]->coneApex.y, m[2]->coneApex.y, m[3]->coneApex.y);
+		meshlets.apexZ = XMVectorSet(m[0]->coneApex.z, m[1]->coneApex.z, m[2]->coneApex.z, m[3]->coneApex.z);
+	}
+}
+
+uint32_t MeshletCuller::Cull(const MeshletCullParams& _params, JobSystem* _pJobSystem)
+{
+	m_visible.clear();
+	m_stats = MeshletCullStats();
+	uint32_t quadCount = static_cast<uint32_t>(m_quads.size());
+	if (quadCount == 0)
+		return 0;
+
+	// a world plane p tests x_world . p = (x_object * world) . p, so in the mesh's space the plane is world * p, which
+	// for row vectors is p * transpose(world). normalising it keeps the radius in the mesh's units
+	XMMATRIX world = XMLoadFloat4x4(&_params.world);
+	XMMATRIX worldTransposed = XMMatrixTranspose(world);
+	XMVECTOR planeX[Frustum::PLANE_COUNT];
+	XMVECTOR planeY[Frustum::PLANE_COUNT];
+	XMVECTOR planeZ[Frustum::PLANE_COUNT];
+	XMVECTOR planeW[Frustum::PLANE_COUNT];
+	for (uint32_t plane = 0; plane < Frustum::PLANE_COUNT; ++plane)
+	{
+		XMVECTOR objectPlane = XMVector4Transform(XMLoadFloat4(&_params.frustum.planes[plane]), worldTransposed);
+		float length = XMVectorGetX(XMVector3Length(objectPlane));
+		objectPlane = length > 0.0f ? XMVectorScale(objectPlane, 1.0f / length) : objectPlane;
+		planeX[plane] = XMVectorSplatX(objectPlane);
+		planeY[plane] = XMVectorSplatY(objectPlane);
+		planeZ[plane] = XMVectorSplatZ(objectPlane);
+		planeW[plane] = XMVectorSplatW(objectPlane);
+	}
+
+	// a mirroring world matrix turns the winding around, so the cones would pick the wrong side
+	XMVECTOR determinant;
+	XMMATRIX inverseWorld = XMMatrixInverse(&determinant, world);
+	bool cullBackfaces = _params.cullBackfaces && XMVectorGetX(determinant) > 0.0f;
+	XMVECTOR eye = XMVector3TransformCoord(XMLoadFloat3(&_params.cameraPosition), inverseWorld);
+	XMVECTOR eyeX = XMVectorSplatX(eye);
+	XMVECTOR eyeY = XMVectorSplatY(eye);
+	XMVECTOR eyeZ = XMVectorSplatZ(eye);
+
+	// the occlusion test is in world space: centres move with the world matrix, radii grow with its longest axis
+	float maxScale = 0.0f;
+	for (uint32_t row = 0; row < 3; ++row)
+		maxScale = std::max(maxScale, XMVectorGetX(XMVector3Length(world.r[row])));
+
+	uint32_t blockCount = (quadCount + QUADS_PER_BLOCK - 1) / QUADS_PER_BLOCK;
+	m_blockVisible.resize(blockCount);
+	m_blockStats.assign(blockCount, MeshletCullStats());
+	auto cull = [&](unsigned int _begin, unsigned int _end)
+	{
+		for (unsigned int block = _begin; block < _end; ++block)
+		{
+			std::vector<uint32_t>& out = m_blockVisible[block];
+			MeshletCullStats& stats = m_blockStats[block];
+			out.clear();
+
+			uint32_t firstQuad = block * QUADS_PER_BLOCK;
+			uint32_t lastQuad = std::min(firstQuad + QUADS_PER_BLOCK, quadCount);
+			for (uint32_t quad = firstQuad; quad < lastQuad; ++quad)
+			{
+				const MeshletQuad& meshlets = m_quads[quad];
+
+				// the sphere is inside while it is not entirely behind any plane
+				XMVECTOR negativeRadius = XMVectorNegate(meshlets.radius);
+				XMVECTOR inside = XMVectorGreaterOrEqual(meshlets.radius, XMVectorZero());
+				for (uint32_t plane = 0; plane < Frustum::PLANE_COUNT; ++plane)
+				{
+					XMVECTOR distance = XMVectorMultiplyAdd(meshlets.centerX, planeX[plane], XMVectorMultiplyAdd(meshlets.centerY, planeY[plane],
+						XMVectorMultiplyAdd(meshlets.centerZ, planeZ[plane], planeW[plane])));
+					inside = XMVectorAndInt(inside, XMVectorGreaterOrEqual(distance, negativeRadius));
+				}
+
+				// backfacing when the apex is seen from inside the cone: dot(apex - eye, axis) >= cutoff * |apex - eye|
+				XMVECTOR backfacing = XMVectorFalseInt();
+				if (cullBackfaces)
+				{
+					XMVECTOR x = XMVectorSubtract(meshlets.apexX, eyeX);
+					XMVECTOR y = XMVectorSubtract(meshlets.apexY, eyeY);
+					XMVECTOR z = XMVectorSubtract(meshlets.apexZ, eyeZ);
+					XMVECTOR length = XMVectorSqrt(XMVectorMultiplyAdd(x, x, XMVectorMultiplyAdd(y, y, XMVectorMultiply(z, z))));
+					XMVECTOR facing = XMVectorMultiplyAdd(x, meshlets.axisX, XMVectorMultiplyAdd(y, meshlets.axisY, XMVectorMultiply(z, meshlets.axisZ)));
+					backfacing = XMVectorGreaterOrEqual(facing, XMVectorMultiply(meshlets.cutoff, length));
+				}
+
+				uint32_t insideMask[4];
+				uint32_t backfacingMask[4];
+				XMStoreInt4(insideMask, inside);
+				XMStoreInt4(backfacingMask, backfacing);
+				for (uint32_t lane = 0; lane < 4; ++lane)
+				{
+					uint32_t i = quad * 4 + lane;
+					if (i >= m_count)
+						break;
+					stats.tested++;
+					if (!insideMask[lane])
+					{
+						stats.frustumCulled++;
+						continue;
+					}
+					if (backfacingMask[lane])
+					{
+						stats.backfaceCulled++;
+						continue;
+					}
+					if (_params.pOcclusion)
+					{
+						const Meshlet& meshlet = m_pMeshlets[i];
+						XMFLOAT4 sphere;
+						XMStoreFloat4(&sphere, XMVector3TransformCoord(XMLoadFloat3(&meshlet.center), world));
+						sphere.w = meshlet.radius * maxScale;
+						if (_params.pOcclusion->SphereOccluded(sphere, _params.occlusionViewProj))
+						{
+							stats.occlusionCulled++;
+							continue;
+						}
+					}
+					out.push_back(i);
+				}
+			}
+		}
+	};
+	if (_pJobSystem && blockCount > 1)
+		_pJobSystem->ParallelFor(blockCount, 1, cull);
+	else
+		cull(0, blockCount);
+
+	for (uint32_t block = 0; block < blockCount; ++block)
+	{
+		m_visible.insert(m_visible.end(), m_blockVisible[block].begin(), m_blockVisible[block].end());
+		m_stats.tested += m_blockStats[block].tested;
+		m_stats.frustumCulled += m_blockStats[block].frustumCulled;
+		m_stats.backfaceCulled += m_blockStats[block].backfaceCulled;
+		m_stats.occlusionCulled += m_blockStats[block].occlusionCulled;
+	}
+	return static_cast<uint32_t>(m_visible.size());
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <DirectXMath.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "Culling.h"
+
+class DepthPyramid;
+class JobSystem;
+struct Meshlet;
+
+struct MeshletCullParams
+{
+	DirectX::XMFLOAT4X4 world; // of the instance being drawn
+	Frustum frustum; // world space
+	DirectX::XMFLOAT3 cameraPosition; // world space
+	bool cullBackfaces = true;
+	DepthPyramid* pOcclusion = nullptr; // last frame's depth, nullptr to skip the occlusion test
+	DirectX::XMFLOAT4X4 occlusionViewProj; // the matrix pOcclusion was drawn with
+};
+
+// how many meshlets each test threw out, in the order they are tested
+struct MeshletCullStats
+{
+	uint32_t tested = 0;
+	uint32_t frustumCulled = 0;
+	uint32_t backfaceCulled = 0;
+	uint32_t occlusionCulled = 0;
+};
+
+// culls the meshlets of one mesh for each instance drawn with it.
+//
+// Init packs the meshlets four to a MeshletQuad, one component per XMVECTOR, so the frustum and cone tests run on
+// four meshlets at a time. the tests are done in the mesh's own space instead of moving every meshlet into the world:
+// the planes and the eye are moved by the inverse of the instance's world matrix once per Cull, and as both tests
+// are affine invariant that is exact even for non uniform scale. meshlets that pass both are then checked one by
+// one against the depth pyramid, if there is one.
+//
+// the meshlets are shared out in blocks on the job system and the survivors come back in meshlet order, ready to be
+// turned into indirect draws
+class MeshletCuller
+{
+public:
+	MeshletCuller() = default;
+	~MeshletCuller() = default;
+
+	void Init(const Meshlet* _pMeshlets, uint32_t _count);
+
+	// returns how many meshlets are visible, see Visible
+	uint32_t Cull(const MeshletCullParams& _params, JobSystem* _pJobSystem = nullptr);
+
+	const std::vector<uint32_t>& Visible() { return m_visible; } // indices of the meshlets the last Cull kept
+	const MeshletCullStats& Stats() { return m_stats; }
+
+private:
+	struct MeshletQuad
+	{
+		DirectX::XMVECTOR centerX;
+		DirectX::XMVECTOR centerY;
+		DirectX::XMVECTOR centerZ;
+		DirectX::XMVECTOR radius; // negative for the padding after the last meshlet
+		DirectX::XMVECTOR axisX;
+		DirectX::XMVECTOR axisY;
+		DirectX::XMVECTOR axisZ;
+		DirectX::XMVECTOR cutoff;
+		DirectX::XMVECTOR apexX;
+		DirectX::XMVECTOR apexY;
+		DirectX::XMVECTOR apexZ;
+	};
+
+	const Meshlet* m_pMeshlets = nullptr;
+	uint32_t m_count = 0;
+	std::vector<MeshletQuad> m_quads;
+	std::vector<std::vector<uint32_t>> m_blockVisible;
+	std::vector<MeshletCullStats> m_blockStats;
+	std::vector<uint32_t> m_visible;
+	MeshletCullStats m_stats;
+};
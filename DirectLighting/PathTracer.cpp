@@ -0,0 +1,312 @@
+#include "PathTracer.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+#include "JobSystem.h"
+
+using namespace DirectX;
+
+namespace
+{
+	const uint32_t MIN_ROULETTE_BOUNCE = 2; // paths are never cut before this many bounces
+
+	// splitmix64, to turn a pixel and pass number into a well spread seed
+	uint64_t MixSeed(uint64_t _value)
+	{
+		_value += 0x9e3779b97f4a7c15ull;
+		_value = (_value ^ (_value >> 30)) * 0xbf58476d1ce4e5b9ull;
+		_value = (_value ^ (_value >> 27)) * 0x94d049bb133111ebull;
+		return _value ^ (_value >> 31);
+	}
+
+	XMFLOAT3 Add(const XMFLOAT3& _a, const XMFLOAT3& _b) { return XMFLOAT3(_a.x + _b.x, _a.y + _b.y, _a.z + _b.z); }
+	XMFLOAT3 Multiply(const XMFLOAT3& _a, const XMFLOAT3& _b) { return XMFLOAT3(_a.x * _b.x, _a.y * _b.y, _a.z * _b.z); }
+	XMFLOAT3 Scale(const XMFLOAT3& _a, float _s) { return XMFLOAT3(_a.x * _s, _a.y * _s, _a.z * _s); }
+	float Dot(const XMFLOAT3& _a, const XMFLOAT3& _b) { return _a.x * _b.x + _a.y * _b.y + _a.z * _b.z; }
+}
+
+PathRandom::PathRandom(uint64_t _seed)
+{
+	m_state = MixSeed(_seed);
+	Next();
+}
+
+float PathRandom::Next()
+{
+	uint64_t state = m_state;
+	m_state = state * 6364136223846793005ull + 1442695040888963407ull;
+	uint32_t xorShifted = static_cast<uint32_t>(((state >> 18) ^ state) >> 27);
+	uint32_t rotation = static_cast<uint32_t>(state >> 59);
+	uint32_t bits = (xorShifted >> rotation) | (xorShifted << ((32 - rotation) & 31));
+
+	// the top 24 bits fill a float's mantissa exactly, so the result never rounds up to 1
+	return static_cast<float>(bits >> 8) * (1.0f / 16777216.0f);
+}
+
+void PathTracer::Init(const PathTracerDesc& _desc)
+{
+	m_desc = _desc;
+	m_desc.tileSize = std::max(m_desc.tileSize, 1u);
+	m_tilesX = (m_desc.width + m_desc.tileSize - 1) / m_desc.tileSize;
+	m_tilesY = (m_desc.height + m_desc.tileSize - 1) / m_desc.tileSize;
+	m_accumulation.assign(m_desc.width * m_desc.height, XMFLOAT3(0.0f, 0.0f, 0.0f));
+	m_passCount = 0;
+	XMStoreFloat4x4(&m_inverseViewProj, XMMatrixIdentity());
+	m_cameraPosition = XMFLOAT3(0.0f, 0.0f, 0.0f);
+}
+
+void PathTracer::ClearScene()
+{
+	m_positions.clear();
+	m_albedos.clear();
+	m_indices.clear();
+	m_normals.clear();
+	m_lights.clear();
+	m_sunColor = XMFLOAT3(0.0f, 0.0f, 0.0f);
+}
+
+void PathTracer::AddMesh(const void* _pVertices, uint32_t _vertexCount, uint32_t _stride, uint32_t _positionOffset, uint32_t _colorOffset,
+	const uint32_t* _indices, uint32_t _indexCount, const XMFLOAT4X4& _world)
+{
+	uint32_t firstVertex = static_cast<uint32_t>(m_positions.size());
+	XMMATRIX world = XMLoadFloat4x4(&_world);
+	const unsigned char* pBytes = static_cast<const unsigned char*>(_pVertices);
+	for (uint32_t i = 0; i < _vertexCount; ++i)
+	{
+		XMFLOAT3 position;
+		XMFLOAT4 color;
+		std::memcpy(&position, pBytes + i * _stride + _positionOffset, sizeof(position));
+		std::memcpy(&color, pBytes + i * _stride + _colorOffset, sizeof(color));
+
+		XMFLOAT3 worldPosition;
+		XMStoreFloat3(&worldPosition, XMVector3TransformCoord(XMLoadFloat3(&position), world));
+		m_positions.push_back(worldPosition);
+		m_albedos.push_back(XMFLOAT3(color.x, color.y, color.z));
+	}
+	for (uint32_t i = 0; i < _indexCount; ++i)
+		m_indices.push_back(firstVertex + _indices[i]);
+}
+
+void PathTracer::SetLights(const Light* _lights, uint32_t _count)
+{
+	m_lights.assign(_lights, _lights + _count);
+}
+
+void PathTracer::SetSun(const XMFLOAT3& _direction, const XMFLOAT3& _color)
+{
+	XMStoreFloat3(&m_sunDirection, XMVector3Normalize(XMLoadFloat3(&_direction)));
+	m_sunColor = _color;
+}
+
+void PathTracer::Commit()
+{
+	uint32_t triangleCount = static_cast<uint32_t>(m_indices.size() / 3);
+	m_normals.resize(triangleCount);
+	for (uint32_t i = 0; i < triangleCount; ++i)
+	{
+		XMVECTOR a = XMLoadFloat3(&m_positions[m_indices[i * 3 + 0]]);
+		XMVECTOR b = XMLoadFloat3(&m_positions[m_indices[i * 3 + 1]]);
+		XMVECTOR c = XMLoadFloat3(&m_positions[m_indices[i * 3 + 2]]);
+		XMStoreFloat3(&m_normals[i], XMVector3Normalize(XMVector3Cross(XMVectorSubtract(b, a), XMVectorSubtract(c, a))));
+	}
+	m_bvh.Build(m_positions.data(), m_indices.data(), triangleCount);
+	m_lightTable.Build(m_lights.data(), static_cast<uint32_t>(m_lights.size()));
+
+	std::fill(m_accumulation.begin(), m_accumulation.end(), XMFLOAT3(0.0f, 0.0f, 0.0f));
+	m_passCount = 0;
+}
+
+void PathTracer::SetCamera(const XMFLOAT4X4& _view, const XMFLOAT4X4& _proj)
+{
+	XMMATRIX view = XMLoadFloat4x4(&_view);
+	XMStoreFloat4x4(&m_inverseViewProj, XMMatrixInverse(nullptr, view * XMLoadFloat4x4(&_proj)));
+	XMStoreFloat3(&m_cameraPosition, XMMatrixInverse(nullptr, view).r[3]);
+
+	std::fill(m_accumulation.begin(), m_accumulation.end(), XMFLOAT3(0.0f, 0.0f, 0.0f));
+	m_passCount = 0;
+}
+
+void PathTracer::Render(uint32_t _passes, JobSystem* _pJobSystem)
+{
+	uint32_t tileCount = m_tilesX * m_tilesY;
+	auto render = [&](unsigned int _begin, unsigned int _end)
+	{
+		for (unsigned int tile = _begin; tile < _end; ++tile)
+			RenderTile(tile);
+	};
+
+	// the tiles are small and take very different times, so they are handed out one at a time
+	for (uint32_t pass = 0; pass < _passes; ++pass)
+	{
+		if (_pJobSystem)
+			_pJobSystem->ParallelFor(tileCount, 1, render);
+		else
+			render(0, tileCount);
+		++m_passCount;
+	}
+}
+
+void PathTracer::RenderTile(uint32_t _tile)
+{
+	uint32_t firstX = (_tile % m_tilesX) * m_desc.tileSize;
+	uint32_t firstY = (_tile / m_tilesX) * m_desc.tileSize;
+	uint32_t lastX = std::min(firstX + m_desc.tileSize, m_desc.width);
+	uint32_t lastY = std::min(firstY + m_desc.tileSize, m_desc.height);
+	XMMATRIX inverseViewProj = XMLoadFloat4x4(&m_inverseViewProj);
+
+	for (uint32_t y = firstY; y < lastY; ++y)
+	{
+		for (uint32_t x = firstX; x < lastX; ++x)
+		{
+			uint32_t pixel = y * m_desc.width + x;
+			PathRandom random((static_cast<uint64_t>(m_passCount) << 32) | pixel);
+
+			// a random point in the pixel, through the far plane
+			float ndcX = (x + random.Next()) / m_desc.width * 2.0f - 1.0f;
+			float ndcY = 1.0f - (y + random.Next()) / m_desc.height * 2.0f;
+			XMVECTOR target = XMVector3TransformCoord(XMVectorSet(ndcX, ndcY, 1.0f, 1.0f), inverseViewProj);
+			XMFLOAT3 direction;
+			XMStoreFloat3(&direction, XMVector3Normalize(XMVectorSubtract(target, XMLoadFloat3(&m_cameraPosition))));
+
+			XMFLOAT3 radiance = Radiance(m_cameraPosition, direction, random);
+			m_accumulation[pixel] = Add(m_accumulation[pixel], radiance);
+		}
+	}
+}
+
+bool PathTracer::Trace(const XMFLOAT3& _origin, const XMFLOAT3& _direction, float _tMax, PathHit& _hit)
+{
+	RayHit rayHit;
+	if (!m_bvh.Intersect(_origin, _direction, _tMax, rayHit))
+		return false;
+
+	uint32_t i0 = m_indices[rayHit.triangle * 3 + 0];
+	uint32_t i1 = m_indices[rayHit.triangle * 3 + 1];
+	uint32_t i2 = m_indices[rayHit.triangle * 3 + 2];
+	float w = 1.0f - rayHit.u - rayHit.v;
+	_hit.distance = rayHit.t;
+	_hit.position = Add(_origin, Scale(_direction, rayHit.t));
+	_hit.albedo = Add(Add(Scale(m_albedos[i0], w), Scale(m_albedos[i1], rayHit.u)), Scale(m_albedos[i2], rayHit.v));
+	_hit.normal = m_normals[rayHit.triangle];
+	if (Dot(_hit.normal, _direction) > 0.0f)
+		_hit.normal = Scale(_hit.normal, -1.0f);
+	return true;
+}
+
+XMFLOAT3 PathTracer::Radiance(const XMFLOAT3& _origin, const XMFLOAT3& _direction, PathRandom& _random)
+{
+	XMFLOAT3 radiance(0.0f, 0.0f, 0.0f);
+	XMFLOAT3 throughput(1.0f, 1.0f, 1.0f);
+	XMFLOAT3 origin = _origin;
+	XMFLOAT3 direction = _direction;
+	for (uint32_t bounce = 0; ; ++bounce)
+	{
+		PathHit hit;
+		if (!Trace(origin, direction, FLT_MAX, hit))
+		{
+			radiance = Add(radiance, Multiply(throughput, m_desc.background));
+			break;
+		}
+
+		// lambertian, so the light reflected towards the ray is albedo / pi times the irradiance
+		XMFLOAT3 irradiance = DirectIrradiance(hit.position, hit.normal, _random);
+		radiance = Add(radiance, Multiply(throughput, Scale(Multiply(hit.albedo, irradiance), 1.0f / XM_PI)));
+		if (bounce >= m_desc.maxBounces)
+			break;
+
+		// sampling in proportion to the cosine cancels it and the pi out of the brdf, which leaves the albedo
+		throughput = Multiply(throughput, hit.albedo);
+		if (bounce >= MIN_ROULETTE_BOUNCE)
+		{
+			float survival = std::min(std::max(throughput.x, std::max(throughput.y, throughput.z)), 1.0f);
+			if (_random.Next() >= survival)
+				break;
+			throughput = Scale(throughput, 1.0f / survival);
+		}
+
+		origin = OffsetRayOrigin(hit.position, hit.normal);
+		direction = CosineDirection(hit.normal, _random.Next(), _random.Next());
+	}
+	return radiance;
+}
+
+XMFLOAT3 PathTracer::DirectIrradiance(const XMFLOAT3& _position, const XMFLOAT3& _normal, PathRandom& _random)
+{
+	XMFLOAT3 irradiance(0.0f, 0.0f, 0.0f);
+	XMFLOAT3 origin = OffsetRayOrigin(_position, _normal);
+
+	// the random numbers are drawn whether or not they are used, so every path uses the same number of them
+	float u0 = _random.Next();
+	float u1 = _random.Next();
+	LightAliasSample sample;
+	if (!m_lights.empty() && m_lightTable.Sample(u0, u1, sample))
+	{
+		const Light& light = m_lights[sample.light];
+		XMFLOAT3 toLight;
+		float distance;
+		float attenuation = LightAttenuation(light, _position, toLight, distance);
+		float cosine = Dot(_normal, toLight);
+		if (attenuation > 0.0f && cosine > 0.0f && !m_bvh.Occluded(origin, toLight, distance))
+			irradiance = Add(irradiance, Scale(light.color, attenuation * cosine / sample.pmf));
+	}
+
+	XMFLOAT3 toSun = Scale(m_sunDirection, -1.0f);
+	float cosine = Dot(_normal, toSun);
+	if (cosine > 0.0f && (m_sunColor.x > 0.0f || m_sunColor.y > 0.0f || m_sunColor.z > 0.0f) && !m_bvh.Occluded(origin, toSun, FLT_MAX))
+		irradiance = Add(irradiance, Scale(m_sunColor, cosine));
+	return irradiance;
+}
+
+XMFLOAT3 PathTracer::CosineDirection(const XMFLOAT3& _normal, float _u0, float _u1)
+{
+	// a uniform point on the disc, lifted up onto the hemisphere
+	float radius = std::sqrt(_u0);
+	float angle = 2.0f * XM_PI * _u1;
+	float x = radius * std::cos(angle);
+	float y = radius * std::sin(angle);
+	float z = std::sqrt(std::max(0.0f, 1.0f - _u0));
+
+	// an orthonormal basis around the normal without any branches on its direction (duff et al. 2017)
+	float sign = std::copysign(1.0f, _normal.z);
+	float a = -1.0f / (sign + _normal.z);
+	float b = _normal.x * _normal.y * a;
+	XMFLOAT3 tangent(1.0f + sign * _normal.x * _normal.x * a, sign * b, -sign * _normal.x);
+	XMFLOAT3 bitangent(b, sign + _normal.y * _normal.y * a, -_normal.y);
+	return Add(Add(Scale(tangent, x), Scale(bitangent, y)), Scale(_normal, z));
+}
+
+XMFLOAT3 PathTracer::OffsetRayOrigin(const XMFLOAT3& _position, const XMFLOAT3& _normal)
+{
+	// float precision falls off with distance from the origin, so the offset grows with it
+	float scale = std::max(std::fabs(_position.x), std::max(std::fabs(_position.y), std::fabs(_position.z)));
+	return Add(_position, Scale(_normal, 1e-4f * (1.0f + scale)));
+}
+
+XMFLOAT3 PathTracer::Pixel(uint32_t _x, uint32_t _y)
+{
+	if (m_passCount == 0)
+		return XMFLOAT3(0.0f, 0.0f, 0.0f);
+	return Scale(m_accumulation[_y * m_desc.width + _x], 1.0f / m_passCount);
+}
+
+bool PathTracer::SavePfm(const std::string& _fileName)
+{
+	std::ofstream file(_fileName, std::ios::binary);
+	if (!file)
+		return false;
+
+	// a negative scale means little endian. the rows go from the bottom up
+	file << "PF\n" << m_desc.width << " " << m_desc.height << "\n-1.0\n";
+	std::vector<XMFLOAT3> row(m_desc.width);
+	for (uint32_t y = m_desc.height; y-- > 0; )
+	{
+		for (uint32_t x = 0; x < m_desc.width; ++x)
+			row[x] = Pixel(x, y);
+		file.write(reinterpret_cast<const char*>(row.data()), row.size() * sizeof(XMFLOAT3));
+	}
+	return static_cast<bool>(file);
+}
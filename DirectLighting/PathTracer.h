@@ -0,0 +1,136 @@
+#pragma once
+#include <DirectXMath.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "LightAliasTable.h"
+#include "LightClusters.h"
+#include "TriangleBvh.h"
+
+class JobSystem;
+
+struct PathTracerDesc
+{
+	uint32_t width = 1280;
+	uint32_t height = 720;
+	uint32_t tileSize = 16; // pixels along the side of one job
+	uint32_t maxBounces = 4; // 0 only gives the direct light, which is what the real time lighting computes
+	DirectX::XMFLOAT3 background = DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f); // radiance of rays that leave the scene
+};
+
+// pcg32. every pixel gets a stream of its own for every pass, so the image does not depend on which thread drew what
+class PathRandom
+{
+public:
+	explicit PathRandom(uint64_t _seed);
+
+	float Next(); // [0, 1)
+
+private:
+	uint64_t m_state;
+};
+
+// what a ray hit, with the surface filled in
+struct PathHit
+{
+	DirectX::XMFLOAT3 position;
+	DirectX::XMFLOAT3 normal; // the triangle's, facing back along the ray
+	DirectX::XMFLOAT3 albedo;
+	float distance;
+};
+
+// a reference renderer for the real time lighting. it takes the same meshes, world matrices, lights and sun as the
+// scene and path traces them on the cpu, with no d3d in sight, so it also runs headless.
+//
+// surfaces are lambertian with the vertex colour as their albedo, the same colour the scene's pixel shader shows.
+// point and spot lights are picked by power from a LightAliasTable and the sun is always sampled, both with a shadow
+// ray through a TriangleBvh, and the attenuation is LightAttenuation's. indirect light follows cosine weighted
+// bounces with russian roulette.
+//
+// the image is split into tiles that the job system hands out to every core, and each Render adds whole passes of one
+// sample per pixel to a float accumulation, so the image keeps converging for as long as it is rendered. the random
+// numbers only depend on the pixel and the pass, so the result is the same however many threads there are
+class PathTracer
+{
+public:
+	PathTracer() = default;
+	~PathTracer() = default;
+
+	void Init(const PathTracerDesc& _desc);
+
+	void ClearScene();
+
+	// positions (three floats) and colours (four floats, alpha unused) are read _stride bytes apart. indices are three per triangle
+	void AddMesh(const void* _pVertices, uint32_t _vertexCount, uint32_t _stride, uint32_t _positionOffset, uint32_t _colorOffset,
+		const uint32_t* _indices, uint32_t _indexCount, const DirectX::XMFLOAT4X4& _world);
+	void SetLights(const Light* _lights, uint32_t _count);
+	void SetSun(const DirectX::XMFLOAT3& _direction, const DirectX::XMFLOAT3& _color); // the way the light travels. black turns it off
+
+	// builds the bvh and the light table after the scene has changed. starts the image over
+	void Commit();
+
+	// the camera's view and projection matrices. starts the image over
+	void SetCamera(const DirectX::XMFLOAT4X4& _view, const DirectX::XMFLOAT4X4& _proj);
+
+	// adds _passes samples to every pixel
+	void Render(uint32_t _passes, JobSystem* _pJobSystem = nullptr);
+
+	// the light arriving at _origin from _direction (normalised). for anything else that wants to integrate the scene's lighting
+	DirectX::XMFLOAT3 Radiance(const DirectX::XMFLOAT3& _origin, const DirectX::XMFLOAT3& _direction, PathRandom& _random);
+	bool Trace(const DirectX::XMFLOAT3& _origin, const DirectX::XMFLOAT3& _direction, float _tMax, PathHit& _hit);
+	bool Occluded(const DirectX::XMFLOAT3& _origin, const DirectX::XMFLOAT3& _direction, float _tMax) { return m_bvh.Occluded(_origin, _direction, _tMax); }
+
+	// the average of every pass so far
+	DirectX::XMFLOAT3 Pixel(uint32_t _x, uint32_t _y);
+	uint32_t PassCount() { return m_passCount; }
+
+	// the image as a portable float map, linear hdr rgb
+	bool SavePfm(const std::string& _fileName);
+
+	// the light reaching a surface at _position straight from the lights and the sun, times the cosine. one light is
+	// picked per call, so it is an estimate
+	DirectX::XMFLOAT3 DirectIrradiance(const DirectX::XMFLOAT3& _position, const DirectX::XMFLOAT3& _normal, PathRandom& _random);
+
+	// a direction around _normal with a probability in proportion to its cosine
+	static DirectX::XMFLOAT3 CosineDirection(const DirectX::XMFLOAT3& _normal, float _u0, float _u1);
+
+	// a point just off the surface, so rays leaving it do not hit it again
+	static DirectX::XMFLOAT3 OffsetRayOrigin(const DirectX::XMFLOAT3& _position, const DirectX::XMFLOAT3& _normal);
+
+	uint32_t Width() { return m_desc.width; }
+	uint32_t Height() { return m_desc.height; }
+
+	// the scene as of the last Commit, world space
+	const std::vector<DirectX::XMFLOAT3>& Positions() { return m_positions; }
+	const std::vector<uint32_t>& Indices() { return m_indices; }
+	const std::vector<DirectX::XMFLOAT3>& TriangleNormals() { return m_normals; }
+	const std::vector<Light>& Lights() { return m_lights; }
+	const DirectX::XMFLOAT3& SunDirection() { return m_sunDirection; }
+	const DirectX::XMFLOAT3& SunColor() { return m_sunColor; }
+
+private:
+	void RenderTile(uint32_t _tile);
+
+	PathTracerDesc m_desc;
+
+	std::vector<DirectX::XMFLOAT3> m_positions; // world space
+	std::vector<DirectX::XMFLOAT3> m_albedos; // per vertex
+	std::vector<uint32_t> m_indices;
+	std::vector<DirectX::XMFLOAT3> m_normals; // per triangle, made by Commit
+	TriangleBvh m_bvh;
+
+	std::vector<Light> m_lights;
+	LightAliasTable m_lightTable;
+	DirectX::XMFLOAT3 m_sunDirection = DirectX::XMFLOAT3(0.0f, -1.0f, 0.0f);
+	DirectX::XMFLOAT3 m_sunColor = DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
+
+	DirectX::XMFLOAT4X4 m_inverseViewProj;
+	DirectX::XMFLOAT3 m_cameraPosition;
+
+	uint32_t m_tilesX = 0;
+	uint32_t m_tilesY = 0;
+	std::vector<DirectX::XMFLOAT3> m_accumulation; // the sum of every pass
+	uint32_t m_passCount = 0;
+};
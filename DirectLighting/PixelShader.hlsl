@@ -1,11 +1,29 @@
+#include "BakedLighting.hlsli"
+#include "CascadedShadows.hlsli"
+#include "LightClusters.hlsli"
 
 struct VS_OUTPUT
 {
   float4 pos: SV_POSITION;
   float4 color: COLOR;
+  float3 normal: NORMAL;
 };
 
 float4 main(VS_OUTPUT input) : SV_TARGET
 {
-	return input.color;
-}
\ No newline at end of file
+	// the world position comes back from the depth, and everything is lit with the mesh's own normal, interpolated
+	// across the triangle. a lightmap chart is a plane, so finding one still takes the triangle's face normal, from
+	// how the position changes across it
+	float3 position = LightClusterWorldPosition(input.pos);
+	float3 normal = normalize(input.normal);
+	float3 faceNormal = normalize(cross(ddx(position), ddy(position)));
+
+	// the light bouncing off the scene comes from the irradiance volume when there is one. what was baked into the
+	// lightmap has the lights and the sun in it already, so it takes the place of the clusters and the sun. anywhere
+	// else the sun is shadowed by the cascade the pixel's view depth falls in
+	float3 indirect = BouncedLight(position, normal, ambient);
+	float3 baked;
+	float3 diffuse = SampleLightmap(position, faceNormal, baked) ? indirect + baked :
+		ClusteredDiffuse(input.pos, position, normal, indirect) + SunDiffuse(normal) * SunShadow(input.pos.w, position);
+	return float4(input.color.rgb * diffuse, input.color.a);
+}
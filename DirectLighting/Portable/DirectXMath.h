@@ -0,0 +1,513 @@
+#pragma once
+// a scalar stand in for the part of DirectXMath the portable modules use, for building them where the real library
+// is not installed. it keeps DirectXMath's conventions (row vectors, left handed matrices, comparisons that set every
+// bit of a lane) so results match the real thing to rounding. the cmake build only falls back to it when
+// DIRECTXMATH_INCLUDE_DIR does not point at a copy of DirectXMath
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#define XM_CALLCONV
+
+namespace DirectX
+{
+	const float XM_PI = 3.141592654f;
+	const float XM_2PI = 6.283185307f;
+	const float XM_1DIVPI = 0.318309886f;
+	const float XM_1DIV2PI = 0.159154943f;
+	const float XM_PIDIV2 = 1.570796327f;
+	const float XM_PIDIV4 = 0.785398163f;
+
+	const uint32_t XM_SELECT_0 = 0x00000000;
+	const uint32_t XM_SELECT_1 = 0xFFFFFFFF;
+
+	struct XMVECTOR
+	{
+		union
+		{
+			float f[4];
+			uint32_t u[4];
+		};
+	};
+	typedef const XMVECTOR& FXMVECTOR;
+	typedef const XMVECTOR& GXMVECTOR;
+	typedef const XMVECTOR& HXMVECTOR;
+	typedef const XMVECTOR& CXMVECTOR;
+
+	struct XMMATRIX
+	{
+		XMVECTOR r[4];
+	};
+	typedef const XMMATRIX& FXMMATRIX;
+	typedef const XMMATRIX& CXMMATRIX;
+
+	struct XMFLOAT2
+	{
+		float x;
+		float y;
+
+		XMFLOAT2() = default;
+		XMFLOAT2(float _x, float _y) : x(_x), y(_y) {}
+	};
+
+	struct XMFLOAT3
+	{
+		float x;
+		float y;
+		float z;
+
+		XMFLOAT3() = default;
+		XMFLOAT3(float _x, float _y, float _z) : x(_x), y(_y), z(_z) {}
+	};
+
+	struct XMFLOAT4
+	{
+		float x;
+		float y;
+		float z;
+		float w;
+
+		XMFLOAT4() = default;
+		XMFLOAT4(float _x, float _y, float _z, float _w) : x(_x), y(_y), z(_z), w(_w) {}
+	};
+
+	struct XMFLOAT4X4
+	{
+		union
+		{
+			struct
+			{
+				float _11, _12, _13, _14;
+				float _21, _22, _23, _24;
+				float _31, _32, _33, _34;
+				float _41, _42, _43, _44;
+			};
+			float m[4][4];
+		};
+
+		XMFLOAT4X4() = default;
+		XMFLOAT4X4(float _m00, float _m01, float _m02, float _m03, float _m10, float _m11, float _m12, float _m13,
+			float _m20, float _m21, float _m22, float _m23, float _m30, float _m31, float _m32, float _m33)
+			: _11(_m00), _12(_m01), _13(_m02), _14(_m03), _21(_m10), _22(_m11), _23(_m12), _24(_m13),
+			_31(_m20), _32(_m21), _33(_m22), _34(_m23), _41(_m30), _42(_m31), _43(_m32), _44(_m33) {}
+	};
+
+	// ---- setting and getting
+
+	inline XMVECTOR XMVectorSet(float _x, float _y, float _z, float _w)
+	{
+		XMVECTOR result;
+		result.f[0] = _x;
+		result.f[1] = _y;
+		result.f[2] = _z;
+		result.f[3] = _w;
+		return result;
+	}
+
+	inline XMVECTOR XMVectorSetInt(uint32_t _x, uint32_t _y, uint32_t _z, uint32_t _w)
+	{
+		XMVECTOR result;
+		result.u[0] = _x;
+		result.u[1] = _y;
+		result.u[2] = _z;
+		result.u[3] = _w;
+		return result;
+	}
+
+	inline XMVECTOR XMVectorReplicate(float _value) { return XMVectorSet(_value, _value, _value, _value); }
+	inline XMVECTOR XMVectorZero() { return XMVectorSet(0.0f, 0.0f, 0.0f, 0.0f); }
+	inline XMVECTOR XMVectorTrueInt() { return XMVectorSetInt(0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF); }
+	inline XMVECTOR XMVectorFalseInt() { return XMVectorSetInt(0, 0, 0, 0); }
+	inline XMVECTOR XMVectorSplatX(FXMVECTOR _v) { return XMVectorReplicate(_v.f[0]); }
+	inline XMVECTOR XMVectorSplatY(FXMVECTOR _v) { return XMVectorReplicate(_v.f[1]); }
+	inline XMVECTOR XMVectorSplatZ(FXMVECTOR _v) { return XMVectorReplicate(_v.f[2]); }
+	inline XMVECTOR XMVectorSplatW(FXMVECTOR _v) { return XMVectorReplicate(_v.f[3]); }
+
+	inline float XMVectorGetX(FXMVECTOR _v) { return _v.f[0]; }
+	inline float XMVectorGetY(FXMVECTOR _v) { return _v.f[1]; }
+	inline float XMVectorGetZ(FXMVECTOR _v) { return _v.f[2]; }
+	inline float XMVectorGetW(FXMVECTOR _v) { return _v.f[3]; }
+	inline float XMVectorGetByIndex(FXMVECTOR _v, size_t _index) { return _v.f[_index]; }
+	inline uint32_t XMVectorGetIntX(FXMVECTOR _v) { return _v.u[0]; }
+
+	inline XMVECTOR XMVectorSetX(FXMVECTOR _v, float _x) { XMVECTOR result = _v; result.f[0] = _x; return result; }
+	inline XMVECTOR XMVectorSetY(FXMVECTOR _v, float _y) { XMVECTOR result = _v; result.f[1] = _y; return result; }
+	inline XMVECTOR XMVectorSetZ(FXMVECTOR _v, float _z) { XMVECTOR result = _v; result.f[2] = _z; return result; }
+	inline XMVECTOR XMVectorSetW(FXMVECTOR _v, float _w) { XMVECTOR result = _v; result.f[3] = _w; return result; }
+
+	// ---- loads and stores
+
+	inline XMVECTOR XMLoadFloat2(const XMFLOAT2* _p) { return XMVectorSet(_p->x, _p->y, 0.0f, 0.0f); }
+	inline XMVECTOR XMLoadFloat3(const XMFLOAT3* _p) { return XMVectorSet(_p->x, _p->y, _p->z, 0.0f); }
+	inline XMVECTOR XMLoadFloat4(const XMFLOAT4* _p) { return XMVectorSet(_p->x, _p->y, _p->z, _p->w); }
+	inline void XMStoreFloat2(XMFLOAT2* _p, FXMVECTOR _v) { _p->x = _v.f[0]; _p->y = _v.f[1]; }
+	inline void XMStoreFloat3(XMFLOAT3* _p, FXMVECTOR _v) { _p->x = _v.f[0]; _p->y = _v.f[1]; _p->z = _v.f[2]; }
+	inline void XMStoreFloat4(XMFLOAT4* _p, FXMVECTOR _v) { _p->x = _v.f[0]; _p->y = _v.f[1]; _p->z = _v.f[2]; _p->w = _v.f[3]; }
+	inline void XMStoreInt4(uint32_t* _p, FXMVECTOR _v) { memcpy(_p, _v.u, sizeof(_v.u)); }
+
+	inline XMMATRIX XMLoadFloat4x4(const XMFLOAT4X4* _p)
+	{
+		XMMATRIX result;
+		for (int row = 0; row < 4; ++row)
+			result.r[row] = XMVectorSet(_p->m[row][0], _p->m[row][1], _p->m[row][2], _p->m[row][3]);
+		return result;
+	}
+
+	inline void XMStoreFloat4x4(XMFLOAT4X4* _p, FXMMATRIX _m)
+	{
+		for (int row = 0; row < 4; ++row)
+		{
+			for (int column = 0; column < 4; ++column)
+				_p->m[row][column] = _m.r[row].f[column];
+		}
+	}
+
+	// ---- per lane arithmetic
+
+#define XM_PORTABLE_LANES(_expression) \
+	XMVECTOR result; \
+	for (int i = 0; i < 4; ++i) \
+		result.f[i] = (_expression); \
+	return result
+
+	inline XMVECTOR XMVectorAdd(FXMVECTOR _a, FXMVECTOR _b) { XM_PORTABLE_LANES(_a.f[i] + _b.f[i]); }
+	inline XMVECTOR XMVectorSubtract(FXMVECTOR _a, FXMVECTOR _b) { XM_PORTABLE_LANES(_a.f[i] - _b.f[i]); }
+	inline XMVECTOR XMVectorMultiply(FXMVECTOR _a, FXMVECTOR _b) { XM_PORTABLE_LANES(_a.f[i] * _b.f[i]); }
+	inline XMVECTOR XMVectorDivide(FXMVECTOR _a, FXMVECTOR _b) { XM_PORTABLE_LANES(_a.f[i] / _b.f[i]); }
+	inline XMVECTOR XMVectorMultiplyAdd(FXMVECTOR _a, FXMVECTOR _b, FXMVECTOR _c) { XM_PORTABLE_LANES(_a.f[i] * _b.f[i] + _c.f[i]); }
+	inline XMVECTOR XMVectorNegativeMultiplySubtract(FXMVECTOR _a, FXMVECTOR _b, FXMVECTOR _c) { XM_PORTABLE_LANES(_c.f[i] - _a.f[i] * _b.f[i]); }
+	inline XMVECTOR XMVectorScale(FXMVECTOR _v, float _scale) { XM_PORTABLE_LANES(_v.f[i] * _scale); }
+	inline XMVECTOR XMVectorNegate(FXMVECTOR _v) { XM_PORTABLE_LANES(-_v.f[i]); }
+	inline XMVECTOR XMVectorAbs(FXMVECTOR _v) { XM_PORTABLE_LANES(std::fabs(_v.f[i])); }
+	inline XMVECTOR XMVectorSqrt(FXMVECTOR _v) { XM_PORTABLE_LANES(std::sqrt(_v.f[i])); }
+	inline XMVECTOR XMVectorReciprocal(FXMVECTOR _v) { XM_PORTABLE_LANES(1.0f / _v.f[i]); }
+	inline XMVECTOR XMVectorFloor(FXMVECTOR _v) { XM_PORTABLE_LANES(std::floor(_v.f[i])); }
+	inline XMVECTOR XMVectorRound(FXMVECTOR _v) { XM_PORTABLE_LANES(std::nearbyint(_v.f[i])); }
+	inline XMVECTOR XMVectorMin(FXMVECTOR _a, FXMVECTOR _b) { XM_PORTABLE_LANES(_a.f[i] < _b.f[i] ? _a.f[i] : _b.f[i]); }
+	inline XMVECTOR XMVectorMax(FXMVECTOR _a, FXMVECTOR _b) { XM_PORTABLE_LANES(_a.f[i] > _b.f[i] ? _a.f[i] : _b.f[i]); }
+	inline XMVECTOR XMVectorLerp(FXMVECTOR _a, FXMVECTOR _b, float _t) { XM_PORTABLE_LANES(_a.f[i] + (_b.f[i] - _a.f[i]) * _t); }
+
+	inline XMVECTOR XMVectorClamp(FXMVECTOR _v, FXMVECTOR _min, FXMVECTOR _max) { return XMVectorMin(XMVectorMax(_v, _min), _max); }
+	inline XMVECTOR XMVectorSaturate(FXMVECTOR _v) { return XMVectorClamp(_v, XMVectorZero(), XMVectorReplicate(1.0f)); }
+
+#undef XM_PORTABLE_LANES
+
+	// ---- comparisons and bit masks, a lane is all ones where the comparison holds
+
+#define XM_PORTABLE_COMPARE(_expression) \
+	XMVECTOR result; \
+	for (int i = 0; i < 4; ++i) \
+		result.u[i] = (_expression) ? 0xFFFFFFFF : 0; \
+	return result
+
+	inline XMVECTOR XMVectorEqual(FXMVECTOR _a, FXMVECTOR _b) { XM_PORTABLE_COMPARE(_a.f[i] == _b.f[i]); }
+	inline XMVECTOR XMVectorLess(FXMVECTOR _a, FXMVECTOR _b) { XM_PORTABLE_COMPARE(_a.f[i] < _b.f[i]); }
+	inline XMVECTOR XMVectorLessOrEqual(FXMVECTOR _a, FXMVECTOR _b) { XM_PORTABLE_COMPARE(_a.f[i] <= _b.f[i]); }
+	inline XMVECTOR XMVectorGreater(FXMVECTOR _a, FXMVECTOR _b) { XM_PORTABLE_COMPARE(_a.f[i] > _b.f[i]); }
+	inline XMVECTOR XMVectorGreaterOrEqual(FXMVECTOR _a, FXMVECTOR _b) { XM_PORTABLE_COMPARE(_a.f[i] >= _b.f[i]); }
+
+#undef XM_PORTABLE_COMPARE
+
+	inline XMVECTOR XMVectorSelectControl(uint32_t _x, uint32_t _y, uint32_t _z, uint32_t _w)
+	{
+		return XMVectorSetInt(_x ? XM_SELECT_1 : XM_SELECT_0, _y ? XM_SELECT_1 : XM_SELECT_0, _z ? XM_SELECT_1 : XM_SELECT_0,
+			_w ? XM_SELECT_1 : XM_SELECT_0);
+	}
+
+	inline XMVECTOR XMVectorAndInt(FXMVECTOR _a, FXMVECTOR _b)
+	{
+		return XMVectorSetInt(_a.u[0] & _b.u[0], _a.u[1] & _b.u[1], _a.u[2] & _b.u[2], _a.u[3] & _b.u[3]);
+	}
+
+	inline XMVECTOR XMVectorOrInt(FXMVECTOR _a, FXMVECTOR _b)
+	{
+		return XMVectorSetInt(_a.u[0] | _b.u[0], _a.u[1] | _b.u[1], _a.u[2] | _b.u[2], _a.u[3] | _b.u[3]);
+	}
+
+	// the bits of _b where _control is set, of _a elsewhere
+	inline XMVECTOR XMVectorSelect(FXMVECTOR _a, FXMVECTOR _b, FXMVECTOR _control)
+	{
+		XMVECTOR result;
+		for (int i = 0; i < 4; ++i)
+			result.u[i] = (_a.u[i] & ~_control.u[i]) | (_b.u[i] & _control.u[i]);
+		return result;
+	}
+
+	// ---- 3 and 4 component vector operations, the results are replicated into every lane
+
+	inline XMVECTOR XMVector3Dot(FXMVECTOR _a, FXMVECTOR _b) { return XMVectorReplicate(_a.f[0] * _b.f[0] + _a.f[1] * _b.f[1] + _a.f[2] * _b.f[2]); }
+	inline XMVECTOR XMVector4Dot(FXMVECTOR _a, FXMVECTOR _b) { return XMVectorReplicate(_a.f[0] * _b.f[0] + _a.f[1] * _b.f[1] + _a.f[2] * _b.f[2] + _a.f[3] * _b.f[3]); }
+	inline XMVECTOR XMVector3LengthSq(FXMVECTOR _v) { return XMVector3Dot(_v, _v); }
+	inline XMVECTOR XMVector4LengthSq(FXMVECTOR _v) { return XMVector4Dot(_v, _v); }
+	inline XMVECTOR XMVector3Length(FXMVECTOR _v) { return XMVectorSqrt(XMVector3Dot(_v, _v)); }
+	inline XMVECTOR XMVector4Length(FXMVECTOR _v) { return XMVectorSqrt(XMVector4Dot(_v, _v)); }
+
+	inline XMVECTOR XMVector3Cross(FXMVECTOR _a, FXMVECTOR _b)
+	{
+		return XMVectorSet(_a.f[1] * _b.f[2] - _a.f[2] * _b.f[1], _a.f[2] * _b.f[0] - _a.f[0] * _b.f[2], _a.f[0] * _b.f[1] - _a.f[1] * _b.f[0], 0.0f);
+	}
+
+	// a zero length vector comes back as it is, like DirectXMath
+	inline XMVECTOR XMVector3Normalize(FXMVECTOR _v)
+	{
+		float length = XMVectorGetX(XMVector3Length(_v));
+		return length > 0.0f ? XMVectorScale(_v, 1.0f / length) : _v;
+	}
+
+	inline XMVECTOR XMVector4Normalize(FXMVECTOR _v)
+	{
+		float length = XMVectorGetX(XMVector4Length(_v));
+		return length > 0.0f ? XMVectorScale(_v, 1.0f / length) : _v;
+	}
+
+	inline bool XMVector3Equal(FXMVECTOR _a, FXMVECTOR _b) { return _a.f[0] == _b.f[0] && _a.f[1] == _b.f[1] && _a.f[2] == _b.f[2]; }
+	inline bool XMVector3Less(FXMVECTOR _a, FXMVECTOR _b) { return _a.f[0] < _b.f[0] && _a.f[1] < _b.f[1] && _a.f[2] < _b.f[2]; }
+	inline bool XMVector3LessOrEqual(FXMVECTOR _a, FXMVECTOR _b) { return _a.f[0] <= _b.f[0] && _a.f[1] <= _b.f[1] && _a.f[2] <= _b.f[2]; }
+	inline bool XMVector3Greater(FXMVECTOR _a, FXMVECTOR _b) { return _a.f[0] > _b.f[0] && _a.f[1] > _b.f[1] && _a.f[2] > _b.f[2]; }
+	inline bool XMVector3GreaterOrEqual(FXMVECTOR _a, FXMVECTOR _b) { return _a.f[0] >= _b.f[0] && _a.f[1] >= _b.f[1] && _a.f[2] >= _b.f[2]; }
+	inline bool XMVector4EqualInt(FXMVECTOR _a, FXMVECTOR _b) { return memcmp(_a.u, _b.u, sizeof(_a.u)) == 0; }
+	inline bool XMVector4NotEqualInt(FXMVECTOR _a, FXMVECTOR _b) { return memcmp(_a.u, _b.u, sizeof(_a.u)) != 0; }
+
+	// planes are (nx, ny, nz, d)
+	inline XMVECTOR XMPlaneNormalize(FXMVECTOR _plane)
+	{
+		float length = XMVectorGetX(XMVector3Length(_plane));
+		return length > 0.0f ? XMVectorScale(_plane, 1.0f / length) : _plane;
+	}
+
+	inline XMVECTOR XMPlaneDotCoord(FXMVECTOR _plane, FXMVECTOR _point) { return XMVectorReplicate(XMVectorGetX(XMVector3Dot(_plane, _point)) + _plane.f[3]); }
+	inline XMVECTOR XMPlaneDotNormal(FXMVECTOR _plane, FXMVECTOR _normal) { return XMVector3Dot(_plane, _normal); }
+
+	// ---- transforms, row vectors times matrices
+
+	inline XMVECTOR XMVector4Transform(FXMVECTOR _v, FXMMATRIX _m)
+	{
+		XMVECTOR result;
+		for (int column = 0; column < 4; ++column)
+			result.f[column] = _v.f[0] * _m.r[0].f[column] + _v.f[1] * _m.r[1].f[column] + _v.f[2] * _m.r[2].f[column] + _v.f[3] * _m.r[3].f[column];
+		return result;
+	}
+
+	inline XMVECTOR XMVector3Transform(FXMVECTOR _v, FXMMATRIX _m) { return XMVector4Transform(XMVectorSetW(_v, 1.0f), _m); }
+	inline XMVECTOR XMVector3TransformNormal(FXMVECTOR _v, FXMMATRIX _m) { return XMVector4Transform(XMVectorSetW(_v, 0.0f), _m); }
+
+	inline XMVECTOR XMVector3TransformCoord(FXMVECTOR _v, FXMMATRIX _m)
+	{
+		XMVECTOR result = XMVector3Transform(_v, _m);
+		return XMVectorScale(result, 1.0f / result.f[3]);
+	}
+
+	// ---- matrices
+
+	inline XMMATRIX XMMatrixSet(float _m00, float _m01, float _m02, float _m03, float _m10, float _m11, float _m12, float _m13,
+		float _m20, float _m21, float _m22, float _m23, float _m30, float _m31, float _m32, float _m33)
+	{
+		XMMATRIX result;
+		result.r[0] = XMVectorSet(_m00, _m01, _m02, _m03);
+		result.r[1] = XMVectorSet(_m10, _m11, _m12, _m13);
+		result.r[2] = XMVectorSet(_m20, _m21, _m22, _m23);
+		result.r[3] = XMVectorSet(_m30, _m31, _m32, _m33);
+		return result;
+	}
+
+	inline XMMATRIX XMMatrixIdentity()
+	{
+		return XMMatrixSet(1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+	}
+
+	inline XMMATRIX XMMatrixMultiply(FXMMATRIX _a, CXMMATRIX _b)
+	{
+		XMMATRIX result;
+		for (int row = 0; row < 4; ++row)
+			result.r[row] = XMVector4Transform(_a.r[row], _b);
+		return result;
+	}
+
+	inline XMMATRIX XMMatrixTranspose(FXMMATRIX _m)
+	{
+		XMMATRIX result;
+		for (int row = 0; row < 4; ++row)
+		{
+			for (int column = 0; column < 4; ++column)
+				result.r[row].f[column] = _m.r[column].f[row];
+		}
+		return result;
+	}
+
+	inline XMMATRIX XMMatrixTranslation(float _x, float _y, float _z)
+	{
+		return XMMatrixSet(1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, _x, _y, _z, 1.0f);
+	}
+
+	inline XMMATRIX XMMatrixTranslationFromVector(FXMVECTOR _v) { return XMMatrixTranslation(_v.f[0], _v.f[1], _v.f[2]); }
+
+	inline XMMATRIX XMMatrixScaling(float _x, float _y, float _z)
+	{
+		return XMMatrixSet(_x, 0.0f, 0.0f, 0.0f, 0.0f, _y, 0.0f, 0.0f, 0.0f, 0.0f, _z, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+	}
+
+	inline XMMATRIX XMMatrixRotationX(float _angle)
+	{
+		float c = std::cos(_angle);
+		float s = std::sin(_angle);
+		return XMMatrixSet(1.0f, 0.0f, 0.0f, 0.0f, 0.0f, c, s, 0.0f, 0.0f, -s, c, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+	}
+
+	inline XMMATRIX XMMatrixRotationY(float _angle)
+	{
+		float c = std::cos(_angle);
+		float s = std::sin(_angle);
+		return XMMatrixSet(c, 0.0f, -s, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, s, 0.0f, c, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+	}
+
+	inline XMMATRIX XMMatrixRotationZ(float _angle)
+	{
+		float c = std::cos(_angle);
+		float s = std::sin(_angle);
+		return XMMatrixSet(c, s, 0.0f, 0.0f, -s, c, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+	}
+
+	inline XMMATRIX XMMatrixRotationQuaternion(FXMVECTOR _q)
+	{
+		float x = _q.f[0];
+		float y = _q.f[1];
+		float z = _q.f[2];
+		float w = _q.f[3];
+		return XMMatrixSet(
+			1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y + z * w), 2.0f * (x * z - y * w), 0.0f,
+			2.0f * (x * y - z * w), 1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z + x * w), 0.0f,
+			2.0f * (x * z + y * w), 2.0f * (y * z - x * w), 1.0f - 2.0f * (x * x + y * y), 0.0f,
+			0.0f, 0.0f, 0.0f, 1.0f);
+	}
+
+	inline XMMATRIX XMMatrixLookToLH(FXMVECTOR _eye, FXMVECTOR _direction, FXMVECTOR _up)
+	{
+		XMVECTOR axisZ = XMVector3Normalize(_direction);
+		XMVECTOR axisX = XMVector3Normalize(XMVector3Cross(_up, axisZ));
+		XMVECTOR axisY = XMVector3Cross(axisZ, axisX);
+		XMVECTOR negativeEye = XMVectorNegate(_eye);
+		XMMATRIX result;
+		result.r[0] = XMVectorSetW(axisX, XMVectorGetX(XMVector3Dot(axisX, negativeEye)));
+		result.r[1] = XMVectorSetW(axisY, XMVectorGetX(XMVector3Dot(axisY, negativeEye)));
+		result.r[2] = XMVectorSetW(axisZ, XMVectorGetX(XMVector3Dot(axisZ, negativeEye)));
+		result.r[3] = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+		return XMMatrixTranspose(result);
+	}
+
+	inline XMMATRIX XMMatrixLookAtLH(FXMVECTOR _eye, FXMVECTOR _focus, FXMVECTOR _up)
+	{
+		return XMMatrixLookToLH(_eye, XMVectorSubtract(_focus, _eye), _up);
+	}
+
+	inline XMMATRIX XMMatrixPerspectiveFovLH(float _fovAngleY, float _aspectRatio, float _nearZ, float _farZ)
+	{
+		float height = 1.0f / std::tan(0.5f * _fovAngleY);
+		float width = height / _aspectRatio;
+		float range = _farZ / (_farZ - _nearZ);
+		return XMMatrixSet(width, 0.0f, 0.0f, 0.0f, 0.0f, height, 0.0f, 0.0f, 0.0f, 0.0f, range, 1.0f, 0.0f, 0.0f, -range * _nearZ, 0.0f);
+	}
+
+	inline XMMATRIX XMMatrixOrthographicOffCenterLH(float _left, float _right, float _bottom, float _top, float _nearZ, float _farZ)
+	{
+		float width = 1.0f / (_right - _left);
+		float height = 1.0f / (_top - _bottom);
+		float range = 1.0f / (_farZ - _nearZ);
+		return XMMatrixSet(width + width, 0.0f, 0.0f, 0.0f, 0.0f, height + height, 0.0f, 0.0f, 0.0f, 0.0f, range, 0.0f,
+			-(_left + _right) * width, -(_top + _bottom) * height, -range * _nearZ, 1.0f);
+	}
+
+	inline XMMATRIX XMMatrixOrthographicLH(float _width, float _height, float _nearZ, float _farZ)
+	{
+		return XMMatrixOrthographicOffCenterLH(-0.5f * _width, 0.5f * _width, -0.5f * _height, 0.5f * _height, _nearZ, _farZ);
+	}
+
+	inline XMVECTOR XMMatrixDeterminant(FXMMATRIX _m)
+	{
+		// cofactors along the first row, each a 3x3 determinant of the rows below
+		float determinant = 0.0f;
+		for (int column = 0; column < 4; ++column)
+		{
+			int c[3];
+			for (int i = 0, j = 0; i < 4; ++i)
+			{
+				if (i != column)
+					c[j++] = i;
+			}
+			const float* r1 = _m.r[1].f;
+			const float* r2 = _m.r[2].f;
+			const float* r3 = _m.r[3].f;
+			float minor = r1[c[0]] * (r2[c[1]] * r3[c[2]] - r2[c[2]] * r3[c[1]]) - r1[c[1]] * (r2[c[0]] * r3[c[2]] - r2[c[2]] * r3[c[0]]) +
+				r1[c[2]] * (r2[c[0]] * r3[c[1]] - r2[c[1]] * r3[c[0]]);
+			determinant += (column & 1 ? -1.0f : 1.0f) * _m.r[0].f[column] * minor;
+		}
+		return XMVectorReplicate(determinant);
+	}
+
+	// gauss-jordan with partial pivoting in doubles
+	inline XMMATRIX XMMatrixInverse(XMVECTOR* _pDeterminant, FXMMATRIX _m)
+	{
+		double a[4][8];
+		for (int row = 0; row < 4; ++row)
+		{
+			for (int column = 0; column < 4; ++column)
+			{
+				a[row][column] = _m.r[row].f[column];
+				a[row][column + 4] = row == column ? 1.0 : 0.0;
+			}
+		}
+		for (int column = 0; column < 4; ++column)
+		{
+			int pivot = column;
+			for (int row = column + 1; row < 4; ++row)
+			{
+				if (std::fabs(a[row][column]) > std::fabs(a[pivot][column]))
+					pivot = row;
+			}
+			for (int k = 0; k < 8; ++k)
+			{
+				double swap = a[column][k];
+				a[column][k] = a[pivot][k];
+				a[pivot][k] = swap;
+			}
+			double divisor = a[column][column];
+			for (int k = 0; k < 8; ++k)
+				a[column][k] /= divisor;
+			for (int row = 0; row < 4; ++row)
+			{
+				if (row == column)
+					continue;
+				double factor = a[row][column];
+				for (int k = 0; k < 8; ++k)
+					a[row][k] -= factor * a[column][k];
+			}
+		}
+
+		XMMATRIX result;
+		for (int row = 0; row < 4; ++row)
+		{
+			for (int column = 0; column < 4; ++column)
+				result.r[row].f[column] = static_cast<float>(a[row][column + 4]);
+		}
+		if (_pDeterminant)
+			*_pDeterminant = XMMatrixDeterminant(_m);
+		return result;
+	}
+
+	// ---- scalars
+
+	inline float XMConvertToRadians(float _degrees) { return _degrees * (XM_PI / 180.0f); }
+	inline float XMScalarSin(float _angle) { return std::sin(_angle); }
+	inline float XMScalarCos(float _angle) { return std::cos(_angle); }
+
+	// ---- operators
+
+	inline XMVECTOR operator+(FXMVECTOR _a, FXMVECTOR _b) { return XMVectorAdd(_a, _b); }
+	inline XMVECTOR operator-(FXMVECTOR _a, FXMVECTOR _b) { return XMVectorSubtract(_a, _b); }
+	inline XMVECTOR operator*(FXMVECTOR _a, FXMVECTOR _b) { return XMVectorMultiply(_a, _b); }
+	inline XMVECTOR operator/(FXMVECTOR _a, FXMVECTOR _b) { return XMVectorDivide(_a, _b); }
+	inline XMVECTOR operator*(FXMVECTOR _v, float _scale) { return XMVectorScale(_v, _scale); }
+	inline XMVECTOR operator*(float _scale, FXMVECTOR _v) { return XMVectorScale(_v, _scale); }
+	inline XMVECTOR operator-(FXMVECTOR _v) { return XMVectorNegate(_v); }
+	inline XMMATRIX operator*(FXMMATRIX _a, CXMMATRIX _b) { return XMMatrixMultiply(_a, _b); }
+}
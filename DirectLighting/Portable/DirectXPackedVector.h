@@ -0,0 +1,75 @@
+#pragma once
+// the half float conversion from DirectXPackedVector, for the cmake build without DirectXMath (see DirectXMath.h here)
+#include <cstdint>
+#include <cstring>
+
+#include "DirectXMath.h"
+
+namespace DirectX
+{
+	namespace PackedVector
+	{
+		typedef uint16_t HALF;
+
+		// rounds to nearest even. too big becomes infinity, too small flushes through the denormals to zero
+		inline HALF XMConvertFloatToHalf(float _value)
+		{
+			uint32_t bits;
+			memcpy(&bits, &_value, sizeof(bits));
+			uint32_t sign = (bits >> 16) & 0x8000;
+			uint32_t magnitude = bits & 0x7FFFFFFF;
+			if (magnitude >= 0x7F800000)
+				return static_cast<HALF>(sign | (magnitude > 0x7F800000 ? 0x7E00 : 0x7C00));
+			if (magnitude >= 0x477FF000)
+				return static_cast<HALF>(sign | 0x7C00);
+			if (magnitude < 0x38800000)
+			{
+				// a denormal half: shift the mantissa, with its implicit one, down by how far the exponent is under -14
+				uint32_t shift = 113 - (magnitude >> 23);
+				if (shift > 11) // under half the smallest denormal
+					return static_cast<HALF>(sign);
+				uint32_t mantissa = (magnitude & 0x7FFFFF) | 0x800000;
+				uint32_t half = mantissa >> (shift + 13);
+				uint32_t rest = mantissa & ((1u << (shift + 13)) - 1);
+				uint32_t halfway = 1u << (shift + 12);
+				if (rest > halfway || (rest == halfway && (half & 1)))
+					half++;
+				return static_cast<HALF>(sign | half);
+			}
+			uint32_t rebiased = magnitude - 0x38000000;
+			uint32_t half = rebiased >> 13;
+			uint32_t rest = rebiased & 0x1FFF;
+			if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+				half++;
+			return static_cast<HALF>(sign | half);
+		}
+
+		inline float XMConvertHalfToFloat(HALF _value)
+		{
+			uint32_t sign = static_cast<uint32_t>(_value & 0x8000) << 16;
+			uint32_t exponent = (_value >> 10) & 0x1F;
+			uint32_t mantissa = _value & 0x3FF;
+			uint32_t bits;
+			if (exponent == 0x1F)
+				bits = sign | 0x7F800000 | (mantissa << 13);
+			else if (exponent != 0)
+				bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+			else if (mantissa == 0)
+				bits = sign;
+			else
+			{
+				// a denormal, normalise it
+				exponent = 113;
+				while ((mantissa & 0x400) == 0)
+				{
+					mantissa <<= 1;
+					exponent--;
+				}
+				bits = sign | (exponent << 23) | ((mantissa & 0x3FF) << 13);
+			}
+			float result;
+			memcpy(&result, &bits, sizeof(result));
+			return result;
+		}
+	}
+}
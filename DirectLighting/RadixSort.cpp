@@ -0,0 +1,166 @@
+#include "RadixSort.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "JobSystem.h"
+
+namespace
+{
+	const uint32_t RADIX_BITS = 8;
+	const uint32_t RADIX_BUCKETS = 1 << RADIX_BITS;
+	const uint32_t RADIX_PASSES = 64 / RADIX_BITS;
+
+	// below this many keys per block the cost of waking the workers is more than the sort
+	const uint32_t MIN_KEYS_PER_BLOCK = 16 * 1024;
+
+	inline uint32_t Digit(uint64_t _key, uint32_t _pass)
+	{
+		return static_cast<uint32_t>(_key >> (_pass * RADIX_BITS)) & (RADIX_BUCKETS - 1);
+	}
+
+	void RunBlocks(JobSystem* _pJobSystem, uint32_t _blockCount, const std::function<void(unsigned int, unsigned int)>& _func)
+	{
+		if (_pJobSystem && _blockCount > 1)
+			_pJobSystem->ParallelFor(_blockCount, 1, _func);
+		else
+			_func(0, _blockCount);
+	}
+}
+
+void RadixSort64(uint64_t* _keys, uint32_t* _values, uint64_t* _tempKeys, uint32_t* _tempValues, uint32_t _count, JobSystem* _pJobSystem)
+{
+	if (_count < 2)
+		return;
+
+	uint32_t blockCount = 1;
+	if (_pJobSystem)
+	{
+		uint32_t maxBlocks = std::max(1u, _count / MIN_KEYS_PER_BLOCK);
+		blockCount = std::min(_pJobSystem->ThreadCount() + 1, maxBlocks);
+	}
+	uint32_t blockSize = (_count + blockCount - 1) / blockCount;
+
+	// histograms of every digit for the whole array, used to find passes that would not move anything.
+	// these do not depend on the order of the keys so they are built once up front
+	std::vector<uint32_t> blockTotals(static_cast<size_t>(blockCount) * RADIX_PASSES * RADIX_BUCKETS, 0);
+	RunBlocks(_pJobSystem, blockCount, [&](unsigned int _begin, unsigned int _end)
+	{
+		for (unsigned int block = _begin; block < _end; ++block)
+		{
+			uint32_t* pTotals = &blockTotals[static_cast<size_t>(block) * RADIX_PASSES * RADIX_BUCKETS];
+			uint32_t first = block * blockSize;
+			uint32_t last = std::min(first + blockSize, _count);
+			for (uint32_t i = first; i < last; ++i)
+			{
+				uint64_t key = _keys[i];
+				for (uint32_t pass = 0; pass < RADIX_PASSES; ++pass)
+				{
+					pTotals[pass * RADIX_BUCKETS + Digit(key, pass)]++;
+				}
+			}
+		}
+	});
+
+	bool passNeeded[RADIX_PASSES];
+	for (uint32_t pass = 0; pass < RADIX_PASSES; ++pass)
+	{
+		passNeeded[pass] = true;
+		for (uint32_t digit = 0; digit < RADIX_BUCKETS; ++digit)
+		{
+			uint32_t total = 0;
+			for (uint32_t block = 0; block < blockCount; ++block)
+			{
+				total += blockTotals[(static_cast<size_t>(block) * RADIX_PASSES + pass) * RADIX_BUCKETS + digit];
+			}
+			if (total == _count)
+			{
+				passNeeded[pass] = false; // every key has this digit
+				break;
+			}
+			if (total != 0)
+				break; // at least two different digits
+		}
+	}
+
+	uint64_t* pSrcKeys = _keys;
+	uint32_t* pSrcValues = _values;
+	uint64_t* pDstKeys = _tempKeys;
+	uint32_t* pDstValues = _tempValues;
+
+	// per block write offsets for the current pass, laid out [block][digit]
+	std::vector<uint32_t> offsets(static_cast<size_t>(blockCount) * RADIX_BUCKETS);
+	for (uint32_t pass = 0; pass < RADIX_PASSES; ++pass)
+	{
+		if (!passNeeded[pass])
+			continue;
+
+		// the keys have moved since the last pass so each block counts its own digits again
+		RunBlocks(_pJobSystem, blockCount, [&](unsigned int _begin, unsigned int _end)
+		{
+			for (unsigned int block = _begin; block < _end; ++block)
+			{
+				uint32_t* pCounts = &offsets[static_cast<size_t>(block) * RADIX_BUCKETS];
+				memset(pCounts, 0, RADIX_BUCKETS * sizeof(uint32_t));
+				uint32_t first = block * blockSize;
+				uint32_t last = std::min(first + blockSize, _count);
+				for (uint32_t i = first; i < last; ++i)
+				{
+					pCounts[Digit(pSrcKeys[i], pass)]++;
+				}
+			}
+		});
+
+		// exclusive prefix sum in (digit, block) order, so block 0's keys with a digit come before block 1's
+		// keys with the same digit. that is what keeps the sort stable
+		uint32_t running = 0;
+		for (uint32_t digit = 0; digit < RADIX_BUCKETS; ++digit)
+		{
+			for (uint32_t block = 0; block < blockCount; ++block)
+			{
+				uint32_t& offset = offsets[static_cast<size_t>(block) * RADIX_BUCKETS + digit];
+				uint32_t count = offset;
+				offset = running;
+				running += count;
+			}
+		}
+
+		RunBlocks(_pJobSystem, blockCount, [&](unsigned int _begin, unsigned int _end)
+		{
+			for (unsigned int block = _begin; block < _end; ++block)
+			{
+				uint32_t* pOffsets = &offsets[static_cast<size_t>(block) * RADIX_BUCKETS];
+				uint32_t first = block * blockSize;
+				uint32_t last = std::min(first + blockSize, _count);
+				for (uint32_t i = first; i < last; ++i)
+				{
+					uint64_t key = pSrcKeys[i];
+					uint32_t destination = pOffsets[Digit(key, pass)]++;
+					pDstKeys[destination] = key;
+					pDstValues[destination] = pSrcValues[i];
+				}
+			}
+		});
+
+		std::swap(pSrcKeys, pDstKeys);
+		std::swap(pSrcValues, pDstValues);
+	}
+
+	// an odd number of passes leaves the result in the temp arrays
+	if (pSrcKeys != _keys)
+	{
+		RunBlocks(_pJobSystem, blockCount, [&](unsigned int _begin, unsigned int _end)
+		{
+			for (unsigned int block = _begin; block < _end; ++block)
+			{
+				uint32_t first = block * blockSize;
+				uint32_t last = std::min(first + blockSize, _count);
+				if (first >= last)
+					continue;
+				memcpy(_keys + first, pSrcKeys + first, (last - first) * sizeof(uint64_t));
+				memcpy(_values + first, pSrcValues + first, (last - first) * sizeof(uint32_t));
+			}
+		});
+	}
+}
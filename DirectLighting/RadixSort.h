@@ -0,0 +1,12 @@
+#pragma once
+#include <cstdint>
+
+class JobSystem;
+
+// stable least significant digit radix sort of 64 bit keys, 8 bits per pass. _values are moved with their keys
+// (usually an index into whatever the keys describe). _tempKeys/_tempValues must hold _count entries and are
+// used as the other half of the ping pong. passes where every key has the same digit are skipped, which is
+// most of them for draw sort keys, so a frame's worth of draws usually only costs a few passes.
+// each pass is split into one block per thread: every block builds its own histogram, a prefix sum over
+// (digit, block) gives each block its own output ranges, then every block scatters without any atomics
+void RadixSort64(uint64_t* _keys, uint32_t* _values, uint64_t* _tempKeys, uint32_t* _tempValues, uint32_t _count, JobSystem* _pJobSystem = nullptr);
@@ -0,0 +1,256 @@
+#include "RootSignature.h"
+
+#include <cassert>
+#include <cstring>
+
+#include "d3dx12.h"
+
+UINT RootSignatureDesc::AddConstants(UINT _shaderRegister, UINT _num32BitValues, D3D12_SHADER_VISIBILITY _visibility, UINT _registerSpace)
+{
+	return AddRootParameter(D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS, _shaderRegister, _num32BitValues, _visibility, _registerSpace);
+}
+
+UINT RootSignatureDesc::AddCBV(UINT _shaderRegister, D3D12_SHADER_VISIBILITY _visibility, UINT _registerSpace)
+{
+	return AddRootParameter(D3D12_ROOT_PARAMETER_TYPE_CBV, _shaderRegister, 0, _visibility, _registerSpace);
+}
+
+UINT RootSignatureDesc::AddSRV(UINT _shaderRegister, D3D12_SHADER_VISIBILITY _visibility, UINT _registerSpace)
+{
+	return AddRootParameter(D3D12_ROOT_PARAMETER_TYPE_SRV, _shaderRegister, 0, _visibility, _registerSpace);
+}
+
+UINT RootSignatureDesc::AddUAV(UINT _shaderRegister, D3D12_SHADER_VISIBILITY _visibility, UINT _registerSpace)
+{
+	return AddRootParameter(D3D12_ROOT_PARAMETER_TYPE_UAV, _shaderRegister, 0, _visibility, _registerSpace);
+}
+
+UINT RootSignatureDesc::AddDescriptorTable(D3D12_SHADER_VISIBILITY _visibility)
+{
+	return AddRootParameter(D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE, 0, 0, _visibility, 0);
+}
+
+void RootSignatureDesc::AddDescriptorRange(UINT _tableSlot, D3D12_DESCRIPTOR_RANGE_TYPE _type, UINT _numDescriptors, UINT _baseShaderRegister, UINT _registerSpace)
+{
+	D3D12_DESCRIPTOR_RANGE range;
+	range.RangeType = _type;
+	range.NumDescriptors = _numDescriptors;
+	range.BaseShaderRegister = _baseShaderRegister;
+	range.RegisterSpace = _registerSpace;
+	range.OffsetInDescriptorsFromTableStart = D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND; // ranges are packed one after another in the table
+	m_parameters[_tableSlot].ranges.push_back(range);
+}
+
+void RootSignatureDesc::AddStaticSampler(const D3D12_STATIC_SAMPLER_DESC& _sampler)
+{
+	m_staticSamplers.push_back(_sampler);
+}
+
+UINT RootSignatureDesc::AddRootParameter(D3D12_ROOT_PARAMETER_TYPE _type, UINT _shaderRegister, UINT _num32BitValues, D3D12_SHADER_VISIBILITY _visibility, UINT _registerSpace)
+{
+	Parameter parameter;
+	parameter.type = _type;
+	parameter.visibility = _visibility;
+	parameter.shaderRegister = _shaderRegister;
+	parameter.registerSpace = _registerSpace;
+	parameter.num32BitValues = _num32BitValues;
+	m_parameters.push_back(parameter);
+	return static_cast<UINT>(m_parameters.size() - 1);
+}
+
+UINT RootSignatureDesc::SizeInDWORDs() const
+{
+	UINT size = 0;
+	for (const Parameter& parameter : m_parameters)
+	{
+		switch (parameter.type)
+		{
+		case D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS:
+			size += parameter.num32BitValues;
+			break;
+		case D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE:
+			size += 1;
+			break;
+		default:
+			size += 2; // root descriptors are a 64 bit gpu virtual address
+			break;
+		}
+	}
+	return size;
+}
+
+void RootSignatureDesc::BuildKey(std::vector<UINT>& _key) const
+{
+	_key.clear();
+	_key.push_back(static_cast<UINT>(m_flags));
+	_key.push_back(static_cast<UINT>(m_parameters.size()));
+	for (const Parameter& parameter : m_parameters)
+	{
+		_key.push_back(static_cast<UINT>(parameter.type));
+		_key.push_back(static_cast<UINT>(parameter.visibility));
+		_key.push_back(parameter.shaderRegister);
+		_key.push_back(parameter.registerSpace);
+		_key.push_back(parameter.num32BitValues);
+		_key.push_back(static_cast<UINT>(parameter.ranges.size()));
+		for (const D3D12_DESCRIPTOR_RANGE& range : parameter.ranges)
+		{
+			_key.push_back(static_cast<UINT>(range.RangeType));
+			_key.push_back(range.NumDescriptors);
+			_key.push_back(range.BaseShaderRegister);
+			_key.push_back(range.RegisterSpace);
+			_key.push_back(range.OffsetInDescriptorsFromTableStart);
+		}
+	}
+
+	// every member of a static sampler is 32 bits wide, so it can be copied in as is
+	_key.push_back(static_cast<UINT>(m_staticSamplers.size()));
+	for (const D3D12_STATIC_SAMPLER_DESC& sampler : m_staticSamplers)
+	{
+		size_t offset = _key.size();
+		_key.resize(offset + sizeof(D3D12_STATIC_SAMPLER_DESC) / sizeof(UINT));
+		memcpy(&_key[offset], &sampler, sizeof(D3D12_STATIC_SAMPLER_DESC));
+	}
+}
+
+UINT64 RootSignatureDesc::Hash() const
+{
+	std::vector<UINT> key;
+	BuildKey(key);
+
+	// 64 bit FNV-1a over the key
+	UINT64 hash = 14695981039346656037ull;
+	const BYTE* pBytes = reinterpret_cast<const BYTE*>(key.data());
+	for (size_t i = 0; i < key.size() * sizeof(UINT); ++i)
+	{
+		hash ^= pBytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+bool RootSignatureDesc::operator==(const RootSignatureDesc& _other) const
+{
+	std::vector<UINT> key;
+	std::vector<UINT> otherKey;
+	BuildKey(key);
+	_other.BuildKey(otherKey);
+	return key == otherKey;
+}
+
+bool RootSignatureDesc::Serialize(ID3DBlob** _ppBlob) const
+{
+	std::vector<CD3DX12_ROOT_PARAMETER> rootParameters(m_parameters.size());
+	for (size_t i = 0; i < m_parameters.size(); ++i)
+	{
+		const Parameter& parameter = m_parameters[i];
+		switch (parameter.type)
+		{
+		case D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS:
+			rootParameters[i].InitAsConstants(parameter.num32BitValues, parameter.shaderRegister, parameter.registerSpace, parameter.visibility);
+			break;
+		case D3D12_ROOT_PARAMETER_TYPE_CBV:
+			rootParameters[i].InitAsConstantBufferView(parameter.shaderRegister, parameter.registerSpace, parameter.visibility);
+			break;
+		case D3D12_ROOT_PARAMETER_TYPE_SRV:
+			rootParameters[i].InitAsShaderResourceView(parameter.shaderRegister, parameter.registerSpace, parameter.visibility);
+			break;
+		case D3D12_ROOT_PARAMETER_TYPE_UAV:
+			rootParameters[i].InitAsUnorderedAccessView(parameter.shaderRegister, parameter.registerSpace, parameter.visibility);
+			break;
+		case D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE:
+			// the ranges live in this description, which outlives the serialize call
+			rootParameters[i].InitAsDescriptorTable(static_cast<UINT>(parameter.ranges.size()), parameter.ranges.data(), parameter.visibility);
+			break;
+		}
+	}
+
+	CD3DX12_ROOT_SIGNATURE_DESC rootSignatureDesc;
+	rootSignatureDesc.Init(static_cast<UINT>(rootParameters.size()),
+		rootParameters.data(),
+		static_cast<UINT>(m_staticSamplers.size()),
+		m_staticSamplers.data(),
+		m_flags);
+
+	ID3DBlob* errorBuff = nullptr;
+	HRESULT hr = D3D12SerializeRootSignature(&rootSignatureDesc, D3D_ROOT_SIGNATURE_VERSION_1, _ppBlob, &errorBuff);
+	if (FAILED(hr))
+	{
+		if (errorBuff)
+			OutputDebugStringA((char*)errorBuff->GetBufferPointer());
+	}
+	if (errorBuff)
+		errorBuff->Release();
+
+	return SUCCEEDED(hr);
+}
+
+RootSignatureCache::~RootSignatureCache()
+{
+	Release();
+}
+
+ID3D12RootSignature* RootSignatureCache::GetOrCreate(ID3D12Device* _pDevice, const RootSignatureDesc& _desc)
+{
+	UINT64 hash = _desc.Hash();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::vector<Entry>& bucket = m_entries[hash];
+	for (Entry& entry : bucket)
+	{
+		if (entry.desc == _desc)
+			return entry.pRootSignature;
+	}
+
+	// a description over the limit is a mistake in the code building it, so catch it here rather than as a
+	// serializer error. release builds still refuse it
+	assert(_desc.SizeInDWORDs() <= RootSignatureDesc::MAX_DWORDS);
+	if (_desc.SizeInDWORDs() > RootSignatureDesc::MAX_DWORDS)
+	{
+		OutputDebugStringA("root signature is over 64 DWORDs\n");
+		return nullptr;
+	}
+
+	ID3DBlob* signature = nullptr;
+	if (!_desc.Serialize(&signature))
+	{
+		return nullptr;
+	}
+
+	ID3D12RootSignature* pRootSignature = nullptr;
+	HRESULT hr = _pDevice->CreateRootSignature(0, signature->GetBufferPointer(), signature->GetBufferSize(), IID_PPV_ARGS(&pRootSignature));
+	signature->Release();
+	if (FAILED(hr))
+	{
+		return nullptr;
+	}
+
+	Entry entry;
+	entry.desc = _desc;
+	entry.pRootSignature = pRootSignature;
+	bucket.push_back(entry);
+	return pRootSignature;
+}
+
+void RootSignatureCache::Release()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (auto& bucket : m_entries)
+	{
+		for (Entry& entry : bucket.second)
+		{
+			entry.pRootSignature->Release();
+		}
+	}
+	m_entries.clear();
+}
+
+size_t RootSignatureCache::Size()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	size_t size = 0;
+	for (auto& bucket : m_entries)
+	{
+		size += bucket.second.size();
+	}
+	return size;
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <Windows.h>
+#include <D3d12.h>
+
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// a declarative description of a root signature. parameters are added in root slot order and
+// each Add* returns the slot index to pass to SetGraphicsRoot*. root constants are the cheapest
+// way to get small per draw data (object index, material id, a matrix) to a shader, they are
+// stored in the command list so there is no constant buffer to allocate or upload
+class RootSignatureDesc
+{
+public:
+	static const UINT MAX_DWORDS = 64;
+
+	UINT AddConstants(UINT _shaderRegister, UINT _num32BitValues, D3D12_SHADER_VISIBILITY _visibility = D3D12_SHADER_VISIBILITY_ALL, UINT _registerSpace = 0);
+	UINT AddCBV(UINT _shaderRegister, D3D12_SHADER_VISIBILITY _visibility = D3D12_SHADER_VISIBILITY_ALL, UINT _registerSpace = 0);
+	UINT AddSRV(UINT _shaderRegister, D3D12_SHADER_VISIBILITY _visibility = D3D12_SHADER_VISIBILITY_ALL, UINT _registerSpace = 0);
+	UINT AddUAV(UINT _shaderRegister, D3D12_SHADER_VISIBILITY _visibility = D3D12_SHADER_VISIBILITY_ALL, UINT _registerSpace = 0);
+
+	// a descriptor table starts empty, fill it with AddDescriptorRange using the returned slot
+	UINT AddDescriptorTable(D3D12_SHADER_VISIBILITY _visibility = D3D12_SHADER_VISIBILITY_ALL);
+	void AddDescriptorRange(UINT _tableSlot, D3D12_DESCRIPTOR_RANGE_TYPE _type, UINT _numDescriptors, UINT _baseShaderRegister, UINT _registerSpace = 0);
+
+	void AddStaticSampler(const D3D12_STATIC_SAMPLER_DESC& _sampler);
+	void SetFlags(D3D12_ROOT_SIGNATURE_FLAGS _flags) { m_flags = _flags; }
+
+	UINT ParameterCount() const { return static_cast<UINT>(m_parameters.size()); }
+
+	// root signatures are limited to MAX_DWORDS: constants cost one per value, root descriptors two, tables one
+	UINT SizeInDWORDs() const;
+
+	UINT64 Hash() const;
+	bool operator==(const RootSignatureDesc& _other) const;
+
+	bool Serialize(ID3DBlob** _ppBlob) const;
+
+private:
+	struct Parameter
+	{
+		D3D12_ROOT_PARAMETER_TYPE type;
+		D3D12_SHADER_VISIBILITY visibility;
+		UINT shaderRegister;
+		UINT registerSpace;
+		UINT num32BitValues;
+		std::vector<D3D12_DESCRIPTOR_RANGE> ranges; // only used by descriptor tables
+	};
+
+	UINT AddRootParameter(D3D12_ROOT_PARAMETER_TYPE _type, UINT _shaderRegister, UINT _num32BitValues, D3D12_SHADER_VISIBILITY _visibility, UINT _registerSpace);
+
+	// flattens the description into a list of values, used for both hashing and comparing
+	void BuildKey(std::vector<UINT>& _key) const;
+
+	std::vector<Parameter> m_parameters;
+	std::vector<D3D12_STATIC_SAMPLER_DESC> m_staticSamplers;
+	D3D12_ROOT_SIGNATURE_FLAGS m_flags = D3D12_ROOT_SIGNATURE_FLAG_NONE;
+};
+
+// creates each distinct root signature once. psos built from the same description share it,
+// which also lets the command list skip rebinding when the root signature does not change
+class RootSignatureCache
+{
+public:
+	RootSignatureCache() = default;
+	~RootSignatureCache();
+
+	// the cache keeps the reference, do not release the returned root signature
+	ID3D12RootSignature* GetOrCreate(ID3D12Device* _pDevice, const RootSignatureDesc& _desc);
+
+	void Release();
+	size_t Size();
+
+private:
+	struct Entry
+	{
+		RootSignatureDesc desc;
+		ID3D12RootSignature* pRootSignature;
+	};
+
+	std::mutex m_mutex; // psos can be built on worker threads
+	std::unordered_map<UINT64, std::vector<Entry>> m_entries; // hash -> every description with that hash
+};
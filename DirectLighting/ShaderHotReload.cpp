@@ -0,0 +1,290 @@
+#include "ShaderHotReload.h"
+
+#include <fstream>
+
+namespace
+{
+	// opens includes next to the shader that is compiling and remembers which, for hot reload to watch
+	class RecordingInclude : public ID3DInclude
+	{
+	public:
+		RecordingInclude(const std::string& _directory, std::vector<std::string>* _pIncludes)
+			: m_directory(_directory), m_pIncludes(_pIncludes)
+		{
+		}
+
+		HRESULT __stdcall Open(D3D_INCLUDE_TYPE, LPCSTR _pFileName, LPCVOID, LPCVOID* _ppData, UINT* _pBytes) override
+		{
+			std::string path = m_directory + _pFileName;
+			std::ifstream file(path, std::ios::binary | std::ios::ate);
+			if (!file)
+				return E_FAIL;
+
+			size_t size = static_cast<size_t>(file.tellg());
+			char* pData = new char[size > 0 ? size : 1];
+			file.seekg(0);
+			file.read(pData, static_cast<std::streamsize>(size));
+			*_ppData = pData;
+			*_pBytes = static_cast<UINT>(size);
+			if (m_pIncludes)
+				m_pIncludes->push_back(path);
+			return S_OK;
+		}
+
+		HRESULT __stdcall Close(LPCVOID _pData) override
+		{
+			delete[] static_cast<const char*>(_pData);
+			return S_OK;
+		}
+
+	private:
+		std::string m_directory;
+		std::vector<std::string>* m_pIncludes;
+	};
+}
+
+ShaderHotReload::~ShaderHotReload()
+{
+	Shutdown();
+}
+
+bool ShaderHotReload::Init(JobSystem* _pJobSystem, const std::string& _directory, BuildPSOFunc _buildPSO)
+{
+	m_pJobSystem = _pJobSystem;
+	AddPipeline(_buildPSO);
+	return m_watcher.Start(_directory);
+}
+
+UINT ShaderHotReload::AddPipeline(BuildPSOFunc _buildPSO)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_buildPSOs.push_back(_buildPSO);
+	m_readyPSOs.push_back(nullptr);
+	return static_cast<UINT>(m_buildPSOs.size() - 1);
+}
+
+void ShaderHotReload::Shutdown()
+{
+	m_watcher.Stop();
+
+	// a rebuild may still be using the device on a worker, let it finish
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_idleCondition.wait(lock, [this]() { return !m_rebuildInFlight; });
+
+	for (int i = 0; i < STAGE_COUNT; ++i)
+	{
+		if (m_shaders[i].pBlob)
+		{
+			m_shaders[i].pBlob->Release();
+			m_shaders[i].pBlob = nullptr;
+		}
+	}
+	for (ID3D12PipelineState*& pReadyPSO : m_readyPSOs)
+	{
+		if (pReadyPSO)
+		{
+			pReadyPSO->Release();
+			pReadyPSO = nullptr;
+		}
+	}
+}
+
+void ShaderHotReload::SetVertexShader(const std::string& _file, ID3DBlob* _pBlob, const std::vector<std::string>& _includes)
+{
+	SetShader(STAGE_VERTEX, _file, "vs_5_0", _pBlob, _includes);
+}
+
+void ShaderHotReload::SetPixelShader(const std::string& _file, ID3DBlob* _pBlob, const std::vector<std::string>& _includes)
+{
+	SetShader(STAGE_PIXEL, _file, "ps_5_0", _pBlob, _includes);
+}
+
+void ShaderHotReload::SetShader(ShaderStage _stage, const std::string& _file, const char* _target, ID3DBlob* _pBlob,
+	const std::vector<std::string>& _includes)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	ShaderSource& shader = m_shaders[_stage];
+	if (shader.pBlob)
+		shader.pBlob->Release();
+
+	shader.file = _file;
+	shader.target = _target;
+	shader.includes = _includes;
+	shader.pBlob = _pBlob;
+	shader.dirty = false;
+	if (shader.pBlob)
+		shader.pBlob->AddRef();
+}
+
+void ShaderHotReload::Update()
+{
+	std::vector<std::string> changedFiles;
+	m_watcher.PollChanges(changedFiles);
+
+	RebuildJob job;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (const std::string& file : changedFiles)
+		{
+			for (int i = 0; i < STAGE_COUNT; ++i)
+			{
+				if (_stricmp(file.c_str(), m_shaders[i].file.c_str()) == 0)
+					m_shaders[i].dirty = true;
+				for (const std::string& include : m_shaders[i].includes)
+				{
+					if (_stricmp(file.c_str(), include.c_str()) == 0)
+						m_shaders[i].dirty = true;
+				}
+			}
+		}
+
+		// only one rebuild at a time. anything that changes meanwhile stays dirty and goes in the next one
+		if (m_rebuildInFlight || (!m_shaders[STAGE_VERTEX].dirty && !m_shaders[STAGE_PIXEL].dirty))
+			return;
+
+		for (int i = 0; i < STAGE_COUNT; ++i)
+		{
+			job.dirty[i] = m_shaders[i].dirty;
+			job.files[i] = m_shaders[i].file;
+			job.targets[i] = m_shaders[i].target;
+			m_shaders[i].dirty = false;
+
+			// the clean stage is reused as is, keep it alive while the worker has it
+			job.pBlobs[i] = m_shaders[i].pBlob;
+			if (job.pBlobs[i])
+				job.pBlobs[i]->AddRef();
+		}
+		m_rebuildInFlight = true;
+	}
+
+	m_pJobSystem->Submit([this, job]() mutable
+	{
+		Rebuild(job);
+	});
+}
+
+void ShaderHotReload::Rebuild(RebuildJob& _job)
+{
+	ID3DBlob** pBlobs = _job.pBlobs;
+	bool compiled = true;
+	bool recompiled[STAGE_COUNT] = {};
+	std::vector<std::string> includes[STAGE_COUNT];
+	for (int i = 0; i < STAGE_COUNT && compiled; ++i)
+	{
+		if (!_job.dirty[i])
+			continue;
+
+		ID3DBlob* pNewBlob = nullptr;
+		compiled = CompileShader(_job.files[i], _job.targets[i], &pNewBlob, &includes[i]);
+		if (compiled)
+		{
+			if (pBlobs[i])
+				pBlobs[i]->Release();
+			pBlobs[i] = pNewBlob;
+			recompiled[i] = true;
+		}
+	}
+
+	// every pipeline or none, a pso that built is thrown away if a later one does not
+	std::vector<ID3D12PipelineState*> psos;
+	if (compiled && pBlobs[STAGE_VERTEX] && pBlobs[STAGE_PIXEL])
+	{
+		for (BuildPSOFunc& buildPSO : m_buildPSOs)
+		{
+			ID3D12PipelineState* pPSO = buildPSO(pBlobs[STAGE_VERTEX], pBlobs[STAGE_PIXEL]);
+			if (pPSO == nullptr)
+				break;
+			psos.push_back(pPSO);
+		}
+		if (psos.size() != m_buildPSOs.size())
+		{
+			for (ID3D12PipelineState* pPSO : psos)
+				pPSO->Release();
+			psos.clear();
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	// a shader that gained or lost an include is watched for the new set, unless it was replaced meanwhile
+	for (int i = 0; i < STAGE_COUNT; ++i)
+	{
+		if (recompiled[i] && m_shaders[i].file == _job.files[i])
+			m_shaders[i].includes.swap(includes[i]);
+	}
+
+	if (!psos.empty())
+	{
+		// these are now the last good shaders
+		for (int i = 0; i < STAGE_COUNT; ++i)
+		{
+			if (m_shaders[i].pBlob)
+				m_shaders[i].pBlob->Release();
+			m_shaders[i].pBlob = pBlobs[i];
+		}
+
+		// a pso that was never picked up has been superseded
+		for (size_t i = 0; i < psos.size(); ++i)
+		{
+			if (m_readyPSOs[i])
+				m_readyPSOs[i]->Release();
+			m_readyPSOs[i] = psos[i];
+		}
+	}
+	else
+	{
+		for (int i = 0; i < STAGE_COUNT; ++i)
+		{
+			if (pBlobs[i])
+				pBlobs[i]->Release();
+		}
+	}
+	m_rebuildInFlight = false;
+	m_idleCondition.notify_all();
+}
+
+ID3D12PipelineState* ShaderHotReload::TakeReadyPSO(UINT _pipeline)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (_pipeline >= m_readyPSOs.size())
+		return nullptr;
+	ID3D12PipelineState* pPSO = m_readyPSOs[_pipeline];
+	m_readyPSOs[_pipeline] = nullptr;
+	return pPSO;
+}
+
+bool ShaderHotReload::CompileShader(const std::string& _file, const char* _target, ID3DBlob** _ppBlob, std::vector<std::string>* _pIncludes, UINT _flags)
+{
+	// when debugging, we can compile the shader files at runtime.
+	// but for release versions, we can compile the hlsl shaders
+	// with fxc.exe to create .cso files, which contain the shader
+	// bytecode. We can load the .cso files at runtime to get the
+	// shader bytecode, which of course is faster than compiling
+	// them at runtime
+	std::wstring wideFile(_file.begin(), _file.end());
+	size_t slash = _file.find_last_of("/\\");
+	RecordingInclude include(slash == std::string::npos ? std::string() : _file.substr(0, slash + 1), _pIncludes);
+
+	ID3DBlob* errorBuff = nullptr; // a buffer holding the error data if any
+	HRESULT hr = D3DCompileFromFile(wideFile.c_str(),
+		nullptr,
+		&include,
+		"main",
+		_target,
+		_flags,
+		0,
+		_ppBlob,
+		&errorBuff);
+	if (FAILED(hr))
+	{
+		// there is no error blob if the file could not be opened at all
+		if (errorBuff)
+			OutputDebugStringA((char*)errorBuff->GetBufferPointer());
+		else
+			OutputDebugStringA(("could not compile " + _file + "\n").c_str());
+	}
+	if (errorBuff)
+		errorBuff->Release();
+
+	return SUCCEEDED(hr);
+}
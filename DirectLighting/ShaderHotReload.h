@@ -0,0 +1,92 @@
+#pragma once
+#include <Windows.h>
+#include <D3d12.h>
+#include <d3dcompiler.h>
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "FileWatcher.h"
+#include "JobSystem.h"
+
+// recompiles the vertex/pixel shaders when their files change on disk and builds a replacement for every
+// pso made from them on a worker thread. the render thread picks the new psos up between frames with
+// TakeReadyPSO, so a reload never stalls a frame. if a shader fails to compile, or any of the psos fails
+// to build, the old psos all stay in use, so they never mix old and new shaders.
+// the files a shader includes count as its own, so saving a .hlsli recompiles every stage that pulled
+// it in the last time it compiled
+class ShaderHotReload
+{
+public:
+	// builds a pso from a vertex/pixel shader pair, a depth only one just ignores the pixel shader. called from a
+	// worker thread, so it may only use free threaded device calls
+	typedef std::function<ID3D12PipelineState*(ID3DBlob* _pVertexShader, ID3DBlob* _pPixelShader)> BuildPSOFunc;
+
+	ShaderHotReload() = default;
+	~ShaderHotReload();
+
+	// _buildPSO is pipeline 0
+	bool Init(JobSystem* _pJobSystem, const std::string& _directory, BuildPSOFunc _buildPSO);
+	void Shutdown();
+
+	// another pso built from the same shaders, rebuilt with the first. call before the first Update, returns the
+	// pipeline to pass to TakeReadyPSO
+	UINT AddPipeline(BuildPSOFunc _buildPSO);
+
+	// the shaders the current pso was built with and the files CompileShader said they include. adds a reference to the blob
+	void SetVertexShader(const std::string& _file, ID3DBlob* _pBlob, const std::vector<std::string>& _includes = std::vector<std::string>());
+	void SetPixelShader(const std::string& _file, ID3DBlob* _pBlob, const std::vector<std::string>& _includes = std::vector<std::string>());
+
+	// once per frame on the render thread: picks up settled file changes and starts a recompile
+	void Update();
+
+	// _pipeline's pso built from the latest shaders, or nullptr if nothing new has finished. the caller owns the reference
+	ID3D12PipelineState* TakeReadyPSO(UINT _pipeline = 0);
+
+	// includes are looked for next to _file. the ones opened are appended to _pIncludes, paths as _file gives them.
+	// _flags are D3DCOMPILE_ flags, debuggable by default since a reload is for while the shaders are being worked on
+	static bool CompileShader(const std::string& _file, const char* _target, ID3DBlob** _ppBlob, std::vector<std::string>* _pIncludes = nullptr,
+		UINT _flags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION);
+
+private:
+	enum ShaderStage
+	{
+		STAGE_VERTEX = 0,
+		STAGE_PIXEL = 1,
+		STAGE_COUNT = 2
+	};
+
+	struct ShaderSource
+	{
+		std::string file;
+		const char* target = nullptr;
+		std::vector<std::string> includes; // from the last time it compiled
+		ID3DBlob* pBlob = nullptr; // last blob that compiled and built a pso
+		bool dirty = false;
+	};
+
+	// what a rebuild works from, copied out under the lock so the worker never reads m_shaders without it
+	struct RebuildJob
+	{
+		bool dirty[STAGE_COUNT];
+		ID3DBlob* pBlobs[STAGE_COUNT];
+		std::string files[STAGE_COUNT];
+		const char* targets[STAGE_COUNT];
+	};
+
+	void SetShader(ShaderStage _stage, const std::string& _file, const char* _target, ID3DBlob* _pBlob, const std::vector<std::string>& _includes);
+	void Rebuild(RebuildJob& _job);
+
+	JobSystem* m_pJobSystem = nullptr;
+	FileWatcher m_watcher;
+	std::vector<BuildPSOFunc> m_buildPSOs; // one per pipeline, only changed before the first rebuild
+
+	std::mutex m_mutex; // guards everything below, the worker writes it when a rebuild finishes
+	std::condition_variable m_idleCondition;
+	ShaderSource m_shaders[STAGE_COUNT];
+	std::vector<ID3D12PipelineState*> m_readyPSOs; // one per pipeline
+	bool m_rebuildInFlight = false;
+};
@@ -0,0 +1,321 @@
+#include "ShadowAtlas.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace DirectX;
+
+namespace
+{
+	// a tile only grows once the light wants a quarter more than it has, and only shrinks once it wants less than
+	// 0.4 of it, which is a fifth under the next size down
+	const float GROW_MARGIN = 1.25f;
+	const float SHRINK_MARGIN = 0.4f;
+}
+
+void ShadowAtlas::Init(const ShadowAtlasDesc& _desc)
+{
+	m_desc = _desc;
+	m_desc.minTileSize = std::min(std::max(m_desc.minTileSize, 1u), m_desc.atlasSize);
+	m_desc.maxTileSize = std::min(std::max(m_desc.maxTileSize, m_desc.minTileSize), m_desc.atlasSize);
+
+	m_levelCount = 1;
+	for (uint32_t size = m_desc.atlasSize; size > m_desc.minTileSize; size /= 2)
+		++m_levelCount;
+
+	// (4^levels - 1) / 3 nodes in the whole tree
+	uint32_t nodeCount = 0;
+	for (uint32_t level = 0, levelNodes = 1; level < m_levelCount; ++level, levelNodes *= 4)
+		nodeCount += levelNodes;
+
+	m_states.assign(nodeCount, NODE_NONE);
+	m_levels.resize(nodeCount);
+	m_freeSlots.assign(nodeCount, 0);
+	for (uint32_t level = 0, first = 0, levelNodes = 1; level < m_levelCount; ++level, first += levelNodes, levelNodes *= 4)
+		std::fill(m_levels.begin() + first, m_levels.begin() + first + levelNodes, static_cast<uint8_t>(level));
+
+	m_freeLists.resize(m_levelCount);
+	for (std::vector<uint32_t>& freeList : m_freeLists)
+		freeList.clear();
+	m_states[0] = NODE_FREE;
+	AddFree(0);
+
+	m_usedArea = 0;
+	m_tiles.clear();
+	m_frame = 0;
+	m_invalidated = false;
+}
+
+float ShadowAtlas::ProjectedSize(const XMFLOAT4& _sphere, const XMFLOAT4X4& _view, const XMFLOAT4X4& _proj, uint32_t _screenHeight)
+{
+	XMVECTOR center = XMVector3TransformCoord(XMVectorSet(_sphere.x, _sphere.y, _sphere.z, 1.0f), XMLoadFloat4x4(&_view));
+	float distanceSq = XMVectorGetX(XMVector3LengthSq(center));
+	float radiusSq = _sphere.w * _sphere.w;
+	if (distanceSq <= radiusSq)
+		return std::numeric_limits<float>::max();
+
+	// the tangent of the angle the sphere covers from its centre, times the projection's scale, is half its height
+	// in clip space, which is two units high
+	float tanAngle = _sphere.w / std::sqrt(distanceSq - radiusSq);
+	return tanAngle * _proj._22 * static_cast<float>(_screenHeight);
+}
+
+uint32_t ShadowAtlas::TileSize(float _desiredSize)
+{
+	uint32_t size = m_desc.minTileSize;
+	while (size < m_desc.maxTileSize && static_cast<float>(size) < _desiredSize)
+		size *= 2;
+	return size;
+}
+
+void ShadowAtlas::Update(const ShadowAtlasRequest* _requests, uint32_t _count, ShadowAtlasTile* _tiles)
+{
+	++m_frame;
+
+	// the size every request gets, kept in the output until the tiles are placed
+	for (uint32_t i = 0; i < _count; ++i)
+	{
+		uint32_t size = TileSize(_requests[i].desiredSize);
+		auto it = m_tiles.find(_requests[i].key);
+		if (it != m_tiles.end())
+		{
+			Tile& tile = it->second;
+			float current = static_cast<float>(tile.size);
+			if ((size > tile.size && _requests[i].desiredSize <= current * GROW_MARGIN) ||
+				(size < tile.size && _requests[i].desiredSize > current * SHRINK_MARGIN))
+			{
+				size = tile.size;
+			}
+			tile.frame = m_frame;
+		}
+		_tiles[i].size = size;
+		_tiles[i].render = false;
+	}
+
+	// when everything would not fit even packed perfectly, every tile is halved until it would, so the lights that
+	// came first do not keep the whole atlas to themselves
+	uint64_t atlasArea = static_cast<uint64_t>(m_desc.atlasSize) * m_desc.atlasSize;
+	for (;;)
+	{
+		uint64_t area = 0;
+		bool canShrink = false;
+		for (uint32_t i = 0; i < _count; ++i)
+		{
+			area += static_cast<uint64_t>(_tiles[i].size) * _tiles[i].size;
+			canShrink = canShrink || _tiles[i].size > m_desc.minTileSize;
+		}
+		if (area <= atlasArea || !canShrink)
+			break;
+		for (uint32_t i = 0; i < _count; ++i)
+			_tiles[i].size = std::max(_tiles[i].size / 2, m_desc.minTileSize);
+	}
+
+	// free the tiles nobody asked for. they go in key order so the layout only depends on the requests
+	m_order.clear();
+	for (const auto& entry : m_tiles)
+	{
+		if (entry.second.frame != m_frame)
+			m_order.push_back(entry.first);
+	}
+	std::sort(m_order.begin(), m_order.end());
+	for (uint32_t key : m_order)
+	{
+		Free(m_tiles[key].node);
+		m_tiles.erase(key);
+	}
+
+	// shrinking tiles give up their room first. the smaller tile always fits, at worst in the room just freed
+	for (uint32_t i = 0; i < _count; ++i)
+	{
+		auto it = m_tiles.find(_requests[i].key);
+		if (it != m_tiles.end() && _tiles[i].size < it->second.size)
+		{
+			Free(it->second.node);
+			it->second.node = Allocate(_tiles[i].size);
+			it->second.size = _tiles[i].size;
+			_tiles[i].render = true;
+		}
+	}
+
+	// then the growing and the new ones, largest first so the big tiles are not blocked by small ones
+	m_order.clear();
+	for (uint32_t i = 0; i < _count; ++i)
+	{
+		auto it = m_tiles.find(_requests[i].key);
+		if (it == m_tiles.end() || _tiles[i].size > it->second.size)
+			m_order.push_back(i);
+	}
+	std::sort(m_order.begin(), m_order.end(), [&](uint32_t _a, uint32_t _b)
+	{
+		if (_tiles[_a].size != _tiles[_b].size)
+			return _tiles[_a].size > _tiles[_b].size;
+		return _requests[_a].key < _requests[_b].key;
+	});
+	for (uint32_t i : m_order)
+	{
+		auto it = m_tiles.find(_requests[i].key);
+		if (it != m_tiles.end())
+		{
+			// a tile that cannot grow keeps what it has rather than starting over smaller
+			uint32_t node = Allocate(_tiles[i].size);
+			if (node != INVALID_NODE)
+			{
+				Free(it->second.node);
+				it->second.node = node;
+				it->second.size = _tiles[i].size;
+				_tiles[i].render = true;
+			}
+			continue;
+		}
+
+		uint32_t node = Place(_tiles[i].size, m_desc.minTileSize);
+		if (node == INVALID_NODE)
+			continue;
+
+		Tile tile;
+		tile.node = node;
+		tile.size = m_desc.atlasSize >> m_levels[node];
+		tile.contentHash = _requests[i].contentHash;
+		tile.frame = m_frame;
+		m_tiles[_requests[i].key] = tile;
+		_tiles[i].render = true;
+	}
+
+	for (uint32_t i = 0; i < _count; ++i)
+	{
+		ShadowAtlasTile& out = _tiles[i];
+		auto it = m_tiles.find(_requests[i].key);
+		if (it == m_tiles.end())
+		{
+			out.x = 0;
+			out.y = 0;
+			out.size = 0;
+			out.render = false;
+			continue;
+		}
+
+		Tile& tile = it->second;
+		NodeRect(tile.node, out.x, out.y, out.size);
+		out.render = out.render || m_invalidated || tile.contentHash != _requests[i].contentHash;
+		tile.contentHash = _requests[i].contentHash;
+	}
+	m_invalidated = false;
+}
+
+uint32_t ShadowAtlas::Allocate(uint32_t _size)
+{
+	if (_size < m_desc.minTileSize || _size > m_desc.atlasSize)
+		return INVALID_NODE;
+
+	uint32_t node = FindFree(Level(_size));
+	if (node == INVALID_NODE)
+		return INVALID_NODE;
+
+	RemoveFree(node);
+	m_states[node] = NODE_TAKEN;
+	m_usedArea += static_cast<uint64_t>(_size) * _size;
+	return node;
+}
+
+uint32_t ShadowAtlas::Place(uint32_t _size, uint32_t _minSize)
+{
+	for (uint32_t size = _size; size >= _minSize; size /= 2)
+	{
+		uint32_t node = Allocate(size);
+		if (node != INVALID_NODE)
+			return node;
+	}
+	return INVALID_NODE;
+}
+
+void ShadowAtlas::Free(uint32_t _node)
+{
+	uint32_t size = m_desc.atlasSize >> m_levels[_node];
+	m_usedArea -= static_cast<uint64_t>(size) * size;
+	m_states[_node] = NODE_FREE;
+	AddFree(_node);
+
+	// merge back up for as long as all four siblings are free
+	while (_node != 0)
+	{
+		uint32_t parent = (_node - 1) / 4;
+		uint32_t firstChild = parent * 4 + 1;
+		bool allFree = true;
+		for (uint32_t child = firstChild; child < firstChild + 4; ++child)
+			allFree = allFree && m_states[child] == NODE_FREE;
+		if (!allFree)
+			break;
+
+		for (uint32_t child = firstChild; child < firstChild + 4; ++child)
+		{
+			RemoveFree(child);
+			m_states[child] = NODE_NONE;
+		}
+		m_states[parent] = NODE_FREE;
+		AddFree(parent);
+		_node = parent;
+	}
+}
+
+void ShadowAtlas::NodeRect(uint32_t _node, uint32_t& _x, uint32_t& _y, uint32_t& _size)
+{
+	_size = m_desc.atlasSize >> m_levels[_node];
+	_x = 0;
+	_y = 0;
+
+	// children are numbered left to right then top to bottom
+	for (uint32_t size = _size; _node != 0; size *= 2)
+	{
+		uint32_t child = (_node - 1) % 4;
+		_x += (child & 1) * size;
+		_y += (child >> 1) * size;
+		_node = (_node - 1) / 4;
+	}
+}
+
+uint32_t ShadowAtlas::FindFree(uint32_t _level)
+{
+	if (!m_freeLists[_level].empty())
+		return m_freeLists[_level].back();
+	if (_level == 0)
+		return INVALID_NODE;
+
+	uint32_t parent = FindFree(_level - 1);
+	if (parent == INVALID_NODE)
+		return INVALID_NODE;
+
+	// split the parent. the children go on backwards so the first one is handed out first
+	RemoveFree(parent);
+	m_states[parent] = NODE_SPLIT;
+	for (uint32_t child = parent * 4 + 4; child > parent * 4; --child)
+	{
+		m_states[child] = NODE_FREE;
+		AddFree(child);
+	}
+	return parent * 4 + 1;
+}
+
+void ShadowAtlas::AddFree(uint32_t _node)
+{
+	std::vector<uint32_t>& freeList = m_freeLists[m_levels[_node]];
+	m_freeSlots[_node] = static_cast<uint32_t>(freeList.size());
+	freeList.push_back(_node);
+}
+
+void ShadowAtlas::RemoveFree(uint32_t _node)
+{
+	std::vector<uint32_t>& freeList = m_freeLists[m_levels[_node]];
+	uint32_t slot = m_freeSlots[_node];
+	freeList[slot] = freeList.back();
+	m_freeSlots[freeList[slot]] = slot;
+	freeList.pop_back();
+}
+
+uint32_t ShadowAtlas::Level(uint32_t _size)
+{
+	uint32_t level = 0;
+	for (uint32_t size = m_desc.atlasSize; size > _size && level + 1 < m_levelCount; size /= 2)
+		++level;
+	return level;
+}
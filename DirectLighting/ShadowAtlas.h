@@ -0,0 +1,116 @@
+#pragma once
+#include <DirectXMath.h>
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+struct ShadowAtlasDesc
+{
+	uint32_t atlasSize = 8192; // texels along each side of the atlas' depth texture, a power of two
+	uint32_t minTileSize = 128; // the smallest and largest shadow map a light can get, powers of two
+	uint32_t maxTileSize = 2048;
+};
+
+// one shadow map a light wants this frame. a point light asks for six, one per cube face
+struct ShadowAtlasRequest
+{
+	uint32_t key; // the same from frame to frame for the same light (and face), unique within a frame
+	float desiredSize; // texels along the side, usually ShadowAtlas::ProjectedSize scaled to taste
+	uint64_t contentHash; // anything that changes what the shadow map holds: the light and the casters in its volume
+};
+
+// where a request ended up. size is 0 when there was no room left
+struct ShadowAtlasTile
+{
+	uint32_t x;
+	uint32_t y;
+	uint32_t size;
+	bool render; // the tile is new or its contents are out of date. tiles that are not rendered keep last frame's depth
+};
+
+// hands out square tiles of one large depth texture to the shadow maps of spot and point lights, sized by how big
+// the light is on screen.
+//
+// the tiles come from a quadtree: every node is either free, split into four children or holds one tile, and a
+// free node's three siblings are merged back into their parent as soon as they are all free again. every tile is a
+// power of two and sits on a multiple of its own size, so the atlas never fragments into pieces that nothing fits.
+//
+// tiles stay where they are for as long as their light keeps asking for the same size, and a tile whose content
+// hash has not changed is not rendered again, so lights that only see static casters cost nothing after the first
+// frame. sizes only change once the desired size has moved well past the tile's, so a light near a power of two
+// does not flip between sizes (and get re-rendered) every frame. when the requests add up to more than the atlas
+// holds they are all halved until they fit. tiles already in the atlas are never evicted for new ones, shrinking
+// tiles give up their room first and the rest are placed largest first
+class ShadowAtlas
+{
+public:
+	static const uint32_t INVALID_NODE = 0xffffffff;
+
+	ShadowAtlas() = default;
+	~ShadowAtlas() = default;
+
+	// empties the atlas
+	void Init(const ShadowAtlasDesc& _desc);
+
+	// places this frame's requests, _tiles gets one per request in the same order. tiles of keys that were not
+	// requested are freed
+	void Update(const ShadowAtlasRequest* _requests, uint32_t _count, ShadowAtlasTile* _tiles);
+
+	// every tile is rendered again on the next Update, e.g. after the atlas texture has been recreated
+	void Invalidate() { m_invalidated = true; }
+
+	// the height in pixels of _sphere (world space centre and radius) on screen, or the float max if the camera is inside it
+	static float ProjectedSize(const DirectX::XMFLOAT4& _sphere, const DirectX::XMFLOAT4X4& _view, const DirectX::XMFLOAT4X4& _proj, uint32_t _screenHeight);
+
+	// the power of two tile a desired size rounds up to, clamped to the desc's range
+	uint32_t TileSize(float _desiredSize);
+
+	// the quadtree on its own. Allocate returns INVALID_NODE when there is no room, _size has to be a power of two
+	// between the desc's min and the atlas size
+	uint32_t Allocate(uint32_t _size);
+	void Free(uint32_t _node);
+	void NodeRect(uint32_t _node, uint32_t& _x, uint32_t& _y, uint32_t& _size);
+
+	uint32_t AtlasSize() { return m_desc.atlasSize; }
+	uint64_t UsedArea() { return m_usedArea; } // texels taken by tiles
+	uint32_t TileCount() { return static_cast<uint32_t>(m_tiles.size()); }
+
+private:
+	enum NodeState : uint8_t
+	{
+		NODE_NONE = 0, // inside a free or taken ancestor
+		NODE_FREE,
+		NODE_SPLIT,
+		NODE_TAKEN
+	};
+
+	struct Tile
+	{
+		uint32_t node;
+		uint32_t size;
+		uint64_t contentHash;
+		uint32_t frame; // the last Update that asked for it
+	};
+
+	uint32_t FindFree(uint32_t _level);
+	void AddFree(uint32_t _node);
+	void RemoveFree(uint32_t _node);
+	uint32_t Level(uint32_t _size);
+	uint32_t Place(uint32_t _size, uint32_t _minSize); // tries smaller sizes down to _minSize when _size does not fit
+
+	ShadowAtlasDesc m_desc;
+	uint32_t m_levelCount = 0; // level 0 is the whole atlas, every level below has four times the nodes
+
+	// the tree is stored breadth first, so node n's children are 4n + 1 to 4n + 4
+	std::vector<uint8_t> m_states;
+	std::vector<uint8_t> m_levels;
+	std::vector<uint32_t> m_freeSlots; // where a free node is in its level's free list
+	std::vector<std::vector<uint32_t>> m_freeLists; // [level]
+	uint64_t m_usedArea = 0;
+
+	std::unordered_map<uint32_t, Tile> m_tiles; // key -> its tile
+	std::vector<uint32_t> m_order; // scratch for Update
+	uint32_t m_frame = 0;
+	bool m_invalidated = false;
+};
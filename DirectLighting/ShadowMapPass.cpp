@@ -0,0 +1,313 @@
+#include "ShadowMapPass.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "D3dx12.h"
+#include "JobSystem.h"
+#include "ShaderHotReload.h"
+
+using namespace DirectX;
+
+static_assert(sizeof(ShadowMapConstants) == 288, "ShadowMapConstants must match the cbuffer in CascadedShadows.hlsli");
+
+void ShadowMapPass::AddRootParameters(RootSignatureDesc& _rootSignatureDesc)
+{
+	m_rootConstants = _rootSignatureDesc.AddCBV(3, D3D12_SHADER_VISIBILITY_PIXEL);
+	m_rootShadowMap = _rootSignatureDesc.AddDescriptorTable(D3D12_SHADER_VISIBILITY_PIXEL);
+	_rootSignatureDesc.AddDescriptorRange(m_rootShadowMap, D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 13);
+
+	// compares on every tap and filters the results, so a texel's edge is soft even before the shader's four taps.
+	// outside the cascade the white border leaves everything lit
+	D3D12_STATIC_SAMPLER_DESC sampler = {};
+	sampler.Filter = D3D12_FILTER_COMPARISON_MIN_MAG_LINEAR_MIP_POINT;
+	sampler.AddressU = D3D12_TEXTURE_ADDRESS_MODE_BORDER;
+	sampler.AddressV = D3D12_TEXTURE_ADDRESS_MODE_BORDER;
+	sampler.AddressW = D3D12_TEXTURE_ADDRESS_MODE_CLAMP;
+	sampler.BorderColor = D3D12_STATIC_BORDER_COLOR_OPAQUE_WHITE;
+	sampler.ComparisonFunc = D3D12_COMPARISON_FUNC_LESS_EQUAL;
+	sampler.ShaderRegister = 1;
+	sampler.ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
+	_rootSignatureDesc.AddStaticSampler(sampler);
+}
+
+bool ShadowMapPass::Init(ID3D12Device* _pDevice, ID3D12RootSignature* _pRootSignature, UINT _rootParamPerObject, const std::string& _vertexShaderFile,
+	const D3D12_INPUT_LAYOUT_DESC& _inputLayout, UINT _resolution, UINT _cascadeCount, UINT _frameCount)
+{
+	if (_frameCount > MAX_FRAMES || _cascadeCount > MAX_SHADOW_CASCADES)
+	{
+		return false;
+	}
+	m_pDevice = _pDevice;
+	m_pRootSignature = _pRootSignature;
+	m_rootParamPerObject = _rootParamPerObject;
+	m_inputLayout = _inputLayout;
+	m_cascadeCount = _cascadeCount;
+
+	ID3DBlob* pVertexShader = nullptr;
+	if (!ShaderHotReload::CompileShader(_vertexShaderFile, "vs_5_0", &pVertexShader))
+	{
+		return false;
+	}
+	m_pPipelineState = BuildPipelineState(pVertexShader);
+	pVertexShader->Release();
+	if (m_pPipelineState == nullptr)
+	{
+		return false;
+	}
+
+	// typeless so the lighting can read it back as R32_FLOAT
+	D3D12_CLEAR_VALUE clearValue = {};
+	clearValue.Format = DXGI_FORMAT_D32_FLOAT;
+	clearValue.DepthStencil.Depth = 1.0f;
+	HRESULT hr = _pDevice->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R32_TYPELESS, _resolution, _resolution, static_cast<UINT16>(_cascadeCount), 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL),
+		D3D12_RESOURCE_STATE_DEPTH_WRITE,
+		&clearValue,
+		IID_PPV_ARGS(&m_pShadowMap));
+	if (FAILED(hr))
+	{
+		return false;
+	}
+	m_pShadowMap->SetName(L"Shadow Map Resource Heap");
+
+	D3D12_DESCRIPTOR_HEAP_DESC heapDesc = {};
+	heapDesc.NumDescriptors = _cascadeCount;
+	heapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_DSV;
+	heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+	hr = _pDevice->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(&m_pDSDescriptorHeap));
+	if (FAILED(hr))
+	{
+		return false;
+	}
+	m_dsvDescriptorSize = _pDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_DSV);
+
+	for (UINT cascade = 0; cascade < _cascadeCount; ++cascade)
+	{
+		D3D12_DEPTH_STENCIL_VIEW_DESC dsvDesc = {};
+		dsvDesc.Format = DXGI_FORMAT_D32_FLOAT;
+		dsvDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2DARRAY;
+		dsvDesc.Texture2DArray.FirstArraySlice = cascade;
+		dsvDesc.Texture2DArray.ArraySize = 1;
+		_pDevice->CreateDepthStencilView(m_pShadowMap, &dsvDesc, CD3DX12_CPU_DESCRIPTOR_HANDLE(m_pDSDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), cascade, m_dsvDescriptorSize));
+	}
+
+	// one allocator per cascade per frame, so a cascade can be recorded while the gpu is still drawing older frames
+	for (UINT frame = 0; frame < _frameCount; ++frame)
+	{
+		for (UINT cascade = 0; cascade < _cascadeCount; ++cascade)
+		{
+			hr = _pDevice->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&m_pCommandAllocators[frame][cascade]));
+			if (FAILED(hr))
+			{
+				return false;
+			}
+		}
+	}
+	for (UINT cascade = 0; cascade < _cascadeCount; ++cascade)
+	{
+		hr = _pDevice->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, m_pCommandAllocators[0][cascade], m_pPipelineState, IID_PPV_ARGS(&m_pCommandLists[cascade]));
+		if (FAILED(hr))
+		{
+			return false;
+		}
+		m_pCommandLists[cascade]->Close(); // Record resets it
+	}
+
+	// a constant buffer view has to be a multiple of 256 bytes
+	UINT64 constantsSize = (sizeof(ShadowMapConstants) + 255) & ~static_cast<UINT64>(255);
+	for (UINT frame = 0; frame < _frameCount; ++frame)
+	{
+		hr = _pDevice->CreateCommittedResource(
+			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+			D3D12_HEAP_FLAG_NONE,
+			&CD3DX12_RESOURCE_DESC::Buffer(constantsSize),
+			D3D12_RESOURCE_STATE_GENERIC_READ,
+			nullptr,
+			IID_PPV_ARGS(&m_pConstantBuffer[frame]));
+		if (FAILED(hr))
+		{
+			return false;
+		}
+		m_pConstantBuffer[frame]->SetName(L"Shadow Map Constants Upload Resource Heap");
+
+		CD3DX12_RANGE readRange(0, 0); // we never read it on the cpu
+		hr = m_pConstantBuffer[frame]->Map(0, &readRange, reinterpret_cast<void**>(&m_pConstantData[frame]));
+		if (FAILED(hr))
+		{
+			return false;
+		}
+		memset(m_pConstantData[frame], 0, sizeof(ShadowMapConstants));
+	}
+
+	m_viewport.Width = static_cast<FLOAT>(_resolution);
+	m_viewport.Height = static_cast<FLOAT>(_resolution);
+	m_viewport.MaxDepth = 1.0f;
+	m_scissorRect.right = _resolution;
+	m_scissorRect.bottom = _resolution;
+	return true;
+}
+
+ID3D12PipelineState* ShadowMapPass::BuildPipelineState(ID3DBlob* _pVertexShader)
+{
+	// depth only, so there is no pixel shader and no render target
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc = {};
+	psoDesc.InputLayout = m_inputLayout;
+	psoDesc.pRootSignature = m_pRootSignature;
+	psoDesc.VS.pShaderBytecode = _pVertexShader->GetBufferPointer();
+	psoDesc.VS.BytecodeLength = _pVertexShader->GetBufferSize();
+	psoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+	psoDesc.NumRenderTargets = 0;
+	psoDesc.DSVFormat = DXGI_FORMAT_D32_FLOAT;
+	psoDesc.SampleDesc.Count = 1;
+	psoDesc.SampleMask = 0xffffffff;
+	psoDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
+	psoDesc.DepthStencilState = CD3DX12_DEPTH_STENCIL_DESC(D3D12_DEFAULT);
+
+	// casters between the light and the cascade are clamped onto its near plane instead of clipped away.
+	// the bias pushes the stored depth back so surfaces do not shadow themselves
+	psoDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
+	psoDesc.RasterizerState.DepthClipEnable = FALSE;
+	psoDesc.RasterizerState.DepthBias = 1000;
+	psoDesc.RasterizerState.SlopeScaledDepthBias = 2.0f;
+
+	ID3D12PipelineState* pPipelineState = nullptr;
+	if (FAILED(m_pDevice->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&pPipelineState))))
+	{
+		return nullptr;
+	}
+	return pPipelineState;
+}
+
+ID3D12PipelineState* ShadowMapPass::SwapPipelineState(ID3D12PipelineState* _pPipelineState)
+{
+	ID3D12PipelineState* pOld = m_pPipelineState;
+	m_pPipelineState = _pPipelineState;
+	return pOld;
+}
+
+void ShadowMapPass::WriteView(ID3D12Device* _pDevice, D3D12_CPU_DESCRIPTOR_HANDLE _handle)
+{
+	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format = DXGI_FORMAT_R32_FLOAT;
+	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2DARRAY;
+	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	srvDesc.Texture2DArray.MipLevels = 1;
+	srvDesc.Texture2DArray.ArraySize = m_cascadeCount;
+	_pDevice->CreateShaderResourceView(m_pShadowMap, &srvDesc, _handle);
+}
+
+bool ShadowMapPass::Record(UINT _frameIndex, CascadedShadows& _shadows, const ShadowCaster* _casters, JobSystem* _pJobSystem)
+{
+	m_recordedLists = 0;
+	UINT cascadeCount = std::min(m_cascadeCount, _shadows.CascadeCount());
+
+	// nothing is shadowed unless every cascade is recorded
+	ShadowMapConstants* pConstants = reinterpret_cast<ShadowMapConstants*>(m_pConstantData[_frameIndex]);
+	pConstants->cascadeCount = 0;
+	bool failed[MAX_SHADOW_CASCADES] = {};
+
+	auto record = [&](unsigned int _begin, unsigned int _end)
+	{
+		for (unsigned int cascade = _begin; cascade < _end; ++cascade)
+		{
+			ID3D12GraphicsCommandList* pCommandList = m_pCommandLists[cascade];
+			if (FAILED(m_pCommandAllocators[_frameIndex][cascade]->Reset()) ||
+				FAILED(pCommandList->Reset(m_pCommandAllocators[_frameIndex][cascade], m_pPipelineState)))
+			{
+				failed[cascade] = true;
+				continue;
+			}
+
+			GraphicsCommandRecorder& recorder = m_recorders[cascade];
+			recorder.Begin(pCommandList, m_pPipelineState);
+
+			CD3DX12_CPU_DESCRIPTOR_HANDLE dsvHandle(m_pDSDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), cascade, m_dsvDescriptorSize);
+			recorder.OMSetRenderTargets(0, nullptr, FALSE, &dsvHandle);
+			recorder.ClearDepthStencilView(dsvHandle, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0);
+			recorder.RSSetViewport(m_viewport);
+			recorder.RSSetScissorRect(m_scissorRect);
+			recorder.SetGraphicsRootSignature(m_pRootSignature);
+			recorder.IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+			// root constants are copied when they are set, so the matrix can live on the stack
+			XMMATRIX viewProj = XMLoadFloat4x4(&_shadows.Cascade(cascade).viewProj);
+			for (uint32_t caster : _shadows.Casters(cascade))
+			{
+				const ShadowCaster& shadowCaster = _casters[caster];
+				XMFLOAT4X4 wvp;
+				XMStoreFloat4x4(&wvp, XMMatrixTranspose(XMLoadFloat4x4(&shadowCaster.world) * viewProj));
+				recorder.IASetVertexBuffer(*shadowCaster.pVertexBufferView);
+				recorder.IASetIndexBuffer(*shadowCaster.pIndexBufferView);
+				recorder.SetGraphicsRoot32BitConstants(m_rootParamPerObject, sizeof(wvp) / sizeof(UINT), &wvp, 0);
+				recorder.DrawIndexedInstanced(shadowCaster.indexCount, 1, shadowCaster.startIndex, 0, 0);
+			}
+
+			recorder.End();
+			failed[cascade] = FAILED(pCommandList->Close());
+		}
+	};
+	if (_pJobSystem && cascadeCount > 1)
+		_pJobSystem->ParallelFor(cascadeCount, 1, record);
+	else
+		record(0, cascadeCount);
+
+	for (UINT cascade = 0; cascade < cascadeCount; ++cascade)
+	{
+		if (failed[cascade])
+			return false;
+	}
+	for (UINT cascade = 0; cascade < cascadeCount; ++cascade)
+	{
+		const ShadowCascade& shadowCascade = _shadows.Cascade(cascade);
+		XMStoreFloat4x4(&pConstants->cascadeViewProj[cascade], XMMatrixTranspose(XMLoadFloat4x4(&shadowCascade.viewProj)));
+		pConstants->splitFar[cascade] = shadowCascade.splitFar;
+	}
+	pConstants->texelSize = 1.0f / m_viewport.Width;
+	pConstants->cascadeCount = cascadeCount;
+	m_recordedLists = cascadeCount;
+	return true;
+}
+
+void ShadowMapPass::Bind(GraphicsCommandRecorder& _recorder, UINT _frameIndex, D3D12_GPU_DESCRIPTOR_HANDLE _view)
+{
+	_recorder.SetGraphicsRootConstantBufferView(m_rootConstants, m_pConstantBuffer[_frameIndex]->GetGPUVirtualAddress());
+	_recorder.SetGraphicsRootDescriptorTable(m_rootShadowMap, _view);
+}
+
+void ShadowMapPass::Release()
+{
+	for (UINT frame = 0; frame < MAX_FRAMES; ++frame)
+	{
+		if (m_pConstantBuffer[frame])
+			m_pConstantBuffer[frame]->Release();
+		m_pConstantBuffer[frame] = nullptr;
+		m_pConstantData[frame] = nullptr;
+	}
+	for (UINT cascade = 0; cascade < MAX_SHADOW_CASCADES; ++cascade)
+	{
+		if (m_pCommandLists[cascade])
+			m_pCommandLists[cascade]->Release();
+		m_pCommandLists[cascade] = nullptr;
+		for (UINT frame = 0; frame < MAX_FRAMES; ++frame)
+		{
+			if (m_pCommandAllocators[frame][cascade])
+				m_pCommandAllocators[frame][cascade]->Release();
+			m_pCommandAllocators[frame][cascade] = nullptr;
+		}
+	}
+	if (m_pDSDescriptorHeap)
+		m_pDSDescriptorHeap->Release();
+	m_pDSDescriptorHeap = nullptr;
+	if (m_pShadowMap)
+		m_pShadowMap->Release();
+	m_pShadowMap = nullptr;
+	if (m_pPipelineState)
+		m_pPipelineState->Release();
+	m_pPipelineState = nullptr;
+	m_pRootSignature = nullptr;
+	m_pDevice = nullptr;
+	m_recordedLists = 0;
+}
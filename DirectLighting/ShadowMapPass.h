@@ -0,0 +1,103 @@
+#pragma once
+#include <Windows.h>
+#include <D3d12.h>
+#include <DirectXMath.h>
+
+#include <string>
+
+#include "CascadedShadows.h"
+#include "CommandRecorder.h"
+#include "RootSignature.h"
+
+class JobSystem;
+
+// something that is drawn into the shadow maps. the mesh is drawn with the scene's vertex shader, which only needs
+// the world * view * projection matrix
+struct ShadowCaster
+{
+	DirectX::XMFLOAT4X4 world;
+	const D3D12_VERTEX_BUFFER_VIEW* pVertexBufferView;
+	const D3D12_INDEX_BUFFER_VIEW* pIndexBufferView;
+	UINT indexCount;
+	UINT startIndex;
+};
+
+// the scene pixel shader's view of the cascades, a constant buffer at b3 (see CascadedShadows.hlsli)
+struct ShadowMapConstants
+{
+	DirectX::XMFLOAT4X4 cascadeViewProj[MAX_SHADOW_CASCADES]; // transposed
+	float splitFar[MAX_SHADOW_CASCADES];
+	uint32_t cascadeCount; // 0 while the last Record failed, the shader then shadows nothing
+	float texelSize;
+	uint32_t pad[2];
+};
+
+// renders the cascades of a CascadedShadows into one slice each of a depth texture array. the cascades do not depend
+// on each other, so each is recorded into a command list of its own on the job system, and the frame graph's cascade
+// passes submit the lists ahead of the frame's main list. the shadow map is in the depth write state between frames,
+// the scene's pass reads it as a pixel shader resource through the view WriteView puts in the scene's heap
+class ShadowMapPass
+{
+public:
+	static const UINT MAX_FRAMES = 3;
+
+	ShadowMapPass() = default;
+	~ShadowMapPass() = default;
+
+	// the constants at b3, a table with the shadow map at t13 and the comparison sampler at s1, for the pixel shader
+	void AddRootParameters(RootSignatureDesc& _rootSignatureDesc);
+
+	// _pRootSignature and _rootParamPerObject are the scene's, so the scene's vertex shader can be used as it is
+	bool Init(ID3D12Device* _pDevice, ID3D12RootSignature* _pRootSignature, UINT _rootParamPerObject, const std::string& _vertexShaderFile,
+		const D3D12_INPUT_LAYOUT_DESC& _inputLayout, UINT _resolution, UINT _cascadeCount, UINT _frameCount);
+
+	// a depth only pso for _pVertexShader, the way Init makes its own. it only uses the device, so shader hot reload
+	// can call it from a worker
+	ID3D12PipelineState* BuildPipelineState(ID3DBlob* _pVertexShader);
+
+	// records with _pPipelineState from the next Record on. returns the old one, which the gpu may still be using
+	ID3D12PipelineState* SwapPipelineState(ID3D12PipelineState* _pPipelineState);
+
+	// the shadow map's srv, for a shader visible heap the scene's draws use
+	void WriteView(ID3D12Device* _pDevice, D3D12_CPU_DESCRIPTOR_HANDLE _handle);
+
+	// records every cascade's visible casters and writes the frame's constants. _casters is indexed the same as the
+	// spheres given to the CascadedShadows. the frame's allocators have to be free, so call it after waiting for the frame
+	bool Record(UINT _frameIndex, CascadedShadows& _shadows, const ShadowCaster* _casters, JobSystem* _pJobSystem);
+
+	// the lists recorded by the last successful Record, in cascade order
+	UINT CommandListCount() { return m_recordedLists; }
+	ID3D12CommandList* CommandList(UINT _cascade) { return m_pCommandLists[_cascade]; }
+
+	ID3D12Resource* ShadowMap() { return m_pShadowMap; } // R32_TYPELESS, one array slice per cascade
+
+	// _view is where WriteView wrote the shadow map's srv, the heap it is in has to be set already
+	void Bind(GraphicsCommandRecorder& _recorder, UINT _frameIndex, D3D12_GPU_DESCRIPTOR_HANDLE _view);
+
+	void Release();
+
+private:
+	ID3D12Device* m_pDevice = nullptr;
+	ID3D12PipelineState* m_pPipelineState = nullptr;
+	ID3D12RootSignature* m_pRootSignature = nullptr; // the scene's, owned by the root signature cache
+	D3D12_INPUT_LAYOUT_DESC m_inputLayout = {}; // the scene's, its elements have to outlive the pass
+	UINT m_rootParamPerObject = 0;
+
+	ID3D12Resource* m_pShadowMap = nullptr;
+	ID3D12DescriptorHeap* m_pDSDescriptorHeap = nullptr; // one dsv per cascade
+	UINT m_dsvDescriptorSize = 0;
+
+	ID3D12CommandAllocator* m_pCommandAllocators[MAX_FRAMES][MAX_SHADOW_CASCADES] = {};
+	ID3D12GraphicsCommandList* m_pCommandLists[MAX_SHADOW_CASCADES] = {};
+	GraphicsCommandRecorder m_recorders[MAX_SHADOW_CASCADES];
+	UINT m_cascadeCount = 0;
+	UINT m_recordedLists = 0;
+
+	ID3D12Resource* m_pConstantBuffer[MAX_FRAMES] = {};
+	UINT8* m_pConstantData[MAX_FRAMES] = {}; // mapped for as long as the buffers live
+	UINT m_rootConstants = 0;
+	UINT m_rootShadowMap = 0;
+
+	D3D12_VIEWPORT m_viewport = {};
+	D3D12_RECT m_scissorRect = {};
+};
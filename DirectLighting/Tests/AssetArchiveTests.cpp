@@ -0,0 +1,203 @@
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "AssetArchive.h"
+#include "Check.h"
+#include "JobSystem.h"
+#include "LzCodec.h"
+
+// LzCodec round trips on data that compresses and data that does not, and fails on anything damaged or cut short.
+// AssetArchive packs a handful of files, finds and reads them back, hands out stored ones straight from the mapping,
+// and refuses archives that have been damaged
+namespace
+{
+	const uint32_t BLOCK_SIZE = 4096; // small, so the bigger assets span many blocks
+
+	std::vector<uint8_t> ReadFile(const std::string& _fileName)
+	{
+		std::ifstream file(_fileName, std::ios::binary);
+		return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+
+	void WriteFile(const std::string& _fileName, const std::vector<uint8_t>& _bytes)
+	{
+		std::ofstream file(_fileName, std::ios::binary);
+		file.write(reinterpret_cast<const char*>(_bytes.data()), _bytes.size());
+	}
+
+	// text that repeats with small changes, the way an obj or a shader does
+	std::vector<uint8_t> MakeText(size_t _size)
+	{
+		std::string text;
+		for (uint32_t line = 0; text.size() < _size; ++line)
+			text += "v " + std::to_string(line % 97) + ".5 " + std::to_string(line % 13) + " -1.25\n";
+		return std::vector<uint8_t>(text.begin(), text.begin() + _size);
+	}
+
+	std::vector<uint8_t> MakeNoise(size_t _size, uint32_t _seed)
+	{
+		std::mt19937 random(_seed);
+		std::vector<uint8_t> bytes(_size);
+		for (uint8_t& byte : bytes)
+			byte = static_cast<uint8_t>(random());
+		return bytes;
+	}
+
+	bool RoundTrip(const std::vector<uint8_t>& _data, size_t* _pCompressedSize = nullptr)
+	{
+		std::vector<uint8_t> compressed(LzCodec::MaxCompressedSize(_data.size()));
+		size_t size = LzCodec::Compress(_data.data(), _data.size(), compressed.data());
+		if (_pCompressedSize)
+			*_pCompressedSize = size;
+		std::vector<uint8_t> decompressed(_data.size());
+		return size <= compressed.size() && LzCodec::Decompress(compressed.data(), size, decompressed.data(), decompressed.size()) &&
+			decompressed == _data;
+	}
+
+	void TestLzCodec()
+	{
+		// nothing, less than a match, runs that overlap their own output and lengths that need extra bytes
+		CHECK(RoundTrip({}));
+		CHECK(RoundTrip({ 1, 2, 3 }));
+		CHECK(RoundTrip(std::vector<uint8_t>(100000, 7)));
+		std::vector<uint8_t> pattern;
+		for (uint32_t i = 0; i < 5000; ++i)
+			pattern.push_back(static_cast<uint8_t>(i % 3 == 0 ? i : i % 5));
+		CHECK(RoundTrip(pattern));
+
+		// text shrinks to well under half, noise grows by no more than MaxCompressedSize allows
+		size_t compressedSize = 0;
+		std::vector<uint8_t> text = MakeText(200000);
+		CHECK(RoundTrip(text, &compressedSize) && compressedSize < text.size() / 2);
+		std::vector<uint8_t> noise = MakeNoise(200000, 1);
+		CHECK(RoundTrip(noise, &compressedSize) && compressedSize > noise.size());
+
+		// matches further back than a distance can reach are not used
+		std::vector<uint8_t> far = MakeNoise(LzCodec::MAX_DISTANCE + 1000, 2);
+		far.insert(far.end(), far.begin(), far.begin() + 1000);
+		CHECK(RoundTrip(far));
+
+		// a wrong size, a cut short stream and a distance back past the start all fail rather than read or write out
+		// of bounds
+		std::vector<uint8_t> compressed(LzCodec::MaxCompressedSize(text.size()));
+		compressed.resize(LzCodec::Compress(text.data(), text.size(), compressed.data()));
+		std::vector<uint8_t> out(text.size() + 1);
+		CHECK(!LzCodec::Decompress(compressed.data(), compressed.size(), out.data(), text.size() - 1));
+		CHECK(!LzCodec::Decompress(compressed.data(), compressed.size(), out.data(), text.size() + 1));
+		CHECK(!LzCodec::Decompress(compressed.data(), compressed.size() / 2, out.data(), text.size()));
+		const uint8_t badDistance[] = { 0x10, 'a', 0x10, 0x00 };
+		CHECK(!LzCodec::Decompress(badDistance, sizeof(badDistance), out.data(), 5));
+	}
+
+	void TestArchive(JobSystem& _jobSystem)
+	{
+		// text that compresses across many blocks, noise that is stored, an asset a block long to the byte, an empty
+		// one and a small one. named with a folder, so '\' can find them too
+		std::vector<std::string> files = { "./text.obj", "./noise.tex", "./block.bin", "./empty.bin", "./small.txt" };
+		std::vector<std::vector<uint8_t>> contents = { MakeText(100000), MakeNoise(50000, 3), MakeText(BLOCK_SIZE), {}, MakeText(10) };
+		for (size_t i = 0; i < files.size(); ++i)
+			WriteFile(files[i], contents[i]);
+
+		AssetPackDesc desc;
+		desc.blockSize = BLOCK_SIZE;
+		AssetPackStats stats;
+		CHECK(AssetArchive::Pack(files, "assets.pack", desc, &_jobSystem, &stats));
+		CHECK(stats.assetCount == 5 && stats.size == 100000 + 50000 + BLOCK_SIZE + 10);
+		CHECK(stats.packedSize < stats.size && stats.packedSize == ReadFile("assets.pack").size());
+
+		// the same with or without the job system
+		CHECK(AssetArchive::Pack(files, "assets1.pack", desc));
+		CHECK(ReadFile("assets1.pack") == ReadFile("assets.pack"));
+
+		AssetArchive archive;
+		CHECK(archive.Open("assets.pack"));
+		if (!archive.IsOpen())
+			return;
+		CHECK(archive.AssetCount() == 5);
+		CHECK(archive.Find("./missing.bin") == AssetArchive::INVALID_ASSET && archive.Find("text.obj") == AssetArchive::INVALID_ASSET);
+		std::vector<uint32_t> assets;
+		for (size_t i = 0; i < files.size(); ++i)
+		{
+			uint32_t asset = archive.Find(files[i]);
+			CHECK(asset != AssetArchive::INVALID_ASSET && archive.Find(".\\" + files[i].substr(2)) == asset);
+			if (asset == AssetArchive::INVALID_ASSET)
+				return;
+			CHECK(archive.Name(asset) == files[i] && archive.Entry(asset).size == contents[i].size());
+			assets.push_back(asset);
+
+			std::vector<uint8_t> data;
+			CHECK(archive.Read(asset, data) && data == contents[i]);
+			CHECK(archive.Read(asset, data, &_jobSystem) && data == contents[i]);
+		}
+
+		// noise is kept as it is and can be used in place, text cannot
+		CHECK((archive.Entry(assets[1]).flags & AssetArchive::ASSET_STORED) != 0);
+		const uint8_t* pNoise = archive.Data(assets[1]);
+		CHECK(pNoise && reinterpret_cast<uintptr_t>(pNoise) % AssetArchive::DATA_ALIGNMENT == 0);
+		CHECK(pNoise && memcmp(pNoise, contents[1].data(), contents[1].size()) == 0);
+		CHECK(archive.Data(assets[0]) == nullptr && archive.Entry(assets[0]).blockCount == (100000 + BLOCK_SIZE - 1) / BLOCK_SIZE);
+		CHECK(archive.Entry(assets[2]).blockCount == 1 && archive.Entry(assets[3]).blockCount == 0);
+		CHECK(stats.storedCount == 3); // the noise, the empty asset and the small one, too short to compress
+
+		std::vector<std::vector<uint8_t>> many;
+		CHECK(archive.ReadMany(assets.data(), static_cast<uint32_t>(assets.size()), many, &_jobSystem) && many == contents);
+		archive.Close();
+
+		// without compression everything is stored
+		desc.compress = false;
+		CHECK(AssetArchive::Pack(files, "stored.pack", desc, &_jobSystem, &stats));
+		CHECK(stats.storedCount == 5 && archive.Open("stored.pack") && archive.Data(archive.Find(files[0])) != nullptr);
+		archive.Close();
+
+		// a name given twice, a missing file or no block size is not packed
+		CHECK(!AssetArchive::Pack({ "./text.obj", "./text.obj" }, "bad.pack", AssetPackDesc()));
+		CHECK(!AssetArchive::Pack({ "./missing.bin" }, "bad.pack", AssetPackDesc()));
+		desc.blockSize = 0;
+		CHECK(!AssetArchive::Pack(files, "bad.pack", desc));
+	}
+
+	void TestDamage()
+	{
+		AssetPackDesc desc;
+		desc.blockSize = BLOCK_SIZE;
+		desc.compress = false;
+		CHECK(AssetArchive::Pack({ "./text.obj" }, "text.pack", desc));
+		std::vector<uint8_t> bytes = ReadFile("text.pack");
+		AssetArchive archive;
+		CHECK(!archive.Open("missing.pack"));
+
+		// truncated, or a table changed, fails to open
+		WriteFile("damaged.pack", std::vector<uint8_t>(bytes.begin(), bytes.end() - 1));
+		CHECK(!archive.Open("damaged.pack"));
+		std::vector<uint8_t> damaged = bytes;
+		damaged[sizeof(AssetArchiveHeader) + offsetof(AssetArchiveEntry, size)] ^= 1;
+		WriteFile("damaged.pack", damaged);
+		CHECK(!archive.Open("damaged.pack"));
+
+		// a changed byte in the last block opens, then fails to read, unless checksums are skipped
+		damaged = bytes;
+		damaged[damaged.size() - 1] ^= 0x80;
+		WriteFile("damaged.pack", damaged);
+		CHECK(archive.Open("damaged.pack"));
+		std::vector<uint8_t> data;
+		CHECK(!archive.Read(0, data));
+		archive.Close();
+		CHECK(archive.Open("damaged.pack", false));
+		CHECK(archive.Read(0, data) && data != ReadFile("./text.obj"));
+	}
+}
+
+int main()
+{
+	JobSystem jobSystem;
+	jobSystem.Init(3);
+
+	TestLzCodec();
+	TestArchive(jobSystem);
+	TestDamage();
+	return CHECK_RESULT();
+}
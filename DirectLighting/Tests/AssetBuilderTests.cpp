@@ -0,0 +1,191 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "AssetBuilder.h"
+#include "Check.h"
+#include "JobSystem.h"
+
+// AssetBuilder over fake tools that count their runs: a first build makes everything, a second in a new builder finds it
+// all up to date from state.txt, an edit rebuilds only what it reaches, a deleted output or an input put back comes from
+// the cache, a failure skips what needs it, and a cycle or an unknown tool builds nothing
+namespace
+{
+	const char* CACHE_DIRECTORY = "AssetBuilderCache";
+
+	std::atomic<uint32_t> g_runs(0);
+
+	// keys include the tools' version, so a new one for each pass keeps what an earlier pass or run cached from counting
+	uint64_t g_version = static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+
+	std::string ReadFile(const std::string& _fileName)
+	{
+		std::ifstream file(_fileName, std::ios::binary);
+		return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+
+	bool WriteFile(const std::string& _fileName, const std::string& _contents)
+	{
+		std::ofstream file(_fileName, std::ios::binary);
+		file << _contents;
+		return static_cast<bool>(file);
+	}
+
+	// "cat" writes its inputs one after the other, "head" the first three bytes of its input and "fail" nothing
+	void AddTools(AssetBuilder& _builder)
+	{
+		_builder.AddTool("cat", g_version, [](const AssetBuildStep& _step, JobSystem*)
+		{
+			g_runs++;
+			std::string contents;
+			for (const std::string& input : _step.inputs)
+				contents += ReadFile(input);
+			return WriteFile(_step.output, contents);
+		});
+		_builder.AddTool("head", g_version, [](const AssetBuildStep& _step, JobSystem*)
+		{
+			g_runs++;
+			return WriteFile(_step.output, ReadFile(_step.inputs[0]).substr(0, 3));
+		});
+		_builder.AddTool("fail", g_version, [](const AssetBuildStep&, JobSystem*)
+		{
+			g_runs++;
+			return false;
+		});
+	}
+
+	// a fresh builder each time, as a new run of the tool would be, with two chains: Both.txt is made from Cat.txt,
+	// which is made from the first source, and from Head.txt, which is made from the second
+	bool Build(JobSystem* _pJobSystem, AssetBuilder& _builder, AssetBuildStats& _stats)
+	{
+		CHECK(_builder.Init(CACHE_DIRECTORY));
+		AddTools(_builder);
+		CHECK(_builder.AddStep({ "cat", "", "Cat.txt", { "SourceA.txt" } }));
+		CHECK(_builder.AddStep({ "head", "", "Head.txt", { "SourceB.txt" } }));
+		CHECK(_builder.AddStep({ "cat", "", "Both.txt", { "Cat.txt", "Head.txt" } }));
+		return _builder.Build(_pJobSystem, &_stats);
+	}
+
+	void TestIncremental(JobSystem* _pJobSystem)
+	{
+		// what an earlier run left behind must not make anything up to date
+		std::remove((std::string(CACHE_DIRECTORY) + "/state.txt").c_str());
+		g_version++;
+		WriteFile("SourceA.txt", "one");
+		WriteFile("SourceB.txt", "abcdef");
+		g_runs = 0;
+
+		AssetBuildStats stats;
+		{
+			AssetBuilder builder;
+			CHECK(Build(_pJobSystem, builder, stats));
+			CHECK(stats.stepCount == 3 && stats.built == 3 && stats.waveCount == 2 && g_runs == 3);
+			CHECK(ReadFile("Both.txt") == "oneabc");
+		}
+
+		// a second builder reads state.txt and finds nothing to do
+		{
+			AssetBuilder builder;
+			CHECK(Build(_pJobSystem, builder, stats));
+			CHECK(stats.upToDate == 3 && g_runs == 3);
+			for (uint32_t step = 0; step < 3; ++step)
+				CHECK(builder.Result(step) == ASSET_BUILD_UP_TO_DATE);
+		}
+
+		// an edit rebuilds its step and the steps after it
+		{
+			WriteFile("SourceA.txt", "two");
+			AssetBuilder builder;
+			CHECK(Build(_pJobSystem, builder, stats));
+			CHECK(builder.Result(0) == ASSET_BUILD_BUILT && builder.Result(1) == ASSET_BUILD_UP_TO_DATE && builder.Result(2) == ASSET_BUILD_BUILT);
+			CHECK(g_runs == 5 && ReadFile("Both.txt") == "twoabc");
+		}
+
+		// an edit that makes the same output stops there
+		{
+			WriteFile("SourceB.txt", "abcxyz");
+			AssetBuilder builder;
+			CHECK(Build(_pJobSystem, builder, stats));
+			CHECK(builder.Result(1) == ASSET_BUILD_BUILT && builder.Result(2) == ASSET_BUILD_UP_TO_DATE && g_runs == 6);
+		}
+
+		// a deleted output comes back from the cache, and what is made from it does not notice
+		{
+			std::remove("Cat.txt");
+			AssetBuilder builder;
+			CHECK(Build(_pJobSystem, builder, stats));
+			CHECK(builder.Result(0) == ASSET_BUILD_FROM_CACHE && builder.Result(2) == ASSET_BUILD_UP_TO_DATE);
+			CHECK(stats.fromCache == 1 && g_runs == 6 && ReadFile("Cat.txt") == "two");
+		}
+
+		// so does everything made from an input put back the way it was
+		{
+			WriteFile("SourceA.txt", "one");
+			AssetBuilder builder;
+			CHECK(Build(_pJobSystem, builder, stats));
+			CHECK(builder.Result(0) == ASSET_BUILD_FROM_CACHE && builder.Result(2) == ASSET_BUILD_FROM_CACHE);
+			CHECK(stats.fromCache == 2 && g_runs == 6 && ReadFile("Both.txt") == "oneabc");
+		}
+	}
+
+	void TestFailures(JobSystem* _pJobSystem)
+	{
+		AssetBuildStats stats;
+
+		// a failed tool and a missing source both fail, and skip what is made from them. the step beside them still builds
+		{
+			AssetBuilder builder;
+			CHECK(builder.Init(CACHE_DIRECTORY));
+			AddTools(builder);
+			CHECK(builder.AddStep({ "fail", "", "Failed.txt", { "SourceA.txt" } }));
+			CHECK(builder.AddStep({ "cat", "", "AfterFailed.txt", { "Failed.txt" } }));
+			CHECK(builder.AddStep({ "cat", "", "Missing.txt", { "NoSuchSource.txt" } }));
+			CHECK(builder.AddStep({ "cat", "", "AfterMissing.txt", { "Missing.txt", "SourceA.txt" } }));
+			CHECK(builder.AddStep({ "cat", "", "Fine.txt", { "SourceB.txt" } }));
+			CHECK(!builder.AddStep({ "cat", "", "Fine.txt", { "SourceA.txt" } }));
+			CHECK(!builder.Build(_pJobSystem, &stats));
+			CHECK(builder.Result(0) == ASSET_BUILD_FAILED && builder.Result(1) == ASSET_BUILD_SKIPPED);
+			CHECK(builder.Result(2) == ASSET_BUILD_FAILED && builder.Result(3) == ASSET_BUILD_SKIPPED);
+			CHECK(builder.Result(4) == ASSET_BUILD_BUILT);
+			CHECK(stats.failed == 2 && stats.skipped == 2 && stats.built == 1);
+		}
+
+		// steps made from each other never run
+		{
+			AssetBuilder builder;
+			CHECK(builder.Init(CACHE_DIRECTORY));
+			AddTools(builder);
+			CHECK(builder.AddStep({ "cat", "", "CycleA.txt", { "CycleB.txt" } }));
+			CHECK(builder.AddStep({ "cat", "", "CycleB.txt", { "CycleA.txt" } }));
+			uint32_t runs = g_runs;
+			CHECK(!builder.Build(_pJobSystem, &stats));
+			CHECK(builder.Result(0) == ASSET_BUILD_PENDING && builder.Result(1) == ASSET_BUILD_PENDING && g_runs == runs);
+		}
+
+		// nor does anything when a tool is unknown
+		{
+			AssetBuilder builder;
+			CHECK(builder.Init(CACHE_DIRECTORY));
+			AddTools(builder);
+			CHECK(builder.AddStep({ "cat", "", "Known.txt", { "SourceA.txt" } }));
+			CHECK(builder.AddStep({ "unknown", "", "Unknown.txt", { "SourceA.txt" } }));
+			uint32_t runs = g_runs;
+			CHECK(!builder.Build(_pJobSystem, &stats) && g_runs == runs);
+		}
+	}
+}
+
+int main()
+{
+	JobSystem jobSystem;
+	jobSystem.Init(3);
+	for (JobSystem* pJobSystem : { static_cast<JobSystem*>(nullptr), &jobSystem })
+	{
+		TestIncremental(pJobSystem);
+		TestFailures(pJobSystem);
+	}
+	return CHECK_RESULT();
+}
@@ -0,0 +1,224 @@
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "CascadedShadows.h"
+#include "Check.h"
+#include "JobSystem.h"
+
+using namespace DirectX;
+
+namespace
+{
+	const float NEAR_Z = 0.1f;
+	const float FAR_Z = 1000.0f;
+	const float MAX_DISTANCE = 200.0f;
+
+	XMFLOAT4X4 Projection()
+	{
+		XMFLOAT4X4 proj;
+		XMStoreFloat4x4(&proj, XMMatrixPerspectiveFovLH(45.0f * (3.14159f / 180.0f), 1920.0f / 1080.0f, NEAR_Z, FAR_Z));
+		return proj;
+	}
+
+	XMFLOAT4X4 View(float _x, float _z, float _yaw)
+	{
+		XMFLOAT4X4 view;
+		XMVECTOR eye = XMVectorSet(_x, 2.0f, _z, 1.0f);
+		XMStoreFloat4x4(&view, XMMatrixLookToLH(eye, XMVectorSet(std::sin(_yaw), -0.3f, std::cos(_yaw), 0.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)));
+		return view;
+	}
+
+	void TestSplits()
+	{
+		float even[5], logarithmic[5], blended[5];
+		CascadedShadows::ComputeSplits(1.0f, 81.0f, 4, 0.0f, even);
+		CascadedShadows::ComputeSplits(1.0f, 81.0f, 4, 1.0f, logarithmic);
+		CascadedShadows::ComputeSplits(1.0f, 81.0f, 4, 0.5f, blended);
+		for (uint32_t i = 0; i <= 4; ++i)
+		{
+			CHECK(std::abs(even[i] - (1.0f + 20.0f * i)) < 1e-4f);
+			CHECK(std::abs(logarithmic[i] - std::pow(3.0f, static_cast<float>(i))) < 1e-3f);
+			CHECK(std::abs(blended[i] - 0.5f * (even[i] + logarithmic[i])) < 1e-3f);
+		}
+		// whatever the blend, the ends are exact and the splits only go up
+		for (float lambda : { 0.0f, 0.25f, 0.75f, 1.0f })
+		{
+			float splits[MAX_SHADOW_CASCADES + 1];
+			CascadedShadows::ComputeSplits(NEAR_Z, MAX_DISTANCE, MAX_SHADOW_CASCADES, lambda, splits);
+			CHECK(splits[0] == NEAR_Z && splits[MAX_SHADOW_CASCADES] == MAX_DISTANCE);
+			for (uint32_t i = 0; i < MAX_SHADOW_CASCADES; ++i)
+				CHECK(splits[i] < splits[i + 1]);
+		}
+	}
+
+	// every cascade has to hold the whole slice of the view frustum it covers, the slices follow on from each other,
+	// and the world's origin always lands on a texel corner with a radius that does not change as the camera moves
+	void TestFit()
+	{
+		XMFLOAT4X4 proj = Projection();
+		ShadowCascadeDesc desc;
+		desc.maxDistance = MAX_DISTANCE;
+		CascadedShadows shadows;
+		shadows.Init(desc, proj);
+		CHECK(shadows.CascadeCount() == 4);
+
+		float radius[MAX_SHADOW_CASCADES] = {};
+		uint32_t uncovered = 0;
+		uint32_t offGrid = 0;
+		uint32_t resized = 0;
+		const XMFLOAT3 sun(0.3f, -1.0f, 0.4f);
+		for (uint32_t frame = 0; frame < 50; ++frame)
+		{
+			// the camera creeps forward a fraction of a texel at a time and turns
+			XMFLOAT4X4 view = View(0.013f * frame, -4.0f + 0.021f * frame, 0.05f * frame);
+			shadows.Update(view, sun);
+			XMMATRIX inverseView = XMMatrixInverse(nullptr, XMLoadFloat4x4(&view));
+
+			CHECK(shadows.Cascade(0).splitNear == NEAR_Z && shadows.Cascade(3).splitFar == MAX_DISTANCE);
+			for (uint32_t c = 0; c < shadows.CascadeCount(); ++c)
+			{
+				const ShadowCascade& cascade = shadows.Cascade(c);
+				if (c > 0)
+					CHECK(cascade.splitNear == shadows.Cascade(c - 1).splitFar);
+
+				XMMATRIX viewProj = XMLoadFloat4x4(&cascade.viewProj);
+				for (uint32_t corner = 0; corner < 8; ++corner)
+				{
+					float z = corner & 4 ? cascade.splitFar : cascade.splitNear;
+					float x = (corner & 1 ? 1.0f : -1.0f) * z / proj._11;
+					float y = (corner & 2 ? 1.0f : -1.0f) * z / proj._22;
+					XMFLOAT3 clip;
+					XMStoreFloat3(&clip, XMVector3TransformCoord(XMVector3TransformCoord(XMVectorSet(x, y, z, 1.0f), inverseView), viewProj));
+					if (std::abs(clip.x) > 1.0f + 1e-4f || std::abs(clip.y) > 1.0f + 1e-4f || clip.z < -1e-4f || clip.z > 1.0f + 1e-4f)
+						++uncovered;
+				}
+
+				XMFLOAT3 origin;
+				XMStoreFloat3(&origin, XMVector3TransformCoord(XMVectorZero(), viewProj));
+				float texelX = origin.x * 0.5f * shadows.Resolution();
+				float texelY = origin.y * 0.5f * shadows.Resolution();
+				if (std::abs(texelX - std::round(texelX)) > 0.01f || std::abs(texelY - std::round(texelY)) > 0.01f)
+					++offGrid;
+
+				if (frame == 0)
+					radius[c] = cascade.sphere.w;
+				else if (cascade.sphere.w != radius[c])
+					++resized;
+			}
+		}
+		CHECK(uncovered == 0);
+		CHECK(offGrid == 0);
+		CHECK(resized == 0);
+
+		// a light straight down needs another up vector, the fit still has to hold
+		shadows.Update(View(0.0f, -4.0f, 0.0f), XMFLOAT3(0.0f, -1.0f, 0.0f));
+		for (uint32_t c = 0; c < shadows.CascadeCount(); ++c)
+			CHECK(std::isfinite(shadows.Cascade(c).viewProj._11) && std::isfinite(shadows.Cascade(c).viewProj._44));
+	}
+
+	enum Verdict
+	{
+		VERDICT_OUT,
+		VERDICT_IN,
+		VERDICT_CLOSE // within rounding of a plane
+	};
+
+	// the sides and the far end of the cascade's box against the sphere, in double precision. the near end is left out
+	// like the cull leaves it out, the maps are drawn without depth clipping
+	Verdict BruteForce(const ShadowCascade& _cascade, const XMFLOAT4& _sphere)
+	{
+		if (_sphere.w < 0.0f)
+			return VERDICT_OUT;
+		const XMFLOAT4X4& m = _cascade.viewProj;
+		double x = _sphere.x * static_cast<double>(m._11) + _sphere.y * static_cast<double>(m._21) + _sphere.z * static_cast<double>(m._31) + m._41;
+		double y = _sphere.x * static_cast<double>(m._12) + _sphere.y * static_cast<double>(m._22) + _sphere.z * static_cast<double>(m._32) + m._42;
+		double z = _sphere.x * static_cast<double>(m._13) + _sphere.y * static_cast<double>(m._23) + _sphere.z * static_cast<double>(m._33) + m._43;
+		double slack[3] =
+		{
+			1.0 + _sphere.w * std::abs(static_cast<double>(_cascade.proj._11)) - std::abs(x),
+			1.0 + _sphere.w * std::abs(static_cast<double>(_cascade.proj._22)) - std::abs(y),
+			1.0 + _sphere.w * std::abs(static_cast<double>(_cascade.proj._33)) - z
+		};
+		Verdict verdict = VERDICT_IN;
+		for (double value : slack)
+		{
+			if (value < -1e-4)
+				return VERDICT_OUT;
+			if (value <= 1e-4)
+				verdict = VERDICT_CLOSE;
+		}
+		return verdict;
+	}
+
+	void TestCull(JobSystem& _jobSystem)
+	{
+		ShadowCascadeDesc desc;
+		desc.maxDistance = MAX_DISTANCE;
+		CascadedShadows shadows;
+		shadows.Init(desc, Projection());
+		shadows.Update(View(0.0f, -4.0f, 0.3f), XMFLOAT3(0.3f, -1.0f, 0.4f));
+
+		// casters over a wide flat area, a few of them with a negative radius, which never cast
+		std::mt19937 random(1);
+		std::uniform_real_distribution<float> spread(-300.0f, 300.0f);
+		std::uniform_real_distribution<float> radius(0.1f, 5.0f);
+		std::vector<XMFLOAT4> spheres(50003);
+		for (uint32_t i = 0; i < spheres.size(); ++i)
+			spheres[i] = XMFLOAT4(spread(random), spread(random) * 0.05f, spread(random), i % 97 == 0 ? -1.0f : radius(random));
+		uint32_t count = static_cast<uint32_t>(spheres.size());
+
+		shadows.SetCasters(spheres.data(), count);
+		shadows.Cull();
+		std::vector<uint32_t> serial[MAX_SHADOW_CASCADES];
+		for (uint32_t c = 0; c < shadows.CascadeCount(); ++c)
+			serial[c] = shadows.Casters(c);
+
+		// the blocks are stitched back in order, so the job system gives the same lists
+		shadows.SetCasters(spheres.data(), count, &_jobSystem);
+		shadows.Cull(&_jobSystem);
+		for (uint32_t c = 0; c < shadows.CascadeCount(); ++c)
+			CHECK(serial[c] == shadows.Casters(c));
+
+		uint32_t disagreements = 0;
+		uint32_t close = 0;
+		uint32_t inside = 0;
+		for (uint32_t c = 0; c < shadows.CascadeCount(); ++c)
+		{
+			const std::vector<uint32_t>& casters = shadows.Casters(c);
+			CHECK(std::is_sorted(casters.begin(), casters.end()));
+			std::vector<bool> culledIn(count, false);
+			for (uint32_t caster : casters)
+				culledIn[caster] = true;
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				Verdict verdict = BruteForce(shadows.Cascade(c), spheres[i]);
+				if (verdict == VERDICT_CLOSE)
+					++close;
+				else if ((verdict == VERDICT_IN) != culledIn[i])
+					++disagreements;
+				inside += verdict == VERDICT_IN ? 1 : 0;
+			}
+		}
+		CHECK(disagreements == 0);
+		CHECK(inside > 1000);
+		CHECK(close < inside / 100);
+
+		// no casters at all
+		shadows.SetCasters(nullptr, 0, &_jobSystem);
+		shadows.Cull(&_jobSystem);
+		for (uint32_t c = 0; c < shadows.CascadeCount(); ++c)
+			CHECK(shadows.Casters(c).empty());
+	}
+}
+
+int main()
+{
+	JobSystem jobSystem;
+	jobSystem.Init(3);
+	TestSplits();
+	TestFit();
+	TestCull(jobSystem);
+	return CHECK_RESULT();
+}
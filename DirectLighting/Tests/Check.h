@@ -0,0 +1,39 @@
+#pragma once
+#include <cstdio>
+
+// the tests are plain programs that ctest runs, one per module. CHECK prints the failing line and keeps going, so one
+// run shows everything that is broken, and CHECK_RESULT is what main returns
+namespace Check
+{
+	inline int& Failures()
+	{
+		static int failures = 0;
+		return failures;
+	}
+
+	inline int Result(const char* _name)
+	{
+		if (Failures() != 0)
+			printf("%s: %d checks failed\n", _name, Failures());
+		else
+			printf("%s: all checks passed\n", _name);
+		return Failures() != 0 ? 1 : 0;
+	}
+}
+
+#define CHECK(_condition) \
+	do \
+	{ \
+		if (!(_condition)) \
+		{ \
+			printf("%s(%d): failed: %s\n", __FILE__, __LINE__, #_condition); \
+			Check::Failures()++; \
+		} \
+	} while (0)
+
+#define CHECK_RESULT() Check::Result(__FILE__)
+
+// where the checked in images and meshes are, set by CMakeLists.txt
+#ifndef TEST_DATA_DIR
+#define TEST_DATA_DIR "Data/"
+#endif
@@ -0,0 +1,196 @@
+#include <cstring>
+
+#include "Check.h"
+#include "CommandRecorder.h"
+#include "RecordingCommandList.h"
+
+// what CommandRecorder lets through to the command list: redundant state dropped, everything else in order, and
+// transitions merged into as few ResourceBarrier calls as possible
+namespace
+{
+	typedef CommandRecorder<RecordingCommandList> Recorder;
+
+	ID3D12PipelineState g_pipelineStates[2];
+	ID3D12RootSignature g_rootSignatures[2];
+	ID3D12Resource g_resources[3];
+	ID3D12CommandSignature g_commandSignature;
+
+	void TestRedundantState()
+	{
+		RecordingCommandList list;
+		Recorder recorder;
+		recorder.Begin(&list, &g_pipelineStates[0]);
+
+		D3D12_VIEWPORT viewport = { 0.0f, 0.0f, 1280.0f, 720.0f, 0.0f, 1.0f };
+		D3D12_RECT scissorRect = { 0, 0, 1280, 720 };
+		D3D12_VERTEX_BUFFER_VIEW vertexBuffer = { 0x1000, 256, 16 };
+		D3D12_INDEX_BUFFER_VIEW indexBuffer = { 0x2000, 72, DXGI_FORMAT_R16_UINT };
+		UINT constants[16] = {};
+		for (int draw = 0; draw < 3; ++draw)
+		{
+			// the initial pso is already bound after a reset
+			recorder.SetPipelineState(&g_pipelineStates[0]);
+			recorder.SetGraphicsRootSignature(&g_rootSignatures[0]);
+			recorder.RSSetViewport(viewport);
+			recorder.RSSetScissorRect(scissorRect);
+			recorder.IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+			recorder.IASetVertexBuffer(vertexBuffer);
+			recorder.IASetIndexBuffer(indexBuffer);
+			constants[0] = draw == 2 ? 1 : 0;
+			recorder.SetGraphicsRoot32BitConstants(0, 16, constants, 0);
+			recorder.SetGraphicsRootConstantBufferView(1, 0x3000);
+			recorder.DrawIndexedInstanced(36, 1, 0, 0, 0);
+		}
+		const CommandStats& stats = recorder.End();
+
+		// three draws, but the state once. the constants change for the last draw so they go again
+		CHECK(list.Count("pso") == 0);
+		CHECK(list.Count("root signature") == 1 && list.Count("viewports") == 1 && list.Count("scissor rects") == 1);
+		CHECK(list.Count("topology") == 1 && list.Count("vertex buffers") == 1 && list.Count("index buffer") == 1);
+		CHECK(list.Count("constants") == 2 && list.Count("cbv") == 1 && list.Count("draw") == 3);
+		CHECK(stats.issued == 9 && stats.skipped == 3 * 9 - 9);
+
+		// a new root signature throws the root arguments away, so they are set again even though they are the same
+		recorder.SetGraphicsRootSignature(&g_rootSignatures[1]);
+		recorder.SetGraphicsRoot32BitConstants(0, 16, constants, 0);
+		recorder.SetGraphicsRootConstantBufferView(1, 0x3000);
+		CHECK(list.Count("constants") == 3 && list.Count("cbv") == 2);
+
+		// a different pso goes through, and so does a different vertex buffer
+		recorder.SetPipelineState(&g_pipelineStates[1]);
+		vertexBuffer.BufferLocation = 0x4000;
+		recorder.IASetVertexBuffer(vertexBuffer);
+		CHECK(list.Count("pso") == 1 && list.Count("vertex buffers") == 2);
+	}
+
+	void TestRootArguments()
+	{
+		RecordingCommandList list;
+		Recorder recorder;
+		recorder.Begin(&list, &g_pipelineStates[0]);
+		recorder.SetGraphicsRootSignature(&g_rootSignatures[0]);
+
+		UINT constants[16] = { 1, 2, 3, 4 };
+		recorder.SetGraphicsRoot32BitConstants(0, 16, constants, 0);
+
+		// constants at an offset are not tracked. they change what is in the slot, so the same first block has to be
+		// set again afterwards rather than be dropped as a repeat
+		UINT tail[4] = { 9, 9, 9, 9 };
+		recorder.SetGraphicsRoot32BitConstants(0, 4, tail, 12);
+		recorder.SetGraphicsRoot32BitConstants(0, 16, constants, 0);
+		CHECK(list.Count("constants 0 16 @0") == 2 && list.Count("constants 0 4 @12") == 1);
+
+		// so are too many constants for one slot
+		UINT many[Recorder::MAX_ROOT_CONSTANTS + 1] = {};
+		recorder.SetGraphicsRoot32BitConstants(0, Recorder::MAX_ROOT_CONSTANTS + 1, many, 0);
+		recorder.SetGraphicsRoot32BitConstants(0, 16, constants, 0);
+		CHECK(list.Count("constants 0 16 @0") == 3);
+
+		// slots past MAX_ROOT_PARAMETERS always go through
+		recorder.SetGraphicsRoot32BitConstants(Recorder::MAX_ROOT_PARAMETERS, 16, constants, 0);
+		recorder.SetGraphicsRoot32BitConstants(Recorder::MAX_ROOT_PARAMETERS, 16, constants, 0);
+		CHECK(list.Count("constants 16 16 @0") == 2);
+
+		// a descriptor in a slot that held constants is a change, and the other way round
+		recorder.SetGraphicsRootShaderResourceView(0, 0x5000);
+		recorder.SetGraphicsRoot32BitConstants(0, 16, constants, 0);
+		CHECK(list.Count("srv 0") == 1 && list.Count("constants 0 16 @0") == 4);
+
+		D3D12_GPU_DESCRIPTOR_HANDLE table = { 0x6000 };
+		recorder.SetGraphicsRootDescriptorTable(2, table);
+		recorder.SetGraphicsRootDescriptorTable(2, table);
+		CHECK(list.Count("table 2") == 1);
+
+		// the indirect records overwrite the root constants, so nothing bound before counts after
+		recorder.ExecuteIndirect(&g_commandSignature, 8, &g_resources[0], 0);
+		recorder.SetGraphicsRoot32BitConstants(0, 16, constants, 0);
+		recorder.SetGraphicsRootDescriptorTable(2, table);
+		CHECK(list.Count("constants 0 16 @0") == 5 && list.Count("table 2") == 2);
+		recorder.End();
+	}
+
+	void TestBarriers()
+	{
+		RecordingCommandList list;
+		Recorder recorder;
+		recorder.Begin(&list, &g_pipelineStates[0]);
+		ID3D12Resource* pBackBuffer = &g_resources[0];
+		ID3D12Resource* pBuffer = &g_resources[1];
+		ID3D12Resource* pShadowMap = &g_resources[2];
+
+		// A->B then B->C is A->C, A->B then B->A is nothing, and A->A was never needed
+		recorder.Transition(pBackBuffer, D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_COPY_DEST);
+		recorder.Transition(pBackBuffer, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_RENDER_TARGET);
+		recorder.Transition(pBuffer, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_GENERIC_READ);
+		recorder.Transition(pBuffer, D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_COPY_DEST);
+		recorder.Transition(pShadowMap, D3D12_RESOURCE_STATE_DEPTH_WRITE, D3D12_RESOURCE_STATE_DEPTH_WRITE);
+		recorder.Transition(pShadowMap, D3D12_RESOURCE_STATE_DEPTH_WRITE, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, 1);
+		CHECK(list.calls.empty());
+
+		// nothing is sent until a command needs it, then it all goes in one call
+		D3D12_CPU_DESCRIPTOR_HANDLE renderTarget = { 0x10 };
+		FLOAT clearColour[4] = {};
+		recorder.ClearRenderTargetView(renderTarget, clearColour);
+		CHECK(list.calls.size() == 2 && list.calls[0] == "barriers 2" && list.calls[1] == "clear rtv 10");
+		if (list.barrierBatches.size() == 1 && list.barrierBatches[0].size() == 2)
+		{
+			const D3D12_RESOURCE_TRANSITION_BARRIER& backBuffer = list.barrierBatches[0][0].Transition;
+			CHECK(backBuffer.pResource == pBackBuffer && backBuffer.StateBefore == D3D12_RESOURCE_STATE_PRESENT &&
+				backBuffer.StateAfter == D3D12_RESOURCE_STATE_RENDER_TARGET && backBuffer.Subresource == D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES);
+			const D3D12_RESOURCE_TRANSITION_BARRIER& shadowMap = list.barrierBatches[0][1].Transition;
+			CHECK(shadowMap.pResource == pShadowMap && shadowMap.Subresource == 1);
+		}
+		else
+			CHECK(false);
+
+		// transitions of different subresources are not merged, aliasing and uav barriers are kept as they are
+		recorder.Transition(pShadowMap, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_DEPTH_WRITE, 1);
+		recorder.Transition(pShadowMap, D3D12_RESOURCE_STATE_DEPTH_WRITE, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, 2);
+		recorder.Aliasing(nullptr, pBuffer);
+		recorder.UAVBarrier(pBuffer);
+		recorder.DrawIndexedInstanced(3, 1, 0, 0, 0);
+		CHECK(list.barrierBatches.size() == 2 && list.barrierBatches.back().size() == 4);
+		if (list.barrierBatches.size() == 2 && list.barrierBatches.back().size() == 4)
+		{
+			CHECK(list.barrierBatches[1][2].Type == D3D12_RESOURCE_BARRIER_TYPE_ALIASING && list.barrierBatches[1][2].Aliasing.pResourceAfter == pBuffer);
+			CHECK(list.barrierBatches[1][3].Type == D3D12_RESOURCE_BARRIER_TYPE_UAV);
+		}
+
+		// a transition is not merged across an aliasing or uav barrier queued after it, either would then run on the
+		// resource in the wrong state. the ones on the far side merge with each other as before
+		recorder.Transition(pBuffer, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+		recorder.UAVBarrier(pBuffer);
+		recorder.Transition(pBuffer, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_DEST);
+		recorder.Transition(pShadowMap, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_DEPTH_WRITE, 2);
+		recorder.Aliasing(pShadowMap, pBackBuffer);
+		recorder.Transition(pShadowMap, D3D12_RESOURCE_STATE_DEPTH_WRITE, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, 2);
+		recorder.Transition(pBackBuffer, D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_COPY_SOURCE);
+		recorder.Transition(pBackBuffer, D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_RENDER_TARGET);
+		recorder.DrawIndexedInstanced(3, 1, 0, 0, 0);
+		CHECK(list.barrierBatches.size() == 3 && list.barrierBatches.back().size() == 6);
+		if (list.barrierBatches.size() == 3 && list.barrierBatches.back().size() == 6)
+		{
+			const std::vector<D3D12_RESOURCE_BARRIER>& batch = list.barrierBatches[2];
+			CHECK(batch[0].Transition.pResource == pBuffer && batch[0].Transition.StateAfter == D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+			CHECK(batch[1].Type == D3D12_RESOURCE_BARRIER_TYPE_UAV);
+			CHECK(batch[2].Transition.pResource == pBuffer && batch[2].Transition.StateBefore == D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+			CHECK(batch[3].Transition.pResource == pShadowMap && batch[3].Transition.StateAfter == D3D12_RESOURCE_STATE_DEPTH_WRITE);
+			CHECK(batch[4].Type == D3D12_RESOURCE_BARRIER_TYPE_ALIASING);
+			CHECK(batch[5].Transition.pResource == pShadowMap && batch[5].Transition.StateAfter == D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+		}
+
+		// anything still queued goes out at End
+		recorder.Transition(pBackBuffer, D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT);
+		const CommandStats& stats = recorder.End();
+		CHECK(list.calls.back() == "barriers 1");
+		CHECK(stats.barriersRequested == 19 && stats.barriersIssued == 13 && stats.barrierBatches == 4);
+	}
+}
+
+int main()
+{
+	TestRedundantState();
+	TestRootArguments();
+	TestBarriers();
+	return CHECK_RESULT();
+}
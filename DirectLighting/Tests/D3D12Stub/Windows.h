@@ -0,0 +1,12 @@
+#pragma once
+// the few windows types the d3d12 stand-in needs. only on the include path of the linux tests, see D3d12.h here
+#include <cstddef>
+#include <cstdint>
+
+typedef uint8_t UINT8;
+typedef uint32_t UINT;
+typedef uint64_t UINT64;
+typedef int32_t INT;
+typedef int32_t LONG;
+typedef int BOOL;
+typedef float FLOAT;
@@ -0,0 +1,121 @@
+# makes the test images in this folder and the rgba8 each should decode to (the .ref files). python 3, run it from here
+import zlib, struct, random, math
+random.seed(1)
+def chunk(t, d): return struct.pack('>I', len(d)) + t + d + struct.pack('>I', zlib.crc32(t+d) & 0xffffffff)
+def png(name, w, h, ct, bd, rows, plte=None, trns=None, level=6, filt=None):
+    raw=b''
+    for y,r in enumerate(rows):
+        f = filt if filt is not None else (y % 5)
+        # apply filter f
+        bpp = max(1, {0:1,2:3,3:1,4:2,6:4}[ct]*bd//8)
+        prev = rows[y-1] if y>0 else bytes(len(r))
+        out=bytearray()
+        for i,b in enumerate(r):
+            a = r[i-bpp] if i>=bpp else 0
+            u = prev[i]
+            c = prev[i-bpp] if i>=bpp else 0
+            if f==0: v=b
+            elif f==1: v=b-a
+            elif f==2: v=b-u
+            elif f==3: v=b-((a+u)>>1)
+            else:
+                p=a+u-c; pa=abs(p-a); pb=abs(p-u); pc=abs(p-c)
+                pr = a if pa<=pb and pa<=pc else (u if pb<=pc else c)
+                v=b-pr
+            out.append(v & 255)
+        raw += bytes([f]) + bytes(out)
+    d = b'\x89PNG\r\n\x1a\n' + chunk(b'IHDR', struct.pack('>IIBBBBB', w, h, bd, ct, 0, 0, 0))
+    if plte: d += chunk(b'PLTE', plte)
+    if trns: d += chunk(b'tRNS', trns)
+    z = zlib.compress(raw, level)
+    # split into two IDATs
+    d += chunk(b'IDAT', z[:len(z)//2]) + chunk(b'IDAT', z[len(z)//2:]) + chunk(b'IEND', b'')
+    open(name,'wb').write(d)
+    return raw
+
+def expected(name, w, h, px): open(name,'wb').write(bytes(px))
+
+W,H=37,23
+# rgba8
+rows=[]; px=[]
+for y in range(H):
+    r=bytearray()
+    for x in range(W):
+        c=[(x*7+y*3)&255, (x*x+y)&255, random.randrange(256), random.randrange(256)]
+        r+=bytes(c); px+=c
+    rows.append(bytes(r))
+png('rgba8.png',W,H,6,8,rows); expected('rgba8.ref',W,H,px)
+png('rgba8_l0.png',W,H,6,8,rows,level=0); 
+png('rgba8_l9.png',W,H,6,8,rows,level=9);
+# rgb16 with trns
+rows=[];px=[]
+key=(1000,2000,3000)
+for y in range(H):
+    r=bytearray()
+    for x in range(W):
+        c=[random.randrange(65536) for _ in range(3)]
+        if (x+y)%7==0: c=list(key)
+        r+=struct.pack('>HHH',*c); px+=[c[0]>>8,c[1]>>8,c[2]>>8, 0 if tuple(c)==key else 255]
+    rows.append(bytes(r))
+png('rgb16.png',W,H,2,16,rows,trns=struct.pack('>HHH',*key)); expected('rgb16.ref',W,H,px)
+# palette 4 bit
+pal=[(random.randrange(256),random.randrange(256),random.randrange(256)) for _ in range(16)]
+alph=[random.randrange(256) for _ in range(5)]
+rows=[];px=[]
+for y in range(H):
+    idx=[random.randrange(16) for _ in range(W)]
+    b=bytearray()
+    for i in range(0,W,2):
+        hi=idx[i]; lo=idx[i+1] if i+1<W else 0
+        b.append(hi<<4|lo)
+    rows.append(bytes(b))
+    for i in idx: px+=list(pal[i])+[alph[i] if i<5 else 255]
+png('pal4.png',W,H,3,4,rows,plte=b''.join(bytes(p) for p in pal),trns=bytes(alph)); expected('pal4.ref',W,H,px)
+# grey 1 bit
+rows=[];px=[]
+for y in range(H):
+    bits=[random.randrange(2) for _ in range(W)]
+    b=bytearray((W+7)//8)
+    for i,v in enumerate(bits): b[i//8]|=v<<(7-i%8)
+    rows.append(bytes(b)); 
+    for v in bits: px+=[v*255]*3+[255]
+png('grey1.png',W,H,0,1,rows); expected('grey1.ref',W,H,px)
+# grey alpha 8
+rows=[];px=[]
+for y in range(H):
+    b=bytearray()
+    for x in range(W):
+        g=random.randrange(256);a=random.randrange(256); b+=bytes([g,a]); px+=[g,g,g,a]
+    rows.append(bytes(b))
+png('ga8.png',W,H,4,8,rows); expected('ga8.ref',W,H,px)
+# tga rle bottom origin 24 bit, and 32 bit top origin uncompressed
+def tga(name, w, h, bpp, rle, top, px):
+    hdr=struct.pack('<BBBHHBHHHHBB',0,0,10 if rle else 2,0,0,0,0,0,w,h,bpp,(0x20 if top else 0)|(8 if bpp==32 else 0))
+    rowsl=[px[y*w*4:(y+1)*w*4] for y in range(h)]
+    if not top: rowsl=rowsl[::-1]
+    pixels=[]
+    for r in rowsl:
+        for x in range(w):
+            c=r[x*4:x*4+4]
+            pixels.append(bytes([c[2],c[1],c[0]]+([c[3]] if bpp==32 else [])))
+    data=b''
+    if not rle: data=b''.join(pixels)
+    else:
+        i=0
+        while i<len(pixels):
+            j=i
+            while j+1<len(pixels) and pixels[j+1]==pixels[i] and j-i<127: j+=1
+            if j>i: data+=bytes([0x80|(j-i)])+pixels[i]; i=j+1
+            else:
+                k=i
+                while k+1<len(pixels) and pixels[k+1]!=pixels[k] and k-i<127: k+=1
+                data+=bytes([k-i])+b''.join(pixels[i:k+1]); i=k+1
+    open(name,'wb').write(hdr+data)
+px=[]
+for y in range(H):
+    for x in range(W):
+        v=(x//4+y//3)%5*50
+        px+=[v,(v*3)&255,x*6&255,255]
+tga('rle24.tga',W,H,24,True,False,px); expected('rle24.ref',W,H,px)
+px2=[random.randrange(256) for _ in range(W*H*4)]
+tga('raw32.tga',W,H,32,False,True,px2); expected('raw32.ref',W,H,px2)
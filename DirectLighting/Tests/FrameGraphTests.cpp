@@ -0,0 +1,370 @@
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Check.h"
+#include "FrameGraph.h"
+
+// what FrameGraph::Compile works out: which passes are culled, where the transients go in the heap, and the barrier
+// batch in front of each pass
+namespace
+{
+	TransientDesc Target(uint64_t _size, uint64_t _alignment = 65536)
+	{
+		TransientDesc desc;
+		desc.sizeInBytes = _size;
+		desc.alignment = _alignment;
+		return desc;
+	}
+
+	bool SameBarrier(const FrameGraphBarrier& _barrier, FrameGraphBarrier::Type _type, uint32_t _resource, uint32_t _before = 0, uint32_t _after = 0)
+	{
+		return _barrier.type == _type && _barrier.resource == _resource && _barrier.before == _before && _barrier.after == _after;
+	}
+
+	// every pair of transients that are alive in the same live pass must not share memory, and a transient that shares
+	// memory with any other must say so with an aliasing barrier in front of its first pass, since the other one may
+	// have had it last, this frame or the one before
+	bool PlacementIsValid(FrameGraph& _graph, const std::vector<uint32_t>& _firstPass, const std::vector<uint32_t>& _lastPass)
+	{
+		for (uint32_t a = 0; a < _graph.ResourceCount(); ++a)
+		{
+			if (!_graph.IsTransient(a) || !_graph.IsUsed(a))
+				continue;
+			const TransientDesc& descA = _graph.Desc(a);
+			if (descA.alignment != 0 && _graph.HeapOffset(a) % descA.alignment != 0)
+				return false;
+			if (_graph.HeapOffset(a) + descA.sizeInBytes > _graph.HeapSize())
+				return false;
+
+			bool needsAliasing = false;
+			for (uint32_t b = 0; b < _graph.ResourceCount(); ++b)
+			{
+				if (a == b || !_graph.IsTransient(b) || !_graph.IsUsed(b))
+					continue;
+				const TransientDesc& descB = _graph.Desc(b);
+				bool overlaps = _graph.HeapOffset(a) < _graph.HeapOffset(b) + descB.sizeInBytes && _graph.HeapOffset(b) < _graph.HeapOffset(a) + descA.sizeInBytes;
+				bool livesTogether = _firstPass[a] <= _lastPass[b] && _firstPass[b] <= _lastPass[a];
+				if (overlaps && livesTogether)
+					return false;
+				if (overlaps)
+					needsAliasing = true;
+			}
+
+			const FrameGraphBarrier* pBarriers;
+			uint32_t count;
+			_graph.PassBarriers(_firstPass[a], &pBarriers, &count);
+			bool hasAliasing = false;
+			for (uint32_t i = 0; i < count; ++i)
+				hasAliasing |= SameBarrier(pBarriers[i], FrameGraphBarrier::TYPE_ALIASING, a);
+			if (hasAliasing != needsAliasing)
+				return false;
+		}
+		return true;
+	}
+
+	bool SharesMemory(FrameGraph& _graph, uint32_t _a, uint32_t _b)
+	{
+		return _a != _b && _graph.IsTransient(_b) && _graph.IsUsed(_b) && _graph.HeapOffset(_a) < _graph.HeapOffset(_b) + _graph.Desc(_b).sizeInBytes &&
+			_graph.HeapOffset(_b) < _graph.HeapOffset(_a) + _graph.Desc(_a).sizeInBytes;
+	}
+
+	// plays the frame's barriers twice in a row, as two frames would, keeping track of which transient owns each piece of
+	// memory. a transition is only allowed on a transient that owns all of its memory, and every transient has to be
+	// back in the state its first pass wants by the end of the frame
+	bool BarriersRespectAliasing(FrameGraph& _graph, uint32_t _passCount)
+	{
+		std::vector<bool> active(_graph.ResourceCount(), false);
+		std::vector<uint32_t> state(_graph.ResourceCount(), 0);
+		for (uint32_t r = 0; r < _graph.ResourceCount(); ++r)
+		{
+			if (!_graph.IsTransient(r) || !_graph.IsUsed(r))
+				continue;
+			state[r] = _graph.InitialState(r);
+			active[r] = true;
+			for (uint32_t other = 0; other < _graph.ResourceCount(); ++other)
+				active[r] = active[r] && !SharesMemory(_graph, r, other);
+		}
+
+		for (uint32_t frame = 0; frame < 2; ++frame)
+		{
+			for (uint32_t p = 0; p <= _passCount; ++p)
+			{
+				const FrameGraphBarrier* pBarriers;
+				uint32_t count;
+				if (p < _passCount)
+					_graph.PassBarriers(p, &pBarriers, &count);
+				else
+					_graph.FinalBarriers(&pBarriers, &count);
+				for (uint32_t i = 0; i < count; ++i)
+				{
+					uint32_t r = pBarriers[i].resource;
+					if (!_graph.IsTransient(r))
+						continue;
+					if (pBarriers[i].type == FrameGraphBarrier::TYPE_ALIASING)
+					{
+						for (uint32_t other = 0; other < _graph.ResourceCount(); ++other)
+						{
+							if (SharesMemory(_graph, r, other))
+								active[other] = false;
+						}
+						active[r] = true;
+					}
+					else if (pBarriers[i].type == FrameGraphBarrier::TYPE_TRANSITION)
+					{
+						if (!active[r] || pBarriers[i].before != state[r])
+							return false;
+						state[r] = pBarriers[i].after;
+					}
+				}
+			}
+			for (uint32_t r = 0; r < _graph.ResourceCount(); ++r)
+			{
+				if (_graph.IsTransient(r) && _graph.IsUsed(r) && state[r] != _graph.InitialState(r))
+					return false;
+			}
+		}
+		return true;
+	}
+
+	// a small deferred frame: gbuffer, a debug view nobody reads, lighting, two bloom passes and a tonemap into the
+	// back buffer
+	void TestDeferredFrame()
+	{
+		FrameGraph graph;
+		TransientDesc full = Target(8 << 20);
+		TransientDesc half = Target(2 << 20);
+		uint32_t backBuffer = graph.Import("back buffer", FG_STATE_PRESENT, FG_STATE_PRESENT);
+		uint32_t albedo = graph.CreateTransient("albedo", full);
+		uint32_t normal = graph.CreateTransient("normal", full);
+		uint32_t depth = graph.CreateTransient("depth", full);
+		uint32_t hdr = graph.CreateTransient("hdr", full);
+		uint32_t bloom = graph.CreateTransient("bloom", half);
+		uint32_t debug = graph.CreateTransient("debug", full);
+		uint32_t blurred = graph.CreateTransient("blurred", half);
+
+		std::string order;
+		uint32_t gbuffer = graph.AddPass("gbuffer", [&]() { order += "g"; });
+		graph.Write(gbuffer, albedo, FG_STATE_RENDER_TARGET);
+		graph.Write(gbuffer, normal, FG_STATE_RENDER_TARGET);
+		graph.Write(gbuffer, depth, FG_STATE_DEPTH_WRITE);
+		uint32_t debugView = graph.AddPass("debug", [&]() { order += "d"; });
+		graph.Read(debugView, normal, FG_STATE_PIXEL_SHADER_RESOURCE);
+		graph.Write(debugView, debug, FG_STATE_RENDER_TARGET);
+		uint32_t lighting = graph.AddPass("lighting", [&]() { order += "l"; });
+		graph.Read(lighting, albedo, FG_STATE_PIXEL_SHADER_RESOURCE);
+		graph.Read(lighting, normal, FG_STATE_PIXEL_SHADER_RESOURCE);
+		graph.Read(lighting, depth, FG_STATE_DEPTH_READ);
+		graph.Read(lighting, depth, FG_STATE_PIXEL_SHADER_RESOURCE);
+		graph.Write(lighting, hdr, FG_STATE_RENDER_TARGET);
+		uint32_t bright = graph.AddPass("bloom", [&]() { order += "b"; });
+		graph.Read(bright, hdr, FG_STATE_PIXEL_SHADER_RESOURCE);
+		graph.Write(bright, bloom, FG_STATE_RENDER_TARGET);
+		uint32_t blur = graph.AddPass("blur", [&]() { order += "u"; });
+		graph.Read(blur, bloom, FG_STATE_PIXEL_SHADER_RESOURCE);
+		graph.Write(blur, blurred, FG_STATE_UNORDERED_ACCESS);
+		uint32_t tonemap = graph.AddPass("tonemap", [&]() { order += "t"; });
+		graph.Read(tonemap, hdr, FG_STATE_NON_PIXEL_SHADER_RESOURCE);
+		graph.Read(tonemap, blurred, FG_STATE_PIXEL_SHADER_RESOURCE);
+		graph.Write(tonemap, backBuffer, FG_STATE_RENDER_TARGET);
+
+		CHECK(graph.Compile());
+
+		// only the debug view goes, and the transient it wrote never gets memory
+		CHECK(graph.IsPassCulled(debugView) && !graph.IsPassCulled(gbuffer) && !graph.IsPassCulled(tonemap));
+		CHECK(!graph.IsUsed(debug) && graph.IsUsed(blurred));
+		CHECK(graph.Stats().passesDeclared == 6 && graph.Stats().passesCulled == 1);
+
+		// gbuffer targets and hdr are alive together through lighting, bloom reuses albedo's memory once it is dead
+		std::vector<uint32_t> firstPass = { 0, gbuffer, gbuffer, gbuffer, lighting, bright, 0, blur };
+		std::vector<uint32_t> lastPass = { 0, lighting, lighting, lighting, tonemap, blur, 0, tonemap };
+		CHECK(PlacementIsValid(graph, firstPass, lastPass));
+		CHECK(graph.Stats().transientBytes == 4 * (8 << 20) + 2 * (2 << 20));
+		CHECK(graph.HeapSize() == 4 * (8 << 20));
+
+		CHECK(graph.HeapOffset(bloom) == 0 && graph.HeapOffset(albedo) == 0);
+		CHECK(BarriersRespectAliasing(graph, 6));
+
+		// hdr is read by bloom and tonemap in different ways, the first read moves it into both at once. depth read as
+		// depth and as a texture in one pass is one transition. albedo shares its memory with bloom and blurred, so it
+		// takes the memory back from whichever of them had it last frame
+		const FrameGraphBarrier* pBarriers;
+		uint32_t count;
+		graph.PassBarriers(gbuffer, &pBarriers, &count);
+		CHECK(count == 1 && SameBarrier(pBarriers[0], FrameGraphBarrier::TYPE_ALIASING, albedo));
+		graph.PassBarriers(lighting, &pBarriers, &count);
+		CHECK(count == 3 && SameBarrier(pBarriers[0], FrameGraphBarrier::TYPE_TRANSITION, albedo, FG_STATE_RENDER_TARGET, FG_STATE_PIXEL_SHADER_RESOURCE) &&
+			SameBarrier(pBarriers[2], FrameGraphBarrier::TYPE_TRANSITION, depth, FG_STATE_DEPTH_WRITE, FG_STATE_DEPTH_READ | FG_STATE_PIXEL_SHADER_RESOURCE));
+		// albedo goes back to the state the next frame wants before it hands its memory to bloom, not after
+		graph.PassBarriers(bright, &pBarriers, &count);
+		CHECK(count == 3 && SameBarrier(pBarriers[0], FrameGraphBarrier::TYPE_TRANSITION, hdr, FG_STATE_RENDER_TARGET,
+			FG_STATE_PIXEL_SHADER_RESOURCE | FG_STATE_NON_PIXEL_SHADER_RESOURCE) &&
+			SameBarrier(pBarriers[1], FrameGraphBarrier::TYPE_TRANSITION, albedo, FG_STATE_PIXEL_SHADER_RESOURCE, FG_STATE_RENDER_TARGET) &&
+			SameBarrier(pBarriers[2], FrameGraphBarrier::TYPE_ALIASING, bloom));
+		graph.PassBarriers(tonemap, &pBarriers, &count);
+		CHECK(count == 2 && SameBarrier(pBarriers[0], FrameGraphBarrier::TYPE_TRANSITION, blurred, FG_STATE_UNORDERED_ACCESS, FG_STATE_PIXEL_SHADER_RESOURCE) &&
+			SameBarrier(pBarriers[1], FrameGraphBarrier::TYPE_TRANSITION, backBuffer, FG_STATE_PRESENT, FG_STATE_RENDER_TARGET));
+		graph.PassBarriers(debugView, &pBarriers, &count);
+		CHECK(count == 0 && pBarriers == nullptr);
+
+		// the back buffer goes back to present and each transient that still owns its memory back to the state its first
+		// pass wants. albedo was put back before bloom took its memory
+		graph.FinalBarriers(&pBarriers, &count);
+		CHECK(count == 6 && SameBarrier(pBarriers[0], FrameGraphBarrier::TYPE_TRANSITION, backBuffer, FG_STATE_RENDER_TARGET, FG_STATE_PRESENT));
+		for (uint32_t i = 0; i < count; ++i)
+			CHECK(pBarriers[i].resource != albedo);
+		CHECK(graph.InitialState(blurred) == FG_STATE_UNORDERED_ACCESS);
+
+		// Execute runs the live passes in order with their batches in front
+		uint32_t batches = 0;
+		uint32_t barriers = 0;
+		graph.Execute([&](const FrameGraphBarrier*, uint32_t _count) { ++batches; barriers += _count; });
+		CHECK(order == "glbut");
+		CHECK(batches == graph.Stats().barrierBatches && batches == 6 && barriers == graph.Stats().barriers && barriers == 17);
+	}
+
+	void TestCulling()
+	{
+		FrameGraph graph;
+		uint32_t output = graph.Import("output", FG_STATE_COMMON, FG_STATE_COMMON);
+		uint32_t scratch = graph.CreateTransient("scratch", Target(1024, 0));
+
+		// the first write to output is replaced by a full write before anyone reads it, so it is not needed
+		uint32_t overwritten = graph.AddPass("overwritten", nullptr);
+		graph.Write(overwritten, output, FG_STATE_RENDER_TARGET);
+		uint32_t clear = graph.AddPass("clear", nullptr);
+		graph.Write(clear, output, FG_STATE_RENDER_TARGET);
+
+		// ReadWrite keeps what was there, so the clear above it stays
+		uint32_t blend = graph.AddPass("blend", nullptr);
+		graph.ReadWrite(blend, output, FG_STATE_RENDER_TARGET);
+
+		// nobody reads scratch, but a pass with side effects stays anyway
+		uint32_t unused = graph.AddPass("unused", nullptr);
+		graph.Write(unused, scratch, FG_STATE_RENDER_TARGET);
+		uint32_t readback = graph.AddPass("readback", nullptr);
+		graph.Read(readback, output, FG_STATE_COPY_SOURCE);
+		graph.SetSideEffects(readback);
+
+		CHECK(graph.Compile());
+		CHECK(graph.IsPassCulled(overwritten) && !graph.IsPassCulled(clear) && !graph.IsPassCulled(blend));
+		CHECK(graph.IsPassCulled(unused) && !graph.IsPassCulled(readback));
+		CHECK(!graph.IsUsed(scratch) && graph.HeapSize() == 0);
+
+		// the clear and the blend write the same state back to back, only the copy needs a transition
+		const FrameGraphBarrier* pBarriers;
+		uint32_t count;
+		graph.PassBarriers(clear, &pBarriers, &count);
+		CHECK(count == 1 && SameBarrier(pBarriers[0], FrameGraphBarrier::TYPE_TRANSITION, output, FG_STATE_COMMON, FG_STATE_RENDER_TARGET));
+		graph.PassBarriers(blend, &pBarriers, &count);
+		CHECK(count == 0);
+		graph.PassBarriers(readback, &pBarriers, &count);
+		CHECK(count == 1 && pBarriers[0].after == FG_STATE_COPY_SOURCE);
+	}
+
+	void TestUnorderedAccess()
+	{
+		// two passes in a row writing the same uav need a uav barrier between them, not a transition
+		FrameGraph graph;
+		uint32_t buffer = graph.Import("buffer", FG_STATE_UNORDERED_ACCESS, FG_STATE_UNORDERED_ACCESS);
+		uint32_t first = graph.AddPass("first", nullptr);
+		graph.Write(first, buffer, FG_STATE_UNORDERED_ACCESS);
+		uint32_t second = graph.AddPass("second", nullptr);
+		graph.ReadWrite(second, buffer, FG_STATE_UNORDERED_ACCESS);
+		CHECK(graph.Compile());
+
+		const FrameGraphBarrier* pBarriers;
+		uint32_t count;
+		graph.PassBarriers(first, &pBarriers, &count);
+		CHECK(count == 0);
+		graph.PassBarriers(second, &pBarriers, &count);
+		CHECK(count == 1 && SameBarrier(pBarriers[0], FrameGraphBarrier::TYPE_UAV, buffer));
+		graph.FinalBarriers(&pBarriers, &count);
+		CHECK(count == 0);
+	}
+
+	void TestMalformed()
+	{
+		// a transient has no contents at the start of the frame, so reading it first is an error
+		FrameGraph graph;
+		uint32_t output = graph.Import("output", FG_STATE_COMMON, FG_STATE_COMMON);
+		uint32_t transient = graph.CreateTransient("transient", Target(1024));
+		uint32_t pass = graph.AddPass("pass", nullptr);
+		graph.Read(pass, transient, FG_STATE_PIXEL_SHADER_RESOURCE);
+		graph.Write(pass, output, FG_STATE_RENDER_TARGET);
+		CHECK(!graph.Compile());
+
+		// Reset forgets it all and the graph can be built again
+		graph.Reset();
+		CHECK(graph.ResourceCount() == 0);
+		output = graph.Import("output", FG_STATE_COMMON, FG_STATE_COMMON);
+		pass = graph.AddPass("pass", nullptr);
+		graph.Write(pass, output, FG_STATE_RENDER_TARGET);
+		CHECK(graph.Compile() && graph.Stats().passesDeclared == 1);
+	}
+
+	// random chains of passes, each writing a new transient and reading a couple of earlier ones. whatever comes out,
+	// the placement has to be valid against lifetimes worked out here from the passes that survived
+	void TestRandomPlacement()
+	{
+		std::mt19937 random(7);
+		for (int graphIndex = 0; graphIndex < 200; ++graphIndex)
+		{
+			FrameGraph graph;
+			uint32_t output = graph.Import("output", FG_STATE_COMMON, FG_STATE_PRESENT);
+			uint32_t passCount = 2 + random() % 12;
+			std::vector<std::vector<uint32_t>> reads(passCount);
+			std::vector<uint32_t> written(passCount);
+			for (uint32_t p = 0; p < passCount; ++p)
+			{
+				uint32_t pass = graph.AddPass("pass", nullptr);
+				written[p] = graph.CreateTransient("target", Target((1 + random() % 8) << 16, 1ull << (12 + random() % 5)));
+				graph.Write(pass, written[p], FG_STATE_RENDER_TARGET);
+				for (uint32_t r = 0; p > 0 && r < 2; ++r)
+				{
+					uint32_t source = written[random() % p];
+					graph.Read(pass, source, FG_STATE_PIXEL_SHADER_RESOURCE);
+					reads[p].push_back(source);
+				}
+				if (p == passCount - 1 || random() % 4 == 0)
+					graph.Write(pass, output, FG_STATE_RENDER_TARGET);
+			}
+			if (!graph.Compile())
+			{
+				CHECK(false);
+				continue;
+			}
+
+			uint32_t none = FrameGraph::INVALID_HANDLE; // the constant has no definition for the vector to take a reference to
+			std::vector<uint32_t> firstPass(graph.ResourceCount(), none);
+			std::vector<uint32_t> lastPass(graph.ResourceCount(), none);
+			for (uint32_t p = 0; p < passCount; ++p)
+			{
+				if (graph.IsPassCulled(p))
+					continue;
+				reads[p].push_back(written[p]);
+				for (uint32_t resource : reads[p])
+				{
+					if (firstPass[resource] == FrameGraph::INVALID_HANDLE)
+						firstPass[resource] = p;
+					lastPass[resource] = p;
+				}
+			}
+			for (uint32_t r = 0; r < graph.ResourceCount(); ++r)
+				CHECK(graph.IsUsed(r) == (firstPass[r] != FrameGraph::INVALID_HANDLE) || !graph.IsTransient(r));
+			CHECK(PlacementIsValid(graph, firstPass, lastPass));
+			CHECK(BarriersRespectAliasing(graph, passCount));
+			CHECK(graph.HeapSize() <= graph.Stats().transientBytes + (1 << 16) * passCount);
+		}
+	}
+}
+
+int main()
+{
+	TestDeferredFrame();
+	TestCulling();
+	TestUnorderedAccess();
+	TestMalformed();
+	TestRandomPlacement();
+	return CHECK_RESULT();
+}
@@ -0,0 +1,133 @@
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "Check.h"
+#include "IndirectDraw.h"
+#include "JobSystem.h"
+
+using namespace DirectX;
+
+// CompactIndirectDraws against the obvious version: for each bucket in turn, every source in it that passes
+// SphereInFrustum, in source order. the records, the bucket ranges and the count all have to match, threads or not
+namespace
+{
+	struct Reference
+	{
+		std::vector<uint32_t> sources; // the source index behind each record
+		std::vector<uint32_t> bucketOffsets;
+		std::vector<uint32_t> bucketCounts;
+	};
+
+	Reference BruteForce(const std::vector<IndirectDrawSource>& _sources, const Frustum& _frustum, uint32_t _bucketCount)
+	{
+		Reference reference;
+		for (uint32_t bucket = 0; bucket < _bucketCount; ++bucket)
+		{
+			reference.bucketOffsets.push_back(static_cast<uint32_t>(reference.sources.size()));
+			for (uint32_t i = 0; i < _sources.size(); ++i)
+			{
+				if (_sources[i].bucket == bucket && Culling::SphereInFrustum(_frustum, _sources[i].boundingSphere))
+					reference.sources.push_back(i);
+			}
+			reference.bucketCounts.push_back(static_cast<uint32_t>(reference.sources.size()) - reference.bucketOffsets.back());
+		}
+		return reference;
+	}
+
+	Frustum CameraFrustum()
+	{
+		XMMATRIX view = XMMatrixLookAtLH(XMVectorSet(0.0f, 2.0f, -4.0f, 1.0f), XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+		XMMATRIX projection = XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, 100.0f);
+		XMFLOAT4X4 viewProj;
+		XMStoreFloat4x4(&viewProj, view * projection);
+		Frustum frustum;
+		Culling::ExtractFrustum(viewProj, frustum);
+		return frustum;
+	}
+
+	// _sortedBuckets gives the sources in bucket order, the way DrawQueue hands them over, otherwise buckets are shuffled
+	void TestScene(uint32_t _count, uint32_t _bucketCount, bool _sortedBuckets, JobSystem& _jobSystem)
+	{
+		std::mt19937 random(_count * 31 + _bucketCount);
+		std::uniform_real_distribution<float> position(-60.0f, 60.0f);
+		std::uniform_real_distribution<float> radius(0.1f, 4.0f);
+		std::vector<IndirectDrawSource> sources(_count);
+		std::vector<uint32_t> constants(_count * INDIRECT_ROOT_CONSTANTS);
+		for (uint32_t i = 0; i < _count; ++i)
+		{
+			IndirectDrawSource& source = sources[i];
+			source.boundingSphere = XMFLOAT4(position(random), position(random) * 0.2f, position(random), radius(random));
+			source.bucket = _sortedBuckets ? static_cast<uint32_t>(uint64_t(i) * _bucketCount / _count) : random() % _bucketCount;
+			for (uint32_t c = 0; c < INDIRECT_ROOT_CONSTANTS; ++c)
+				constants[i * INDIRECT_ROOT_CONSTANTS + c] = i * INDIRECT_ROOT_CONSTANTS + c;
+			source.pRootConstants = &constants[i * INDIRECT_ROOT_CONSTANTS];
+			source.draw = { 36, 1, i * 3, static_cast<int32_t>(i), 0 };
+		}
+
+		Frustum frustum = CameraFrustum();
+		Reference reference = BruteForce(sources, frustum, _bucketCount);
+
+		JobSystem* pJobSystems[] = { nullptr, &_jobSystem };
+		for (JobSystem* pJobSystem : pJobSystems)
+		{
+			std::vector<IndirectDrawRecord> records(_count + 1);
+			std::vector<uint32_t> bucketOffsets(_bucketCount, ~0u), bucketCounts(_bucketCount, ~0u);
+			uint32_t visible = CompactIndirectDraws(sources.data(), _count, frustum, _bucketCount, records.data(),
+				bucketOffsets.data(), bucketCounts.data(), pJobSystem);
+
+			CHECK(visible == reference.sources.size());
+			CHECK(bucketOffsets == reference.bucketOffsets && bucketCounts == reference.bucketCounts);
+			bool same = visible == reference.sources.size();
+			for (uint32_t i = 0; i < visible && same; ++i)
+			{
+				const IndirectDrawSource& source = sources[reference.sources[i]];
+				same = memcmp(records[i].rootConstants, source.pRootConstants, sizeof(records[i].rootConstants)) == 0 &&
+					memcmp(&records[i].draw, &source.draw, sizeof(DrawIndexedArguments)) == 0;
+			}
+			CHECK(same);
+		}
+	}
+
+	void TestEdges()
+	{
+		Frustum frustum = CameraFrustum();
+
+		// nothing in, every bucket empty
+		uint32_t bucketOffsets[2] = { ~0u, ~0u }, bucketCounts[2] = { ~0u, ~0u };
+		CHECK(CompactIndirectDraws(nullptr, 0, frustum, 2, nullptr, bucketOffsets, bucketCounts) == 0);
+		CHECK(bucketCounts[0] == 0 && bucketCounts[1] == 0 && bucketOffsets[0] == 0 && bucketOffsets[1] == 0);
+
+		// the camera looks at the origin, so a sphere there is in, one behind the camera and one far to the side are not
+		uint32_t constants[INDIRECT_ROOT_CONSTANTS] = {};
+		IndirectDrawSource sources[3] = {};
+		sources[0].boundingSphere = XMFLOAT4(0.0f, 0.0f, 0.0f, 0.5f);
+		sources[1].boundingSphere = XMFLOAT4(0.0f, 2.0f, -10.0f, 0.5f);
+		sources[2].boundingSphere = XMFLOAT4(-50.0f, 0.0f, 0.0f, 0.5f);
+		for (IndirectDrawSource& source : sources)
+		{
+			source.bucket = 1;
+			source.pRootConstants = constants;
+		}
+		IndirectDrawRecord records[3];
+		CHECK(CompactIndirectDraws(sources, 3, frustum, 2, records, bucketOffsets, bucketCounts) == 1);
+		CHECK(bucketCounts[0] == 0 && bucketOffsets[1] == 0 && bucketCounts[1] == 1);
+
+		// a sphere that only overlaps the frustum still counts
+		sources[1].boundingSphere = XMFLOAT4(0.0f, 2.0f, -4.0f, 0.5f);
+		CHECK(CompactIndirectDraws(sources, 3, frustum, 2, records, bucketOffsets, bucketCounts) == 2);
+	}
+}
+
+int main()
+{
+	JobSystem jobSystem;
+	jobSystem.Init(3);
+	TestEdges();
+	TestScene(1, 1, true, jobSystem);
+	TestScene(1000, 7, false, jobSystem);
+	TestScene(100003, 7, false, jobSystem);
+	TestScene(100003, 300, true, jobSystem);
+	TestScene(20000, 1, true, jobSystem);
+	return CHECK_RESULT();
+}
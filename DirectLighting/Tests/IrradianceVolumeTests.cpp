@@ -0,0 +1,323 @@
+#include <DirectXPackedVector.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <vector>
+
+#include "Check.h"
+#include "IrradianceVolume.h"
+#include "JobSystem.h"
+#include "PathTracer.h"
+
+using namespace DirectX;
+
+namespace
+{
+	struct TestVertex
+	{
+		XMFLOAT3 position;
+		XMFLOAT4 color;
+	};
+
+	typedef std::function<XMFLOAT3(const XMFLOAT3&)> RadianceFunction;
+
+	// a uniform direction on the sphere in each cell of a _strata * _strata grid, the way BakeProbe picks them
+	std::vector<XMFLOAT3> StratifiedDirections(uint32_t _strata, std::mt19937& _random)
+	{
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		std::vector<XMFLOAT3> directions(_strata * _strata);
+		for (uint32_t i = 0; i < directions.size(); ++i)
+		{
+			float u = ((i % _strata) + unit(_random)) / _strata;
+			float v = ((i / _strata) + unit(_random)) / _strata;
+			float cosTheta = 1.0f - 2.0f * u;
+			float sinTheta = std::sqrt(std::max(0.0f, 1.0f - cosTheta * cosTheta));
+			float phi = 2.0f * XM_PI * v;
+			directions[i] = XMFLOAT3(sinTheta * std::cos(phi), sinTheta * std::sin(phi), cosTheta);
+		}
+		return directions;
+	}
+
+	// the irradiance on a surface facing _normal, integrating _radiance over the hemisphere on a fine grid in doubles
+	XMFLOAT3 BruteForceIrradiance(const RadianceFunction& _radiance, const XMFLOAT3& _normal)
+	{
+		const uint32_t thetaSteps = 256;
+		const uint32_t phiSteps = 512;
+		double sum[3] = { 0.0, 0.0, 0.0 };
+		for (uint32_t i = 0; i < thetaSteps; ++i)
+		{
+			double theta = (i + 0.5) * 3.14159265358979 / thetaSteps;
+			for (uint32_t j = 0; j < phiSteps; ++j)
+			{
+				double phi = (j + 0.5) * 2.0 * 3.14159265358979 / phiSteps;
+				XMFLOAT3 direction(static_cast<float>(std::sin(theta) * std::cos(phi)), static_cast<float>(std::sin(theta) * std::sin(phi)), static_cast<float>(std::cos(theta)));
+				double cosine = static_cast<double>(direction.x) * _normal.x + static_cast<double>(direction.y) * _normal.y + static_cast<double>(direction.z) * _normal.z;
+				if (cosine <= 0.0)
+					continue;
+				double area = std::sin(theta) * (3.14159265358979 / thetaSteps) * (2.0 * 3.14159265358979 / phiSteps);
+				XMFLOAT3 radiance = _radiance(direction);
+				sum[0] += radiance.x * cosine * area;
+				sum[1] += radiance.y * cosine * area;
+				sum[2] += radiance.z * cosine * area;
+			}
+		}
+		return XMFLOAT3(static_cast<float>(sum[0]), static_cast<float>(sum[1]), static_cast<float>(sum[2]));
+	}
+
+	float MaxDifference(const XMFLOAT3& _a, const XMFLOAT3& _b)
+	{
+		return std::max(std::abs(_a.x - _b.x), std::max(std::abs(_a.y - _b.y), std::abs(_a.z - _b.z)));
+	}
+
+	XMFLOAT3 RandomNormal(std::mt19937& _random)
+	{
+		std::normal_distribution<float> gauss;
+		XMFLOAT3 normal;
+		XMStoreFloat3(&normal, XMVector3Normalize(XMVectorSet(gauss(_random), gauss(_random), gauss(_random), 0.0f)));
+		return normal;
+	}
+
+	// radiance made of the first three bands only is all l2 can hold, so the projection evaluates to the exact
+	// irradiance for every normal. anything more only shows up as the sampling noise of the directions
+	void TestProjection()
+	{
+		std::mt19937 random(1);
+		std::vector<XMFLOAT3> directions = StratifiedDirections(128, random);
+
+		const RadianceFunction functions[] =
+		{
+			[](const XMFLOAT3&) { return XMFLOAT3(1.0f, 2.0f, 0.5f); },
+			[](const XMFLOAT3& _d) { return XMFLOAT3(1.0f + 0.5f * _d.x, 1.0f - 0.8f * _d.y, 1.0f + 0.3f * _d.z); },
+			[](const XMFLOAT3& _d) { return XMFLOAT3(_d.z * _d.z, 1.0f + _d.x * _d.y, 2.0f + _d.x * _d.z - _d.y * _d.z); },
+			[](const XMFLOAT3& _d) { return XMFLOAT3(_d.x * _d.x - _d.y * _d.y + 1.0f, 0.2f + _d.y * _d.y, 0.0f); }
+		};
+		for (const RadianceFunction& function : functions)
+		{
+			std::vector<XMFLOAT3> radiance(directions.size());
+			for (size_t i = 0; i < directions.size(); ++i)
+				radiance[i] = function(directions[i]);
+			ShCoefficients coefficients;
+			IrradianceVolume::ProjectIrradiance(directions.data(), radiance.data(), static_cast<uint32_t>(directions.size()), coefficients);
+
+			float worst = 0.0f;
+			for (uint32_t i = 0; i < 50; ++i)
+			{
+				XMFLOAT3 normal = RandomNormal(random);
+				worst = std::max(worst, MaxDifference(IrradianceVolume::Evaluate(coefficients, normal), BruteForceIrradiance(function, normal)));
+			}
+			printf("band limited radiance: worst irradiance error %g\n", worst);
+			CHECK(worst < 0.01f);
+		}
+
+		// a constant sky is pi times its radiance whichever way the surface faces
+		std::vector<XMFLOAT3> sky(directions.size(), XMFLOAT3(1.0f, 1.0f, 1.0f));
+		ShCoefficients skyCoefficients;
+		IrradianceVolume::ProjectIrradiance(directions.data(), sky.data(), static_cast<uint32_t>(directions.size()), skyCoefficients);
+		for (uint32_t i = 0; i < 20; ++i)
+			CHECK(MaxDifference(IrradianceVolume::Evaluate(skyCoefficients, RandomNormal(random)), XMFLOAT3(XM_PI, XM_PI, XM_PI)) < 1e-3f);
+
+		// light from one side only is beyond l2, but the lit side gets about pi and the dark side about nothing
+		std::vector<XMFLOAT3> upper(directions.size());
+		for (size_t i = 0; i < directions.size(); ++i)
+			upper[i] = directions[i].y > 0.0f ? XMFLOAT3(1.0f, 1.0f, 1.0f) : XMFLOAT3(0.0f, 0.0f, 0.0f);
+		ShCoefficients upperCoefficients;
+		IrradianceVolume::ProjectIrradiance(directions.data(), upper.data(), static_cast<uint32_t>(directions.size()), upperCoefficients);
+		CHECK(std::abs(IrradianceVolume::Evaluate(upperCoefficients, XMFLOAT3(0.0f, 1.0f, 0.0f)).x - XM_PI) < 0.1f * XM_PI);
+		CHECK(IrradianceVolume::Evaluate(upperCoefficients, XMFLOAT3(0.0f, -1.0f, 0.0f)).x < 0.1f * XM_PI);
+	}
+
+
+	void Store(const ShCoefficients& _coefficients, float _floats[28])
+	{
+		for (uint32_t i = 0; i < 7; ++i)
+			XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&_floats[i * 4]), _coefficients.v[i]);
+	}
+
+	// the projection works four directions at a time. the coefficients are linear in the samples, so any count has to
+	// give the mean of projecting each direction on its own, with the padding of the last four carrying no light
+	void TestProjectionLanes()
+	{
+		std::mt19937 random(2);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		for (uint32_t count : { 1u, 3u, 4u, 5u, 7u, 64u, 101u })
+		{
+			std::vector<XMFLOAT3> directions(count);
+			std::vector<XMFLOAT3> radiance(count);
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				directions[i] = RandomNormal(random);
+				radiance[i] = XMFLOAT3(unit(random), unit(random), unit(random));
+			}
+			ShCoefficients coefficients;
+			IrradianceVolume::ProjectIrradiance(directions.data(), radiance.data(), count, coefficients);
+			float all[28];
+			Store(coefficients, all);
+
+			double sums[27] = {};
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				ShCoefficients single;
+				IrradianceVolume::ProjectIrradiance(&directions[i], &radiance[i], 1, single);
+				float singleFloats[28];
+				Store(single, singleFloats);
+				for (uint32_t c = 0; c < 27; ++c)
+					sums[c] += singleFloats[c];
+			}
+			float worst = 0.0f;
+			for (uint32_t c = 0; c < 27; ++c)
+				worst = std::max(worst, static_cast<float>(std::abs(all[c] - sums[c] / count)));
+			CHECK(worst < 1e-5f);
+			CHECK(all[27] == 0.0f);
+		}
+	}
+
+	// a floor lit by a point light and the sun, with the probes above it
+	void InitScene(PathTracer& _scene)
+	{
+		PathTracerDesc desc;
+		desc.width = 1;
+		desc.height = 1;
+		_scene.Init(desc);
+
+		const float extent = 20.0f;
+		TestVertex vertices[4] =
+		{
+			{ XMFLOAT3(-extent, 0.0f, -extent), XMFLOAT4(0.5f, 0.5f, 0.5f, 1.0f) },
+			{ XMFLOAT3(-extent, 0.0f, extent), XMFLOAT4(0.5f, 0.5f, 0.5f, 1.0f) },
+			{ XMFLOAT3(extent, 0.0f, extent), XMFLOAT4(0.5f, 0.5f, 0.5f, 1.0f) },
+			{ XMFLOAT3(extent, 0.0f, -extent), XMFLOAT4(0.5f, 0.5f, 0.5f, 1.0f) }
+		};
+		uint32_t indices[6] = { 0, 1, 2, 0, 2, 3 };
+		XMFLOAT4X4 identity;
+		XMStoreFloat4x4(&identity, XMMatrixIdentity());
+		_scene.AddMesh(vertices, 4, sizeof(TestVertex), 0, sizeof(XMFLOAT3), indices, 6, identity);
+
+		Light light = {};
+		light.position = XMFLOAT3(1.0f, 1.0f, 0.0f);
+		light.range = 4.0f;
+		light.color = XMFLOAT3(4.0f, 2.0f, 1.0f);
+		light.type = LIGHT_POINT;
+		light.direction = XMFLOAT3(0.0f, 0.0f, 1.0f);
+		light.cosOuterAngle = -1.0f;
+		_scene.SetLights(&light, 1);
+		_scene.SetSun(XMFLOAT3(0.0f, -1.0f, 0.0f), XMFLOAT3(0.5f, 0.5f, 0.5f));
+		_scene.Commit();
+	}
+
+	// a small volume over the floor: the bake is the same however many threads ran, the probes see the floor's light
+	// from below, Sample blends the eight probes around a point, and GpuTexels is the probes as half floats
+	void TestVolume(JobSystem& _jobSystem)
+	{
+		PathTracer scene;
+		InitScene(scene);
+		IrradianceVolumeDesc desc;
+		desc.boundsMin = XMFLOAT3(-2.0f, 0.5f, -2.0f);
+		desc.boundsMax = XMFLOAT3(2.0f, 2.5f, 2.0f);
+		desc.countX = 3;
+		desc.countY = 2;
+		desc.countZ = 3;
+		desc.samplesPerProbe = 64;
+
+		IrradianceVolume threaded;
+		threaded.Init(desc);
+		threaded.Bake(scene, &_jobSystem);
+		IrradianceVolume single;
+		single.Init(desc);
+		single.Bake(scene);
+		CHECK(threaded.ProbeCount() == 18);
+		bool same = true;
+		for (uint32_t probe = 0; probe < threaded.ProbeCount(); ++probe)
+		{
+			float a[28];
+			float b[28];
+			Store(threaded.Probe(probe), a);
+			Store(single.Probe(probe), b);
+			same = same && std::equal(a, a + 28, b);
+		}
+		CHECK(same);
+
+		// nothing comes from the black sky, all of it is light bouncing off the floor
+		XMFLOAT3 up = threaded.Irradiance(XMFLOAT3(0.0f, 1.0f, 0.0f), XMFLOAT3(0.0f, 1.0f, 0.0f));
+		XMFLOAT3 down = threaded.Irradiance(XMFLOAT3(0.0f, 1.0f, 0.0f), XMFLOAT3(0.0f, -1.0f, 0.0f));
+		CHECK(down.x > 0.1f && down.x > 5.0f * up.x);
+		// the light is red, so what bounces off the grey floor is too
+		CHECK(down.x > down.y && down.y > down.z);
+
+		// at a probe the blend is that probe alone, outside the bounds it is the nearest one
+		float expected[28];
+		float sampled[28];
+		ShCoefficients coefficients;
+		threaded.Sample(threaded.ProbePosition(1, 1, 2), coefficients);
+		Store(coefficients, sampled);
+		Store(threaded.Probe(threaded.ProbeIndex(1, 1, 2)), expected);
+		float worst = 0.0f;
+		for (uint32_t c = 0; c < 28; ++c)
+			worst = std::max(worst, std::abs(sampled[c] - expected[c]));
+		CHECK(worst < 1e-5f);
+		threaded.Sample(XMFLOAT3(-50.0f, 100.0f, 50.0f), coefficients);
+		Store(coefficients, sampled);
+		Store(threaded.Probe(threaded.ProbeIndex(0, 1, 2)), expected);
+		worst = 0.0f;
+		for (uint32_t c = 0; c < 28; ++c)
+			worst = std::max(worst, std::abs(sampled[c] - expected[c]));
+		CHECK(worst < 1e-5f);
+
+		// a point a quarter of the way into a cell against the trilinear weights worked out in doubles
+		XMFLOAT3 position(-2.0f + 0.25f * 2.0f, 0.5f + 0.75f * 2.0f, 0.0f + 0.5f * 2.0f);
+		const double weights[3][2] = { { 0.75, 0.25 }, { 0.25, 0.75 }, { 0.5, 0.5 } };
+		double blend[28] = {};
+		for (uint32_t corner = 0; corner < 8; ++corner)
+		{
+			uint32_t cx = corner & 1;
+			uint32_t cy = (corner >> 1) & 1;
+			uint32_t cz = corner >> 2;
+			double weight = weights[0][cx] * weights[1][cy] * weights[2][cz];
+			float probe[28];
+			Store(threaded.Probe(threaded.ProbeIndex(cx, cy, 1 + cz)), probe);
+			for (uint32_t c = 0; c < 28; ++c)
+				blend[c] += weight * probe[c];
+		}
+		threaded.Sample(position, coefficients);
+		Store(coefficients, sampled);
+		worst = 0.0f;
+		for (uint32_t c = 0; c < 28; ++c)
+			worst = std::max(worst, static_cast<float>(std::abs(sampled[c] - blend[c])));
+		CHECK(worst < 1e-5f);
+
+		// texture t of the gpu layout holds floats 4t to 4t + 3 of every probe, in probe order
+		std::vector<uint16_t> halfs;
+		threaded.GpuTexels(halfs);
+		CHECK(halfs.size() == IrradianceVolume::GPU_TEXTURE_COUNT * threaded.ProbeCount() * 4);
+		uint32_t wrong = 0;
+		for (uint32_t probe = 0; probe < threaded.ProbeCount(); ++probe)
+		{
+			float floats[28];
+			Store(threaded.Probe(probe), floats);
+			for (uint32_t texture = 0; texture < IrradianceVolume::GPU_TEXTURE_COUNT; ++texture)
+			{
+				for (uint32_t channel = 0; channel < 4; ++channel)
+				{
+					float value = floats[texture * 4 + channel];
+					float half = PackedVector::XMConvertHalfToFloat(halfs[(texture * threaded.ProbeCount() + probe) * 4 + channel]);
+					if (std::abs(half - value) > std::abs(value) / 1024.0f + 1e-6f)
+						++wrong;
+				}
+			}
+		}
+		CHECK(wrong == 0);
+	}
+}
+
+int main()
+{
+	JobSystem jobSystem;
+	jobSystem.Init(3);
+
+	TestProjection();
+	TestProjectionLanes();
+	TestVolume(jobSystem);
+	return CHECK_RESULT();
+}
@@ -0,0 +1,206 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "Check.h"
+#include "JobSystem.h"
+#include "LightAliasTable.h"
+
+using namespace DirectX;
+
+namespace
+{
+	// a tenth of the lights are off, the rest spread over two orders of magnitude
+	std::vector<Light> MakeLights(uint32_t _count, std::mt19937& _random)
+	{
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		std::vector<Light> lights(_count);
+		for (Light& light : lights)
+		{
+			float power = unit(_random) < 0.1f ? 0.0f : 0.1f + 10.0f * unit(_random) * unit(_random);
+			light.position = XMFLOAT3(0.0f, 0.0f, 0.0f);
+			light.range = 1.0f;
+			light.color = XMFLOAT3(power, power, power);
+			light.type = LIGHT_POINT;
+			light.direction = XMFLOAT3(0.0f, 0.0f, 1.0f);
+			light.cosOuterAngle = -1.0f;
+		}
+		return lights;
+	}
+
+	// SampleLightAliasTable in LightAliasTable.hlsli line by line, reading nothing but the entries a shader gets
+	uint32_t ShaderPickSlot(const std::vector<LightAliasEntry>& _entries, uint32_t _first, uint32_t _count, float _u, float& _pmf)
+	{
+		float scaled = _u * static_cast<float>(_count);
+		uint32_t slot = std::min(static_cast<uint32_t>(scaled), _count - 1);
+		float fraction = scaled - static_cast<float>(slot);
+		const LightAliasEntry& entry = _entries[_first + slot];
+		if (fraction < entry.threshold)
+		{
+			_pmf = entry.pmf;
+			return slot;
+		}
+		_pmf = entry.aliasPmf;
+		return entry.alias;
+	}
+
+	bool ShaderSample(const std::vector<LightAliasEntry>& _entries, uint32_t _lightCount, float _u0, float _u1, uint32_t& _light, float& _pmf)
+	{
+		const float oneMinusEpsilon = 0.99999994f;
+		_light = 0;
+		_pmf = 0.0f;
+		uint32_t blockCount = (_lightCount + LIGHT_ALIAS_BLOCK_SIZE - 1) / LIGHT_ALIAS_BLOCK_SIZE;
+		if (blockCount == 0)
+			return false;
+
+		float blockPmf;
+		uint32_t block = ShaderPickSlot(_entries, 0, blockCount, std::min(_u0, oneMinusEpsilon), blockPmf);
+		if (blockPmf <= 0.0f)
+			return false;
+
+		uint32_t first = block * LIGHT_ALIAS_BLOCK_SIZE;
+		uint32_t count = std::min(_lightCount - first, LIGHT_ALIAS_BLOCK_SIZE);
+		float lightPmf;
+		_light = first + ShaderPickSlot(_entries, blockCount + first, count, std::min(_u1, oneMinusEpsilon), lightPmf);
+		_pmf = blockPmf * lightPmf;
+		return true;
+	}
+
+	// the exact probability of every light from the table itself: each slot is picked with 1 / count and hands out
+	// threshold to its own item and the rest to its alias
+	std::vector<double> TableProbabilities(LightAliasTable& _table)
+	{
+		const std::vector<LightAliasEntry>& entries = _table.Entries();
+		uint32_t lightCount = _table.LightCount();
+		uint32_t blockCount = _table.BlockCount();
+		std::vector<double> blocks(blockCount, 0.0);
+		for (uint32_t slot = 0; slot < blockCount; ++slot)
+		{
+			blocks[slot] += entries[slot].threshold / static_cast<double>(blockCount);
+			blocks[entries[slot].alias] += (1.0 - entries[slot].threshold) / blockCount;
+		}
+		std::vector<double> lights(lightCount, 0.0);
+		for (uint32_t block = 0; block < blockCount; ++block)
+		{
+			uint32_t first = block * LIGHT_ALIAS_BLOCK_SIZE;
+			uint32_t count = std::min(lightCount - first, LIGHT_ALIAS_BLOCK_SIZE);
+			for (uint32_t slot = 0; slot < count; ++slot)
+			{
+				const LightAliasEntry& entry = entries[blockCount + first + slot];
+				lights[first + slot] += blocks[block] * entry.threshold / count;
+				lights[first + entry.alias] += blocks[block] * (1.0 - entry.threshold) / count;
+			}
+		}
+		return lights;
+	}
+
+	void TestTable(JobSystem& _jobSystem)
+	{
+		std::mt19937 random(5);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		for (uint32_t count : { 1u, 5u, LIGHT_ALIAS_BLOCK_SIZE, LIGHT_ALIAS_BLOCK_SIZE + 1, 100000u })
+		{
+			std::vector<Light> lights = MakeLights(count, random);
+			LightAliasTable serial;
+			LightAliasTable parallel;
+			serial.Build(lights.data(), count);
+			parallel.Build(lights.data(), count, &_jobSystem);
+			CHECK(serial.LightCount() == count);
+			CHECK(serial.Entries().size() == serial.BlockCount() + count);
+			CHECK(std::memcmp(serial.Entries().data(), parallel.Entries().data(), serial.Entries().size() * sizeof(LightAliasEntry)) == 0);
+
+			// the table picks every light in proportion to its power, and Pmf says so
+			double total = 0.0;
+			for (const Light& light : lights)
+				total += LightPower(light);
+			std::vector<double> probabilities = TableProbabilities(serial);
+			uint32_t wrongProbability = 0;
+			uint32_t wrongPmf = 0;
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				double expected = LightPower(lights[i]) / total;
+				double tolerance = 1e-5 * std::max(expected, 1.0 / count);
+				if (std::abs(probabilities[i] - expected) > tolerance || (expected == 0.0 && probabilities[i] != 0.0))
+					++wrongProbability;
+				if (std::abs(serial.Pmf(i) - expected) > tolerance || (expected == 0.0 && serial.Pmf(i) != 0.0f))
+					++wrongPmf;
+			}
+			CHECK(wrongProbability == 0);
+			CHECK(wrongPmf == 0);
+
+			// the shader's walk over the packed entries picks the same light with the same pmf, bit for bit
+			uint32_t mismatches = 0;
+			std::vector<float> edges = { 0.0f, 0.5f, 0.99999994f, 1.0f };
+			for (uint32_t i = 0; i < 20000; ++i)
+			{
+				float u0 = i < 16 ? edges[i % 4] : unit(random);
+				float u1 = i < 16 ? edges[i / 4] : unit(random);
+				LightAliasSample sample;
+				bool found = serial.Sample(u0, u1, sample);
+				uint32_t light;
+				float pmf;
+				if (ShaderSample(serial.Entries(), count, u0, u1, light, pmf) != found)
+					++mismatches;
+				else if (found && (light != sample.light || std::memcmp(&pmf, &sample.pmf, sizeof(float)) != 0 || pmf != serial.Pmf(light) || pmf <= 0.0f))
+					++mismatches;
+			}
+			CHECK(mismatches == 0);
+		}
+	}
+
+	// changing one light's power rebuilds only its block and the block table, and gives the table a new build would
+	void TestIncremental(JobSystem& _jobSystem)
+	{
+		std::mt19937 random(6);
+		std::vector<Light> lights = MakeLights(5 * LIGHT_ALIAS_BLOCK_SIZE + 7, random);
+		uint32_t count = static_cast<uint32_t>(lights.size());
+		LightAliasTable table;
+		table.Build(lights.data(), count, &_jobSystem);
+		CHECK(table.RebuiltBlocks() == 6);
+
+		table.Build(lights.data(), count, &_jobSystem);
+		CHECK(table.RebuiltBlocks() == 0);
+
+		lights[2 * LIGHT_ALIAS_BLOCK_SIZE + 10].color.y += 3.0f;
+		lights[5 * LIGHT_ALIAS_BLOCK_SIZE + 3].color.x = 0.0f;
+		lights[5 * LIGHT_ALIAS_BLOCK_SIZE + 3].color.y = 0.0f;
+		lights[5 * LIGHT_ALIAS_BLOCK_SIZE + 3].color.z = 0.0f;
+		table.Build(lights.data(), count, &_jobSystem);
+		CHECK(table.RebuiltBlocks() == 2);
+		LightAliasTable fresh;
+		fresh.Build(lights.data(), count);
+		CHECK(std::memcmp(table.Entries().data(), fresh.Entries().data(), fresh.Entries().size() * sizeof(LightAliasEntry)) == 0);
+	}
+
+	// with every light off there is nothing to pick, on the cpu or in the shader
+	void TestDark()
+	{
+		std::mt19937 random(7);
+		std::vector<Light> lights = MakeLights(10, random);
+		for (Light& light : lights)
+			light.color = XMFLOAT3(0.0f, 0.0f, 0.0f);
+		LightAliasTable table;
+		table.Build(lights.data(), static_cast<uint32_t>(lights.size()));
+		LightAliasSample sample;
+		uint32_t light;
+		float pmf;
+		CHECK(!table.Sample(0.5f, 0.5f, sample));
+		CHECK(!ShaderSample(table.Entries(), static_cast<uint32_t>(lights.size()), 0.5f, 0.5f, light, pmf));
+
+		LightAliasTable empty;
+		empty.Build(nullptr, 0);
+		CHECK(!empty.Sample(0.5f, 0.5f, sample));
+	}
+}
+
+int main()
+{
+	JobSystem jobSystem;
+	jobSystem.Init(3);
+	TestTable(jobSystem);
+	TestIncremental(jobSystem);
+	TestDark();
+	return CHECK_RESULT();
+}
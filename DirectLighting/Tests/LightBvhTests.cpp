@@ -0,0 +1,235 @@
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "Check.h"
+#include "JobSystem.h"
+#include "LightBvh.h"
+
+using namespace DirectX;
+
+namespace
+{
+	std::vector<Light> MakeLights(uint32_t _count, std::mt19937& _random)
+	{
+		std::uniform_real_distribution<float> spread(-100.0f, 100.0f);
+		std::uniform_real_distribution<float> range(1.0f, 40.0f);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		std::vector<Light> lights(_count);
+		for (Light& light : lights)
+		{
+			light.position = XMFLOAT3(spread(_random), spread(_random) * 0.1f, spread(_random));
+			light.range = range(_random);
+			light.color = XMFLOAT3(unit(_random), unit(_random), unit(_random));
+			light.type = unit(_random) < 0.3f ? LIGHT_SPOT : LIGHT_POINT;
+			XMStoreFloat3(&light.direction, XMVector3Normalize(XMVectorSet(spread(_random), spread(_random), spread(_random), 0.0f)));
+			light.cosOuterAngle = std::cos(0.1f + 1.2f * unit(_random));
+		}
+		return lights;
+	}
+
+	// whether the light actually reaches the point, the same test LightAttenuation does plus the side of the surface
+	bool Reaches(const Light& _light, const XMFLOAT3& _position, const XMFLOAT3& _normal)
+	{
+		float dx = _light.position.x - _position.x;
+		float dy = _light.position.y - _position.y;
+		float dz = _light.position.z - _position.z;
+		float distance = std::sqrt(dx * dx + dy * dy + dz * dz);
+		if (distance >= _light.range || distance <= 0.0f)
+			return false;
+		if (dx * _normal.x + dy * _normal.y + dz * _normal.z < 0.0f)
+			return false;
+		return _light.type != LIGHT_SPOT ||
+			-(dx * _light.direction.x + dy * _light.direction.y + dz * _light.direction.z) / distance >= _light.cosOuterAngle;
+	}
+
+	// every node has to hold the lights under it: a leaf sits on its light, an interior node's box, power and range
+	// cover both children's and its light count is theirs added up
+	bool Bounded(LightBvh& _bvh, const std::vector<Light>& _lights)
+	{
+		const std::vector<LightBvhNode>& nodes = _bvh.Nodes();
+		for (uint32_t i = 0; i < nodes.size(); ++i)
+		{
+			const LightBvhNode& node = nodes[i];
+			if (node.lightCount == 1)
+			{
+				const Light& light = _lights[node.secondChild];
+				if (std::memcmp(&node.boundsMin, &light.position, sizeof(XMFLOAT3)) != 0 ||
+					std::memcmp(&node.boundsMax, &light.position, sizeof(XMFLOAT3)) != 0 || node.range != light.range)
+					return false;
+				continue;
+			}
+			const LightBvhNode& first = nodes[i + 1];
+			const LightBvhNode& second = nodes[node.secondChild];
+			if (node.lightCount != first.lightCount + second.lightCount || node.secondChild != i + 2 * first.lightCount)
+				return false;
+			for (const LightBvhNode* pChild : { &first, &second })
+			{
+				if (pChild->boundsMin.x < node.boundsMin.x || pChild->boundsMin.y < node.boundsMin.y || pChild->boundsMin.z < node.boundsMin.z ||
+					pChild->boundsMax.x > node.boundsMax.x || pChild->boundsMax.y > node.boundsMax.y || pChild->boundsMax.z > node.boundsMax.z ||
+					pChild->range > node.range || pChild->power > node.power * 1.0001f)
+					return false;
+			}
+		}
+		return true;
+	}
+
+	// at random points every light that reaches the point has to be possible to pick and Sample has to report the
+	// probability Pmf gives for what it picked. the walk can end up under a node that gets nothing, so the pmfs only add
+	// up to the share of random numbers Sample finds a light for, which is counted over evenly spaced ones
+	void CheckSampling(LightBvh& _bvh, const std::vector<Light>& _lights, std::mt19937& _random, uint32_t _points)
+	{
+		const uint32_t strata = 4096;
+		std::uniform_real_distribution<float> spread(-100.0f, 100.0f);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		uint32_t reached = 0;
+		uint32_t missed = 0;
+		uint32_t wrongSum = 0;
+		uint32_t wrongPmf = 0;
+		for (uint32_t i = 0; i < _points; ++i)
+		{
+			XMFLOAT3 position(spread(_random), spread(_random) * 0.1f, spread(_random));
+			XMFLOAT3 normal(0.0f, 0.0f, 0.0f);
+			if (i % 2 == 0)
+				XMStoreFloat3(&normal, XMVector3Normalize(XMVectorSet(spread(_random), spread(_random), spread(_random), 0.0f)));
+
+			double sum = 0.0;
+			for (uint32_t light = 0; light < _lights.size(); ++light)
+			{
+				float pmf = _bvh.Pmf(position, normal, light);
+				sum += pmf;
+				if (Reaches(_lights[light], position, normal))
+				{
+					++reached;
+					missed += pmf > 0.0f ? 0 : 1;
+				}
+			}
+			uint32_t found = 0;
+			for (uint32_t j = 0; j < strata; ++j)
+			{
+				LightBvhSample sample;
+				found += _bvh.Sample(position, normal, (j + 0.5f) / strata, sample) ? 1 : 0;
+			}
+			if (sum > 1.0 + 1e-4 || std::abs(sum - static_cast<double>(found) / strata) > 0.01)
+				++wrongSum;
+
+			for (uint32_t j = 0; j < 32; ++j)
+			{
+				LightBvhSample sample;
+				if (!_bvh.Sample(position, normal, unit(_random), sample))
+					continue;
+				float pmf = _bvh.Pmf(position, normal, sample.light);
+				if (std::abs(pmf - sample.pmf) > 1e-5f * pmf || pmf <= 0.0f)
+					++wrongPmf;
+			}
+		}
+		CHECK(reached > 0 || _lights.size() < 1000);
+		CHECK(missed == 0);
+		CHECK(wrongSum == 0);
+		CHECK(wrongPmf == 0);
+	}
+
+	void TestBuild(JobSystem& _jobSystem)
+	{
+		std::mt19937 random(3);
+		for (uint32_t count : { 1u, 2u, 3u, 7u, 1000u, 20000u })
+		{
+			std::vector<Light> lights = MakeLights(count, random);
+			LightBvh serial;
+			LightBvh parallel;
+			serial.Build(lights.data(), count);
+			parallel.Build(lights.data(), count, &_jobSystem);
+			CHECK(serial.LightCount() == count);
+			CHECK(serial.Nodes().size() == 2 * count - 1);
+			// node indices only depend on the split, so however many threads built the tree it comes out the same
+			CHECK(serial.Nodes().size() == parallel.Nodes().size() &&
+				std::memcmp(serial.Nodes().data(), parallel.Nodes().data(), serial.Nodes().size() * sizeof(LightBvhNode)) == 0);
+			CHECK(Bounded(serial, lights));
+
+			// refitting lights that have not moved changes nothing
+			std::vector<LightBvhNode> built = parallel.Nodes();
+			parallel.Refit(lights.data(), &_jobSystem);
+			CHECK(std::memcmp(built.data(), parallel.Nodes().data(), built.size() * sizeof(LightBvhNode)) == 0);
+
+			CheckSampling(serial, lights, random, count > 1000 ? 10 : 100);
+		}
+	}
+
+	// after the lights move a refit tree is looser than a new one, but it still has to bound them and sample correctly
+	void TestRefit(JobSystem& _jobSystem)
+	{
+		std::mt19937 random(4);
+		std::uniform_real_distribution<float> offset(-5.0f, 5.0f);
+		std::uniform_real_distribution<float> scale(0.5f, 2.0f);
+		std::vector<Light> lights = MakeLights(5000, random);
+		LightBvh bvh;
+		bvh.Build(lights.data(), static_cast<uint32_t>(lights.size()), &_jobSystem);
+		for (Light& light : lights)
+		{
+			light.position.x += offset(random);
+			light.position.y += offset(random);
+			light.position.z += offset(random);
+			light.range *= scale(random);
+			light.color.x *= scale(random);
+		}
+		bvh.Refit(lights.data(), &_jobSystem);
+		CHECK(Bounded(bvh, lights));
+		CheckSampling(bvh, lights, random, 20);
+
+		LightBvh serial;
+		serial.Build(lights.data(), static_cast<uint32_t>(lights.size()));
+		std::vector<Light> moved = lights;
+		for (Light& light : moved)
+			light.position.y += 1.0f;
+		LightBvh parallel = serial;
+		serial.Refit(moved.data());
+		parallel.Refit(moved.data(), &_jobSystem);
+		CHECK(std::memcmp(serial.Nodes().data(), parallel.Nodes().data(), serial.Nodes().size() * sizeof(LightBvhNode)) == 0);
+	}
+
+	// the picks Sample makes follow Pmf, checked over many picks among a handful of lights around one point
+	void TestDistribution()
+	{
+		std::vector<Light> lights(8);
+		for (uint32_t i = 0; i < lights.size(); ++i)
+		{
+			Light& light = lights[i];
+			light.position = XMFLOAT3(2.0f * i - 7.0f, 1.0f + 0.25f * i, 0.5f * (i % 3));
+			light.range = 20.0f;
+			light.color = XMFLOAT3(1.0f + i, 1.0f, 1.0f);
+			light.type = LIGHT_POINT;
+			light.direction = XMFLOAT3(0.0f, -1.0f, 0.0f);
+			light.cosOuterAngle = -1.0f;
+		}
+		LightBvh bvh;
+		bvh.Build(lights.data(), static_cast<uint32_t>(lights.size()));
+
+		XMFLOAT3 position(0.5f, 0.0f, 0.0f);
+		XMFLOAT3 normal(0.0f, 1.0f, 0.0f);
+		const uint32_t picks = 200000;
+		std::vector<uint32_t> counts(lights.size(), 0);
+		for (uint32_t i = 0; i < picks; ++i)
+		{
+			LightBvhSample sample;
+			if (bvh.Sample(position, normal, (i + 0.5f) / picks, sample))
+				++counts[sample.light];
+		}
+		for (uint32_t light = 0; light < lights.size(); ++light)
+		{
+			double expected = bvh.Pmf(position, normal, light);
+			CHECK(expected > 0.0);
+			CHECK(std::abs(static_cast<double>(counts[light]) / picks - expected) < 1e-3);
+		}
+	}
+}
+
+int main()
+{
+	JobSystem jobSystem;
+	jobSystem.Init(3);
+	TestBuild(jobSystem);
+	TestRefit(jobSystem);
+	TestDistribution();
+	return CHECK_RESULT();
+}
@@ -0,0 +1,390 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "Check.h"
+#include "JobSystem.h"
+#include "LightmapBaker.h"
+#include "PathTracer.h"
+
+using namespace DirectX;
+
+namespace
+{
+	struct TestVertex
+	{
+		XMFLOAT3 position;
+		XMFLOAT4 color;
+	};
+
+	// a quad wound so its normal points along _outward, the way the baker reads which side is lit
+	void AddQuad(PathTracer& _scene, const XMFLOAT3 _corners[4], const XMFLOAT3& _outward)
+	{
+		TestVertex vertices[4];
+		for (uint32_t i = 0; i < 4; ++i)
+			vertices[i] = { _corners[i], XMFLOAT4(0.5f, 0.5f, 0.5f, 1.0f) };
+		XMVECTOR a = XMLoadFloat3(&_corners[0]);
+		XMVECTOR normal = XMVector3Cross(XMVectorSubtract(XMLoadFloat3(&_corners[1]), a), XMVectorSubtract(XMLoadFloat3(&_corners[2]), a));
+		bool flip = XMVectorGetX(XMVector3Dot(normal, XMLoadFloat3(&_outward))) < 0.0f;
+		uint32_t indices[6] = { 0, 1, 2, 0, 2, 3 };
+		if (flip)
+		{
+			std::swap(indices[1], indices[2]);
+			std::swap(indices[4], indices[5]);
+		}
+		XMFLOAT4X4 identity;
+		XMStoreFloat4x4(&identity, XMMatrixIdentity());
+		_scene.AddMesh(vertices, 4, sizeof(TestVertex), 0, sizeof(XMFLOAT3), indices, 6, identity);
+	}
+
+	// a floor at y = 0 reaching _extent each way
+	void AddFloor(PathTracer& _scene, float _extent)
+	{
+		XMFLOAT3 corners[4] =
+		{
+			XMFLOAT3(-_extent, 0.0f, -_extent), XMFLOAT3(-_extent, 0.0f, _extent), XMFLOAT3(_extent, 0.0f, _extent), XMFLOAT3(_extent, 0.0f, -_extent)
+		};
+		AddQuad(_scene, corners, XMFLOAT3(0.0f, 1.0f, 0.0f));
+	}
+
+	// a box from _min to _max, six quads facing out
+	void AddBox(PathTracer& _scene, const XMFLOAT3& _min, const XMFLOAT3& _max)
+	{
+		const float lo[3] = { _min.x, _min.y, _min.z };
+		const float hi[3] = { _max.x, _max.y, _max.z };
+		for (uint32_t face = 0; face < 6; ++face)
+		{
+			uint32_t axis = face / 2;
+			uint32_t u = (axis + 1) % 3;
+			uint32_t v = (axis + 2) % 3;
+			float corners[4][3];
+			for (uint32_t corner = 0; corner < 4; ++corner)
+			{
+				corners[corner][axis] = face % 2 == 0 ? lo[axis] : hi[axis];
+				corners[corner][u] = corner == 0 || corner == 3 ? lo[u] : hi[u];
+				corners[corner][v] = corner < 2 ? lo[v] : hi[v];
+			}
+			XMFLOAT3 points[4];
+			for (uint32_t corner = 0; corner < 4; ++corner)
+				points[corner] = XMFLOAT3(corners[corner][0], corners[corner][1], corners[corner][2]);
+			float outward[3] = { 0.0f, 0.0f, 0.0f };
+			outward[axis] = face % 2 == 0 ? -1.0f : 1.0f;
+			AddQuad(_scene, points, XMFLOAT3(outward[0], outward[1], outward[2]));
+		}
+	}
+
+	// the scene keeps no image, it is only there for its rays
+	void InitScene(PathTracer& _scene)
+	{
+		PathTracerDesc desc;
+		desc.width = 1;
+		desc.height = 1;
+		_scene.Init(desc);
+	}
+
+	float Dot(const XMFLOAT3& _a, const XMFLOAT3& _b) { return _a.x * _b.x + _a.y * _b.y + _a.z * _b.z; }
+
+	// the world space point at the centre of texel (_x, _y) of a chart as Save wrote it. the axes are at right angles
+	// to each other and to the normal, so each one gives its own part of the point
+	XMFLOAT3 TexelCentre(const LightmapFileChart& _chart, uint32_t _x, uint32_t _y)
+	{
+		float u = (_x + 0.5f + _chart.offsetU) / Dot(_chart.axisU, _chart.axisU);
+		float v = (_y + 0.5f + _chart.offsetV) / Dot(_chart.axisV, _chart.axisV);
+		return XMFLOAT3(
+			_chart.axisU.x * u + _chart.axisV.x * v + _chart.normal.x * _chart.planeDistance,
+			_chart.axisU.y * u + _chart.axisV.y * v + _chart.normal.y * _chart.planeDistance,
+			_chart.axisU.z * u + _chart.axisV.z * v + _chart.normal.z * _chart.planeDistance);
+	}
+
+	// the shared exponent keeps nine bits for the largest channel, so that one is good to a part in 512
+	void TestPacking()
+	{
+		std::mt19937 random(1);
+		std::uniform_real_distribution<float> exponent(-12.0f, 15.0f);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		uint32_t wrong = 0;
+		for (uint32_t i = 0; i < 100000; ++i)
+		{
+			float scale = std::exp2(exponent(random));
+			XMFLOAT3 color(scale * unit(random), scale * unit(random), scale * unit(random));
+			XMFLOAT3 unpacked = LightmapBaker::UnpackRGB9E5(LightmapBaker::PackRGB9E5(color));
+			float largest = std::max(color.x, std::max(color.y, color.z));
+			float tolerance = largest / 512.0f + 1e-30f;
+			if (std::abs(unpacked.x - color.x) > tolerance || std::abs(unpacked.y - color.y) > tolerance || std::abs(unpacked.z - color.z) > tolerance)
+				++wrong;
+		}
+		CHECK(wrong == 0);
+
+		CHECK(LightmapBaker::PackRGB9E5(XMFLOAT3(0.0f, 0.0f, 0.0f)) == 0);
+		XMFLOAT3 negative = LightmapBaker::UnpackRGB9E5(LightmapBaker::PackRGB9E5(XMFLOAT3(-1.0f, 2.0f, -3.0f)));
+		CHECK(negative.x == 0.0f && negative.y == 2.0f && negative.z == 0.0f);
+		XMFLOAT3 huge = LightmapBaker::UnpackRGB9E5(LightmapBaker::PackRGB9E5(XMFLOAT3(1e9f, 1.0f, 0.0f)));
+		CHECK(huge.x == 65408.0f);
+		// exact powers of two and the largest mantissa survive as they are
+		for (float value : { 1.0f, 0.5f, 1024.0f, 511.0f / 512.0f })
+			CHECK(LightmapBaker::UnpackRGB9E5(LightmapBaker::PackRGB9E5(XMFLOAT3(value, value, value))).x == value);
+	}
+
+	// a box on a floor: every triangle in one chart, the rectangles inside the lightmap and apart, and the corners'
+	// uvs inside their chart's rectangle
+	void TestCharts()
+	{
+		PathTracer scene;
+		InitScene(scene);
+		AddFloor(scene, 10.0f);
+		AddBox(scene, XMFLOAT3(-0.5f, 0.0f, -0.5f), XMFLOAT3(0.5f, 1.0f, 0.5f));
+		scene.Commit();
+
+		LightmapDesc desc;
+		desc.size = 256;
+		LightmapBaker baker;
+		CHECK(baker.Build(scene, desc));
+		const std::vector<LightmapChart>& charts = baker.Charts();
+		CHECK(charts.size() == 7);
+
+		std::vector<uint32_t> chartOfTriangle(scene.Indices().size() / 3, 0xffffffff);
+		uint32_t outside = 0;
+		uint32_t overlapping = 0;
+		uint32_t misplaced = 0;
+		for (uint32_t c = 0; c < charts.size(); ++c)
+		{
+			const LightmapChart& chart = charts[c];
+			if (chart.x + chart.width > desc.size || chart.y + chart.height > desc.size)
+				++outside;
+			for (uint32_t other = c + 1; other < charts.size(); ++other)
+			{
+				const LightmapChart& b = charts[other];
+				if (chart.x < b.x + b.width && b.x < chart.x + chart.width && chart.y < b.y + b.height && b.y < chart.y + chart.height)
+					++overlapping;
+			}
+			for (uint32_t i = 0; i < chart.triangleCount; ++i)
+			{
+				uint32_t triangle = baker.ChartTriangles()[chart.firstTriangle + i];
+				CHECK(chartOfTriangle[triangle] == 0xffffffff);
+				chartOfTriangle[triangle] = c;
+				// at least the padding in from the rectangle's edges
+				for (uint32_t corner = 0; corner < 3; ++corner)
+				{
+					XMFLOAT2 uv = baker.TriangleUvs()[triangle * 3 + corner];
+					float x = uv.x * desc.size;
+					float y = uv.y * desc.size;
+					if (x < chart.x + desc.padding - 1e-3f || x > chart.x + chart.width - desc.padding + 1e-3f ||
+						y < chart.y + desc.padding - 1e-3f || y > chart.y + chart.height - desc.padding + 1e-3f)
+						++misplaced;
+				}
+			}
+		}
+		CHECK(outside == 0);
+		CHECK(overlapping == 0);
+		CHECK(misplaced == 0);
+		CHECK(std::find(chartOfTriangle.begin(), chartOfTriangle.end(), 0xffffffff) == chartOfTriangle.end());
+
+		// the floor is twenty units across, 320 texels at 16 a unit, so the density had to come down to fit 256
+		CHECK(baker.TexelsPerUnit() < desc.texelsPerUnit);
+	}
+
+	// the floor alone under a point light and the sun has a closed form at every texel: I cos / d^2 plus the sun's
+	// colour times its cosine. the box then shadows the floor under it from a sun straight above
+	void TestIrradiance(JobSystem& _jobSystem)
+	{
+		PathTracer scene;
+		InitScene(scene);
+		AddFloor(scene, 4.0f);
+		Light light = {};
+		light.position = XMFLOAT3(1.0f, 2.0f, -0.5f);
+		light.range = 1e4f; // far enough that the window does not matter
+		light.color = XMFLOAT3(10.0f, 8.0f, 6.0f);
+		light.type = LIGHT_POINT;
+		light.direction = XMFLOAT3(0.0f, -1.0f, 0.0f);
+		light.cosOuterAngle = -1.0f;
+		scene.SetLights(&light, 1);
+		XMFLOAT3 sunDirection(std::sin(XM_PI / 3.0f), -std::cos(XM_PI / 3.0f), 0.0f);
+		scene.SetSun(sunDirection, XMFLOAT3(2.0f, 2.0f, 2.0f));
+		scene.Commit();
+
+		LightmapDesc desc;
+		desc.size = 256;
+		LightmapBaker baker;
+		CHECK(baker.Build(scene, desc));
+		CHECK(baker.Bake(scene, &_jobSystem) == 1);
+		CHECK(baker.Save("LightmapBakerTests.lmap"));
+		LightmapBaker::FileHeader header;
+		std::vector<uint32_t> texels;
+		std::vector<LightmapFileChart> charts;
+		CHECK(LightmapBaker::Load("LightmapBakerTests.lmap", header, texels, charts));
+		CHECK(charts.size() == 1);
+		if (charts.size() != 1)
+			return;
+
+		const LightmapChart& chart = baker.Charts()[0];
+		uint32_t checked = 0;
+		uint32_t wrong = 0;
+		for (uint32_t y = desc.padding; y < chart.height - desc.padding; ++y)
+		{
+			for (uint32_t x = desc.padding; x < chart.width - desc.padding; ++x)
+			{
+				XMFLOAT3 p = TexelCentre(charts[0], chart.x + x, chart.y + y);
+				if (std::abs(p.x) > 4.0f || std::abs(p.z) > 4.0f)
+					continue; // a texel on the edge whose centre is off the floor only got the padding
+				double dx = light.position.x - p.x;
+				double dy = light.position.y - p.y;
+				double dz = light.position.z - p.z;
+				double distanceSq = dx * dx + dy * dy + dz * dz;
+				double cosine = dy / std::sqrt(distanceSq);
+				double sun = 2.0 * std::cos(XM_PI / 3.0);
+				XMFLOAT3 texel = baker.Texel(chart.x + x, chart.y + y);
+				const double expected[3] = { 10.0 * cosine / distanceSq + sun, 8.0 * cosine / distanceSq + sun, 6.0 * cosine / distanceSq + sun };
+				const float got[3] = { texel.x, texel.y, texel.z };
+				for (uint32_t channel = 0; channel < 3; ++channel)
+				{
+					if (std::abs(got[channel] - expected[channel]) > 1e-3 * expected[channel])
+						++wrong;
+				}
+				++checked;
+			}
+		}
+		CHECK(checked > 1000);
+		CHECK(wrong == 0);
+
+		// the box shades the floor under it and a little way around, from the sun straight down only
+		scene.ClearScene();
+		AddFloor(scene, 4.0f);
+		AddBox(scene, XMFLOAT3(-1.0f, 0.0f, -1.0f), XMFLOAT3(1.0f, 1.0f, 1.0f));
+		scene.SetSun(XMFLOAT3(0.0f, -1.0f, 0.0f), XMFLOAT3(1.0f, 1.0f, 1.0f));
+		scene.Commit();
+		CHECK(baker.Build(scene, desc));
+		baker.Bake(scene, &_jobSystem);
+		CHECK(baker.Save("LightmapBakerTests.lmap"));
+		CHECK(LightmapBaker::Load("LightmapBakerTests.lmap", header, texels, charts));
+		uint32_t lit = 0;
+		uint32_t shadowed = 0;
+		wrong = 0;
+		for (uint32_t c = 0; c < charts.size(); ++c)
+		{
+			const LightmapChart& boxChart = baker.Charts()[c];
+			bool floor = charts[c].normal.y > 0.99f && charts[c].planeDistance == 0.0f;
+			bool top = charts[c].normal.y > 0.99f && charts[c].planeDistance == 1.0f;
+			for (uint32_t y = desc.padding; y < boxChart.height - desc.padding; ++y)
+			{
+				for (uint32_t x = desc.padding; x < boxChart.width - desc.padding; ++x)
+				{
+					XMFLOAT3 p = TexelCentre(charts[c], boxChart.x + x, boxChart.y + y);
+					float irradiance = baker.Texel(boxChart.x + x, boxChart.y + y).x;
+					float edge = std::max(std::abs(p.x), std::abs(p.z));
+					if (floor && edge < 0.95f)
+					{
+						wrong += irradiance != 0.0f ? 1 : 0;
+						++shadowed;
+					}
+					else if ((floor && edge > 1.05f && edge < 3.95f) || (top && edge < 0.95f))
+					{
+						wrong += irradiance != 1.0f ? 1 : 0;
+						++lit;
+					}
+					else if (!floor && !top)
+					{
+						// the sides face away from a sun straight down
+						wrong += irradiance != 0.0f ? 1 : 0;
+					}
+				}
+			}
+		}
+		CHECK(lit > 1000);
+		CHECK(shadowed > 100);
+		CHECK(wrong == 0);
+
+		// what Load gives back is what Save was given, and the file's charts put every corner where TriangleUvs does
+		CHECK(header.width == desc.size && header.height == desc.size && header.chartCount == baker.Charts().size());
+		CHECK(texels == baker.PackedTexels());
+		uint32_t misplaced = 0;
+		for (uint32_t c = 0; c < charts.size(); ++c)
+		{
+			const LightmapChart& boxChart = baker.Charts()[c];
+			for (uint32_t i = 0; i < boxChart.triangleCount; ++i)
+			{
+				uint32_t triangle = baker.ChartTriangles()[boxChart.firstTriangle + i];
+				for (uint32_t corner = 0; corner < 3; ++corner)
+				{
+					const XMFLOAT3& position = scene.Positions()[scene.Indices()[triangle * 3 + corner]];
+					XMFLOAT2 uv = baker.TriangleUvs()[triangle * 3 + corner];
+					float u = (Dot(position, charts[c].axisU) - charts[c].offsetU) / desc.size;
+					float v = (Dot(position, charts[c].axisV) - charts[c].offsetV) / desc.size;
+					if (std::abs(u - uv.x) > 1e-5f || std::abs(v - uv.y) > 1e-5f ||
+						std::abs(Dot(position, charts[c].normal) - charts[c].planeDistance) > 1e-5f)
+						++misplaced;
+				}
+			}
+		}
+		CHECK(misplaced == 0);
+
+		// anything else is refused
+		LightmapBaker::FileHeader wrongHeader = header;
+		wrongHeader.version = 1;
+		{
+			std::FILE* pFile = std::fopen("LightmapBakerTests.lmap", "r+b");
+			CHECK(pFile != nullptr);
+			if (pFile)
+			{
+				std::fwrite(&wrongHeader, sizeof(wrongHeader), 1, pFile);
+				std::fclose(pFile);
+			}
+		}
+		CHECK(!LightmapBaker::Load("LightmapBakerTests.lmap", header, texels, charts));
+		CHECK(!LightmapBaker::Load("LightmapBakerTests.missing", header, texels, charts));
+	}
+
+	// only the charts a changed light reaches are baked again, and they come out as a full bake would have them
+	void TestIncremental(JobSystem& _jobSystem)
+	{
+		PathTracer scene;
+		InitScene(scene);
+		AddFloor(scene, 4.0f);
+		AddBox(scene, XMFLOAT3(-1.0f, 0.0f, -1.0f), XMFLOAT3(1.0f, 1.0f, 1.0f));
+		Light light = {};
+		light.position = XMFLOAT3(0.0f, 0.5f, -1.5f); // in front of the box, reaching the floor and the front face only
+		light.range = 0.6f;
+		light.color = XMFLOAT3(1.0f, 1.0f, 1.0f);
+		light.type = LIGHT_POINT;
+		light.direction = XMFLOAT3(0.0f, -1.0f, 0.0f);
+		light.cosOuterAngle = -1.0f;
+		scene.SetLights(&light, 1);
+		scene.SetSun(XMFLOAT3(0.3f, -1.0f, 0.2f), XMFLOAT3(1.0f, 1.0f, 1.0f));
+		scene.Commit();
+
+		LightmapDesc desc;
+		desc.size = 256;
+		LightmapBaker baker;
+		CHECK(baker.Build(scene, desc));
+		CHECK(baker.Bake(scene, &_jobSystem) == 7);
+		CHECK(baker.Bake(scene, &_jobSystem) == 0);
+
+		light.color = XMFLOAT3(2.0f, 1.0f, 1.0f);
+		scene.SetLights(&light, 1);
+		scene.Commit();
+		CHECK(baker.Bake(scene, &_jobSystem) == 2);
+		LightmapBaker fresh;
+		CHECK(fresh.Build(scene, desc));
+		fresh.Bake(scene);
+		CHECK(baker.PackedTexels() == fresh.PackedTexels());
+
+		// the sun reaches everything, and Invalidate bakes everything whatever changed
+		scene.SetSun(XMFLOAT3(0.3f, -1.0f, 0.3f), XMFLOAT3(1.0f, 1.0f, 1.0f));
+		scene.Commit();
+		CHECK(baker.Bake(scene, &_jobSystem) == 7);
+		baker.Invalidate();
+		CHECK(baker.Bake(scene) == 7);
+	}
+}
+
+int main()
+{
+	JobSystem jobSystem;
+	jobSystem.Init(3);
+	TestPacking();
+	TestCharts();
+	TestIrradiance(jobSystem);
+	TestIncremental(jobSystem);
+	return CHECK_RESULT();
+}
@@ -0,0 +1,201 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Check.h"
+#include "JobSystem.h"
+#include "MeshFile.h"
+
+using namespace DirectX;
+
+namespace
+{
+	const uint32_t GRID_SIZE = 24; // quads along each side of the test grid
+
+	// a bumpy grid of GRID_SIZE * GRID_SIZE quads as an obj
+	void WriteGrid(const std::string& _fileName)
+	{
+		std::ofstream file(_fileName, std::ios::binary);
+		for (uint32_t y = 0; y <= GRID_SIZE; ++y)
+		{
+			for (uint32_t x = 0; x <= GRID_SIZE; ++x)
+				file << "v " << x * 0.5f << " " << 0.1f * ((x * 3 + y * 5) % 4) << " " << y * 0.5f << "\n";
+		}
+		for (uint32_t y = 0; y < GRID_SIZE; ++y)
+		{
+			for (uint32_t x = 0; x < GRID_SIZE; ++x)
+			{
+				uint32_t corner = y * (GRID_SIZE + 1) + x + 1;
+				file << "f " << corner << " " << corner + GRID_SIZE + 1 << " " << corner + GRID_SIZE + 2 << " " << corner + 1 << "\n";
+			}
+		}
+	}
+
+	std::vector<char> ReadBytes(const std::string& _fileName)
+	{
+		std::ifstream file(_fileName, std::ios::binary);
+		return std::vector<char>((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	}
+
+	void WriteBytes(const std::string& _fileName, const std::vector<char>& _bytes, size_t _size)
+	{
+		std::ofstream file(_fileName, std::ios::binary);
+		file.write(_bytes.data(), _size);
+	}
+
+	// the checksum is the same whichever thread hashed which block, and any flipped bit changes it
+	void TestChecksum(JobSystem& _jobSystem)
+	{
+		std::mt19937 random(1);
+		std::vector<uint8_t> data(3 * 1024 * 1024 + 13);
+		for (uint8_t& byte : data)
+			byte = static_cast<uint8_t>(random());
+		for (uint64_t size : { 0ull, 1ull, 7ull, 8ull, 33ull, 1024ull * 1024ull, static_cast<unsigned long long>(data.size()) })
+			CHECK(MeshFile::Checksum(data.data(), size) == MeshFile::Checksum(data.data(), size, &_jobSystem));
+
+		uint64_t checksum = MeshFile::Checksum(data.data(), data.size(), &_jobSystem);
+		uint32_t unchanged = 0;
+		for (uint32_t i = 0; i < 64; ++i)
+		{
+			size_t byte = random() % data.size();
+			uint8_t bit = static_cast<uint8_t>(1 << (random() % 8));
+			data[byte] ^= bit;
+			if (MeshFile::Checksum(data.data(), data.size(), &_jobSystem) == checksum)
+				++unchanged;
+			data[byte] ^= bit;
+		}
+		CHECK(unchanged == 0);
+
+		// two sign bits 32 bytes apart land in the same lane, where multiplies alone would let the flips cancel
+		float floats[16];
+		for (uint32_t i = 0; i < 16; ++i)
+			floats[i] = 1.0f + i;
+		checksum = MeshFile::Checksum(floats, sizeof(floats));
+		floats[1] = -floats[1];
+		floats[9] = -floats[9];
+		CHECK(MeshFile::Checksum(floats, sizeof(floats)) != checksum);
+		for (uint32_t word = 0; word < 4; ++word)
+		{
+			uint64_t words[8] = {};
+			checksum = MeshFile::Checksum(words, sizeof(words));
+			words[word] ^= 1ull << 63;
+			words[word + 4] ^= 1ull << 63;
+			CHECK(MeshFile::Checksum(words, sizeof(words)) != checksum);
+		}
+	}
+
+	// a converted grid opens with everything in place: packed vertices inside the bounds, 16 bit indices, the full
+	// level's submeshes covering every triangle of the grid, and the source's stamp
+	void TestConvert(JobSystem& _jobSystem)
+	{
+		WriteGrid("Grid.obj");
+		MeshOptimizeStats stats;
+		CHECK(MeshFile::Convert("Grid.obj", "Grid.mesh", &_jobSystem, &stats));
+
+		MeshFile mesh;
+		CHECK(mesh.Open("Grid.mesh", true, &_jobSystem));
+		if (!mesh.IsOpen())
+			return;
+		const MeshFileHeader& header = mesh.Header();
+		CHECK(header.magic == MeshFile::FILE_MAGIC && header.version == MeshFile::FILE_VERSION);
+		CHECK(header.vertexCount == (GRID_SIZE + 1) * (GRID_SIZE + 1));
+		CHECK(header.vertexStride == sizeof(PackedVertex));
+		CHECK(header.indexSize == 2);
+		CHECK(mesh.VertexBytes() == header.vertexCount * sizeof(PackedVertex));
+		CHECK(reinterpret_cast<uintptr_t>(mesh.Vertices()) % MeshFile::SECTION_ALIGNMENT == 0);
+		CHECK(reinterpret_cast<uintptr_t>(mesh.Indices()) % MeshFile::SECTION_ALIGNMENT == 0);
+
+		const MeshVertexAttribute* pPosition = mesh.FindAttribute(MESH_SEMANTIC_POSITION);
+		CHECK(pPosition && pPosition->format == MeshFile::FORMAT_UNORM16X4 && pPosition->offset == 0);
+		CHECK(mesh.FindAttribute(MESH_SEMANTIC_NORMAL) && mesh.FindAttribute(MESH_SEMANTIC_COLOR));
+		CHECK(!mesh.FindAttribute(MESH_SEMANTIC_TEXCOORD));
+
+		CHECK(mesh.LodCount() >= 1);
+		const MeshLod& full = mesh.Lods()[0];
+		CHECK(full.error == 0.0f);
+		uint32_t fullIndices = 0;
+		for (uint32_t i = 0; i < full.submeshCount; ++i)
+			fullIndices += mesh.Submeshes()[full.firstSubmesh + i].indexCount;
+		CHECK(fullIndices == GRID_SIZE * GRID_SIZE * 6);
+		const uint16_t* pIndices = static_cast<const uint16_t*>(mesh.Indices());
+		uint32_t outOfRange = 0;
+		for (uint32_t i = 0; i < header.indexCount; ++i)
+			outOfRange += pIndices[i] >= header.vertexCount ? 1 : 0;
+		CHECK(outOfRange == 0);
+
+		// every grid point comes back to within a step of the 16 bit quantisation
+		CHECK(std::abs(header.boundsMax.x - GRID_SIZE * 0.5f) < 1e-5f && std::abs(header.boundsMax.z - GRID_SIZE * 0.5f) < 1e-5f);
+		const PackedVertex* pVertices = static_cast<const PackedVertex*>(mesh.Vertices());
+		uint32_t offGrid = 0;
+		for (uint32_t i = 0; i < header.vertexCount; ++i)
+		{
+			XMFLOAT3 position = VertexCompression::DecodePosition(pVertices[i].position, header.boundsMin, header.boundsMax);
+			float x = position.x / 0.5f;
+			float z = position.z / 0.5f;
+			if (std::abs(x - std::round(x)) > 1e-3f || std::abs(z - std::round(z)) > 1e-3f)
+				++offGrid;
+		}
+		CHECK(offGrid == 0);
+
+		uint64_t sourceSize;
+		uint64_t sourceTime;
+		MeshFile::SourceStamp("Grid.obj", sourceSize, sourceTime);
+		CHECK(sourceSize > 0 && header.sourceSize == sourceSize && header.sourceTime == sourceTime);
+		mesh.Close();
+		CHECK(!mesh.IsOpen());
+	}
+
+	// a flipped byte in a section only gets through with the checksums off, while a truncated file, another version
+	// and a changed header never open
+	void TestDamage()
+	{
+		std::vector<char> bytes = ReadBytes("Grid.mesh");
+		CHECK(bytes.size() > sizeof(MeshFileHeader));
+		if (bytes.size() <= sizeof(MeshFileHeader))
+			return;
+		MeshFile mesh;
+
+		std::vector<char> damaged = bytes;
+		damaged[damaged.size() - 1] ^= 0x10;
+		WriteBytes("Damaged.mesh", damaged, damaged.size());
+		CHECK(!mesh.Open("Damaged.mesh"));
+		CHECK(mesh.Open("Damaged.mesh", false));
+		mesh.Close();
+
+		WriteBytes("Truncated.mesh", bytes, bytes.size() - 1);
+		CHECK(!mesh.Open("Truncated.mesh", false));
+
+		MeshFileHeader header;
+		memcpy(&header, bytes.data(), sizeof(header));
+		std::vector<char> changed = bytes;
+		header.version = MeshFile::FILE_VERSION - 1;
+		memcpy(changed.data(), &header, sizeof(header));
+		WriteBytes("OldVersion.mesh", changed, changed.size());
+		CHECK(!mesh.Open("OldVersion.mesh", false));
+
+		memcpy(&header, bytes.data(), sizeof(header));
+		header.vertexCount += 1;
+		memcpy(changed.data(), &header, sizeof(header));
+		WriteBytes("ChangedHeader.mesh", changed, changed.size());
+		CHECK(!mesh.Open("ChangedHeader.mesh", false));
+
+		CHECK(!mesh.Open("Missing.mesh"));
+		CHECK(!MeshFile::Convert("Missing.obj", "Missing.mesh"));
+	}
+}
+
+int main()
+{
+	JobSystem jobSystem;
+	jobSystem.Init(3);
+
+	TestChecksum(jobSystem);
+	TestConvert(jobSystem);
+	TestDamage();
+	return CHECK_RESULT();
+}
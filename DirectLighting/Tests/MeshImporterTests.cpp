@@ -0,0 +1,204 @@
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "Check.h"
+#include "JobSystem.h"
+#include "MeshImporter.h"
+
+using namespace DirectX;
+
+namespace
+{
+	void WriteText(const std::string& _fileName, const std::string& _text)
+	{
+		std::ofstream file(_fileName, std::ios::binary);
+		file << _text;
+	}
+
+	bool Near(const XMFLOAT3& _a, float _x, float _y, float _z)
+	{
+		return std::abs(_a.x - _x) < 1e-6f && std::abs(_a.y - _y) < 1e-6f && std::abs(_a.z - _z) < 1e-6f;
+	}
+
+	bool SameMesh(const ImportedMesh& _a, const ImportedMesh& _b)
+	{
+		return _a.indices == _b.indices && _a.vertices.size() == _b.vertices.size() &&
+			memcmp(_a.vertices.data(), _b.vertices.data(), _a.vertices.size() * sizeof(MeshVertex)) == 0;
+	}
+
+	// two quads sharing an edge, the second with relative indices, and a triangle that reuses the first quad's corners
+	void TestObj()
+	{
+		WriteText("Quads.obj",
+			"# two quads\n"
+			"v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nv 2 0 0\nv 2 1 0\n"
+			"vt 0 0\nvt 1 0\nvt 1 1\nvt 0 1\n"
+			"vn 0 0 1\n"
+			"f 1/1/1 2/2/1 3/3/1 4/4/1\n"
+			"f -5/-4/-1 -2/-3/-1 -1/-2/-1 -4/-1/-1\r\n"
+			"f 1/1/1 2/2/1 3/3/1");
+		MeshImporter importer;
+		ImportedMesh mesh;
+		CHECK(importer.Load("Quads.obj", mesh));
+		CHECK(mesh.indices.size() == 15);
+		// the second quad starts at the first one's corner 2 with another uv, so that is a vertex of its own. the
+		// triangle at the end reuses three of the first quad's
+		CHECK(mesh.vertices.size() == 8);
+		CHECK(importer.Stats().corners == 15 && importer.Stats().vertices == 8);
+		CHECK(mesh.hasNormals && mesh.hasUvs && !mesh.hasColors);
+		CHECK(Near(mesh.boundsMin, 0.0f, 0.0f, 0.0f) && Near(mesh.boundsMax, 2.0f, 1.0f, 0.0f));
+
+		// faces are fanned from their first corner
+		const uint32_t quad[6] = { 0, 1, 2, 0, 2, 3 };
+		for (uint32_t i = 0; i < 6; ++i)
+			CHECK(mesh.indices[i] == quad[i]);
+		CHECK(Near(mesh.vertices[mesh.indices[6]].position, 1.0f, 0.0f, 0.0f));
+		CHECK(Near(mesh.vertices[mesh.indices[7]].position, 2.0f, 0.0f, 0.0f));
+		CHECK(Near(mesh.vertices[mesh.indices[8]].position, 2.0f, 1.0f, 0.0f));
+		CHECK(mesh.vertices[mesh.indices[6]].uv.x == 0.0f && mesh.vertices[mesh.indices[7]].uv.x == 1.0f);
+		CHECK(mesh.indices[12] == 0 && mesh.indices[13] == 1 && mesh.indices[14] == 2);
+		for (const MeshVertex& vertex : mesh.vertices)
+			CHECK(Near(vertex.normal, 0.0f, 0.0f, 1.0f) && vertex.color.x == 1.0f && vertex.color.w == 1.0f);
+
+		// without normals they come from the triangles, and the colour extension is read
+		WriteText("Coloured.obj", "v 0 0 0 1 0 0\nv 1 0 0 0 1 0\nv 0 1 0 0 0 1\nf 1 2 3\n");
+		CHECK(importer.Load("Coloured.obj", mesh));
+		CHECK(!mesh.hasNormals && !mesh.hasUvs && mesh.hasColors);
+		CHECK(mesh.vertices.size() == 3);
+		CHECK(Near(mesh.vertices[0].normal, 0.0f, 0.0f, 1.0f));
+		CHECK(mesh.vertices[1].color.x == 0.0f && mesh.vertices[1].color.y == 1.0f && mesh.vertices[1].color.z == 0.0f);
+
+		// a face pointing at a vertex that does not exist is malformed
+		WriteText("Broken.obj", "v 0 0 0\nv 1 0 0\nf 1 2 3\n");
+		CHECK(!importer.Load("Broken.obj", mesh));
+		CHECK(!importer.Load("Missing.obj", mesh));
+		CHECK(!importer.Load("Quads.txt", mesh));
+	}
+
+	// a grid big enough to cross many windows and chunks comes out the same through tiny ones on the job system as
+	// through one window on one thread, welded down to a vertex per grid point
+	void TestObjChunks(JobSystem& _jobSystem)
+	{
+		const uint32_t size = 100;
+		std::string text;
+		for (uint32_t y = 0; y <= size; ++y)
+		{
+			for (uint32_t x = 0; x <= size; ++x)
+				text += "v " + std::to_string(x * 0.25f) + " " + std::to_string(y * 0.5f) + " -1.5e-1\n";
+		}
+		text += "vn 0 0 -1\n";
+		for (uint32_t y = 0; y < size; ++y)
+		{
+			for (uint32_t x = 0; x < size; ++x)
+			{
+				uint32_t corner = y * (size + 1) + x + 1;
+				text += "f " + std::to_string(corner) + "//1 " + std::to_string(corner + size + 1) + "//1 " +
+					std::to_string(corner + size + 2) + "//1 " + std::to_string(corner + 1) + "//1\n";
+			}
+		}
+		WriteText("Grid.obj", text);
+
+		MeshImporter importer;
+		ImportedMesh whole;
+		CHECK(importer.Load("Grid.obj", whole));
+		CHECK(whole.vertices.size() == (size + 1) * (size + 1));
+		CHECK(whole.indices.size() == size * size * 6);
+		CHECK(Near(whole.boundsMax, size * 0.25f, size * 0.5f, -0.15f));
+
+		MeshImportDesc desc;
+		desc.windowSize = 4096;
+		desc.chunkSize = 300;
+		ImportedMesh chunked;
+		CHECK(importer.Load("Grid.obj", chunked, &_jobSystem, desc));
+		CHECK(SameMesh(whole, chunked));
+
+		// without welding every triangle corner is its own vertex
+		desc.weld = false;
+		ImportedMesh unwelded;
+		CHECK(importer.Load("Grid.obj", unwelded, &_jobSystem, desc));
+		CHECK(unwelded.vertices.size() == size * size * 6);
+	}
+
+	// a glb with a json chunk padded with spaces and a binary chunk padded with zeros
+	void WriteGlb(const std::string& _fileName, std::string _json, std::vector<uint8_t> _binary)
+	{
+		while (_json.size() % 4 != 0)
+			_json += ' ';
+		while (_binary.size() % 4 != 0)
+			_binary.push_back(0);
+		uint32_t header[3] = { 0x46546c67, 2, static_cast<uint32_t>(12 + 8 + _json.size() + 8 + _binary.size()) };
+		uint32_t jsonChunk[2] = { static_cast<uint32_t>(_json.size()), 0x4e4f534a };
+		uint32_t binaryChunk[2] = { static_cast<uint32_t>(_binary.size()), 0x004e4942 };
+		std::ofstream file(_fileName, std::ios::binary);
+		file.write(reinterpret_cast<const char*>(header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(jsonChunk), sizeof(jsonChunk));
+		file.write(_json.data(), _json.size());
+		file.write(reinterpret_cast<const char*>(binaryChunk), sizeof(binaryChunk));
+		file.write(reinterpret_cast<const char*>(_binary.data()), _binary.size());
+	}
+
+	// one triangle with 16 bit indices, placed by a translated node. gltf is right handed, so the default flip negates
+	// z and reverses the winding
+	void TestGltf()
+	{
+		const float positions[9] = { 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f };
+		const uint16_t indices[3] = { 0, 1, 2 };
+		std::vector<uint8_t> binary(sizeof(positions) + sizeof(indices));
+		memcpy(binary.data(), positions, sizeof(positions));
+		memcpy(binary.data() + sizeof(positions), indices, sizeof(indices));
+		std::string json =
+			"{\"asset\":{\"version\":\"2.0\"},\"scene\":0,\"scenes\":[{\"nodes\":[0]}],"
+			"\"nodes\":[{\"mesh\":0,\"translation\":[1,2,3]}],"
+			"\"meshes\":[{\"primitives\":[{\"attributes\":{\"POSITION\":0},\"indices\":1}]}],"
+			"\"buffers\":[{\"byteLength\":42}],"
+			"\"bufferViews\":[{\"buffer\":0,\"byteOffset\":0,\"byteLength\":36},{\"buffer\":0,\"byteOffset\":36,\"byteLength\":6}],"
+			"\"accessors\":[{\"bufferView\":0,\"componentType\":5126,\"count\":3,\"type\":\"VEC3\"},"
+			"{\"bufferView\":1,\"componentType\":5123,\"count\":3,\"type\":\"SCALAR\"}]}";
+		WriteGlb("Triangle.glb", json, binary);
+
+		MeshImporter importer;
+		ImportedMesh mesh;
+		CHECK(importer.Load("Triangle.glb", mesh));
+		CHECK(mesh.vertices.size() == 3 && mesh.indices.size() == 3);
+		CHECK(Near(mesh.boundsMin, 1.0f, 2.0f, -3.0f) && Near(mesh.boundsMax, 2.0f, 3.0f, -3.0f));
+		// the same three corners, the other way round
+		const XMFLOAT3& a = mesh.vertices[mesh.indices[0]].position;
+		const XMFLOAT3& b = mesh.vertices[mesh.indices[1]].position;
+		const XMFLOAT3& c = mesh.vertices[mesh.indices[2]].position;
+		XMVECTOR normal = XMVector3Cross(XMVectorSubtract(XMLoadFloat3(&b), XMLoadFloat3(&a)), XMVectorSubtract(XMLoadFloat3(&c), XMLoadFloat3(&a)));
+		CHECK(XMVectorGetZ(normal) < 0.0f);
+
+		MeshImportDesc desc;
+		desc.flipGltfHandedness = false;
+		CHECK(importer.Load("Triangle.glb", mesh, nullptr, desc));
+		CHECK(Near(mesh.boundsMin, 1.0f, 2.0f, 3.0f));
+		CHECK(mesh.indices[0] == 0 && mesh.indices[1] == 1 && mesh.indices[2] == 2);
+
+		// an accessor reaching past its buffer, and a chunk longer than the file, are malformed
+		std::string overrun = json;
+		overrun.replace(overrun.find("\"count\":3"), 9, "\"count\":9");
+		WriteGlb("Overrun.glb", overrun, binary);
+		CHECK(!importer.Load("Overrun.glb", mesh));
+		std::ifstream in("Triangle.glb", std::ios::binary);
+		std::vector<char> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+		std::ofstream truncated("Truncated.glb", std::ios::binary);
+		truncated.write(bytes.data(), bytes.size() - 8);
+		truncated.close();
+		CHECK(!importer.Load("Truncated.glb", mesh));
+	}
+}
+
+int main()
+{
+	JobSystem jobSystem;
+	jobSystem.Init(3);
+
+	TestObj();
+	TestObjChunks(jobSystem);
+	TestGltf();
+	return CHECK_RESULT();
+}
@@ -0,0 +1,262 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "Check.h"
+#include "JobSystem.h"
+#include "MeshImporter.h"
+#include "MeshOptimizer.h"
+
+using namespace DirectX;
+
+namespace
+{
+	typedef std::array<float, 9> TriangleKey;
+
+	MeshVertex Vertex(float _x, float _y, float _z)
+	{
+		MeshVertex vertex;
+		vertex.position = XMFLOAT3(_x, _y, _z);
+		vertex.normal = XMFLOAT3(0.0f, 1.0f, 0.0f);
+		vertex.uv = XMFLOAT2(_x, _z);
+		vertex.color = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
+		return vertex;
+	}
+
+	// _size * _size quads with their triangles in random order, so the cache order has something to fix
+	ImportedMesh ShuffledGrid(uint32_t _size, uint32_t _seed)
+	{
+		ImportedMesh mesh;
+		for (uint32_t y = 0; y <= _size; ++y)
+		{
+			for (uint32_t x = 0; x <= _size; ++x)
+				mesh.vertices.push_back(Vertex(static_cast<float>(x), 0.01f * ((x * 3 + y * 5) % 7), static_cast<float>(y)));
+		}
+		std::vector<std::array<uint32_t, 3>> triangles;
+		for (uint32_t y = 0; y < _size; ++y)
+		{
+			for (uint32_t x = 0; x < _size; ++x)
+			{
+				uint32_t a = y * (_size + 1) + x;
+				uint32_t b = a + _size + 1;
+				triangles.push_back({ { a, b, b + 1 } });
+				triangles.push_back({ { a, b + 1, a + 1 } });
+			}
+		}
+		std::mt19937 random(_seed);
+		std::shuffle(triangles.begin(), triangles.end(), random);
+		for (const std::array<uint32_t, 3>& triangle : triangles)
+			mesh.indices.insert(mesh.indices.end(), triangle.begin(), triangle.end());
+		return mesh;
+	}
+
+	// a closed uv sphere, so the overdraw pass has clusters facing every way
+	ImportedMesh Sphere(uint32_t _rings, uint32_t _segments)
+	{
+		ImportedMesh mesh;
+		for (uint32_t ring = 0; ring <= _rings; ++ring)
+		{
+			float theta = 3.14159265f * ring / _rings;
+			for (uint32_t segment = 0; segment < _segments; ++segment)
+			{
+				float phi = 2.0f * 3.14159265f * segment / _segments;
+				mesh.vertices.push_back(Vertex(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi)));
+			}
+		}
+		for (uint32_t ring = 0; ring < _rings; ++ring)
+		{
+			for (uint32_t segment = 0; segment < _segments; ++segment)
+			{
+				uint32_t a = ring * _segments + segment;
+				uint32_t b = ring * _segments + (segment + 1) % _segments;
+				uint32_t c = a + _segments;
+				uint32_t d = b + _segments;
+				const uint32_t quad[6] = { a, b, d, a, d, c };
+				mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+			}
+		}
+		return mesh;
+	}
+
+	// every triangle as its three positions, turned so the smallest comes first without changing the winding, and
+	// sorted. two meshes with the same keys draw the same triangles facing the same way, however they are numbered
+	std::vector<TriangleKey> TriangleKeys(const ImportedMesh& _mesh)
+	{
+		std::vector<TriangleKey> keys;
+		for (size_t i = 0; i + 2 < _mesh.indices.size(); i += 3)
+		{
+			std::array<std::array<float, 3>, 3> corners;
+			for (uint32_t corner = 0; corner < 3; ++corner)
+			{
+				const XMFLOAT3& position = _mesh.vertices[_mesh.indices[i + corner]].position;
+				corners[corner] = { { position.x, position.y, position.z } };
+			}
+			std::rotate(corners.begin(), std::min_element(corners.begin(), corners.end()), corners.end());
+			TriangleKey key;
+			for (uint32_t corner = 0; corner < 3; ++corner)
+				memcpy(&key[corner * 3], corners[corner].data(), sizeof(float) * 3);
+			keys.push_back(key);
+		}
+		std::sort(keys.begin(), keys.end());
+		return keys;
+	}
+
+	bool SameMesh(const ImportedMesh& _a, const ImportedMesh& _b)
+	{
+		return _a.indices == _b.indices && _a.vertices.size() == _b.vertices.size() &&
+			memcmp(_a.vertices.data(), _b.vertices.data(), _a.vertices.size() * sizeof(MeshVertex)) == 0;
+	}
+
+	// the fifo simulation counted by hand: a triangle costs three misses, a second one sharing an edge one more, and
+	// a vertex that has been pushed out of the cache is a miss again
+	void TestAnalyze()
+	{
+		const uint32_t quad[6] = { 0, 1, 2, 0, 2, 3 };
+		VertexCacheStats stats = MeshOptimizer::AnalyzeVertexCache(quad, 6, 4);
+		CHECK(stats.acmr == 2.0f && stats.atvr == 1.0f);
+
+		const uint32_t evicting[9] = { 0, 1, 2, 3, 4, 5, 0, 1, 2 };
+		stats = MeshOptimizer::AnalyzeVertexCache(evicting, 9, 6, 4);
+		CHECK(stats.acmr == 3.0f && stats.atvr == 1.5f);
+		stats = MeshOptimizer::AnalyzeVertexCache(evicting, 9, 6, 6);
+		CHECK(stats.acmr == 2.0f && stats.atvr == 1.0f);
+
+		stats = MeshOptimizer::AnalyzeVertexCache(quad, 0, 4);
+		CHECK(stats.acmr == 0.0f && stats.atvr == 0.0f);
+	}
+
+	// tipsify alone, then with the overdraw sort, keeps every triangle and its winding, and never makes the cache do
+	// worse than the shuffled order. the sort stays within its threshold of the cache order
+	void TestVertexCache()
+	{
+		ImportedMesh grid = ShuffledGrid(64, 1);
+		std::vector<TriangleKey> keys = TriangleKeys(grid);
+		uint32_t indexCount = static_cast<uint32_t>(grid.indices.size());
+		uint32_t vertexCount = static_cast<uint32_t>(grid.vertices.size());
+		VertexCacheStats shuffled = MeshOptimizer::AnalyzeVertexCache(grid.indices.data(), indexCount, vertexCount);
+
+		MeshOptimizer::OptimizeVertexCache(grid.indices.data(), indexCount, vertexCount);
+		CHECK(TriangleKeys(grid) == keys);
+		VertexCacheStats cacheOrder = MeshOptimizer::AnalyzeVertexCache(grid.indices.data(), indexCount, vertexCount);
+		printf("grid acmr %.3f shuffled, %.3f tipsify\n", shuffled.acmr, cacheOrder.acmr);
+		CHECK(cacheOrder.acmr <= shuffled.acmr);
+		CHECK(cacheOrder.acmr < 0.8f && cacheOrder.atvr < 1.5f);
+
+		// running it again on its own output keeps the triangles and does not undo the gain
+		MeshOptimizer::OptimizeVertexCache(grid.indices.data(), indexCount, vertexCount);
+		CHECK(TriangleKeys(grid) == keys);
+		CHECK(MeshOptimizer::AnalyzeVertexCache(grid.indices.data(), indexCount, vertexCount).acmr <= shuffled.acmr);
+
+		ImportedMesh sphere = Sphere(24, 48);
+		keys = TriangleKeys(sphere);
+		indexCount = static_cast<uint32_t>(sphere.indices.size());
+		vertexCount = static_cast<uint32_t>(sphere.vertices.size());
+		MeshOptimizer::OptimizeVertexCache(sphere.indices.data(), indexCount, vertexCount);
+		cacheOrder = MeshOptimizer::AnalyzeVertexCache(sphere.indices.data(), indexCount, vertexCount);
+		uint32_t clusters = MeshOptimizer::OptimizeOverdraw(sphere.indices.data(), indexCount, &sphere.vertices[0].position.x, sizeof(MeshVertex),
+			vertexCount, 16, 1.05f);
+		CHECK(TriangleKeys(sphere) == keys);
+		CHECK(clusters > 1);
+		VertexCacheStats sorted = MeshOptimizer::AnalyzeVertexCache(sphere.indices.data(), indexCount, vertexCount);
+		printf("sphere acmr %.3f tipsify, %.3f after sorting %u clusters\n", cacheOrder.acmr, sorted.acmr, clusters);
+		// each cut starts a cluster with a cold cache, which the threshold allows for, plus the few vertices a
+		// cluster would otherwise have found left over from the one before it
+		CHECK(sorted.acmr <= cacheOrder.acmr * 1.05f + 0.05f);
+	}
+
+	// vertex fetch order numbers the vertices as the indices first reach them and drops those nothing uses
+	void TestVertexFetch()
+	{
+		ImportedMesh mesh;
+		for (uint32_t i = 0; i < 5; ++i)
+			mesh.vertices.push_back(Vertex(static_cast<float>(i), 0.0f, 0.0f));
+		mesh.indices = { 3, 1, 4, 4, 1, 0 };
+		std::vector<uint32_t> remap;
+		MeshOptimizer::OptimizeVertexFetch(mesh, &remap);
+		CHECK(mesh.vertices.size() == 4);
+		const uint32_t indices[6] = { 0, 1, 2, 2, 1, 3 };
+		CHECK(std::equal(mesh.indices.begin(), mesh.indices.end(), indices));
+		CHECK(remap.size() == 5 && remap[3] == 0 && remap[1] == 1 && remap[4] == 2 && remap[0] == 3 && remap[2] == 0xffffffff);
+		CHECK(mesh.vertices[0].position.x == 3.0f && mesh.vertices[3].position.x == 0.0f);
+	}
+
+	// the whole pipeline keeps the triangle set, reports acmr that went down and matches what AnalyzeVertexCache
+	// says, gives the same bytes every time, and OptimizeMeshes on the job system is Optimize on each mesh
+	void TestOptimize(JobSystem& _jobSystem)
+	{
+		std::vector<ImportedMesh> meshes;
+		for (uint32_t seed = 0; seed < 6; ++seed)
+			meshes.push_back(ShuffledGrid(20 + seed * 7, seed));
+		meshes.push_back(Sphere(16, 32));
+
+		std::vector<ImportedMesh> serial = meshes;
+		std::vector<MeshOptimizeStats> serialStats(meshes.size());
+		for (size_t i = 0; i < serial.size(); ++i)
+		{
+			std::vector<TriangleKey> keys = TriangleKeys(serial[i]);
+			MeshOptimizer::Optimize(serial[i], MeshOptimizeDesc(), &serialStats[i]);
+			CHECK(TriangleKeys(serial[i]) == keys);
+			CHECK(serialStats[i].after.acmr <= serialStats[i].before.acmr);
+			CHECK(serialStats[i].clusterCount >= 1);
+			VertexCacheStats after = MeshOptimizer::AnalyzeVertexCache(serial[i].indices.data(), static_cast<uint32_t>(serial[i].indices.size()),
+				static_cast<uint32_t>(serial[i].vertices.size()));
+			CHECK(after.acmr == serialStats[i].after.acmr);
+
+			// the vertices come in the order they are first used
+			uint32_t next = 0;
+			uint32_t late = 0;
+			for (uint32_t index : serial[i].indices)
+			{
+				late += index > next ? 1 : 0;
+				next = std::max(next, index + 1);
+			}
+			CHECK(late == 0 && next == serial[i].vertices.size());
+		}
+
+		std::vector<ImportedMesh> again = meshes;
+		MeshOptimizer::Optimize(again[0]);
+		CHECK(SameMesh(again[0], serial[0]));
+
+		std::vector<ImportedMesh> threaded = meshes;
+		std::vector<MeshOptimizeStats> threadedStats(meshes.size());
+		MeshOptimizer::OptimizeMeshes(threaded.data(), static_cast<uint32_t>(threaded.size()), MeshOptimizeDesc(), threadedStats.data(), &_jobSystem);
+		uint32_t different = 0;
+		for (size_t i = 0; i < threaded.size(); ++i)
+		{
+			different += SameMesh(threaded[i], serial[i]) ? 0 : 1;
+			different += threadedStats[i].after.acmr == serialStats[i].after.acmr ? 0 : 1;
+		}
+		CHECK(different == 0);
+
+		// with every pass but the cache order off, the vertices stay where they were
+		MeshOptimizeDesc desc;
+		desc.reduceOverdraw = false;
+		desc.optimizeVertexFetch = false;
+		ImportedMesh cacheOnly = meshes[1];
+		MeshOptimizeStats stats;
+		MeshOptimizer::Optimize(cacheOnly, desc, &stats);
+		CHECK(stats.clusterCount == 0);
+		CHECK(memcmp(cacheOnly.vertices.data(), meshes[1].vertices.data(), cacheOnly.vertices.size() * sizeof(MeshVertex)) == 0);
+		CHECK(TriangleKeys(cacheOnly) == TriangleKeys(meshes[1]));
+
+		ImportedMesh empty;
+		MeshOptimizer::Optimize(empty, MeshOptimizeDesc(), &stats);
+		CHECK(empty.indices.empty() && empty.vertices.empty());
+	}
+}
+
+int main()
+{
+	JobSystem jobSystem;
+	jobSystem.Init(3);
+
+	TestAnalyze();
+	TestVertexCache();
+	TestVertexFetch();
+	TestOptimize(jobSystem);
+	return CHECK_RESULT();
+}
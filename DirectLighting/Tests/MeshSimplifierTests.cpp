@@ -0,0 +1,265 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "Check.h"
+#include "Culling.h"
+#include "JobSystem.h"
+#include "MeshImporter.h"
+#include "MeshSimplifier.h"
+
+using namespace DirectX;
+
+namespace
+{
+	MeshVertex Vertex(const XMFLOAT3& _position, const XMFLOAT3& _normal)
+	{
+		MeshVertex vertex;
+		vertex.position = _position;
+		vertex.normal = _normal;
+		vertex.uv = XMFLOAT2(_position.x, _position.z);
+		vertex.color = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
+		return vertex;
+	}
+
+	// a flat _size * _size grid facing up. with _seam the column at x = _size / 2 is there twice, the right half's
+	// copy with another normal, the way a hard edge comes out of an importer
+	ImportedMesh Grid(uint32_t _size, bool _seam)
+	{
+		ImportedMesh mesh;
+		uint32_t columns = _size + 1 + (_seam ? 1 : 0);
+		for (uint32_t y = 0; y <= _size; ++y)
+		{
+			for (uint32_t column = 0; column < columns; ++column)
+			{
+				bool right = _seam && column > _size / 2;
+				uint32_t x = right ? column - 1 : column;
+				mesh.vertices.push_back(Vertex(XMFLOAT3(static_cast<float>(x), 0.0f, static_cast<float>(y)),
+					right ? XMFLOAT3(0.6f, 0.8f, 0.0f) : XMFLOAT3(0.0f, 1.0f, 0.0f)));
+			}
+		}
+		for (uint32_t y = 0; y < _size; ++y)
+		{
+			for (uint32_t x = 0; x < _size; ++x)
+			{
+				uint32_t column = _seam && x >= _size / 2 ? x + 1 : x;
+				uint32_t a = y * columns + column;
+				uint32_t b = a + columns;
+				const uint32_t quad[6] = { a, b, b + 1, a, b + 1, a + 1 };
+				mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+			}
+		}
+		mesh.boundsMin = XMFLOAT3(0.0f, 0.0f, 0.0f);
+		mesh.boundsMax = XMFLOAT3(static_cast<float>(_size), 0.0f, static_cast<float>(_size));
+		return mesh;
+	}
+
+	// a closed unit sphere with a single vertex at each pole and the normals pointing out
+	ImportedMesh Sphere(uint32_t _rings, uint32_t _segments)
+	{
+		ImportedMesh mesh;
+		mesh.vertices.push_back(Vertex(XMFLOAT3(0.0f, 1.0f, 0.0f), XMFLOAT3(0.0f, 1.0f, 0.0f)));
+		for (uint32_t ring = 1; ring < _rings; ++ring)
+		{
+			float theta = 3.14159265f * ring / _rings;
+			for (uint32_t segment = 0; segment < _segments; ++segment)
+			{
+				float phi = 2.0f * 3.14159265f * segment / _segments;
+				XMFLOAT3 position(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+				mesh.vertices.push_back(Vertex(position, position));
+			}
+		}
+		uint32_t south = static_cast<uint32_t>(mesh.vertices.size());
+		mesh.vertices.push_back(Vertex(XMFLOAT3(0.0f, -1.0f, 0.0f), XMFLOAT3(0.0f, -1.0f, 0.0f)));
+
+		auto ringVertex = [&](uint32_t _ring, uint32_t _segment) { return 1 + (_ring - 1) * _segments + _segment % _segments; };
+		for (uint32_t segment = 0; segment < _segments; ++segment)
+		{
+			const uint32_t top[3] = { 0, ringVertex(1, segment + 1), ringVertex(1, segment) };
+			mesh.indices.insert(mesh.indices.end(), top, top + 3);
+			for (uint32_t ring = 1; ring + 1 < _rings; ++ring)
+			{
+				uint32_t a = ringVertex(ring, segment);
+				uint32_t b = ringVertex(ring, segment + 1);
+				uint32_t c = ringVertex(ring + 1, segment);
+				uint32_t d = ringVertex(ring + 1, segment + 1);
+				const uint32_t quad[6] = { a, b, d, a, d, c };
+				mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+			}
+			const uint32_t bottom[3] = { south, ringVertex(_rings - 1, segment), ringVertex(_rings - 1, segment + 1) };
+			mesh.indices.insert(mesh.indices.end(), bottom, bottom + 3);
+		}
+		mesh.boundsMin = XMFLOAT3(-1.0f, -1.0f, -1.0f);
+		mesh.boundsMax = XMFLOAT3(1.0f, 1.0f, 1.0f);
+		return mesh;
+	}
+
+	XMVECTOR Normal(const ImportedMesh& _mesh, const std::vector<uint32_t>& _indices, size_t _triangle)
+	{
+		XMVECTOR a = XMLoadFloat3(&_mesh.vertices[_indices[_triangle * 3 + 0]].position);
+		XMVECTOR b = XMLoadFloat3(&_mesh.vertices[_indices[_triangle * 3 + 1]].position);
+		XMVECTOR c = XMLoadFloat3(&_mesh.vertices[_indices[_triangle * 3 + 2]].position);
+		return XMVector3Cross(XMVectorSubtract(b, a), XMVectorSubtract(c, a));
+	}
+
+	float Simplify(const ImportedMesh& _mesh, uint32_t _targetIndexCount, float _maxError, std::vector<uint32_t>& _result)
+	{
+		return MeshSimplifier::Simplify(_mesh.indices.data(), static_cast<uint32_t>(_mesh.indices.size()), _mesh.vertices.data(),
+			static_cast<uint32_t>(_mesh.vertices.size()), _targetIndexCount, _maxError, _result);
+	}
+
+	// a flat grid folds down to its target for free, keeping its area, its corners, its facing and its seam
+	void TestFlat()
+	{
+		ImportedMesh grid = Grid(32, false);
+		std::vector<uint32_t> result;
+		uint32_t target = static_cast<uint32_t>(grid.indices.size() / 10 / 3 * 3);
+		float error = Simplify(grid, target, 1e-3f, result);
+		printf("flat grid: %u triangles down to %u, error %g\n", static_cast<uint32_t>(grid.indices.size() / 3), static_cast<uint32_t>(result.size() / 3), error);
+		CHECK(result.size() <= target && result.size() % 3 == 0 && !result.empty());
+		CHECK(error < 1e-5f);
+
+		float area = 0.0f;
+		uint32_t turned = 0;
+		for (size_t triangle = 0; triangle < result.size() / 3; ++triangle)
+		{
+			XMVECTOR normal = Normal(grid, result, triangle);
+			area += 0.5f * XMVectorGetX(XMVector3Length(normal));
+			turned += XMVectorGetY(normal) < 0.0f ? 1 : 0;
+		}
+		CHECK(std::abs(area - 32.0f * 32.0f) < 1e-2f);
+		CHECK(turned == 0);
+		const uint32_t corners[4] = { 0, 32, 33 * 32, 33 * 33 - 1 };
+		for (uint32_t corner : corners)
+			CHECK(std::find(result.begin(), result.end(), corner) != result.end());
+
+		// every position down the seam is still there, on both sides
+		ImportedMesh seamed = Grid(32, true);
+		Simplify(seamed, target, 1e-3f, result);
+		uint32_t lost = 0;
+		for (uint32_t y = 0; y <= 32; ++y)
+		{
+			uint32_t left = y * 34 + 16;
+			lost += std::find(result.begin(), result.end(), left) != result.end() ? 0 : 1;
+			lost += std::find(result.begin(), result.end(), left + 1) != result.end() ? 0 : 1;
+		}
+		CHECK(lost == 0);
+		CHECK(result.size() < seamed.indices.size() / 2);
+	}
+
+	// on a curved surface the error limit stops it short of the target, a tighter limit stops it sooner, and no
+	// triangle ever turns around or loses its area
+	void TestCurved()
+	{
+		ImportedMesh sphere = Sphere(24, 48);
+		uint32_t indexCount = static_cast<uint32_t>(sphere.indices.size());
+		std::vector<uint32_t> loose;
+		float looseError = Simplify(sphere, indexCount / 4 / 3 * 3, 1.0f, loose);
+		CHECK(loose.size() <= indexCount / 4);
+		CHECK(looseError > 0.0f && looseError <= 1.0f);
+
+		std::vector<uint32_t> tight;
+		float tightError = Simplify(sphere, indexCount / 4 / 3 * 3, looseError * 0.25f, tight);
+		CHECK(tight.size() > loose.size() && tight.size() < indexCount);
+		CHECK(tightError <= looseError * 0.25f);
+
+		std::vector<uint32_t> untouched;
+		CHECK(Simplify(sphere, 0, 0.0f, untouched) == 0.0f);
+		CHECK(untouched == sphere.indices);
+
+		uint32_t bad = 0;
+		for (const std::vector<uint32_t>* pIndices : { &loose, &tight })
+		{
+			for (size_t triangle = 0; triangle < pIndices->size() / 3; ++triangle)
+			{
+				XMVECTOR normal = Normal(sphere, *pIndices, triangle);
+				XMVECTOR center = XMLoadFloat3(&sphere.vertices[(*pIndices)[triangle * 3]].position);
+				bad += XMVectorGetX(XMVector3Dot(normal, center)) > 0.0f ? 0 : 1;
+			}
+		}
+		CHECK(bad == 0);
+	}
+
+	// the levels shrink and their errors grow, within the limit, and the job system gives the same chain
+	void TestLods(JobSystem& _jobSystem)
+	{
+		ImportedMesh sphere = Sphere(48, 96);
+		MeshLodDesc desc;
+		std::vector<MeshLodLevel> levels;
+		MeshSimplifier::GenerateLods(sphere, desc, levels);
+		CHECK(levels.size() >= 2 && levels.size() <= desc.maxLods);
+		CHECK(levels[0].indices == sphere.indices && levels[0].error == 0.0f);
+		float maxError = desc.maxError * std::sqrt(12.0f);
+		for (size_t lod = 1; lod < levels.size(); ++lod)
+		{
+			printf("lod %u: %u triangles, error %g\n", static_cast<uint32_t>(lod), static_cast<uint32_t>(levels[lod].indices.size() / 3), levels[lod].error);
+			CHECK(levels[lod].indices.size() < levels[lod - 1].indices.size());
+			CHECK(levels[lod].error >= levels[lod - 1].error && levels[lod].error <= maxError);
+		}
+
+		std::vector<MeshLodLevel> threaded;
+		MeshSimplifier::GenerateLods(sphere, desc, threaded, &_jobSystem);
+		CHECK(threaded.size() == levels.size());
+		uint32_t different = 0;
+		for (size_t lod = 0; lod < std::min(threaded.size(), levels.size()); ++lod)
+			different += threaded[lod].indices == levels[lod].indices && threaded[lod].error == levels[lod].error ? 0 : 1;
+		CHECK(different == 0);
+
+		ImportedMesh empty;
+		MeshSimplifier::GenerateLods(empty, desc, levels, &_jobSystem);
+		CHECK(levels.size() == 1 && levels[0].indices.empty());
+	}
+
+	struct Lod
+	{
+		uint32_t firstIndex;
+		float error;
+	};
+
+	// the coarsest level within the pixel error wins, a bigger world matrix makes the errors bigger, and an eye
+	// inside the bounds always gets the full mesh
+	void TestSelectLod()
+	{
+		const Lod lods[4] = { { 0, 0.0f }, { 100, 0.01f }, { 150, 0.05f }, { 170, 0.2f } };
+		const float pixelsPerUnit = 500.0f;
+		XMFLOAT4X4 identity;
+		XMStoreFloat4x4(&identity, XMMatrixIdentity());
+		const XMFLOAT3 eye(0.0f, 0.0f, 0.0f);
+		auto select = [&](const XMFLOAT4X4& _world, float _distance, float _radius)
+		{
+			XMFLOAT4 sphere(0.0f, 0.0f, _distance, _radius);
+			return Culling::SelectLod(&lods[0].error, sizeof(Lod), 4, _world, sphere, eye, pixelsPerUnit, 1.0f);
+		};
+
+		// a level is fine once error * 500 / (distance - radius) is at most a pixel
+		CHECK(select(identity, 0.5f, 1.0f) == 0);
+		CHECK(select(identity, 3.0f, 1.0f) == 0);
+		CHECK(select(identity, 6.1f, 1.0f) == 1);
+		CHECK(select(identity, 26.1f, 1.0f) == 2);
+		CHECK(select(identity, 101.1f, 1.0f) == 3);
+		CHECK(select(identity, 1e6f, 1.0f) == 3);
+
+		XMFLOAT4X4 doubled;
+		XMStoreFloat4x4(&doubled, XMMatrixScaling(1.0f, 2.0f, 1.0f));
+		CHECK(select(doubled, 101.1f, 1.0f) == 2);
+		CHECK(select(doubled, 201.1f, 1.0f) == 3);
+
+		XMFLOAT4 sphere(0.0f, 0.0f, 1e6f, 1.0f);
+		CHECK(Culling::SelectLod(&lods[0].error, sizeof(Lod), 1, identity, sphere, eye, pixelsPerUnit, 1.0f) == 0);
+		CHECK(Culling::SelectLod(&lods[0].error, sizeof(Lod), 0, identity, sphere, eye, pixelsPerUnit, 1.0f) == 0);
+	}
+}
+
+int main()
+{
+	JobSystem jobSystem;
+	jobSystem.Init(3);
+
+	TestFlat();
+	TestCurved();
+	TestLods(jobSystem);
+	TestSelectLod();
+	return CHECK_RESULT();
+}
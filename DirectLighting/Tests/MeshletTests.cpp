@@ -0,0 +1,379 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "Check.h"
+#include "Culling.h"
+#include "DepthPyramid.h"
+#include "JobSystem.h"
+#include "MeshOptimizer.h"
+#include "MeshletBuilder.h"
+#include "MeshletCulling.h"
+
+using namespace DirectX;
+
+namespace
+{
+	struct SphereMesh
+	{
+		std::vector<XMFLOAT3> positions;
+		std::vector<uint32_t> indices;
+	};
+
+	// a unit uv sphere wound so cross(b - a, c - a) points out, its poles a ring of vertices at the same place, in
+	// cache order as the builder expects
+	SphereMesh Sphere(uint32_t _rings, uint32_t _segments)
+	{
+		SphereMesh mesh;
+		for (uint32_t ring = 0; ring <= _rings; ++ring)
+		{
+			float theta = 3.14159265f * ring / _rings;
+			for (uint32_t segment = 0; segment < _segments; ++segment)
+			{
+				float phi = 2.0f * 3.14159265f * segment / _segments;
+				mesh.positions.push_back(XMFLOAT3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi)));
+			}
+		}
+		for (uint32_t ring = 0; ring < _rings; ++ring)
+		{
+			for (uint32_t segment = 0; segment < _segments; ++segment)
+			{
+				uint32_t a = ring * _segments + segment;
+				uint32_t b = ring * _segments + (segment + 1) % _segments;
+				uint32_t c = a + _segments;
+				uint32_t d = b + _segments;
+				const uint32_t quad[6] = { a, b, d, a, d, c };
+				mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+			}
+		}
+		MeshOptimizer::OptimizeVertexCache(mesh.indices.data(), static_cast<uint32_t>(mesh.indices.size()), static_cast<uint32_t>(mesh.positions.size()));
+		return mesh;
+	}
+
+	MeshletData Build(const SphereMesh& _mesh, uint32_t _maxVertices = MeshletBuilder::MAX_VERTICES, uint32_t _maxTriangles = MeshletBuilder::MAX_TRIANGLES)
+	{
+		MeshletData data;
+		MeshletBuilder::Build(_mesh.indices.data(), static_cast<uint32_t>(_mesh.indices.size()), &_mesh.positions[0].x, sizeof(XMFLOAT3),
+			static_cast<uint32_t>(_mesh.positions.size()), data, _maxVertices, _maxTriangles);
+		return data;
+	}
+
+	// every triangle turned so its smallest index comes first, which keeps its winding, and sorted
+	std::vector<std::array<uint32_t, 3>> SortedTriangles(const std::vector<uint32_t>& _indices)
+	{
+		std::vector<std::array<uint32_t, 3>> triangles;
+		for (size_t i = 0; i + 2 < _indices.size(); i += 3)
+		{
+			std::array<uint32_t, 3> triangle = { { _indices[i], _indices[i + 1], _indices[i + 2] } };
+			std::rotate(triangle.begin(), std::min_element(triangle.begin(), triangle.end()), triangle.end());
+			triangles.push_back(triangle);
+		}
+		std::sort(triangles.begin(), triangles.end());
+		return triangles;
+	}
+
+	XMVECTOR Position(const SphereMesh& _mesh, uint32_t _vertex, FXMMATRIX _world)
+	{
+		return XMVector3TransformCoord(XMLoadFloat3(&_mesh.positions[_vertex]), _world);
+	}
+
+	// each meshlet stays within the limits, its local triangles name the same vertices as its run of indices, its
+	// sphere holds all of them, and between them the meshlets hold every triangle of the mesh exactly once
+	void CheckMeshlets(const SphereMesh& _mesh, const MeshletData& _data, uint32_t _maxVertices, uint32_t _maxTriangles)
+	{
+		CHECK(SortedTriangles(_data.indices) == SortedTriangles(_mesh.indices));
+		uint32_t overLimit = 0;
+		uint32_t mismatched = 0;
+		uint32_t outside = 0;
+		uint32_t nextIndex = 0;
+		for (const Meshlet& meshlet : _data.meshlets)
+		{
+			overLimit += meshlet.vertexCount > _maxVertices || meshlet.triangleCount > _maxTriangles || meshlet.triangleCount == 0 ? 1 : 0;
+			mismatched += meshlet.firstIndex == nextIndex ? 0 : 1;
+			nextIndex = meshlet.firstIndex + meshlet.triangleCount * 3;
+			for (uint32_t i = 0; i < meshlet.triangleCount * 3; ++i)
+			{
+				uint8_t local = _data.triangles[meshlet.triangleOffset * 3 + i];
+				mismatched += local < meshlet.vertexCount && _data.vertices[meshlet.vertexOffset + local] == _data.indices[meshlet.firstIndex + i] ? 0 : 1;
+			}
+			for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+			{
+				float distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(XMLoadFloat3(&_mesh.positions[_data.vertices[meshlet.vertexOffset + i]]),
+					XMLoadFloat3(&meshlet.center))));
+				outside += distance <= meshlet.radius * 1.0001f + 1e-6f ? 0 : 1;
+			}
+		}
+		CHECK(overLimit == 0);
+		CHECK(mismatched == 0);
+		CHECK(outside == 0);
+		CHECK(nextIndex == _data.indices.size());
+	}
+
+	void TestBuild()
+	{
+		SphereMesh sphere = Sphere(48, 96);
+		MeshletData data = Build(sphere);
+		CheckMeshlets(sphere, data, MeshletBuilder::MAX_VERTICES, MeshletBuilder::MAX_TRIANGLES);
+		// a closed mesh fills its meshlets: two triangles per vertex, so about 64 vertices hold about 100 triangles
+		float averageTriangles = static_cast<float>(sphere.indices.size() / 3) / data.meshlets.size();
+		printf("%u meshlets, %.1f triangles each\n", static_cast<uint32_t>(data.meshlets.size()), averageTriangles);
+		CHECK(averageTriangles > 80.0f);
+
+		MeshletData small = Build(sphere, 16, 8);
+		CheckMeshlets(sphere, small, 16, 8);
+
+		MeshletData again = Build(sphere);
+		CHECK(again.indices == data.indices && again.triangles == data.triangles && again.vertices == data.vertices);
+
+		MeshletData empty;
+		MeshletBuilder::Build(nullptr, 0, &sphere.positions[0].x, sizeof(XMFLOAT3), 0, empty);
+		CHECK(empty.meshlets.empty() && empty.indices.empty());
+	}
+
+	// an eye the cone calls backfacing sees the back of every triangle of the meshlet, from anywhere
+	void TestCones()
+	{
+		SphereMesh sphere = Sphere(32, 64);
+		MeshletData data = Build(sphere);
+		std::mt19937 random(1);
+		std::uniform_real_distribution<float> unit(-4.0f, 4.0f);
+		uint32_t backfacing = 0;
+		uint32_t wrong = 0;
+		for (uint32_t eyeIndex = 0; eyeIndex < 200; ++eyeIndex)
+		{
+			XMVECTOR eye = XMVectorSet(unit(random), unit(random), unit(random), 0.0f);
+			for (const Meshlet& meshlet : data.meshlets)
+			{
+				XMVECTOR toApex = XMVectorSubtract(XMLoadFloat3(&meshlet.coneApex), eye);
+				float facing = XMVectorGetX(XMVector3Dot(toApex, XMLoadFloat3(&meshlet.coneAxis)));
+				if (facing < meshlet.coneCutoff * XMVectorGetX(XMVector3Length(toApex)))
+					continue;
+				backfacing++;
+				for (uint32_t i = 0; i < meshlet.triangleCount * 3; i += 3)
+				{
+					XMVECTOR a = XMLoadFloat3(&sphere.positions[data.indices[meshlet.firstIndex + i + 0]]);
+					XMVECTOR b = XMLoadFloat3(&sphere.positions[data.indices[meshlet.firstIndex + i + 1]]);
+					XMVECTOR c = XMLoadFloat3(&sphere.positions[data.indices[meshlet.firstIndex + i + 2]]);
+					XMVECTOR normal = XMVector3Cross(XMVectorSubtract(b, a), XMVectorSubtract(c, a));
+					wrong += XMVectorGetX(XMVector3Dot(normal, XMVectorSubtract(a, eye))) >= -1e-6f ? 0 : 1;
+				}
+			}
+		}
+		CHECK(backfacing > 0);
+		CHECK(wrong == 0);
+	}
+
+	void Camera(const XMFLOAT3& _eye, XMFLOAT4X4& _viewProj, Frustum& _frustum)
+	{
+		XMMATRIX view = XMMatrixLookAtLH(XMLoadFloat3(&_eye), XMVectorZero(), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+		XMMATRIX proj = XMMatrixPerspectiveFovLH(0.8f, 1.5f, 0.1f, 100.0f);
+		XMStoreFloat4x4(&_viewProj, view * proj);
+		Culling::ExtractFrustum(_viewProj, _frustum);
+	}
+
+	// the culler keeps every meshlet with a triangle that faces the eye and is inside the frustum, under a scaled and
+	// rotated world matrix, does the same on the job system, and skips the cones when the matrix mirrors
+	void TestCull(JobSystem& _jobSystem)
+	{
+		SphereMesh sphere = Sphere(128, 133);
+		MeshletData data = Build(sphere, 32, 32);
+		uint32_t count = static_cast<uint32_t>(data.meshlets.size());
+		CHECK(count > 4 * 256 && count % 4 != 0); // more than one block, and a padded last quad
+
+		MeshletCuller culler;
+		culler.Init(data.meshlets.data(), count);
+		MeshletCullParams params;
+		XMMATRIX world = XMMatrixScaling(1.5f, 1.0f, 0.75f) * XMMatrixRotationY(0.4f) * XMMatrixTranslation(0.2f, 0.0f, 0.0f);
+		XMStoreFloat4x4(&params.world, world);
+		params.cameraPosition = XMFLOAT3(0.0f, 0.3f, -2.2f);
+		XMFLOAT4X4 viewProj;
+		Camera(params.cameraPosition, viewProj, params.frustum);
+
+		uint32_t visible = culler.Cull(params);
+		std::vector<uint32_t> serial = culler.Visible();
+		MeshletCullStats stats = culler.Stats();
+		printf("%u meshlets: %u outside, %u backfacing, %u visible\n", count, stats.frustumCulled, stats.backfaceCulled, visible);
+		CHECK(stats.tested == count && stats.frustumCulled + stats.backfaceCulled + stats.occlusionCulled + visible == count);
+		CHECK(stats.frustumCulled > 0 && stats.backfaceCulled > 0 && stats.occlusionCulled == 0 && visible > 0);
+		CHECK(std::is_sorted(serial.begin(), serial.end()));
+
+		culler.Cull(params, &_jobSystem);
+		CHECK(culler.Visible() == serial);
+		CHECK(culler.Stats().backfaceCulled == stats.backfaceCulled && culler.Stats().frustumCulled == stats.frustumCulled);
+
+		// nothing that could be seen was culled
+		XMVECTOR eye = XMLoadFloat3(&params.cameraPosition);
+		uint32_t missing = 0;
+		for (uint32_t m = 0; m < count; ++m)
+		{
+			const Meshlet& meshlet = data.meshlets[m];
+			bool seen = false;
+			for (uint32_t i = 0; i < meshlet.triangleCount * 3 && !seen; i += 3)
+			{
+				XMVECTOR a = Position(sphere, data.indices[meshlet.firstIndex + i + 0], world);
+				XMVECTOR b = Position(sphere, data.indices[meshlet.firstIndex + i + 1], world);
+				XMVECTOR c = Position(sphere, data.indices[meshlet.firstIndex + i + 2], world);
+				XMVECTOR normal = XMVector3Cross(XMVectorSubtract(b, a), XMVectorSubtract(c, a));
+				bool inside = true;
+				for (XMVECTOR corner : { a, b, c })
+				{
+					for (const XMFLOAT4& plane : params.frustum.planes)
+						inside = inside && XMVectorGetX(XMPlaneDotCoord(XMLoadFloat4(&plane), corner)) > 0.0f;
+				}
+				seen = inside && XMVectorGetX(XMVector3Dot(normal, XMVectorSubtract(a, eye))) < 0.0f;
+			}
+			missing += seen && !std::binary_search(serial.begin(), serial.end(), m) ? 1 : 0;
+		}
+		CHECK(missing == 0);
+
+		// turned inside out, the cones would cull the front
+		XMStoreFloat4x4(&params.world, XMMatrixScaling(-1.0f, 1.0f, 1.0f) * world);
+		culler.Cull(params, &_jobSystem);
+		CHECK(culler.Stats().backfaceCulled == 0 && culler.Stats().frustumCulled > 0);
+		params.cullBackfaces = false;
+		XMStoreFloat4x4(&params.world, world);
+		culler.Cull(params);
+		CHECK(culler.Stats().backfaceCulled == 0 && culler.Stats().frustumCulled == stats.frustumCulled);
+	}
+
+	// the depth of a wall facing the camera _distance in front of it, over the whole screen
+	std::vector<float> WallDepth(uint32_t _width, uint32_t _height, const XMFLOAT4X4& _proj, float _distance)
+	{
+		XMFLOAT4 clip;
+		XMStoreFloat4(&clip, XMVector4Transform(XMVectorSet(0.0f, 0.0f, _distance, 1.0f), XMLoadFloat4x4(&_proj)));
+		return std::vector<float>(static_cast<size_t>(_width) * _height, clip.z / clip.w);
+	}
+
+	// a sphere behind a wall is hidden, one in front of it, through a hole in it, off the screen or across the near
+	// plane is not. on a random depth buffer every sphere called hidden really is behind every pixel it covers, and
+	// the pyramid built on the job system gives the same answers
+	void TestDepthPyramid(JobSystem& _jobSystem)
+	{
+		const uint32_t width = 301;
+		const uint32_t height = 199;
+		XMFLOAT4X4 proj;
+		XMStoreFloat4x4(&proj, XMMatrixPerspectiveFovLH(0.8f, static_cast<float>(width) / height, 0.1f, 100.0f));
+
+		DepthPyramid pyramid;
+		CHECK(!pyramid.IsBuilt());
+		CHECK(!pyramid.SphereOccluded(XMFLOAT4(0.0f, 0.0f, 5.0f, 0.5f), proj));
+		std::vector<float> depth = WallDepth(width, height, proj, 2.0f);
+		pyramid.Build(depth.data(), width, height);
+		CHECK(pyramid.IsBuilt());
+		CHECK(pyramid.SphereOccluded(XMFLOAT4(0.0f, 0.0f, 5.0f, 0.5f), proj));
+		CHECK(!pyramid.SphereOccluded(XMFLOAT4(0.0f, 0.0f, 1.5f, 0.3f), proj));
+		CHECK(!pyramid.SphereOccluded(XMFLOAT4(0.0f, 0.0f, 2.0f, 0.3f), proj));
+		CHECK(!pyramid.SphereOccluded(XMFLOAT4(100.0f, 0.0f, 5.0f, 0.5f), proj));
+		CHECK(!pyramid.SphereOccluded(XMFLOAT4(0.0f, 0.0f, 0.2f, 0.5f), proj));
+
+		// one far pixel in the middle lets the sphere through
+		depth[(height / 2) * width + width / 2] = 1.0f;
+		pyramid.Build(depth.data(), width, height);
+		CHECK(!pyramid.SphereOccluded(XMFLOAT4(0.0f, 0.0f, 5.0f, 0.5f), proj));
+		CHECK(pyramid.SphereOccluded(XMFLOAT4(-1.5f, 0.0f, 5.0f, 0.5f), proj));
+
+		std::mt19937 random(2);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		for (float& value : depth)
+			value = 0.9f + 0.1f * unit(random);
+		pyramid.Build(depth.data(), width, height);
+		DepthPyramid threaded;
+		threaded.Build(depth.data(), width, height, &_jobSystem);
+
+		XMMATRIX projMat = XMLoadFloat4x4(&proj);
+		uint32_t occluded = 0;
+		uint32_t different = 0;
+		uint32_t wrong = 0;
+		for (uint32_t i = 0; i < 5000; ++i)
+		{
+			XMFLOAT4 sphere((unit(random) - 0.5f) * 20.0f, (unit(random) - 0.5f) * 12.0f, 1.0f + 40.0f * unit(random), 0.05f + unit(random));
+			bool hidden = pyramid.SphereOccluded(sphere, proj);
+			different += hidden == threaded.SphereOccluded(sphere, proj) ? 0 : 1;
+			if (!hidden)
+				continue;
+			occluded++;
+
+			// the same screen rectangle and nearest depth, checked against every pixel under it
+			float left = 1.0f;
+			float right = -1.0f;
+			float bottom = 1.0f;
+			float top = -1.0f;
+			float nearest = 1.0f;
+			for (uint32_t corner = 0; corner < 8; ++corner)
+			{
+				XMVECTOR point = XMVectorSet(sphere.x + ((corner & 1) ? sphere.w : -sphere.w), sphere.y + ((corner & 2) ? sphere.w : -sphere.w),
+					sphere.z + ((corner & 4) ? sphere.w : -sphere.w), 1.0f);
+				XMFLOAT4 clip;
+				XMStoreFloat4(&clip, XMVector4Transform(point, projMat));
+				left = std::min(left, clip.x / clip.w);
+				right = std::max(right, clip.x / clip.w);
+				bottom = std::min(bottom, clip.y / clip.w);
+				top = std::max(top, clip.y / clip.w);
+				nearest = std::min(nearest, clip.z / clip.w);
+			}
+			uint32_t x0 = static_cast<uint32_t>((left * 0.5f + 0.5f) * width);
+			uint32_t x1 = std::min(static_cast<uint32_t>((right * 0.5f + 0.5f) * width), width - 1);
+			uint32_t y0 = static_cast<uint32_t>((0.5f - top * 0.5f) * height);
+			uint32_t y1 = std::min(static_cast<uint32_t>((0.5f - bottom * 0.5f) * height), height - 1);
+			for (uint32_t y = y0; y <= y1; ++y)
+			{
+				for (uint32_t x = x0; x <= x1; ++x)
+					wrong += depth[y * width + x] < nearest ? 0 : 1;
+			}
+		}
+		printf("%u of 5000 random spheres occluded\n", occluded);
+		CHECK(occluded > 0);
+		CHECK(different == 0);
+		CHECK(wrong == 0);
+
+		pyramid.Build(depth.data(), 0, 0);
+		CHECK(!pyramid.IsBuilt());
+	}
+
+	// with a wall between the camera and the mesh every meshlet that got past the frustum and the cones is hidden,
+	// and with the wall behind it none are
+	void TestCullOcclusion(JobSystem& _jobSystem)
+	{
+		SphereMesh sphere = Sphere(64, 64);
+		MeshletData data = Build(sphere);
+		MeshletCuller culler;
+		culler.Init(data.meshlets.data(), static_cast<uint32_t>(data.meshlets.size()));
+
+		MeshletCullParams params;
+		XMStoreFloat4x4(&params.world, XMMatrixIdentity());
+		params.cameraPosition = XMFLOAT3(0.0f, 0.0f, -5.0f);
+		Camera(params.cameraPosition, params.occlusionViewProj, params.frustum);
+		uint32_t visible = culler.Cull(params, &_jobSystem);
+		CHECK(visible > 0);
+
+		XMFLOAT4X4 proj;
+		XMStoreFloat4x4(&proj, XMMatrixPerspectiveFovLH(0.8f, 1.5f, 0.1f, 100.0f));
+		DepthPyramid pyramid;
+		params.pOcclusion = &pyramid;
+		std::vector<float> depth = WallDepth(96, 64, proj, 2.0f);
+		pyramid.Build(depth.data(), 96, 64, &_jobSystem);
+		CHECK(culler.Cull(params, &_jobSystem) == 0);
+		CHECK(culler.Stats().occlusionCulled == visible);
+
+		depth = WallDepth(96, 64, proj, 10.0f);
+		pyramid.Build(depth.data(), 96, 64, &_jobSystem);
+		CHECK(culler.Cull(params, &_jobSystem) == visible);
+		CHECK(culler.Stats().occlusionCulled == 0);
+	}
+}
+
+int main()
+{
+	JobSystem jobSystem;
+	jobSystem.Init(3);
+
+	TestBuild();
+	TestCones();
+	TestCull(jobSystem);
+	TestDepthPyramid(jobSystem);
+	TestCullOcclusion(jobSystem);
+	return CHECK_RESULT();
+}
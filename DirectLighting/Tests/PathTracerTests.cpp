@@ -0,0 +1,287 @@
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "Check.h"
+#include "JobSystem.h"
+#include "PathTracer.h"
+
+using namespace DirectX;
+
+namespace
+{
+	// the nearest hit over every triangle, moller trumbore in double precision
+	bool BruteForce(const std::vector<XMFLOAT3>& _positions, const std::vector<uint32_t>& _indices, const XMFLOAT3& _origin,
+		const XMFLOAT3& _direction, double& _t)
+	{
+		bool found = false;
+		_t = 1e30;
+		for (size_t triangle = 0; triangle < _indices.size() / 3; ++triangle)
+		{
+			const XMFLOAT3& a = _positions[_indices[triangle * 3]];
+			const XMFLOAT3& b = _positions[_indices[triangle * 3 + 1]];
+			const XMFLOAT3& c = _positions[_indices[triangle * 3 + 2]];
+			double e1[3] = { b.x - static_cast<double>(a.x), b.y - static_cast<double>(a.y), b.z - static_cast<double>(a.z) };
+			double e2[3] = { c.x - static_cast<double>(a.x), c.y - static_cast<double>(a.y), c.z - static_cast<double>(a.z) };
+			double d[3] = { _direction.x, _direction.y, _direction.z };
+			double p[3] = { d[1] * e2[2] - d[2] * e2[1], d[2] * e2[0] - d[0] * e2[2], d[0] * e2[1] - d[1] * e2[0] };
+			double det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+			if (std::abs(det) < 1e-12)
+				continue;
+			double s[3] = { _origin.x - static_cast<double>(a.x), _origin.y - static_cast<double>(a.y), _origin.z - static_cast<double>(a.z) };
+			double u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) / det;
+			double q[3] = { s[1] * e1[2] - s[2] * e1[1], s[2] * e1[0] - s[0] * e1[2], s[0] * e1[1] - s[1] * e1[0] };
+			double v = (d[0] * q[0] + d[1] * q[1] + d[2] * q[2]) / det;
+			double t = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) / det;
+			if (u >= 0.0 && v >= 0.0 && u + v <= 1.0 && t > 0.0 && t < _t)
+			{
+				_t = t;
+				found = true;
+			}
+		}
+		return found;
+	}
+
+	// 20000 small triangles scattered through a box, and rays between random points in it
+	void TestTriangleBvh()
+	{
+		std::mt19937 random(3);
+		std::uniform_real_distribution<float> spread(-10.0f, 10.0f);
+		std::uniform_real_distribution<float> jitter(-0.5f, 0.5f);
+		std::vector<XMFLOAT3> positions;
+		std::vector<uint32_t> indices;
+		for (uint32_t triangle = 0; triangle < 20000; ++triangle)
+		{
+			XMFLOAT3 center(spread(random), spread(random), spread(random));
+			for (uint32_t corner = 0; corner < 3; ++corner)
+			{
+				positions.push_back(XMFLOAT3(center.x + jitter(random), center.y + jitter(random), center.z + jitter(random)));
+				indices.push_back(triangle * 3 + corner);
+			}
+		}
+		TriangleBvh bvh;
+		bvh.Build(positions.data(), indices.data(), 20000);
+		CHECK(bvh.TriangleCount() == 20000);
+
+		uint32_t hits = 0;
+		uint32_t wrongHit = 0;
+		uint32_t wrongDistance = 0;
+		uint32_t wrongOcclusion = 0;
+		for (uint32_t ray = 0; ray < 2000; ++ray)
+		{
+			XMFLOAT3 origin(spread(random), spread(random), spread(random));
+			XMFLOAT3 direction(spread(random), spread(random), spread(random));
+			double t;
+			bool expected = BruteForce(positions, indices, origin, direction, t);
+			RayHit hit;
+			bool found = bvh.Intersect(origin, direction, 1e30f, hit);
+			hits += expected ? 1 : 0;
+			// rays that only graze an edge may go either way
+			if (found != expected)
+				++wrongHit;
+			else if (found && std::abs(hit.t - t) > 1e-4 * t)
+				++wrongDistance;
+			if (bvh.Occluded(origin, direction, 1e30f) != expected)
+				++wrongOcclusion;
+			// a shadow ray that stops short of the first hit is not blocked
+			if (expected && bvh.Occluded(origin, direction, static_cast<float>(t * 0.999)))
+				++wrongOcclusion;
+		}
+		CHECK(hits > 500);
+		CHECK(wrongHit <= 2);
+		CHECK(wrongDistance == 0);
+		CHECK(wrongOcclusion <= 2);
+
+		// nothing to hit
+		TriangleBvh empty;
+		empty.Build(nullptr, nullptr, 0);
+		RayHit hit;
+		CHECK(!empty.Intersect(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, 1.0f), 1e30f, hit));
+	}
+
+	struct TestVertex
+	{
+		XMFLOAT3 position;
+		XMFLOAT4 color;
+	};
+
+	// a 100 by 100 floor at y = 0 with the given albedo, seen from straight above
+	void MakeFloor(PathTracer& _pathTracer, float _albedo)
+	{
+		TestVertex floor[4] =
+		{
+			{ XMFLOAT3(-50.0f, 0.0f, -50.0f), XMFLOAT4(_albedo, _albedo, _albedo, 1.0f) },
+			{ XMFLOAT3(50.0f, 0.0f, -50.0f), XMFLOAT4(_albedo, _albedo, _albedo, 1.0f) },
+			{ XMFLOAT3(50.0f, 0.0f, 50.0f), XMFLOAT4(_albedo, _albedo, _albedo, 1.0f) },
+			{ XMFLOAT3(-50.0f, 0.0f, 50.0f), XMFLOAT4(_albedo, _albedo, _albedo, 1.0f) }
+		};
+		uint32_t indices[6] = { 0, 1, 2, 0, 2, 3 };
+		XMFLOAT4X4 identity;
+		XMStoreFloat4x4(&identity, XMMatrixIdentity());
+		_pathTracer.ClearScene();
+		_pathTracer.AddMesh(floor, 4, sizeof(TestVertex), 0, sizeof(XMFLOAT3), indices, 6, identity);
+	}
+
+	void SetTopCamera(PathTracer& _pathTracer)
+	{
+		XMFLOAT4X4 view, proj;
+		XMStoreFloat4x4(&view, XMMatrixLookAtLH(XMVectorSet(0.0f, 5.0f, -0.001f, 1.0f), XMVectorZero(), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)));
+		XMStoreFloat4x4(&proj, XMMatrixPerspectiveFovLH(1.0f, 1.0f, 0.1f, 1000.0f));
+		_pathTracer.SetCamera(view, proj);
+	}
+
+	// direct light only on a lambertian floor has a closed form: radiance = albedo / pi * irradiance, where a point
+	// light of intensity I at height h gives I cos / d^2 and the sun gives its colour times the cosine
+	void TestAnalyticIrradiance(JobSystem& _jobSystem)
+	{
+		const float albedo = 0.5f;
+		PathTracerDesc desc;
+		desc.width = 64;
+		desc.height = 64;
+		desc.maxBounces = 0;
+		PathTracer pathTracer;
+		pathTracer.Init(desc);
+		MakeFloor(pathTracer, albedo);
+		Light light = {};
+		light.position = XMFLOAT3(0.0f, 2.0f, 0.0f);
+		light.range = 1000.0f; // far enough that the window does not matter
+		light.color = XMFLOAT3(10.0f, 10.0f, 10.0f);
+		light.type = LIGHT_POINT;
+		pathTracer.SetLights(&light, 1);
+		pathTracer.Commit();
+
+		PathRandom random(1);
+		uint32_t wrong = 0;
+		for (float x : { 0.0f, 1.0f, 2.5f, -3.0f })
+		{
+			// a ray straight down onto the floor at (x, 0, 0)
+			XMFLOAT3 radiance = pathTracer.Radiance(XMFLOAT3(x, 1.0f, 0.0f), XMFLOAT3(0.0f, -1.0f, 0.0f), random);
+			double distanceSq = x * x + 4.0;
+			double expected = albedo / XM_PI * 10.0 * (2.0 / std::sqrt(distanceSq)) / distanceSq;
+			if (std::abs(radiance.x - expected) > 1e-3 * expected)
+				++wrong;
+		}
+		CHECK(wrong == 0);
+
+		// the image agrees in the middle, and does not depend on the threads that drew it
+		SetTopCamera(pathTracer);
+		pathTracer.Render(2, &_jobSystem);
+		CHECK(pathTracer.PassCount() == 2);
+		XMFLOAT3 center = pathTracer.Pixel(32, 32);
+		CHECK(std::abs(center.x - albedo / XM_PI * 10.0f / 4.0f) < 0.02f * albedo / XM_PI * 10.0f / 4.0f);
+		PathTracer serial;
+		serial.Init(desc);
+		MakeFloor(serial, albedo);
+		serial.SetLights(&light, 1);
+		serial.Commit();
+		SetTopCamera(serial);
+		serial.Render(2);
+		uint32_t different = 0;
+		for (uint32_t y = 0; y < desc.height; ++y)
+		{
+			for (uint32_t x = 0; x < desc.width; ++x)
+			{
+				XMFLOAT3 a = pathTracer.Pixel(x, y);
+				XMFLOAT3 b = serial.Pixel(x, y);
+				different += a.x != b.x || a.y != b.y || a.z != b.z ? 1 : 0;
+			}
+		}
+		CHECK(different == 0);
+
+		// the sun at 60 degrees from straight down
+		MakeFloor(pathTracer, albedo);
+		pathTracer.SetLights(nullptr, 0);
+		XMFLOAT3 sunDirection(std::sin(XM_PI / 3.0f), -std::cos(XM_PI / 3.0f), 0.0f);
+		pathTracer.SetSun(sunDirection, XMFLOAT3(2.0f, 2.0f, 2.0f));
+		pathTracer.Commit();
+		XMFLOAT3 sunRadiance = pathTracer.Radiance(XMFLOAT3(0.0f, 1.0f, 0.0f), XMFLOAT3(0.0f, -1.0f, 0.0f), random);
+		double sunExpected = albedo / XM_PI * 2.0 * 0.5;
+		CHECK(std::abs(sunRadiance.x - sunExpected) < 1e-3 * sunExpected);
+
+		// a roof over the point blocks the sun
+		TestVertex roof[3] =
+		{
+			{ XMFLOAT3(-20.0f, 3.0f, -20.0f), XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f) },
+			{ XMFLOAT3(-20.0f, 3.0f, 40.0f), XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f) },
+			{ XMFLOAT3(40.0f, 3.0f, -20.0f), XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f) }
+		};
+		uint32_t roofIndices[3] = { 0, 1, 2 };
+		XMFLOAT4X4 identity;
+		XMStoreFloat4x4(&identity, XMMatrixIdentity());
+		pathTracer.AddMesh(roof, 3, sizeof(TestVertex), 0, sizeof(XMFLOAT3), roofIndices, 3, identity);
+		pathTracer.Commit();
+		sunRadiance = pathTracer.Radiance(XMFLOAT3(0.0f, 1.0f, 0.0f), XMFLOAT3(0.0f, -1.0f, 0.0f), random);
+		CHECK(sunRadiance.x == 0.0f);
+	}
+
+	// a closed grey box lit by a point light inside it. every bounce brings back about the albedo of what the one
+	// before it did, so with enough bounces the image comes out close to 1 / (1 - albedo) times the direct light
+	void TestBounces(JobSystem& _jobSystem)
+	{
+		std::vector<TestVertex> vertices;
+		std::vector<uint32_t> indices;
+		const float albedo = 0.5f;
+		for (uint32_t face = 0; face < 6; ++face)
+		{
+			uint32_t axis = face / 2;
+			float side = face % 2 == 0 ? -5.0f : 5.0f;
+			uint32_t first = static_cast<uint32_t>(vertices.size());
+			for (uint32_t corner = 0; corner < 4; ++corner)
+			{
+				float a = corner & 1 ? 5.0f : -5.0f;
+				float b = corner & 2 ? 5.0f : -5.0f;
+				float p[3];
+				p[axis] = side;
+				p[(axis + 1) % 3] = a;
+				p[(axis + 2) % 3] = b;
+				vertices.push_back({ XMFLOAT3(p[0], p[1], p[2]), XMFLOAT4(albedo, albedo, albedo, 1.0f) });
+			}
+			uint32_t quad[6] = { 0, 1, 3, 0, 3, 2 };
+			for (uint32_t index : quad)
+				indices.push_back(first + index);
+		}
+		XMFLOAT4X4 identity;
+		XMStoreFloat4x4(&identity, XMMatrixIdentity());
+		Light light = {};
+		light.position = XMFLOAT3(0.0f, 0.0f, 0.0f);
+		light.range = 100.0f;
+		light.color = XMFLOAT3(20.0f, 20.0f, 20.0f);
+		light.type = LIGHT_POINT;
+
+		double brightness[2] = {};
+		for (uint32_t run = 0; run < 2; ++run)
+		{
+			PathTracerDesc desc;
+			desc.width = 32;
+			desc.height = 32;
+			desc.maxBounces = run == 0 ? 0 : 8;
+			PathTracer pathTracer;
+			pathTracer.Init(desc);
+			pathTracer.AddMesh(vertices.data(), static_cast<uint32_t>(vertices.size()), sizeof(TestVertex), 0, sizeof(XMFLOAT3),
+				indices.data(), static_cast<uint32_t>(indices.size()), identity);
+			pathTracer.SetLights(&light, 1);
+			pathTracer.Commit();
+			XMFLOAT4X4 view, proj;
+			XMStoreFloat4x4(&view, XMMatrixLookAtLH(XMVectorSet(0.0f, 0.0f, -4.0f, 1.0f), XMVectorZero(), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)));
+			XMStoreFloat4x4(&proj, XMMatrixPerspectiveFovLH(1.0f, 1.0f, 0.1f, 100.0f));
+			pathTracer.SetCamera(view, proj);
+			pathTracer.Render(32, &_jobSystem);
+			for (uint32_t y = 0; y < desc.height; ++y)
+			{
+				for (uint32_t x = 0; x < desc.width; ++x)
+					brightness[run] += pathTracer.Pixel(x, y).x;
+			}
+		}
+		CHECK(brightness[1] > brightness[0] * 1.5 && brightness[1] < brightness[0] * 2.5);
+	}
+}
+
+int main()
+{
+	JobSystem jobSystem;
+	jobSystem.Init(3);
+	TestTriangleBvh();
+	TestAnalyticIrradiance(jobSystem);
+	TestBounces(jobSystem);
+	return CHECK_RESULT();
+}
@@ -0,0 +1,72 @@
+#include <algorithm>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "Check.h"
+#include "JobSystem.h"
+#include "RadixSort.h"
+
+// RadixSort64 has to give exactly what std::stable_sort gives, values and all, whatever the keys look like and however
+// many threads it splits across
+namespace
+{
+	enum KeyPattern
+	{
+		KEYS_RANDOM, // every pass does something
+		KEYS_DRAWS, // a few passes and pipelines over 32 bits of depth, like SortKey
+		KEYS_FEW, // lots of equal keys, where stability shows
+		KEYS_SORTED,
+		KEYS_REVERSED,
+		KEYS_COUNT
+	};
+
+	void TestPattern(KeyPattern _pattern, uint32_t _count, JobSystem* _pJobSystem)
+	{
+		std::mt19937_64 random(_pattern * 1000 + _count);
+		std::vector<uint64_t> keys(_count);
+		std::vector<uint32_t> values(_count);
+		for (uint32_t i = 0; i < _count; ++i)
+		{
+			switch (_pattern)
+			{
+			case KEYS_RANDOM: keys[i] = random(); break;
+			case KEYS_DRAWS: keys[i] = (random() % 4) << 60 | (random() % 16) << 48 | (random() & 0xFFFFFFFF); break;
+			case KEYS_FEW: keys[i] = random() % 7; break;
+			case KEYS_SORTED: keys[i] = i * 3ull; break;
+			default: keys[i] = (_count - i) * 0x10001ull; break;
+			}
+			values[i] = i;
+		}
+
+		std::vector<std::pair<uint64_t, uint32_t>> expected(_count);
+		for (uint32_t i = 0; i < _count; ++i)
+			expected[i] = std::make_pair(keys[i], values[i]);
+		std::stable_sort(expected.begin(), expected.end(),
+			[](const std::pair<uint64_t, uint32_t>& _a, const std::pair<uint64_t, uint32_t>& _b) { return _a.first < _b.first; });
+
+		std::vector<uint64_t> tempKeys(_count);
+		std::vector<uint32_t> tempValues(_count);
+		RadixSort64(keys.data(), values.data(), tempKeys.data(), tempValues.data(), _count, _pJobSystem);
+		bool same = true;
+		for (uint32_t i = 0; i < _count && same; ++i)
+			same = keys[i] == expected[i].first && values[i] == expected[i].second;
+		CHECK(same);
+	}
+}
+
+int main()
+{
+	JobSystem jobSystem;
+	jobSystem.Init(3);
+	const uint32_t counts[] = { 0, 1, 2, 255, 4096, 100003 };
+	for (int pattern = 0; pattern < KEYS_COUNT; ++pattern)
+	{
+		for (uint32_t count : counts)
+		{
+			TestPattern(static_cast<KeyPattern>(pattern), count, nullptr);
+			TestPattern(static_cast<KeyPattern>(pattern), count, &jobSystem);
+		}
+	}
+	return CHECK_RESULT();
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <D3d12.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// stands in for ID3D12GraphicsCommandList under CommandRecorder<RecordingCommandList>. every call is written down as a
+// line of text, "constants 0 16 @0" and so on, so a test can check exactly what reached the list and in what order.
+// barriers are kept whole as well, a batch per ResourceBarrier call
+struct RecordingCommandList
+{
+	std::vector<std::string> calls;
+	std::vector<std::vector<D3D12_RESOURCE_BARRIER>> barrierBatches;
+
+	void Record(const char* _format, unsigned long long _a = 0, unsigned long long _b = 0, unsigned long long _c = 0)
+	{
+		char call[128];
+		snprintf(call, sizeof(call), _format, _a, _b, _c);
+		calls.push_back(call);
+	}
+
+	// how many recorded calls start with _prefix
+	size_t Count(const std::string& _prefix)
+	{
+		size_t count = 0;
+		for (const std::string& call : calls)
+			count += call.compare(0, _prefix.size(), _prefix) == 0 ? 1 : 0;
+		return count;
+	}
+
+	void SetPipelineState(ID3D12PipelineState* _pPipelineState) { Record("pso %llx", reinterpret_cast<uintptr_t>(_pPipelineState)); }
+	void SetGraphicsRootSignature(ID3D12RootSignature* _pRootSignature) { Record("root signature %llx", reinterpret_cast<uintptr_t>(_pRootSignature)); }
+	void SetGraphicsRoot32BitConstants(UINT _index, UINT _count, const void*, UINT _offset) { Record("constants %llu %llu @%llu", _index, _count, _offset); }
+	void SetGraphicsRootConstantBufferView(UINT _index, D3D12_GPU_VIRTUAL_ADDRESS _address) { Record("cbv %llu %llx", _index, _address); }
+	void SetGraphicsRootShaderResourceView(UINT _index, D3D12_GPU_VIRTUAL_ADDRESS _address) { Record("srv %llu %llx", _index, _address); }
+	void SetGraphicsRootDescriptorTable(UINT _index, D3D12_GPU_DESCRIPTOR_HANDLE _handle) { Record("table %llu %llx", _index, _handle.ptr); }
+	void RSSetViewports(UINT _count, const D3D12_VIEWPORT*) { Record("viewports %llu", _count); }
+	void RSSetScissorRects(UINT _count, const D3D12_RECT*) { Record("scissor rects %llu", _count); }
+	void IASetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY _topology) { Record("topology %llu", _topology); }
+	void IASetVertexBuffers(UINT _slot, UINT _count, const D3D12_VERTEX_BUFFER_VIEW* _pViews) { Record("vertex buffers %llu %llu %llx", _slot, _count, _pViews->BufferLocation); }
+	void IASetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW* _pView) { Record("index buffer %llx", _pView->BufferLocation); }
+	void OMSetRenderTargets(UINT _count, const D3D12_CPU_DESCRIPTOR_HANDLE*, BOOL, const D3D12_CPU_DESCRIPTOR_HANDLE*) { Record("render targets %llu", _count); }
+	void ClearRenderTargetView(D3D12_CPU_DESCRIPTOR_HANDLE _view, const FLOAT*, UINT, const D3D12_RECT*) { Record("clear rtv %llx", _view.ptr); }
+	void ClearDepthStencilView(D3D12_CPU_DESCRIPTOR_HANDLE _view, D3D12_CLEAR_FLAGS, FLOAT, UINT8, UINT, const D3D12_RECT*) { Record("clear dsv %llx", _view.ptr); }
+	void DrawIndexedInstanced(UINT _indexCount, UINT _instanceCount, UINT, INT, UINT) { Record("draw %llu %llu", _indexCount, _instanceCount); }
+
+	void ExecuteIndirect(ID3D12CommandSignature*, UINT _maxCommandCount, ID3D12Resource*, UINT64 _offset, ID3D12Resource*, UINT64)
+	{
+		Record("execute indirect %llu @%llu", _maxCommandCount, _offset);
+	}
+
+	void ResourceBarrier(UINT _count, const D3D12_RESOURCE_BARRIER* _pBarriers)
+	{
+		Record("barriers %llu", _count);
+		barrierBatches.push_back(std::vector<D3D12_RESOURCE_BARRIER>(_pBarriers, _pBarriers + _count));
+	}
+};
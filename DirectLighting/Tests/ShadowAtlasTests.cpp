@@ -0,0 +1,227 @@
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "Check.h"
+#include "ShadowAtlas.h"
+
+using namespace DirectX;
+
+namespace
+{
+	// no two placed tiles overlap, every one sits inside the atlas on a multiple of its power of two size, and
+	// together they add up to what the atlas says it has handed out
+	bool Packed(ShadowAtlas& _atlas, const ShadowAtlasTile* _tiles, uint32_t _count)
+	{
+		uint64_t area = 0;
+		for (uint32_t i = 0; i < _count; ++i)
+		{
+			const ShadowAtlasTile& tile = _tiles[i];
+			if (tile.size == 0)
+				continue;
+			if ((tile.size & (tile.size - 1)) != 0 || tile.x % tile.size != 0 || tile.y % tile.size != 0 ||
+				tile.x + tile.size > _atlas.AtlasSize() || tile.y + tile.size > _atlas.AtlasSize())
+				return false;
+			area += static_cast<uint64_t>(tile.size) * tile.size;
+			for (uint32_t j = i + 1; j < _count; ++j)
+			{
+				const ShadowAtlasTile& other = _tiles[j];
+				if (other.size != 0 && tile.x < other.x + other.size && other.x < tile.x + tile.size &&
+					tile.y < other.y + other.size && other.y < tile.y + tile.size)
+					return false;
+			}
+		}
+		return area == _atlas.UsedArea();
+	}
+
+	void TestQuadtree()
+	{
+		ShadowAtlasDesc desc;
+		ShadowAtlas atlas;
+		atlas.Init(desc);
+
+		// 1024 tiles of 256 fill an 8192 atlas exactly, each on its own spot of the grid
+		std::vector<uint32_t> nodes;
+		for (uint32_t i = 0; i < 1024; ++i)
+			nodes.push_back(atlas.Allocate(256));
+		CHECK(std::find(nodes.begin(), nodes.end(), ShadowAtlas::INVALID_NODE) == nodes.end());
+		CHECK(atlas.Allocate(128) == ShadowAtlas::INVALID_NODE);
+		CHECK(atlas.UsedArea() == 8192ull * 8192ull);
+		std::set<std::pair<uint32_t, uint32_t>> corners;
+		bool aligned = true;
+		for (uint32_t node : nodes)
+		{
+			uint32_t x, y, size;
+			atlas.NodeRect(node, x, y, size);
+			aligned = aligned && size == 256 && x % 256 == 0 && y % 256 == 0 && x < 8192 && y < 8192;
+			corners.insert(std::make_pair(x, y));
+		}
+		CHECK(aligned && corners.size() == 1024);
+
+		// freeing one tile only makes room for that size, freeing them all merges the tree back into one free root
+		atlas.Free(nodes[100]);
+		CHECK(atlas.Allocate(512) == ShadowAtlas::INVALID_NODE);
+		nodes[100] = atlas.Allocate(256);
+		CHECK(nodes[100] != ShadowAtlas::INVALID_NODE);
+		for (uint32_t node : nodes)
+			atlas.Free(node);
+		CHECK(atlas.UsedArea() == 0);
+		CHECK(atlas.Allocate(8192) == 0);
+
+		// sizes outside the desc are refused
+		atlas.Init(desc);
+		CHECK(atlas.Allocate(64) == ShadowAtlas::INVALID_NODE);
+		CHECK(atlas.Allocate(16384) == ShadowAtlas::INVALID_NODE);
+		CHECK(atlas.TileSize(1.0f) == 128 && atlas.TileSize(129.0f) == 256 && atlas.TileSize(256.0f) == 256 && atlas.TileSize(1e9f) == 2048);
+	}
+
+	// 300 lights that drift in size, with some coming and going, some changing every frame and some never
+	void TestFrames()
+	{
+		ShadowAtlasDesc desc;
+		ShadowAtlas atlas;
+		atlas.Init(desc);
+
+		std::mt19937 random(1);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		const uint32_t lightCount = 300;
+		std::vector<float> sizes(lightCount);
+		for (float& size : sizes)
+			size = 2500.0f * unit(random);
+		std::vector<ShadowAtlasRequest> requests(lightCount);
+		std::vector<ShadowAtlasTile> tiles(lightCount);
+		std::vector<ShadowAtlasTile> lastTiles(lightCount);
+
+		uint32_t overlapping = 0;
+		uint32_t missing = 0;
+		uint32_t moved = 0;
+		uint32_t staticRenders = 0;
+		for (uint32_t frame = 0; frame < 200; ++frame)
+		{
+			for (uint32_t i = 0; i < lightCount; ++i)
+			{
+				sizes[i] = std::max(1.0f, sizes[i] * (0.97f + 0.06f * unit(random)));
+				requests[i].key = i * 6;
+				requests[i].desiredSize = sizes[i];
+				requests[i].contentHash = i % 3 == 0 ? frame : 0;
+			}
+			uint32_t count = lightCount - (frame % 7) * 10;
+			atlas.Update(requests.data(), count, tiles.data());
+			overlapping += Packed(atlas, tiles.data(), count) ? 0 : 1;
+			CHECK(atlas.TileCount() <= count);
+
+			// the requests are halved until they fit, so every light gets a tile
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				missing += tiles[i].size == 0 ? 1 : 0;
+				// a tile that was not rendered has to be where it was with what it had, or it would show stale depth
+				if (!tiles[i].render && frame > 0 && i < lightCount - ((frame - 1) % 7) * 10)
+				{
+					if (tiles[i].x != lastTiles[i].x || tiles[i].y != lastTiles[i].y || tiles[i].size != lastTiles[i].size)
+						++moved;
+					if (requests[i].contentHash != 0)
+						++staticRenders;
+				}
+			}
+			std::copy(tiles.begin(), tiles.begin() + count, lastTiles.begin());
+		}
+		CHECK(overlapping == 0);
+		CHECK(missing == 0);
+		CHECK(moved == 0);
+		CHECK(staticRenders == 0);
+
+		// with nothing changing, nothing is rendered again until the atlas is invalidated
+		for (ShadowAtlasRequest& request : requests)
+			request.contentHash = 0;
+		atlas.Update(requests.data(), lightCount, tiles.data());
+		atlas.Update(requests.data(), lightCount, tiles.data());
+		uint32_t renders = 0;
+		for (const ShadowAtlasTile& tile : tiles)
+			renders += tile.render ? 1 : 0;
+		CHECK(renders == 0);
+		atlas.Invalidate();
+		atlas.Update(requests.data(), lightCount, tiles.data());
+		renders = 0;
+		for (const ShadowAtlasTile& tile : tiles)
+			renders += tile.render ? 1 : 0;
+		CHECK(renders == lightCount);
+
+		// lights nobody asks for any more give their room back
+		atlas.Update(requests.data(), 0, tiles.data());
+		CHECK(atlas.TileCount() == 0 && atlas.UsedArea() == 0);
+	}
+
+	// a size near a power of two keeps its tile until it has moved well past it
+	void TestHysteresis()
+	{
+		ShadowAtlasDesc desc;
+		ShadowAtlas atlas;
+		atlas.Init(desc);
+		ShadowAtlasRequest request = { 7, 500.0f, 1 };
+		ShadowAtlasTile tile;
+		atlas.Update(&request, 1, &tile);
+		CHECK(tile.size == 512 && tile.render);
+
+		uint32_t renders = 0;
+		for (float size : { 520.0f, 490.0f, 600.0f, 510.0f, 300.0f, 620.0f })
+		{
+			request.desiredSize = size;
+			atlas.Update(&request, 1, &tile);
+			renders += tile.render ? 1 : 0;
+			CHECK(tile.size == 512);
+		}
+		CHECK(renders == 0);
+
+		request.desiredSize = 700.0f;
+		atlas.Update(&request, 1, &tile);
+		CHECK(tile.size == 1024 && tile.render);
+		request.desiredSize = 300.0f;
+		atlas.Update(&request, 1, &tile);
+		CHECK(tile.size == 512 && tile.render);
+	}
+
+	// more than the atlas holds: everything shrinks alike, and tiles already placed keep their spots over new ones
+	void TestOvercommit()
+	{
+		ShadowAtlasDesc desc;
+		desc.atlasSize = 1024;
+		desc.minTileSize = 64;
+		desc.maxTileSize = 512;
+		ShadowAtlas atlas;
+		atlas.Init(desc);
+
+		std::vector<ShadowAtlasRequest> requests(8);
+		for (uint32_t i = 0; i < requests.size(); ++i)
+			requests[i] = { i, 512.0f, 0 };
+		std::vector<ShadowAtlasTile> tiles(requests.size());
+		atlas.Update(requests.data(), 8, tiles.data());
+		CHECK(Packed(atlas, tiles.data(), 8));
+		for (const ShadowAtlasTile& tile : tiles)
+			CHECK(tile.size == 256);
+
+		// 300 minimum sized tiles cannot all fit in 256 spots, the ones that do not get nothing
+		requests.resize(300);
+		for (uint32_t i = 0; i < requests.size(); ++i)
+			requests[i] = { i, 64.0f, 0 };
+		tiles.resize(requests.size());
+		atlas.Init(desc);
+		atlas.Update(requests.data(), 300, tiles.data());
+		CHECK(Packed(atlas, tiles.data(), 300));
+		uint32_t placed = 0;
+		for (const ShadowAtlasTile& tile : tiles)
+			placed += tile.size != 0 ? 1 : 0;
+		CHECK(placed == 256);
+	}
+}
+
+int main()
+{
+	TestQuadtree();
+	TestFrames();
+	TestHysteresis();
+	TestOvercommit();
+	return CHECK_RESULT();
+}
@@ -0,0 +1,186 @@
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Check.h"
+#include "JobSystem.h"
+#include "TextureFile.h"
+#include "TextureStreaming.h"
+
+// TextureStreamer over rgba8 textures of 256x256, nine levels of which the last seven are the tail at the default
+// tail size: the tail on its own, levels streamed in coarse to fine as a texture grows on screen, two textures
+// fighting over a budget too small for both, a level that fails its checksum, and the same again on the job system
+namespace
+{
+	const uint32_t TEXTURE_SIZE = 256;
+
+	std::vector<uint8_t> ReadFile(const std::string& _fileName)
+	{
+		std::ifstream file(_fileName, std::ios::binary);
+		return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+
+	void WriteFile(const std::string& _fileName, const std::vector<uint8_t>& _bytes)
+	{
+		std::ofstream file(_fileName, std::ios::binary);
+		file.write(reinterpret_cast<const char*>(_bytes.data()), _bytes.size());
+	}
+
+	// a grey tga, top row first, converted to an rgba8 texture with every level
+	bool MakeTexture(const std::string& _fileName)
+	{
+		std::vector<uint8_t> tga(18, 0);
+		tga[2] = 3;
+		tga[12] = static_cast<uint8_t>(TEXTURE_SIZE);
+		tga[13] = static_cast<uint8_t>(TEXTURE_SIZE >> 8);
+		tga[14] = static_cast<uint8_t>(TEXTURE_SIZE);
+		tga[15] = static_cast<uint8_t>(TEXTURE_SIZE >> 8);
+		tga[16] = 8;
+		tga[17] = 0x20;
+		for (uint32_t y = 0; y < TEXTURE_SIZE; ++y)
+		{
+			for (uint32_t x = 0; x < TEXTURE_SIZE; ++x)
+				tga.push_back(static_cast<uint8_t>(x ^ y));
+		}
+		WriteFile("streamed.tga", tga);
+
+		TextureDesc desc;
+		desc.format = TEXTURE_FORMAT_RGBA8;
+		desc.srgb = false;
+		return TextureFile::Convert("streamed.tga", _fileName, desc);
+	}
+
+	// Update until nothing is in flight any more, at most _maxFrames times, with every upload checked against the file
+	// and the levels they bring counted
+	uint32_t Stream(TextureStreamer& _streamer, const std::vector<std::pair<uint32_t, float>>& _requests, uint32_t _maxFrames = 10000)
+	{
+		uint32_t uploads = 0;
+		for (uint32_t frame = 0; frame < _maxFrames; ++frame)
+		{
+			for (const std::pair<uint32_t, float>& request : _requests)
+				_streamer.Request(request.first, request.second);
+			_streamer.Update();
+			for (const TextureStreamUpload& upload : _streamer.Uploads())
+			{
+				const TextureFileMip& mip = _streamer.File(upload.texture).Mip(upload.level);
+				CHECK(upload.level >= _streamer.ResidentMip(upload.texture) && upload.rowPitch == mip.rowPitch && upload.rowCount == mip.rowCount);
+				CHECK(memcmp(upload.pData, _streamer.File(upload.texture).MipData(upload.level), static_cast<size_t>(mip.size)) == 0);
+				uploads++;
+			}
+			if (_streamer.Stats().bytesInFlight == 0 && _streamer.Stats().readsStarted == 0 && _streamer.Uploads().empty())
+				break;
+			std::this_thread::yield();
+		}
+		return uploads;
+	}
+
+	// the tail comes in as soon as a texture is added, then levels one at a time, the coarsest first, up to what the
+	// requests want and no further
+	void TestStreaming(JobSystem* _pJobSystem)
+	{
+		TextureStreamer streamer;
+		streamer.Init(TextureStreamingDesc(), _pJobSystem);
+		CHECK(streamer.AddTexture("Missing.tex") == TextureStreamer::INVALID_TEXTURE);
+		uint32_t texture = streamer.AddTexture("streamed.tex");
+		CHECK(texture == 0 && streamer.TextureCount() == 1);
+		if (texture == TextureStreamer::INVALID_TEXTURE)
+			return;
+		TextureFile& file = streamer.File(texture);
+		CHECK(file.Header().mipCount == 9);
+
+		// levels no larger than 64 texels, the seven from 64x64 down, are the tail
+		CHECK(Stream(streamer, {}) == 7);
+		CHECK(streamer.ResidentMip(texture) == 2 && streamer.WantedMip(texture) == 2);
+		CHECK(streamer.Stats().residentBytes == TextureStreamer::LevelBytes(file, 2));
+
+		// a texel to a pixel: 64 pixels across wants the tail, 128 the level above, 256 the first. with a texture that
+		// repeats twice across, 256 pixels are only worth the second level. of two requests in a frame the sharpest wins
+		CHECK(Stream(streamer, { { texture, 64.0f } }) == 0 && streamer.ResidentMip(texture) == 2);
+		CHECK(Stream(streamer, { { texture, 40.0f }, { texture, 100.0f } }) == 1);
+		CHECK(streamer.ResidentMip(texture) == 1 && streamer.WantedMip(texture) == 1);
+		streamer.Request(texture, 256.0f, 2.0f);
+		streamer.Update();
+		CHECK(streamer.WantedMip(texture) == 1 && streamer.Stats().readsStarted == 0);
+		CHECK(Stream(streamer, { { texture, 256.0f } }) == 1);
+		CHECK(streamer.ResidentMip(texture) == 0 && streamer.Stats().residentBytes == TextureStreamer::LevelBytes(file, 0));
+		CHECK(streamer.Stats().texturesBlurry == 0 && streamer.Stats().bytesRead == TextureStreamer::LevelBytes(file, 0));
+
+		// with room in the budget nothing is dropped when the texture is no longer wanted
+		Stream(streamer, {});
+		CHECK(streamer.WantedMip(texture) == 2 && streamer.ResidentMip(texture) == 0 && streamer.Stats().levelsEvicted == 0);
+		streamer.Shutdown();
+		CHECK(streamer.TextureCount() == 0);
+	}
+
+	// room for both tails and the two sharpest levels of one texture. the bigger on screen keeps what it wants, the
+	// other gives up its level for it and cannot take it back, until the first is no longer drawn
+	void TestBudget(JobSystem* _pJobSystem)
+	{
+		TextureFile file;
+		CHECK(file.Open("streamed.tex"));
+		if (!file.IsOpen())
+			return;
+		WriteFile("streamed2.tex", ReadFile("streamed.tex"));
+
+		TextureStreamingDesc desc;
+		desc.budgetBytes = 2 * TextureStreamer::LevelBytes(file, 2) + file.Mip(0).size + file.Mip(1).size;
+		TextureStreamer streamer;
+		streamer.Init(desc, _pJobSystem);
+		uint32_t near = streamer.AddTexture("streamed.tex");
+		uint32_t far = streamer.AddTexture("streamed2.tex");
+		CHECK(near == 0 && far == 1);
+		if (far == TextureStreamer::INVALID_TEXTURE)
+			return;
+
+		Stream(streamer, { { near, 256.0f }, { far, 128.0f } });
+		CHECK(streamer.ResidentMip(near) == 0 && streamer.ResidentMip(far) == 2);
+		CHECK(streamer.Stats().peakResidentBytes <= desc.budgetBytes);
+		streamer.Request(near, 256.0f);
+		streamer.Request(far, 128.0f);
+		streamer.Update();
+		CHECK(streamer.Stats().texturesRequested == 2 && streamer.Stats().texturesBlurry == 1 && streamer.Stats().missingLevels == 1);
+
+		// the near texture's levels are no longer wanted, so they go first
+		Stream(streamer, { { far, 128.0f } });
+		CHECK(streamer.ResidentMip(far) == 1 && streamer.ResidentMip(near) >= 1);
+		CHECK(streamer.Stats().peakResidentBytes <= desc.budgetBytes);
+	}
+
+	// a level that fails its checksum is not uploaded, the texture keeps what it had and asks for nothing more
+	void TestDamage(JobSystem* _pJobSystem)
+	{
+		TextureFile file;
+		CHECK(file.Open("streamed.tex"));
+		if (!file.IsOpen())
+			return;
+		std::vector<uint8_t> bytes = ReadFile("streamed.tex");
+		bytes[static_cast<size_t>(file.Mip(0).offset) + 5] ^= 1;
+		WriteFile("damaged.tex", bytes);
+
+		TextureStreamer streamer;
+		streamer.Init(TextureStreamingDesc(), _pJobSystem);
+		uint32_t texture = streamer.AddTexture("damaged.tex");
+		CHECK(texture != TextureStreamer::INVALID_TEXTURE);
+		if (texture == TextureStreamer::INVALID_TEXTURE)
+			return;
+		CHECK(Stream(streamer, { { texture, 256.0f } }) == 8);
+		CHECK(streamer.ResidentMip(texture) == 1 && streamer.Stats().residentBytes == TextureStreamer::LevelBytes(file, 1));
+		CHECK(streamer.Stats().bytesRead == TextureStreamer::LevelBytes(file, 0) && streamer.Stats().texturesBlurry == 1);
+	}
+}
+
+int main()
+{
+	CHECK(MakeTexture("streamed.tex"));
+	JobSystem jobSystem;
+	jobSystem.Init(3);
+	for (JobSystem* pJobSystem : { static_cast<JobSystem*>(nullptr), &jobSystem })
+	{
+		TestStreaming(pJobSystem);
+		TestBudget(pJobSystem);
+		TestDamage(pJobSystem);
+	}
+	return CHECK_RESULT();
+}
@@ -0,0 +1,427 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "BlockCompression.h"
+#include "Check.h"
+#include "ImageImporter.h"
+#include "JobSystem.h"
+#include "TextureFile.h"
+#include "TextureProcessing.h"
+
+// the texture pipeline: every png and tga variant the importer takes against the pixels Data/MakeImages.py put in
+// them, the mip filter, and each BC format decoded again by the reference decoders below
+namespace
+{
+	std::vector<uint8_t> ReadFile(const std::string& _fileName)
+	{
+		std::ifstream file(_fileName, std::ios::binary);
+		return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+
+	void WriteFile(const std::string& _fileName, const std::vector<uint8_t>& _bytes)
+	{
+		std::ofstream file(_fileName, std::ios::binary);
+		file.write(reinterpret_cast<const char*>(_bytes.data()), _bytes.size());
+	}
+
+	// decoders written from the format specs, not from the encoder
+	void Unpack565(uint16_t _colour, int* _pRgb)
+	{
+		int r = _colour >> 11;
+		int g = (_colour >> 5) & 63;
+		int b = _colour & 31;
+		_pRgb[0] = r << 3 | r >> 2;
+		_pRgb[1] = g << 2 | g >> 4;
+		_pRgb[2] = b << 3 | b >> 2;
+	}
+
+	void DecodeBC1(const uint8_t* _pBlock, uint8_t* _pTexels, bool _alwaysFourColours)
+	{
+		uint16_t colour0, colour1;
+		uint32_t indices;
+		memcpy(&colour0, _pBlock, 2);
+		memcpy(&colour1, _pBlock + 2, 2);
+		memcpy(&indices, _pBlock + 4, 4);
+		int palette[4][4];
+		Unpack565(colour0, palette[0]);
+		Unpack565(colour1, palette[1]);
+		palette[0][3] = palette[1][3] = palette[2][3] = 255;
+		bool fourColours = colour0 > colour1 || _alwaysFourColours;
+		for (int c = 0; c < 3; ++c)
+		{
+			palette[2][c] = fourColours ? (2 * palette[0][c] + palette[1][c]) / 3 : (palette[0][c] + palette[1][c]) / 2;
+			palette[3][c] = fourColours ? (palette[0][c] + 2 * palette[1][c]) / 3 : 0;
+		}
+		palette[3][3] = fourColours ? 255 : 0;
+		for (int i = 0; i < 16; ++i)
+		{
+			for (int c = 0; c < 4; ++c)
+				_pTexels[i * 4 + c] = static_cast<uint8_t>(palette[(indices >> (2 * i)) & 3][c]);
+		}
+	}
+
+	void DecodeBC4(const uint8_t* _pBlock, uint8_t* _pValues, int _stride)
+	{
+		int value0 = _pBlock[0];
+		int value1 = _pBlock[1];
+		float palette[8] = { static_cast<float>(value0), static_cast<float>(value1) };
+		if (value0 > value1)
+		{
+			for (int i = 1; i < 7; ++i)
+				palette[i + 1] = ((7 - i) * value0 + i * value1) / 7.0f;
+		}
+		else
+		{
+			for (int i = 1; i < 5; ++i)
+				palette[i + 1] = ((5 - i) * value0 + i * value1) / 5.0f;
+			palette[6] = 0.0f;
+			palette[7] = 255.0f;
+		}
+		uint64_t bits = 0;
+		for (int i = 0; i < 6; ++i)
+			bits |= static_cast<uint64_t>(_pBlock[2 + i]) << (8 * i);
+		for (int i = 0; i < 16; ++i)
+			_pValues[i * _stride] = static_cast<uint8_t>(palette[(bits >> (3 * i)) & 7] + 0.5f);
+	}
+
+	uint32_t ReadBits(const uint8_t* _pBlock, int& _position, int _count)
+	{
+		uint32_t value = 0;
+		for (int i = 0; i < _count; ++i, ++_position)
+			value |= ((_pBlock[_position / 8] >> (_position % 8)) & 1u) << i;
+		return value;
+	}
+
+	// mode 6 only, which is all the encoder writes
+	bool DecodeBC7(const uint8_t* _pBlock, uint8_t* _pTexels)
+	{
+		int position = 0;
+		if (ReadBits(_pBlock, position, 7) != 0x40)
+			return false;
+		int endPoints[2][4];
+		for (int c = 0; c < 4; ++c)
+		{
+			endPoints[0][c] = ReadBits(_pBlock, position, 7);
+			endPoints[1][c] = ReadBits(_pBlock, position, 7);
+		}
+		int shared0 = ReadBits(_pBlock, position, 1);
+		int shared1 = ReadBits(_pBlock, position, 1);
+		for (int c = 0; c < 4; ++c)
+		{
+			endPoints[0][c] = endPoints[0][c] << 1 | shared0;
+			endPoints[1][c] = endPoints[1][c] << 1 | shared1;
+		}
+		static const int WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+		for (int i = 0; i < 16; ++i)
+		{
+			int index = ReadBits(_pBlock, position, i == 0 ? 3 : 4);
+			for (int c = 0; c < 4; ++c)
+				_pTexels[i * 4 + c] = static_cast<uint8_t>(((64 - WEIGHTS[index]) * endPoints[0][c] + WEIGHTS[index] * endPoints[1][c] + 32) >> 6);
+		}
+		return position == 128;
+	}
+
+	void DecodeLevel(TextureFormat _format, const uint8_t* _pData, uint32_t _width, uint32_t _height, std::vector<uint8_t>& _pixels)
+	{
+		_pixels.assign(static_cast<size_t>(_width) * _height * 4, 0);
+		uint32_t blocksWide = (_width + 3) / 4;
+		uint32_t blockBytes = BlockCompression::BlockBytes(_format);
+		for (uint32_t blockY = 0; blockY < (_height + 3) / 4; ++blockY)
+		{
+			for (uint32_t blockX = 0; blockX < blocksWide; ++blockX)
+			{
+				const uint8_t* pBlock = _pData + (static_cast<size_t>(blockY) * blocksWide + blockX) * blockBytes;
+				uint8_t texels[64] = {};
+				if (_format == TEXTURE_FORMAT_BC1)
+					DecodeBC1(pBlock, texels, false);
+				else if (_format == TEXTURE_FORMAT_BC3)
+				{
+					DecodeBC1(pBlock + 8, texels, true);
+					DecodeBC4(pBlock, texels + 3, 4);
+				}
+				else if (_format == TEXTURE_FORMAT_BC5)
+				{
+					DecodeBC4(pBlock, texels, 4);
+					DecodeBC4(pBlock + 8, texels + 1, 4);
+				}
+				else
+					CHECK(DecodeBC7(pBlock, texels));
+
+				for (uint32_t y = 0; y < 4; ++y)
+				{
+					for (uint32_t x = 0; x < 4; ++x)
+					{
+						uint32_t pixelX = blockX * 4 + x;
+						uint32_t pixelY = blockY * 4 + y;
+						if (pixelX < _width && pixelY < _height)
+							memcpy(&_pixels[(static_cast<size_t>(pixelY) * _width + pixelX) * 4], texels + (y * 4 + x) * 4, 4);
+					}
+				}
+			}
+		}
+	}
+
+	// over the first _channels of every rgba8 texel
+	double Psnr(const std::vector<uint8_t>& _a, const std::vector<uint8_t>& _b, int _channels)
+	{
+		double squaredError = 0.0;
+		size_t count = 0;
+		for (size_t i = 0; i < _a.size(); i += 4)
+		{
+			for (int c = 0; c < _channels; ++c, ++count)
+			{
+				double difference = static_cast<double>(_a[i + c]) - _b[i + c];
+				squaredError += difference * difference;
+			}
+		}
+		return squaredError == 0.0 ? 99.0 : 10.0 * log10(255.0 * 255.0 * count / squaredError);
+	}
+
+	void TestImport()
+	{
+		const char* images[][2] = {
+			{ "rgba8.png", "rgba8.ref" }, // every filter type, two IDAT chunks
+			{ "rgba8_l0.png", "rgba8.ref" }, // stored blocks
+			{ "rgba8_l9.png", "rgba8.ref" },
+			{ "rgb16.png", "rgb16.ref" }, // 16 bit with a tRNS colour key
+			{ "pal4.png", "pal4.ref" }, // 4 bit palette with tRNS alpha
+			{ "grey1.png", "grey1.ref" },
+			{ "ga8.png", "ga8.ref" },
+			{ "rle24.tga", "rle24.ref" }, // run length encoded, bottom up
+			{ "raw32.tga", "raw32.ref" }, // top down
+		};
+		for (const auto& image : images)
+		{
+			Image decoded;
+			bool loaded = ImageImporter::Load(std::string(TEST_DATA_DIR) + image[0], decoded);
+			CHECK(loaded && decoded.width == 37 && decoded.height == 23);
+			CHECK(loaded && decoded.pixels == ReadFile(std::string(TEST_DATA_DIR) + image[1]));
+		}
+
+		// a truncated file and a flipped bit in the middle of the deflate stream both fail
+		std::vector<uint8_t> png = ReadFile(std::string(TEST_DATA_DIR) + "rgba8.png");
+		Image decoded;
+		CHECK(!ImageImporter::DecodePng(png.data(), png.size() - 30, decoded));
+		png[png.size() / 2] ^= 0x55;
+		CHECK(!ImageImporter::DecodePng(png.data(), png.size(), decoded));
+	}
+
+	void TestMips(JobSystem* _pJobSystem)
+	{
+		// a flat colour stays that colour down odd sized levels, wrapped or not
+		Image flat;
+		flat.width = 13;
+		flat.height = 7;
+		for (uint32_t i = 0; i < flat.width * flat.height; ++i)
+			flat.pixels.insert(flat.pixels.end(), { 200, 30, 99, 128 });
+		TextureDesc desc;
+		std::vector<TextureMip> mips(1);
+		TextureProcessing::ToLinear(flat, desc, mips[0]);
+		TextureProcessing::GenerateMips(mips, desc, _pJobSystem);
+		CHECK(mips.size() == 4 && TextureProcessing::MipCount(13, 7) == 4);
+		CHECK(mips[1].width == 6 && mips[1].height == 3 && mips[2].width == 3 && mips[2].height == 1 && mips[3].width == 1);
+		std::vector<uint8_t> pixels;
+		TextureProcessing::ToRgba8(mips.back(), desc, pixels, _pJobSystem);
+		CHECK(pixels == std::vector<uint8_t>({ 200, 30, 99, 128 }));
+		desc.wrap = false;
+		mips.resize(1);
+		TextureProcessing::GenerateMips(mips, desc, _pJobSystem);
+		TextureProcessing::ToRgba8(mips[1], desc, pixels, _pJobSystem);
+		CHECK(pixels[0] == 200 && pixels[1] == 30 && pixels[2] == 99 && pixels[3] == 128);
+
+		// a black and white checker averages to half the light: 188 in srgb, 128 when the values are linear already
+		Image checker;
+		checker.width = checker.height = 64;
+		for (uint32_t y = 0; y < 64; ++y)
+		{
+			for (uint32_t x = 0; x < 64; ++x)
+			{
+				uint8_t value = ((x + y) & 1) ? 255 : 0;
+				checker.pixels.insert(checker.pixels.end(), { value, value, value, 255 });
+			}
+		}
+		desc = TextureDesc();
+		mips.resize(1);
+		TextureProcessing::ToLinear(checker, desc, mips[0]);
+		TextureProcessing::GenerateMips(mips, desc, _pJobSystem);
+		TextureProcessing::ToRgba8(mips[1], desc, pixels);
+		CHECK(abs(pixels[0] - 188) <= 1);
+		desc.srgb = false;
+		mips.resize(1);
+		TextureProcessing::ToLinear(checker, desc, mips[0]);
+		TextureProcessing::GenerateMips(mips, desc, _pJobSystem);
+		TextureProcessing::ToRgba8(mips[1], desc, pixels);
+		CHECK(abs(pixels[0] - 128) <= 1);
+
+		// to linear and back gives every srgb byte back
+		Image ramp;
+		ramp.width = 256;
+		ramp.height = 1;
+		for (uint32_t i = 0; i < 256; ++i)
+			ramp.pixels.insert(ramp.pixels.end(), { static_cast<uint8_t>(i), static_cast<uint8_t>(i), static_cast<uint8_t>(i), static_cast<uint8_t>(i) });
+		desc = TextureDesc();
+		TextureMip mip;
+		TextureProcessing::ToLinear(ramp, desc, mip);
+		TextureProcessing::ToRgba8(mip, desc, pixels);
+		CHECK(pixels == ramp.pixels);
+	}
+
+	void TestBlockCompression(JobSystem* _pJobSystem)
+	{
+		// smooth gradients with hard edged patches in them
+		const uint32_t size = 256;
+		std::vector<uint8_t> source(size * size * 4);
+		for (uint32_t y = 0; y < size; ++y)
+		{
+			for (uint32_t x = 0; x < size; ++x)
+			{
+				uint8_t* pTexel = &source[(y * size + x) * 4];
+				float u = x / static_cast<float>(size);
+				float v = y / static_cast<float>(size);
+				pTexel[0] = static_cast<uint8_t>(127.5f + 127.5f * sinf(u * 20.0f + sinf(v * 7.0f) * 3.0f));
+				pTexel[1] = static_cast<uint8_t>(255.0f * u * v);
+				pTexel[2] = static_cast<uint8_t>(127.5f + 127.5f * cosf((u + v) * 13.0f));
+				pTexel[3] = static_cast<uint8_t>(255.0f * (0.5f + 0.5f * sinf(v * 9.0f)));
+				if ((x / 37 + y / 29) % 3 == 0)
+					pTexel[0] = 255 - pTexel[0];
+			}
+		}
+
+		// the lowest psnr each format has to reach over the channels it keeps
+		struct FormatCase
+		{
+			TextureFormat format;
+			int channels;
+			double minPsnr;
+		};
+		const FormatCase cases[] = { { TEXTURE_FORMAT_BC1, 3, 34.0 }, { TEXTURE_FORMAT_BC3, 4, 35.0 }, { TEXTURE_FORMAT_BC5, 2, 42.0 },
+			{ TEXTURE_FORMAT_BC7, 4, 38.0 } };
+		double bc1Psnr = 0.0;
+		double bc7Psnr = 0.0;
+		for (const FormatCase& formatCase : cases)
+		{
+			std::vector<uint8_t> pixels = source;
+			if (formatCase.format == TEXTURE_FORMAT_BC1)
+			{
+				for (size_t i = 3; i < pixels.size(); i += 4)
+					pixels[i] = 255;
+			}
+			std::vector<uint8_t> blocks, decoded;
+			BlockCompression::Compress(pixels.data(), size, size, formatCase.format, blocks, _pJobSystem);
+			CHECK(blocks.size() == (size / 4) * (size / 4) * BlockCompression::BlockBytes(formatCase.format));
+			DecodeLevel(formatCase.format, blocks.data(), size, size, decoded);
+			double psnr = Psnr(pixels, decoded, formatCase.channels);
+			printf("%u: %.2f dB\n", formatCase.format, psnr);
+			CHECK(psnr >= formatCase.minPsnr);
+			if (formatCase.format == TEXTURE_FORMAT_BC1)
+				bc1Psnr = Psnr(pixels, decoded, 3);
+			if (formatCase.format == TEXTURE_FORMAT_BC7)
+				bc7Psnr = Psnr(pixels, decoded, 3);
+		}
+		CHECK(bc7Psnr > bc1Psnr + 3.0);
+
+		// BC1 keeps cut out texels transparent and the rest opaque
+		uint8_t block[64], encoded[16], texels[64];
+		for (int i = 0; i < 16; ++i)
+		{
+			block[i * 4 + 0] = static_cast<uint8_t>(10 * i);
+			block[i * 4 + 1] = 200;
+			block[i * 4 + 2] = 5;
+			block[i * 4 + 3] = i % 3 == 0 ? 0 : 255;
+		}
+		BlockCompression::EncodeBC1(block, encoded);
+		DecodeBC1(encoded, texels, false);
+		for (int i = 0; i < 16; ++i)
+			CHECK((texels[i * 4 + 3] == 0) == (i % 3 == 0));
+
+		// a single colour comes back within the 565 table's reach in BC1 and nearly exact in BC7
+		for (int colour = 0; colour < 256; colour += 17)
+		{
+			for (int i = 0; i < 16; ++i)
+			{
+				block[i * 4 + 0] = static_cast<uint8_t>(colour);
+				block[i * 4 + 1] = static_cast<uint8_t>(255 - colour);
+				block[i * 4 + 2] = static_cast<uint8_t>(colour / 2);
+				block[i * 4 + 3] = 255;
+			}
+			BlockCompression::EncodeBC1(block, encoded);
+			DecodeBC1(encoded, texels, false);
+			for (int c = 0; c < 3; ++c)
+				CHECK(abs(texels[c] - block[c]) <= 3);
+			BlockCompression::EncodeBC7(block, encoded);
+			CHECK(DecodeBC7(encoded, texels));
+			for (int c = 0; c < 64; ++c)
+				CHECK(abs(texels[c] - block[c]) <= 1);
+		}
+
+		// BC4 with both 0 and 255 among middling values takes the six value mode and keeps the extremes exact
+		const uint8_t values[16] = { 0, 255, 0, 255, 100, 110, 120, 130, 0, 255, 105, 115, 125, 0, 255, 100 };
+		uint8_t decodedValues[16];
+		BlockCompression::EncodeBC4(values, 1, encoded);
+		DecodeBC4(encoded, decodedValues, 1);
+		for (int i = 0; i < 16; ++i)
+			CHECK(abs(decodedValues[i] - values[i]) <= 3);
+
+		// sizes that are not a multiple of four still get whole blocks
+		std::vector<uint8_t> blocks;
+		BlockCompression::Compress(source.data(), 5, 3, TEXTURE_FORMAT_BC7, blocks, _pJobSystem);
+		CHECK(blocks.size() == 2 * 16);
+	}
+
+	void TestTextureFile(JobSystem* _pJobSystem)
+	{
+		std::string source = std::string(TEST_DATA_DIR) + "rgba8.png";
+		for (uint32_t format = TEXTURE_FORMAT_RGBA8; format <= TEXTURE_FORMAT_BC7; ++format)
+		{
+			TextureDesc desc;
+			desc.format = static_cast<TextureFormat>(format);
+			desc.normalMap = desc.format == TEXTURE_FORMAT_BC5;
+			TextureConvertStats stats;
+			CHECK(TextureFile::Convert(source, "texture.tex", desc, _pJobSystem, &stats));
+			TextureFile file;
+			CHECK(file.Open("texture.tex", true, _pJobSystem));
+			if (!file.IsOpen())
+				continue;
+			CHECK(file.Header().format == TextureFile::DxgiFormat(desc) && file.Header().mipCount == stats.mipCount);
+			// block compressed textures are resampled up to 40x24 first
+			CHECK(file.Header().width == (format == TEXTURE_FORMAT_RGBA8 ? 37u : 40u));
+			for (uint32_t level = 0; level < file.Header().mipCount; ++level)
+				CHECK(file.Mip(level).offset % TextureFile::MIP_ALIGNMENT == 0);
+			CHECK(TextureFile::IsUpToDate(source, "texture.tex", desc));
+			desc.wrap = !desc.wrap;
+			CHECK(!TextureFile::IsUpToDate(source, "texture.tex", desc));
+		}
+
+		// a source that changes makes its texture out of date
+		WriteFile("source.png", ReadFile(source));
+		TextureDesc desc;
+		CHECK(TextureFile::Convert("source.png", "texture.tex", desc, _pJobSystem));
+		CHECK(TextureFile::IsUpToDate("source.png", "texture.tex", desc));
+		std::ofstream("source.png", std::ios::binary | std::ios::app).write("x", 1);
+		CHECK(!TextureFile::IsUpToDate("source.png", "texture.tex", desc));
+
+		// a damaged level fails its checksum, unless checksums are skipped
+		std::vector<uint8_t> texture = ReadFile("texture.tex");
+		texture[texture.size() - 5] ^= 1;
+		WriteFile("damaged.tex", texture);
+		TextureFile file;
+		CHECK(!file.Open("damaged.tex"));
+		CHECK(file.Open("damaged.tex", false));
+	}
+}
+
+int main()
+{
+	JobSystem jobSystem;
+	jobSystem.Init();
+	TestImport();
+	TestMips(&jobSystem);
+	TestBlockCompression(&jobSystem);
+	TestTextureFile(&jobSystem);
+	return CHECK_RESULT();
+}
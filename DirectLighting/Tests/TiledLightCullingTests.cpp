@@ -0,0 +1,232 @@
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "Check.h"
+#include "JobSystem.h"
+#include "TiledLightCulling.h"
+
+using namespace DirectX;
+
+// TiledLightCulling::Cull against a brute-force check done separately in double precision: each tile's frustum built
+// from its corner rays and the view depth range under it, and each light's bounding sphere tested against its planes.
+// the two only have to agree where the sphere is clearly in or clearly out, right on a plane rounding decides
+namespace
+{
+	const uint32_t WIDTH = 1920;
+	const uint32_t HEIGHT = 1080;
+	const float NEAR_Z = 0.1f;
+	const float FAR_Z = 1000.0f;
+
+	struct Scene
+	{
+		XMFLOAT4X4 view;
+		XMFLOAT4X4 proj;
+		std::vector<float> depth; // what a depth buffer would hold
+		std::vector<float> viewZ; // and the view depth it came from
+		std::vector<Light> lights;
+	};
+
+	// a floor that runs away from the camera with a wave across it, and a strip of sky at the top
+	Scene MakeScene(uint32_t _lightCount)
+	{
+		Scene scene;
+		XMStoreFloat4x4(&scene.proj, XMMatrixPerspectiveFovLH(45.0f * (3.14f / 180.0f), static_cast<float>(WIDTH) / HEIGHT, NEAR_Z, FAR_Z));
+		XMStoreFloat4x4(&scene.view, XMMatrixLookAtLH(XMVectorSet(0.0f, 2.0f, -4.0f, 1.0f), XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)));
+		scene.depth.resize(WIDTH * HEIGHT);
+		scene.viewZ.resize(WIDTH * HEIGHT);
+		for (uint32_t y = 0; y < HEIGHT; ++y)
+		{
+			for (uint32_t x = 0; x < WIDTH; ++x)
+			{
+				float z = y < 100 ? FAR_Z : 2.0f + 58.0f * y / HEIGHT + 5.0f * std::sin(x * 0.01f);
+				scene.viewZ[y * WIDTH + x] = z;
+				scene.depth[y * WIDTH + x] = z >= FAR_Z ? 1.0f : scene.proj._33 + scene.proj._43 / z;
+			}
+		}
+
+		std::mt19937 random(5);
+		std::uniform_real_distribution<float> spread(-40.0f, 40.0f);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		scene.lights.resize(_lightCount);
+		for (Light& light : scene.lights)
+		{
+			light.position = XMFLOAT3(spread(random), spread(random) * 0.2f, spread(random) + 30.0f);
+			light.range = 0.5f + 6.0f * unit(random);
+			light.color = XMFLOAT3(1.0f, 1.0f, 1.0f);
+			light.type = unit(random) < 0.3f ? LIGHT_SPOT : LIGHT_POINT;
+			XMStoreFloat3(&light.direction, XMVector3Normalize(XMVectorSet(spread(random), spread(random), spread(random), 0.0f)));
+			light.cosOuterAngle = std::cos(0.2f + unit(random));
+		}
+		// one light around the camera and one behind it
+		scene.lights[0].position = XMFLOAT3(0.0f, 2.0f, -4.0f);
+		scene.lights[0].type = LIGHT_POINT;
+		scene.lights[0].range = 100.0f;
+		scene.lights[1].position = XMFLOAT3(0.0f, 2.5f, -12.0f);
+		scene.lights[1].type = LIGHT_POINT;
+		scene.lights[1].range = 2.0f;
+		return scene;
+	}
+
+	enum Verdict
+	{
+		VERDICT_OUT,
+		VERDICT_IN,
+		VERDICT_CLOSE // within rounding of a plane
+	};
+
+	Verdict BruteForce(const Scene& _scene, uint32_t _tileX, uint32_t _tileY, double _minZ, double _maxZ, const Light& _light)
+	{
+		XMFLOAT4 sphere = LightBoundingSphere(_light);
+		XMVECTOR center = XMVector3TransformCoord(XMVectorSet(sphere.x, sphere.y, sphere.z, 1.0f), XMLoadFloat4x4(&_scene.view));
+		double x = XMVectorGetX(center);
+		double y = XMVectorGetY(center);
+		double z = XMVectorGetZ(center);
+		double radius = sphere.w;
+
+		// the tile's edges as slopes x / z and y / z, then the signed distance inside each side plane
+		double left = (2.0 * std::min(_tileX * TILED_CULLING_TILE_SIZE, WIDTH) / WIDTH - 1.0) / _scene.proj._11;
+		double right = (2.0 * std::min((_tileX + 1) * TILED_CULLING_TILE_SIZE, WIDTH) / WIDTH - 1.0) / _scene.proj._11;
+		double top = (1.0 - 2.0 * std::min(_tileY * TILED_CULLING_TILE_SIZE, HEIGHT) / HEIGHT) / _scene.proj._22;
+		double bottom = (1.0 - 2.0 * std::min((_tileY + 1) * TILED_CULLING_TILE_SIZE, HEIGHT) / HEIGHT) / _scene.proj._22;
+		double slack[6] =
+		{
+			(x - left * z) / std::sqrt(1.0 + left * left) + radius,
+			(right * z - x) / std::sqrt(1.0 + right * right) + radius,
+			(top * z - y) / std::sqrt(1.0 + top * top) + radius,
+			(y - bottom * z) / std::sqrt(1.0 + bottom * bottom) + radius,
+			// the sphere's depth range has to reach past the near plane and overlap the tile's
+			std::min(z + radius - NEAR_Z, z + radius - _minZ),
+			_maxZ - (z - radius)
+		};
+
+		Verdict verdict = VERDICT_IN;
+		for (double value : slack)
+		{
+			double tolerance = 1e-4 * std::max(1.0, std::abs(z) + radius);
+			if (value < -tolerance)
+				return VERDICT_OUT;
+			if (value <= tolerance)
+				verdict = VERDICT_CLOSE;
+		}
+		return verdict;
+	}
+
+	void TestAgainstBruteForce(JobSystem& _jobSystem)
+	{
+		Scene scene = MakeScene(300);
+		TiledLightCulling culling;
+		culling.Init(WIDTH, HEIGHT, scene.proj);
+		culling.PrepareLights(scene.lights.data(), static_cast<uint32_t>(scene.lights.size()), scene.view);
+		culling.ComputeDepthBounds(scene.depth.data(), WIDTH);
+		culling.Cull();
+		std::vector<uint32_t> serialMasks = culling.TileMasks();
+		std::vector<XMFLOAT2> serialBounds = culling.TileDepthBounds();
+
+		// the job system splits the work by rows and has to give back the same bits
+		culling.PrepareLights(scene.lights.data(), static_cast<uint32_t>(scene.lights.size()), scene.view, &_jobSystem);
+		culling.ComputeDepthBounds(scene.depth.data(), WIDTH, &_jobSystem);
+		culling.Cull(&_jobSystem);
+		CHECK(serialMasks == culling.TileMasks());
+
+		uint32_t wrongBounds = 0;
+		uint32_t disagreements = 0;
+		uint32_t close = 0;
+		uint32_t inside = 0;
+		for (uint32_t tileY = 0; tileY < culling.TilesY(); ++tileY)
+		{
+			for (uint32_t tileX = 0; tileX < culling.TilesX(); ++tileX)
+			{
+				// the tile's depth and view depth range, straight from the pixels under it
+				float minDepth = 1.0f, maxDepth = 0.0f;
+				double minZ = FAR_Z, maxZ = 0.0;
+				for (uint32_t y = tileY * TILED_CULLING_TILE_SIZE; y < std::min((tileY + 1) * TILED_CULLING_TILE_SIZE, HEIGHT); ++y)
+				{
+					for (uint32_t x = tileX * TILED_CULLING_TILE_SIZE; x < std::min((tileX + 1) * TILED_CULLING_TILE_SIZE, WIDTH); ++x)
+					{
+						minDepth = std::min(minDepth, scene.depth[y * WIDTH + x]);
+						maxDepth = std::max(maxDepth, scene.depth[y * WIDTH + x]);
+						minZ = std::min(minZ, static_cast<double>(scene.viewZ[y * WIDTH + x]));
+						maxZ = std::max(maxZ, static_cast<double>(scene.viewZ[y * WIDTH + x]));
+					}
+				}
+				uint32_t tile = tileY * culling.TilesX() + tileX;
+				if (serialBounds[tile].x != minDepth || serialBounds[tile].y != maxDepth)
+					++wrongBounds;
+
+				for (uint32_t i = 0; i < scene.lights.size(); ++i)
+				{
+					Verdict verdict = BruteForce(scene, tileX, tileY, minZ, maxZ, scene.lights[i]);
+					if (verdict == VERDICT_CLOSE)
+						++close;
+					else if ((verdict == VERDICT_IN) != culling.TileHasLight(tile, i))
+						++disagreements;
+					inside += verdict == VERDICT_IN ? 1 : 0;
+				}
+			}
+		}
+		CHECK(wrongBounds == 0);
+		CHECK(disagreements == 0);
+		CHECK(inside > 1000); // the scene really puts lights in tiles
+		CHECK(close < inside / 100);
+
+		// the light around the camera reaches every tile under the sky, the one behind it no tile at all
+		bool everyTile = true, noTile = true;
+		for (uint32_t tile = 0; tile < culling.TilesX() * culling.TilesY(); ++tile)
+		{
+			if (tile / culling.TilesX() > 100 / TILED_CULLING_TILE_SIZE)
+				everyTile = everyTile && culling.TileHasLight(tile, 0);
+			noTile = noTile && !culling.TileHasLight(tile, 1);
+		}
+		CHECK(everyTile && noTile);
+	}
+
+	// whatever rounding does on the planes, a pixel lit by a point light must never be in a tile that dropped it
+	void TestConservative()
+	{
+		Scene scene = MakeScene(200);
+		TiledLightCulling culling;
+		culling.Init(WIDTH, HEIGHT, scene.proj);
+		culling.PrepareLights(scene.lights.data(), static_cast<uint32_t>(scene.lights.size()), scene.view);
+		culling.ComputeDepthBounds(scene.depth.data(), WIDTH);
+		culling.Cull();
+
+		XMMATRIX view = XMLoadFloat4x4(&scene.view);
+		uint32_t lit = 0;
+		uint32_t missed = 0;
+		for (uint32_t i = 0; i < scene.lights.size(); ++i)
+		{
+			const Light& light = scene.lights[i];
+			if (light.type != LIGHT_POINT)
+				continue;
+			XMFLOAT3 center;
+			XMStoreFloat3(&center, XMVector3TransformCoord(XMLoadFloat3(&light.position), view));
+			for (uint32_t y = 100; y < HEIGHT; y += 5)
+			{
+				for (uint32_t x = 0; x < WIDTH; x += 5)
+				{
+					float z = scene.viewZ[y * WIDTH + x];
+					float pixelX = ((x + 0.5f) / WIDTH * 2.0f - 1.0f) * z / scene.proj._11;
+					float pixelY = (1.0f - (y + 0.5f) / HEIGHT * 2.0f) * z / scene.proj._22;
+					float dx = pixelX - center.x, dy = pixelY - center.y, dz = z - center.z;
+					if (dx * dx + dy * dy + dz * dz > light.range * light.range)
+						continue;
+					++lit;
+					uint32_t tile = (y / TILED_CULLING_TILE_SIZE) * culling.TilesX() + x / TILED_CULLING_TILE_SIZE;
+					missed += culling.TileHasLight(tile, i) ? 0 : 1;
+				}
+			}
+		}
+		CHECK(lit > 0 && missed == 0);
+	}
+}
+
+int main()
+{
+	JobSystem jobSystem;
+	jobSystem.Init(3);
+	TestAgainstBruteForce(jobSystem);
+	TestConservative();
+	return CHECK_RESULT();
+}
@@ -0,0 +1,175 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "Check.h"
+#include "JobSystem.h"
+#include "MeshImporter.h"
+#include "VertexCompression.h"
+
+using namespace DirectX;
+
+namespace
+{
+	// a position comes back within half a 16 bit step of its bounds on every axis, and the decode matrix the vertex
+	// shader gets does the same as DecodePosition
+	void TestPositions()
+	{
+		std::mt19937 random(1);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		const XMFLOAT3 boundsMin(-3.0f, 10.0f, -0.25f);
+		const XMFLOAT3 boundsMax(5.0f, 10.5f, 0.25f);
+		const float extent[3] = { 8.0f, 0.5f, 0.5f };
+		XMFLOAT4X4 decode = VertexCompression::PositionDecodeMatrix(boundsMin, boundsMax);
+		float worst[3] = { 0.0f, 0.0f, 0.0f };
+		float worstMatrix = 0.0f;
+		for (uint32_t i = 0; i < 100000; ++i)
+		{
+			XMFLOAT3 position(boundsMin.x + extent[0] * unit(random), boundsMin.y + extent[1] * unit(random), boundsMin.z + extent[2] * unit(random));
+			uint16_t encoded[4];
+			VertexCompression::EncodePosition(position, boundsMin, boundsMax, encoded);
+			CHECK(encoded[3] == 0xffff);
+			XMFLOAT3 decoded = VertexCompression::DecodePosition(encoded, boundsMin, boundsMax);
+			worst[0] = std::max(worst[0], std::abs(decoded.x - position.x) / extent[0]);
+			worst[1] = std::max(worst[1], std::abs(decoded.y - position.y) / extent[1]);
+			worst[2] = std::max(worst[2], std::abs(decoded.z - position.z) / extent[2]);
+
+			// what the input assembler hands the shader: unorm in xyz, and w = 1
+			XMVECTOR unorm = XMVectorSet(encoded[0] / 65535.0f, encoded[1] / 65535.0f, encoded[2] / 65535.0f, encoded[3] / 65535.0f);
+			XMFLOAT3 transformed;
+			XMStoreFloat3(&transformed, XMVector4Transform(unorm, XMLoadFloat4x4(&decode)));
+			worstMatrix = std::max(worstMatrix, std::max(std::abs(transformed.x - decoded.x), std::max(std::abs(transformed.y - decoded.y), std::abs(transformed.z - decoded.z))));
+		}
+		for (float error : worst)
+			CHECK(error <= 0.5f / 65535.0f + 1e-6f);
+		CHECK(worstMatrix < 1e-5f);
+
+		// the corners are exact, a flat axis is stored as 0 and anything outside is clamped to the bounds
+		uint16_t encoded[4];
+		VertexCompression::EncodePosition(boundsMax, boundsMin, boundsMax, encoded);
+		CHECK(encoded[0] == 0xffff && encoded[1] == 0xffff && encoded[2] == 0xffff);
+		VertexCompression::EncodePosition(boundsMin, boundsMin, boundsMax, encoded);
+		CHECK(encoded[0] == 0 && encoded[1] == 0 && encoded[2] == 0);
+		VertexCompression::EncodePosition(XMFLOAT3(1.0f, 2.0f, 3.0f), XMFLOAT3(0.0f, 2.0f, 0.0f), XMFLOAT3(2.0f, 2.0f, 2.0f), encoded);
+		CHECK(encoded[0] == 0x8000 && encoded[1] == 0 && encoded[2] == 0xffff);
+	}
+
+	// octahedral normals in two snorm16s stay within a few hundredths of a degree everywhere on the sphere, the axes
+	// and the folded lower half included
+	void TestNormals()
+	{
+		std::mt19937 random(2);
+		std::normal_distribution<float> gauss;
+		std::vector<XMFLOAT3> normals =
+		{
+			XMFLOAT3(1.0f, 0.0f, 0.0f), XMFLOAT3(-1.0f, 0.0f, 0.0f), XMFLOAT3(0.0f, 1.0f, 0.0f), XMFLOAT3(0.0f, -1.0f, 0.0f),
+			XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(0.0f, 0.0f, -1.0f), XMFLOAT3(0.0f, 3.0f, -4.0f)
+		};
+		for (uint32_t i = 0; i < 100000; ++i)
+			normals.push_back(XMFLOAT3(gauss(random), gauss(random), gauss(random)));
+
+		double worst = 0.0;
+		for (const XMFLOAT3& normal : normals)
+		{
+			int16_t encoded[2];
+			VertexCompression::EncodeNormal(normal, encoded);
+			XMFLOAT3 decoded = VertexCompression::DecodeNormal(encoded);
+			// the angle from the sine and the cosine in doubles, as acos alone loses it near 1
+			const double n[3] = { normal.x, normal.y, normal.z };
+			const double d[3] = { decoded.x, decoded.y, decoded.z };
+			double cross[3] = { d[1] * n[2] - d[2] * n[1], d[2] * n[0] - d[0] * n[2], d[0] * n[1] - d[1] * n[0] };
+			double sine = std::sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]);
+			worst = std::max(worst, std::atan2(sine, d[0] * n[0] + d[1] * n[1] + d[2] * n[2]));
+		}
+		printf("worst normal error %g degrees\n", worst * 180.0 / 3.14159265358979);
+		CHECK(worst < 0.02 * 3.14159265358979 / 180.0);
+
+		int16_t encoded[2];
+		VertexCompression::EncodeNormal(XMFLOAT3(0.0f, 0.0f, 0.0f), encoded);
+		XMFLOAT3 up = VertexCompression::DecodeNormal(encoded);
+		CHECK(up.x == 0.0f && up.y == 0.0f && up.z == 1.0f);
+	}
+
+	// every step of each format survives the round trip exactly, red is in the low bits, and out of range is clamped
+	void TestColors()
+	{
+		uint32_t wrong = 0;
+		for (uint32_t step = 0; step <= 255; ++step)
+		{
+			float value = step / 255.0f;
+			float inverse = (255 - step) / 255.0f;
+			XMFLOAT4 color = VertexCompression::UnpackRgba8(VertexCompression::PackRgba8(XMFLOAT4(value, inverse, value, 1.0f)));
+			wrong += color.x == value && color.y == inverse && color.z == value && color.w == 1.0f ? 0 : 1;
+		}
+		for (uint32_t step = 0; step <= 1023; ++step)
+		{
+			float value = step / 1023.0f;
+			float inverse = (1023 - step) / 1023.0f;
+			XMFLOAT4 color = VertexCompression::UnpackRgb10A2(VertexCompression::PackRgb10A2(XMFLOAT4(value, value, inverse, (step % 4) / 3.0f)));
+			wrong += color.x == value && color.y == value && color.z == inverse && color.w == (step % 4) / 3.0f ? 0 : 1;
+		}
+		CHECK(wrong == 0);
+		CHECK(VertexCompression::PackRgba8(XMFLOAT4(1.0f, 0.0f, 0.0f, 0.0f)) == 0x000000ff);
+		CHECK(VertexCompression::PackRgba8(XMFLOAT4(-1.0f, 2.0f, 0.0f, 1.0f)) == 0xff00ff00);
+		CHECK(VertexCompression::PackRgb10A2(XMFLOAT4(1.0f, 0.0f, 0.0f, 1.0f)) == 0xc00003ff);
+	}
+
+	// Compress is the per vertex encoders on the job system, giving the same bytes as one thread, and colours the
+	// vertices by their normals when the mesh has no colours
+	void TestCompress(JobSystem& _jobSystem)
+	{
+		std::mt19937 random(3);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		std::normal_distribution<float> gauss;
+		const uint32_t count = 20000;
+		std::vector<MeshVertex> vertices(count);
+		for (MeshVertex& vertex : vertices)
+		{
+			vertex.position = XMFLOAT3(unit(random), 2.0f * unit(random), -unit(random));
+			XMStoreFloat3(&vertex.normal, XMVector3Normalize(XMVectorSet(gauss(random), gauss(random), gauss(random), 0.0f)));
+			vertex.uv = XMFLOAT2(0.0f, 0.0f);
+			vertex.color = XMFLOAT4(unit(random), unit(random), unit(random), 1.0f);
+		}
+		const XMFLOAT3 boundsMin(0.0f, 0.0f, -1.0f);
+		const XMFLOAT3 boundsMax(1.0f, 2.0f, 0.0f);
+
+		std::vector<PackedVertex> single(count);
+		std::vector<PackedVertex> threaded(count);
+		VertexCompression::Compress(vertices.data(), count, true, boundsMin, boundsMax, single.data());
+		VertexCompression::Compress(vertices.data(), count, true, boundsMin, boundsMax, threaded.data(), &_jobSystem);
+		CHECK(memcmp(single.data(), threaded.data(), count * sizeof(PackedVertex)) == 0);
+
+		uint32_t wrong = 0;
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			PackedVertex expected;
+			VertexCompression::EncodePosition(vertices[i].position, boundsMin, boundsMax, expected.position);
+			VertexCompression::EncodeNormal(vertices[i].normal, expected.normal);
+			expected.color = VertexCompression::PackRgba8(vertices[i].color);
+			wrong += memcmp(&expected, &single[i], sizeof(PackedVertex)) == 0 ? 0 : 1;
+		}
+		CHECK(wrong == 0);
+
+		VertexCompression::Compress(vertices.data(), count, false, boundsMin, boundsMax, threaded.data(), &_jobSystem);
+		const XMFLOAT3& normal = vertices[0].normal;
+		CHECK(threaded[0].color == VertexCompression::PackRgba8(XMFLOAT4(normal.x * 0.5f + 0.5f, normal.y * 0.5f + 0.5f, normal.z * 0.5f + 0.5f, 1.0f)));
+
+		CHECK(VertexCompression::FitsIn16Bits(0x10000));
+		CHECK(!VertexCompression::FitsIn16Bits(0x10001));
+	}
+}
+
+int main()
+{
+	JobSystem jobSystem;
+	jobSystem.Init(3);
+
+	TestPositions();
+	TestNormals();
+	TestColors();
+	TestCompress(jobSystem);
+	return CHECK_RESULT();
+}
@@ -0,0 +1,264 @@
+#include "TextureFile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#include "BlockCompression.h"
+#include "ImageImporter.h"
+#include "JobSystem.h"
+#include "MeshFile.h"
+
+namespace
+{
+	using Clock = std::chrono::high_resolution_clock;
+
+	static_assert(sizeof(TextureFileHeader) == 64, "the header is written as it is, so it must not change size");
+	static_assert(sizeof(TextureFileMip) == 40, "the mip table is written as it is, so it must not change size");
+
+	double MillisecondsSince(Clock::time_point _start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - _start).count();
+	}
+
+	uint64_t Align(uint64_t _value, uint64_t _alignment)
+	{
+		return (_value + _alignment - 1) & ~(_alignment - 1);
+	}
+
+	uint64_t HeaderChecksum(const TextureFileHeader& _header, const TextureFileMip* _pMips)
+	{
+		std::vector<uint8_t> bytes(sizeof(TextureFileHeader) + _header.mipCount * sizeof(TextureFileMip));
+		memcpy(bytes.data(), &_header, sizeof(TextureFileHeader));
+		memcpy(bytes.data() + sizeof(TextureFileHeader), _pMips, _header.mipCount * sizeof(TextureFileMip));
+		memset(bytes.data() + offsetof(TextureFileHeader, checksum), 0, sizeof(uint64_t));
+		return MeshFile::Checksum(bytes.data(), bytes.size());
+	}
+
+	// bytes in a block of 4x4 texels, or in one texel for uncompressed formats. 0 for formats textures are never made in
+	uint32_t FormatBytes(uint32_t _format, bool& _compressed)
+	{
+		_compressed = true;
+		switch (_format)
+		{
+		case TextureFile::FORMAT_BC1:
+		case TextureFile::FORMAT_BC1_SRGB:
+			return 8;
+		case TextureFile::FORMAT_BC3:
+		case TextureFile::FORMAT_BC3_SRGB:
+		case TextureFile::FORMAT_BC5:
+		case TextureFile::FORMAT_BC7:
+		case TextureFile::FORMAT_BC7_SRGB:
+			return 16;
+		case TextureFile::FORMAT_RGBA8:
+		case TextureFile::FORMAT_RGBA8_SRGB:
+			_compressed = false;
+			return 4;
+		default:
+			return 0;
+		}
+	}
+
+	// the row pitch and row count a level of _width x _height has in _format
+	void MipLayout(uint32_t _format, uint32_t _width, uint32_t _height, uint32_t& _rowPitch, uint32_t& _rowCount)
+	{
+		bool compressed;
+		uint32_t bytes = FormatBytes(_format, compressed);
+		_rowPitch = compressed ? (_width + 3) / 4 * bytes : _width * bytes;
+		_rowCount = compressed ? (_height + 3) / 4 : _height;
+	}
+}
+
+bool TextureFile::Open(const std::string& _fileName, bool _verifyChecksums, JobSystem* _pJobSystem)
+{
+	Close();
+	if (!m_file.Open(_fileName))
+		return false;
+
+	const uint8_t* pData = m_file.Data();
+	uint64_t size = m_file.Size();
+	const TextureFileHeader* pHeader = reinterpret_cast<const TextureFileHeader*>(pData);
+	bool compressed;
+	if (size < sizeof(TextureFileHeader) || pHeader->magic != FILE_MAGIC || pHeader->version != FILE_VERSION || pHeader->fileSize != size ||
+		pHeader->mipCount == 0 || pHeader->mipCount > MAX_MIPS || pHeader->mipCount > (size - sizeof(TextureFileHeader)) / sizeof(TextureFileMip) ||
+		pHeader->width == 0 || pHeader->height == 0 || FormatBytes(pHeader->format, compressed) == 0)
+	{
+		Close();
+		return false;
+	}
+
+	const TextureFileMip* pMips = reinterpret_cast<const TextureFileMip*>(pData + sizeof(TextureFileHeader));
+	if (HeaderChecksum(*pHeader, pMips) != pHeader->checksum)
+	{
+		Close();
+		return false;
+	}
+
+	// every level has to be the size its place in the chain and the format make it, and lie inside the file
+	bool valid = true;
+	for (uint32_t level = 0; level < pHeader->mipCount && valid; ++level)
+	{
+		const TextureFileMip& mip = pMips[level];
+		uint32_t rowPitch;
+		uint32_t rowCount;
+		MipLayout(pHeader->format, mip.width, mip.height, rowPitch, rowCount);
+		valid = mip.width == std::max(pHeader->width >> level, 1u) && mip.height == std::max(pHeader->height >> level, 1u) &&
+			mip.rowPitch == rowPitch && mip.rowCount == rowCount && mip.size == static_cast<uint64_t>(rowPitch) * rowCount &&
+			mip.offset % MIP_ALIGNMENT == 0 && mip.offset <= size && mip.size <= size - mip.offset;
+	}
+	for (uint32_t level = 0; valid && _verifyChecksums && level < pHeader->mipCount; ++level)
+		valid = MeshFile::Checksum(pData + pMips[level].offset, pMips[level].size, _pJobSystem) == pMips[level].checksum;
+
+	if (!valid)
+	{
+		Close();
+		return false;
+	}
+	m_pHeader = pHeader;
+	m_pMips = pMips;
+	return true;
+}
+
+void TextureFile::Close()
+{
+	m_file.Close();
+	m_pHeader = nullptr;
+	m_pMips = nullptr;
+}
+
+bool TextureFile::Convert(const std::string& _source, const std::string& _destination, const TextureDesc& _desc,
+	JobSystem* _pJobSystem, TextureConvertStats* _pStats)
+{
+	// BC5 has no _SRGB format, it only holds linear data
+	TextureDesc desc = _desc;
+	desc.srgb = desc.srgb && desc.format != TEXTURE_FORMAT_BC5;
+	desc.maxMips = desc.maxMips > 0 && desc.maxMips < MAX_MIPS ? desc.maxMips : MAX_MIPS;
+
+	TextureConvertStats stats;
+	Clock::time_point start = Clock::now();
+	Image image;
+	if (!ImageImporter::Load(_source, image))
+		return false;
+	stats.decodeMs = MillisecondsSince(start);
+
+	start = Clock::now();
+	std::vector<TextureMip> mips(1);
+	TextureProcessing::ToLinear(image, desc, mips[0]);
+	image.pixels.clear();
+	image.pixels.shrink_to_fit();
+	if (desc.format != TEXTURE_FORMAT_RGBA8 && (mips[0].width % 4 != 0 || mips[0].height % 4 != 0))
+	{
+		TextureMip source;
+		std::swap(source, mips[0]);
+		TextureProcessing::Resample(source, (source.width + 3) & ~3u, (source.height + 3) & ~3u, desc, mips[0], _pJobSystem);
+	}
+	TextureProcessing::GenerateMips(mips, desc, _pJobSystem);
+	stats.mipMs = MillisecondsSince(start);
+
+	// the levels one after the other, each spread over the job system on its own
+	start = Clock::now();
+	uint32_t mipCount = static_cast<uint32_t>(mips.size());
+	std::vector<std::vector<uint8_t>> levels(mipCount);
+	std::vector<uint8_t> pixels;
+	for (uint32_t level = 0; level < mipCount; ++level)
+	{
+		if (desc.format == TEXTURE_FORMAT_RGBA8)
+			TextureProcessing::ToRgba8(mips[level], desc, levels[level], _pJobSystem);
+		else
+		{
+			TextureProcessing::ToRgba8(mips[level], desc, pixels, _pJobSystem);
+			BlockCompression::Compress(pixels.data(), mips[level].width, mips[level].height, desc.format, levels[level], _pJobSystem);
+		}
+		stats.texels += static_cast<uint64_t>(mips[level].width) * mips[level].height;
+	}
+	stats.encodeMs = MillisecondsSince(start);
+
+	start = Clock::now();
+	TextureFileHeader header = {};
+	header.magic = FILE_MAGIC;
+	header.version = FILE_VERSION;
+	header.format = DxgiFormat(desc);
+	header.width = mips[0].width;
+	header.height = mips[0].height;
+	header.mipCount = mipCount;
+	header.settingsHash = SettingsHash(_desc);
+	MeshFile::SourceStamp(_source, header.sourceSize, header.sourceTime);
+
+	TextureFileMip table[MAX_MIPS] = {};
+	uint64_t offset = Align(sizeof(TextureFileHeader) + mipCount * sizeof(TextureFileMip), MIP_ALIGNMENT);
+	for (uint32_t level = 0; level < mipCount; ++level)
+	{
+		TextureFileMip& mip = table[level];
+		mip.offset = offset;
+		mip.size = levels[level].size();
+		mip.width = mips[level].width;
+		mip.height = mips[level].height;
+		MipLayout(header.format, mip.width, mip.height, mip.rowPitch, mip.rowCount);
+		mip.checksum = MeshFile::Checksum(levels[level].data(), mip.size, _pJobSystem);
+		offset = Align(offset + mip.size, MIP_ALIGNMENT);
+	}
+	header.fileSize = table[mipCount - 1].offset + table[mipCount - 1].size;
+	header.checksum = HeaderChecksum(header, table);
+
+	std::ofstream file(_destination, std::ios::binary);
+	if (!file)
+		return false;
+
+	const char padding[MIP_ALIGNMENT] = {};
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(table), mipCount * sizeof(TextureFileMip));
+	uint64_t written = sizeof(header) + mipCount * sizeof(TextureFileMip);
+	for (uint32_t level = 0; level < mipCount; ++level)
+	{
+		file.write(padding, static_cast<std::streamsize>(table[level].offset - written));
+		file.write(reinterpret_cast<const char*>(levels[level].data()), static_cast<std::streamsize>(table[level].size));
+		written = table[level].offset + table[level].size;
+	}
+	file.close();
+	stats.writeMs = MillisecondsSince(start);
+
+	stats.width = header.width;
+	stats.height = header.height;
+	stats.mipCount = mipCount;
+	if (_pStats)
+		*_pStats = stats;
+	return static_cast<bool>(file);
+}
+
+bool TextureFile::IsUpToDate(const std::string& _source, const std::string& _destination, const TextureDesc& _desc)
+{
+	// only the header is read, the levels are not checked here
+	uint64_t sourceSize;
+	uint64_t sourceTime;
+	MeshFile::SourceStamp(_source, sourceSize, sourceTime);
+	TextureFileHeader header;
+	std::ifstream file(_destination, std::ios::binary);
+	if (sourceSize == 0 || !file || !file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+		return false;
+	return header.magic == FILE_MAGIC && header.version == FILE_VERSION && header.settingsHash == SettingsHash(_desc) &&
+		header.sourceSize == sourceSize && header.sourceTime == sourceTime;
+}
+
+uint32_t TextureFile::DxgiFormat(const TextureDesc& _desc)
+{
+	bool srgb = _desc.srgb && !_desc.normalMap;
+	switch (_desc.format)
+	{
+	case TEXTURE_FORMAT_BC1: return srgb ? FORMAT_BC1_SRGB : FORMAT_BC1;
+	case TEXTURE_FORMAT_BC3: return srgb ? FORMAT_BC3_SRGB : FORMAT_BC3;
+	case TEXTURE_FORMAT_BC5: return FORMAT_BC5;
+	case TEXTURE_FORMAT_BC7: return srgb ? FORMAT_BC7_SRGB : FORMAT_BC7;
+	default: return srgb ? FORMAT_RGBA8_SRGB : FORMAT_RGBA8;
+	}
+}
+
+uint64_t TextureFile::SettingsHash(const TextureDesc& _desc)
+{
+	// field by field, so padding inside TextureDesc never reaches the hash
+	uint32_t settings[6] = { PIPELINE_VERSION, static_cast<uint32_t>(_desc.format), _desc.srgb ? 1u : 0u, _desc.normalMap ? 1u : 0u,
+		_desc.wrap ? 1u : 0u, _desc.maxMips };
+	return MeshFile::Checksum(settings, sizeof(settings));
+}
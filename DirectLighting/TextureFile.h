@@ -0,0 +1,105 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+#include "MappedFile.h"
+#include "TextureProcessing.h"
+
+class JobSystem;
+
+struct TextureFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t fileSize;
+	uint32_t format; // a DXGI_FORMAT
+	uint32_t width;
+	uint32_t height;
+	uint32_t mipCount; // the mip table follows the header, largest level first
+	uint64_t settingsHash; // TextureFile::SettingsHash of the TextureDesc it was made with
+	uint64_t sourceSize; // of the image it was converted from, to tell when it is out of date
+	uint64_t sourceTime;
+	uint64_t checksum; // of the header, with this set to 0, and the mip table
+};
+
+struct TextureFileMip
+{
+	uint64_t offset; // bytes from the start of the file, a multiple of MIP_ALIGNMENT
+	uint64_t size; // rowPitch * rowCount
+	uint32_t width;
+	uint32_t height;
+	uint32_t rowPitch; // bytes from one row of blocks to the next, or one row of texels for uncompressed formats
+	uint32_t rowCount;
+	uint64_t checksum; // MeshFile::Checksum of the level's bytes
+};
+
+// what Convert did and how long each step took
+struct TextureConvertStats
+{
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint32_t mipCount = 0;
+	uint64_t texels = 0; // in every level
+	double decodeMs = 0.0;
+	double mipMs = 0.0;
+	double encodeMs = 0.0;
+	double writeMs = 0.0;
+};
+
+// the runtime texture container, laid out like MeshFile: a header, a table of mip levels and then the levels, each
+// already in the gpu's format and starting on a MIP_ALIGNMENT boundary, so a level is copied row by row from the
+// mapping into the upload heap and nothing else.
+//
+// Convert is the offline half: it decodes the source with ImageImporter, makes the mip chain with TextureProcessing
+// and compresses every level with BlockCompression, all on the job system. a file remembers the size and time of its
+// source and a hash of the settings it was made with, so IsUpToDate can tell a build to skip it
+class TextureFile
+{
+public:
+	static const uint32_t FILE_MAGIC = 0x52545854; // "TXTR"
+	static const uint32_t FILE_VERSION = 2; // 2: xxhash64 checksums
+	static const uint32_t PIPELINE_VERSION = 1; // bump when the filter or the encoders change what they make, so every texture is made again
+	static const uint32_t MIP_ALIGNMENT = 64;
+	static const uint32_t MAX_MIPS = 16;
+	static const uint32_t FORMAT_RGBA8 = 28; // DXGI_FORMAT_R8G8B8A8_UNORM
+	static const uint32_t FORMAT_RGBA8_SRGB = 29; // DXGI_FORMAT_R8G8B8A8_UNORM_SRGB
+	static const uint32_t FORMAT_BC1 = 71; // DXGI_FORMAT_BC1_UNORM
+	static const uint32_t FORMAT_BC1_SRGB = 72; // DXGI_FORMAT_BC1_UNORM_SRGB
+	static const uint32_t FORMAT_BC3 = 77; // DXGI_FORMAT_BC3_UNORM
+	static const uint32_t FORMAT_BC3_SRGB = 78; // DXGI_FORMAT_BC3_UNORM_SRGB
+	static const uint32_t FORMAT_BC5 = 83; // DXGI_FORMAT_BC5_UNORM
+	static const uint32_t FORMAT_BC7 = 98; // DXGI_FORMAT_BC7_UNORM
+	static const uint32_t FORMAT_BC7_SRGB = 99; // DXGI_FORMAT_BC7_UNORM_SRGB
+
+	TextureFile() = default;
+	~TextureFile() = default;
+
+	// false if the file is missing, truncated, from another version or fails a checksum
+	bool Open(const std::string& _fileName, bool _verifyChecksums = true, JobSystem* _pJobSystem = nullptr);
+	void Close();
+	bool IsOpen() { return m_pHeader != nullptr; }
+
+	const TextureFileHeader& Header() { return *m_pHeader; }
+	const TextureFileMip& Mip(uint32_t _level) { return m_pMips[_level]; }
+	const uint8_t* MipData(uint32_t _level) { return m_file.Data() + m_pMips[_level].offset; }
+
+	// imports _source (png or tga), makes its mips and writes them to _destination in _desc's format. levels are made
+	// from the full image in linear space and only then compressed. the first level of a block compressed texture is
+	// resampled up to a multiple of 4 texels first, as d3d12 needs
+	static bool Convert(const std::string& _source, const std::string& _destination, const TextureDesc& _desc,
+		JobSystem* _pJobSystem = nullptr, TextureConvertStats* _pStats = nullptr);
+
+	// true when _destination is this version and was made from _source as it is now with the same settings
+	static bool IsUpToDate(const std::string& _source, const std::string& _destination, const TextureDesc& _desc);
+
+	// the DXGI_FORMAT a texture made with _desc is stored in
+	static uint32_t DxgiFormat(const TextureDesc& _desc);
+
+	// changes whenever _desc or the way textures are made does
+	static uint64_t SettingsHash(const TextureDesc& _desc);
+
+private:
+	MappedFile m_file;
+	const TextureFileHeader* m_pHeader = nullptr;
+	const TextureFileMip* m_pMips = nullptr;
+};
@@ -0,0 +1,264 @@
+#include "TextureProcessing.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+#include "ImageImporter.h"
+#include "JobSystem.h"
+
+using namespace DirectX;
+
+namespace
+{
+	const uint32_t ROWS_PER_JOB = 16;
+	const float LANCZOS_LOBES = 3.0f;
+
+	void ForRange(JobSystem* _pJobSystem, uint32_t _count, uint32_t _grainSize, const std::function<void(unsigned int, unsigned int)>& _func)
+	{
+		if (_pJobSystem && _count > _grainSize)
+			_pJobSystem->ParallelFor(_count, _grainSize, _func);
+		else
+			_func(0, _count);
+	}
+
+	float Sinc(float _x)
+	{
+		float x = _x * XM_PI;
+		return std::sin(x) / x;
+	}
+
+	float Lanczos(float _x)
+	{
+		_x = std::fabs(_x);
+		if (_x < 1e-5f)
+			return 1.0f;
+		return _x < LANCZOS_LOBES ? Sinc(_x) * Sinc(_x / LANCZOS_LOBES) : 0.0f;
+	}
+
+	// the source texels and weights each output texel of one axis sums, all outputs' taps back to back
+	struct FilterTaps
+	{
+		std::vector<uint32_t> first; // per output, where its taps start. one more at the end
+		std::vector<uint32_t> source;
+		std::vector<float> weight;
+	};
+
+	void BuildTaps(uint32_t _sourceSize, uint32_t _size, bool _wrap, FilterTaps& _taps)
+	{
+		// texel centres line up: output texel i covers source texels scale * i to scale * (i + 1). shrinking widens the
+		// kernel by the same factor, so it stays a low pass filter at the new size
+		float scale = static_cast<float>(_sourceSize) / _size;
+		float width = std::max(scale, 1.0f);
+		float radius = LANCZOS_LOBES * width;
+		_taps.first.resize(_size + 1);
+		_taps.source.clear();
+		_taps.weight.clear();
+		for (uint32_t i = 0; i < _size; ++i)
+		{
+			_taps.first[i] = static_cast<uint32_t>(_taps.source.size());
+			float center = (i + 0.5f) * scale - 0.5f;
+			int begin = static_cast<int>(std::ceil(center - radius));
+			int end = static_cast<int>(std::floor(center + radius));
+			float sum = 0.0f;
+			for (int j = begin; j <= end; ++j)
+			{
+				float weight = Lanczos((j - center) / width);
+				if (weight == 0.0f)
+					continue;
+				int size = static_cast<int>(_sourceSize);
+				int source = _wrap ? ((j % size) + size) % size : std::min(std::max(j, 0), size - 1);
+				_taps.source.push_back(static_cast<uint32_t>(source));
+				_taps.weight.push_back(weight);
+				sum += weight;
+			}
+			for (size_t tap = _taps.first[i]; tap < _taps.weight.size(); ++tap)
+				_taps.weight[tap] /= sum;
+		}
+		_taps.first[_size] = static_cast<uint32_t>(_taps.source.size());
+	}
+
+	// lanczos overshoots around hard edges, so colours are clamped back into range and normals made unit length again
+	XMVECTOR Finish(FXMVECTOR _texel, bool _normalMap)
+	{
+		if (!_normalMap)
+			return XMVectorSaturate(_texel);
+
+		XMVECTOR length = XMVector3Length(_texel);
+		XMVECTOR normal = XMVectorGetX(length) > 1e-6f ? XMVectorDivide(_texel, length) : XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f);
+		return XMVectorSelect(XMVectorSaturate(_texel), normal, XMVectorSelectControl(1, 1, 1, 0));
+	}
+
+	const uint32_t SRGB_ENCODE_STEPS = 4096;
+
+	// srgb to linear for every byte, and the linear values of the points half way between neighbouring bytes for going
+	// back, where rounding the encoded value flips from one byte to the next. the way back starts from the byte for the bottom of one of 4096 even steps of linear and walks up the half way
+	// points, which is never more than a step or two
+	struct SrgbTables
+	{
+		float toLinear[256];
+		float midpoints[255];
+		uint8_t encodeStart[SRGB_ENCODE_STEPS];
+
+		SrgbTables()
+		{
+			for (uint32_t i = 0; i < 256; ++i)
+				toLinear[i] = Decode(i / 255.0f);
+			for (uint32_t i = 0; i < 255; ++i)
+				midpoints[i] = Decode((i + 0.5f) / 255.0f);
+			for (uint32_t i = 0; i < SRGB_ENCODE_STEPS; ++i)
+				encodeStart[i] = static_cast<uint8_t>(std::upper_bound(midpoints, midpoints + 255, static_cast<float>(i) / (SRGB_ENCODE_STEPS - 1)) - midpoints);
+		}
+
+		static float Decode(float _value)
+		{
+			return _value <= 0.04045f ? _value / 12.92f : std::pow((_value + 0.055f) / 1.055f, 2.4f);
+		}
+
+		// exactly the rounded srgb encode of _linear, where a curve fitted to it would be off by one here and there
+		uint8_t Encode(float _linear) const
+		{
+			_linear = std::min(std::max(_linear, 0.0f), 1.0f);
+			uint32_t value = encodeStart[static_cast<uint32_t>(_linear * (SRGB_ENCODE_STEPS - 1))];
+			while (value < 255 && _linear >= midpoints[value])
+				value++;
+			return static_cast<uint8_t>(value);
+		}
+	};
+
+	const SrgbTables& Srgb()
+	{
+		static const SrgbTables tables;
+		return tables;
+	}
+
+	uint8_t ToUnorm8(float _value)
+	{
+		return static_cast<uint8_t>(std::min(std::max(_value, 0.0f), 1.0f) * 255.0f + 0.5f);
+	}
+}
+
+uint32_t TextureProcessing::MipCount(uint32_t _width, uint32_t _height)
+{
+	uint32_t count = 1;
+	for (uint32_t size = std::max(_width, _height); size > 1; size /= 2)
+		count++;
+	return count;
+}
+
+void TextureProcessing::ToLinear(const Image& _image, const TextureDesc& _desc, TextureMip& _mip)
+{
+	const SrgbTables& srgb = Srgb();
+	size_t count = static_cast<size_t>(_image.width) * _image.height;
+	_mip.width = _image.width;
+	_mip.height = _image.height;
+	_mip.texels.resize(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		const uint8_t* p = &_image.pixels[i * 4];
+		XMFLOAT4& texel = _mip.texels[i];
+		if (_desc.normalMap)
+			texel = XMFLOAT4(p[0] / 127.5f - 1.0f, p[1] / 127.5f - 1.0f, p[2] / 127.5f - 1.0f, p[3] / 255.0f);
+		else if (_desc.srgb)
+			texel = XMFLOAT4(srgb.toLinear[p[0]], srgb.toLinear[p[1]], srgb.toLinear[p[2]], p[3] / 255.0f);
+		else
+			texel = XMFLOAT4(p[0] / 255.0f, p[1] / 255.0f, p[2] / 255.0f, p[3] / 255.0f);
+	}
+}
+
+void TextureProcessing::Resample(const TextureMip& _source, uint32_t _width, uint32_t _height, const TextureDesc& _desc,
+	TextureMip& _result, JobSystem* _pJobSystem)
+{
+	FilterTaps horizontal;
+	FilterTaps vertical;
+	BuildTaps(_source.width, _width, _desc.wrap, horizontal);
+	BuildTaps(_source.height, _height, _desc.wrap, vertical);
+
+	// rows first, into a buffer as wide as the result and as tall as the source, then columns
+	std::vector<XMFLOAT4> rows(static_cast<size_t>(_width) * _source.height);
+	ForRange(_pJobSystem, _source.height, ROWS_PER_JOB, [&](unsigned int _begin, unsigned int _end)
+	{
+		for (unsigned int y = _begin; y < _end; ++y)
+		{
+			const XMFLOAT4* pSource = &_source.texels[static_cast<size_t>(y) * _source.width];
+			XMFLOAT4* pOut = &rows[static_cast<size_t>(y) * _width];
+			for (uint32_t x = 0; x < _width; ++x)
+			{
+				XMVECTOR sum = XMVectorZero();
+				for (uint32_t tap = horizontal.first[x]; tap < horizontal.first[x + 1]; ++tap)
+					sum = XMVectorMultiplyAdd(XMLoadFloat4(&pSource[horizontal.source[tap]]), XMVectorReplicate(horizontal.weight[tap]), sum);
+				XMStoreFloat4(&pOut[x], sum);
+			}
+		}
+	});
+
+	_result.width = _width;
+	_result.height = _height;
+	_result.texels.assign(static_cast<size_t>(_width) * _height, XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f));
+	ForRange(_pJobSystem, _height, ROWS_PER_JOB, [&](unsigned int _begin, unsigned int _end)
+	{
+		for (unsigned int y = _begin; y < _end; ++y)
+		{
+			// a whole source row at a time, so both rows are read front to back
+			XMFLOAT4* pOut = &_result.texels[static_cast<size_t>(y) * _width];
+			for (uint32_t tap = vertical.first[y]; tap < vertical.first[y + 1]; ++tap)
+			{
+				const XMFLOAT4* pRow = &rows[static_cast<size_t>(vertical.source[tap]) * _width];
+				XMVECTOR weight = XMVectorReplicate(vertical.weight[tap]);
+				for (uint32_t x = 0; x < _width; ++x)
+					XMStoreFloat4(&pOut[x], XMVectorMultiplyAdd(XMLoadFloat4(&pRow[x]), weight, XMLoadFloat4(&pOut[x])));
+			}
+			for (uint32_t x = 0; x < _width; ++x)
+				XMStoreFloat4(&pOut[x], Finish(XMLoadFloat4(&pOut[x]), _desc.normalMap));
+		}
+	});
+}
+
+void TextureProcessing::GenerateMips(std::vector<TextureMip>& _mips, const TextureDesc& _desc, JobSystem* _pJobSystem)
+{
+	_mips.resize(1);
+	uint32_t count = MipCount(_mips[0].width, _mips[0].height);
+	if (_desc.maxMips > 0)
+		count = std::min(count, _desc.maxMips);
+
+	// each level needs the one before, so the parallelism is inside a level
+	_mips.resize(count);
+	for (uint32_t level = 1; level < count; ++level)
+	{
+		const TextureMip& above = _mips[level - 1];
+		Resample(above, std::max(above.width / 2, 1u), std::max(above.height / 2, 1u), _desc, _mips[level], _pJobSystem);
+	}
+}
+
+void TextureProcessing::ToRgba8(const TextureMip& _mip, const TextureDesc& _desc, std::vector<uint8_t>& _pixels, JobSystem* _pJobSystem)
+{
+	const SrgbTables& srgb = Srgb();
+	_pixels.resize(static_cast<size_t>(_mip.width) * _mip.height * 4);
+	ForRange(_pJobSystem, _mip.height, ROWS_PER_JOB, [&](unsigned int _begin, unsigned int _end)
+	{
+		for (size_t i = static_cast<size_t>(_begin) * _mip.width; i < static_cast<size_t>(_end) * _mip.width; ++i)
+		{
+			const XMFLOAT4& texel = _mip.texels[i];
+			uint8_t* p = &_pixels[i * 4];
+			if (_desc.normalMap)
+			{
+				p[0] = ToUnorm8(texel.x * 0.5f + 0.5f);
+				p[1] = ToUnorm8(texel.y * 0.5f + 0.5f);
+				p[2] = ToUnorm8(texel.z * 0.5f + 0.5f);
+			}
+			else if (_desc.srgb)
+			{
+				p[0] = srgb.Encode(texel.x);
+				p[1] = srgb.Encode(texel.y);
+				p[2] = srgb.Encode(texel.z);
+			}
+			else
+			{
+				p[0] = ToUnorm8(texel.x);
+				p[1] = ToUnorm8(texel.y);
+				p[2] = ToUnorm8(texel.z);
+			}
+			p[3] = ToUnorm8(texel.w);
+		}
+	});
+}
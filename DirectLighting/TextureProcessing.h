@@ -0,0 +1,64 @@
+#pragma once
+#include <DirectXMath.h>
+
+#include <cstdint>
+#include <vector>
+
+class JobSystem;
+struct Image;
+
+enum TextureFormat : uint32_t
+{
+	TEXTURE_FORMAT_RGBA8, // uncompressed
+	TEXTURE_FORMAT_BC1, // rgb at 4 bits a texel, with alpha either 0 or 255
+	TEXTURE_FORMAT_BC3, // rgba at 8 bits a texel, the alpha coded on its own like BC4
+	TEXTURE_FORMAT_BC5, // two channels at 8 bits a texel, for the x and y of normal maps
+	TEXTURE_FORMAT_BC7, // rgba at 8 bits a texel, closer to the source than BC1 and BC3
+};
+
+// how a source image is turned into a texture. everything in here goes into the hash that tells when a converted
+// texture is out of date
+struct TextureDesc
+{
+	TextureFormat format = TEXTURE_FORMAT_BC7;
+	bool srgb = true; // the colours are gamma encoded, so they are filtered in linear space and sampled as _SRGB
+	bool normalMap = false; // rgb is a unit vector in 0..1, renormalised after filtering. for BC5 z is left out
+	bool wrap = true; // the filter wraps around the edges, for tiling textures, instead of repeating the edge texels
+	uint32_t maxMips = 0; // at most this many levels, 0 for the whole chain down to 1x1
+};
+
+// one level of the chain in linear floats, rows top to bottom
+struct TextureMip
+{
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<DirectX::XMFLOAT4> texels;
+};
+
+// makes the mip chain of a texture.
+//
+// each level is resampled straight from the level above with a separable lanczos filter of three lobes, which keeps
+// the detail a box filter blurs away without ringing much. every level is half the size of the one before, rounded
+// down but at least 1, so odd sizes lose no texels: the filter is stretched over the source instead. srgb textures are
+// filtered as linear light and encoded again at the end, or dark and bright texels would average too dark.
+//
+// the filter weights are worked out once per level and axis, then the rows of a level are shared out on the job
+// system, one XMVECTOR per texel
+namespace TextureProcessing
+{
+	// levels in the whole chain of a _width x _height texture
+	uint32_t MipCount(uint32_t _width, uint32_t _height);
+
+	// _image in linear floats: srgb colours decoded, normal maps moved to -1..1
+	void ToLinear(const Image& _image, const TextureDesc& _desc, TextureMip& _mip);
+
+	// _source resized to _width x _height with the same filter, for a first level whose size does not suit the format
+	void Resample(const TextureMip& _source, uint32_t _width, uint32_t _height, const TextureDesc& _desc, TextureMip& _result,
+		JobSystem* _pJobSystem = nullptr);
+
+	// _mips[0] must hold the first level, the rest of the chain is added after it
+	void GenerateMips(std::vector<TextureMip>& _mips, const TextureDesc& _desc, JobSystem* _pJobSystem = nullptr);
+
+	// _mip back in rgba8, gamma encoded again for srgb textures
+	void ToRgba8(const TextureMip& _mip, const TextureDesc& _desc, std::vector<uint8_t>& _pixels, JobSystem* _pJobSystem = nullptr);
+}
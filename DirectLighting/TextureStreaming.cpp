@@ -0,0 +1,304 @@
+#include "TextureStreaming.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+#include "JobSystem.h"
+#include "MeshFile.h"
+
+TextureStreamer::~TextureStreamer()
+{
+	Shutdown();
+}
+
+void TextureStreamer::Init(const TextureStreamingDesc& _desc, JobSystem* _pJobSystem)
+{
+	Shutdown();
+	m_desc = _desc;
+	m_pJobSystem = _pJobSystem;
+	m_frame = 1; // so a texture's lastRequestFrame of 0 is never this frame
+	m_stats = TextureStreamingStats();
+}
+
+void TextureStreamer::Shutdown()
+{
+	for (std::unique_ptr<PendingRead>& pRead : m_reads)
+	{
+		while (!pRead->done.load(std::memory_order_acquire))
+			std::this_thread::yield();
+	}
+	m_reads.clear();
+	m_finishedReads.clear();
+	m_uploads.clear();
+	m_textures.clear();
+}
+
+uint32_t TextureStreamer::AddTexture(const std::string& _fileName)
+{
+	// the levels are checked as they are read, not all up front
+	std::unique_ptr<StreamedTexture> pTexture(new StreamedTexture());
+	if (!pTexture->file.Open(_fileName, false))
+		return INVALID_TEXTURE;
+
+	const TextureFileHeader& header = pTexture->file.Header();
+	pTexture->mipCount = header.mipCount;
+	pTexture->tailMip = header.mipCount - 1;
+	while (pTexture->tailMip > 0 && std::max(pTexture->file.Mip(pTexture->tailMip - 1).width, pTexture->file.Mip(pTexture->tailMip - 1).height) <= m_desc.tailSize)
+		pTexture->tailMip--;
+	pTexture->residentMip = pTexture->mipCount;
+	pTexture->wantedMip = pTexture->tailMip;
+
+	// tails are never dropped, so they go over the budget rather than wait for room
+	uint32_t texture = static_cast<uint32_t>(m_textures.size());
+	m_textures.push_back(std::move(pTexture));
+	MakeRoom(LevelBytes(m_textures[texture]->file, m_textures[texture]->tailMip), texture);
+	StartRead(texture, m_textures[texture]->tailMip, m_textures[texture]->mipCount);
+	return texture;
+}
+
+void TextureStreamer::Request(uint32_t _texture, float _pixelsAcross, float _repeat)
+{
+	if (_texture >= m_textures.size() || !(_pixelsAcross > 0.0f))
+		return;
+
+	// one texel to a pixel: a texture twice as wide as it is drawn wants the level below the first
+	StreamedTexture& texture = *m_textures[_texture];
+	const TextureFileHeader& header = texture.file.Header();
+	float mip = std::log2(std::max(header.width, header.height) * _repeat / _pixelsAcross) + m_desc.mipBias;
+	if (texture.lastRequestFrame != m_frame)
+	{
+		texture.lastRequestFrame = m_frame;
+		texture.requestedMip = mip;
+		texture.priority = _pixelsAcross;
+	}
+	else
+	{
+		texture.requestedMip = std::min(texture.requestedMip, mip);
+		texture.priority = std::max(texture.priority, _pixelsAcross);
+	}
+}
+
+void TextureStreamer::Update()
+{
+	m_stats.readsStarted = 0;
+	m_stats.levelsEvicted = 0;
+	m_stats.texturesRequested = 0;
+	m_stats.texturesBlurry = 0;
+	m_stats.missingLevels = 0;
+	FinishReads();
+
+	// a texture nobody asked for this frame wants only its tail, and its priority drops so others can take its levels
+	for (std::unique_ptr<StreamedTexture>& pTexture : m_textures)
+	{
+		StreamedTexture& texture = *pTexture;
+		if (texture.lastRequestFrame == m_frame)
+		{
+			float mip = std::floor(texture.requestedMip);
+			texture.wantedMip = mip <= 0.0f ? 0 : std::min(static_cast<uint32_t>(mip), texture.tailMip);
+			m_stats.texturesRequested++;
+			if (texture.residentMip > texture.wantedMip)
+			{
+				m_stats.texturesBlurry++;
+				m_stats.missingLevels += std::min(texture.residentMip, texture.mipCount) - texture.wantedMip;
+			}
+		}
+		else
+		{
+			texture.wantedMip = texture.tailMip;
+			texture.priority = 0.0f;
+		}
+	}
+
+	// the ones furthest from sharp enough that cover the most of the screen first. only textures whose tail is in can
+	// take a level, so a texture always has a run of levels from the tail up
+	m_order.clear();
+	for (uint32_t i = 0; i < m_textures.size(); ++i)
+	{
+		StreamedTexture& texture = *m_textures[i];
+		if (!texture.reading && !texture.failed && texture.residentMip <= texture.tailMip && texture.residentMip > texture.wantedMip)
+			m_order.push_back(i);
+	}
+	std::sort(m_order.begin(), m_order.end(), [this](uint32_t _a, uint32_t _b)
+	{
+		const StreamedTexture& a = *m_textures[_a];
+		const StreamedTexture& b = *m_textures[_b];
+		return a.priority * (a.residentMip - a.wantedMip) > b.priority * (b.residentMip - b.wantedMip);
+	});
+
+	for (uint32_t texture : m_order)
+	{
+		if (m_reads.size() >= m_desc.maxReadsInFlight)
+			break;
+
+		// one level bigger than the whole in flight allowance still goes when nothing else is being read
+		StreamedTexture& streamed = *m_textures[texture];
+		uint32_t level = streamed.residentMip - 1;
+		uint64_t size = streamed.file.Mip(level).size;
+		if (!m_reads.empty() && m_stats.bytesInFlight + size > m_desc.maxBytesInFlight)
+			continue;
+		if (MakeRoom(size, texture))
+		{
+			StartRead(texture, level, level + 1);
+			m_stats.readsStarted++;
+		}
+	}
+
+	m_stats.peakResidentBytes = std::max(m_stats.peakResidentBytes, m_stats.residentBytes);
+	m_frame++;
+}
+
+uint64_t TextureStreamer::LevelBytes(TextureFile& _file, uint32_t _first)
+{
+	uint64_t bytes = 0;
+	for (uint32_t level = _first; level < _file.Header().mipCount; ++level)
+		bytes += _file.Mip(level).size;
+	return bytes;
+}
+
+void TextureStreamer::StartRead(uint32_t _texture, uint32_t _firstLevel, uint32_t _endLevel)
+{
+	StreamedTexture& texture = *m_textures[_texture];
+	std::unique_ptr<PendingRead> pRead(new PendingRead());
+	pRead->texture = _texture;
+	pRead->firstLevel = _firstLevel;
+	pRead->endLevel = _endLevel;
+	pRead->size = 0;
+	for (uint32_t level = _firstLevel; level < _endLevel; ++level)
+		pRead->size += texture.file.Mip(level).size;
+	texture.reading = true;
+	m_stats.bytesInFlight += pRead->size;
+
+	// the levels back to back. the read and the texture both outlive the job, Shutdown waits for it
+	PendingRead* pPending = pRead.get();
+	TextureFile* pFile = &texture.file;
+	m_reads.push_back(std::move(pRead));
+	std::function<void()> job = [pPending, pFile]()
+	{
+		pPending->data.resize(static_cast<size_t>(pPending->size));
+		bool valid = true;
+		size_t offset = 0;
+		for (uint32_t level = pPending->firstLevel; level < pPending->endLevel; ++level)
+		{
+			const TextureFileMip& mip = pFile->Mip(level);
+			memcpy(pPending->data.data() + offset, pFile->MipData(level), static_cast<size_t>(mip.size));
+			valid = valid && MeshFile::Checksum(pPending->data.data() + offset, mip.size) == mip.checksum;
+			offset += static_cast<size_t>(mip.size);
+		}
+		pPending->valid = valid;
+		pPending->done.store(true, std::memory_order_release);
+	};
+	if (m_pJobSystem)
+		m_pJobSystem->Submit(job);
+	else
+		job();
+}
+
+void TextureStreamer::FinishReads()
+{
+	// the last frame's uploads have been copied by now
+	m_finishedReads.clear();
+	m_uploads.clear();
+
+	size_t kept = 0;
+	for (size_t i = 0; i < m_reads.size(); ++i)
+	{
+		if (!m_reads[i]->done.load(std::memory_order_acquire))
+		{
+			std::swap(m_reads[kept++], m_reads[i]);
+			continue;
+		}
+
+		PendingRead& read = *m_reads[i];
+		StreamedTexture& texture = *m_textures[read.texture];
+		texture.reading = false;
+		m_stats.bytesInFlight -= read.size;
+		m_stats.bytesRead += read.size;
+		if (!read.valid)
+		{
+			// the room it had is given back, and it keeps what it had
+			texture.failed = true;
+			continue;
+		}
+
+		texture.residentMip = read.firstLevel;
+		texture.uploadFrame = m_frame;
+		m_stats.residentBytes += read.size;
+		size_t offset = 0;
+		for (uint32_t level = read.firstLevel; level < read.endLevel; ++level)
+		{
+			const TextureFileMip& mip = texture.file.Mip(level);
+			TextureStreamUpload upload = { read.texture, level, read.data.data() + offset, mip.rowPitch, mip.rowCount };
+			m_uploads.push_back(upload);
+			offset += static_cast<size_t>(mip.size);
+		}
+		m_finishedReads.push_back(std::move(m_reads[i]));
+	}
+	m_reads.resize(kept);
+}
+
+bool TextureStreamer::MakeRoom(uint64_t _bytes, uint32_t _forTexture)
+{
+	// what is in flight already has its room
+	uint64_t used = m_stats.residentBytes + m_stats.bytesInFlight;
+	if (used + _bytes <= m_desc.budgetBytes)
+		return true;
+	uint64_t needed = used + _bytes - m_desc.budgetBytes;
+
+	// levels below what a texture wants can always go. a texture of lower priority can give up everything above its
+	// tail. nothing is taken from a texture being read, its resident level is about to change, nor from one whose
+	// levels are this frame's uploads, the memory under them is still being written. first check there is enough to
+	// free, so nothing is dropped for a read that would not fit anyway
+	float priority = m_textures[_forTexture]->priority;
+	uint64_t freeable = 0;
+	for (uint32_t i = 0; i < m_textures.size() && freeable < needed; ++i)
+	{
+		StreamedTexture& texture = *m_textures[i];
+		if (i == _forTexture || texture.reading || texture.uploadFrame == m_frame || texture.residentMip >= texture.tailMip)
+			continue;
+		uint32_t keep = texture.priority < priority ? texture.tailMip : std::max(texture.wantedMip, texture.residentMip);
+		for (uint32_t level = texture.residentMip; level < keep; ++level)
+			freeable += texture.file.Mip(level).size;
+	}
+	if (freeable < needed)
+		return false;
+
+	uint64_t freed = 0;
+	while (freed < needed)
+	{
+		// unwanted levels of whatever was asked for longest ago, then the lowest priority texture's sharpest level
+		uint32_t victim = INVALID_TEXTURE;
+		bool victimUnwanted = false;
+		for (uint32_t i = 0; i < m_textures.size(); ++i)
+		{
+			StreamedTexture& texture = *m_textures[i];
+			if (i == _forTexture || texture.reading || texture.uploadFrame == m_frame || texture.residentMip >= texture.tailMip)
+				continue;
+			bool unwanted = texture.residentMip < texture.wantedMip;
+			if (!unwanted && texture.priority >= priority)
+				continue;
+			if (victim == INVALID_TEXTURE || (unwanted && !victimUnwanted))
+			{
+				victim = i;
+				victimUnwanted = unwanted;
+				continue;
+			}
+			const StreamedTexture& best = *m_textures[victim];
+			if (unwanted == victimUnwanted && (unwanted ? texture.lastRequestFrame < best.lastRequestFrame : texture.priority < best.priority))
+				victim = i;
+		}
+		freed += m_textures[victim]->file.Mip(m_textures[victim]->residentMip).size;
+		Evict(victim);
+	}
+	return true;
+}
+
+void TextureStreamer::Evict(uint32_t _texture)
+{
+	// the renderer stops sampling it by clamping to ResidentMip, the memory under it can be reused straight away
+	StreamedTexture& texture = *m_textures[_texture];
+	m_stats.residentBytes -= texture.file.Mip(texture.residentMip).size;
+	texture.residentMip++;
+	m_stats.levelsEvicted++;
+}
@@ -0,0 +1,133 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "TextureFile.h"
+
+class JobSystem;
+
+struct TextureStreamingDesc
+{
+	uint64_t budgetBytes = 256ull << 20; // what every streamed texture together may keep resident, tails included
+	uint32_t tailSize = 64; // levels no larger than this along either side are loaded with the texture and never dropped
+	uint32_t maxReadsInFlight = 16;
+	uint64_t maxBytesInFlight = 32ull << 20;
+	float mipBias = 0.0f; // added to every wanted mip, above 0 for blurrier and cheaper
+};
+
+// a level that has just been read, for the renderer to copy into the texture's resource before the next Update
+struct TextureStreamUpload
+{
+	uint32_t texture;
+	uint32_t level;
+	const uint8_t* pData;
+	uint32_t rowPitch;
+	uint32_t rowCount;
+};
+
+// where the streamer stands after an Update
+struct TextureStreamingStats
+{
+	uint64_t residentBytes = 0;
+	uint64_t peakResidentBytes = 0; // since Init
+	uint64_t bytesInFlight = 0;
+	uint64_t bytesRead = 0; // since Init
+	uint32_t readsStarted = 0; // by the last Update
+	uint32_t levelsEvicted = 0; // by the last Update
+	uint32_t texturesRequested = 0; // last frame
+	uint32_t texturesBlurry = 0; // of those, how many are still coarser than they want
+	uint32_t missingLevels = 0; // and by how many levels in all
+};
+
+// keeps the mips of many textures resident within a fixed memory budget.
+//
+// while culling, the renderer calls Request for every visible object with how many pixels across it covers. that
+// and the texture's size give the level the object wants, one texel to a pixel, and the coverage is also its
+// priority. Update then, once a frame:
+// - takes in the reads that have finished, each making one more level resident, and hands them out as uploads
+// - starts reads for the textures furthest from the level they want, biggest on screen first, one level at a time
+//   from coarse to fine so the resident levels are always one unbroken run down to the tail
+// - makes room when a read would go over the budget: first by dropping levels nobody wants any more, longest
+//   unrequested first, then levels of textures with a lower priority than the one being read
+//
+// every texture's mip tail is read as soon as it is added and stays, so there is always something to sample. reads
+// copy the level out of the mapped TextureFile on the job system, so the page faults land on a worker, and check it
+// against its checksum there. none of this touches d3d, so it runs the same headless as it does in the renderer
+class TextureStreamer
+{
+public:
+	static const uint32_t INVALID_TEXTURE = 0xffffffff;
+
+	TextureStreamer() = default;
+	~TextureStreamer();
+
+	void Init(const TextureStreamingDesc& _desc, JobSystem* _pJobSystem = nullptr);
+	void Shutdown(); // waits for reads still in flight
+
+	// maps a texture made by TextureFile::Convert and starts reading its tail. INVALID_TEXTURE if it does not open
+	uint32_t AddTexture(const std::string& _fileName);
+
+	// _texture is drawn this frame, _pixelsAcross pixels wide on screen. _repeat is how many times the texture
+	// spans that width, above 1 for tiling. requests for the same texture in a frame keep the sharpest
+	void Request(uint32_t _texture, float _pixelsAcross, float _repeat = 1.0f);
+
+	// ends the frame's requests, see the class comment. what it leaves resident holds until the next Update
+	void Update();
+
+	uint32_t TextureCount() { return static_cast<uint32_t>(m_textures.size()); }
+	TextureFile& File(uint32_t _texture) { return m_textures[_texture]->file; }
+	uint32_t ResidentMip(uint32_t _texture) { return m_textures[_texture]->residentMip; } // the sharpest, the mip count while nothing is
+	uint32_t WantedMip(uint32_t _texture) { return m_textures[_texture]->wantedMip; }
+
+	const std::vector<TextureStreamUpload>& Uploads() { return m_uploads; } // from the last Update
+	const TextureStreamingStats& Stats() { return m_stats; }
+
+	// bytes levels _first to the end of the chain take
+	static uint64_t LevelBytes(TextureFile& _file, uint32_t _first);
+
+private:
+	struct StreamedTexture
+	{
+		TextureFile file;
+		uint32_t mipCount = 0;
+		uint32_t tailMip = 0; // the first level of the tail
+		uint32_t residentMip = 0;
+		uint32_t wantedMip = 0;
+		float requestedMip = 0.0f; // this frame's, while requested is set
+		float priority = 0.0f;
+		uint64_t lastRequestFrame = 0;
+		uint64_t uploadFrame = 0; // levels that came in then are being uploaded, they cannot be dropped that frame
+		bool requested = false;
+		bool reading = false;
+		bool failed = false; // a read failed its checksum, it is left at what it has
+	};
+
+	struct PendingRead
+	{
+		uint32_t texture;
+		uint32_t firstLevel; // the levels from this one up to endLevel, back to back in data
+		uint32_t endLevel;
+		uint64_t size;
+		std::vector<uint8_t> data;
+		bool valid = false;
+		std::atomic<bool> done{ false }; // set by the job once data and valid are written
+	};
+
+	void StartRead(uint32_t _texture, uint32_t _firstLevel, uint32_t _endLevel);
+	void FinishReads();
+	bool MakeRoom(uint64_t _bytes, uint32_t _forTexture);
+	void Evict(uint32_t _texture);
+
+	TextureStreamingDesc m_desc;
+	JobSystem* m_pJobSystem = nullptr;
+	std::vector<std::unique_ptr<StreamedTexture>> m_textures;
+	std::vector<std::unique_ptr<PendingRead>> m_reads;
+	std::vector<std::unique_ptr<PendingRead>> m_finishedReads; // what the uploads point into, kept until the next Update
+	std::vector<TextureStreamUpload> m_uploads;
+	std::vector<uint32_t> m_order; // scratch for sorting textures
+	uint64_t m_frame = 0;
+	TextureStreamingStats m_stats;
+};
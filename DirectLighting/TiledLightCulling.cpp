@@ -0,0 +1,195 @@
+#include "TiledLightCulling.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "JobSystem.h"
+
+using namespace DirectX;
+
+namespace
+{
+	const uint32_t MIN_LIGHTS_PER_BLOCK = 1024;
+
+	// depth values are never negative, so their bits compare the same way the floats do. the shader
+	// finds the tile bounds with InterlockedMin/Max on the bits, and this does exactly the same
+	uint32_t FloatBits(float _value)
+	{
+		uint32_t bits;
+		memcpy(&bits, &_value, sizeof(bits));
+		return bits;
+	}
+
+	float BitsFloat(uint32_t _bits)
+	{
+		float value;
+		memcpy(&value, &_bits, sizeof(value));
+		return value;
+	}
+
+	// a plane through the eye containing the line where an edge at _ndc sits: the normal is (1, -ndc / scale)
+	// along the edge's axis and z. this is the only place a square root is used
+	XMFLOAT2 EdgePlane(float _ndc, float _offset, float _scale)
+	{
+		float slope = (_ndc - _offset) / _scale;
+		float length = std::sqrt(1.0f + slope * slope);
+		return XMFLOAT2(1.0f / length, -slope / length);
+	}
+}
+
+void TiledLightCulling::Init(uint32_t _screenWidth, uint32_t _screenHeight, const XMFLOAT4X4& _proj)
+{
+	m_constants = TiledCullingConstants();
+	m_constants.tilesX = (_screenWidth + TILED_CULLING_TILE_SIZE - 1) / TILED_CULLING_TILE_SIZE;
+	m_constants.tilesY = (_screenHeight + TILED_CULLING_TILE_SIZE - 1) / TILED_CULLING_TILE_SIZE;
+	m_constants.screenWidth = _screenWidth;
+	m_constants.screenHeight = _screenHeight;
+
+	// a left handed perspective projection gives depth = _33 + _43 / viewZ
+	m_depthScale = _proj._33;
+	m_depthBias = _proj._43;
+	m_nearZ = -_proj._43 / _proj._33;
+	m_farZ = m_nearZ * _proj._33 / (_proj._33 - 1.0f);
+
+	m_edgesX.resize(m_constants.tilesX + 1);
+	for (uint32_t x = 0; x <= m_constants.tilesX; ++x)
+	{
+		float ndc = std::min(-1.0f + 2.0f * (x * TILED_CULLING_TILE_SIZE) / _screenWidth, 1.0f);
+		m_edgesX[x] = EdgePlane(ndc, _proj._31, _proj._11);
+	}
+	m_edgesY.resize(m_constants.tilesY + 1);
+	for (uint32_t y = 0; y <= m_constants.tilesY; ++y)
+	{
+		float ndc = std::max(1.0f - 2.0f * (y * TILED_CULLING_TILE_SIZE) / _screenHeight, -1.0f);
+		m_edgesY[y] = EdgePlane(ndc, _proj._32, _proj._22);
+	}
+
+	m_tileDepthBounds.assign(static_cast<size_t>(m_constants.tilesX) * m_constants.tilesY, XMFLOAT2(0.0f, 1.0f));
+}
+
+void TiledLightCulling::PrepareLights(const Light* _lights, uint32_t _count, const XMFLOAT4X4& _view, JobSystem* _pJobSystem)
+{
+	m_constants.lightCount = _count;
+	m_constants.wordsPerTile = (_count + 31) / 32;
+	m_lights.resize(_count);
+
+	XMMATRIX view = XMLoadFloat4x4(&_view);
+	auto prepare = [&](unsigned int _begin, unsigned int _end)
+	{
+		for (unsigned int i = _begin; i < _end; ++i)
+		{
+			XMFLOAT4 sphere = LightBoundingSphere(_lights[i]);
+			XMVECTOR center = XMVector3TransformCoord(XMVectorSet(sphere.x, sphere.y, sphere.z, 1.0f), view);
+
+			TiledLight& light = m_lights[i];
+			light.x = XMVectorGetX(center);
+			light.y = XMVectorGetY(center);
+			light.z = XMVectorGetZ(center);
+			light.radius = sphere.w;
+			light.pad[0] = 0.0f;
+			light.pad[1] = 0.0f;
+
+			// depth grows with view z, so the sphere's nearest and farthest points give its depth range
+			float nearest = light.z - light.radius;
+			float farthest = light.z + light.radius;
+			if (farthest <= m_nearZ)
+			{
+				light.minDepth = 2.0f;
+				light.maxDepth = -1.0f;
+				continue;
+			}
+			light.minDepth = nearest <= m_nearZ ? 0.0f : m_depthScale + m_depthBias / nearest;
+			light.maxDepth = farthest >= m_farZ ? 1.0f : m_depthScale + m_depthBias / farthest;
+		}
+	};
+	if (_pJobSystem && _count >= 2 * MIN_LIGHTS_PER_BLOCK)
+		_pJobSystem->ParallelFor(_count, MIN_LIGHTS_PER_BLOCK, prepare);
+	else
+		prepare(0, _count);
+}
+
+void TiledLightCulling::ComputeDepthBounds(const float* _depth, uint32_t _rowPitch, JobSystem* _pJobSystem)
+{
+	auto rows = [&](unsigned int _begin, unsigned int _end)
+	{
+		for (unsigned int tileY = _begin; tileY < _end; ++tileY)
+		{
+			uint32_t firstY = tileY * TILED_CULLING_TILE_SIZE;
+			uint32_t lastY = std::min(firstY + TILED_CULLING_TILE_SIZE, m_constants.screenHeight);
+			for (uint32_t tileX = 0; tileX < m_constants.tilesX; ++tileX)
+			{
+				uint32_t firstX = tileX * TILED_CULLING_TILE_SIZE;
+				uint32_t lastX = std::min(firstX + TILED_CULLING_TILE_SIZE, m_constants.screenWidth);
+
+				uint32_t minBits = 0x7f800000; // infinity, which the shader starts from as well
+				uint32_t maxBits = 0;
+				for (uint32_t y = firstY; y < lastY; ++y)
+				{
+					const float* pRow = _depth + static_cast<size_t>(y) * _rowPitch;
+					for (uint32_t x = firstX; x < lastX; ++x)
+					{
+						uint32_t bits = FloatBits(pRow[x]);
+						minBits = std::min(minBits, bits);
+						maxBits = std::max(maxBits, bits);
+					}
+				}
+				m_tileDepthBounds[tileY * m_constants.tilesX + tileX] = XMFLOAT2(BitsFloat(minBits), BitsFloat(maxBits));
+			}
+		}
+	};
+	if (_pJobSystem)
+		_pJobSystem->ParallelFor(m_constants.tilesY, 1, rows);
+	else
+		rows(0, m_constants.tilesY);
+}
+
+void TiledLightCulling::Cull(JobSystem* _pJobSystem)
+{
+	uint32_t wordsPerTile = m_constants.wordsPerTile;
+	m_tileMasks.assign(static_cast<size_t>(m_constants.tilesX) * m_constants.tilesY * wordsPerTile, 0);
+
+	auto rows = [&](unsigned int _begin, unsigned int _end)
+	{
+		// the row's top and bottom planes are the same for every tile in it, so test them once per light
+		std::vector<uint8_t> inRow(m_lights.size());
+		for (unsigned int tileY = _begin; tileY < _end; ++tileY)
+		{
+			const XMFLOAT2& top = m_edgesY[tileY];
+			const XMFLOAT2& bottom = m_edgesY[tileY + 1];
+			for (size_t i = 0; i < m_lights.size(); ++i)
+			{
+				const TiledLight& light = m_lights[i];
+				float topDistance = top.x * light.y + top.y * light.z;
+				float bottomDistance = bottom.x * light.y + bottom.y * light.z;
+				inRow[i] = topDistance <= light.radius && bottomDistance >= -light.radius;
+			}
+
+			for (uint32_t tileX = 0; tileX < m_constants.tilesX; ++tileX)
+			{
+				uint32_t tile = tileY * m_constants.tilesX + tileX;
+				const XMFLOAT2& left = m_edgesX[tileX];
+				const XMFLOAT2& right = m_edgesX[tileX + 1];
+				const XMFLOAT2& depthBounds = m_tileDepthBounds[tile];
+				uint32_t* pMask = &m_tileMasks[static_cast<size_t>(tile) * wordsPerTile];
+
+				for (size_t i = 0; i < m_lights.size(); ++i)
+				{
+					if (!inRow[i])
+						continue;
+					const TiledLight& light = m_lights[i];
+					float leftDistance = left.x * light.x + left.y * light.z;
+					float rightDistance = right.x * light.x + right.y * light.z;
+					bool inside = leftDistance >= -light.radius && rightDistance <= light.radius &&
+						light.minDepth <= depthBounds.y && light.maxDepth >= depthBounds.x;
+					if (inside)
+						pMask[i / 32] |= 1u << (i % 32);
+				}
+			}
+		}
+	};
+	if (_pJobSystem)
+		_pJobSystem->ParallelFor(m_constants.tilesY, 1, rows);
+	else
+		rows(0, m_constants.tilesY);
+}
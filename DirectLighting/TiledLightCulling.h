@@ -0,0 +1,93 @@
+#pragma once
+#include <DirectXMath.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "LightClusters.h"
+
+class JobSystem;
+
+// has to match TILE_SIZE in TiledLightCulling.hlsl, one thread group per tile
+const uint32_t TILED_CULLING_TILE_SIZE = 16;
+
+// a light as the culling sees it. built on the cpu once a frame and used as is by the compute shader and by
+// TiledLightCulling::Cull, so both work from exactly the same numbers. matches TiledLight in the shader
+struct TiledLight
+{
+	float x; // view space bounding sphere
+	float y;
+	float z;
+	float radius;
+	float minDepth; // the sphere's depth range in depth buffer values, an empty range if it is behind the camera
+	float maxDepth;
+	float pad[2];
+};
+
+// matches CullingConstants in the shader, it goes in as root constants
+struct TiledCullingConstants
+{
+	uint32_t tilesX;
+	uint32_t tilesY;
+	uint32_t lightCount;
+	uint32_t wordsPerTile;
+	uint32_t screenWidth;
+	uint32_t screenHeight;
+	uint32_t pad[2];
+};
+
+// 2d tiled light culling. every screen tile gets the min and max of the depth buffer under it, and a light is kept
+// for the tile when its sphere is inside the four planes through the tile's edges and its depth range overlaps the
+// tile's. the result is a bitmask per tile, bit i of the tile's words is set when light i touches it.
+//
+// this is the cpu reference for TiledLightCulling.hlsl and produces the same bits. the tests are only multiplies, adds
+// and compares in the same order as the shader, which marks them precise, and anything that needs a division or a
+// square root (the edge planes and the lights' depth ranges) is done here once and handed to both. keep it that way
+// and do not build this file with fused multiply add contraction (/fp:fast, -ffp-contract=fast)
+class TiledLightCulling
+{
+public:
+	TiledLightCulling() = default;
+	~TiledLightCulling() = default;
+
+	// works out the tile edge planes. call again when the projection or the screen size changes
+	void Init(uint32_t _screenWidth, uint32_t _screenHeight, const DirectX::XMFLOAT4X4& _proj);
+
+	// moves the lights' bounding spheres into view space and works out their depth ranges
+	void PrepareLights(const Light* _lights, uint32_t _count, const DirectX::XMFLOAT4X4& _view, JobSystem* _pJobSystem = nullptr);
+
+	// min and max of every tile. _depth is a d3d depth buffer (0 near, 1 far), _rowPitch is in floats
+	void ComputeDepthBounds(const float* _depth, uint32_t _rowPitch, JobSystem* _pJobSystem = nullptr);
+
+	// fills the tile masks from the prepared lights and the depth bounds
+	void Cull(JobSystem* _pJobSystem = nullptr);
+
+	uint32_t TilesX() { return m_constants.tilesX; }
+	uint32_t TilesY() { return m_constants.tilesY; }
+	uint32_t WordsPerTile() { return m_constants.wordsPerTile; }
+	const TiledCullingConstants& Constants() { return m_constants; }
+
+	const std::vector<TiledLight>& Lights() { return m_lights; }
+	const std::vector<DirectX::XMFLOAT2>& EdgesX() { return m_edgesX; }
+	const std::vector<DirectX::XMFLOAT2>& EdgesY() { return m_edgesY; }
+	const std::vector<DirectX::XMFLOAT2>& TileDepthBounds() { return m_tileDepthBounds; }
+	const std::vector<uint32_t>& TileMasks() { return m_tileMasks; }
+
+	bool TileHasLight(uint32_t _tile, uint32_t _light) { return (m_tileMasks[_tile * m_constants.wordsPerTile + _light / 32] >> (_light % 32)) & 1; }
+
+private:
+	TiledCullingConstants m_constants = {};
+	float m_nearZ = 0.0f;
+	float m_farZ = 0.0f;
+	float m_depthScale = 0.0f; // depth = m_depthScale + m_depthBias / viewZ
+	float m_depthBias = 0.0f;
+
+	// planes through the eye and each tile edge, stored as (normal along the edge's axis, normal along z).
+	// x edges go left to right and y edges top to bottom, so tile (x, y) sits between edges x, x + 1 and y, y + 1
+	std::vector<DirectX::XMFLOAT2> m_edgesX;
+	std::vector<DirectX::XMFLOAT2> m_edgesY;
+
+	std::vector<TiledLight> m_lights;
+	std::vector<DirectX::XMFLOAT2> m_tileDepthBounds; // (min, max) per tile
+	std::vector<uint32_t> m_tileMasks; // wordsPerTile words per tile
+};
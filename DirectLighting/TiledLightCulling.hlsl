@@ -0,0 +1,87 @@
+// 2d tiled light culling, one thread group per 16x16 pixel tile. TiledLightCulling.cpp does the same thing on the cpu
+// and has to give the same bits, so the tests below are marked precise and done in the same order as there
+
+#define TILE_SIZE 16 // TILED_CULLING_TILE_SIZE
+#define THREADS_PER_TILE (TILE_SIZE * TILE_SIZE)
+
+// TiledCullingConstants
+cbuffer CullingConstants : register(b0)
+{
+	uint tilesX;
+	uint tilesY;
+	uint lightCount;
+	uint wordsPerTile;
+	uint screenWidth;
+	uint screenHeight;
+};
+
+struct TiledLight
+{
+	float3 center; // view space
+	float radius;
+	float minDepth;
+	float maxDepth;
+	float2 pad;
+};
+
+Texture2D<float> depthBuffer : register(t0);
+StructuredBuffer<TiledLight> lights : register(t1);
+StructuredBuffer<float2> edgesX : register(t2); // planes through the eye and the tile edges, see TiledLightCulling.h
+StructuredBuffer<float2> edgesY : register(t3);
+RWStructuredBuffer<uint> tileMasks : register(u0); // wordsPerTile words per tile, bit i set when light i touches the tile
+
+groupshared uint tileMinDepth;
+groupshared uint tileMaxDepth;
+
+[numthreads(TILE_SIZE, TILE_SIZE, 1)]
+void main(uint3 groupId : SV_GroupID, uint3 threadId : SV_GroupThreadID, uint groupIndex : SV_GroupIndex)
+{
+	if (groupIndex == 0)
+	{
+		tileMinDepth = 0x7f800000; // infinity
+		tileMaxDepth = 0;
+	}
+	GroupMemoryBarrierWithGroupSync();
+
+	// depth is never negative, so comparing the bits as uints orders them the same as the floats
+	uint2 pixel = groupId.xy * TILE_SIZE + threadId.xy;
+	if (pixel.x < screenWidth && pixel.y < screenHeight)
+	{
+		uint depthBits = asuint(depthBuffer[pixel]);
+		InterlockedMin(tileMinDepth, depthBits);
+		InterlockedMax(tileMaxDepth, depthBits);
+	}
+	GroupMemoryBarrierWithGroupSync();
+
+	float minDepth = asfloat(tileMinDepth);
+	float maxDepth = asfloat(tileMaxDepth);
+	float2 left = edgesX[groupId.x];
+	float2 right = edgesX[groupId.x + 1];
+	float2 top = edgesY[groupId.y];
+	float2 bottom = edgesY[groupId.y + 1];
+	uint tile = groupId.y * tilesX + groupId.x;
+
+	// each thread builds whole words, so no atomics are needed on the output
+	for (uint word = groupIndex; word < wordsPerTile; word += THREADS_PER_TILE)
+	{
+		uint bits = 0;
+		for (uint bit = 0; bit < 32; ++bit)
+		{
+			uint index = word * 32 + bit;
+			if (index >= lightCount)
+				break;
+
+			TiledLight light = lights[index];
+			precise float topDistance = top.x * light.center.y + top.y * light.center.z;
+			precise float bottomDistance = bottom.x * light.center.y + bottom.y * light.center.z;
+			precise float leftDistance = left.x * light.center.x + left.y * light.center.z;
+			precise float rightDistance = right.x * light.center.x + right.y * light.center.z;
+			bool inside = topDistance <= light.radius && bottomDistance >= -light.radius &&
+				leftDistance >= -light.radius && rightDistance <= light.radius &&
+				light.minDepth <= maxDepth && light.maxDepth >= minDepth;
+			if (inside)
+				bits |= 1u << bit;
+		}
+		tileMasks[tile * wordsPerTile + word] = bits;
+	}
+}
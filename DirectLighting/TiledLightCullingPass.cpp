@@ -0,0 +1,183 @@
+#include "TiledLightCullingPass.h"
+
+#include <cstring>
+
+#include "D3dx12.h"
+#include "ShaderHotReload.h"
+
+namespace
+{
+	// root srvs only need 4 byte alignment, but keeping each array on its own 256 bytes costs nothing
+	UINT64 AlignOffset(UINT64 _offset)
+	{
+		return (_offset + 255) & ~static_cast<UINT64>(255);
+	}
+}
+
+bool TiledLightCullingPass::Init(ID3D12Device* _pDevice, RootSignatureCache& _rootSignatureCache, UINT _maxLights, UINT _screenWidth, UINT _screenHeight, UINT _frameCount)
+{
+	m_pDevice = _pDevice;
+	m_maxLights = _maxLights;
+	if (_frameCount > MAX_FRAMES)
+	{
+		return false;
+	}
+
+	RootSignatureDesc rootSignatureDesc;
+	m_rootConstants = rootSignatureDesc.AddConstants(0, sizeof(TiledCullingConstants) / sizeof(UINT));
+	m_rootDepthTable = rootSignatureDesc.AddDescriptorTable();
+	rootSignatureDesc.AddDescriptorRange(m_rootDepthTable, D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0);
+	m_rootLights = rootSignatureDesc.AddSRV(1);
+	m_rootEdgesX = rootSignatureDesc.AddSRV(2);
+	m_rootEdgesY = rootSignatureDesc.AddSRV(3);
+	m_rootTileMasks = rootSignatureDesc.AddUAV(0);
+	m_pRootSignature = _rootSignatureCache.GetOrCreate(_pDevice, rootSignatureDesc);
+	if (m_pRootSignature == nullptr)
+	{
+		return false;
+	}
+
+	ID3DBlob* pComputeShader = nullptr;
+	if (!ShaderHotReload::CompileShader("TiledLightCulling.hlsl", "cs_5_0", &pComputeShader))
+	{
+		return false;
+	}
+	D3D12_COMPUTE_PIPELINE_STATE_DESC psoDesc = {};
+	psoDesc.pRootSignature = m_pRootSignature;
+	psoDesc.CS.pShaderBytecode = pComputeShader->GetBufferPointer();
+	psoDesc.CS.BytecodeLength = pComputeShader->GetBufferSize();
+	HRESULT hr = _pDevice->CreateComputePipelineState(&psoDesc, IID_PPV_ARGS(&m_pPipelineState));
+	pComputeShader->Release();
+	if (FAILED(hr))
+	{
+		return false;
+	}
+
+	D3D12_DESCRIPTOR_HEAP_DESC heapDesc = {};
+	heapDesc.NumDescriptors = _frameCount;
+	heapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+	heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+	hr = _pDevice->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(&m_pDescriptorHeap));
+	if (FAILED(hr))
+	{
+		return false;
+	}
+	m_descriptorSize = _pDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+
+	// sized for the largest frame we will see
+	UINT tilesX = (_screenWidth + TILED_CULLING_TILE_SIZE - 1) / TILED_CULLING_TILE_SIZE;
+	UINT tilesY = (_screenHeight + TILED_CULLING_TILE_SIZE - 1) / TILED_CULLING_TILE_SIZE;
+	m_edgesXOffset = AlignOffset(static_cast<UINT64>(_maxLights) * sizeof(TiledLight));
+	m_edgesYOffset = AlignOffset(m_edgesXOffset + (tilesX + 1) * sizeof(DirectX::XMFLOAT2));
+	UINT64 uploadSize = m_edgesYOffset + (tilesY + 1) * sizeof(DirectX::XMFLOAT2);
+
+	for (UINT i = 0; i < _frameCount; ++i)
+	{
+		hr = _pDevice->CreateCommittedResource(
+			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+			D3D12_HEAP_FLAG_NONE,
+			&CD3DX12_RESOURCE_DESC::Buffer(uploadSize),
+			D3D12_RESOURCE_STATE_GENERIC_READ,
+			nullptr,
+			IID_PPV_ARGS(&m_pUploadBuffer[i]));
+		if (FAILED(hr))
+		{
+			return false;
+		}
+		m_pUploadBuffer[i]->SetName(L"Tiled Light Culling Upload Resource Heap");
+
+		CD3DX12_RANGE readRange(0, 0); // we never read it on the cpu
+		hr = m_pUploadBuffer[i]->Map(0, &readRange, reinterpret_cast<void**>(&m_pUploadData[i]));
+		if (FAILED(hr))
+		{
+			return false;
+		}
+	}
+
+	UINT64 maskSize = static_cast<UINT64>(tilesX) * tilesY * ((_maxLights + 31) / 32) * sizeof(UINT);
+	hr = _pDevice->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(maskSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS),
+		D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+		nullptr,
+		IID_PPV_ARGS(&m_pTileMasks));
+	if (FAILED(hr))
+	{
+		return false;
+	}
+	m_pTileMasks->SetName(L"Tile Light Masks Resource Heap");
+
+	return true;
+}
+
+bool TiledLightCullingPass::Upload(TiledLightCulling& _culling, UINT _frameIndex)
+{
+	m_constants = _culling.Constants();
+	if (m_constants.lightCount > m_maxLights)
+	{
+		return false;
+	}
+
+	UINT8* pData = m_pUploadData[_frameIndex];
+	if (m_constants.lightCount > 0)
+		memcpy(pData, _culling.Lights().data(), m_constants.lightCount * sizeof(TiledLight));
+	memcpy(pData + m_edgesXOffset, _culling.EdgesX().data(), _culling.EdgesX().size() * sizeof(DirectX::XMFLOAT2));
+	memcpy(pData + m_edgesYOffset, _culling.EdgesY().data(), _culling.EdgesY().size() * sizeof(DirectX::XMFLOAT2));
+	return true;
+}
+
+void TiledLightCullingPass::Dispatch(GraphicsCommandRecorder& _recorder, ID3D12Resource* _pDepthBuffer, UINT _frameIndex)
+{
+	// the depth buffer can be placed somewhere else from one frame to the next, so its view is written every frame
+	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format = DXGI_FORMAT_R32_FLOAT;
+	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	srvDesc.Texture2D.MipLevels = 1;
+	CD3DX12_CPU_DESCRIPTOR_HANDLE srvHandle(m_pDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), _frameIndex, m_descriptorSize);
+	m_pDevice->CreateShaderResourceView(_pDepthBuffer, &srvDesc, srvHandle);
+
+	// the pso goes through the recorder so it knows the graphics pso has to be set again afterwards.
+	// compute root arguments are separate from the graphics ones, so the rest goes straight to the list
+	_recorder.SetPipelineState(m_pPipelineState);
+	ID3D12GraphicsCommandList* pCommandList = _recorder.CommandList();
+
+	ID3D12DescriptorHeap* ppHeaps[] = { m_pDescriptorHeap };
+	pCommandList->SetDescriptorHeaps(_countof(ppHeaps), ppHeaps);
+	pCommandList->SetComputeRootSignature(m_pRootSignature);
+	pCommandList->SetComputeRoot32BitConstants(m_rootConstants, sizeof(TiledCullingConstants) / sizeof(UINT), &m_constants, 0);
+	pCommandList->SetComputeRootDescriptorTable(m_rootDepthTable, CD3DX12_GPU_DESCRIPTOR_HANDLE(m_pDescriptorHeap->GetGPUDescriptorHandleForHeapStart(), _frameIndex, m_descriptorSize));
+
+	D3D12_GPU_VIRTUAL_ADDRESS uploadAddress = m_pUploadBuffer[_frameIndex]->GetGPUVirtualAddress();
+	pCommandList->SetComputeRootShaderResourceView(m_rootLights, uploadAddress);
+	pCommandList->SetComputeRootShaderResourceView(m_rootEdgesX, uploadAddress + m_edgesXOffset);
+	pCommandList->SetComputeRootShaderResourceView(m_rootEdgesY, uploadAddress + m_edgesYOffset);
+	pCommandList->SetComputeRootUnorderedAccessView(m_rootTileMasks, m_pTileMasks->GetGPUVirtualAddress());
+
+	pCommandList->Dispatch(m_constants.tilesX, m_constants.tilesY, 1);
+
+	// anything reading the masks later in the frame has to wait for the writes
+	_recorder.UAVBarrier(m_pTileMasks);
+}
+
+void TiledLightCullingPass::Release()
+{
+	for (UINT i = 0; i < MAX_FRAMES; ++i)
+	{
+		if (m_pUploadBuffer[i])
+			m_pUploadBuffer[i]->Release();
+		m_pUploadBuffer[i] = nullptr;
+		m_pUploadData[i] = nullptr;
+	}
+	if (m_pTileMasks)
+		m_pTileMasks->Release();
+	m_pTileMasks = nullptr;
+	if (m_pDescriptorHeap)
+		m_pDescriptorHeap->Release();
+	m_pDescriptorHeap = nullptr;
+	if (m_pPipelineState)
+		m_pPipelineState->Release();
+	m_pPipelineState = nullptr;
+	m_pRootSignature = nullptr;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <Windows.h>
+#include <D3d12.h>
+
+#include "CommandRecorder.h"
+#include "RootSignature.h"
+#include "TiledLightCulling.h"
+
+// runs TiledLightCulling.hlsl. the lights and tile planes come from a TiledLightCulling that has been through
+// PrepareLights, so the gpu culls exactly what the cpu reference would, and the result is one bitmask per tile
+// left in TileMasks() in the unordered access state
+class TiledLightCullingPass
+{
+public:
+	static const UINT MAX_FRAMES = 3;
+
+	TiledLightCullingPass() = default;
+	~TiledLightCullingPass() = default;
+
+	bool Init(ID3D12Device* _pDevice, RootSignatureCache& _rootSignatureCache, UINT _maxLights, UINT _screenWidth, UINT _screenHeight, UINT _frameCount);
+
+	// copies the prepared lights and the tile planes into this frame's upload buffer.
+	// returns false if there are more lights than Init was told about, the pass should not run then
+	bool Upload(TiledLightCulling& _culling, UINT _frameIndex);
+
+	// _pDepthBuffer has to be R32_TYPELESS and in the non pixel shader resource state
+	void Dispatch(GraphicsCommandRecorder& _recorder, ID3D12Resource* _pDepthBuffer, UINT _frameIndex);
+
+	ID3D12Resource* TileMasks() { return m_pTileMasks; }
+
+	void Release();
+
+private:
+	ID3D12Device* m_pDevice = nullptr;
+	ID3D12RootSignature* m_pRootSignature = nullptr; // owned by the cache
+	ID3D12PipelineState* m_pPipelineState = nullptr;
+
+	// shader visible, one depth srv per frame so we never rewrite one the gpu may still be reading
+	ID3D12DescriptorHeap* m_pDescriptorHeap = nullptr;
+	UINT m_descriptorSize = 0;
+
+	// per frame upload buffers holding the lights, then the x edges, then the y edges
+	ID3D12Resource* m_pUploadBuffer[MAX_FRAMES] = {};
+	UINT8* m_pUploadData[MAX_FRAMES] = {};
+	UINT64 m_edgesXOffset = 0;
+	UINT64 m_edgesYOffset = 0;
+
+	ID3D12Resource* m_pTileMasks = nullptr;
+
+	UINT m_maxLights = 0;
+	TiledCullingConstants m_constants = {};
+
+	UINT m_rootConstants = 0;
+	UINT m_rootDepthTable = 0;
+	UINT m_rootLights = 0;
+	UINT m_rootEdgesX = 0;
+	UINT m_rootEdgesY = 0;
+	UINT m_rootTileMasks = 0;
+};
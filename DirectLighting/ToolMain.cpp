@@ -0,0 +1,532 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <DirectXMath.h>
+
+#include "AssetArchive.h"
+#include "AssetBuilder.h"
+#include "Culling.h"
+#include "JobSystem.h"
+#include "LightmapBaker.h"
+#include "MeshFile.h"
+#include "MeshImporter.h"
+#include "PathTracer.h"
+#include "TextureFile.h"
+#include "TextureStreaming.h"
+#ifdef _WIN32
+#include "ShaderHotReload.h"
+#endif
+
+using namespace DirectX;
+
+// the offline tools, one mode per asset job. they have nothing to do with the window, so they live in a console
+// program of their own that builds on windows and linux alike. see CMakeLists.txt
+namespace
+{
+	// "rgba8", "bc1", "bc3", "bc5" or "bc7". bc5 is for normal maps, the others take srgb colour
+	bool ParseTextureFormat(const char* _name, TextureDesc& _desc)
+	{
+		const char* formatNames[] = { "rgba8", "bc1", "bc3", "bc5", "bc7" };
+		for (uint32_t format = 0; format < sizeof(formatNames) / sizeof(formatNames[0]); ++format)
+		{
+			if (strcmp(_name, formatNames[format]) == 0)
+			{
+				_desc.format = static_cast<TextureFormat>(format);
+				_desc.normalMap = _desc.format == TEXTURE_FORMAT_BC5;
+				_desc.srgb = !_desc.normalMap;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// "-convert source destination [source destination ...]" turns meshes into the runtime format, for converting
+	// assets ahead of time instead of on the first run. the meshes are converted in parallel and what the vertex cache
+	// optimisation did is printed for each
+	int ConvertMeshes(int _argc, char* _argv[])
+	{
+		JobSystem jobSystem;
+		jobSystem.Init();
+		unsigned int meshCount = (_argc - 2) / 2;
+		std::vector<MeshOptimizeStats> stats(meshCount);
+		std::vector<int> converted(meshCount, 0);
+		jobSystem.ParallelFor(meshCount, 1, [&](unsigned int _begin, unsigned int _end)
+		{
+			for (unsigned int i = _begin; i < _end; ++i)
+				converted[i] = MeshFile::Convert(_argv[2 + i * 2], _argv[3 + i * 2], &jobSystem, &stats[i]) ? 1 : 0;
+		});
+
+		int result = 0;
+		for (unsigned int i = 0; i < meshCount; ++i)
+		{
+			if (converted[i])
+			{
+				printf("%s: acmr %.3f -> %.3f, atvr %.3f -> %.3f, %u clusters, %.1f ms\n", _argv[2 + i * 2], stats[i].before.acmr, stats[i].after.acmr,
+					stats[i].before.atvr, stats[i].after.atvr, stats[i].clusterCount, stats[i].ms);
+			}
+			else
+			{
+				printf("%s: failed\n", _argv[2 + i * 2]);
+				result = 1;
+			}
+		}
+		return result;
+	}
+
+	// "-texture format source destination [source destination ...]" does the same for images, with format one of bc1,
+	// bc3, bc5, bc7 or rgba8. a texture whose destination was already made from the same source with the same settings
+	// is skipped, so an asset build can run it over everything
+	int ConvertTextures(int _argc, char* _argv[])
+	{
+		TextureDesc desc;
+		if (!ParseTextureFormat(_argv[2], desc))
+		{
+			printf("unknown texture format %s\n", _argv[2]);
+			return 1;
+		}
+
+		JobSystem jobSystem;
+		jobSystem.Init();
+		unsigned int textureCount = (_argc - 3) / 2;
+		std::vector<TextureConvertStats> stats(textureCount);
+		std::vector<int> results(textureCount, 0);
+		jobSystem.ParallelFor(textureCount, 1, [&](unsigned int _begin, unsigned int _end)
+		{
+			for (unsigned int i = _begin; i < _end; ++i)
+			{
+				if (TextureFile::IsUpToDate(_argv[3 + i * 2], _argv[4 + i * 2], desc))
+					results[i] = 2;
+				else
+					results[i] = TextureFile::Convert(_argv[3 + i * 2], _argv[4 + i * 2], desc, &jobSystem, &stats[i]) ? 1 : 0;
+			}
+		});
+
+		int result = 0;
+		for (unsigned int i = 0; i < textureCount; ++i)
+		{
+			const TextureConvertStats& s = stats[i];
+			if (results[i] == 2)
+				printf("%s: up to date\n", _argv[3 + i * 2]);
+			else if (results[i] == 1)
+			{
+				printf("%s: %ux%u, %u mips, decode %.1f ms, mips %.1f ms, encode %.1f ms (%.1f mtexels/s), write %.1f ms\n", _argv[3 + i * 2],
+					s.width, s.height, s.mipCount, s.decodeMs, s.mipMs, s.encodeMs, s.encodeMs > 0.0 ? s.texels / (s.encodeMs * 1000.0) : 0.0, s.writeMs);
+			}
+			else
+			{
+				printf("%s: failed\n", _argv[3 + i * 2]);
+				result = 1;
+			}
+		}
+		return result;
+	}
+
+	// "-stream budgetMB texture [texture ...]" flies a camera over a grid of objects wearing the textures, made with
+	// -texture, and streams them through a TextureStreamer held to the budget, as a renderer's culling pass would. what
+	// stayed resident, what was read and dropped, and how many levels the visible objects were short are printed
+	int StreamTextures(int _argc, char* _argv[])
+	{
+		const uint32_t GRID_SIZE = 32;
+		const float GRID_SPACING = 4.0f;
+		const uint32_t FRAME_COUNT = 1000;
+
+		JobSystem jobSystem;
+		jobSystem.Init();
+		TextureStreamingDesc desc;
+		desc.budgetBytes = static_cast<uint64_t>(atoi(_argv[2])) << 20;
+		TextureStreamer streamer;
+		streamer.Init(desc, &jobSystem);
+		std::vector<uint32_t> textures;
+		for (int i = 3; i < _argc; ++i)
+		{
+			uint32_t texture = streamer.AddTexture(_argv[i]);
+			if (texture == TextureStreamer::INVALID_TEXTURE)
+			{
+				printf("%s: failed\n", _argv[i]);
+				return 1;
+			}
+			textures.push_back(texture);
+		}
+
+		// each grid cell gets its own copy of a texture, so the budget is shared between as many textures as a scene has
+		std::vector<uint32_t> objects(GRID_SIZE * GRID_SIZE);
+		for (uint32_t i = 0; i < objects.size(); ++i)
+			objects[i] = i < textures.size() ? textures[i] : streamer.AddTexture(_argv[3 + i % textures.size()]);
+
+		// a 60 degree 720p camera circling low over the grid
+		float pixelsPerUnit = 720.0f * 0.5f / tanf(XM_PI / 6.0f);
+		XMMATRIX proj = XMMatrixPerspectiveFovLH(XM_PI / 3.0f, 1280.0f / 720.0f, 0.1f, 1000.0f);
+		float center = GRID_SIZE * GRID_SPACING * 0.5f;
+		uint64_t missingLevels = 0;
+		uint64_t requested = 0;
+		uint32_t reads = 0;
+		uint32_t evictions = 0;
+		for (uint32_t frame = 0; frame < FRAME_COUNT; ++frame)
+		{
+			float angle = XM_2PI * frame / FRAME_COUNT;
+			XMFLOAT3 eye(center + center * 0.8f * cosf(angle), 2.0f, center + center * 0.8f * sinf(angle));
+			XMVECTOR eyePos = XMLoadFloat3(&eye);
+			XMVECTOR ahead = XMVectorSet(-sinf(angle), -0.1f, cosf(angle), 0.0f);
+			XMFLOAT4X4 viewProj;
+			XMStoreFloat4x4(&viewProj, XMMatrixLookToLH(eyePos, ahead, XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)) * proj);
+			Frustum frustum;
+			Culling::ExtractFrustum(viewProj, frustum);
+
+			for (uint32_t i = 0; i < objects.size(); ++i)
+			{
+				XMFLOAT4 sphere((i % GRID_SIZE + 0.5f) * GRID_SPACING, 0.0f, (i / GRID_SIZE + 0.5f) * GRID_SPACING, 1.0f);
+				if (Culling::SphereInFrustum(frustum, sphere))
+					streamer.Request(objects[i], Culling::ProjectedError(2.0f * sphere.w, sphere, eye, pixelsPerUnit));
+			}
+			streamer.Update();
+
+			// the rest of a frame, which is when the reads get done
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			const TextureStreamingStats& stats = streamer.Stats();
+			missingLevels += stats.missingLevels;
+			requested += stats.texturesRequested;
+			reads += stats.readsStarted;
+			evictions += stats.levelsEvicted;
+		}
+
+		const TextureStreamingStats& stats = streamer.Stats();
+		printf("%u textures, budget %.1f mb, peak resident %.1f mb, read %.1f mb in %u reads, %u levels evicted, %.3f levels short per visible texture\n",
+			streamer.TextureCount(), desc.budgetBytes / 1048576.0, stats.peakResidentBytes / 1048576.0, stats.bytesRead / 1048576.0, reads, evictions,
+			requested > 0 ? static_cast<double>(missingLevels) / requested : 0.0);
+		streamer.Shutdown();
+		return stats.peakResidentBytes <= desc.budgetBytes ? 0 : 1;
+	}
+
+	// "-pack archive file [file ...]" packs files into an AssetArchive, named by their paths as given
+	int PackFiles(int _argc, char* _argv[])
+	{
+		JobSystem jobSystem;
+		jobSystem.Init();
+		std::vector<std::string> files(_argv + 3, _argv + _argc);
+		AssetPackStats stats;
+		if (!AssetArchive::Pack(files, _argv[2], AssetPackDesc(), &jobSystem, &stats))
+		{
+			printf("%s: failed\n", _argv[2]);
+			return 1;
+		}
+		printf("%s: %u assets, %u stored, %.1f mb -> %.1f mb, compress %.1f ms, write %.1f ms\n", _argv[2], stats.assetCount, stats.storedCount,
+			stats.size / 1048576.0, stats.packedSize / 1048576.0, stats.compressMs, stats.writeMs);
+		return 0;
+	}
+
+	// "-readbench archive" times reading every asset in an archive as the loose files it was packed from, then from the
+	// archive on one thread and on the job system, checking all three agree
+	int ReadBenchmark(char* _argv[])
+	{
+		using Clock = std::chrono::high_resolution_clock;
+		JobSystem jobSystem;
+		jobSystem.Init();
+		AssetArchive archive;
+		if (!archive.Open(_argv[2]))
+		{
+			printf("%s: failed\n", _argv[2]);
+			return 1;
+		}
+		std::vector<uint32_t> assets(archive.AssetCount());
+		std::vector<std::string> names(archive.AssetCount());
+		for (uint32_t i = 0; i < archive.AssetCount(); ++i)
+		{
+			assets[i] = i;
+			names[i] = archive.Name(i);
+		}
+		archive.Close();
+
+		Clock::time_point start = Clock::now();
+		std::vector<std::vector<uint8_t>> loose(names.size());
+		uint64_t bytes = 0;
+		for (size_t i = 0; i < names.size(); ++i)
+		{
+			std::ifstream file(names[i], std::ios::binary | std::ios::ate);
+			if (!file)
+			{
+				printf("%s: missing\n", names[i].c_str());
+				return 1;
+			}
+			loose[i].resize(static_cast<size_t>(file.tellg()));
+			file.seekg(0);
+			file.read(reinterpret_cast<char*>(loose[i].data()), static_cast<std::streamsize>(loose[i].size()));
+			bytes += loose[i].size();
+		}
+		double looseMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+		// opening is part of a load, so it is timed too
+		double archiveMs[2];
+		JobSystem* pJobSystems[2] = { nullptr, &jobSystem };
+		for (int run = 0; run < 2; ++run)
+		{
+			start = Clock::now();
+			std::vector<std::vector<uint8_t>> data;
+			bool read = archive.Open(_argv[2]) && archive.ReadMany(assets.data(), static_cast<uint32_t>(assets.size()), data, pJobSystems[run]);
+			archiveMs[run] = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+			archive.Close();
+			if (!read || data != loose)
+			{
+				printf("%s: does not match the loose files\n", _argv[2]);
+				return 1;
+			}
+		}
+		printf("%zu assets, %.1f mb: loose %.1f ms (%.0f mb/s), archive %.1f ms (%.0f mb/s), archive on %u workers %.1f ms (%.0f mb/s)\n",
+			names.size(), bytes / 1048576.0, looseMs, bytes / 1048.576 / looseMs, archiveMs[0], bytes / 1048.576 / archiveMs[0],
+			jobSystem.ThreadCount(), archiveMs[1], bytes / 1048.576 / archiveMs[1]);
+		return 0;
+	}
+
+	// "-build buildfile [cachedir]" builds the steps in an AssetBuilder build file, a line each like
+	// "texture:bc7 Bricks.tex Bricks.png", "mesh Cube.mesh Cube.obj", "shader:vs_5_0 VertexShader.cso VertexShader.hlsl
+	// Lighting.hlsli" or "pack Assets.pack Cube.mesh Bricks.tex". only steps whose inputs changed run, outputs made
+	// before come from the cache, .assetcache unless one is given. shaders need d3dcompiler, so only build on windows
+	int BuildAssets(int _argc, char* _argv[])
+	{
+		JobSystem jobSystem;
+		jobSystem.Init();
+		AssetBuilder builder;
+		if (!builder.Init(_argc == 4 ? _argv[3] : ".assetcache") || !builder.LoadSteps(_argv[2]))
+		{
+			printf("%s: failed\n", _argv[2]);
+			return 1;
+		}
+
+		builder.AddTool("mesh", MeshFile::FILE_VERSION, [](const AssetBuildStep& _step, JobSystem* _pJobSystem)
+		{
+			return MeshFile::Convert(_step.inputs[0], _step.output, _pJobSystem);
+		});
+		// a new file layout or a new encoder both change what a texture step makes
+		uint64_t textureVersion = static_cast<uint64_t>(TextureFile::FILE_VERSION) << 32 | TextureFile::PIPELINE_VERSION;
+		builder.AddTool("texture", textureVersion, [](const AssetBuildStep& _step, JobSystem* _pJobSystem)
+		{
+			TextureDesc desc;
+			return ParseTextureFormat(_step.settings.c_str(), desc) && TextureFile::Convert(_step.inputs[0], _step.output, desc, _pJobSystem);
+		});
+#ifdef _WIN32
+		// "vs_5_0" is optimised, "vs_5_0,debug" keeps the debug info and skips the optimiser, as a hot reload does
+		builder.AddTool("shader", D3D_COMPILER_VERSION, [](const AssetBuildStep& _step, JobSystem*)
+		{
+			size_t comma = _step.settings.find(',');
+			std::string target = _step.settings.substr(0, comma);
+			UINT flags = D3DCOMPILE_OPTIMIZATION_LEVEL3;
+			if (comma != std::string::npos)
+			{
+				if (_step.settings.substr(comma + 1) != "debug")
+					return false;
+				flags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+			}
+			ID3DBlob* pBlob = nullptr;
+			if (!ShaderHotReload::CompileShader(_step.inputs[0], target.c_str(), &pBlob, nullptr, flags))
+				return false;
+			std::ofstream file(_step.output, std::ios::binary);
+			file.write(static_cast<const char*>(pBlob->GetBufferPointer()), static_cast<std::streamsize>(pBlob->GetBufferSize()));
+			pBlob->Release();
+			return static_cast<bool>(file);
+		});
+#endif
+		builder.AddTool("pack", AssetArchive::FILE_VERSION, [](const AssetBuildStep& _step, JobSystem* _pJobSystem)
+		{
+			return AssetArchive::Pack(_step.inputs, _step.output, AssetPackDesc(), _pJobSystem);
+		});
+
+		AssetBuildStats stats;
+		bool built = builder.Build(&jobSystem, &stats);
+		const char* resultNames[] = { "not run", "up to date", "from cache", "built", "failed", "skipped" };
+		for (uint32_t step = 0; step < builder.Steps().size(); ++step)
+		{
+			if (builder.Result(step) != ASSET_BUILD_UP_TO_DATE)
+				printf("%s: %s\n", builder.Steps()[step].output.c_str(), resultNames[builder.Result(step)]);
+		}
+		printf("%u steps in %u waves: %u up to date, %u from cache, %u built, %u failed, %u skipped, %.1f ms\n", stats.stepCount, stats.waveCount,
+			stats.upToDate, stats.fromCache, stats.built, stats.failed, stats.skipped, stats.ms);
+		return built ? 0 : 1;
+	}
+
+	// a mesh (anything MeshImporter reads) standing on a grey floor under the renderer's sun with a point light in front
+	// of it, for the modes that light a mesh on the cpu. _center and _radius bound the mesh
+	bool LoadLitMesh(const char* _fileName, PathTracer& _scene, JobSystem& _jobSystem, XMFLOAT3& _center, float& _radius, size_t& _triangleCount)
+	{
+		MeshImporter importer;
+		ImportedMesh mesh;
+		if (!importer.Load(_fileName, mesh, &_jobSystem))
+		{
+			return false;
+		}
+		XMFLOAT4X4 identity;
+		XMStoreFloat4x4(&identity, XMMatrixIdentity());
+		_scene.ClearScene();
+		_scene.AddMesh(mesh.vertices.data(), static_cast<uint32_t>(mesh.vertices.size()), sizeof(MeshVertex), offsetof(MeshVertex, position),
+			offsetof(MeshVertex, color), mesh.indices.data(), static_cast<uint32_t>(mesh.indices.size()), identity);
+		_triangleCount = mesh.indices.size() / 3;
+
+		XMVECTOR boundsMin = XMLoadFloat3(&mesh.boundsMin);
+		XMVECTOR boundsMax = XMLoadFloat3(&mesh.boundsMax);
+		XMVECTOR center = XMVectorScale(XMVectorAdd(boundsMin, boundsMax), 0.5f);
+		XMStoreFloat3(&_center, center);
+		_radius = std::max(0.5f * XMVectorGetX(XMVector3Length(XMVectorSubtract(boundsMax, boundsMin))), 1e-3f);
+
+		// the floor reaches well past the mesh so it catches the shadows
+		struct FloorVertex
+		{
+			XMFLOAT3 position;
+			XMFLOAT4 color;
+		};
+		XMFLOAT3 floorCenter(_center.x, mesh.boundsMin.y, _center.z);
+		float extent = 10.0f * _radius;
+		FloorVertex floor[4] =
+		{
+			{ XMFLOAT3(floorCenter.x - extent, floorCenter.y, floorCenter.z - extent), XMFLOAT4(0.5f, 0.5f, 0.5f, 1.0f) },
+			{ XMFLOAT3(floorCenter.x - extent, floorCenter.y, floorCenter.z + extent), XMFLOAT4(0.5f, 0.5f, 0.5f, 1.0f) },
+			{ XMFLOAT3(floorCenter.x + extent, floorCenter.y, floorCenter.z + extent), XMFLOAT4(0.5f, 0.5f, 0.5f, 1.0f) },
+			{ XMFLOAT3(floorCenter.x + extent, floorCenter.y, floorCenter.z - extent), XMFLOAT4(0.5f, 0.5f, 0.5f, 1.0f) }
+		};
+		uint32_t floorIndices[6] = { 0, 1, 2, 0, 2, 3 };
+		_scene.AddMesh(floor, 4, sizeof(FloorVertex), offsetof(FloorVertex, position), offsetof(FloorVertex, color), floorIndices, 6, identity);
+
+		Light light = {};
+		XMStoreFloat3(&light.position, XMVectorAdd(center, XMVectorSet(0.0f, _radius, -1.5f * _radius, 0.0f)));
+		light.range = 6.0f * _radius;
+		light.color = XMFLOAT3(4.0f * _radius * _radius, 3.6f * _radius * _radius, 3.0f * _radius * _radius);
+		light.type = LIGHT_POINT;
+		light.direction = XMFLOAT3(0.0f, -1.0f, 0.0f);
+		light.cosOuterAngle = -1.0f;
+		_scene.SetLights(&light, 1);
+		XMFLOAT3 sunDirection;
+		XMStoreFloat3(&sunDirection, XMVector3Normalize(XMVectorSet(0.3f, -1.0f, 0.4f, 0.0f)));
+		_scene.SetSun(sunDirection, XMFLOAT3(1.0f, 1.0f, 1.0f));
+		_scene.Commit();
+		return true;
+	}
+
+	// "-reference mesh image.pfm [passes] [bounces]" path traces LoadLitMesh's scene with PathTracer, no d3d involved,
+	// and writes the image as a pfm to compare the real time lighting against. the mesh is seen from the front and
+	// above by the renderer's 45 degree 720p camera. 64 passes and 4 bounces unless given
+	int RenderReference(int _argc, char* _argv[])
+	{
+		using Clock = std::chrono::high_resolution_clock;
+		JobSystem jobSystem;
+		jobSystem.Init();
+
+		PathTracerDesc desc;
+		desc.maxBounces = _argc > 5 ? static_cast<uint32_t>(atoi(_argv[5])) : 4;
+		uint32_t passes = _argc > 4 ? static_cast<uint32_t>(atoi(_argv[4])) : 64;
+		PathTracer pathTracer;
+		pathTracer.Init(desc);
+		XMFLOAT3 centerPoint;
+		float radius;
+		size_t triangleCount;
+		if (!LoadLitMesh(_argv[2], pathTracer, jobSystem, centerPoint, radius, triangleCount))
+		{
+			printf("%s: failed\n", _argv[2]);
+			return 1;
+		}
+
+		XMVECTOR center = XMLoadFloat3(&centerPoint);
+		XMVECTOR eye = XMVectorAdd(center, XMVectorSet(0.0f, 0.8f * radius, -2.8f * radius, 0.0f));
+		XMFLOAT4X4 view, proj;
+		XMStoreFloat4x4(&view, XMMatrixLookAtLH(eye, center, XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)));
+		XMStoreFloat4x4(&proj, XMMatrixPerspectiveFovLH(45.0f * (XM_PI / 180.0f), static_cast<float>(desc.width) / desc.height, 0.01f * radius, 100.0f * radius));
+		pathTracer.SetCamera(view, proj);
+
+		Clock::time_point start = Clock::now();
+		pathTracer.Render(passes, &jobSystem);
+		double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		if (!pathTracer.SavePfm(_argv[3]))
+		{
+			printf("%s: failed\n", _argv[3]);
+			return 1;
+		}
+		printf("%s: %zu triangles, %ux%u, %u passes of %u bounces on %u workers, %.1f ms (%.2f mrays/s for the camera)\n", _argv[3], triangleCount,
+			desc.width, desc.height, passes, desc.maxBounces, jobSystem.ThreadCount(), ms, static_cast<double>(desc.width) * desc.height * passes / (ms * 1000.0));
+		return 0;
+	}
+
+	// "-bake mesh lightmap [size]" bakes the direct light on LoadLitMesh's scene into a lightmap file with
+	// LightmapBaker, headless, for build machines. the renderer loads the file as it is, see BakedLighting. the
+	// lightmap is 1024 texels square unless given
+	int BakeLightmap(int _argc, char* _argv[])
+	{
+		using Clock = std::chrono::high_resolution_clock;
+		JobSystem jobSystem;
+		jobSystem.Init();
+
+		// the scene keeps no image, it is only there for its rays
+		PathTracerDesc sceneDesc;
+		sceneDesc.width = 1;
+		sceneDesc.height = 1;
+		PathTracer scene;
+		scene.Init(sceneDesc);
+		XMFLOAT3 center;
+		float radius;
+		size_t triangleCount;
+		if (!LoadLitMesh(_argv[2], scene, jobSystem, center, radius, triangleCount))
+		{
+			printf("%s: failed\n", _argv[2]);
+			return 1;
+		}
+
+		LightmapDesc desc;
+		if (_argc > 4)
+			desc.size = static_cast<uint32_t>(atoi(_argv[4]));
+		LightmapBaker baker;
+		Clock::time_point start = Clock::now();
+		if (!baker.Build(scene, desc))
+		{
+			printf("%s: the charts do not fit in %u texels\n", _argv[2], desc.size);
+			return 1;
+		}
+		double buildMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		start = Clock::now();
+		uint32_t baked = baker.Bake(scene, &jobSystem);
+		double bakeMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		if (!baker.Save(_argv[3]))
+		{
+			printf("%s: failed\n", _argv[3]);
+			return 1;
+		}
+		printf("%s: %zu triangles in %zu charts at %.2f texels a unit, %ux%u, charts %.1f ms, %u baked in %.1f ms on %u workers\n", _argv[3],
+			triangleCount, baker.Charts().size(), baker.TexelsPerUnit(), desc.size, desc.size, buildMs, baked, bakeMs, jobSystem.ThreadCount());
+		return 0;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	const char* mode = argc >= 2 ? argv[1] : "";
+	if (argc >= 4 && argc % 2 == 0 && strcmp(mode, "-convert") == 0)
+		return ConvertMeshes(argc, argv);
+	if (argc >= 5 && argc % 2 == 1 && strcmp(mode, "-texture") == 0)
+		return ConvertTextures(argc, argv);
+	if (argc >= 4 && strcmp(mode, "-stream") == 0)
+		return StreamTextures(argc, argv);
+	if (argc >= 4 && strcmp(mode, "-pack") == 0)
+		return PackFiles(argc, argv);
+	if (argc == 3 && strcmp(mode, "-readbench") == 0)
+		return ReadBenchmark(argv);
+	if ((argc == 3 || argc == 4) && strcmp(mode, "-build") == 0)
+		return BuildAssets(argc, argv);
+	if (argc >= 4 && argc <= 6 && strcmp(mode, "-reference") == 0)
+		return RenderReference(argc, argv);
+	if ((argc == 4 || argc == 5) && strcmp(mode, "-bake") == 0)
+		return BakeLightmap(argc, argv);
+
+	printf("usage:\n"
+		"  -convert source destination [source destination ...]\n"
+		"  -texture rgba8|bc1|bc3|bc5|bc7 source destination [source destination ...]\n"
+		"  -stream budgetMB texture [texture ...]\n"
+		"  -pack archive file [file ...]\n"
+		"  -readbench archive\n"
+		"  -build buildfile [cachedir]\n"
+		"  -reference mesh image.pfm [passes] [bounces]\n"
+		"  -bake mesh lightmap [size]\n");
+	return 1;
+}
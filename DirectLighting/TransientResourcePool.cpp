@@ -0,0 +1,216 @@
+#include "TransientResourcePool.h"
+
+#include <cstring>
+
+#include "D3dx12.h"
+
+// the graph's states are cast straight to D3D12_RESOURCE_STATES
+static_assert(FG_STATE_RENDER_TARGET == D3D12_RESOURCE_STATE_RENDER_TARGET, "FrameGraphState must match D3D12_RESOURCE_STATES");
+static_assert(FG_STATE_DEPTH_WRITE == D3D12_RESOURCE_STATE_DEPTH_WRITE, "FrameGraphState must match D3D12_RESOURCE_STATES");
+static_assert(FG_STATE_PIXEL_SHADER_RESOURCE == D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, "FrameGraphState must match D3D12_RESOURCE_STATES");
+static_assert(FG_STATE_COPY_SOURCE == D3D12_RESOURCE_STATE_COPY_SOURCE, "FrameGraphState must match D3D12_RESOURCE_STATES");
+
+namespace
+{
+	bool SameDesc(const TransientDesc& _a, const TransientDesc& _b)
+	{
+		return _a.width == _b.width && _a.height == _b.height && _a.format == _b.format && _a.flags == _b.flags &&
+			memcmp(_a.clearValue, _b.clearValue, sizeof(_a.clearValue)) == 0 && _a.sizeInBytes == _b.sizeInBytes;
+	}
+
+	// a depth buffer that is also read as a texture has a typeless format, its clear value needs the depth format
+	DXGI_FORMAT ClearFormat(DXGI_FORMAT _format)
+	{
+		switch (_format)
+		{
+		case DXGI_FORMAT_R32_TYPELESS: return DXGI_FORMAT_D32_FLOAT;
+		case DXGI_FORMAT_R24G8_TYPELESS: return DXGI_FORMAT_D24_UNORM_S8_UINT;
+		case DXGI_FORMAT_R16_TYPELESS: return DXGI_FORMAT_D16_UNORM;
+		default: return _format;
+		}
+	}
+
+	D3D12_RESOURCE_DESC TextureDesc(const TransientDesc& _desc)
+	{
+		return CD3DX12_RESOURCE_DESC::Tex2D(static_cast<DXGI_FORMAT>(_desc.format), _desc.width, _desc.height, 1, 1, 1, 0,
+			static_cast<D3D12_RESOURCE_FLAGS>(_desc.flags));
+	}
+}
+
+TransientDesc TransientResourcePool::DescribeTexture(ID3D12Device* _pDevice, UINT _width, UINT _height, DXGI_FORMAT _format, D3D12_RESOURCE_FLAGS _flags, const FLOAT _clearValue[4])
+{
+	TransientDesc desc;
+	desc.width = _width;
+	desc.height = _height;
+	desc.format = _format;
+	desc.flags = _flags;
+	memcpy(desc.clearValue, _clearValue, sizeof(desc.clearValue));
+
+	D3D12_RESOURCE_DESC resourceDesc = TextureDesc(desc);
+	D3D12_RESOURCE_ALLOCATION_INFO info = _pDevice->GetResourceAllocationInfo(0, 1, &resourceDesc);
+	desc.sizeInBytes = info.SizeInBytes;
+	desc.alignment = info.Alignment;
+	return desc;
+}
+
+bool TransientResourcePool::Realize(ID3D12Device* _pDevice, FrameGraph& _frameGraph, UINT64 _frame, UINT64 _framesInFlight)
+{
+	// let go of anything the gpu is done with
+	for (size_t i = 0; i < m_retired.size();)
+	{
+		if (m_retired[i].releaseFrame <= _frame)
+		{
+			m_retired[i].pObject->Release();
+			m_retired[i] = m_retired.back();
+			m_retired.pop_back();
+		}
+		else
+		{
+			++i;
+		}
+	}
+
+	UINT64 releaseFrame = _frame + _framesInFlight;
+
+	// growing can't wait, shrinking can. a graph that has needed at most half the heap for SHRINK_AFTER_FRAMES frames in a
+	// row gets a heap its own size, so one big frame (a resize, a debug view) does not hold on to the memory for good
+	UINT64 needed = _frameGraph.HeapSize();
+	if (needed * 2 <= m_heapSize)
+		++m_smallFrames;
+	else
+		m_smallFrames = 0;
+
+	// a different heap means every resource has to move, so start again from nothing
+	if (needed > m_heapSize || m_smallFrames >= SHRINK_AFTER_FRAMES)
+	{
+		for (Entry& entry : m_entries)
+		{
+			Retire(entry.pResource, releaseFrame);
+		}
+		m_entries.clear();
+		if (m_pHeap)
+			Retire(m_pHeap, releaseFrame);
+		m_pHeap = nullptr;
+		m_heapSize = 0;
+		m_smallFrames = 0;
+	}
+
+	if (m_pHeap == nullptr && needed > 0)
+	{
+		// tier 1 hardware cannot mix render targets with other resources in a heap, and render targets and
+		// depth buffers are all we alias
+		D3D12_HEAP_DESC heapDesc = {};
+		heapDesc.SizeInBytes = needed;
+		heapDesc.Properties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+		heapDesc.Alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+		heapDesc.Flags = D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES;
+		HRESULT hr = _pDevice->CreateHeap(&heapDesc, IID_PPV_ARGS(&m_pHeap));
+		if (FAILED(hr))
+		{
+			return false;
+		}
+		m_pHeap->SetName(L"Transient Resource Heap");
+		m_heapSize = heapDesc.SizeInBytes;
+	}
+
+	// reuse a resource from last frame if one matches exactly, otherwise place a new one
+	std::vector<bool> claimed(m_entries.size(), false);
+	m_bound.assign(_frameGraph.ResourceCount(), nullptr);
+	for (uint32_t r = 0; r < _frameGraph.ResourceCount(); ++r)
+	{
+		if (!_frameGraph.IsTransient(r) || !_frameGraph.IsUsed(r))
+			continue;
+
+		const TransientDesc& desc = _frameGraph.Desc(r);
+		UINT64 offset = _frameGraph.HeapOffset(r);
+		uint32_t state = _frameGraph.InitialState(r);
+
+		for (size_t i = 0; i < m_entries.size(); ++i)
+		{
+			if (!claimed[i] && m_entries[i].offset == offset && m_entries[i].state == state && SameDesc(m_entries[i].desc, desc))
+			{
+				claimed[i] = true;
+				m_bound[r] = m_entries[i].pResource;
+				break;
+			}
+		}
+		if (m_bound[r])
+			continue;
+
+		D3D12_CLEAR_VALUE clearValue = {};
+		clearValue.Format = ClearFormat(static_cast<DXGI_FORMAT>(desc.format));
+		if (desc.flags & D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL)
+		{
+			clearValue.DepthStencil.Depth = desc.clearValue[0];
+			clearValue.DepthStencil.Stencil = static_cast<UINT8>(desc.clearValue[1]);
+		}
+		else
+		{
+			memcpy(clearValue.Color, desc.clearValue, sizeof(clearValue.Color));
+		}
+
+		Entry entry;
+		entry.desc = desc;
+		entry.offset = offset;
+		entry.state = state;
+		entry.pResource = nullptr;
+		D3D12_RESOURCE_DESC resourceDesc = TextureDesc(desc);
+		HRESULT hr = _pDevice->CreatePlacedResource(m_pHeap, offset, &resourceDesc, static_cast<D3D12_RESOURCE_STATES>(state),
+			&clearValue, IID_PPV_ARGS(&entry.pResource));
+		if (FAILED(hr))
+		{
+			return false;
+		}
+		m_entries.push_back(entry);
+		claimed.push_back(true);
+		m_bound[r] = entry.pResource;
+	}
+
+	// anything left over belongs to a graph we no longer build
+	for (size_t i = claimed.size(); i-- > 0;)
+	{
+		if (claimed[i])
+			continue;
+		Retire(m_entries[i].pResource, releaseFrame);
+		m_entries.erase(m_entries.begin() + i);
+	}
+
+	return true;
+}
+
+ID3D12Resource* TransientResourcePool::Resource(uint32_t _graphResource)
+{
+	if (_graphResource >= m_bound.size())
+		return nullptr;
+	return m_bound[_graphResource];
+}
+
+void TransientResourcePool::Release()
+{
+	for (Retired& retired : m_retired)
+	{
+		retired.pObject->Release();
+	}
+	m_retired.clear();
+
+	for (Entry& entry : m_entries)
+	{
+		entry.pResource->Release();
+	}
+	m_entries.clear();
+	m_bound.clear();
+
+	if (m_pHeap)
+		m_pHeap->Release();
+	m_pHeap = nullptr;
+	m_heapSize = 0;
+	m_smallFrames = 0;
+}
+
+void TransientResourcePool::Retire(ID3D12Pageable* _pObject, UINT64 _releaseFrame)
+{
+	Retired retired;
+	retired.pObject = _pObject;
+	retired.releaseFrame = _releaseFrame;
+	m_retired.push_back(retired);
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <Windows.h>
+#include <D3d12.h>
+
+#include <vector>
+
+#include "FrameGraph.h"
+
+// gives a compiled frame graph's transient resources real memory. every transient is a placed resource in one heap,
+// at the offset the graph picked, so transients that are never alive together share memory.
+// resources are kept from frame to frame and only recreated when the graph asks for something different,
+// anything replaced is released once the gpu can no longer be using it. the heap grows straight away when a graph
+// needs more, and shrinks once graphs have needed less than half of it for SHRINK_AFTER_FRAMES frames
+class TransientResourcePool
+{
+public:
+	static const UINT64 SHRINK_AFTER_FRAMES = 120;
+
+	TransientResourcePool() = default;
+	~TransientResourcePool() = default;
+
+	// fills in a TransientDesc for a 2d render target or depth buffer, including the size and alignment the device wants
+	static TransientDesc DescribeTexture(ID3D12Device* _pDevice, UINT _width, UINT _height, DXGI_FORMAT _format, D3D12_RESOURCE_FLAGS _flags, const FLOAT _clearValue[4]);
+
+	// creates whatever the compiled graph needs that we do not already have. _frame is the current frame number and
+	// anything replaced is released once _frame + _framesInFlight has been reached
+	bool Realize(ID3D12Device* _pDevice, FrameGraph& _frameGraph, UINT64 _frame, UINT64 _framesInFlight);
+
+	// the placed resource behind a transient, or null if the graph did not use it
+	ID3D12Resource* Resource(uint32_t _graphResource);
+
+	void Release();
+
+private:
+	struct Entry
+	{
+		TransientDesc desc;
+		UINT64 offset;
+		uint32_t state;
+		ID3D12Resource* pResource;
+	};
+
+	struct Retired
+	{
+		ID3D12Pageable* pObject;
+		UINT64 releaseFrame;
+	};
+
+	void Retire(ID3D12Pageable* _pObject, UINT64 _releaseFrame);
+
+	ID3D12Heap* m_pHeap = nullptr;
+	UINT64 m_heapSize = 0;
+	UINT64 m_smallFrames = 0; // frames in a row the graph has needed at most half the heap
+	std::vector<Entry> m_entries;
+	std::vector<ID3D12Resource*> m_bound; // graph resource index to placed resource for the current frame
+	std::vector<Retired> m_retired;
+};
@@ -0,0 +1,445 @@
+#include "TriangleBvh.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+	const uint32_t BIN_COUNT = 16;
+	const uint32_t MAX_STACK = 128;
+
+	float SurfaceArea(const XMFLOAT3& _min, const XMFLOAT3& _max)
+	{
+		float x = _max.x - _min.x;
+		float y = _max.y - _min.y;
+		float z = _max.z - _min.z;
+		return 2.0f * (x * y + y * z + z * x);
+	}
+
+	void Grow(XMFLOAT3& _min, XMFLOAT3& _max, const XMFLOAT3& _pointMin, const XMFLOAT3& _pointMax)
+	{
+		_min.x = std::min(_min.x, _pointMin.x);
+		_min.y = std::min(_min.y, _pointMin.y);
+		_min.z = std::min(_min.z, _pointMin.z);
+		_max.x = std::max(_max.x, _pointMax.x);
+		_max.y = std::max(_max.y, _pointMax.y);
+		_max.z = std::max(_max.z, _pointMax.z);
+	}
+
+	float Component(const XMFLOAT3& _v, uint32_t _axis)
+	{
+		return _axis == 0 ? _v.x : (_axis == 1 ? _v.y : _v.z);
+	}
+
+	// a direction of exactly zero along an axis would give 0 * infinity in the slab test
+	float SafeInverse(float _d)
+	{
+		const float TINY = 1e-20f;
+		return 1.0f / (std::fabs(_d) > TINY ? _d : std::copysign(TINY, _d));
+	}
+}
+
+void TriangleBvh::Build(const XMFLOAT3* _positions, const uint32_t* _indices, uint32_t _triangleCount)
+{
+	m_nodes.clear();
+	m_leaves.clear();
+	m_buildNodes.clear();
+	m_triangleCount = _triangleCount;
+	if (_triangleCount == 0)
+		return;
+
+	m_pPositions = _positions;
+	m_pIndices = _indices;
+	m_order.resize(_triangleCount);
+	m_triangleMin.resize(_triangleCount);
+	m_triangleMax.resize(_triangleCount);
+	m_centroids.resize(_triangleCount);
+	for (uint32_t i = 0; i < _triangleCount; ++i)
+	{
+		const XMFLOAT3& a = _positions[_indices[i * 3 + 0]];
+		const XMFLOAT3& b = _positions[_indices[i * 3 + 1]];
+		const XMFLOAT3& c = _positions[_indices[i * 3 + 2]];
+		m_triangleMin[i] = a;
+		m_triangleMax[i] = a;
+		Grow(m_triangleMin[i], m_triangleMax[i], b, b);
+		Grow(m_triangleMin[i], m_triangleMax[i], c, c);
+		m_centroids[i] = XMFLOAT3(
+			0.5f * (m_triangleMin[i].x + m_triangleMax[i].x),
+			0.5f * (m_triangleMin[i].y + m_triangleMax[i].y),
+			0.5f * (m_triangleMin[i].z + m_triangleMax[i].z));
+		m_order[i] = i;
+	}
+
+	m_buildNodes.reserve(2 * _triangleCount / LEAF_SIZE + 1);
+	uint32_t root = BuildBinary(0, _triangleCount);
+
+	// the root of the wide tree is always a node, even when everything fits in one leaf
+	if (m_buildNodes[root].count > 0)
+	{
+		Node node;
+		std::fill(std::begin(node.children), std::end(node.children), EMPTY_CHILD);
+		const BuildNode& buildNode = m_buildNodes[root];
+		node.minX[0] = buildNode.boundsMin.x;
+		node.minY[0] = buildNode.boundsMin.y;
+		node.minZ[0] = buildNode.boundsMin.z;
+		node.maxX[0] = buildNode.boundsMax.x;
+		node.maxY[0] = buildNode.boundsMax.y;
+		node.maxZ[0] = buildNode.boundsMax.z;
+		for (uint32_t slot = 1; slot < 4; ++slot)
+		{
+			node.minX[slot] = node.minY[slot] = node.minZ[slot] = 0.0f;
+			node.maxX[slot] = node.maxY[slot] = node.maxZ[slot] = 0.0f;
+		}
+		m_nodes.push_back(node);
+		m_nodes[0].children[0] = Collapse(root);
+	}
+	else
+	{
+		Collapse(root);
+	}
+
+	m_buildNodes.clear();
+	m_buildNodes.shrink_to_fit();
+	m_triangleMin.clear();
+	m_triangleMax.clear();
+	m_centroids.clear();
+	m_pPositions = nullptr;
+	m_pIndices = nullptr;
+}
+
+uint32_t TriangleBvh::BuildBinary(uint32_t _begin, uint32_t _end)
+{
+	BuildNode buildNode;
+	buildNode.boundsMin = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+	buildNode.boundsMax = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	XMFLOAT3 centroidMin = buildNode.boundsMin;
+	XMFLOAT3 centroidMax = buildNode.boundsMax;
+	for (uint32_t i = _begin; i < _end; ++i)
+	{
+		uint32_t triangle = m_order[i];
+		Grow(buildNode.boundsMin, buildNode.boundsMax, m_triangleMin[triangle], m_triangleMax[triangle]);
+		Grow(centroidMin, centroidMax, m_centroids[triangle], m_centroids[triangle]);
+	}
+	buildNode.left = buildNode.right = 0;
+	buildNode.first = _begin;
+	buildNode.count = _end - _begin;
+
+	uint32_t index = static_cast<uint32_t>(m_buildNodes.size());
+	m_buildNodes.push_back(buildNode);
+	if (_end - _begin <= LEAF_SIZE)
+		return index;
+
+	// bin the centroids along the longest axis of their bounds and split where the surface area heuristic is lowest
+	XMFLOAT3 extent(centroidMax.x - centroidMin.x, centroidMax.y - centroidMin.y, centroidMax.z - centroidMin.z);
+	uint32_t axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+	float axisMin = Component(centroidMin, axis);
+	float axisExtent = Component(extent, axis);
+
+	uint32_t middle = _begin + (_end - _begin) / 2;
+	if (axisExtent > 0.0f)
+	{
+		uint32_t binCounts[BIN_COUNT] = {};
+		XMFLOAT3 binMin[BIN_COUNT];
+		XMFLOAT3 binMax[BIN_COUNT];
+		std::fill(std::begin(binMin), std::end(binMin), XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX));
+		std::fill(std::begin(binMax), std::end(binMax), XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX));
+		float binScale = BIN_COUNT * (1.0f - 1e-6f) / axisExtent;
+		auto binOf = [&](uint32_t _triangle)
+		{
+			return std::min(static_cast<uint32_t>((Component(m_centroids[_triangle], axis) - axisMin) * binScale), BIN_COUNT - 1);
+		};
+		for (uint32_t i = _begin; i < _end; ++i)
+		{
+			uint32_t triangle = m_order[i];
+			uint32_t bin = binOf(triangle);
+			++binCounts[bin];
+			Grow(binMin[bin], binMax[bin], m_triangleMin[triangle], m_triangleMax[triangle]);
+		}
+
+		// the area and count to the right of every split, then sweep from the left
+		float rightCost[BIN_COUNT] = {};
+		XMFLOAT3 sweepMin(FLT_MAX, FLT_MAX, FLT_MAX);
+		XMFLOAT3 sweepMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		uint32_t sweepCount = 0;
+		for (uint32_t bin = BIN_COUNT - 1; bin > 0; --bin)
+		{
+			Grow(sweepMin, sweepMax, binMin[bin], binMax[bin]);
+			sweepCount += binCounts[bin];
+			rightCost[bin] = sweepCount > 0 ? SurfaceArea(sweepMin, sweepMax) * sweepCount : 0.0f;
+		}
+
+		float bestCost = FLT_MAX;
+		uint32_t bestSplit = 0;
+		sweepMin = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+		sweepMax = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		sweepCount = 0;
+		for (uint32_t split = 1; split < BIN_COUNT; ++split)
+		{
+			Grow(sweepMin, sweepMax, binMin[split - 1], binMax[split - 1]);
+			sweepCount += binCounts[split - 1];
+			if (sweepCount == 0 || sweepCount == _end - _begin)
+				continue;
+			float cost = SurfaceArea(sweepMin, sweepMax) * sweepCount + rightCost[split];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestSplit = split;
+			}
+		}
+
+		if (bestSplit > 0)
+		{
+			uint32_t* pMiddle = std::partition(m_order.data() + _begin, m_order.data() + _end, [&](uint32_t _triangle)
+			{
+				return binOf(_triangle) < bestSplit;
+			});
+			middle = static_cast<uint32_t>(pMiddle - m_order.data());
+		}
+	}
+
+	// every centroid in the same place, split by count
+	if (middle == _begin || middle == _end)
+		middle = _begin + (_end - _begin) / 2;
+
+	uint32_t left = BuildBinary(_begin, middle);
+	uint32_t right = BuildBinary(middle, _end);
+	m_buildNodes[index].left = left;
+	m_buildNodes[index].right = right;
+	m_buildNodes[index].count = 0;
+	return index;
+}
+
+uint32_t TriangleBvh::Collapse(uint32_t _buildNode)
+{
+	const BuildNode& buildNode = m_buildNodes[_buildNode];
+	if (buildNode.count > 0)
+	{
+		Leaf leaf;
+		XMFLOAT4 v0[3] = {};
+		XMFLOAT4 e1[3] = {};
+		XMFLOAT4 e2[3] = {};
+		float* pV0[3] = { &v0[0].x, &v0[1].x, &v0[2].x };
+		float* pE1[3] = { &e1[0].x, &e1[1].x, &e1[2].x };
+		float* pE2[3] = { &e2[0].x, &e2[1].x, &e2[2].x };
+		for (uint32_t lane = 0; lane < 4; ++lane)
+		{
+			leaf.triangles[lane] = 0;
+			if (lane >= buildNode.count)
+				continue;
+
+			uint32_t triangle = m_order[buildNode.first + lane];
+			const XMFLOAT3& a = m_pPositions[m_pIndices[triangle * 3 + 0]];
+			const XMFLOAT3& b = m_pPositions[m_pIndices[triangle * 3 + 1]];
+			const XMFLOAT3& c = m_pPositions[m_pIndices[triangle * 3 + 2]];
+			const float aComponents[3] = { a.x, a.y, a.z };
+			const float bComponents[3] = { b.x, b.y, b.z };
+			const float cComponents[3] = { c.x, c.y, c.z };
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				pV0[axis][lane] = aComponents[axis];
+				pE1[axis][lane] = bComponents[axis] - aComponents[axis];
+				pE2[axis][lane] = cComponents[axis] - aComponents[axis];
+			}
+			leaf.triangles[lane] = triangle;
+		}
+		leaf.v0x = XMLoadFloat4(&v0[0]);
+		leaf.v0y = XMLoadFloat4(&v0[1]);
+		leaf.v0z = XMLoadFloat4(&v0[2]);
+		leaf.e1x = XMLoadFloat4(&e1[0]);
+		leaf.e1y = XMLoadFloat4(&e1[1]);
+		leaf.e1z = XMLoadFloat4(&e1[2]);
+		leaf.e2x = XMLoadFloat4(&e2[0]);
+		leaf.e2y = XMLoadFloat4(&e2[1]);
+		leaf.e2z = XMLoadFloat4(&e2[2]);
+		m_leaves.push_back(leaf);
+		return LEAF_FLAG | static_cast<uint32_t>(m_leaves.size() - 1);
+	}
+
+	// open up the child with the largest surface area until there are four
+	uint32_t children[4] = { buildNode.left, buildNode.right };
+	uint32_t childCount = 2;
+	while (childCount < 4)
+	{
+		int32_t largest = -1;
+		float largestArea = -1.0f;
+		for (uint32_t i = 0; i < childCount; ++i)
+		{
+			const BuildNode& child = m_buildNodes[children[i]];
+			float area = SurfaceArea(child.boundsMin, child.boundsMax);
+			if (child.count == 0 && area > largestArea)
+			{
+				largest = static_cast<int32_t>(i);
+				largestArea = area;
+			}
+		}
+		if (largest < 0)
+			break;
+
+		const BuildNode& opened = m_buildNodes[children[largest]];
+		children[childCount++] = opened.right;
+		children[largest] = opened.left;
+	}
+
+	uint32_t index = static_cast<uint32_t>(m_nodes.size());
+	m_nodes.push_back(Node());
+	for (uint32_t slot = 0; slot < 4; ++slot)
+	{
+		uint32_t code = EMPTY_CHILD;
+		XMFLOAT3 boundsMin(0.0f, 0.0f, 0.0f);
+		XMFLOAT3 boundsMax(0.0f, 0.0f, 0.0f);
+		if (slot < childCount)
+		{
+			code = Collapse(children[slot]);
+			boundsMin = m_buildNodes[children[slot]].boundsMin;
+			boundsMax = m_buildNodes[children[slot]].boundsMax;
+		}
+
+		// m_nodes may have grown while the child was collapsed
+		Node& node = m_nodes[index];
+		node.children[slot] = code;
+		node.minX[slot] = boundsMin.x;
+		node.minY[slot] = boundsMin.y;
+		node.minZ[slot] = boundsMin.z;
+		node.maxX[slot] = boundsMax.x;
+		node.maxY[slot] = boundsMax.y;
+		node.maxZ[slot] = boundsMax.z;
+	}
+	return index;
+}
+
+bool TriangleBvh::Intersect(const XMFLOAT3& _origin, const XMFLOAT3& _direction, float _tMax, RayHit& _hit)
+{
+	return Trace<false>(_origin, _direction, _tMax, &_hit);
+}
+
+bool TriangleBvh::Occluded(const XMFLOAT3& _origin, const XMFLOAT3& _direction, float _tMax)
+{
+	return Trace<true>(_origin, _direction, _tMax, nullptr);
+}
+
+template<bool ANY_HIT>
+bool TriangleBvh::Trace(const XMFLOAT3& _origin, const XMFLOAT3& _direction, float _tMax, RayHit* _pHit)
+{
+	if (m_nodes.empty())
+		return false;
+
+	XMVECTOR originX = XMVectorReplicate(_origin.x);
+	XMVECTOR originY = XMVectorReplicate(_origin.y);
+	XMVECTOR originZ = XMVectorReplicate(_origin.z);
+	XMVECTOR directionX = XMVectorReplicate(_direction.x);
+	XMVECTOR directionY = XMVectorReplicate(_direction.y);
+	XMVECTOR directionZ = XMVectorReplicate(_direction.z);
+	XMVECTOR inverseX = XMVectorReplicate(SafeInverse(_direction.x));
+	XMVECTOR inverseY = XMVectorReplicate(SafeInverse(_direction.y));
+	XMVECTOR inverseZ = XMVectorReplicate(SafeInverse(_direction.z));
+	XMVECTOR zero = XMVectorZero();
+	XMVECTOR one = XMVectorReplicate(1.0f);
+	XMVECTOR epsilon = XMVectorReplicate(1e-12f);
+
+	float tMax = _tMax;
+	bool found = false;
+	uint32_t stack[MAX_STACK];
+	uint32_t stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0)
+	{
+		uint32_t code = stack[--stackSize];
+		if (code & LEAF_FLAG)
+		{
+			// moller trumbore on four triangles at once
+			const Leaf& leaf = m_leaves[code & ~LEAF_FLAG];
+			XMVECTOR px = XMVectorSubtract(XMVectorMultiply(directionY, leaf.e2z), XMVectorMultiply(directionZ, leaf.e2y));
+			XMVECTOR py = XMVectorSubtract(XMVectorMultiply(directionZ, leaf.e2x), XMVectorMultiply(directionX, leaf.e2z));
+			XMVECTOR pz = XMVectorSubtract(XMVectorMultiply(directionX, leaf.e2y), XMVectorMultiply(directionY, leaf.e2x));
+			XMVECTOR det = XMVectorMultiplyAdd(leaf.e1x, px, XMVectorMultiplyAdd(leaf.e1y, py, XMVectorMultiply(leaf.e1z, pz)));
+			XMVECTOR inverseDet = XMVectorReciprocal(det);
+
+			XMVECTOR sx = XMVectorSubtract(originX, leaf.v0x);
+			XMVECTOR sy = XMVectorSubtract(originY, leaf.v0y);
+			XMVECTOR sz = XMVectorSubtract(originZ, leaf.v0z);
+			XMVECTOR u = XMVectorMultiply(XMVectorMultiplyAdd(sx, px, XMVectorMultiplyAdd(sy, py, XMVectorMultiply(sz, pz))), inverseDet);
+
+			XMVECTOR qx = XMVectorSubtract(XMVectorMultiply(sy, leaf.e1z), XMVectorMultiply(sz, leaf.e1y));
+			XMVECTOR qy = XMVectorSubtract(XMVectorMultiply(sz, leaf.e1x), XMVectorMultiply(sx, leaf.e1z));
+			XMVECTOR qz = XMVectorSubtract(XMVectorMultiply(sx, leaf.e1y), XMVectorMultiply(sy, leaf.e1x));
+			XMVECTOR v = XMVectorMultiply(XMVectorMultiplyAdd(directionX, qx, XMVectorMultiplyAdd(directionY, qy, XMVectorMultiply(directionZ, qz))), inverseDet);
+			XMVECTOR t = XMVectorMultiply(XMVectorMultiplyAdd(leaf.e2x, qx, XMVectorMultiplyAdd(leaf.e2y, qy, XMVectorMultiply(leaf.e2z, qz))), inverseDet);
+
+			XMVECTOR hit = XMVectorGreater(XMVectorAbs(det), epsilon);
+			hit = XMVectorAndInt(hit, XMVectorGreaterOrEqual(u, zero));
+			hit = XMVectorAndInt(hit, XMVectorGreaterOrEqual(v, zero));
+			hit = XMVectorAndInt(hit, XMVectorLessOrEqual(XMVectorAdd(u, v), one));
+			hit = XMVectorAndInt(hit, XMVectorGreater(t, zero));
+			hit = XMVectorAndInt(hit, XMVectorLess(t, XMVectorReplicate(tMax)));
+
+			uint32_t mask[4];
+			XMStoreInt4(mask, hit);
+			if (!(mask[0] | mask[1] | mask[2] | mask[3]))
+				continue;
+			if (ANY_HIT)
+				return true;
+
+			XMFLOAT4 ts;
+			XMFLOAT4 us;
+			XMFLOAT4 vs;
+			XMStoreFloat4(&ts, t);
+			XMStoreFloat4(&us, u);
+			XMStoreFloat4(&vs, v);
+			const float* pT = &ts.x;
+			for (uint32_t lane = 0; lane < 4; ++lane)
+			{
+				if (mask[lane] && pT[lane] < tMax)
+				{
+					tMax = pT[lane];
+					_pHit->t = pT[lane];
+					_pHit->triangle = leaf.triangles[lane];
+					_pHit->u = (&us.x)[lane];
+					_pHit->v = (&vs.x)[lane];
+					found = true;
+				}
+			}
+			continue;
+		}
+
+		// slab test against all four children
+		const Node& node = m_nodes[code];
+		XMVECTOR tx0 = XMVectorMultiply(XMVectorSubtract(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(node.minX)), originX), inverseX);
+		XMVECTOR tx1 = XMVectorMultiply(XMVectorSubtract(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(node.maxX)), originX), inverseX);
+		XMVECTOR ty0 = XMVectorMultiply(XMVectorSubtract(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(node.minY)), originY), inverseY);
+		XMVECTOR ty1 = XMVectorMultiply(XMVectorSubtract(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(node.maxY)), originY), inverseY);
+		XMVECTOR tz0 = XMVectorMultiply(XMVectorSubtract(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(node.minZ)), originZ), inverseZ);
+		XMVECTOR tz1 = XMVectorMultiply(XMVectorSubtract(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(node.maxZ)), originZ), inverseZ);
+		XMVECTOR tNear = XMVectorMax(XMVectorMax(XMVectorMin(tx0, tx1), XMVectorMin(ty0, ty1)), XMVectorMax(XMVectorMin(tz0, tz1), zero));
+		XMVECTOR tFar = XMVectorMin(XMVectorMin(XMVectorMax(tx0, tx1), XMVectorMax(ty0, ty1)), XMVectorMin(XMVectorMax(tz0, tz1), XMVectorReplicate(tMax)));
+
+		uint32_t mask[4];
+		XMStoreInt4(mask, XMVectorLessOrEqual(tNear, tFar));
+		XMFLOAT4 nears;
+		XMStoreFloat4(&nears, tNear);
+
+		// push the hit children farthest first, so the nearest is visited next and shrinks tMax for the rest
+		uint32_t hitChildren[4];
+		float hitNear[4];
+		uint32_t hitCount = 0;
+		for (uint32_t slot = 0; slot < 4; ++slot)
+		{
+			if (!mask[slot] || node.children[slot] == EMPTY_CHILD)
+				continue;
+			float distance = (&nears.x)[slot];
+			uint32_t insert = hitCount++;
+			for (; insert > 0 && hitNear[insert - 1] < distance; --insert)
+			{
+				hitNear[insert] = hitNear[insert - 1];
+				hitChildren[insert] = hitChildren[insert - 1];
+			}
+			hitNear[insert] = distance;
+			hitChildren[insert] = node.children[slot];
+		}
+		for (uint32_t i = 0; i < hitCount && stackSize < MAX_STACK; ++i)
+			stack[stackSize++] = hitChildren[i];
+	}
+	return found;
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include <DirectXMath.h>
+
+#include <cstdint>
+#include <vector>
+
+struct RayHit
+{
+	float t; // distance along the ray, in units of its direction's length
+	uint32_t triangle; // the index the triangle was given to Build with
+	float u; // barycentrics of the second and third vertex
+	float v;
+};
+
+// a bounding volume hierarchy over triangles for casting rays on the cpu, four children to a node.
+//
+// it is built as a binary tree with the surface area heuristic over binned centroids, then collapsed so every node
+// takes in the children of its largest children until it has four. a node keeps its children's boxes side by side,
+// one component per array, so a ray tests all four with a handful of DirectXMath vector operations and visits the
+// ones it hits nearest first. leaves hold up to four triangles laid out the same way and are tested all at once too
+class TriangleBvh
+{
+public:
+	static const uint32_t LEAF_SIZE = 4;
+
+	TriangleBvh() = default;
+	~TriangleBvh() = default;
+
+	// _positions are world space, _indices three per triangle
+	void Build(const DirectX::XMFLOAT3* _positions, const uint32_t* _indices, uint32_t _triangleCount);
+
+	// the nearest hit closer than _tMax. _direction does not have to be normalised
+	bool Intersect(const DirectX::XMFLOAT3& _origin, const DirectX::XMFLOAT3& _direction, float _tMax, RayHit& _hit);
+
+	// whether anything is hit closer than _tMax. stops at the first hit, so it is cheaper than Intersect for shadow rays
+	bool Occluded(const DirectX::XMFLOAT3& _origin, const DirectX::XMFLOAT3& _direction, float _tMax);
+
+	uint32_t NodeCount() { return static_cast<uint32_t>(m_nodes.size()); }
+	uint32_t TriangleCount() { return m_triangleCount; }
+
+private:
+	static const uint32_t LEAF_FLAG = 0x80000000;
+	static const uint32_t EMPTY_CHILD = 0xffffffff;
+
+	// four child boxes. an empty slot has an inside out box that nothing hits
+	struct Node
+	{
+		float minX[4];
+		float minY[4];
+		float minZ[4];
+		float maxX[4];
+		float maxY[4];
+		float maxZ[4];
+		uint32_t children[4]; // a node index, or LEAF_FLAG | leaf index
+	};
+
+	// up to four triangles as the first vertex and the two edges from it. unused lanes have zero edges and never hit
+	struct Leaf
+	{
+		DirectX::XMVECTOR v0x, v0y, v0z;
+		DirectX::XMVECTOR e1x, e1y, e1z;
+		DirectX::XMVECTOR e2x, e2y, e2z;
+		uint32_t triangles[4];
+	};
+
+	struct BuildNode
+	{
+		DirectX::XMFLOAT3 boundsMin;
+		DirectX::XMFLOAT3 boundsMax;
+		uint32_t left; // children in the binary tree, or the range of m_order for a leaf
+		uint32_t right;
+		uint32_t first;
+		uint32_t count;
+	};
+
+	uint32_t BuildBinary(uint32_t _begin, uint32_t _end);
+	uint32_t Collapse(uint32_t _buildNode);
+
+	template<bool ANY_HIT>
+	bool Trace(const DirectX::XMFLOAT3& _origin, const DirectX::XMFLOAT3& _direction, float _tMax, RayHit* _pHit);
+
+	std::vector<Node> m_nodes; // the root is node 0
+	std::vector<Leaf> m_leaves;
+	uint32_t m_triangleCount = 0;
+
+	// only used while building
+	std::vector<BuildNode> m_buildNodes;
+	std::vector<uint32_t> m_order; // triangle indices, partitioned as the binary tree is built
+	std::vector<DirectX::XMFLOAT3> m_triangleMin;
+	std::vector<DirectX::XMFLOAT3> m_triangleMax;
+	std::vector<DirectX::XMFLOAT3> m_centroids;
+	const DirectX::XMFLOAT3* m_pPositions = nullptr;
+	const uint32_t* m_pIndices = nullptr;
+};
@@ -0,0 +1,153 @@
+#include "VertexCompression.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "JobSystem.h"
+#include "MeshImporter.h"
+
+using namespace DirectX;
+
+namespace
+{
+	const uint32_t COMPRESS_GRAIN = 4096; // vertices per job
+
+	static_assert(sizeof(PackedVertex) == 16, "the input layouts and mesh files expect 16 byte vertices");
+
+	float Saturate(float _value)
+	{
+		return std::min(std::max(_value, 0.0f), 1.0f);
+	}
+
+	// rounds to the nearest step, which is what the unorm and snorm formats expect
+	uint32_t ToUnorm(float _value, uint32_t _max)
+	{
+		return static_cast<uint32_t>(Saturate(_value) * _max + 0.5f);
+	}
+
+	int16_t ToSnorm16(float _value)
+	{
+		_value = std::min(std::max(_value, -1.0f), 1.0f);
+		return static_cast<int16_t>(std::floor(_value * 32767.0f + 0.5f));
+	}
+
+	// the gpu maps -32768 and -32767 both to -1
+	float FromSnorm16(int16_t _value)
+	{
+		return std::max(_value / 32767.0f, -1.0f);
+	}
+
+	float SignNotZero(float _value)
+	{
+		return _value >= 0.0f ? 1.0f : -1.0f;
+	}
+}
+
+void VertexCompression::EncodePosition(const XMFLOAT3& _position, const XMFLOAT3& _boundsMin, const XMFLOAT3& _boundsMax, uint16_t _encoded[4])
+{
+	const float position[3] = { _position.x, _position.y, _position.z };
+	const float boundsMin[3] = { _boundsMin.x, _boundsMin.y, _boundsMin.z };
+	const float boundsMax[3] = { _boundsMax.x, _boundsMax.y, _boundsMax.z };
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		float extent = boundsMax[axis] - boundsMin[axis];
+		float t = extent > 0.0f ? (position[axis] - boundsMin[axis]) / extent : 0.0f;
+		_encoded[axis] = static_cast<uint16_t>(ToUnorm(t, 0xffff));
+	}
+	_encoded[3] = 0xffff;
+}
+
+XMFLOAT3 VertexCompression::DecodePosition(const uint16_t _encoded[4], const XMFLOAT3& _boundsMin, const XMFLOAT3& _boundsMax)
+{
+	return XMFLOAT3(
+		_boundsMin.x + _encoded[0] / 65535.0f * (_boundsMax.x - _boundsMin.x),
+		_boundsMin.y + _encoded[1] / 65535.0f * (_boundsMax.y - _boundsMin.y),
+		_boundsMin.z + _encoded[2] / 65535.0f * (_boundsMax.z - _boundsMin.z));
+}
+
+XMFLOAT4X4 VertexCompression::PositionDecodeMatrix(const XMFLOAT3& _boundsMin, const XMFLOAT3& _boundsMax)
+{
+	XMFLOAT4X4 decode;
+	XMStoreFloat4x4(&decode, XMMatrixScaling(_boundsMax.x - _boundsMin.x, _boundsMax.y - _boundsMin.y, _boundsMax.z - _boundsMin.z) *
+		XMMatrixTranslation(_boundsMin.x, _boundsMin.y, _boundsMin.z));
+	return decode;
+}
+
+void VertexCompression::EncodeNormal(const XMFLOAT3& _normal, int16_t _encoded[2])
+{
+	// project onto the octahedron |x| + |y| + |z| = 1, then fold the lower half over the diagonals of the square
+	float length = std::fabs(_normal.x) + std::fabs(_normal.y) + std::fabs(_normal.z);
+	if (length <= 0.0f)
+	{
+		_encoded[0] = 0;
+		_encoded[1] = 0;
+		return;
+	}
+	float x = _normal.x / length;
+	float y = _normal.y / length;
+	if (_normal.z < 0.0f)
+	{
+		float foldedX = (1.0f - std::fabs(y)) * SignNotZero(x);
+		float foldedY = (1.0f - std::fabs(x)) * SignNotZero(y);
+		x = foldedX;
+		y = foldedY;
+	}
+	_encoded[0] = ToSnorm16(x);
+	_encoded[1] = ToSnorm16(y);
+}
+
+XMFLOAT3 VertexCompression::DecodeNormal(const int16_t _encoded[2])
+{
+	// the same steps as OctDecode in VertexShader.hlsl
+	float x = FromSnorm16(_encoded[0]);
+	float y = FromSnorm16(_encoded[1]);
+	float z = 1.0f - std::fabs(x) - std::fabs(y);
+	float t = std::max(-z, 0.0f);
+	x += x >= 0.0f ? -t : t;
+	y += y >= 0.0f ? -t : t;
+
+	XMFLOAT3 normal;
+	XMStoreFloat3(&normal, XMVector3Normalize(XMVectorSet(x, y, z, 0.0f)));
+	return normal;
+}
+
+uint32_t VertexCompression::PackRgba8(const XMFLOAT4& _color)
+{
+	return ToUnorm(_color.x, 255) | (ToUnorm(_color.y, 255) << 8) | (ToUnorm(_color.z, 255) << 16) | (ToUnorm(_color.w, 255) << 24);
+}
+
+XMFLOAT4 VertexCompression::UnpackRgba8(uint32_t _packed)
+{
+	return XMFLOAT4((_packed & 0xff) / 255.0f, ((_packed >> 8) & 0xff) / 255.0f, ((_packed >> 16) & 0xff) / 255.0f, (_packed >> 24) / 255.0f);
+}
+
+uint32_t VertexCompression::PackRgb10A2(const XMFLOAT4& _color)
+{
+	return ToUnorm(_color.x, 1023) | (ToUnorm(_color.y, 1023) << 10) | (ToUnorm(_color.z, 1023) << 20) | (ToUnorm(_color.w, 3) << 30);
+}
+
+XMFLOAT4 VertexCompression::UnpackRgb10A2(uint32_t _packed)
+{
+	return XMFLOAT4((_packed & 0x3ff) / 1023.0f, ((_packed >> 10) & 0x3ff) / 1023.0f, ((_packed >> 20) & 0x3ff) / 1023.0f, (_packed >> 30) / 3.0f);
+}
+
+void VertexCompression::Compress(const MeshVertex* _pVertices, uint32_t _count, bool _hasColors, const XMFLOAT3& _boundsMin,
+	const XMFLOAT3& _boundsMax, PackedVertex* _pPacked, JobSystem* _pJobSystem)
+{
+	auto compressRange = [&](unsigned int _begin, unsigned int _end)
+	{
+		for (unsigned int i = _begin; i < _end; ++i)
+		{
+			const MeshVertex& vertex = _pVertices[i];
+			PackedVertex& packed = _pPacked[i];
+			EncodePosition(vertex.position, _boundsMin, _boundsMax, packed.position);
+			EncodeNormal(vertex.normal, packed.normal);
+			packed.color = PackRgba8(_hasColors ? vertex.color :
+				XMFLOAT4(vertex.normal.x * 0.5f + 0.5f, vertex.normal.y * 0.5f + 0.5f, vertex.normal.z * 0.5f + 0.5f, 1.0f));
+		}
+	};
+	if (_pJobSystem && _count > COMPRESS_GRAIN)
+		_pJobSystem->ParallelFor(_count, COMPRESS_GRAIN, compressRange);
+	else
+		compressRange(0, _count);
+}
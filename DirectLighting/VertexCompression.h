@@ -0,0 +1,47 @@
+#pragma once
+#include <DirectXMath.h>
+
+#include <cstdint>
+
+class JobSystem;
+struct MeshVertex;
+
+// the vertex the scene is drawn with, 16 bytes instead of the 28 of a float position and colour:
+//  position R16G16B16A16_UNORM, quantised inside the mesh's bounds. w is always 1 so the input assembler hands the
+//           shader a (0..1, 1) point that one matrix (PositionDecodeMatrix) scales back, folded into the wvp matrix
+//  normal   R16G16_SNORM, octahedral: the unit sphere unfolded onto a square, decoded in VertexShader.hlsl
+//  color    R8G8B8A8_UNORM
+struct PackedVertex
+{
+	uint16_t position[4];
+	int16_t normal[2];
+	uint32_t color;
+};
+
+namespace VertexCompression
+{
+	// _position must lie inside _boundsMin.._boundsMax. flat axes are stored as 0
+	void EncodePosition(const DirectX::XMFLOAT3& _position, const DirectX::XMFLOAT3& _boundsMin, const DirectX::XMFLOAT3& _boundsMax, uint16_t _encoded[4]);
+	DirectX::XMFLOAT3 DecodePosition(const uint16_t _encoded[4], const DirectX::XMFLOAT3& _boundsMin, const DirectX::XMFLOAT3& _boundsMax);
+
+	// takes an encoded position from 0..1 back to object space: scale by the bounds' size, then move by their minimum
+	DirectX::XMFLOAT4X4 PositionDecodeMatrix(const DirectX::XMFLOAT3& _boundsMin, const DirectX::XMFLOAT3& _boundsMax);
+
+	// _normal does not need to be normalised. the zero vector comes back as +z
+	void EncodeNormal(const DirectX::XMFLOAT3& _normal, int16_t _encoded[2]);
+	DirectX::XMFLOAT3 DecodeNormal(const int16_t _encoded[2]);
+
+	// rgba, red in the low bits, as the R8G8B8A8_UNORM and R10G10B10A2_UNORM formats read them. clamped to 0..1
+	uint32_t PackRgba8(const DirectX::XMFLOAT4& _color);
+	DirectX::XMFLOAT4 UnpackRgba8(uint32_t _packed);
+	uint32_t PackRgb10A2(const DirectX::XMFLOAT4& _color);
+	DirectX::XMFLOAT4 UnpackRgb10A2(uint32_t _packed);
+
+	// packs _count vertices on the job system. meshes without colours are coloured by their normals so their shape
+	// still shows
+	void Compress(const MeshVertex* _pVertices, uint32_t _count, bool _hasColors, const DirectX::XMFLOAT3& _boundsMin,
+		const DirectX::XMFLOAT3& _boundsMax, PackedVertex* _pPacked, JobSystem* _pJobSystem = nullptr);
+
+	// whether every index of a mesh with _vertexCount vertices fits in 16 bits
+	inline bool FitsIn16Bits(uint32_t _vertexCount) { return _vertexCount <= 0x10000; }
+}
@@ -1,10 +1,15 @@
+// bound as root constants (see Graphics::InitRootSignature), read the same way as a constant buffer
 cbuffer ConstantBuffer : register(b0)
 {
   float4x4 wvpMat;
+  float4 normalMat[3]; // the inverse world matrix's rows, the inverse transpose's columns
 };
+// vertices are PackedVertex (VertexCompression.h). the input assembler unpacks the unorm and snorm formats to floats,
+// so the position arrives as (0..1, 1) inside the mesh's bounds and wvpMat already holds the matrix that undoes that
 struct VS_INPUT
 {
   float4 pos : POSITION;
+  float2 normal : NORMAL; // octahedral
   float4 color: COLOR;
 };
 
@@ -12,11 +17,24 @@ struct VS_OUTPUT
 {
   float4 pos: SV_POSITION;
   float4 color: COLOR;
+  float3 normal: NORMAL; // world space, not normalised
 };
+
+// the square back onto the unit sphere, the same steps as VertexCompression::DecodeNormal
+float3 OctDecode(float2 e)
+{
+  float3 n = float3(e, 1.0f - abs(e.x) - abs(e.y));
+  float t = max(-n.z, 0.0f);
+  n.xy += n.xy >= 0.0f ? -t : t;
+  return normalize(n);
+}
+
 VS_OUTPUT main(VS_INPUT input)
 {
   VS_OUTPUT output;
   output.pos = mul(input.pos, wvpMat);
   output.color =  input.color;
+  float3 normal = OctDecode(input.normal);
+  output.normal = float3(dot(normalMat[0].xyz, normal), dot(normalMat[1].xyz, normal), dot(normalMat[2].xyz, normal));
 	return output;
 }
\ No newline at end of file
@@ -10,6 +10,7 @@ int WINAPI WinMain(HINSTANCE hInstance,    //Main windows function
 	int nShowCmd)
 
 {
+	// just the window. converting, packing and building assets is done by the console tool, see ToolMain.cpp
 	Scene* scene = new Scene(1280, 720, "Liams");
 	return WindowsApp::Run(scene, hInstance, nShowCmd);
 }
\ No newline at end of file